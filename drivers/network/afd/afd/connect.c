@@ -252,6 +252,10 @@ WarmSocketForConnection(PAFD_FCB FCB) {
                                           FCB->Connection.Object );
     }
 
+    /* Before the SYN goes out, so it already announces the SO_RCVBUF window */
+    if( NT_SUCCESS(Status) )
+        AfdApplyTransportBufferSizes( FCB );
+
     return Status;
 }
 
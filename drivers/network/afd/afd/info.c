@@ -58,6 +58,10 @@ AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
         InfoReq->Information.Ulong = FCB->Recv.Content - FCB->Recv.BytesUsed;
         break;
 
+        case AFD_INFO_ZERO_COPY_SENDS:
+            InfoReq->Information.Ulong = FCB->ZeroCopySends;
+            break;
+
         case AFD_INFO_SENDS_IN_PROGRESS:
             InfoReq->Information.Ulong = 0;
 
@@ -98,6 +102,39 @@ AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     return UnlockAndMaybeComplete( FCB, Status, Irp, 0 );
 }
 
+static VOID
+AfdSetTransportBufferSize( PAFD_FCB FCB, ULONG Id, ULONG Size ) {
+    NTSTATUS Status;
+
+    /* Only connection oriented transports size their window per connection */
+    if (FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS || !FCB->Connection.Object)
+        return;
+
+    Status = TdiSetInformationEx(FCB->Connection.Object,
+                                 CO_TL_ENTITY,
+                                 0,
+                                 INFO_CLASS_PROTOCOL,
+                                 INFO_TYPE_CONNECTION,
+                                 Id,
+                                 &Size,
+                                 sizeof(Size));
+
+    /* The AFD buffers are still resized if the transport doesn't support it */
+    if (!NT_SUCCESS(Status))
+        AFD_DbgPrint(MIN_TRACE,("Transport refused buffer size %u for id %u (%x)\n",
+                                Size, Id, Status));
+}
+
+/* Pushes the sizes set before connect() or listen() to a new connection object */
+VOID
+AfdApplyTransportBufferSizes( PAFD_FCB FCB ) {
+    if (FCB->TdiReceiveWindowSize)
+        AfdSetTransportBufferSize(FCB, TCP_SOCKET_WINDOW, FCB->TdiReceiveWindowSize);
+
+    if (FCB->TdiSendBufferSize)
+        AfdSetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, FCB->TdiSendBufferSize);
+}
+
 NTSTATUS NTAPI
 AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             PIO_STACK_LOCATION IrpSp ) {
@@ -106,6 +143,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     PFILE_OBJECT FileObject = IrpSp->FileObject;
     PAFD_FCB FCB = FileObject->FsContext;
     PCHAR NewBuffer;
+    ULONG RecvSize;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
@@ -124,21 +162,32 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 FCB->OobInline = InfoReq->Information.Boolean;
                 break;
             case AFD_INFO_RECEIVE_WINDOW_SIZE:
+                /* The transport sizes its receive window with the full value.
+                 * Keep it for the connection object of a later connect() or accept() */
+                if (!(FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS))
+                {
+                    FCB->TdiReceiveWindowSize = InfoReq->Information.Ulong;
+                    AfdSetTransportBufferSize(FCB, TCP_SOCKET_WINDOW, FCB->TdiReceiveWindowSize);
+                }
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
+                    /* FIXME: We should not have to limit the packet receive buffer size like this. workaround for CORE-15804 */
+                    RecvSize = min(InfoReq->Information.Ulong, 0x2000);
+
                     /* FIXME: likely not right, check tcpip.sys for TDI_QUERY_MAX_DATAGRAM_INFO */
-                    if (InfoReq->Information.Ulong > 0 && InfoReq->Information.Ulong < 0xFFFF &&
-                        InfoReq->Information.Ulong != FCB->Recv.Size)
+                    if (RecvSize > 0 && RecvSize < 0xFFFF &&
+                        RecvSize != FCB->Recv.Size)
                     {
                         NewBuffer = ExAllocatePoolWithTag(PagedPool,
-                                                          InfoReq->Information.Ulong,
+                                                          RecvSize,
                                                           TAG_AFD_DATA_BUFFER);
 
                         if (NewBuffer)
                         {
-                            if (FCB->Recv.Content > InfoReq->Information.Ulong)
-                                FCB->Recv.Content = InfoReq->Information.Ulong;
+                            if (FCB->Recv.Content > RecvSize)
+                                FCB->Recv.Content = RecvSize;
 
                             if (FCB->Recv.Window)
                             {
@@ -149,7 +198,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                                 ExFreePoolWithTag(FCB->Recv.Window, TAG_AFD_DATA_BUFFER);
                             }
 
-                            FCB->Recv.Size = InfoReq->Information.Ulong;
+                            FCB->Recv.Size = RecvSize;
                             FCB->Recv.Window = NewBuffer;
 
                             Status = STATUS_SUCCESS;
@@ -166,10 +215,17 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 }
                 else
                 {
-                    Status = STATUS_INVALID_PARAMETER;
+                    /* Only the transport size is kept until the socket connects */
+                    Status = STATUS_SUCCESS;
                 }
                 break;
             case AFD_INFO_SEND_WINDOW_SIZE:
+                if (!(FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS))
+                {
+                    FCB->TdiSendBufferSize = InfoReq->Information.Ulong;
+                    AfdSetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, FCB->TdiSendBufferSize);
+                }
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
@@ -211,7 +267,8 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 }
                 else
                 {
-                    Status = STATUS_INVALID_PARAMETER;
+                    /* Only the transport size is kept until the socket connects */
+                    Status = STATUS_SUCCESS;
                 }
                 break;
             default:
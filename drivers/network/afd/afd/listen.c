@@ -27,6 +27,10 @@ static NTSTATUS SatisfyAccept( PAFD_DEVICE_EXTENSION DeviceExt,
 
     FCB->Connection = Qelt->Object;
 
+    /* The connection was set up with the listening socket's sizes, the
+     * accepting socket's own ones win */
+    AfdApplyTransportBufferSizes( FCB );
+
     if (FCB->RemoteAddress)
     {
         ExFreePoolWithTag(FCB->RemoteAddress, TAG_AFD_TRANSPORT_ADDRESS);
@@ -215,7 +219,7 @@ static NTSTATUS NTAPI ListenComplete( PDEVICE_OBJECT DeviceObject,
         FCB->PollStatus[FD_ACCEPT_BIT] = STATUS_SUCCESS;
         PollReeval( FCB->DeviceExt, FCB->FileObject );
     } else
-        FCB->PollState &= ~AFD_EVENT_ACCEPT;
+        PollClear( FCB, AFD_EVENT_ACCEPT );
 
     SocketStateUnlock( FCB );
 
@@ -319,7 +323,7 @@ NTSTATUS AfdWaitForListen( PDEVICE_OBJECT DeviceObject, PIRP Irp,
              FCB->PollStatus[FD_ACCEPT_BIT] = STATUS_SUCCESS;
              PollReeval( FCB->DeviceExt, FCB->FileObject );
         } else
-             FCB->PollState &= ~AFD_EVENT_ACCEPT;
+             PollClear( FCB, AFD_EVENT_ACCEPT );
 
         SocketStateUnlock( FCB );
         return Status;
@@ -393,7 +397,7 @@ NTSTATUS AfdAccept( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 FCB->PollStatus[FD_ACCEPT_BIT] = STATUS_SUCCESS;
                 PollReeval( FCB->DeviceExt, FCB->FileObject );
             } else
-                FCB->PollState &= ~AFD_EVENT_ACCEPT;
+                PollClear( FCB, AFD_EVENT_ACCEPT );
 
             SocketStateUnlock( FCB );
             return Status;
@@ -755,7 +755,7 @@ AfdDisconnect(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         FCB->LastReceiveStatus = STATUS_SUCCESS;
 
         /* Clear the receive event */
-        FCB->PollState &= ~AFD_EVENT_RECEIVE;
+        PollClear( FCB, AFD_EVENT_RECEIVE );
 
         /* Receive direction only */
         if ((DisReq->DisconnectType & AFD_DISCONNECT_RECV) &&
@@ -806,7 +806,7 @@ AfdDisconnect(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         FCB->DisconnectTimeout = DisReq->Timeout;
         FCB->DisconnectPending = TRUE;
         FCB->SendClosed = TRUE;
-        FCB->PollState &= ~AFD_EVENT_SEND;
+        PollClear( FCB, AFD_EVENT_SEND );
 
         Status = QueueUserModeIrp(FCB, Irp, FUNCTION_DISCONNECT);
         if (Status == STATUS_PENDING)
@@ -844,7 +844,7 @@ AfdDisconnect(PDEVICE_OBJECT DeviceObject, PIRP Irp,
             FCB->RemoteAddress = NULL;
         }
 
-        FCB->PollState &= ~AFD_EVENT_SEND;
+        PollClear( FCB, AFD_EVENT_SEND );
         FCB->SendClosed = TRUE;
     }
 
@@ -968,6 +968,9 @@ AfdDispatch(PDEVICE_OBJECT DeviceObject, PIRP Irp)
         case IOCTL_AFD_ENUM_NETWORK_EVENTS:
             return AfdEnumEvents( DeviceObject, Irp, IrpSp );
 
+        case IOCTL_AFD_POLL_REGISTER:
+            return AfdPollRegister( DeviceObject, Irp, IrpSp );
+
         case IOCTL_AFD_RECV_DATAGRAM:
             return AfdPacketSocketReadData( DeviceObject, Irp, IrpSp );
 
@@ -1281,6 +1284,19 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
 
         if (CurrentIrp == Irp)
         {
+            /* The transport reads the chunk in flight straight from the
+             * caller's pages, which must stay locked until it is done.
+             * Stop the transport, ZeroCopySendComplete finishes the IRP */
+            if (Irp == FCB->ZeroCopySendIrp)
+            {
+                FCB->ZeroCopySendCancelled = TRUE;
+                if (FCB->SendIrp.InFlightRequest)
+                    IoCancelIrp(FCB->SendIrp.InFlightRequest);
+
+                SocketStateUnlock(FCB);
+                return;
+            }
+
             RemoveEntryList(CurrentEntry);
             CleanupPendingIrp(FCB, Irp, IrpSp, NULL);
             UnlockAndMaybeComplete(FCB, STATUS_CANCELLED, Irp, 0);
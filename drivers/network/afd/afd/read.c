@@ -236,7 +236,7 @@ static NTSTATUS ReceiveActivity( PAFD_FCB FCB, PIRP Irp ) {
     }
     else
     {
-        FCB->PollState &= ~AFD_EVENT_RECEIVE;
+        PollClear( FCB, AFD_EVENT_RECEIVE );
     }
 
     /* Signal FD_CLOSE if no buffered data remains and the socket can't receive any more */
@@ -479,7 +479,7 @@ AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 PollReeval( FCB->DeviceExt, FCB->FileObject );
             }
             else
-                FCB->PollState &= ~AFD_EVENT_RECEIVE;
+                PollClear( FCB, AFD_EVENT_RECEIVE );
 
             UnlockBuffers(RecvReq->BufferArray, RecvReq->BufferCount, FALSE);
 
@@ -490,13 +490,13 @@ AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         {
             AFD_DbgPrint(MID_TRACE,("Nonblocking\n"));
             Status = STATUS_CANT_WAIT;
-            FCB->PollState &= ~AFD_EVENT_RECEIVE;
+            PollClear( FCB, AFD_EVENT_RECEIVE );
             UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
             return UnlockAndMaybeComplete( FCB, Status, Irp, 0 );
         }
         else
         {
-            FCB->PollState &= ~AFD_EVENT_RECEIVE;
+            PollClear( FCB, AFD_EVENT_RECEIVE );
             return LeaveIrpUntilLater( FCB, Irp, FUNCTION_RECV );
         }
     }
@@ -672,7 +672,7 @@ PacketSocketRecvComplete(
         FCB->PollStatus[FD_READ_BIT] = STATUS_SUCCESS;
         PollReeval( FCB->DeviceExt, FCB->FileObject );
     } else
-        FCB->PollState &= ~AFD_EVENT_RECEIVE;
+        PollClear( FCB, AFD_EVENT_RECEIVE );
 
     if( NT_SUCCESS(Irp->IoStatus.Status) && FCB->Recv.Content < FCB->Recv.Size ) {
         /* Now relaunch the datagram request */
@@ -759,7 +759,7 @@ AfdPacketSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
             PollReeval( FCB->DeviceExt, FCB->FileObject );
         }
         else
-            FCB->PollState &= ~AFD_EVENT_RECEIVE;
+            PollClear( FCB, AFD_EVENT_RECEIVE );
 
         UnlockBuffers(RecvReq->BufferArray, RecvReq->BufferCount, TRUE);
 
@@ -770,13 +770,13 @@ AfdPacketSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
     {
         AFD_DbgPrint(MID_TRACE,("Nonblocking\n"));
         Status = STATUS_CANT_WAIT;
-        FCB->PollState &= ~AFD_EVENT_RECEIVE;
+        PollClear( FCB, AFD_EVENT_RECEIVE );
         UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, TRUE );
         return UnlockAndMaybeComplete( FCB, Status, Irp, 0 );
     }
     else
     {
-        FCB->PollState &= ~AFD_EVENT_RECEIVE;
+        PollClear( FCB, AFD_EVENT_RECEIVE );
         return LeaveIrpUntilLater( FCB, Irp, FUNCTION_RECV );
     }
 }
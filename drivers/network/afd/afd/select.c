@@ -378,6 +378,80 @@ AfdEnumEvents( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     return UnlockAndMaybeComplete( FCB, STATUS_SUCCESS, Irp, 0 );
 }
 
+/* Queues the registered events of a socket to its completion port */
+static VOID SignalPollSet( PAFD_FCB FCB, PFILE_OBJECT FileObject ) {
+    DWORD Events = FCB->PollState & FCB->PollSetEvents;
+    NTSTATUS Status;
+
+    /* Edge triggered registrations only get the events that became ready
+     * since they were last posted */
+    if( FCB->PollSetFlags & AFD_POLL_EDGE_TRIGGERED )
+        Events &= ~FCB->PollSetReported;
+
+    if( !Events || !FCB->PollSetArmed || !FileObject->CompletionContext )
+        return;
+
+    AFD_DbgPrint(MID_TRACE,("Posting %x for %p\n", Events, FCB));
+
+    Status = IoSetIoCompletion( FileObject->CompletionContext->Port,
+                                FileObject->CompletionContext->Key,
+                                FCB->PollSetContext,
+                                STATUS_SUCCESS,
+                                Events,
+                                FALSE );
+    if( !NT_SUCCESS(Status) ) {
+        AFD_DbgPrint(MIN_TRACE,("Failed to post events (0x%x)\n", Status));
+        return;
+    }
+
+    if( FCB->PollSetFlags & AFD_POLL_EDGE_TRIGGERED )
+        FCB->PollSetReported |= Events;
+    else
+        FCB->PollSetArmed = FALSE;
+}
+
+NTSTATUS NTAPI
+AfdPollRegister( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                 PIO_STACK_LOCATION IrpSp ) {
+    PFILE_OBJECT FileObject = IrpSp->FileObject;
+    PAFD_POLL_REGISTER_INFO RegisterInfo =
+        (PAFD_POLL_REGISTER_INFO)LockRequest( Irp, IrpSp, FALSE, NULL );
+    PAFD_FCB FCB = FileObject->FsContext;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    if( !SocketAcquireStateLock( FCB ) ) {
+        return LostSocket( Irp );
+    }
+
+    if ( !RegisterInfo ) {
+         return UnlockAndMaybeComplete( FCB, STATUS_NO_MEMORY, Irp, 0 );
+    }
+
+    AFD_DbgPrint(MID_TRACE,("Called (Events %x Flags %x Context %p)\n",
+                            RegisterInfo->Events,
+                            RegisterInfo->Flags,
+                            RegisterInfo->Context));
+
+    /* Events can only be reported through a completion port */
+    if( (RegisterInfo->Flags & ~AFD_POLL_EDGE_TRIGGERED) ||
+        (RegisterInfo->Events && !FileObject->CompletionContext) ) {
+        AFD_DbgPrint(MIN_TRACE,("Invalid parameter\n"));
+        return UnlockAndMaybeComplete( FCB, STATUS_INVALID_PARAMETER, Irp, 0 );
+    }
+
+    FCB->PollSetEvents = RegisterInfo->Events;
+    FCB->PollSetFlags = RegisterInfo->Flags;
+    FCB->PollSetContext = RegisterInfo->Context;
+    FCB->PollSetArmed = (RegisterInfo->Events != 0);
+    FCB->PollSetReported = 0;
+
+    /* Report what is already pending */
+    SignalPollSet( FCB, FileObject );
+
+    return UnlockAndMaybeComplete( FCB, STATUS_SUCCESS, Irp, 0 );
+}
+
 /* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
 static BOOLEAN UpdatePollWithFCB( PAFD_ACTIVE_POLL Poll, PFILE_OBJECT FileObject ) {
     UINT i;
@@ -404,6 +478,13 @@ static BOOLEAN UpdatePollWithFCB( PAFD_ACTIVE_POLL Poll, PFILE_OBJECT FileObject
     return Signalled ? 1 : 0;
 }
 
+/* The socket is no longer ready for Events, e.g. because the data was read.
+ * Edge triggered registrations report them again once they come back */
+VOID PollClear( PAFD_FCB FCB, DWORD Events ) {
+    FCB->PollState &= ~Events;
+    FCB->PollSetReported &= ~Events;
+}
+
 VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
     PAFD_ACTIVE_POLL Poll = NULL;
     PLIST_ENTRY ThePollEnt = NULL;
@@ -451,5 +532,8 @@ VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
         KeSetEvent( FCB->EventSelect, IO_NETWORK_INCREMENT, FALSE );
     }
 
+    /* And the completion port of a registered socket */
+    SignalPollSet( FCB, FileObject );
+
     AFD_DbgPrint(MID_TRACE,("Leaving\n"));
 }
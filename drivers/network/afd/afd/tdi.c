@@ -759,6 +759,61 @@ NTSTATUS TdiQueryInformationEx(
                                  OutputLength);                             /* Return information */
 }
 
+NTSTATUS TdiSetInformationEx(
+    PFILE_OBJECT FileObject,
+    ULONG Entity,
+    ULONG Instance,
+    ULONG Class,
+    ULONG Type,
+    ULONG Id,
+    PVOID InputBuffer,
+    ULONG InputLength)
+/*
+ * FUNCTION: Extended set information
+ * ARGUMENTS:
+ *     FileObject  = Pointer to file object
+ *     Entity      = Entity
+ *     Instance    = Instance
+ *     Class       = Entity class
+ *     Type        = Entity type
+ *     Id          = Entity id
+ *     InputBuffer = Address of buffer with the data to set
+ *     InputLength = Length of InputBuffer
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    PTCP_REQUEST_SET_INFORMATION_EX SetInfo;
+    ULONG SetInfoLength;
+    NTSTATUS Status;
+
+    SetInfoLength = FIELD_OFFSET(TCP_REQUEST_SET_INFORMATION_EX, Buffer) + InputLength;
+    SetInfo = ExAllocatePoolWithTag(NonPagedPool, SetInfoLength, TAG_AFD_SET_INFO);
+    if (!SetInfo)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlZeroMemory(SetInfo, SetInfoLength);
+    SetInfo->ID.toi_entity.tei_entity   = Entity;
+    SetInfo->ID.toi_entity.tei_instance = Instance;
+    SetInfo->ID.toi_class = Class;
+    SetInfo->ID.toi_type  = Type;
+    SetInfo->ID.toi_id    = Id;
+    SetInfo->BufferSize   = InputLength;
+    RtlCopyMemory(SetInfo->Buffer, InputBuffer, InputLength);
+
+    Status = TdiQueryDeviceControl(FileObject,                      /* Transport/connection object */
+                                   IOCTL_TCP_SET_INFORMATION_EX,    /* Control code */
+                                   SetInfo,                         /* Input buffer */
+                                   SetInfoLength,                   /* Input buffer length */
+                                   NULL,                            /* Output buffer */
+                                   0,                               /* Output buffer length */
+                                   NULL);                           /* Return information */
+
+    ExFreePoolWithTag(SetInfo, TAG_AFD_SET_INFO);
+
+    return Status;
+}
+
 NTSTATUS TdiQueryAddress(
     PFILE_OBJECT FileObject,
     PULONG Address)
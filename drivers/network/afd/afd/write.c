@@ -10,6 +10,76 @@
 
 #include "afd.h"
 
+static IO_COMPLETION_ROUTINE ZeroCopySendComplete;
+
+static VOID FailPendingSends( PAFD_FCB FCB, NTSTATUS Status ) {
+    PLIST_ENTRY NextIrpEntry;
+    PIRP NextIrp;
+    PIO_STACK_LOCATION NextIrpSp;
+    PAFD_SEND_INFO SendReq;
+
+    FCB->ZeroCopySendIrp = NULL;
+    FCB->ZeroCopySendCancelled = FALSE;
+
+    while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_SEND] ) ) {
+        NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]);
+        NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
+        NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
+        SendReq = GetLockedData(NextIrp, NextIrpSp);
+
+        UnlockBuffers( SendReq->BufferArray,
+                       SendReq->BufferCount,
+                       FALSE );
+
+        NextIrp->IoStatus.Status = Status;
+        NextIrp->IoStatus.Information = 0;
+
+        if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, NextIrpSp );
+        (void)IoSetCancelRoutine(NextIrp, NULL);
+        IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
+    }
+}
+
+/*
+ * Hands the next unsent buffer of a zero-copy send to the transport. The
+ * buffer is addressed through the MDL LockBuffers built for it, so this
+ * works from the completion routine too, whatever process we run in.
+ */
+static NTSTATUS StartZeroCopySend( PAFD_FCB FCB, PIRP Irp ) {
+    PAFD_SEND_INFO SendReq = GetLockedData(Irp, IoGetCurrentIrpStackLocation(Irp));
+    PAFD_MAPBUF Map = (PAFD_MAPBUF)(SendReq->BufferArray + SendReq->BufferCount);
+    UINT BytesSent = (UINT)(ULONG_PTR)Irp->Tail.Overlay.DriverContext[3];
+    PCHAR BufferAddress;
+    UINT i;
+
+    for( i = 0; i < SendReq->BufferCount; i++ ) {
+        if( BytesSent < SendReq->BufferArray[i].len ) {
+            BufferAddress = MmGetSystemAddressForMdlSafe( Map[i].Mdl,
+                                                          NormalPagePriority );
+            if( !BufferAddress )
+                return STATUS_INSUFFICIENT_RESOURCES;
+
+            AFD_DbgPrint(MID_TRACE,("Sending buffer %u from %p:%u\n",
+                                    i,
+                                    BufferAddress + BytesSent,
+                                    SendReq->BufferArray[i].len - BytesSent));
+
+            return TdiSend( &FCB->SendIrp.InFlightRequest,
+                            FCB->Connection.Object,
+                            0,
+                            BufferAddress + BytesSent,
+                            SendReq->BufferArray[i].len - BytesSent,
+                            ZeroCopySendComplete,
+                            FCB );
+        }
+
+        BytesSent -= SendReq->BufferArray[i].len;
+    }
+
+    ASSERT(FALSE);
+    return STATUS_INVALID_PARAMETER;
+}
+
 static IO_COMPLETION_ROUTINE SendComplete;
 static NTSTATUS NTAPI SendComplete
 ( PDEVICE_OBJECT DeviceObject,
@@ -50,18 +120,7 @@ static NTSTATUS NTAPI SendComplete
 
     if( FCB->State == SOCKET_STATE_CLOSED ) {
         /* Cleanup our IRP queue because the FCB is being destroyed */
-        while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_SEND] ) ) {
-            NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]);
-            NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
-            NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
-            SendReq = GetLockedData(NextIrp, NextIrpSp);
-            NextIrp->IoStatus.Status = STATUS_FILE_CLOSED;
-            NextIrp->IoStatus.Information = 0;
-            UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, FALSE);
-            if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
-            (void)IoSetCancelRoutine(NextIrp, NULL);
-            IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
-        }
+        FailPendingSends( FCB, STATUS_FILE_CLOSED );
 
         RetryDisconnectCompletion(FCB);
 
@@ -71,26 +130,7 @@ static NTSTATUS NTAPI SendComplete
 
     if( !NT_SUCCESS(Status) ) {
         /* Complete all following send IRPs with error */
-
-        while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_SEND] ) ) {
-            NextIrpEntry =
-                RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]);
-            NextIrp =
-                CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
-            NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
-            SendReq = GetLockedData(NextIrp, NextIrpSp);
-
-            UnlockBuffers( SendReq->BufferArray,
-                           SendReq->BufferCount,
-                           FALSE );
-
-            NextIrp->IoStatus.Status = Status;
-            NextIrp->IoStatus.Information = 0;
-
-            if ( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
-            (void)IoSetCancelRoutine(NextIrp, NULL);
-            IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
-        }
+        FailPendingSends( FCB, Status );
 
         RetryDisconnectCompletion(FCB);
 
@@ -181,7 +221,7 @@ static NTSTATUS NTAPI SendComplete
            /* Blocking sockets have to wait here */
            if (SendLength <= FCB->Send.Size && !((SendReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking)))
            {
-               FCB->PollState &= ~AFD_EVENT_SEND;
+               PollClear( FCB, AFD_EVENT_SEND );
 
                NextIrp = NULL;
            }
@@ -189,7 +229,7 @@ static NTSTATUS NTAPI SendComplete
            /* Check if we can send anything */
            if (SpaceAvail == 0)
            {
-               FCB->PollState &= ~AFD_EVENT_SEND;
+               PollClear( FCB, AFD_EVENT_SEND );
 
                /* We should never be non-overlapped and get to this point */
                ASSERT(SendReq->AfdFlags & AFD_OVERLAPPED);
@@ -231,7 +271,7 @@ static NTSTATUS NTAPI SendComplete
     }
     else
     {
-        FCB->PollState &= ~AFD_EVENT_SEND;
+        PollClear( FCB, AFD_EVENT_SEND );
     }
 
 
@@ -257,6 +297,135 @@ static NTSTATUS NTAPI SendComplete
     return STATUS_SUCCESS;
 }
 
+static NTSTATUS NTAPI ZeroCopySendComplete
+( PDEVICE_OBJECT DeviceObject,
+  PIRP Irp,
+  PVOID Context ) {
+    NTSTATUS Status = Irp->IoStatus.Status;
+    PAFD_FCB FCB = (PAFD_FCB)Context;
+    PIRP NextIrp;
+    PIO_STACK_LOCATION NextIrpSp;
+    PAFD_SEND_INFO SendReq;
+    UINT BytesSent, SendLength, i;
+    BOOLEAN Cancelled;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    AFD_DbgPrint(MID_TRACE,("Called, status %x, %u bytes used\n",
+                            Irp->IoStatus.Status,
+                            Irp->IoStatus.Information));
+
+    if( !SocketAcquireStateLock( FCB ) )
+        return STATUS_FILE_CLOSED;
+
+    ASSERT(FCB->SendIrp.InFlightRequest == Irp);
+    FCB->SendIrp.InFlightRequest = NULL;
+    /* Request is not in flight any longer */
+
+    if( FCB->State == SOCKET_STATE_CLOSED ) {
+        /* Cleanup our IRP queue because the FCB is being destroyed */
+        FailPendingSends( FCB, STATUS_FILE_CLOSED );
+
+        RetryDisconnectCompletion(FCB);
+
+        SocketStateUnlock( FCB );
+        return STATUS_FILE_CLOSED;
+    }
+
+    /* The user-mode IRP was cancelled while the transport had its pages.
+     * Whatever the transport took is in the stream, so a send we cancelled
+     * ourselves is not an error for the sends queued behind it */
+    Cancelled = FCB->ZeroCopySendCancelled;
+    FCB->ZeroCopySendCancelled = FALSE;
+    if( Cancelled && Status == STATUS_CANCELLED )
+        Status = STATUS_SUCCESS;
+
+    if( !NT_SUCCESS(Status) ) {
+        /* Complete all following send IRPs with error */
+        FailPendingSends( FCB, Status );
+
+        RetryDisconnectCompletion(FCB);
+
+        SocketStateUnlock( FCB );
+
+        return STATUS_SUCCESS;
+    }
+
+    NextIrp = FCB->ZeroCopySendIrp;
+    if( NextIrp ) {
+        ASSERT(FCB->PendingIrpList[FUNCTION_SEND].Flink == &NextIrp->Tail.Overlay.ListEntry);
+
+        NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
+        SendReq = GetLockedData(NextIrp, NextIrpSp);
+
+        BytesSent = (UINT)(ULONG_PTR)NextIrp->Tail.Overlay.DriverContext[3] +
+                    (UINT)Irp->IoStatus.Information;
+        NextIrp->Tail.Overlay.DriverContext[3] = (PVOID)(ULONG_PTR)BytesSent;
+
+        SendLength = 0;
+        for( i = 0; i < SendReq->BufferCount; i++ )
+            SendLength += SendReq->BufferArray[i].len;
+
+        if( BytesSent < SendLength && !Cancelled ) {
+            /* Keep going with the rest of the caller's data */
+            Status = StartZeroCopySend( FCB, NextIrp );
+            if( Status != STATUS_PENDING ) {
+                FailPendingSends( FCB, Status );
+                RetryDisconnectCompletion(FCB);
+            }
+
+            SocketStateUnlock( FCB );
+
+            return STATUS_SUCCESS;
+        }
+
+        FCB->ZeroCopySendIrp = NULL;
+        RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]);
+
+        NextIrp->IoStatus.Status = (BytesSent < SendLength) ? STATUS_CANCELLED : STATUS_SUCCESS;
+        NextIrp->IoStatus.Information = BytesSent;
+
+        (void)IoSetCancelRoutine(NextIrp, NULL);
+
+        UnlockBuffers( SendReq->BufferArray,
+                       SendReq->BufferCount,
+                       FALSE );
+
+        if (NextIrp->MdlAddress) UnlockRequest(NextIrp, NextIrpSp);
+
+        IoCompleteRequest(NextIrp, IO_NETWORK_INCREMENT);
+    }
+
+    if (FCB->Send.Size - FCB->Send.BytesUsed != 0 && !FCB->SendClosed &&
+        IsListEmpty(&FCB->PendingIrpList[FUNCTION_SEND]))
+    {
+        FCB->PollState |= AFD_EVENT_SEND;
+        FCB->PollStatus[FD_WRITE_BIT] = STATUS_SUCCESS;
+        PollReeval( FCB->DeviceExt, FCB->FileObject );
+    }
+
+    /* Sends buffered behind the zero-copy one go out now */
+    if( FCB->Send.BytesUsed )
+    {
+        TdiSend( &FCB->SendIrp.InFlightRequest,
+                 FCB->Connection.Object,
+                 0,
+                 FCB->Send.Window,
+                 FCB->Send.BytesUsed,
+                 SendComplete,
+                 FCB );
+    }
+    else
+    {
+        /* Nothing is waiting so try to complete a pending disconnect */
+        RetryDisconnectCompletion(FCB);
+    }
+
+    SocketStateUnlock( FCB );
+
+    return STATUS_SUCCESS;
+}
+
 static IO_COMPLETION_ROUTINE PacketSocketSendComplete;
 static NTSTATUS NTAPI PacketSocketSendComplete
 ( PDEVICE_OBJECT DeviceObject,
@@ -374,7 +543,7 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         Status = TdiBuildConnectionInfo( &TargetAddress, FCB->RemoteAddress );
 
         if( NT_SUCCESS(Status) ) {
-            FCB->PollState &= ~AFD_EVENT_SEND;
+            PollClear( FCB, AFD_EVENT_SEND );
 
             Status = QueueUserModeIrp(FCB, Irp, FUNCTION_SEND);
             if (Status == STATUS_PENDING)
@@ -472,20 +641,57 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         SendLength += SendReq->BufferArray[i].len;
     }
 
+    /* Large blocking sends with nothing queued ahead of them are handed to
+     * the transport straight from the caller's locked pages */
+    if (SendLength >= AFD_ZERO_COPY_SEND_THRESHOLD * SendReq->BufferCount &&
+        !FCB->Send.BytesUsed && !FCB->SendIrp.InFlightRequest &&
+        IsListEmpty(&FCB->PendingIrpList[FUNCTION_SEND]) &&
+        !((SendReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking)))
+    {
+        AFD_DbgPrint(MID_TRACE,("Zero-copy send of %u bytes\n", SendLength));
+        FCB->ZeroCopySends++;
+
+        /* DriverContext[3] counts the bytes the transport has taken */
+        Irp->Tail.Overlay.DriverContext[3] = (PVOID)0;
+
+        Status = QueueUserModeIrp(FCB, Irp, FUNCTION_SEND);
+        if (Status == STATUS_PENDING)
+        {
+            FCB->ZeroCopySendIrp = Irp;
+
+            Status = StartZeroCopySend(FCB, Irp);
+            if (Status != STATUS_PENDING)
+            {
+                FCB->ZeroCopySendIrp = NULL;
+                NT_VERIFY(RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]) == &Irp->Tail.Overlay.ListEntry);
+                Irp->IoStatus.Status = Status;
+                Irp->IoStatus.Information = 0;
+                (void)IoSetCancelRoutine(Irp, NULL);
+                UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, FALSE);
+                UnlockRequest(Irp, IoGetCurrentIrpStackLocation(Irp));
+                IoCompleteRequest(Irp, IO_NETWORK_INCREMENT);
+            }
+        }
+
+        SocketStateUnlock(FCB);
+
+        return STATUS_PENDING;
+    }
+
     /* Make sure we've got the space */
     if (SendLength > SpaceAvail)
     {
         /* Blocking sockets have to wait here */
         if (SendLength <= FCB->Send.Size && !((SendReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking)))
         {
-            FCB->PollState &= ~AFD_EVENT_SEND;
+            PollClear( FCB, AFD_EVENT_SEND );
             return LeaveIrpUntilLater(FCB, Irp, FUNCTION_SEND);
         }
 
         /* Check if we can send anything */
         if (SpaceAvail == 0)
         {
-            FCB->PollState &= ~AFD_EVENT_SEND;
+            PollClear( FCB, AFD_EVENT_SEND );
 
             /* Non-overlapped sockets will fail if we can send nothing */
             if (!(SendReq->AfdFlags & AFD_OVERLAPPED))
@@ -537,7 +743,7 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
     }
     else
     {
-        FCB->PollState &= ~AFD_EVENT_SEND;
+        PollClear( FCB, AFD_EVENT_SEND );
     }
 
     /* We use the IRP tail for some temporary storage here */
@@ -640,7 +846,7 @@ AfdPacketSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
     /* Check the size of the Address given ... */
 
     if( NT_SUCCESS(Status) ) {
-        FCB->PollState &= ~AFD_EVENT_SEND;
+        PollClear( FCB, AFD_EVENT_SEND );
 
         Status = QueueUserModeIrp(FCB, Irp, FUNCTION_SEND);
         if (Status == STATUS_PENDING)
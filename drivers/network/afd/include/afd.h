@@ -13,8 +13,10 @@
 
 #include <ntifs.h>
 #include <ndk/obtypes.h>
+#include <ndk/iofuncs.h>
 #include <tdi.h>
 #include <tcpioctl.h>
+#include <tcpip_undoc.h>
 #define _WINBASE_
 #define _WINDOWS_H
 #define _INC_WINDOWS
@@ -52,6 +54,7 @@
 #define TAG_AFD_SNMP_ADDRESS_INFO          'asfA'
 #define TAG_AFD_TDI_CONNECTION_INFORMATION 'cTfA'
 #define TAG_AFD_WSA_BUFFER                 'bWfA'
+#define TAG_AFD_SET_INFO                   'isfA'
 
 typedef struct IPADDR_ENTRY {
 	ULONG  Addr;
@@ -96,6 +99,10 @@ typedef struct IPADDR_ENTRY {
 					   * for ancillary data on packet
 					   * requests. */
 
+#define AFD_ZERO_COPY_SEND_THRESHOLD    0x4000 /* Average buffer size at
+                                                * which blocking stream sends
+                                                * skip the send window */
+
 /* XXX This is a hack we should clean up later
  * We do this in order to get some storage for the locked handle table
  * Maybe I'll use some tail item in the irp instead */
@@ -176,10 +183,19 @@ typedef struct _AFD_FCB {
     AFD_TDI_OBJECT AddressFile, Connection;
     AFD_IN_FLIGHT_REQUEST ConnectIrp, ListenIrp, ReceiveIrp, SendIrp, DisconnectIrp;
     AFD_DATA_WINDOW Send, Recv;
+    ULONG TdiReceiveWindowSize, TdiSendBufferSize; /* SO_RCVBUF/SO_SNDBUF for the transport, 0 if unset */
+    PIRP ZeroCopySendIrp;
+    BOOLEAN ZeroCopySendCancelled;
+    ULONG ZeroCopySends; /* Sends that took the zero-copy path, for the tests */
     KMUTEX Mutex;
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
     DWORD EventSelectDisabled;
+    DWORD PollSetEvents;
+    DWORD PollSetFlags;
+    PVOID PollSetContext;
+    BOOLEAN PollSetArmed;
+    DWORD PollSetReported; /* Edge triggered events posted and not consumed since */
     UNICODE_STRING TdiDeviceName;
     PVOID Context;
     DWORD PollState;
@@ -258,6 +274,9 @@ NTSTATUS NTAPI
 AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 	    PIO_STACK_LOCATION IrpSp );
 
+VOID
+AfdApplyTransportBufferSizes( PAFD_FCB FCB );
+
 NTSTATUS NTAPI
 AfdGetSockName( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 PIO_STACK_LOCATION IrpSp );
@@ -328,7 +347,11 @@ AfdEventSelect( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 NTSTATUS NTAPI
 AfdEnumEvents( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 	       PIO_STACK_LOCATION IrpSp );
+NTSTATUS NTAPI
+AfdPollRegister( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+		 PIO_STACK_LOCATION IrpSp );
 VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceObject, PFILE_OBJECT FileObject );
+VOID PollClear( PAFD_FCB FCB, DWORD Events );
 VOID KillSelectsForFCB( PAFD_DEVICE_EXTENSION DeviceExt,
                         PFILE_OBJECT FileObject, BOOLEAN ExclusiveOnly );
 VOID ZeroEvents( PAFD_HANDLE HandleArray,
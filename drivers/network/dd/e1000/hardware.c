@@ -227,6 +227,29 @@ NICRecognizeHardware(
     {
         if (SupportedDevices[n] == Adapter->DeviceID)
         {
+            /* The 82542 has no offloads, the 82543 lacks TCP segmentation,
+             * interrupt throttling starts with the 82540 */
+            switch (Adapter->DeviceID)
+            {
+                case 0x1000:
+                    Adapter->Features = 0;
+                    break;
+                case 0x1001:
+                case 0x1004:
+                    Adapter->Features = E1000_FEATURE_CHECKSUM;
+                    break;
+                case 0x1008:
+                case 0x1009:
+                case 0x100C:
+                case 0x100D:
+                    Adapter->Features = E1000_FEATURE_CHECKSUM | E1000_FEATURE_LARGE_SEND;
+                    break;
+                default:
+                    Adapter->Features = E1000_FEATURE_CHECKSUM | E1000_FEATURE_LARGE_SEND |
+                                        E1000_FEATURE_THROTTLING;
+                    break;
+            }
+
             return TRUE;
         }
     }
@@ -236,6 +259,89 @@ NICRecognizeHardware(
     return FALSE;
 }
 
+static
+ULONG
+NICQueryInteger(
+    _In_ NDIS_HANDLE ConfigurationHandle,
+    _In_ PCWSTR EntryName,
+    _In_ ULONG DefaultValue,
+    _In_ ULONG Minimum,
+    _In_ ULONG Maximum)
+{
+    NDIS_STATUS Status;
+    NDIS_STRING Keyword;
+    PNDIS_CONFIGURATION_PARAMETER ConfigurationParameter;
+
+    NdisInitUnicodeString(&Keyword, EntryName);
+    NdisReadConfiguration(&Status,
+                          &ConfigurationParameter,
+                          ConfigurationHandle,
+                          &Keyword,
+                          NdisParameterInteger);
+    if (Status != NDIS_STATUS_SUCCESS)
+        return DefaultValue;
+
+    if (ConfigurationParameter->ParameterData.IntegerData < Minimum ||
+        ConfigurationParameter->ParameterData.IntegerData > Maximum)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("'%S' value out of range\n", EntryName));
+        return DefaultValue;
+    }
+
+    return ConfigurationParameter->ParameterData.IntegerData;
+}
+
+VOID
+NTAPI
+NICReadConfiguration(
+    IN PE1000_ADAPTER Adapter,
+    IN NDIS_HANDLE WrapperConfigurationContext)
+{
+    NDIS_STATUS Status;
+    NDIS_HANDLE ConfigurationHandle;
+    ULONG MaximumDescriptors;
+
+    /* The 82544 and newer (the ones with TCP segmentation) take the larger rings */
+    MaximumDescriptors = (Adapter->Features & E1000_FEATURE_LARGE_SEND) ?
+                         MAX_DESCRIPTORS : MAX_DESCRIPTORS_82543;
+
+    Adapter->TransmitDescriptorCount = NUM_TRANSMIT_DESCRIPTORS;
+    Adapter->ReceiveDescriptorCount = NUM_RECEIVE_DESCRIPTORS;
+    Adapter->InterruptThrottleRate = MAX_INTS_PER_SEC;
+
+    NdisOpenConfiguration(&Status, &ConfigurationHandle, WrapperConfigurationContext);
+    if (Status == NDIS_STATUS_SUCCESS)
+    {
+        Adapter->TransmitDescriptorCount = NICQueryInteger(ConfigurationHandle,
+                                                           L"TransmitBuffers",
+                                                           NUM_TRANSMIT_DESCRIPTORS,
+                                                           MIN_DESCRIPTORS,
+                                                           MaximumDescriptors);
+        Adapter->ReceiveDescriptorCount = NICQueryInteger(ConfigurationHandle,
+                                                          L"ReceiveBuffers",
+                                                          NUM_RECEIVE_DESCRIPTORS,
+                                                          MIN_DESCRIPTORS,
+                                                          MaximumDescriptors);
+
+        /* Zero turns throttling off */
+        Adapter->InterruptThrottleRate = NICQueryInteger(ConfigurationHandle,
+                                                         L"InterruptThrottleRate",
+                                                         MAX_INTS_PER_SEC,
+                                                         0,
+                                                         MAX_ITR_INTS_PER_SEC);
+
+        NdisCloseConfiguration(ConfigurationHandle);
+    }
+
+    Adapter->TransmitDescriptorCount &= ~(DESCRIPTOR_COUNT_ALIGNMENT - 1);
+    Adapter->ReceiveDescriptorCount &= ~(DESCRIPTOR_COUNT_ALIGNMENT - 1);
+
+    NDIS_DbgPrint(MID_TRACE, ("TX descriptors: %lu, RX descriptors: %lu, ITR: %lu/s\n",
+                              Adapter->TransmitDescriptorCount,
+                              Adapter->ReceiveDescriptorCount,
+                              Adapter->InterruptThrottleRate));
+}
+
 NDIS_STATUS
 NTAPI
 NICInitializeAdapterResources(
@@ -330,9 +436,31 @@ NICAllocateIoResources(
                              Adapter->IoAddress,
                              Adapter->IoLength);
 
+    /* The rings are sized from the registry */
+    Status = NdisAllocateMemoryWithTag((PVOID*)&Adapter->TransmitPackets,
+                                       sizeof(PNDIS_PACKET) * Adapter->TransmitDescriptorCount,
+                                       E1000_TAG);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate transmit packet array
+"));
+        return NDIS_STATUS_RESOURCES;
+    }
+    NdisZeroMemory(Adapter->TransmitPackets, sizeof(PNDIS_PACKET) * Adapter->TransmitDescriptorCount);
+
+    Status = NdisAllocateMemoryWithTag((PVOID*)&Adapter->ReceivePackets,
+                                       sizeof(PNDIS_PACKET) * Adapter->ReceiveDescriptorCount,
+                                       E1000_TAG);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet array
+"));
+        return NDIS_STATUS_RESOURCES;
+    }
+    NdisZeroMemory(Adapter->ReceivePackets, sizeof(PNDIS_PACKET) * Adapter->ReceiveDescriptorCount);
 
     NdisMAllocateSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * NUM_TRANSMIT_DESCRIPTORS,
+                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * Adapter->TransmitDescriptorCount,
                               FALSE,
                               (PVOID*)&Adapter->TransmitDescriptors,
                               &Adapter->TransmitDescriptorsPa);
@@ -342,7 +470,7 @@ NICAllocateIoResources(
         return NDIS_STATUS_RESOURCES;
     }
 
-    for (n = 0; n < NUM_TRANSMIT_DESCRIPTORS; ++n)
+    for (n = 0; n < Adapter->TransmitDescriptorCount; ++n)
     {
         PE1000_TRANSMIT_DESCRIPTOR Descriptor = Adapter->TransmitDescriptors + n;
         Descriptor->Address = 0;
@@ -350,7 +478,7 @@ NICAllocateIoResources(
     }
 
     NdisMAllocateSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_RECEIVE_DESCRIPTOR) * NUM_RECEIVE_DESCRIPTORS,
+                              sizeof(E1000_RECEIVE_DESCRIPTOR) * Adapter->ReceiveDescriptorCount,
                               FALSE,
                               (PVOID*)&Adapter->ReceiveDescriptors,
                               &Adapter->ReceiveDescriptorsPa);
@@ -365,7 +493,7 @@ NICAllocateIoResources(
     Adapter->ReceiveBufferEntrySize = AllocationSize;
 
     NdisMAllocateSharedMemory(Adapter->AdapterHandle,
-                              Adapter->ReceiveBufferEntrySize * NUM_RECEIVE_DESCRIPTORS,
+                              Adapter->ReceiveBufferEntrySize * Adapter->ReceiveDescriptorCount,
                               FALSE,
                               (PVOID*)&Adapter->ReceiveBuffer,
                               &Adapter->ReceiveBufferPa);
@@ -376,7 +504,7 @@ NICAllocateIoResources(
         return NDIS_STATUS_RESOURCES;
     }
 
-    for (n = 0; n < NUM_RECEIVE_DESCRIPTORS; ++n)
+    for (n = 0; n < Adapter->ReceiveDescriptorCount; ++n)
     {
         PE1000_RECEIVE_DESCRIPTOR Descriptor = Adapter->ReceiveDescriptors + n;
 
@@ -384,6 +512,55 @@ NICAllocateIoResources(
         Descriptor->Address = Adapter->ReceiveBufferPa.QuadPart + n * Adapter->ReceiveBufferEntrySize;
     }
 
+    NdisAllocatePacketPool(&Status,
+                           &Adapter->ReceivePacketPool,
+                           Adapter->ReceiveDescriptorCount,
+                           PROTOCOL_RESERVED_SIZE_IN_PACKET);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet pool\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    NdisAllocateBufferPool(&Status,
+                           &Adapter->ReceiveBufferPool,
+                           Adapter->ReceiveDescriptorCount);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive buffer pool\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    for (n = 0; n < Adapter->ReceiveDescriptorCount; ++n)
+    {
+        PNDIS_PACKET Packet;
+        PNDIS_BUFFER Buffer;
+
+        NdisAllocatePacket(&Status, &Packet, Adapter->ReceivePacketPool);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet\n"));
+            return NDIS_STATUS_RESOURCES;
+        }
+
+        NdisAllocateBuffer(&Status,
+                           &Buffer,
+                           Adapter->ReceiveBufferPool,
+                           Adapter->ReceiveBuffer + n * Adapter->ReceiveBufferEntrySize,
+                           Adapter->ReceiveBufferEntrySize);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive buffer descriptor\n"));
+            NdisFreePacket(Packet);
+            return NDIS_STATUS_RESOURCES;
+        }
+
+        NdisChainBufferAtFront(Packet, Buffer);
+        NDIS_SET_PACKET_HEADER_SIZE(Packet, sizeof(ETH_HEADER));
+
+        Adapter->ReceivePackets[n] = Packet;
+    }
+
     return NDIS_STATUS_SUCCESS;
 }
 
@@ -433,6 +610,8 @@ NTAPI
 NICReleaseIoResources(
     IN PE1000_ADAPTER Adapter)
 {
+    UINT n;
+
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
     if (Adapter->ReceiveDescriptors != NULL)
@@ -445,7 +624,7 @@ NICReleaseIoResources(
         }
 
         NdisMFreeSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_RECEIVE_DESCRIPTOR) * NUM_RECEIVE_DESCRIPTORS,
+                              sizeof(E1000_RECEIVE_DESCRIPTOR) * Adapter->ReceiveDescriptorCount,
                               FALSE,
                               Adapter->ReceiveDescriptors,
                               Adapter->ReceiveDescriptorsPa);
@@ -453,10 +632,42 @@ NICReleaseIoResources(
         Adapter->ReceiveDescriptors = NULL;
     }
 
+    if (Adapter->ReceivePackets != NULL)
+    {
+        for (n = 0; n < Adapter->ReceiveDescriptorCount; ++n)
+        {
+            PNDIS_BUFFER Buffer;
+
+            if (Adapter->ReceivePackets[n] == NULL)
+                continue;
+
+            NdisUnchainBufferAtFront(Adapter->ReceivePackets[n], &Buffer);
+            if (Buffer != NULL)
+                NdisFreeBuffer(Buffer);
+
+            NdisFreePacket(Adapter->ReceivePackets[n]);
+        }
+
+        NdisFreeMemory(Adapter->ReceivePackets, sizeof(PNDIS_PACKET) * Adapter->ReceiveDescriptorCount, 0);
+        Adapter->ReceivePackets = NULL;
+    }
+
+    if (Adapter->ReceiveBufferPool != NULL)
+    {
+        NdisFreeBufferPool(Adapter->ReceiveBufferPool);
+        Adapter->ReceiveBufferPool = NULL;
+    }
+
+    if (Adapter->ReceivePacketPool != NULL)
+    {
+        NdisFreePacketPool(Adapter->ReceivePacketPool);
+        Adapter->ReceivePacketPool = NULL;
+    }
+
     if (Adapter->ReceiveBuffer != NULL)
     {
         NdisMFreeSharedMemory(Adapter->AdapterHandle,
-                              Adapter->ReceiveBufferEntrySize * NUM_RECEIVE_DESCRIPTORS,
+                              Adapter->ReceiveBufferEntrySize * Adapter->ReceiveDescriptorCount,
                               FALSE,
                               Adapter->ReceiveBuffer,
                               Adapter->ReceiveBufferPa);
@@ -476,7 +687,7 @@ NICReleaseIoResources(
         }
 
         NdisMFreeSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * NUM_TRANSMIT_DESCRIPTORS,
+                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * Adapter->TransmitDescriptorCount,
                               FALSE,
                               Adapter->TransmitDescriptors,
                               Adapter->TransmitDescriptorsPa);
@@ -484,7 +695,11 @@ NICReleaseIoResources(
         Adapter->TransmitDescriptors = NULL;
     }
 
-
+    if (Adapter->TransmitPackets != NULL)
+    {
+        NdisFreeMemory(Adapter->TransmitPackets, sizeof(PNDIS_PACKET) * Adapter->TransmitDescriptorCount, 0);
+        Adapter->TransmitPackets = NULL;
+    }
 
     if (Adapter->IoPort)
     {
@@ -587,13 +802,16 @@ NICEnableTxRx(
     E1000WriteUlong(Adapter, E1000_REG_TDBAL, Adapter->TransmitDescriptorsPa.LowPart);
 
     /* Transmit descriptor buffer size */
-    E1000WriteUlong(Adapter, E1000_REG_TDLEN, sizeof(E1000_TRANSMIT_DESCRIPTOR) * NUM_TRANSMIT_DESCRIPTORS);
+    E1000WriteUlong(Adapter, E1000_REG_TDLEN, sizeof(E1000_TRANSMIT_DESCRIPTOR) * Adapter->TransmitDescriptorCount);
 
     /* Transmit descriptor tail / head */
     E1000WriteUlong(Adapter, E1000_REG_TDH, 0);
     E1000WriteUlong(Adapter, E1000_REG_TDT, 0);
     Adapter->CurrentTxDesc = 0;
 
+    /* The NIC forgets the offload context */
+    Adapter->TxContextValid = FALSE;
+
     /* Set up interrupt timers */
     E1000WriteUlong(Adapter, E1000_REG_TADV, 96); // value is in 1.024 of usec
     E1000WriteUlong(Adapter, E1000_REG_TIDV, 16);
@@ -612,15 +830,28 @@ NICEnableTxRx(
     E1000WriteUlong(Adapter, E1000_REG_RDBAL, Adapter->ReceiveDescriptorsPa.LowPart);
 
     /* Receive descriptor buffer size */
-    E1000WriteUlong(Adapter, E1000_REG_RDLEN, sizeof(E1000_RECEIVE_DESCRIPTOR) * NUM_RECEIVE_DESCRIPTORS);
+    E1000WriteUlong(Adapter, E1000_REG_RDLEN, sizeof(E1000_RECEIVE_DESCRIPTOR) * Adapter->ReceiveDescriptorCount);
 
     /* Receive descriptor tail / head */
     E1000WriteUlong(Adapter, E1000_REG_RDH, 0);
-    E1000WriteUlong(Adapter, E1000_REG_RDT, NUM_RECEIVE_DESCRIPTORS - 1);
+    E1000WriteUlong(Adapter, E1000_REG_RDT, Adapter->ReceiveDescriptorCount - 1);
 
-    /* Set up interrupt timers */
-    E1000WriteUlong(Adapter, E1000_REG_RADV, 96);
-    E1000WriteUlong(Adapter, E1000_REG_RDTR, 16);
+    /* Set up interrupt timers. With throttling the ITR interval bounds the
+     * interrupt rate, so the receive timers would only add latency */
+    if ((Adapter->Features & E1000_FEATURE_THROTTLING) && Adapter->InterruptThrottleRate != 0)
+    {
+        E1000WriteUlong(Adapter, E1000_REG_ITR, E1000_ITR_INTERVAL(Adapter->InterruptThrottleRate));
+        E1000WriteUlong(Adapter, E1000_REG_RADV, 0);
+        E1000WriteUlong(Adapter, E1000_REG_RDTR, 0);
+    }
+    else
+    {
+        if (Adapter->Features & E1000_FEATURE_THROTTLING)
+            E1000WriteUlong(Adapter, E1000_REG_ITR, 0);
+
+        E1000WriteUlong(Adapter, E1000_REG_RADV, 96);
+        E1000WriteUlong(Adapter, E1000_REG_RDTR, 16);
+    }
 
     /* Some defaults */
     Value = E1000_RCTL_SECRC | E1000_RCTL_EN;
@@ -631,6 +862,8 @@ NICEnableTxRx(
     /* Add our current packet filter */
     Value |= PacketFilterToMask(Adapter->PacketFilter);
 
+    NICApplyReceiveChecksum(Adapter);
+
     E1000WriteUlong(Adapter, E1000_REG_RCTL, Value);
 
     return NDIS_STATUS_SUCCESS;
@@ -735,6 +968,27 @@ NICApplyPacketFilter(
     return NDIS_STATUS_SUCCESS;
 }
 
+VOID
+NTAPI
+NICApplyReceiveChecksum(
+    IN PE1000_ADAPTER Adapter)
+{
+    ULONG Value;
+
+    if (!(Adapter->Features & E1000_FEATURE_CHECKSUM))
+        return;
+
+    E1000ReadUlong(Adapter, E1000_REG_RXCSUM, &Value);
+
+    Value &= ~(E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL);
+    if (Adapter->Offload.ReceiveIpChecksum)
+        Value |= E1000_RXCSUM_IPOFL;
+    if (Adapter->Offload.ReceiveTcpChecksum || Adapter->Offload.ReceiveUdpChecksum)
+        Value |= E1000_RXCSUM_TUOFL;
+
+    E1000WriteUlong(Adapter, E1000_REG_RXCSUM, Value);
+}
+
 VOID
 NTAPI
 NICUpdateLinkStatus(
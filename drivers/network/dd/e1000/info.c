@@ -37,6 +37,7 @@ static NDIS_OID SupportedOidList[] =
     OID_802_3_PERMANENT_ADDRESS,
     OID_802_3_CURRENT_ADDRESS,
     OID_802_3_MAXIMUM_LIST_SIZE,
+    OID_TCP_TASK_OFFLOAD,
 
     /* Statistics */
     OID_GEN_XMIT_OK,
@@ -68,6 +69,202 @@ NICFillPowerManagementCapabilities(
     return NDIS_STATUS_NOT_SUPPORTED;
 }
 
+static
+NDIS_STATUS
+NICGetTcpTaskOffload(
+    _In_ PE1000_ADAPTER Adapter,
+    _Inout_ PNDIS_TASK_OFFLOAD_HEADER TaskOffloadHeader,
+    _In_ ULONG InformationBufferLength,
+    _Out_ PULONG BytesWritten,
+    _Out_ PULONG BytesNeeded)
+{
+    ULONG InfoLength;
+    PNDIS_TASK_OFFLOAD TaskOffload;
+    PNDIS_TASK_TCP_IP_CHECKSUM ChecksumTask;
+
+    *BytesWritten = 0;
+    *BytesNeeded = 0;
+
+    if (!(Adapter->Features & E1000_FEATURE_CHECKSUM))
+    {
+        return NDIS_STATUS_NOT_SUPPORTED;
+    }
+
+    InfoLength = sizeof(NDIS_TASK_OFFLOAD_HEADER) +
+                 FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+    if (Adapter->Features & E1000_FEATURE_LARGE_SEND)
+    {
+        InfoLength += FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_LARGE_SEND);
+    }
+
+    if (InformationBufferLength < InfoLength)
+    {
+        *BytesNeeded = InfoLength;
+        return NDIS_STATUS_BUFFER_TOO_SHORT;
+    }
+
+    if (TaskOffloadHeader->Version != NDIS_TASK_OFFLOAD_VERSION)
+    {
+        return NDIS_STATUS_NOT_SUPPORTED;
+    }
+
+    if ((TaskOffloadHeader->EncapsulationFormat.Encapsulation != IEEE_802_3_Encapsulation) &&
+        (TaskOffloadHeader->EncapsulationFormat.Encapsulation != UNSPECIFIED_Encapsulation ||
+         TaskOffloadHeader->EncapsulationFormat.EncapsulationHeaderSize != sizeof(ETH_HEADER)))
+    {
+        return NDIS_STATUS_NOT_SUPPORTED;
+    }
+
+    TaskOffloadHeader->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    TaskOffload = (PNDIS_TASK_OFFLOAD)(TaskOffloadHeader + 1);
+
+    TaskOffload->Size = sizeof(NDIS_TASK_OFFLOAD);
+    TaskOffload->Version = NDIS_TASK_OFFLOAD_VERSION;
+    TaskOffload->Task = TcpIpChecksumNdisTask;
+    TaskOffload->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+    TaskOffload->OffsetNextTask = 0;
+
+    ChecksumTask = (PNDIS_TASK_TCP_IP_CHECKSUM)TaskOffload->TaskBuffer;
+    NdisZeroMemory(ChecksumTask, sizeof(*ChecksumTask));
+
+    ChecksumTask->V4Transmit.IpOptionsSupported = 1;
+    ChecksumTask->V4Transmit.TcpOptionsSupported = 1;
+    ChecksumTask->V4Transmit.TcpChecksum = 1;
+    ChecksumTask->V4Transmit.UdpChecksum = 1;
+    ChecksumTask->V4Transmit.IpChecksum = 1;
+
+    ChecksumTask->V4Receive.IpOptionsSupported = 1;
+    ChecksumTask->V4Receive.TcpOptionsSupported = 1;
+    ChecksumTask->V4Receive.TcpChecksum = 1;
+    ChecksumTask->V4Receive.UdpChecksum = 1;
+    ChecksumTask->V4Receive.IpChecksum = 1;
+
+    if (Adapter->Features & E1000_FEATURE_LARGE_SEND)
+    {
+        PNDIS_TASK_TCP_LARGE_SEND LargeSendTask;
+
+        TaskOffload->OffsetNextTask = FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+                                      sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+        TaskOffload = (PNDIS_TASK_OFFLOAD)(ChecksumTask + 1);
+
+        TaskOffload->Size = sizeof(NDIS_TASK_OFFLOAD);
+        TaskOffload->Version = NDIS_TASK_OFFLOAD_VERSION;
+        TaskOffload->Task = TcpLargeSendNdisTask;
+        TaskOffload->TaskBufferLength = sizeof(NDIS_TASK_TCP_LARGE_SEND);
+        TaskOffload->OffsetNextTask = 0;
+
+        LargeSendTask = (PNDIS_TASK_TCP_LARGE_SEND)TaskOffload->TaskBuffer;
+        LargeSendTask->Version = NDIS_TASK_TCP_LARGE_SEND_V0;
+        LargeSendTask->MaxOffLoadSize = MAXIMUM_LSO_SIZE;
+        LargeSendTask->MinSegmentCount = MINIMUM_LSO_SEGMENT_COUNT;
+        LargeSendTask->TcpOptions = TRUE;
+        LargeSendTask->IpOptions = TRUE;
+    }
+
+    *BytesWritten = InfoLength;
+
+    return NDIS_STATUS_SUCCESS;
+}
+
+static
+NDIS_STATUS
+NICSetTcpTaskOffload(
+    _Inout_ PE1000_ADAPTER Adapter,
+    _In_ PNDIS_TASK_OFFLOAD_HEADER TaskOffloadHeader,
+    _In_ ULONG InformationBufferLength)
+{
+    E1000_OFFLOAD Offload;
+    PNDIS_TASK_OFFLOAD TaskOffload;
+    ULONG Offset;
+
+    if (TaskOffloadHeader->Version != NDIS_TASK_OFFLOAD_VERSION)
+    {
+        return NDIS_STATUS_NOT_SUPPORTED;
+    }
+
+    if ((TaskOffloadHeader->EncapsulationFormat.Encapsulation != IEEE_802_3_Encapsulation) &&
+        (TaskOffloadHeader->EncapsulationFormat.Encapsulation != UNSPECIFIED_Encapsulation ||
+         TaskOffloadHeader->EncapsulationFormat.EncapsulationHeaderSize != sizeof(ETH_HEADER)))
+    {
+        return NDIS_STATUS_NOT_SUPPORTED;
+    }
+
+    /* Tasks missing from the list are turned off */
+    Offload.Value = 0;
+
+    TaskOffload = (PNDIS_TASK_OFFLOAD)TaskOffloadHeader;
+    Offset = TaskOffloadHeader->OffsetFirstTask;
+
+    while (Offset)
+    {
+        TaskOffload = (PNDIS_TASK_OFFLOAD)((PUCHAR)TaskOffload + Offset);
+
+        if ((PUCHAR)TaskOffload->TaskBuffer + TaskOffload->TaskBufferLength >
+            (PUCHAR)TaskOffloadHeader + InformationBufferLength)
+        {
+            return NDIS_STATUS_INVALID_LENGTH;
+        }
+
+        switch (TaskOffload->Task)
+        {
+            case TcpIpChecksumNdisTask:
+            {
+                PNDIS_TASK_TCP_IP_CHECKSUM Task;
+
+                if (!(Adapter->Features & E1000_FEATURE_CHECKSUM) ||
+                    TaskOffload->TaskBufferLength < sizeof(NDIS_TASK_TCP_IP_CHECKSUM))
+                {
+                    return NDIS_STATUS_NOT_SUPPORTED;
+                }
+
+                Task = (PNDIS_TASK_TCP_IP_CHECKSUM)TaskOffload->TaskBuffer;
+
+                Offload.SendTcpChecksum = Task->V4Transmit.TcpChecksum;
+                Offload.SendUdpChecksum = Task->V4Transmit.UdpChecksum;
+                Offload.SendIpChecksum = Task->V4Transmit.IpChecksum;
+
+                Offload.ReceiveTcpChecksum = Task->V4Receive.TcpChecksum;
+                Offload.ReceiveUdpChecksum = Task->V4Receive.UdpChecksum;
+                Offload.ReceiveIpChecksum = Task->V4Receive.IpChecksum;
+                break;
+            }
+
+            case TcpLargeSendNdisTask:
+            {
+                PNDIS_TASK_TCP_LARGE_SEND Task;
+
+                if (!(Adapter->Features & E1000_FEATURE_LARGE_SEND) ||
+                    TaskOffload->TaskBufferLength < sizeof(NDIS_TASK_TCP_LARGE_SEND))
+                {
+                    return NDIS_STATUS_NOT_SUPPORTED;
+                }
+
+                Task = (PNDIS_TASK_TCP_LARGE_SEND)TaskOffload->TaskBuffer;
+
+                if (Task->MaxOffLoadSize > MAXIMUM_LSO_SIZE ||
+                    Task->MinSegmentCount < MINIMUM_LSO_SEGMENT_COUNT)
+                {
+                    return NDIS_STATUS_NOT_SUPPORTED;
+                }
+
+                Offload.LargeSend = 1;
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        Offset = TaskOffload->OffsetNextTask;
+    }
+
+    Adapter->Offload = Offload;
+
+    NICApplyReceiveChecksum(Adapter);
+
+    return NDIS_STATUS_SUCCESS;
+}
+
 NDIS_STATUS
 NTAPI
 MiniportQueryInformation(
@@ -231,6 +428,22 @@ MiniportQueryInformation(
         return NDIS_STATUS_SUCCESS;
     }
 
+    case OID_TCP_TASK_OFFLOAD:
+    {
+        if (InformationBufferLength < sizeof(NDIS_TASK_OFFLOAD_HEADER))
+        {
+            *BytesWritten = 0;
+            *BytesNeeded = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+            return NDIS_STATUS_BUFFER_TOO_SHORT;
+        }
+
+        return NICGetTcpTaskOffload(Adapter,
+                                    InformationBuffer,
+                                    InformationBufferLength,
+                                    BytesWritten,
+                                    BytesNeeded);
+    }
+
     case OID_PNP_CAPABILITIES:
     {
         copyLength = sizeof(NDIS_PNP_CAPABILITIES);
@@ -376,6 +589,23 @@ MiniportSetInformation(
         NICUpdateMulticastList(Adapter);
         break;
 
+    case OID_TCP_TASK_OFFLOAD:
+        if (InformationBufferLength < sizeof(NDIS_TASK_OFFLOAD_HEADER))
+        {
+            *BytesRead = 0;
+            *BytesNeeded = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+            status = NDIS_STATUS_INVALID_LENGTH;
+            break;
+        }
+
+        status = NICSetTcpTaskOffload(Adapter, InformationBuffer, InformationBufferLength);
+        if (status != NDIS_STATUS_SUCCESS)
+        {
+            *BytesRead = 0;
+            *BytesNeeded = 0;
+        }
+        break;
+
     default:
         NDIS_DbgPrint(MIN_TRACE, ("Unknown OID 0x%x(%s)\n", Oid, Oid2Str(Oid)));
         status = NDIS_STATUS_NOT_SUPPORTED;
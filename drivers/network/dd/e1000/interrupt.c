@@ -11,6 +11,53 @@
 
 #include <debug.h>
 
+static
+ULONG
+NICGetReceiveChecksumInfo(
+    _In_ PE1000_ADAPTER Adapter,
+    _In_ volatile PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptor,
+    _In_ PETH_HEADER EthHeader)
+{
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    UCHAR Protocol;
+
+    ChecksumInfo.Value = 0;
+
+    if (ReceiveDescriptor->Status & E1000_RDESC_STATUS_IXSM)
+        return 0;
+
+    if ((ReceiveDescriptor->Status & E1000_RDESC_STATUS_IPCS) && Adapter->Offload.ReceiveIpChecksum)
+    {
+        if (ReceiveDescriptor->Errors & E1000_RDESC_ERR_IPE)
+            ChecksumInfo.Receive.NdisPacketIpChecksumFailed = 1;
+        else
+            ChecksumInfo.Receive.NdisPacketIpChecksumSucceeded = 1;
+    }
+
+    if (ReceiveDescriptor->Status & E1000_RDESC_STATUS_TCPCS)
+    {
+        /* The NIC reports TCP and UDP alike, tell them apart by the IPv4 protocol */
+        Protocol = ((PUCHAR)(EthHeader + 1))[9];
+
+        if (Protocol == IP_PROTOCOL_TCP && Adapter->Offload.ReceiveTcpChecksum)
+        {
+            if (ReceiveDescriptor->Errors & E1000_RDESC_ERR_TCPE)
+                ChecksumInfo.Receive.NdisPacketTcpChecksumFailed = 1;
+            else
+                ChecksumInfo.Receive.NdisPacketTcpChecksumSucceeded = 1;
+        }
+        else if (Protocol == IP_PROTOCOL_UDP && Adapter->Offload.ReceiveUdpChecksum)
+        {
+            if (ReceiveDescriptor->Errors & E1000_RDESC_ERR_TCPE)
+                ChecksumInfo.Receive.NdisPacketUdpChecksumFailed = 1;
+            else
+                ChecksumInfo.Receive.NdisPacketUdpChecksumSucceeded = 1;
+        }
+    }
+
+    return ChecksumInfo.Value;
+}
+
 VOID
 NTAPI
 MiniportISR(
@@ -76,76 +123,112 @@ MiniportHandleInterrupt(
     {
         volatile PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptor;
         PETH_HEADER EthHeader;
-        ULONG BufferOffset;
+        PNDIS_PACKET Packets[RECEIVE_BATCH_SIZE];
+        ULONG BufferOffset, NumDescriptors, NumPackets, i;
         BOOLEAN bGotAny = FALSE;
         ULONG RxDescHead, RxDescTail, CurrRxDesc;
 
         /* Clear out these interrupts */
         InterruptPending &= ~(E1000_IMS_RXDMT0 | E1000_IMS_RXT0);
 
-        E1000ReadUlong(Adapter, E1000_REG_RDH, &RxDescHead);
         E1000ReadUlong(Adapter, E1000_REG_RDT, &RxDescTail);
 
-        while (((RxDescTail + 1) % NUM_RECEIVE_DESCRIPTORS) != RxDescHead)
+        /* Hand the packets to NDIS in batches, a single indication per batch */
+        do
         {
-            CurrRxDesc = (RxDescTail + 1) % NUM_RECEIVE_DESCRIPTORS;
-            BufferOffset = CurrRxDesc * Adapter->ReceiveBufferEntrySize;
-            ReceiveDescriptor = Adapter->ReceiveDescriptors + CurrRxDesc;
+            NumDescriptors = 0;
+            NumPackets = 0;
+
+            E1000ReadUlong(Adapter, E1000_REG_RDH, &RxDescHead);
 
-            /* Check if the hardware have released this descriptor (DD - Descriptor Done) */
-            if (!(ReceiveDescriptor->Status & E1000_RDESC_STATUS_DD))
+            CurrRxDesc = RxDescTail;
+            while (NumDescriptors < RECEIVE_BATCH_SIZE &&
+                   ((CurrRxDesc + 1) % Adapter->ReceiveDescriptorCount) != RxDescHead)
             {
-                /* No need to check descriptors after the first unfinished one */
-                break;
-            }
+                CurrRxDesc = (CurrRxDesc + 1) % Adapter->ReceiveDescriptorCount;
+                BufferOffset = CurrRxDesc * Adapter->ReceiveBufferEntrySize;
+                ReceiveDescriptor = Adapter->ReceiveDescriptors + CurrRxDesc;
 
-            /* Ignoring these flags for now */
-            ReceiveDescriptor->Status &= ~(E1000_RDESC_STATUS_IXSM | E1000_RDESC_STATUS_PIF);
+                /* Check if the hardware have released this descriptor (DD - Descriptor Done) */
+                if (!(ReceiveDescriptor->Status & E1000_RDESC_STATUS_DD))
+                {
+                    /* No need to check descriptors after the first unfinished one */
+                    break;
+                }
 
-            if (ReceiveDescriptor->Status != (E1000_RDESC_STATUS_EOP | E1000_RDESC_STATUS_DD))
-            {
-                NDIS_DbgPrint(MIN_TRACE, ("Unrecognized ReceiveDescriptor status flag: %u\n", ReceiveDescriptor->Status));
-            }
+                NumDescriptors++;
 
-            /* Make sure the receive indications are enabled */
-            if (!Adapter->PacketFilter)
-            {
-                goto NextReceiveDescriptor;
-            }
+                /* Checksum results are picked up below, the others are ignored for now */
+                if ((ReceiveDescriptor->Status & ~(E1000_RDESC_STATUS_IXSM | E1000_RDESC_STATUS_PIF |
+                                                   E1000_RDESC_STATUS_IPCS | E1000_RDESC_STATUS_TCPCS)) !=
+                    (E1000_RDESC_STATUS_EOP | E1000_RDESC_STATUS_DD))
+                {
+                    NDIS_DbgPrint(MIN_TRACE, ("Unrecognized ReceiveDescriptor status flag: %u\n", ReceiveDescriptor->Status));
+                }
 
-            if (ReceiveDescriptor->Length != 0 && ReceiveDescriptor->Address != 0)
-            {
-                EthHeader = (PETH_HEADER)(Adapter->ReceiveBuffer + BufferOffset);
+                /* Make sure the receive indications are enabled */
+                if (!Adapter->PacketFilter)
+                {
+                    continue;
+                }
 
-                NdisMEthIndicateReceive(Adapter->AdapterHandle,
-                                        NULL,
-                                        (PCHAR)EthHeader,
-                                        sizeof(ETH_HEADER),
-                                        (PCHAR)(EthHeader + 1),
-                                        ReceiveDescriptor->Length - sizeof(ETH_HEADER),
-                                        ReceiveDescriptor->Length - sizeof(ETH_HEADER));
+                if (ReceiveDescriptor->Length >= sizeof(ETH_HEADER) && ReceiveDescriptor->Address != 0)
+                {
+                    PNDIS_PACKET Packet = Adapter->ReceivePackets[CurrRxDesc];
+                    PNDIS_BUFFER Buffer;
+                    ULONG ChecksumInfo = 0;
 
-                bGotAny = TRUE;
+                    EthHeader = (PETH_HEADER)(Adapter->ReceiveBuffer + BufferOffset);
+
+                    if (EthHeader->PayloadType == ETH_TYPE_IPV4 &&
+                        ReceiveDescriptor->Length >= sizeof(ETH_HEADER) + 20)
+                    {
+                        ChecksumInfo = NICGetReceiveChecksumInfo(Adapter, ReceiveDescriptor, EthHeader);
+                    }
+
+                    /* Indicate the receive buffer as a packet so the checksum results
+                     * reach the protocol. The buffer is reused once the indication returns */
+                    NdisQueryPacket(Packet, NULL, NULL, &Buffer, NULL);
+                    NdisAdjustBufferLength(Buffer, ReceiveDescriptor->Length);
+                    NdisRecalculatePacketCounts(Packet);
+
+                    NDIS_SET_PACKET_STATUS(Packet, NDIS_STATUS_RESOURCES);
+                    NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo) = UlongToPtr(ChecksumInfo);
+
+                    Packets[NumPackets++] = Packet;
+                }
+                else
+                {
+                    NDIS_DbgPrint(MIN_TRACE, ("Got a NULL descriptor"));
+                }
             }
-            else
+
+            if (NumPackets)
             {
-                NDIS_DbgPrint(MIN_TRACE, ("Got a NULL descriptor"));
+                NdisMIndicateReceivePacket(Adapter->AdapterHandle, Packets, NumPackets);
+                bGotAny = TRUE;
             }
 
-NextReceiveDescriptor:
-            /* Give the descriptor back */
-            ReceiveDescriptor->Status = 0;
+            if (NumDescriptors == 0)
+                break;
 
-            RxDescTail = CurrRxDesc;
-        }
+            /* Give the descriptors back */
+            for (i = 0; i < NumDescriptors; i++)
+            {
+                RxDescTail = (RxDescTail + 1) % Adapter->ReceiveDescriptorCount;
+                ReceiveDescriptor = Adapter->ReceiveDescriptors + RxDescTail;
+                ReceiveDescriptor->Status = 0;
+                ReceiveDescriptor->Errors = 0;
+            }
 
-        if (bGotAny)
-        {
             /* Write back new tail value */
             E1000WriteUlong(Adapter, E1000_REG_RDT, RxDescTail);
 
-            NDIS_DbgPrint(MAX_TRACE, ("Rx done (RDH: %u, RDT: %u)\n", RxDescHead, RxDescTail));
+            NDIS_DbgPrint(MAX_TRACE, ("Rx done (RDH: %u, RDT: %u, %u packets)\n", RxDescHead, RxDescTail, NumPackets));
+        } while (NumDescriptors == RECEIVE_BATCH_SIZE);
 
+        if (bGotAny)
+        {
             NdisMEthIndicateReceiveComplete(Adapter->AdapterHandle);
         }
     }
@@ -172,7 +255,7 @@ NextReceiveDescriptor:
                     TransmitDescriptor->Status = 0;
                 }
 
-                Adapter->LastTxDesc = (Adapter->LastTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
+                Adapter->LastTxDesc = (Adapter->LastTxDesc + 1) % Adapter->TransmitDescriptorCount;
                 Adapter->TxFull = FALSE;
             }
             else
@@ -120,6 +120,8 @@ MiniportInitialize(
         goto Cleanup;
     }
 
+    NICReadConfiguration(Adapter, WrapperConfigurationContext);
+
     /* Get our resources for IRQ and IO base information */
     NdisMQueryAdapterResources(&Status,
                                WrapperConfigurationContext,
@@ -168,9 +170,11 @@ MiniportInitialize(
         goto Cleanup;
     }
 
-    /* Allocate the DMA resources */
+    /* Allocate the DMA resources, large sends are mapped as a whole */
     Status = NdisMInitializeScatterGatherDma(MiniportAdapterHandle,
                                              FALSE, // 64bit is supported but can be buggy
+                                             (Adapter->Features & E1000_FEATURE_LARGE_SEND) ?
+                                             MAXIMUM_LSO_SIZE + sizeof(ETH_HEADER) :
                                              MAXIMUM_FRAME_SIZE);
     if (Status != NDIS_STATUS_SUCCESS)
     {
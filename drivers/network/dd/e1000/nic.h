@@ -21,8 +21,34 @@
 
 #define DRIVER_VERSION 1
 
+/* Largest TCP packet handed to the NIC for segmentation */
+#define MAXIMUM_LSO_SIZE            64000
+#define MINIMUM_LSO_SEGMENT_COUNT   2
+
+/* Optional hardware features */
+#define E1000_FEATURE_CHECKSUM      (1 << 0)    /* TCP/IP checksum offload (82543 and newer) */
+#define E1000_FEATURE_LARGE_SEND    (1 << 1)    /* TCP segmentation (82544 and newer) */
+#define E1000_FEATURE_THROTTLING    (1 << 2)    /* Interrupt throttling (82540 and newer) */
+
+/* Receive packets indicated to NDIS in one call */
+#define RECEIVE_BATCH_SIZE          32
+
 #define DEFAULT_INTERRUPT_MASK  (E1000_IMS_LSC | E1000_IMS_TXDW | E1000_IMS_TXQE | E1000_IMS_RXDMT0 | E1000_IMS_RXT0 | E1000_IMS_TXD_LOW)
 
+typedef union _E1000_OFFLOAD
+{
+    struct {
+        ULONG SendTcpChecksum:1;
+        ULONG SendUdpChecksum:1;
+        ULONG SendIpChecksum:1;
+        ULONG LargeSend:1;
+
+        ULONG ReceiveTcpChecksum:1;
+        ULONG ReceiveUdpChecksum:1;
+        ULONG ReceiveIpChecksum:1;
+    };
+    ULONG Value;
+} E1000_OFFLOAD, *PE1000_OFFLOAD;
 
 typedef struct _E1000_ADAPTER
 {
@@ -50,6 +76,14 @@ typedef struct _E1000_ADAPTER
     ULONG MediaState;
     ULONG PacketFilter;
 
+    ULONG Features;
+    E1000_OFFLOAD Offload;
+
+    /* Settings read from the registry */
+    ULONG TransmitDescriptorCount;
+    ULONG ReceiveDescriptorCount;
+    ULONG InterruptThrottleRate;
+
     /* Io Port */
     ULONG IoPortAddress;
     ULONG IoPortLength;
@@ -74,12 +108,16 @@ typedef struct _E1000_ADAPTER
     PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptors;
     NDIS_PHYSICAL_ADDRESS TransmitDescriptorsPa;
 
-    PNDIS_PACKET TransmitPackets[NUM_TRANSMIT_DESCRIPTORS];
+    PNDIS_PACKET *TransmitPackets;
 
     ULONG CurrentTxDesc;
     ULONG LastTxDesc;
     BOOLEAN TxFull;
 
+    /* Last offload context loaded into the NIC */
+    E1000_CONTEXT_DESCRIPTOR TxContext;
+    BOOLEAN TxContextValid;
+
 
     /* Receive */
     PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptors;
@@ -90,6 +128,11 @@ typedef struct _E1000_ADAPTER
     NDIS_PHYSICAL_ADDRESS ReceiveBufferPa;
     ULONG ReceiveBufferEntrySize;
 
+    /* Packets describing the receive buffers, used to indicate checksum results */
+    NDIS_HANDLE ReceivePacketPool;
+    NDIS_HANDLE ReceiveBufferPool;
+    PNDIS_PACKET *ReceivePackets;
+
 } E1000_ADAPTER, *PE1000_ADAPTER;
 
 
@@ -98,6 +141,12 @@ NTAPI
 NICRecognizeHardware(
     IN PE1000_ADAPTER Adapter);
 
+VOID
+NTAPI
+NICReadConfiguration(
+    IN PE1000_ADAPTER Adapter,
+    IN NDIS_HANDLE WrapperConfigurationContext);
+
 NDIS_STATUS
 NTAPI
 NICInitializeAdapterResources(
@@ -165,6 +214,11 @@ NTAPI
 NICUpdateLinkStatus(
     IN PE1000_ADAPTER Adapter);
 
+VOID
+NTAPI
+NICApplyReceiveChecksum(
+    IN PE1000_ADAPTER Adapter);
+
 NDIS_STATUS
 NTAPI
 MiniportSend(
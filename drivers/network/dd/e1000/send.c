@@ -10,38 +10,167 @@
 
 #include <debug.h>
 
+/* Enough for the Ethernet header, the largest IPv4 header and the fixed TCP header */
+#define MAXIMUM_OFFLOAD_HEADERS     (sizeof(ETH_HEADER) + 60 + 20)
+
 static
-NDIS_STATUS
-NICTransmitPacket(
-    _In_ PE1000_ADAPTER Adapter,
-    _In_ PHYSICAL_ADDRESS PhysicalAddress,
-    _In_ ULONG Length)
+ULONG
+NICGetFreeTransmitDescriptors(
+    _In_ PE1000_ADAPTER Adapter)
 {
-    volatile PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptor;
-
-    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
-
-    TransmitDescriptor = Adapter->TransmitDescriptors + Adapter->CurrentTxDesc;
-    TransmitDescriptor->Address = PhysicalAddress.QuadPart;
-    TransmitDescriptor->Length = Length;
-    TransmitDescriptor->ChecksumOffset = 0;
-    TransmitDescriptor->Command = E1000_TDESC_CMD_RS | E1000_TDESC_CMD_IFCS |
-                                  E1000_TDESC_CMD_EOP | E1000_TDESC_CMD_IDE;
-    TransmitDescriptor->Status = 0;
-    TransmitDescriptor->ChecksumStartField = 0;
-    TransmitDescriptor->Special = 0;
+    if (Adapter->TxFull)
+        return 0;
 
-    Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
+    return ((Adapter->LastTxDesc - Adapter->CurrentTxDesc + Adapter->TransmitDescriptorCount - 1) %
+            Adapter->TransmitDescriptorCount) + 1;
+}
 
-    E1000WriteUlong(Adapter, E1000_REG_TDT, Adapter->CurrentTxDesc);
+static
+VOID
+NICAdvanceTransmitDescriptor(
+    _In_ PE1000_ADAPTER Adapter)
+{
+    Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % Adapter->TransmitDescriptorCount;
 
     if (Adapter->CurrentTxDesc == Adapter->LastTxDesc)
     {
         NDIS_DbgPrint(MID_TRACE, ("All TX descriptors are full now\n"));
         Adapter->TxFull = TRUE;
     }
+}
+
+static
+ULONG
+NICCopyPacketHeaders(
+    _In_ PNDIS_PACKET Packet,
+    _Out_writes_bytes_(Length) PUCHAR Headers,
+    _In_ ULONG Length)
+{
+    PNDIS_BUFFER Buffer;
+    PVOID Address;
+    UINT BufferLength;
+    ULONG Copied = 0;
+
+    NdisQueryPacket(Packet, NULL, NULL, &Buffer, NULL);
+
+    while (Buffer && Copied < Length)
+    {
+        NdisQueryBufferSafe(Buffer, &Address, &BufferLength, HighPagePriority);
+        if (!Address)
+            break;
+
+        BufferLength = min(BufferLength, Length - Copied);
+        NdisMoveMemory(Headers + Copied, Address, BufferLength);
+        Copied += BufferLength;
+
+        NdisGetNextBuffer(Buffer, &Buffer);
+    }
+
+    return Copied;
+}
+
+/*
+ * Builds the offload context for a packet. The protocol has already put the
+ * pseudo-header checksum in the TCP/UDP checksum field, without the length
+ * for a large send since the NIC adds it for each segment.
+ */
+static
+BOOLEAN
+NICBuildTransmitContext(
+    _In_ PE1000_ADAPTER Adapter,
+    _In_ PNDIS_PACKET Packet,
+    _In_ ULONG PacketLength,
+    _Out_ PE1000_CONTEXT_DESCRIPTOR Context,
+    _Out_ PUCHAR PacketOptions,
+    _Out_ PULONG Mss)
+{
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    UCHAR Headers[MAXIMUM_OFFLOAD_HEADERS];
+    ULONG HeadersLength;
+    ULONG IpHeaderLength, TransportStart, HeaderLength;
+    UCHAR Protocol, Command;
+
+    *PacketOptions = 0;
+    *Mss = 0;
+
+    if (!(Adapter->Features & E1000_FEATURE_CHECKSUM) ||
+        NDIS_GET_PACKET_PROTOCOL_TYPE(Packet) != NDIS_PROTOCOL_ID_TCP_IP)
+    {
+        return FALSE;
+    }
+
+    ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo));
+    if (Adapter->Offload.LargeSend)
+    {
+        *Mss = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpLargeSendPacketInfo));
+    }
+
+    if (*Mss == 0 && !ChecksumInfo.Transmit.NdisPacketChecksumV4)
+    {
+        return FALSE;
+    }
+
+    HeadersLength = NICCopyPacketHeaders(Packet, Headers, sizeof(Headers));
+    if (HeadersLength < sizeof(ETH_HEADER) + 20)
+    {
+        *Mss = 0;
+        return FALSE;
+    }
+
+    IpHeaderLength = (Headers[sizeof(ETH_HEADER)] & 0x0F) << 2;
+    Protocol = Headers[sizeof(ETH_HEADER) + 9];
+    TransportStart = sizeof(ETH_HEADER) + IpHeaderLength;
+
+    NdisZeroMemory(Context, sizeof(*Context));
+
+    Context->IpChecksumStart = sizeof(ETH_HEADER);
+    Context->IpChecksumOffset = sizeof(ETH_HEADER) + 10;
+    Context->IpChecksumEnd = (USHORT)(TransportStart - 1);
+
+    Context->TcpChecksumStart = (UCHAR)TransportStart;
+    Context->TcpChecksumOffset = (UCHAR)(TransportStart + (Protocol == IP_PROTOCOL_TCP ? 16 : 6));
+    Context->TcpChecksumEnd = 0;
+
+    Command = E1000_TCTX_CMD_DEXT | E1000_TCTX_CMD_RS | E1000_TCTX_CMD_IP;
+    if (Protocol == IP_PROTOCOL_TCP)
+        Command |= E1000_TCTX_CMD_TCP;
+
+    if (*Mss)
+    {
+        if (Protocol != IP_PROTOCOL_TCP || HeadersLength < TransportStart + 20)
+        {
+            *Mss = 0;
+            return FALSE;
+        }
+
+        HeaderLength = TransportStart + ((Headers[TransportStart + 12] >> 4) << 2);
+
+        Command |= E1000_TCTX_CMD_TSE;
+        Context->HeaderLength = (UCHAR)HeaderLength;
+        Context->MaximumSegmentSize = (USHORT)*Mss;
+        Context->PayloadLengthCommand = (PacketLength - HeaderLength) & E1000_TDESC_LENGTH_MASK;
+
+        *PacketOptions = E1000_TDATA_POPTS_IXSM | E1000_TDATA_POPTS_TXSM;
+    }
+    else
+    {
+        if (ChecksumInfo.Transmit.NdisPacketIpChecksum && Adapter->Offload.SendIpChecksum)
+            *PacketOptions |= E1000_TDATA_POPTS_IXSM;
+
+        if ((ChecksumInfo.Transmit.NdisPacketTcpChecksum && Adapter->Offload.SendTcpChecksum && Protocol == IP_PROTOCOL_TCP) ||
+            (ChecksumInfo.Transmit.NdisPacketUdpChecksum && Adapter->Offload.SendUdpChecksum && Protocol == IP_PROTOCOL_UDP))
+        {
+            *PacketOptions |= E1000_TDATA_POPTS_TXSM;
+        }
+
+        if (*PacketOptions == 0)
+            return FALSE;
+    }
+
+    Context->PayloadLengthCommand |= (E1000_TDESC_DTYP_CONTEXT << E1000_TDESC_DTYP_SHIFT) |
+                                     ((ULONG)Command << E1000_TDESC_CMD_SHIFT);
 
-    return NDIS_STATUS_SUCCESS;
+    return TRUE;
 }
 
 NDIS_STATUS
@@ -53,33 +182,100 @@ MiniportSend(
 {
     PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
     PSCATTER_GATHER_LIST sgList;
-    ULONG TransmitLength;
-    PHYSICAL_ADDRESS TransmitBuffer;
-    NDIS_STATUS Status;
+    E1000_CONTEXT_DESCRIPTOR Context;
+    BOOLEAN Offload, LoadContext;
+    UCHAR PacketOptions;
+    ULONG Mss, Command, i;
+    UINT PacketLength;
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
     sgList = NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, ScatterGatherListPacketInfo);
 
     ASSERT(sgList != NULL);
-    ASSERT(sgList->NumberOfElements == 1);
+    ASSERT(sgList->NumberOfElements != 0);
     ASSERT((sgList->Elements[0].Address.LowPart & 3) == 0);
-    ASSERT(sgList->Elements[0].Length <= MAXIMUM_FRAME_SIZE);
 
-    if (Adapter->TxFull)
+    NdisQueryPacketLength(Packet, &PacketLength);
+
+    Offload = NICBuildTransmitContext(Adapter, Packet, PacketLength, &Context, &PacketOptions, &Mss);
+    ASSERT(Mss != 0 || PacketLength <= MAXIMUM_FRAME_SIZE);
+
+    /* Large sends have their own payload length, skip reloading an identical context */
+    LoadContext = Offload &&
+                  (Mss != 0 || !Adapter->TxContextValid ||
+                   RtlCompareMemory(&Adapter->TxContext, &Context, sizeof(Context)) != sizeof(Context));
+
+    if (NICGetFreeTransmitDescriptors(Adapter) < sgList->NumberOfElements + (LoadContext ? 1 : 0))
     {
         NDIS_DbgPrint(MIN_TRACE, ("All TX descriptors are full\n"));
         return NDIS_STATUS_RESOURCES;
     }
 
-    TransmitLength = sgList->Elements[0].Length;
-    TransmitBuffer = sgList->Elements[0].Address;
-    Adapter->TransmitPackets[Adapter->CurrentTxDesc] = Packet;
+    if (LoadContext)
+    {
+        volatile PE1000_CONTEXT_DESCRIPTOR ContextDescriptor;
+
+        ContextDescriptor = (PE1000_CONTEXT_DESCRIPTOR)(Adapter->TransmitDescriptors + Adapter->CurrentTxDesc);
+        *ContextDescriptor = Context;
+        Adapter->TransmitPackets[Adapter->CurrentTxDesc] = NULL;
+
+        /* A segmentation context is only good for its own packet */
+        Adapter->TxContext = Context;
+        Adapter->TxContextValid = (Mss == 0);
+
+        NICAdvanceTransmitDescriptor(Adapter);
+    }
 
-    Status = NICTransmitPacket(Adapter, TransmitBuffer, TransmitLength);
-    if (Status != NDIS_STATUS_SUCCESS)
+    for (i = 0; i < sgList->NumberOfElements; i++)
     {
-        NDIS_DbgPrint(MIN_TRACE, ("Transmit packet failed\n"));
-        return Status;
+        BOOLEAN Last = (i == sgList->NumberOfElements - 1);
+
+        if (Offload)
+        {
+            volatile PE1000_DATA_DESCRIPTOR DataDescriptor;
+
+            Command = E1000_TDATA_CMD_DEXT | E1000_TDATA_CMD_RS | E1000_TDATA_CMD_IFCS |
+                      E1000_TDATA_CMD_IDE;
+            if (Mss)
+                Command |= E1000_TDATA_CMD_TSE;
+            if (Last)
+                Command |= E1000_TDATA_CMD_EOP;
+
+            DataDescriptor = (PE1000_DATA_DESCRIPTOR)(Adapter->TransmitDescriptors + Adapter->CurrentTxDesc);
+            DataDescriptor->Address = sgList->Elements[i].Address.QuadPart;
+            DataDescriptor->LengthCommand = (sgList->Elements[i].Length & E1000_TDESC_LENGTH_MASK) |
+                                            (E1000_TDESC_DTYP_DATA << E1000_TDESC_DTYP_SHIFT) |
+                                            (Command << E1000_TDESC_CMD_SHIFT);
+            DataDescriptor->Status = 0;
+            DataDescriptor->PacketOptions = PacketOptions;
+            DataDescriptor->Special = 0;
+        }
+        else
+        {
+            volatile PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptor;
+
+            Command = E1000_TDESC_CMD_RS | E1000_TDESC_CMD_IFCS | E1000_TDESC_CMD_IDE;
+            if (Last)
+                Command |= E1000_TDESC_CMD_EOP;
+
+            TransmitDescriptor = Adapter->TransmitDescriptors + Adapter->CurrentTxDesc;
+            TransmitDescriptor->Address = sgList->Elements[i].Address.QuadPart;
+            TransmitDescriptor->Length = (USHORT)sgList->Elements[i].Length;
+            TransmitDescriptor->ChecksumOffset = 0;
+            TransmitDescriptor->Command = (UCHAR)Command;
+            TransmitDescriptor->Status = 0;
+            TransmitDescriptor->ChecksumStartField = 0;
+            TransmitDescriptor->Special = 0;
+        }
+
+        /* The packet completes with its last descriptor */
+        Adapter->TransmitPackets[Adapter->CurrentTxDesc] = Last ? Packet : NULL;
+
+        NICAdvanceTransmitDescriptor(Adapter);
     }
 
+    E1000WriteUlong(Adapter, E1000_REG_TDT, Adapter->CurrentTxDesc);
+
     return NDIS_STATUS_PENDING;
 }
@@ -83,6 +83,11 @@ typedef struct _NDIS_WRAPPER_CONTEXT {
 
 #define GET_MINIPORT_DRIVER(Handle)((PNDIS_M_DRIVER_BLOCK)Handle)
 
+/* Packet statistics of one processor, on its own cache line */
+typedef struct DECLSPEC_CACHEALIGN _MINIPORT_COUNTERS {
+    NDIS_PACKET_COUNTERS  Counters;
+} MINIPORT_COUNTERS, *PMINIPORT_COUNTERS;
+
 /* Information about a logical adapter */
 typedef struct _LOGICAL_ADAPTER
 {
@@ -96,10 +101,27 @@ typedef struct _LOGICAL_ADAPTER
     HARDWARE_ADDRESS            Address;                /* Hardware address of adapter */
     ULONG                       AddressLength;          /* Length of hardware address */
     PMINIPORT_BUGCHECK_CONTEXT  BugcheckContext;        /* Adapter's shutdown handler */
+    PMINIPORT_COUNTERS          Counters;               /* Packet statistics, one per processor */
+    ULONG                       CounterCount;           /* Number of entries in Counters */
+    LARGE_INTEGER               CounterFrequency;       /* Performance counter frequency for latencies */
+    ULONG                       WorkQueueDepth;         /* Items on the work queue */
+    ULONG                       WorkQueueMaxDepth;      /* Deepest the work queue has been */
 } LOGICAL_ADAPTER, *PLOGICAL_ADAPTER;
 
 #define GET_LOGICAL_ADAPTER(Handle)((PLOGICAL_ADAPTER)Handle)
 
+/* Statistics of the processor the caller runs on, NULL if there are none */
+FORCEINLINE
+PNDIS_PACKET_COUNTERS
+MiniGetCounters(
+    PLOGICAL_ADAPTER Adapter)
+{
+    if (!Adapter->Counters)
+        return NULL;
+
+    return &Adapter->Counters[KeGetCurrentProcessorNumber() % Adapter->CounterCount].Counters;
+}
+
 extern LIST_ENTRY MiniportListHead;
 extern KSPIN_LOCK MiniportListLock;
 extern LIST_ENTRY AdapterListHead;
@@ -200,4 +222,27 @@ MiniWorkItemComplete(
     PLOGICAL_ADAPTER     Adapter,
     NDIS_WORK_ITEM_TYPE  WorkItemType);
 
+VOID
+MiniCountSend(
+    PLOGICAL_ADAPTER Adapter,
+    PNDIS_PACKET     Packet);
+
+VOID
+MiniCountSendComplete(
+    PLOGICAL_ADAPTER Adapter,
+    PNDIS_PACKET     Packet,
+    NDIS_STATUS      Status);
+
+VOID
+MiniCountReceive(
+    PLOGICAL_ADAPTER Adapter,
+    UINT             PacketLength);
+
+NDIS_STATUS
+MiniQueryStatistics(
+    PLOGICAL_ADAPTER Adapter,
+    ULONG            Size,
+    PVOID            Buffer,
+    PULONG           BytesWritten);
+
 /* EOF */
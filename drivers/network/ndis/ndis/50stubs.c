@@ -327,27 +327,6 @@ NdisConvertStringToAtmAddress(
 }
 
 
-/*
- * @unimplemented
- */
-PNDIS_PACKET
-EXPORT
-NdisGetReceivedPacket(
-    IN  PNDIS_HANDLE    NdisBindingHandle,
-    IN  PNDIS_HANDLE    MacContext)
-/*
- * FUNCTION:
- * ARGUMENTS:
- * NOTES:
- *    NDIS 5.0
- */
-{
-    UNIMPLEMENTED;
-
-    return NULL;
-}
-
-
 /*
  * @unimplemented
  */
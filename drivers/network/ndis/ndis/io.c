@@ -28,11 +28,15 @@ VOID NTAPI HandleDeferredProcessing(
  */
 {
   PLOGICAL_ADAPTER Adapter = GET_LOGICAL_ADAPTER(DeferredContext);
+  PNDIS_PACKET_COUNTERS Counters = MiniGetCounters(Adapter);
 
   NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
   ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
 
+  if (Counters)
+    InterlockedIncrement64((PLONG64)&Counters->Dpcs);
+
   /* Call the deferred interrupt service handler for this adapter */
   (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.HandleInterruptHandler)(
       Adapter->NdisMiniportBlock.MiniportAdapterContext);
@@ -86,6 +90,14 @@ BOOLEAN NTAPI ServiceRoutine(
        InterruptRecognized = TRUE;
   }
 
+  if (InterruptRecognized)
+  {
+      PNDIS_PACKET_COUNTERS Counters = MiniGetCounters((PLOGICAL_ADAPTER)NdisMiniportBlock);
+
+      if (Counters)
+          InterlockedIncrement64((PLONG64)&Counters->Interrupts);
+  }
+
   /* TODO: Figure out if we should call this or not if Initializing is true. It appears
    * that calling it fixes some NICs, but documentation is contradictory on it.  */
   if (QueueMiniportHandleInterrupt)
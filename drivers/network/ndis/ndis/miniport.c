@@ -49,6 +49,9 @@ static NDIS_MEDIUM MediaArray[MEDIA_ARRAY_SIZE] =
     NdisMediumMax
 };
 
+/* Upper limits of the send latency buckets, in microseconds */
+static const ULONG SendLatencyLimits[NDIS_SEND_LATENCY_BUCKETS - 1] = NDIS_SEND_LATENCY_LIMITS;
+
 /* global list and lock of Miniports NDIS has registered */
 LIST_ENTRY MiniportListHead;
 KSPIN_LOCK MiniportListLock;
@@ -204,6 +207,8 @@ MiniIndicateData(
   MiniDisplayPacket2(HeaderBuffer, HeaderBufferSize, LookaheadBuffer, LookaheadBufferSize);
 #endif
 
+  MiniCountReceive(Adapter, HeaderBufferSize + PacketSize);
+
   NDIS_DbgPrint(MAX_TRACE, ("acquiring miniport block lock\n"));
   KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
     {
@@ -307,7 +312,13 @@ MiniIndicateReceivePacket(
     PLIST_ENTRY CurrentEntry;
     PADAPTER_BINDING AdapterBinding;
     KIRQL OldIrql;
-    UINT i;
+    UINT i, PacketLength;
+
+    for (i = 0; i < NumberOfPackets; i++)
+    {
+        NdisQueryPacketLength(PacketArray[i], &PacketLength);
+        MiniCountReceive(Adapter, PacketLength);
+    }
 
     KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
 
@@ -360,16 +371,22 @@ MiniIndicateReceivePacket(
                                         HeaderSize,
                                         LookAheadSize);
 
+                /* The packet is the receive context, so NdisTransferData copies
+                 * from it and NdisGetReceivedPacket can return it */
+                Adapter->NdisMiniportBlock.IndicatedPacket[KeGetCurrentProcessorNumber()] = PacketArray[i];
+
                 NDIS_DbgPrint(MID_TRACE, ("Indicating packet to protocol's legacy Receive handler\n"));
                 (*AdapterBinding->ProtocolBinding->Chars.ReceiveHandler)(
                      AdapterBinding->NdisOpenBlock.ProtocolBindingContext,
-                     AdapterBinding->NdisOpenBlock.MacHandle,
+                     PacketArray[i],
                      NdisBufferVA,
                      HeaderSize,
                      LookAheadBuffer,
                      LookAheadSize,
                      TotalBufferLength - HeaderSize);
 
+                Adapter->NdisMiniportBlock.IndicatedPacket[KeGetCurrentProcessorNumber()] = NULL;
+
                 ExFreePool(LookAheadBuffer);
             }
         }
@@ -549,6 +566,8 @@ MiniSendComplete(
 
     AdapterBinding = (PADAPTER_BINDING)Packet->Reserved[1];
 
+    MiniCountSendComplete(Adapter, Packet, Status);
+
     KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
 
     if (Adapter->NdisMiniportBlock.ScatterGatherListSize != 0)
@@ -612,6 +631,93 @@ MiniTransferDataComplete(
 }
 
 
+VOID
+MiniCountSend(
+    PLOGICAL_ADAPTER Adapter,
+    PNDIS_PACKET     Packet)
+/*
+ * FUNCTION: Accounts for a packet handed to the miniport
+ * ARGUMENTS:
+ *     Adapter = Pointer to the logical adapter object
+ *     Packet  = Pointer to NDIS packet about to be sent
+ * NOTES:
+ *     Reserved[0] only links free packets in their pool, so it holds
+ *     the time the send started until the send completes
+ */
+{
+    PNDIS_PACKET_COUNTERS Counters = MiniGetCounters(Adapter);
+    UINT PacketLength;
+
+    if (!Counters)
+        return;
+
+    NdisQueryPacketLength(Packet, &PacketLength);
+
+    InterlockedIncrement64((PLONG64)&Counters->SendPackets);
+    InterlockedExchangeAdd64((PLONG64)&Counters->SendBytes, PacketLength);
+
+    /* Zero means the packet was not counted */
+    Packet->Reserved[0] = KeQueryPerformanceCounter(NULL).LowPart | 1;
+}
+
+VOID
+MiniCountSendComplete(
+    PLOGICAL_ADAPTER Adapter,
+    PNDIS_PACKET     Packet,
+    NDIS_STATUS      Status)
+/*
+ * FUNCTION: Accounts for a completed send and how long it took
+ * ARGUMENTS:
+ *     Adapter = Pointer to the logical adapter object
+ *     Packet  = Pointer to NDIS packet that was sent
+ *     Status  = Status of send operation
+ */
+{
+    PNDIS_PACKET_COUNTERS Counters = MiniGetCounters(Adapter);
+    ULONGLONG Microseconds;
+    ULONG Elapsed, Bucket;
+
+    /* Loopback packets never went through MiniCountSend */
+    if (!Counters || !Packet->Reserved[0])
+        return;
+
+    Elapsed = KeQueryPerformanceCounter(NULL).LowPart - (ULONG)Packet->Reserved[0];
+    Packet->Reserved[0] = 0;
+
+    InterlockedIncrement64((PLONG64)&Counters->SendCompletions);
+    if (Status != NDIS_STATUS_SUCCESS)
+        InterlockedIncrement64((PLONG64)&Counters->SendErrors);
+
+    Microseconds = (ULONGLONG)Elapsed * 1000000 / Adapter->CounterFrequency.QuadPart;
+    for (Bucket = 0; Bucket < NDIS_SEND_LATENCY_BUCKETS - 1; Bucket++)
+    {
+        if (Microseconds < SendLatencyLimits[Bucket])
+            break;
+    }
+
+    InterlockedIncrement64((PLONG64)&Counters->SendLatency[Bucket]);
+}
+
+VOID
+MiniCountReceive(
+    PLOGICAL_ADAPTER Adapter,
+    UINT             PacketLength)
+/*
+ * FUNCTION: Accounts for a packet indicated by the miniport
+ * ARGUMENTS:
+ *     Adapter      = Pointer to the logical adapter object
+ *     PacketLength = Size of the packet including its header
+ */
+{
+    PNDIS_PACKET_COUNTERS Counters = MiniGetCounters(Adapter);
+
+    if (!Counters)
+        return;
+
+    InterlockedIncrement64((PLONG64)&Counters->ReceivePackets);
+    InterlockedExchangeAdd64((PLONG64)&Counters->ReceiveBytes, PacketLength);
+}
+
 BOOLEAN
 MiniAdapterHasAddress(
     PLOGICAL_ADAPTER Adapter,
@@ -861,6 +967,69 @@ MiniQueryInformation(
   return NdisStatus;
 }
 
+NDIS_STATUS
+MiniQueryStatistics(
+    PLOGICAL_ADAPTER    Adapter,
+    ULONG               Size,
+    PVOID               Buffer,
+    PULONG              BytesWritten)
+/*
+ * FUNCTION: Collects the packet statistics NDIS keeps for an adapter
+ * ARGUMENTS:
+ *     Adapter      = Pointer to the logical adapter object to query
+ *     Size         = Size of the passed buffer
+ *     Buffer       = Buffer for the NDIS_PACKET_STATISTICS
+ *     BytesWritten = Address of buffer to place number of bytes written
+ * RETURNS:
+ *     Status of operation
+ * NOTES:
+ *     The per-processor counters are copied as far as the buffer goes
+ */
+{
+  PNDIS_PACKET_STATISTICS Statistics = Buffer;
+  PLONG64 Source, Total, Copy;
+  ULONG Processor, Count, i;
+
+  *BytesWritten = 0;
+
+  if (Size < FIELD_OFFSET(NDIS_PACKET_STATISTICS, Processor))
+      return NDIS_STATUS_BUFFER_TOO_SHORT;
+
+  if (!Adapter->Counters)
+      return NDIS_STATUS_NOT_SUPPORTED;
+
+  Count = min(Adapter->CounterCount,
+              (Size - FIELD_OFFSET(NDIS_PACKET_STATISTICS, Processor)) / sizeof(NDIS_PACKET_COUNTERS));
+
+  RtlZeroMemory(Statistics, FIELD_OFFSET(NDIS_PACKET_STATISTICS, Processor[Count]));
+
+  Statistics->Version = NDIS_PACKET_STATISTICS_VERSION;
+  Statistics->NumberOfProcessors = Adapter->CounterCount;
+  Statistics->QueueDepth = Adapter->WorkQueueDepth;
+  Statistics->MaximumQueueDepth = Adapter->WorkQueueMaxDepth;
+
+  for (Processor = 0; Processor < Adapter->CounterCount; Processor++)
+  {
+      Source = (PLONG64)&Adapter->Counters[Processor].Counters;
+      Total = (PLONG64)&Statistics->Total;
+      Copy = (Processor < Count) ? (PLONG64)&Statistics->Processor[Processor] : NULL;
+
+      for (i = 0; i < sizeof(NDIS_PACKET_COUNTERS) / sizeof(LONG64); i++)
+      {
+          /* 64-bit reads are not atomic everywhere */
+          LONG64 Value = InterlockedCompareExchange64(&Source[i], 0, 0);
+
+          Total[i] += Value;
+          if (Copy)
+              Copy[i] = Value;
+      }
+  }
+
+  *BytesWritten = FIELD_OFFSET(NDIS_PACKET_STATISTICS, Processor[Count]);
+
+  return NDIS_STATUS_SUCCESS;
+}
+
 BOOLEAN
 MiniCheckForHang( PLOGICAL_ADAPTER Adapter )
 /*
@@ -1040,6 +1209,10 @@ MiniQueueWorkItem(
             Adapter->WorkQueueTail->Link.Next = (PSINGLE_LIST_ENTRY)MiniportWorkItem;
             Adapter->WorkQueueTail = MiniportWorkItem;
         }
+
+        Adapter->WorkQueueDepth++;
+        if (Adapter->WorkQueueDepth > Adapter->WorkQueueMaxDepth)
+            Adapter->WorkQueueMaxDepth = Adapter->WorkQueueDepth;
     }
 
     KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
@@ -1088,6 +1261,8 @@ MiniDequeueWorkItem(
         if (MiniportWorkItem == Adapter->WorkQueueTail)
             Adapter->WorkQueueTail = NULL;
 
+        Adapter->WorkQueueDepth--;
+
         *WorkItemType    = MiniportWorkItem->WorkItemType;
         *WorkItemContext = MiniportWorkItem->WorkItemContext;
 
@@ -2306,11 +2481,18 @@ NdisIDeviceIoControl(
   switch (ControlCode)
   {
     case IOCTL_NDIS_QUERY_GLOBAL_STATS:
-      Status = MiniQueryInformation(Adapter,
-                                    *(PNDIS_OID)Irp->AssociatedIrp.SystemBuffer,
-                                    Stack->Parameters.DeviceIoControl.OutputBufferLength,
-                                    MmGetSystemAddressForMdl(Irp->MdlAddress),
-                                    &Written);
+      /* Our own statistics never reach the miniport */
+      if (*(PNDIS_OID)Irp->AssociatedIrp.SystemBuffer == OID_REACTOS_PACKET_STATISTICS)
+          Status = MiniQueryStatistics(Adapter,
+                                       Stack->Parameters.DeviceIoControl.OutputBufferLength,
+                                       MmGetSystemAddressForMdl(Irp->MdlAddress),
+                                       &Written);
+      else
+          Status = MiniQueryInformation(Adapter,
+                                        *(PNDIS_OID)Irp->AssociatedIrp.SystemBuffer,
+                                        Stack->Parameters.DeviceIoControl.OutputBufferLength,
+                                        MmGetSystemAddressForMdl(Irp->MdlAddress),
+                                        &Written);
       Irp->IoStatus.Information = Written;
       break;
 
@@ -2564,6 +2746,17 @@ NdisIAddDevice(
   KeInitializeTimer(&Adapter->NdisMiniportBlock.WakeUpDpcTimer.Timer);
   KeInitializeDpc(&Adapter->NdisMiniportBlock.WakeUpDpcTimer.Dpc, MiniportHangDpc, Adapter);
 
+  /* The adapter works without statistics if there is no memory for them */
+  Adapter->CounterCount = KeNumberProcessors;
+  Adapter->Counters = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                            Adapter->CounterCount * sizeof(MINIPORT_COUNTERS),
+                                            NDIS_TAG);
+  if (Adapter->Counters)
+      RtlZeroMemory(Adapter->Counters, Adapter->CounterCount * sizeof(MINIPORT_COUNTERS));
+  else
+      NDIS_DbgPrint(MIN_TRACE, ("No memory for packet statistics\n"));
+  KeQueryPerformanceCounter(&Adapter->CounterFrequency);
+
   DeviceObject->Flags &= ~DO_DEVICE_INITIALIZING;
 
   return STATUS_SUCCESS;
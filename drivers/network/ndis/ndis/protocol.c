@@ -356,6 +356,18 @@ ProReset(
     return MiniReset(AdapterBinding->Adapter);
 }
 
+static VOID
+proCountScatterGatherFailure(PLOGICAL_ADAPTER Adapter, PNDIS_PACKET Packet, NDIS_STATUS Status)
+{
+   PNDIS_PACKET_COUNTERS Counters = MiniGetCounters(Adapter);
+
+   if (Counters)
+       InterlockedIncrement64((PLONG64)&Counters->ScatterGatherFailures);
+
+   /* The protocol gets the packet back with the error */
+   MiniCountSendComplete(Adapter, Packet, Status);
+}
+
 VOID NTAPI
 ScatterGatherSendPacket(
    IN PDEVICE_OBJECT DeviceObject,
@@ -535,9 +547,12 @@ ProSend(
                             &NdisBuffer,
                             &PacketLength);
 
+            MiniCountSend(Adapter, Packet);
+
             Context = ExAllocatePool(NonPagedPool, sizeof(DMA_CONTEXT));
             if (!Context) {
                 NDIS_DbgPrint(MIN_TRACE, ("Insufficient resources\n"));
+                proCountScatterGatherFailure(Adapter, Packet, NDIS_STATUS_RESOURCES);
                 return NDIS_STATUS_RESOURCES;
             }
 
@@ -562,14 +577,22 @@ ProSend(
 
             if (!NT_SUCCESS(NdisStatus)) {
                 NDIS_DbgPrint(MIN_TRACE, ("GetScatterGatherList failed! (%x)\n", NdisStatus));
+                proCountScatterGatherFailure(Adapter, Packet, NdisStatus);
                 return NdisStatus;
             }
 
             return NDIS_STATUS_PENDING;
         }
 
+        MiniCountSend(Adapter, Packet);
+
+        NdisStatus = proSendPacketToMiniport(Adapter, Packet);
+
+        /* The protocol completes the packet itself in this case */
+        if (NdisStatus != NDIS_STATUS_PENDING)
+            MiniCountSendComplete(Adapter, Packet, NdisStatus);
 
-        return proSendPacketToMiniport(Adapter, Packet);
+        return NdisStatus;
     }
 }
 
@@ -585,6 +608,9 @@ ProSendPackets(
     NDIS_STATUS NdisStatus;
     UINT i;
 
+    for (i = 0; i < NumberOfPackets; i++)
+        MiniCountSend(Adapter, PacketArray[i]);
+
     if(Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)
     {
        if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
@@ -695,6 +721,42 @@ ProTransferData(
 
 
 
+/*
+ * @implemented
+ */
+PNDIS_PACKET
+EXPORT
+NdisGetReceivedPacket(
+    IN  PNDIS_HANDLE    NdisBindingHandle,
+    IN  PNDIS_HANDLE    MacContext)
+/*
+ * FUNCTION: Returns the packet descriptor behind a receive indication
+ * ARGUMENTS:
+ *     NdisBindingHandle = Adapter binding handle
+ *     MacContext        = MAC receive context passed to ProtocolReceive
+ * RETURNS:
+ *     Pointer to the packet the miniport indicated, or NULL if the data
+ *     was not indicated as a packet
+ * NOTES:
+ *    NDIS 5.0
+ *    Protocols use this from ProtocolReceive to read the per-packet
+ *    information (e.g. checksum results) of a packet that was indicated
+ *    to them through their legacy receive handler. Packets looped back
+ *    by NDIS are indicated without a MAC context and are not returned,
+ *    since their per-packet information describes a send
+ */
+{
+    PADAPTER_BINDING AdapterBinding = GET_ADAPTER_BINDING(NdisBindingHandle);
+    PLOGICAL_ADAPTER Adapter        = AdapterBinding->Adapter;
+
+    if (!MacContext)
+        return NULL;
+
+    return Adapter->NdisMiniportBlock.IndicatedPacket[KeGetCurrentProcessorNumber()];
+}
+
+
+
 /*
  * @implemented
  */
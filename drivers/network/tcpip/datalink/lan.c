@@ -313,6 +313,7 @@ VOID LanReceiveWorker( PVOID Context ) {
     IP_PACKET IPPacket;
     BOOLEAN LegacyReceive;
     PIP_INTERFACE Interface;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
 
     TI_DbgPrint(DEBUG_DATALINK, ("Called.\n"));
 
@@ -360,6 +361,23 @@ VOID LanReceiveWorker( PVOID Context ) {
         NdisQueryPacketLength(IPPacket.NdisPacket, &IPPacket.TotalSize);
     }
 
+    /* Skip the checksums the adapter has already verified */
+    if (Interface->OffloadFlags & IP_OFFLOAD_RX_CHECKSUM)
+    {
+        ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket.NdisPacket,
+                                                                          TcpIpChecksumPacketInfo));
+
+        if (ChecksumInfo.Receive.NdisPacketIpChecksumSucceeded &&
+            (Interface->OffloadFlags & IP_OFFLOAD_RX_IP_CHECKSUM))
+            IPPacket.Flags |= IP_PACKET_FLAG_IP_CHECKSUM_OK;
+
+        if ((ChecksumInfo.Receive.NdisPacketTcpChecksumSucceeded &&
+             (Interface->OffloadFlags & IP_OFFLOAD_RX_TCP_CHECKSUM)) ||
+            (ChecksumInfo.Receive.NdisPacketUdpChecksumSucceeded &&
+             (Interface->OffloadFlags & IP_OFFLOAD_RX_UDP_CHECKSUM)))
+            IPPacket.Flags |= IP_PACKET_FLAG_L4_CHECKSUM_OK;
+    }
+
     TI_DbgPrint
 	(DEBUG_DATALINK,
 	 ("Ether Type = %x Total = %d\n",
@@ -485,7 +503,7 @@ NDIS_STATUS NTAPI ProtocolReceive(
     UINT BytesTransferred;
     PCHAR BufferData;
     NDIS_STATUS NdisStatus;
-    PNDIS_PACKET NdisPacket;
+    PNDIS_PACKET NdisPacket, ReceivedPacket;
     PLAN_ADAPTER Adapter = (PLAN_ADAPTER)BindingContext;
 
     TI_DbgPrint(DEBUG_DATALINK, ("Called. (packetsize %d)\n",PacketSize));
@@ -519,6 +537,11 @@ NDIS_STATUS NTAPI ProtocolReceive(
 
     PC(NdisPacket)->PacketType = PacketType;
 
+    /* Keep the checksum results of the adapter with the copy */
+    ReceivedPacket = NdisGetReceivedPacket(Adapter->NdisHandle, MacReceiveContext);
+    NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpIpChecksumPacketInfo) =
+        ReceivedPacket ? NDIS_PER_PACKET_INFO_FROM_PACKET(ReceivedPacket, TcpIpChecksumPacketInfo) : NULL;
+
     TI_DbgPrint(DEBUG_DATALINK, ("pretransfer LookaheadBufferSize %d packsize %d\n",LookaheadBufferSize,PacketSize));
 
     GetDataPtr( NdisPacket, 0, &BufferData, &PacketSize );
@@ -975,6 +998,7 @@ VOID LANTransmit(
     KIRQL OldIrql;
     PNDIS_PACKET XmitPacket;
     PIP_INTERFACE Interface = Adapter->Context;
+    PVOID ChecksumInfo, LargeSendInfo;
 
     TI_DbgPrint(DEBUG_DATALINK,
 		("Called( NdisPacket %x, Offset %d, Adapter %x )\n",
@@ -1006,6 +1030,16 @@ VOID LANTransmit(
 
     RtlCopyMemory(Data + Adapter->HeaderSize, OldData, OldSize);
 
+    /* Pass the offload requests on to the miniport */
+    ChecksumInfo = NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpIpChecksumPacketInfo);
+    LargeSendInfo = NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpLargeSendPacketInfo);
+    if (ChecksumInfo || LargeSendInfo)
+    {
+        NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpIpChecksumPacketInfo) = ChecksumInfo;
+        NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpLargeSendPacketInfo) = LargeSendInfo;
+        NdisSetPacketFlags(XmitPacket, NDIS_PROTOCOL_ID_TCP_IP);
+    }
+
     (*PC(NdisPacket)->DLComplete)(PC(NdisPacket)->Context, NdisPacket, NDIS_STATUS_SUCCESS);
 
     switch (Adapter->Media) {
@@ -1056,12 +1090,6 @@ VOID LANTransmit(
 		   ((PCHAR)LinkAddress)[5] & 0xff));
 	}
 
-    if (Adapter->MTU < Size) {
-        /* This is NOT a pointer. MSDN explicitly says so. */
-        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket,
-                                         TcpLargeSendPacketInfo) = (PVOID)((ULONG_PTR)Adapter->MTU);
-    }
-
     /* Update interface stats */
     Interface->Stats.OutBytes += Size;
 
@@ -1309,6 +1337,164 @@ VOID GetName( PUNICODE_STRING RegistryKey,
     AppendUnicodeString( OutName, &PartialRegistryKey, FALSE );
 }
 
+static VOID LANSetTaskOffload(
+    PLAN_ADAPTER Adapter,
+    PIP_INTERFACE IF)
+/*
+ * FUNCTION: Negotiates TCP/IP task offloads with the adapter
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ *     IF      = Pointer to the interface of the adapter
+ * NOTES:
+ *     IF->OffloadFlags is left zero unless the adapter accepted the
+ *     offloads we enabled, in which case everything is done in software
+ */
+{
+    ULONG Buffer[64];
+    PNDIS_TASK_OFFLOAD_HEADER Header = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    PNDIS_TASK_OFFLOAD Task;
+    PNDIS_TASK_TCP_IP_CHECKSUM ChecksumTask;
+    PNDIS_TASK_TCP_LARGE_SEND LargeSendTask;
+    NDIS_STATUS NdisStatus;
+    ULONG Offset, OffloadFlags = 0;
+    UINT LargeSendMaxSize = 0, LargeSendMinSegments = 0;
+
+    IF->OffloadFlags = 0;
+
+    if (Adapter->Media != NdisMedium802_3)
+        return;
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+    Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Header->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Header->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    Header->EncapsulationFormat.EncapsulationHeaderSize = Adapter->HeaderSize;
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestQueryInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          sizeof(Buffer));
+    if (NdisStatus != NDIS_STATUS_SUCCESS || Header->OffsetFirstTask == 0) {
+        TI_DbgPrint(DEBUG_DATALINK, ("No task offload support (0x%X).\n", NdisStatus));
+        return;
+    }
+
+    /* Pick the tasks we can use from the capabilities of the adapter */
+    Offset = Header->OffsetFirstTask;
+    while (Offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) <= sizeof(Buffer)) {
+        Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)Buffer + Offset);
+        if (Offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + Task->TaskBufferLength > sizeof(Buffer))
+            break;
+
+        if (Task->Task == TcpIpChecksumNdisTask &&
+            Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_IP_CHECKSUM)) {
+            ChecksumTask = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+
+            /* We send IP options and TCP options with any packet */
+            if (ChecksumTask->V4Transmit.IpOptionsSupported &&
+                ChecksumTask->V4Transmit.TcpOptionsSupported) {
+                if (ChecksumTask->V4Transmit.IpChecksum)
+                    OffloadFlags |= IP_OFFLOAD_TX_IP_CHECKSUM;
+                if (ChecksumTask->V4Transmit.TcpChecksum)
+                    OffloadFlags |= IP_OFFLOAD_TX_TCP_CHECKSUM;
+                if (ChecksumTask->V4Transmit.UdpChecksum)
+                    OffloadFlags |= IP_OFFLOAD_TX_UDP_CHECKSUM;
+            }
+
+            if (ChecksumTask->V4Receive.IpChecksum)
+                OffloadFlags |= IP_OFFLOAD_RX_IP_CHECKSUM;
+            if (ChecksumTask->V4Receive.TcpChecksum)
+                OffloadFlags |= IP_OFFLOAD_RX_TCP_CHECKSUM;
+            if (ChecksumTask->V4Receive.UdpChecksum)
+                OffloadFlags |= IP_OFFLOAD_RX_UDP_CHECKSUM;
+        } else if (Task->Task == TcpLargeSendNdisTask &&
+                   Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_LARGE_SEND)) {
+            LargeSendTask = (PNDIS_TASK_TCP_LARGE_SEND)Task->TaskBuffer;
+
+            if (LargeSendTask->TcpOptions && LargeSendTask->IpOptions &&
+                LargeSendTask->MaxOffLoadSize > IF->MTU) {
+                OffloadFlags |= IP_OFFLOAD_LARGE_SEND;
+                LargeSendMaxSize = LargeSendTask->MaxOffLoadSize;
+                LargeSendMinSegments = max(LargeSendTask->MinSegmentCount, 1);
+            }
+        }
+
+        if (Task->OffsetNextTask == 0)
+            break;
+        Offset += Task->OffsetNextTask;
+    }
+
+    /* The TCP header checksum of a large send is always left to the adapter */
+    if (!(OffloadFlags & IP_OFFLOAD_TX_TCP_CHECKSUM))
+        OffloadFlags &= ~IP_OFFLOAD_LARGE_SEND;
+
+    if (OffloadFlags == 0)
+        return;
+
+    /* Enable the tasks we picked */
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+    Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Header->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Header->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    Header->EncapsulationFormat.EncapsulationHeaderSize = Adapter->HeaderSize;
+    Header->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+
+    Task = (PNDIS_TASK_OFFLOAD)(Header + 1);
+    Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+    Task->Task = TcpIpChecksumNdisTask;
+    Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+
+    ChecksumTask = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+    ChecksumTask->V4Transmit.IpOptionsSupported = !!(OffloadFlags & (IP_OFFLOAD_TX_IP_CHECKSUM |
+                                                                     IP_OFFLOAD_TX_TCP_CHECKSUM |
+                                                                     IP_OFFLOAD_TX_UDP_CHECKSUM));
+    ChecksumTask->V4Transmit.TcpOptionsSupported = ChecksumTask->V4Transmit.IpOptionsSupported;
+    ChecksumTask->V4Transmit.IpChecksum = !!(OffloadFlags & IP_OFFLOAD_TX_IP_CHECKSUM);
+    ChecksumTask->V4Transmit.TcpChecksum = !!(OffloadFlags & IP_OFFLOAD_TX_TCP_CHECKSUM);
+    ChecksumTask->V4Transmit.UdpChecksum = !!(OffloadFlags & IP_OFFLOAD_TX_UDP_CHECKSUM);
+    ChecksumTask->V4Receive.IpOptionsSupported = !!(OffloadFlags & IP_OFFLOAD_RX_CHECKSUM);
+    ChecksumTask->V4Receive.TcpOptionsSupported = ChecksumTask->V4Receive.IpOptionsSupported;
+    ChecksumTask->V4Receive.IpChecksum = !!(OffloadFlags & IP_OFFLOAD_RX_IP_CHECKSUM);
+    ChecksumTask->V4Receive.TcpChecksum = !!(OffloadFlags & IP_OFFLOAD_RX_TCP_CHECKSUM);
+    ChecksumTask->V4Receive.UdpChecksum = !!(OffloadFlags & IP_OFFLOAD_RX_UDP_CHECKSUM);
+
+    if (OffloadFlags & IP_OFFLOAD_LARGE_SEND) {
+        Task->OffsetNextTask = FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+
+        Task = (PNDIS_TASK_OFFLOAD)(ChecksumTask + 1);
+        Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+        Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+        Task->Task = TcpLargeSendNdisTask;
+        Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_LARGE_SEND);
+
+        LargeSendTask = (PNDIS_TASK_TCP_LARGE_SEND)Task->TaskBuffer;
+        LargeSendTask->Version = 0;
+        LargeSendTask->MaxOffLoadSize = LargeSendMaxSize;
+        LargeSendTask->MinSegmentCount = LargeSendMinSegments;
+        LargeSendTask->TcpOptions = TRUE;
+        LargeSendTask->IpOptions = TRUE;
+    }
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestSetInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          sizeof(Buffer));
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(MIN_TRACE, ("Could not enable task offload (0x%X).\n", NdisStatus));
+        return;
+    }
+
+    TI_DbgPrint(DEBUG_DATALINK, ("Task offload flags 0x%X, large send %d bytes.\n",
+                                 OffloadFlags, LargeSendMaxSize));
+
+    IF->LargeSendMaxSize = LargeSendMaxSize;
+    IF->LargeSendMinSegments = LargeSendMinSegments;
+    IF->OffloadFlags = OffloadFlags;
+}
+
 BOOLEAN BindAdapter(
     PLAN_ADAPTER Adapter,
     PNDIS_STRING RegistryPath)
@@ -1410,6 +1596,9 @@ BOOLEAN BindAdapter(
     if (NdisStatus != NDIS_STATUS_SUCCESS)
         return FALSE;
 
+    /* Let the adapter take over checksums and segmentation where it can */
+    LANSetTaskOffload(Adapter, IF);
+
     /* Register interface with IP layer */
     IPRegisterInterface(IF);
 
@@ -7,7 +7,13 @@
 
 #pragma once
 
+/* Datagram address files hashed by protocol and port for receive */
+#define ADDRESS_FILE_HASH_SIZE  256
+#define ADDRESS_FILE_HASH(Port, Protocol) \
+    (((Port) ^ ((Port) >> 8) ^ (Protocol)) & (ADDRESS_FILE_HASH_SIZE - 1))
+
 extern LIST_ENTRY AddressFileListHead;
+extern LIST_ENTRY AddressFileHashTable[ADDRESS_FILE_HASH_SIZE];
 extern KSPIN_LOCK AddressFileListLock;
 extern LIST_ENTRY ConnectionEndpointListHead;
 extern KSPIN_LOCK ConnectionEndpointListLock;
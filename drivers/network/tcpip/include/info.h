@@ -8,6 +8,7 @@
 #pragma once
 
 #include <tcpioctl.h>
+#include <tcpip_undoc.h>
 /* FIXME */
 #define DWORD ULONG
 #include <in6addr.h>
@@ -67,6 +68,29 @@ typedef struct IPROUTE_ENTRY {
 
 #define TL_INSTANCE 0
 
+/* ReactOS specific: lwIP allocation counters, queried on the TCP entity */
+#define TCP_MEMORY_STATS_ID 0x1100
+
+#define LWIP_MEMORY_CLASSES 6
+
+typedef struct LWIP_MEMORY_CLASS_STATS {
+    ULONG BlockSize;
+    ULONG Allocations;
+    ULONG Frees;
+    ULONG Refills;          /* Batches moved from the depot to a processor */
+    ULONG Flushes;          /* Batches moved from a processor to the depot */
+    ULONG PoolAllocations;
+    ULONG PoolFrees;
+    ULONG Cached;           /* Free blocks held by processors and the depot */
+} LWIP_MEMORY_CLASS_STATS, *PLWIP_MEMORY_CLASS_STATS;
+
+typedef struct LWIP_MEMORY_STATS {
+    ULONG NumberOfProcessors;
+    ULONG LargeAllocations;
+    ULONG LargeFrees;
+    LWIP_MEMORY_CLASS_STATS Classes[LWIP_MEMORY_CLASSES];
+} LWIP_MEMORY_STATS, *PLWIP_MEMORY_STATS;
+
 
 typedef struct ADDRESS_INFO {
     ULONG LocalAddress;
@@ -130,6 +154,11 @@ TDI_STATUS InfoTdiQueryGetConnectionUdpTable( PADDRESS_FILE AddrFile,
                                               PUINT BufferSize,
                                               TDI_TCPUDP_CLASS_INFO Class);
 
+TDI_STATUS InfoTdiQueryGetMemoryStats( PNDIS_BUFFER Buffer,
+                                       PUINT BufferSize );
+
+VOID LibIPQueryMemoryStatistics(PLWIP_MEMORY_STATS Stats);
+
 TDI_STATUS InfoTdiSetRoute(PIP_INTERFACE IF,
                            PVOID Buffer,
                            UINT BufferSize);
@@ -66,6 +66,7 @@ typedef union _IP_HEADER {
 #define IPv4_MF_MASK            0x2000 /* More fragments (host byte order) */
 #define IPv4_DF_MASK            0x4000 /* Don't fragment (host byte order) */
 #define IPv4_MAX_HEADER_SIZE    60
+#define IPv4_MAX_DATAGRAM_SIZE  0xFFFF
 
 /* Packet completion handler prototype */
 typedef VOID (*PACKET_COMPLETION_ROUTINE)(
@@ -90,7 +91,9 @@ typedef struct _IP_PACKET {
     IP_ADDRESS DstAddr;                 /* Destination address */
 } IP_PACKET, *PIP_PACKET;
 
-#define IP_PACKET_FLAG_RAW      0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_RAW            0x01 /* Raw IP packet */
+#define IP_PACKET_FLAG_IP_CHECKSUM_OK 0x02 /* Adapter verified the IP header checksum */
+#define IP_PACKET_FLAG_L4_CHECKSUM_OK 0x04 /* Adapter verified the TCP/UDP checksum */
 
 
 /* Packet context */
@@ -168,8 +171,23 @@ typedef struct _IP_INTERFACE {
     LL_TRANSMIT_ROUTINE Transmit; /* Pointer to transmit function */
     PVOID TCPContext;             /* TCP Content for this interface */
     SEND_RECV_STATS Stats;        /* Send/Receive statistics */
+    ULONG OffloadFlags;           /* Task offloads enabled on the adapter (IP_OFFLOAD_xx) */
+    UINT  LargeSendMaxSize;       /* Largest large send the adapter accepts */
+    UINT  LargeSendMinSegments;   /* Fewest segments in a large send */
 } IP_INTERFACE, *PIP_INTERFACE;
 
+/* Interface task offload flags */
+#define IP_OFFLOAD_TX_IP_CHECKSUM   0x0001
+#define IP_OFFLOAD_TX_TCP_CHECKSUM  0x0002
+#define IP_OFFLOAD_TX_UDP_CHECKSUM  0x0004
+#define IP_OFFLOAD_RX_IP_CHECKSUM   0x0010
+#define IP_OFFLOAD_RX_TCP_CHECKSUM  0x0020
+#define IP_OFFLOAD_RX_UDP_CHECKSUM  0x0040
+#define IP_OFFLOAD_LARGE_SEND       0x0100
+#define IP_OFFLOAD_NO_CHECKSUM      0x0200 /* No checksums are needed at all (loopback) */
+
+#define IP_OFFLOAD_RX_CHECKSUM (IP_OFFLOAD_RX_IP_CHECKSUM | IP_OFFLOAD_RX_TCP_CHECKSUM | IP_OFFLOAD_RX_UDP_CHECKSUM)
+
 typedef struct _IP_SET_ADDRESS {
     ULONG NteIndex;
     IPv4_RAW_ADDRESS Address;
@@ -204,6 +222,7 @@ extern LIST_ENTRY InterfaceListHead;
 extern KSPIN_LOCK InterfaceListLock;
 extern LIST_ENTRY NetTableListHead;
 extern KSPIN_LOCK NetTableListLock;
+extern ULONG IpTimerExpirations;
 
 PIP_PACKET IPCreatePacket(
   ULONG Type);
@@ -18,4 +18,7 @@ NDIS_STATUS LoopRegisterAdapter(
 NDIS_STATUS LoopUnregisterAdapter(
     PLAN_ADAPTER Adapter);
 
+NTSTATUS LoopDeliverDatagram(
+    PIP_PACKET IPPacket);
+
 /* EOF */
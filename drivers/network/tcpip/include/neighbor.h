@@ -7,7 +7,11 @@
 
 #pragma once
 
-#define NB_HASHMASK 0xF /* Hash mask for neighbor cache */
+#define NB_LOCK_STRIPES    16    /* Number of lock stripes (power of two) */
+#define NB_INITIAL_BUCKETS 64    /* Initial number of hash buckets */
+#define NB_MAX_BUCKETS     16384 /* Maximum number of hash buckets */
+#define NB_LOAD_FACTOR     2     /* Average chain length that triggers growth */
+#define NB_WHEEL_SIZE      256   /* Slots in the timer wheel of each stripe */
 
 typedef VOID (*PNEIGHBOR_PACKET_COMPLETE)
     ( PVOID Context, PNDIS_PACKET Packet, NDIS_STATUS Status );
@@ -19,17 +23,37 @@ typedef struct _NEIGHBOR_PACKET {
     PVOID Context;
 } NEIGHBOR_PACKET, *PNEIGHBOR_PACKET;
 
+/* Neighbor cache statistics */
+typedef struct NEIGHBOR_CACHE_STATISTICS {
+    ULONG Entries;                      /* Number of NCEs in the cache */
+    ULONG Buckets;                      /* Number of hash buckets */
+    ULONG Resizes;                      /* Number of times the table grew */
+    ULONG Lookups;                      /* Number of lookups */
+    ULONG Hits;                         /* Number of successful lookups */
+    ULONG Additions;                    /* Number of NCEs added */
+    ULONG Removals;                     /* Number of NCEs removed */
+    ULONG Expirations;                  /* Number of NCEs that timed out */
+    ULONG TimerEvents;                  /* Number of timer wheel events handled */
+} NEIGHBOR_CACHE_STATISTICS, *PNEIGHBOR_CACHE_STATISTICS;
+
+/* Lock stripe of the neighbor cache. A NCE belongs to the stripe selected by
+ * the low bits of its hash value, so the stripe never changes when the table
+ * of hash buckets grows */
 typedef struct NEIGHBOR_CACHE_TABLE {
-    struct NEIGHBOR_CACHE_ENTRY *Cache; /* Pointer to cache */
     KSPIN_LOCK Lock;                    /* Protecting lock */
+    LIST_ENTRY Wheel[NB_WHEEL_SIZE];    /* Timer wheel of pending NCE events */
+    NEIGHBOR_CACHE_STATISTICS Statistics; /* Statistics of this stripe */
 } NEIGHBOR_CACHE_TABLE, *PNEIGHBOR_CACHE_TABLE;
 
 /* Information about a neighbor */
 typedef struct NEIGHBOR_CACHE_ENTRY {
     struct NEIGHBOR_CACHE_ENTRY *Next;  /* Pointer to next entry */
+    ULONG HashValue;                    /* Hash value of the IP address */
     UCHAR State;                        /* State of NCE */
-    UINT EventTimer;                    /* Ticks since last event */
-    UINT EventCount;                    /* Number of events */
+    UINT EventTimer;                    /* Ticks before the NCE times out */
+    ULONG EventStart;                   /* Tick of the last event */
+    ULONG TimerDue;                     /* Tick of the next timer wheel event */
+    LIST_ENTRY TimerListEntry;          /* Entry on the timer wheel */
     PIP_INTERFACE Interface;            /* Pointer to interface */
     UINT LinkAddressLength;             /* Length of link address */
     PVOID LinkAddress;                  /* Pointer to link address */
@@ -54,7 +78,7 @@ typedef struct NEIGHBOR_CACHE_ENTRY {
 /* Number of seconds before retransmission */
 #define ARP_TIMEOUT_RETRANSMISSION 3
 
-extern NEIGHBOR_CACHE_TABLE NeighborCache[NB_HASHMASK + 1];
+extern NEIGHBOR_CACHE_TABLE NeighborCache[NB_LOCK_STRIPES];
 
 
 VOID NBTimeout(
@@ -109,4 +133,7 @@ VOID NBResetNeighborTimeout(
 
 VOID NBDestroyNeighborsForInterface(PIP_INTERFACE Interface);
 
+VOID NBGetStatistics(
+    PNEIGHBOR_CACHE_STATISTICS Statistics);
+
 /* EOF */
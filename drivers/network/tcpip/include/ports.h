@@ -15,6 +15,7 @@ typedef struct _PORT_SET {
     PVOID ProtoBitBuffer;
     UINT StartingPort;
     UINT PortsToOversee;
+    ULONG Seed;             /* Picks where to start looking for a free port */
     KSPIN_LOCK Lock;
 } PORT_SET, *PPORT_SET;
 
@@ -12,6 +12,16 @@
 /* Number of seconds before destroying the IPDR */
 #define MAX_TIMEOUT_COUNT 3
 
+/* Number of buckets reassembly structures are hashed into */
+#define REASSEMBLY_HASH_SIZE 64
+
+/* Fragment data held by all datagrams being reassembled. Beyond it the
+   datagrams that have been waiting the longest are dropped */
+#define REASSEMBLY_MEMORY_LIMIT (256 * 1024)
+
+/* Most fragments a datagram may consist of */
+#define REASSEMBLY_MAX_FRAGMENTS 128
+
 /* IP datagram fragment descriptor. Used to store IP datagram fragments */
 typedef struct IP_FRAGMENT {
     LIST_ENTRY ListEntry; /* Entry on list */
@@ -22,35 +32,29 @@ typedef struct IP_FRAGMENT {
     UINT Size;            /* Size of this fragment */
 } IP_FRAGMENT, *PIP_FRAGMENT;
 
-/* IP datagram hole descriptor. Used to reassemble IP datagrams */
-typedef struct IPDATAGRAM_HOLE {
-    LIST_ENTRY ListEntry; /* Entry on list */
-    UINT First;           /* Offset of first octet of the hole */
-    UINT Last;            /* Offset of last octet of the hole */
-} IPDATAGRAM_HOLE, *PIPDATAGRAM_HOLE;
-
 /* IP datagram reassembly information */
 typedef struct IPDATAGRAM_REASSEMBLY {
-    LIST_ENTRY ListEntry;        /* Entry on list */
-    KSPIN_LOCK Lock;             /* Protecting spin lock */
-    UINT DataSize;               /* Size of datagram data area */
+    LIST_ENTRY ListEntry;        /* Entry on list, least recently updated first */
+    LIST_ENTRY HashEntry;        /* Entry on hash bucket */
+    UINT DataSize;               /* Size of datagram data area, 0 until the last fragment is in */
+    UINT ReceivedSize;           /* Size of the data received so far */
+    UINT FragmentCount;          /* Number of fragments in the fragment list */
     IP_ADDRESS SrcAddr;          /* Source address */
     IP_ADDRESS DstAddr;          /* Destination address */
     UCHAR Protocol;              /* Internet Protocol number */
     USHORT Id;                   /* Identification number */
     PIP_HEADER IPv4Header;       /* Pointer to IP header */
     UINT HeaderSize;             /* Length of IP header */
-    LIST_ENTRY FragmentListHead; /* IP fragment list */
-    LIST_ENTRY HoleListHead;     /* IP datagram hole list */
-    UINT TimeoutCount;           /* Timeout counter */
+    LIST_ENTRY FragmentListHead; /* IP fragment list, sorted by offset */
+    ULONG Deadline;              /* Value of IpTimerExpirations the datagram is dropped at */
 } IPDATAGRAM_REASSEMBLY, *PIPDATAGRAM_REASSEMBLY;
 
 
 extern LIST_ENTRY ReassemblyListHead;
+extern LIST_ENTRY ReassemblyHashTable[REASSEMBLY_HASH_SIZE];
 extern KSPIN_LOCK ReassemblyListLock;
 extern NPAGED_LOOKASIDE_LIST IPDRList;
 extern NPAGED_LOOKASIDE_LIST IPFragmentList;
-extern NPAGED_LOOKASIDE_LIST IPHoleList;
 
 
 VOID IPFreeReassemblyList(
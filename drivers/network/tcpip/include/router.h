@@ -10,6 +10,8 @@
 #include <neighbor.h>
 
 
+struct _FIB_NODE;
+
 /* Forward Information Base Entry */
 typedef struct _FIB_ENTRY {
     LIST_ENTRY ListEntry;         /* Entry on list */
@@ -18,8 +20,28 @@ typedef struct _FIB_ENTRY {
     IP_ADDRESS Netmask;           /* Netmask of network */
     PNEIGHBOR_CACHE_ENTRY Router; /* Pointer to NCE of router to use */
     UINT Metric;                  /* Cost of this route */
+    LIST_ENTRY NodeListEntry;     /* Entry on the list of routes of the prefix */
+    struct _FIB_NODE *Node;       /* Prefix trie node of an IPv4 route */
 } FIB_ENTRY, *PFIB_ENTRY;
 
+/* Prefix trie node, holding the IPv4 routes to a network */
+typedef struct _FIB_NODE {
+    struct _FIB_NODE *Parent;     /* Parent node, NULL for the root */
+    struct _FIB_NODE *Child[2];   /* Longer prefixes, by the next bit */
+    ULONG Prefix;                 /* Network prefix, in host order */
+    UINT Length;                  /* Length of the prefix in bits */
+    LIST_ENTRY RouteListHead;     /* Routes to this prefix, may be empty */
+} FIB_NODE, *PFIB_NODE;
+
+/* Per destination route cache */
+#define ROUTE_CACHE_SIZE 256      /* Must be a power of two */
+
+typedef struct _ROUTE_CACHE_ENTRY {
+    ULONG Destination;            /* IPv4 destination address */
+    ULONG Generation;             /* Valid while equal to the FIB generation */
+    PNEIGHBOR_CACHE_ENTRY Router; /* Router selected for the destination */
+} ROUTE_CACHE_ENTRY, *PROUTE_CACHE_ENTRY;
+
 PFIB_ENTRY RouterAddRoute(
     PIP_ADDRESS NetworkAddress,
     PIP_ADDRESS Netmask,
@@ -19,10 +19,10 @@
 #define IP_INTERFACE_TAG 'FIPI'
 #define DATAGRAM_REASSEMBLY_TAG 'RDPI'
 #define DATAGRAM_FRAGMENT_TAG 'GFPI'
-#define DATAGRAM_HOLE_TAG 'LHPI'
 #define OSKITTCP_CONTEXT_TAG 'TKSO'
 #define NEIGHBOR_PACKET_TAG 'kPbN'
 #define NCE_TAG ' ECN'
+#define NCE_TABLE_TAG 'TECN'
 #define PORT_SET_TAG 'teSP'
 #define PACKET_BUFFER_TAG 'fuBP'
 #define FRAGMENT_DATA_TAG 'taDF'
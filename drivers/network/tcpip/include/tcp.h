@@ -188,6 +188,10 @@ BOOLEAN TCPRemoveIRP( PCONNECTION_ENDPOINT Connection, PIRP Irp );
 
 NTSTATUS TCPSetNoDelay(PCONNECTION_ENDPOINT Connection, BOOLEAN Set);
 
+NTSTATUS TCPSetReceiveWindow(PCONNECTION_ENDPOINT Connection, ULONG Size);
+
+NTSTATUS TCPSetSendBuffer(PCONNECTION_ENDPOINT Connection, ULONG Size);
+
 VOID
 TCPUpdateInterfaceLinkStatus(PIP_INTERFACE IF);
 
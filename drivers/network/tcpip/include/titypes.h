@@ -111,6 +111,7 @@ typedef struct _DATAGRAM_SEND_REQUEST {
    field holds a pointer to this structure */
 typedef struct _ADDRESS_FILE {
     LIST_ENTRY ListEntry;                 /* Entry on list */
+    LIST_ENTRY HashEntry;                 /* Entry on receive hash bucket */
     LONG RefCount;                        /* Reference count */
     OBJECT_FREE_ROUTINE Free;             /* Routine to use to free resources for the object */
     ERESOURCE Resource;                   /* Resource to manipulate this structure */
@@ -181,6 +182,7 @@ typedef struct _ADDRESS_FILE {
 
 /* Structure used to search through Address Files */
 typedef struct _AF_SEARCH {
+    PLIST_ENTRY Head;       /* Hash bucket being searched */
     PLIST_ENTRY Next;       /* Next address file to check */
     PIP_ADDRESS Address;    /* Pointer to address to be found */
     USHORT Port;            /* Network port */
@@ -266,6 +268,16 @@ typedef struct _CONNECTION_ENDPOINT {
     NTSTATUS ReceiveShutdownStatus;
     BOOLEAN Closing;
 
+    /* Buffer tuning */
+    ULONG ReceiveWindowLimit;  /* Receive window set by the client (0 to autotune) */
+    ULONG SendBufferLimit;     /* Send buffer set by the client (0 to autotune) */
+    ULONG SendBufferSize;      /* Current send buffer size of the PCB (0 for the default) */
+    ULONG ReceiveRttSeq;       /* Right window edge which ends the receive RTT sample */
+    ULONG ReceiveRttTime;      /* Time the receive RTT sample started */
+    ULONG ReceiveRtt;          /* Smallest receive RTT sample in ms (0 if none yet) */
+    ULONG ReceiveSpaceSeq;     /* Sequence number the throughput sample started at */
+    ULONG ReceiveSpaceTime;    /* Time the throughput sample started */
+
     struct _CONNECTION_ENDPOINT *Next; /* Next connection in address file list */
 } CONNECTION_ENDPOINT, *PCONNECTION_ENDPOINT;
 
@@ -9,7 +9,8 @@ sys_shutdown(void);
 void
 LibIPInsertPacket(void *ifarg,
                   const void *const data,
-                  const u32_t size)
+                  const u32_t size,
+                  const u8_t checksum_ok)
 {
     struct pbuf *p;
 
@@ -25,6 +26,12 @@ LibIPInsertPacket(void *ifarg,
 
         RtlCopyMemory(p->payload, data, p->len);
 
+        /* IPv4Receive has validated the IP header, the adapter may have
+         * validated the TCP checksum too */
+        p->flags |= PBUF_FLAG_IP_CHKSUM_OK;
+        if (checksum_ok)
+            p->flags |= PBUF_FLAG_L4_CHKSUM_OK;
+
         ((PNETIF)ifarg)->input(p, (PNETIF)ifarg);
     }
 }
@@ -32,6 +39,8 @@ LibIPInsertPacket(void *ifarg,
 void
 LibIPInitialize(void)
 {
+    LibIPInitializeMemory();
+
     /* This completes asynchronously */
     tcpip_init(NULL, NULL);
 }
@@ -41,4 +50,6 @@ LibIPShutdown(void)
 {
     /* This is synchronous */
     sys_shutdown();
+
+    LibIPShutdownMemory();
 }
\ No newline at end of file
@@ -12,6 +12,10 @@
     #define LWIP_QUEUE_TAG   'uQwl'
 #endif
 
+/* Limits of the receive window and send buffer autotuning */
+#define LIBTCP_MAX_RECEIVE_WINDOW   (0xFFFFUL << TCP_RCV_SCALE)
+#define LIBTCP_MAX_SEND_BUFFER      TCP_SND_BUF_MAX
+
 typedef struct tcp_pcb* PTCP_PCB;
 
 typedef struct _QUEUE_ENTRY
@@ -46,7 +50,7 @@ struct lwip_callback_msg
         struct {
             PCONNECTION_ENDPOINT Connection;
             void *Data;
-            u16_t DataLength;
+            u32_t DataLength;
         } Send;
         struct {
             PCONNECTION_ENDPOINT Connection;
@@ -62,6 +66,10 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             int Callback;
         } Close;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            u32_t Size;
+        } SetBuffer;
     } Input;
 
     /* Output */
@@ -88,6 +96,9 @@ struct lwip_callback_msg
         struct {
             err_t Error;
         } Close;
+        struct {
+            err_t Error;
+        } SetBuffer;
     } Output;
 };
 
@@ -105,7 +116,7 @@ PTCP_PCB    LibTCPSocket(void *arg);
 VOID        LibTCPFreeSocket(PTCP_PCB pcb);
 err_t       LibTCPBind(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 PTCP_PCB    LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog);
-err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, u32_t *sent, const int safe);
+err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u32_t len, u32_t *sent, const int safe);
 err_t       LibTCPConnect(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 err_t       LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shut_tx);
 err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback);
@@ -114,11 +125,17 @@ err_t       LibTCPGetPeerName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t
 err_t       LibTCPGetHostName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
 void        LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg);
 void        LibTCPSetNoDelay(PTCP_PCB pcb, BOOLEAN Set);
+err_t       LibTCPSetReceiveWindow(PCONNECTION_ENDPOINT Connection, const u32_t size);
+err_t       LibTCPSetSendBuffer(PCONNECTION_ENDPOINT Connection, const u32_t size);
 void        LibTCPGetSocketStatus(PTCP_PCB pcb, PULONG State);
 
 /* IP functions */
-void LibIPInsertPacket(void *ifarg, const void *const data, const u32_t size);
+void LibIPInsertPacket(void *ifarg, const void *const data, const u32_t size, const u8_t checksum_ok);
 void LibIPInitialize(void);
 void LibIPShutdown(void);
 
+/* Memory functions */
+void LibIPInitializeMemory(void);
+void LibIPShutdownMemory(void);
+
 #endif
@@ -4,10 +4,287 @@
     #define LWIP_TAG 'PIwl'
 #endif
 
+/* Every pbuf and segment lwIP allocates comes through here. Small blocks are
+ * kept in per-processor free lists backed by a global depot, so that packet
+ * processing on several processors does not serialise on the pool */
+#define MEMORY_CACHE_DEPTH  64      /* Free blocks a processor keeps per class */
+#define MEMORY_DEPOT_DEPTH  256     /* Free blocks the depot keeps per class */
+#define MEMORY_BATCH_SIZE   16      /* Blocks moved between a processor and the depot at once */
+
+#define MEMORY_CLASS_LARGE  ((ULONG)-1)
+
+static const ULONG MemoryClassSize[LWIP_MEMORY_CLASSES] = { 64, 128, 256, 512, 1024, 2048 };
+
+/* Precedes every block handed out to lwIP */
+typedef union _MEMORY_BLOCK
+{
+    SLIST_ENTRY Entry;          /* While the block is in a free list */
+    struct
+    {
+        ULONG Class;
+        ULONG Size;
+    } Header;                   /* While lwIP owns the block */
+} MEMORY_BLOCK, *PMEMORY_BLOCK;
+
+C_ASSERT(sizeof(MEMORY_BLOCK) % MEMORY_ALLOCATION_ALIGNMENT == 0);
+
+typedef struct _MEMORY_COUNTERS
+{
+    LONG Allocations;
+    LONG Frees;
+    LONG Refills;
+    LONG Flushes;
+    LONG PoolAllocations;
+    LONG PoolFrees;
+} MEMORY_COUNTERS, *PMEMORY_COUNTERS;
+
+/* One per processor, on its own cache line */
+typedef struct DECLSPEC_CACHEALIGN _MEMORY_CACHE
+{
+    SLIST_HEADER FreeList[LWIP_MEMORY_CLASSES];
+    MEMORY_COUNTERS Counters[LWIP_MEMORY_CLASSES];
+} MEMORY_CACHE, *PMEMORY_CACHE;
+
+static PMEMORY_CACHE MemoryCaches;
+static ULONG MemoryCacheCount;
+static SLIST_HEADER MemoryDepot[LWIP_MEMORY_CLASSES];
+static LONG MemoryLargeAllocations;
+static LONG MemoryLargeFrees;
+
+static
+ULONG
+MemoryGetClass(SIZE_T size)
+{
+    ULONG i;
+
+    for (i = 0; i < LWIP_MEMORY_CLASSES; i++)
+    {
+        if (size <= MemoryClassSize[i])
+            return i;
+    }
+
+    return MEMORY_CLASS_LARGE;
+}
+
+static
+PMEMORY_CACHE
+MemoryGetCache(void)
+{
+    return &MemoryCaches[KeGetCurrentProcessorNumber() % MemoryCacheCount];
+}
+
+static
+PMEMORY_BLOCK
+MemoryAllocatePoolBlock(ULONG class, SIZE_T size)
+{
+    PMEMORY_BLOCK block;
+
+    block = ExAllocatePoolWithTag(NonPagedPool, sizeof(MEMORY_BLOCK) + size, LWIP_TAG);
+    if (!block) return NULL;
+
+    block->Header.Class = class;
+    block->Header.Size = (ULONG)size;
+
+    return block;
+}
+
+/* Moves a batch of free blocks from the depot to a processor cache.
+ * Returns one of them to the caller */
+static
+PMEMORY_BLOCK
+MemoryRefill(PMEMORY_CACHE cache, ULONG class)
+{
+    PMEMORY_BLOCK block;
+    PSLIST_ENTRY entry;
+    ULONG i;
+
+    block = (PMEMORY_BLOCK)InterlockedPopEntrySList(&MemoryDepot[class]);
+    if (!block) return NULL;
+
+    for (i = 1; i < MEMORY_BATCH_SIZE; i++)
+    {
+        entry = InterlockedPopEntrySList(&MemoryDepot[class]);
+        if (!entry) break;
+
+        InterlockedPushEntrySList(&cache->FreeList[class], entry);
+    }
+
+    InterlockedIncrement(&cache->Counters[class].Refills);
+
+    return block;
+}
+
+/* Moves a batch of free blocks from a processor cache to the depot, or back
+ * to the pool once the depot is full */
+static
+void
+MemoryFlush(PMEMORY_CACHE cache, ULONG class)
+{
+    PSLIST_ENTRY entry;
+    ULONG i;
+
+    for (i = 0; i < MEMORY_BATCH_SIZE; i++)
+    {
+        entry = InterlockedPopEntrySList(&cache->FreeList[class]);
+        if (!entry) break;
+
+        if (ExQueryDepthSList(&MemoryDepot[class]) < MEMORY_DEPOT_DEPTH)
+        {
+            InterlockedPushEntrySList(&MemoryDepot[class], entry);
+        }
+        else
+        {
+            ExFreePoolWithTag(entry, LWIP_TAG);
+            InterlockedIncrement(&cache->Counters[class].PoolFrees);
+        }
+    }
+
+    InterlockedIncrement(&cache->Counters[class].Flushes);
+}
+
+static
+void
+MemoryDrainList(PSLIST_HEADER list)
+{
+    PSLIST_ENTRY entry;
+
+    while ((entry = InterlockedPopEntrySList(list)) != NULL)
+    {
+        ExFreePoolWithTag(entry, LWIP_TAG);
+    }
+}
+
+void
+LibIPInitializeMemory(void)
+{
+    ULONG i, j;
+
+    for (i = 0; i < LWIP_MEMORY_CLASSES; i++)
+    {
+        InitializeSListHead(&MemoryDepot[i]);
+    }
+
+    MemoryCacheCount = KeNumberProcessors;
+
+    /* Without the caches every block comes from the pool */
+    MemoryCaches = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                         MemoryCacheCount * sizeof(MEMORY_CACHE),
+                                         LWIP_TAG);
+    if (!MemoryCaches) return;
+
+    RtlZeroMemory(MemoryCaches, MemoryCacheCount * sizeof(MEMORY_CACHE));
+
+    for (i = 0; i < MemoryCacheCount; i++)
+    {
+        for (j = 0; j < LWIP_MEMORY_CLASSES; j++)
+        {
+            InitializeSListHead(&MemoryCaches[i].FreeList[j]);
+        }
+    }
+}
+
+void
+LibIPShutdownMemory(void)
+{
+    PMEMORY_CACHE caches = MemoryCaches;
+    ULONG i, j;
+
+    if (!caches) return;
+
+    /* lwIP is stopped, blocks freed from now on go straight to the pool */
+    MemoryCaches = NULL;
+
+    for (i = 0; i < MemoryCacheCount; i++)
+    {
+        for (j = 0; j < LWIP_MEMORY_CLASSES; j++)
+        {
+            MemoryDrainList(&caches[i].FreeList[j]);
+        }
+    }
+
+    for (i = 0; i < LWIP_MEMORY_CLASSES; i++)
+    {
+        MemoryDrainList(&MemoryDepot[i]);
+    }
+
+    ExFreePoolWithTag(caches, LWIP_TAG);
+}
+
+VOID
+LibIPQueryMemoryStatistics(PLWIP_MEMORY_STATS Stats)
+{
+    PMEMORY_CACHE caches = MemoryCaches;
+    PLWIP_MEMORY_CLASS_STATS classStats;
+    PMEMORY_COUNTERS counters;
+    ULONG i, j;
+
+    RtlZeroMemory(Stats, sizeof(*Stats));
+
+    Stats->NumberOfProcessors = caches ? MemoryCacheCount : 0;
+    Stats->LargeAllocations = MemoryLargeAllocations;
+    Stats->LargeFrees = MemoryLargeFrees;
+
+    for (i = 0; i < LWIP_MEMORY_CLASSES; i++)
+    {
+        classStats = &Stats->Classes[i];
+        classStats->BlockSize = MemoryClassSize[i];
+        classStats->Cached = ExQueryDepthSList(&MemoryDepot[i]);
+
+        if (!caches) continue;
+
+        for (j = 0; j < MemoryCacheCount; j++)
+        {
+            counters = &caches[j].Counters[i];
+
+            classStats->Allocations += counters->Allocations;
+            classStats->Frees += counters->Frees;
+            classStats->Refills += counters->Refills;
+            classStats->Flushes += counters->Flushes;
+            classStats->PoolAllocations += counters->PoolAllocations;
+            classStats->PoolFrees += counters->PoolFrees;
+            classStats->Cached += ExQueryDepthSList(&caches[j].FreeList[i]);
+        }
+    }
+}
+
 void *
 malloc(mem_size_t size)
 {
-    return ExAllocatePoolWithTag(NonPagedPool, size, LWIP_TAG);
+    PMEMORY_CACHE cache;
+    PMEMORY_BLOCK block;
+    ULONG class;
+
+    class = MemoryGetClass(size);
+
+    if (class == MEMORY_CLASS_LARGE || !MemoryCaches)
+    {
+        block = MemoryAllocatePoolBlock(MEMORY_CLASS_LARGE, size);
+        if (!block) return NULL;
+
+        InterlockedIncrement(&MemoryLargeAllocations);
+
+        return block + 1;
+    }
+
+    cache = MemoryGetCache();
+    InterlockedIncrement(&cache->Counters[class].Allocations);
+
+    block = (PMEMORY_BLOCK)InterlockedPopEntrySList(&cache->FreeList[class]);
+    if (!block)
+        block = MemoryRefill(cache, class);
+
+    if (!block)
+    {
+        block = MemoryAllocatePoolBlock(class, MemoryClassSize[class]);
+        if (!block) return NULL;
+
+        InterlockedIncrement(&cache->Counters[class].PoolAllocations);
+    }
+
+    block->Header.Class = class;
+    block->Header.Size = size;
+
+    return block + 1;
 }
 
 void *
@@ -25,13 +302,45 @@ calloc(mem_size_t count, mem_size_t size)
 void
 free(void *mem)
 {
-    ExFreePoolWithTag(mem, LWIP_TAG);
+    PMEMORY_CACHE cache;
+    PMEMORY_BLOCK block;
+    ULONG class;
+
+    if (!mem) return;
+
+    block = (PMEMORY_BLOCK)mem - 1;
+    class = block->Header.Class;
+
+    if (class == MEMORY_CLASS_LARGE)
+    {
+        InterlockedIncrement(&MemoryLargeFrees);
+        ExFreePoolWithTag(block, LWIP_TAG);
+        return;
+    }
+
+    ASSERT(class < LWIP_MEMORY_CLASSES);
+
+    if (!MemoryCaches)
+    {
+        ExFreePoolWithTag(block, LWIP_TAG);
+        return;
+    }
+
+    cache = MemoryGetCache();
+    InterlockedIncrement(&cache->Counters[class].Frees);
+
+    InterlockedPushEntrySList(&cache->FreeList[class], &block->Entry);
+
+    if (ExQueryDepthSList(&cache->FreeList[class]) > MEMORY_CACHE_DEPTH)
+        MemoryFlush(cache, class);
 }
 
 /* This is only used to trim in lwIP */
 void *
 realloc(void *mem, size_t size)
 {
+    PMEMORY_BLOCK block;
+    ULONG capacity;
     void* new_mem;
 
     /* realloc() with a NULL mem pointer acts like a call to malloc() */
@@ -45,6 +354,15 @@ realloc(void *mem, size_t size)
         return NULL;
     }
 
+    /* Trimming a block keeps it where it is */
+    block = (PMEMORY_BLOCK)mem - 1;
+    capacity = (block->Header.Class == MEMORY_CLASS_LARGE) ?
+               block->Header.Size : MemoryClassSize[block->Header.Class];
+    if (size <= capacity) {
+        block->Header.Size = (ULONG)size;
+        return mem;
+    }
+
     /* Allocate the new buffer first */
     new_mem = malloc(size);
     if (new_mem == NULL) {
@@ -53,11 +371,11 @@ realloc(void *mem, size_t size)
     }
 
     /* Copy the data over */
-    RtlCopyMemory(new_mem, mem, size);
+    RtlCopyMemory(new_mem, mem, block->Header.Size);
 
     /* Deallocate the old buffer */
     free(mem);
 
     /* Return the newly allocated block */
     return new_mem;
-}
\ No newline at end of file
+}
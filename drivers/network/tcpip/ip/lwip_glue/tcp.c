@@ -196,6 +196,96 @@ WaitForEventSafely(PRKEVENT Event)
     }
 }
 
+static
+void
+LibTCPApplyReceiveWindow(PCONNECTION_ENDPOINT Connection, PTCP_PCB pcb)
+{
+    tcpwnd_size_t InUse;
+
+    /* Listening PCBs have no receive window */
+    if (pcb->state == LISTEN || Connection->ReceiveWindowLimit == 0)
+        return;
+
+    /* Keep the data the application has not read yet accounted for */
+    InUse = TCP_WND_MAX(pcb) - pcb->rcv_wnd;
+    pcb->rcv_wnd_max = MIN(MAX(Connection->ReceiveWindowLimit, 2 * TCP_MSS), LIBTCP_MAX_RECEIVE_WINDOW);
+    pcb->rcv_wnd = (TCP_WND_MAX(pcb) > InUse) ? TCP_WND_MAX(pcb) - InUse : 0;
+
+    /* Announce the new window if it is significantly larger */
+    if (pcb->state >= ESTABLISHED)
+        tcp_recved(pcb, 0);
+}
+
+static
+void
+LibTCPTuneReceiveWindow(PCONNECTION_ENDPOINT Connection, PTCP_PCB pcb)
+{
+    tcpwnd_size_t NewMax;
+    u32_t Now, Received;
+
+    /* Don't touch a window set by the client */
+    if (Connection->ReceiveWindowLimit != 0 || !(pcb->flags & TF_WND_SCALE))
+        return;
+
+    Now = sys_now();
+
+    /* Estimate the round trip time as the time the peer needs to fill the
+     * window we announced. This is exact for a window limited sender and too
+     * long otherwise, so keep the smallest sample. */
+    if (Connection->ReceiveRttTime == 0 || (s32_t)(pcb->rcv_nxt - Connection->ReceiveRttSeq) >= 0)
+    {
+        if (Connection->ReceiveRttTime != 0)
+        {
+            u32_t Sample = MAX(Now - Connection->ReceiveRttTime, 1);
+
+            if (Connection->ReceiveRtt == 0 || Sample < Connection->ReceiveRtt)
+                Connection->ReceiveRtt = Sample;
+        }
+
+        Connection->ReceiveRttSeq = pcb->rcv_nxt + pcb->rcv_wnd;
+        Connection->ReceiveRttTime = Now;
+    }
+
+    if (Connection->ReceiveSpaceTime == 0)
+    {
+        Connection->ReceiveSpaceSeq = pcb->rcv_nxt;
+        Connection->ReceiveSpaceTime = Now;
+        return;
+    }
+
+    if (Connection->ReceiveRtt == 0 || Now - Connection->ReceiveSpaceTime < Connection->ReceiveRtt)
+        return;
+
+    /* If the peer sent (nearly) a whole window in one round trip, the window
+     * and not the path limits the throughput. Make it twice as large as what
+     * arrived so the sender can keep growing its congestion window. */
+    Received = pcb->rcv_nxt - Connection->ReceiveSpaceSeq;
+    Connection->ReceiveSpaceSeq = pcb->rcv_nxt;
+    Connection->ReceiveSpaceTime = Now;
+
+    if (Received < pcb->rcv_wnd_max - pcb->rcv_wnd_max / 4 ||
+        pcb->rcv_wnd_max >= LIBTCP_MAX_RECEIVE_WINDOW)
+        return;
+
+    NewMax = MIN(MAX(2 * Received, pcb->rcv_wnd_max), LIBTCP_MAX_RECEIVE_WINDOW);
+    pcb->rcv_wnd += NewMax - pcb->rcv_wnd_max;
+    pcb->rcv_wnd_max = NewMax;
+}
+
+static
+void
+LibTCPGrowSendBuffer(PCONNECTION_ENDPOINT Connection, PTCP_PCB pcb, u32_t Size)
+{
+    u32_t Current = Connection->SendBufferSize ? Connection->SendBufferSize : TCP_SND_BUF;
+
+    /* lwIP can't take back buffer space which is in use, so only grow it */
+    if (Size <= Current)
+        return;
+
+    pcb->snd_buf += Size - Current;
+    Connection->SendBufferSize = Size;
+}
+
 static
 err_t
 InternalSendEventHandler(void *arg, PTCP_PCB pcb, const u16_t space)
@@ -227,6 +317,7 @@ InternalRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t er
     {
         LibTCPEnqueuePacket(Connection, p);
 
+        LibTCPTuneReceiveWindow(Connection, pcb);
         tcp_recved(pcb, p->tot_len);
 
         TCPRecvEventHandler(arg);
@@ -498,8 +589,9 @@ void
 LibTCPSendCallback(void *arg)
 {
     struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.Send.Connection;
     PTCP_PCB pcb = msg->Input.Send.Connection->SocketContext;
-    ULONG SendLength;
+    ULONG SendLength, BufferSize;
     UCHAR SendFlags;
 
     ASSERT(msg);
@@ -518,6 +610,22 @@ LibTCPSendCallback(void *arg)
 
     SendFlags = TCP_WRITE_FLAG_COPY;
     SendLength = msg->Input.Send.DataLength;
+    if (SendLength > 0xFFFF)
+    {
+        /* tcp_write takes an u16_t, the rest is sent on the next call */
+        SendLength = 0xFFFF;
+        SendFlags |= TCP_WRITE_FLAG_MORE;
+    }
+
+    if (tcp_sndbuf(pcb) < SendLength && Connection->SendBufferLimit == 0)
+    {
+        /* The buffer is full. Grow it if the peer could take more data
+         * than we buffer, as the buffer limits the throughput then */
+        BufferSize = Connection->SendBufferSize ? Connection->SendBufferSize : TCP_SND_BUF;
+        if (pcb->snd_wnd_max > BufferSize && BufferSize < LIBTCP_MAX_SEND_BUFFER)
+            LibTCPGrowSendBuffer(Connection, pcb, MIN(BufferSize * 2, LIBTCP_MAX_SEND_BUFFER));
+    }
+
     if (tcp_sndbuf(pcb) == 0)
     {
         /* No buffer space so return pending */
@@ -554,7 +662,7 @@ done:
 }
 
 err_t
-LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, u32_t *sent, const int safe)
+LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u32_t len, u32_t *sent, const int safe)
 {
     err_t ret;
     struct lwip_callback_msg *msg;
@@ -829,6 +937,8 @@ LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback)
 void
 LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
 {
+    PCONNECTION_ENDPOINT Connection = arg;
+
     ASSERT(arg);
 
     tcp_arg(pcb, NULL);
@@ -837,6 +947,15 @@ LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
     tcp_err(pcb, InternalErrorEventHandler);
     tcp_arg(pcb, arg);
 
+    /* Apply the buffer sizes of the connection to the new PCB */
+    Connection->SendBufferSize = 0;
+    Connection->ReceiveRtt = 0;
+    Connection->ReceiveRttTime = 0;
+    Connection->ReceiveSpaceTime = 0;
+    LibTCPApplyReceiveWindow(Connection, pcb);
+    if (Connection->SendBufferLimit != 0)
+        LibTCPGrowSendBuffer(Connection, pcb, MIN(Connection->SendBufferLimit, LIBTCP_MAX_SEND_BUFFER));
+
     tcp_accepted(listen_pcb);
 }
 
@@ -875,6 +994,112 @@ LibTCPSetNoDelay(
         pcb->flags &= ~TF_NODELAY;
 }
 
+static
+void
+LibTCPSetReceiveWindowCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.SetBuffer.Connection;
+
+    ASSERT(msg);
+
+    if (!Connection->SocketContext)
+    {
+        msg->Output.SetBuffer.Error = ERR_CLSD;
+        goto done;
+    }
+
+    Connection->ReceiveWindowLimit = msg->Input.SetBuffer.Size;
+    LibTCPApplyReceiveWindow(Connection, Connection->SocketContext);
+    msg->Output.SetBuffer.Error = ERR_OK;
+
+done:
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+/* Sets the receive window of the connection. A size of 0 restores the autotuning */
+err_t
+LibTCPSetReceiveWindow(PCONNECTION_ENDPOINT Connection, const u32_t size)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.SetBuffer.Connection = Connection;
+        msg->Input.SetBuffer.Size = size;
+
+        tcpip_callback_with_block(LibTCPSetReceiveWindowCallback, msg, 1);
+
+        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.SetBuffer.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
+static
+void
+LibTCPSetSendBufferCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.SetBuffer.Connection;
+    PTCP_PCB pcb = Connection->SocketContext;
+
+    ASSERT(msg);
+
+    if (!pcb)
+    {
+        msg->Output.SetBuffer.Error = ERR_CLSD;
+        goto done;
+    }
+
+    Connection->SendBufferLimit = msg->Input.SetBuffer.Size;
+    if (Connection->SendBufferLimit != 0 && pcb->state != LISTEN)
+        LibTCPGrowSendBuffer(Connection, pcb, MIN(Connection->SendBufferLimit, LIBTCP_MAX_SEND_BUFFER));
+    msg->Output.SetBuffer.Error = ERR_OK;
+
+done:
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+/* Sets the send buffer of the connection. A size of 0 restores the autotuning */
+err_t
+LibTCPSetSendBuffer(PCONNECTION_ENDPOINT Connection, const u32_t size)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.SetBuffer.Connection = Connection;
+        msg->Input.SetBuffer.Size = size;
+
+        tcpip_callback_with_block(LibTCPSetSendBufferCallback, msg, 1);
+
+        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.SetBuffer.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
 void
 LibTCPGetSocketStatus(
     PTCP_PCB pcb,
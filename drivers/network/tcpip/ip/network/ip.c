@@ -436,15 +436,6 @@ NTSTATUS IPStartup(PUNICODE_STRING RegistryPath)
 	    DATAGRAM_FRAGMENT_TAG,          /* Tag */
 	    0);                             /* Depth */
 
-    ExInitializeNPagedLookasideList(
-      &IPHoleList,                    /* Lookaside list */
-	    NULL,                           /* Allocate routine */
-	    NULL,                           /* Free routine */
-	    0,                              /* Flags */
-	    sizeof(IPDATAGRAM_HOLE),        /* Size of each entry */
-	    DATAGRAM_HOLE_TAG,              /* Tag */
-	    0);                             /* Depth */
-
     /* Start routing subsystem */
     RouterStartup();
 
@@ -462,6 +453,8 @@ NTSTATUS IPStartup(PUNICODE_STRING RegistryPath)
 
     /* Initialize reassembly list and protecting lock */
     InitializeListHead(&ReassemblyListHead);
+    for (i = 0; i < REASSEMBLY_HASH_SIZE; i++)
+        InitializeListHead(&ReassemblyHashTable[i]);
     TcpipInitializeSpinLock(&ReassemblyListLock);
 
     IPInitialized = TRUE;
@@ -492,7 +485,6 @@ NTSTATUS IPShutdown(
     IPFreeReassemblyList();
 
     /* Destroy lookaside lists */
-    ExDeleteNPagedLookasideList(&IPHoleList);
     ExDeleteNPagedLookasideList(&IPDRList);
     ExDeleteNPagedLookasideList(&IPFragmentList);
 
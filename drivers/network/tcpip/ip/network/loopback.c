@@ -10,17 +10,128 @@
 
 #include "precomp.h"
 
+/* Packet waiting on the loopback queue */
+typedef struct _LOOP_PACKET {
+  LIST_ENTRY ListEntry;
+  IP_PACKET IPPacket;
+} LOOP_PACKET, *PLOOP_PACKET;
+
 PIP_INTERFACE Loopback = NULL;
 
+/* Packets are received in the order they were sent by a single worker */
+static LIST_ENTRY LoopQueue;
+static KSPIN_LOCK LoopQueueLock;
+static BOOLEAN LoopWorkerQueued = FALSE;
+
 VOID LoopPassiveWorker(
   PVOID Context)
+/*
+ * FUNCTION: Receives the packets on the loopback queue
+ * ARGUMENTS:
+ *   Context = Unused
+ */
+{
+  PLIST_ENTRY Entry;
+  PLOOP_PACKET LoopPacket;
+  KIRQL OldIrql;
+
+  for (;;)
+    {
+      KeAcquireSpinLock(&LoopQueueLock, &OldIrql);
+      if (IsListEmpty(&LoopQueue))
+        {
+          LoopWorkerQueued = FALSE;
+          KeReleaseSpinLock(&LoopQueueLock, OldIrql);
+          break;
+        }
+      Entry = RemoveHeadList(&LoopQueue);
+      KeReleaseSpinLock(&LoopQueueLock, OldIrql);
+
+      LoopPacket = CONTAINING_RECORD(Entry, LOOP_PACKET, ListEntry);
+
+      /* IPReceive() takes care of the NDIS packet */
+      if (Loopback)
+        IPReceive(Loopback, &LoopPacket->IPPacket);
+      else
+        LoopPacket->IPPacket.Free(&LoopPacket->IPPacket);
+
+      ExFreePoolWithTag(LoopPacket, PACKET_BUFFER_TAG);
+    }
+}
+
+static NDIS_STATUS LoopQueuePacket(
+  PLOOP_PACKET LoopPacket)
+/*
+ * FUNCTION: Queues a packet for reception on the loopback interface
+ * ARGUMENTS:
+ *   LoopPacket = Pointer to the packet, freed by the worker
+ * RETURNS:
+ *   Status of operation
+ */
+{
+  KIRQL OldIrql;
+  BOOLEAN StartWorker;
+
+  KeAcquireSpinLock(&LoopQueueLock, &OldIrql);
+  InsertTailList(&LoopQueue, &LoopPacket->ListEntry);
+  StartWorker = !LoopWorkerQueued;
+  LoopWorkerQueued = TRUE;
+  KeReleaseSpinLock(&LoopQueueLock, OldIrql);
+
+  if (StartWorker && !ChewCreate(LoopPassiveWorker, NULL))
+    {
+      KeAcquireSpinLock(&LoopQueueLock, &OldIrql);
+      RemoveEntryList(&LoopPacket->ListEntry);
+      LoopWorkerQueued = FALSE;
+      KeReleaseSpinLock(&LoopQueueLock, OldIrql);
+      return NDIS_STATUS_RESOURCES;
+    }
+
+  return NDIS_STATUS_SUCCESS;
+}
+
+NTSTATUS LoopDeliverDatagram(
+  PIP_PACKET IPPacket)
+/*
+ * FUNCTION: Delivers an IP datagram sent to the loopback interface
+ * ARGUMENTS:
+ *   IPPacket = Pointer to an IP packet holding the whole datagram
+ * RETURNS:
+ *   Status of operation
+ * NOTES:
+ *   The datagram is handed to the receive path as it is, without being
+ *   fragmented, checksummed or copied. The packet is freed.
+ */
 {
-  PIP_PACKET IPPacket = Context;
+  PLOOP_PACKET LoopPacket;
 
-  /* IPReceive() takes care of the NDIS packet */
-  IPReceive(Loopback, IPPacket);
+  TI_DbgPrint(MAX_TRACE, ("Called (IPPacket = %x)\n", IPPacket));
 
-  ExFreePool(IPPacket);
+  LoopPacket = ExAllocatePoolWithTag(NonPagedPool, sizeof(LOOP_PACKET), PACKET_BUFFER_TAG);
+  if (!LoopPacket)
+    {
+      IPPacket->Free(IPPacket);
+      return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+  /* The receive path reads the header from the NDIS packet again */
+  if (!IPPacket->MappedHeader && IPPacket->Header)
+    ExFreePoolWithTag(IPPacket->Header, PACKET_BUFFER_TAG);
+
+  /* The receiver takes over the NDIS packet */
+  LoopPacket->IPPacket = *IPPacket;
+  LoopPacket->IPPacket.Header = NULL;
+  LoopPacket->IPPacket.MappedHeader = FALSE;
+  LoopPacket->IPPacket.Flags |= IP_PACKET_FLAG_IP_CHECKSUM_OK | IP_PACKET_FLAG_L4_CHECKSUM_OK;
+
+  if (LoopQueuePacket(LoopPacket) != NDIS_STATUS_SUCCESS)
+    {
+      LoopPacket->IPPacket.Free(&LoopPacket->IPPacket);
+      ExFreePoolWithTag(LoopPacket, PACKET_BUFFER_TAG);
+      return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+  return STATUS_SUCCESS;
 }
 
 VOID LoopTransmit(
@@ -43,7 +154,7 @@ VOID LoopTransmit(
     UINT PacketLength;
     PNDIS_PACKET XmitPacket;
     NDIS_STATUS NdisStatus;
-    PIP_PACKET IPPacket;
+    PLOOP_PACKET LoopPacket;
 
     ASSERT_KM_POINTER(NdisPacket);
     ASSERT_KM_POINTER(PC(NdisPacket));
@@ -64,29 +175,32 @@ VOID LoopTransmit(
         ( &XmitPacket, PacketBuffer, PacketLength );
 
     if( NT_SUCCESS(NdisStatus) ) {
-        IPPacket = ExAllocatePool(NonPagedPool, sizeof(IP_PACKET));
-        if (IPPacket)
+        LoopPacket = ExAllocatePoolWithTag(NonPagedPool, sizeof(LOOP_PACKET), PACKET_BUFFER_TAG);
+        if (LoopPacket)
         {
-            IPInitializePacket(IPPacket, 0);
+            IPInitializePacket(&LoopPacket->IPPacket, 0);
 
-            IPPacket->NdisPacket = XmitPacket;
+            LoopPacket->IPPacket.NdisPacket = XmitPacket;
 
-            GetDataPtr(IPPacket->NdisPacket,
+            GetDataPtr(LoopPacket->IPPacket.NdisPacket,
                        0,
-                       (PCHAR*)&IPPacket->Header,
-                       &IPPacket->TotalSize);
+                       (PCHAR*)&LoopPacket->IPPacket.Header,
+                       &LoopPacket->IPPacket.TotalSize);
 
-            IPPacket->MappedHeader = TRUE;
+            LoopPacket->IPPacket.MappedHeader = TRUE;
 
-            if (!ChewCreate(LoopPassiveWorker, IPPacket))
+            NdisStatus = LoopQueuePacket(LoopPacket);
+            if (NdisStatus != NDIS_STATUS_SUCCESS)
             {
-                IPPacket->Free(IPPacket);
-                ExFreePool(IPPacket);
-                NdisStatus = NDIS_STATUS_RESOURCES;
+                LoopPacket->IPPacket.Free(&LoopPacket->IPPacket);
+                ExFreePoolWithTag(LoopPacket, PACKET_BUFFER_TAG);
             }
         }
         else
+        {
+            FreeNdisPacket(XmitPacket);
             NdisStatus = NDIS_STATUS_RESOURCES;
+        }
     }
 
     (PC(NdisPacket)->DLComplete)
@@ -109,6 +223,9 @@ NDIS_STATUS LoopRegisterAdapter(
 
   TI_DbgPrint(MID_TRACE, ("Called.\n"));
 
+  InitializeListHead(&LoopQueue);
+  KeInitializeSpinLock(&LoopQueueLock);
+
   /* Bind the adapter to network (IP) layer */
   BindInfo.Context = NULL;
   BindInfo.HeaderSize = 0;
@@ -122,6 +239,12 @@ NDIS_STATUS LoopRegisterAdapter(
 
   Loopback->MTU = 16384;
 
+  /* Nothing can corrupt the data on the way, and LoopDeliverDatagram()
+   * takes datagrams of any size */
+  Loopback->OffloadFlags = IP_OFFLOAD_NO_CHECKSUM | IP_OFFLOAD_TX_TCP_CHECKSUM | IP_OFFLOAD_LARGE_SEND;
+  Loopback->LargeSendMaxSize = IPv4_MAX_DATAGRAM_SIZE;
+  Loopback->LargeSendMinSegments = 1;
+
   Loopback->Name.Buffer = L"Loopback";
   Loopback->Name.MaximumLength = Loopback->Name.Length =
       (USHORT)wcslen(Loopback->Name.Buffer) * sizeof(WCHAR);
@@ -10,7 +10,203 @@
 
 #include "precomp.h"
 
-NEIGHBOR_CACHE_TABLE NeighborCache[NB_HASHMASK + 1];
+NEIGHBOR_CACHE_TABLE NeighborCache[NB_LOCK_STRIPES];
+
+/* Hash buckets of the neighbor cache. The bucket array may only be
+ * replaced while holding the locks of all stripes */
+static PNEIGHBOR_CACHE_ENTRY NeighborInitialBuckets[NB_INITIAL_BUCKETS];
+static PNEIGHBOR_CACHE_ENTRY *NeighborBuckets;
+static ULONG NeighborBucketMask;
+static ULONG NeighborResizes;
+static LONG NeighborEntries;
+
+/* Number of times NBTimeout ran */
+static ULONG NeighborTicks;
+
+#define NB_STRIPE(HashValue) (&NeighborCache[(HashValue) & (NB_LOCK_STRIPES - 1)])
+#define NB_BUCKET(HashValue) (&NeighborBuckets[(HashValue) & NeighborBucketMask])
+
+static ULONG NBHashAddress(PIP_ADDRESS Address)
+/*
+ * FUNCTION: Computes the hash value of an IP address
+ * ARGUMENTS:
+ *   Address = Pointer to IP address
+ * RETURNS:
+ *   Hash value. The low bits select the lock stripe and hash bucket
+ */
+{
+    ULONG HashValue = *(PULONG)&Address->Address;
+
+    HashValue ^= HashValue >> 16;
+    HashValue *= 0x45D9F3B;
+    HashValue ^= HashValue >> 16;
+
+    return HashValue;
+}
+
+static VOID NBScheduleEvent(PNEIGHBOR_CACHE_ENTRY NCE)
+/*
+ * FUNCTION: Puts a NCE on the timer wheel for its next timeout event
+ * ARGUMENTS:
+ *   NCE = Pointer to NCE
+ * NOTES:
+ *   Must be called with the lock of the NCE's stripe held. Incomplete
+ *   NCEs are solicited every tick. Other NCEs are only woken up when
+ *   they go stale, need a retransmission or time out, so NBTimeout
+ *   does not have to touch every NCE on every tick
+ */
+{
+    PNEIGHBOR_CACHE_TABLE Stripe = NB_STRIPE(NCE->HashValue);
+    ULONG Age, Next;
+
+    if (!IsListEmpty(&NCE->TimerListEntry))
+    {
+        RemoveEntryList(&NCE->TimerListEntry);
+        InitializeListHead(&NCE->TimerListEntry);
+    }
+
+    if (NCE->State & NUD_INCOMPLETE)
+    {
+        NCE->TimerDue = NeighborTicks + 1;
+    }
+    else if (NCE->EventTimer == 0)
+    {
+        /* Never times out */
+        return;
+    }
+    else
+    {
+        Age = NeighborTicks - NCE->EventStart;
+        if (Age < ARP_RATE)
+            Next = ARP_RATE;
+        else
+            Next = Age - (Age % ARP_TIMEOUT_RETRANSMISSION) + ARP_TIMEOUT_RETRANSMISSION;
+
+        if (Next > NCE->EventTimer)
+            Next = NCE->EventTimer;
+
+        NCE->TimerDue = NCE->EventStart + Next;
+        if ((LONG)(NCE->TimerDue - NeighborTicks) <= 0)
+            NCE->TimerDue = NeighborTicks + 1;
+    }
+
+    InsertTailList(&Stripe->Wheel[NCE->TimerDue % NB_WHEEL_SIZE],
+                   &NCE->TimerListEntry);
+}
+
+static VOID NBUnlinkNeighbor(PNEIGHBOR_CACHE_ENTRY NCE)
+/*
+ * FUNCTION: Removes a NCE from its hash bucket and the timer wheel
+ * ARGUMENTS:
+ *   NCE = Pointer to NCE
+ * NOTES:
+ *   Must be called with the lock of the NCE's stripe held
+ */
+{
+    PNEIGHBOR_CACHE_ENTRY *PrevNCE;
+
+    for (PrevNCE = NB_BUCKET(NCE->HashValue);
+         *PrevNCE != NCE;
+         PrevNCE = &(*PrevNCE)->Next)
+    {
+        ASSERT(*PrevNCE != NULL);
+    }
+
+    *PrevNCE = NCE->Next;
+
+    if (!IsListEmpty(&NCE->TimerListEntry))
+    {
+        RemoveEntryList(&NCE->TimerListEntry);
+        InitializeListHead(&NCE->TimerListEntry);
+    }
+
+    NB_STRIPE(NCE->HashValue)->Statistics.Removals++;
+    InterlockedDecrement(&NeighborEntries);
+}
+
+static VOID NBLockAllStripes(PKIRQL OldIrql)
+/*
+ * FUNCTION: Acquires the locks of all stripes, in order
+ * ARGUMENTS:
+ *   OldIrql = Address of variable receiving the previous IRQL
+ */
+{
+    ULONG i;
+
+    KeRaiseIrql(DISPATCH_LEVEL, OldIrql);
+    for (i = 0; i < NB_LOCK_STRIPES; i++)
+        TcpipAcquireSpinLockAtDpcLevel(&NeighborCache[i].Lock);
+}
+
+static VOID NBUnlockAllStripes(KIRQL OldIrql)
+/*
+ * FUNCTION: Releases the locks acquired by NBLockAllStripes
+ * ARGUMENTS:
+ *   OldIrql = IRQL to return to
+ */
+{
+    ULONG i;
+
+    for (i = NB_LOCK_STRIPES; i > 0; i--)
+        TcpipReleaseSpinLockFromDpcLevel(&NeighborCache[i - 1].Lock);
+    KeLowerIrql(OldIrql);
+}
+
+static VOID NBGrowTable(ULONG BucketCount)
+/*
+ * FUNCTION: Grows the table of hash buckets
+ * ARGUMENTS:
+ *   BucketCount = New number of buckets (power of two)
+ * NOTES:
+ *   Must be called at IRQL <= DISPATCH_LEVEL without any stripe lock held.
+ *   The table silently keeps its size if we run out of memory
+ */
+{
+    PNEIGHBOR_CACHE_ENTRY *Buckets, *OldBuckets;
+    PNEIGHBOR_CACHE_ENTRY NCE;
+    KIRQL OldIrql;
+    ULONG i;
+
+    Buckets = ExAllocatePoolWithTag(NonPagedPool,
+                                    BucketCount * sizeof(PNEIGHBOR_CACHE_ENTRY),
+                                    NCE_TABLE_TAG);
+    if (Buckets == NULL)
+        return;
+
+    RtlZeroMemory(Buckets, BucketCount * sizeof(PNEIGHBOR_CACHE_ENTRY));
+
+    NBLockAllStripes(&OldIrql);
+
+    if (NeighborBucketMask + 1 >= BucketCount)
+    {
+        /* Somebody else was faster */
+        OldBuckets = Buckets;
+    }
+    else
+    {
+        for (i = 0; i <= NeighborBucketMask; i++)
+        {
+            while ((NCE = NeighborBuckets[i]) != NULL)
+            {
+                NeighborBuckets[i] = NCE->Next;
+                NCE->Next = Buckets[NCE->HashValue & (BucketCount - 1)];
+                Buckets[NCE->HashValue & (BucketCount - 1)] = NCE;
+            }
+        }
+
+        OldBuckets = NeighborBuckets;
+        NeighborBuckets = Buckets;
+        NeighborBucketMask = BucketCount - 1;
+        NeighborResizes++;
+    }
+
+    NBUnlockAllStripes(OldIrql);
+
+    TI_DbgPrint(DEBUG_NCACHE, ("Neighbor cache now has %d buckets.\n", NeighborBucketMask + 1));
+
+    if (OldBuckets != NeighborInitialBuckets)
+        ExFreePoolWithTag(OldBuckets, NCE_TABLE_TAG);
+}
 
 VOID NBCompleteSend( PVOID Context,
 		     PNDIS_PACKET NdisPacket,
@@ -28,19 +224,12 @@ VOID NBCompleteSend( PVOID Context,
 VOID NBSendPackets( PNEIGHBOR_CACHE_ENTRY NCE ) {
     PLIST_ENTRY PacketEntry;
     PNEIGHBOR_PACKET Packet;
-    UINT HashValue;
 
     ASSERT(!(NCE->State & NUD_INCOMPLETE));
 
-    HashValue  = *(PULONG)(&NCE->Address.Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
-
     /* Send any waiting packets */
     while ((PacketEntry = ExInterlockedRemoveHeadList(&NCE->PacketQueue,
-                                              &NeighborCache[HashValue].Lock)) != NULL)
+                                              &NB_STRIPE(NCE->HashValue)->Lock)) != NULL)
     {
 	Packet = CONTAINING_RECORD( PacketEntry, NEIGHBOR_PACKET, Next );
 
@@ -93,52 +282,81 @@ VOID NBTimeout(VOID)
  * FUNCTION: Neighbor address cache timeout handler
  * NOTES:
  *     This routine is called by IPTimeout to remove outdated cache
- *     entries.
+ *     entries. Only the NCEs in the current slot of each timer wheel
+ *     are examined
  */
 {
     UINT i;
-    PNEIGHBOR_CACHE_ENTRY *PrevNCE;
+    PNEIGHBOR_CACHE_TABLE Stripe;
     PNEIGHBOR_CACHE_ENTRY NCE;
+    PLIST_ENTRY Slot, Entry;
+    LIST_ENTRY DueList;
     NDIS_STATUS Status;
+    ULONG Age;
 
-    for (i = 0; i <= NB_HASHMASK; i++) {
-        TcpipAcquireSpinLockAtDpcLevel(&NeighborCache[i].Lock);
+    NeighborTicks++;
+
+    for (i = 0; i < NB_LOCK_STRIPES; i++) {
+        Stripe = &NeighborCache[i];
+        Slot = &Stripe->Wheel[NeighborTicks % NB_WHEEL_SIZE];
+
+        TcpipAcquireSpinLockAtDpcLevel(&Stripe->Lock);
+
+        /* Detach the slot, rescheduled NCEs may land in it again */
+        if (IsListEmpty(Slot)) {
+            TcpipReleaseSpinLockFromDpcLevel(&Stripe->Lock);
+            continue;
+        }
+        DueList.Flink = Slot->Flink;
+        DueList.Blink = Slot->Blink;
+        DueList.Flink->Blink = &DueList;
+        DueList.Blink->Flink = &DueList;
+        InitializeListHead(Slot);
+
+        while (!IsListEmpty(&DueList)) {
+            Entry = RemoveHeadList(&DueList);
+            NCE = CONTAINING_RECORD(Entry, NEIGHBOR_CACHE_ENTRY, TimerListEntry);
+
+            if ((LONG)(NCE->TimerDue - NeighborTicks) > 0) {
+                /* Due in a later round of the wheel */
+                InsertTailList(Slot, &NCE->TimerListEntry);
+                continue;
+            }
+
+            InitializeListHead(&NCE->TimerListEntry);
+            Stripe->Statistics.TimerEvents++;
+
+            Age = NeighborTicks - NCE->EventStart;
 
-        for (PrevNCE = &NeighborCache[i].Cache;
-             (NCE = *PrevNCE) != NULL;) {
             if (NCE->State & NUD_INCOMPLETE)
             {
                 /* Solicit for an address */
                 NBSendSolicit(NCE);
-                if (NCE->EventTimer == 0)
+                if (NCE->EventTimer == 0 && Age == ARP_INCOMPLETE_TIMEOUT)
                 {
-                    NCE->EventCount++;
-                    if (NCE->EventCount == ARP_INCOMPLETE_TIMEOUT)
-                    {
-                        NBFlushPacketQueue(NCE, NDIS_STATUS_NETWORK_UNREACHABLE);
-                        NCE->EventCount = 0;
-                    }
+                    NBFlushPacketQueue(NCE, NDIS_STATUS_NETWORK_UNREACHABLE);
+                    NCE->EventStart = NeighborTicks;
                 }
             }
 
             /* Check if event timer is running */
             if (NCE->EventTimer > 0)  {
                 ASSERT(!(NCE->State & NUD_PERMANENT));
-                NCE->EventCount++;
 
-                if ((NCE->EventCount > ARP_RATE &&
-                     NCE->EventCount % ARP_TIMEOUT_RETRANSMISSION == 0) ||
-                    (NCE->EventCount == ARP_RATE))
+                if ((Age > ARP_RATE &&
+                     Age % ARP_TIMEOUT_RETRANSMISSION == 0) ||
+                    (Age == ARP_RATE))
                 {
                     /* We haven't gotten a packet from them in
-                     * EventCount seconds so we mark them as stale
+                     * Age seconds so we mark them as stale
                      * and solicit now */
                     NCE->State |= NUD_STALE;
                     NBSendSolicit(NCE);
                 }
-                if (NCE->EventTimer - NCE->EventCount == 0) {
+                if (Age >= NCE->EventTimer) {
                     /* Unlink and destroy the NCE */
-                    *PrevNCE = NCE->Next;
+                    NBUnlinkNeighbor(NCE);
+                    Stripe->Statistics.Expirations++;
 
                     /* Choose the proper failure status */
                     if (NCE->State & NUD_INCOMPLETE)
@@ -159,10 +377,11 @@ VOID NBTimeout(VOID)
                     continue;
                 }
             }
-            PrevNCE = &NCE->Next;
+
+            NBScheduleEvent(NCE);
         }
 
-        TcpipReleaseSpinLockFromDpcLevel(&NeighborCache[i].Lock);
+        TcpipReleaseSpinLockFromDpcLevel(&Stripe->Lock);
     }
 }
 
@@ -171,13 +390,22 @@ VOID NBStartup(VOID)
  * FUNCTION: Starts the neighbor cache
  */
 {
-    UINT i;
+    UINT i, j;
 
     TI_DbgPrint(DEBUG_NCACHE, ("Called.\n"));
 
-    for (i = 0; i <= NB_HASHMASK; i++) {
-	NeighborCache[i].Cache = NULL;
+    NeighborBuckets = NeighborInitialBuckets;
+    NeighborBucketMask = NB_INITIAL_BUCKETS - 1;
+    NeighborResizes = 0;
+    NeighborEntries = 0;
+    NeighborTicks = 0;
+    RtlZeroMemory(NeighborInitialBuckets, sizeof(NeighborInitialBuckets));
+
+    for (i = 0; i < NB_LOCK_STRIPES; i++) {
 	TcpipInitializeSpinLock(&NeighborCache[i].Lock);
+	for (j = 0; j < NB_WHEEL_SIZE; j++)
+	    InitializeListHead(&NeighborCache[i].Wheel[j]);
+	RtlZeroMemory(&NeighborCache[i].Statistics, sizeof(NEIGHBOR_CACHE_STATISTICS));
     }
 }
 
@@ -186,19 +414,20 @@ VOID NBShutdown(VOID)
  * FUNCTION: Shuts down the neighbor cache
  */
 {
+  PNEIGHBOR_CACHE_ENTRY *OldBuckets;
   PNEIGHBOR_CACHE_ENTRY NextNCE;
   PNEIGHBOR_CACHE_ENTRY CurNCE;
   KIRQL OldIrql;
-  UINT i;
+  UINT i, j;
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called.\n"));
 
   /* Remove possible entries from the cache */
-  for (i = 0; i <= NB_HASHMASK; i++)
-    {
-      TcpipAcquireSpinLock(&NeighborCache[i].Lock, &OldIrql);
+  NBLockAllStripes(&OldIrql);
 
-      CurNCE = NeighborCache[i].Cache;
+  for (i = 0; i <= NeighborBucketMask; i++)
+    {
+      CurNCE = NeighborBuckets[i];
       while (CurNCE) {
           NextNCE = CurNCE->Next;
 
@@ -210,11 +439,23 @@ VOID NBShutdown(VOID)
 	  CurNCE = NextNCE;
       }
 
-    NeighborCache[i].Cache = NULL;
-
-    TcpipReleaseSpinLock(&NeighborCache[i].Lock, OldIrql);
+    NeighborBuckets[i] = NULL;
   }
 
+  for (i = 0; i < NB_LOCK_STRIPES; i++)
+      for (j = 0; j < NB_WHEEL_SIZE; j++)
+          InitializeListHead(&NeighborCache[i].Wheel[j]);
+
+  OldBuckets = NeighborBuckets;
+  NeighborBuckets = NeighborInitialBuckets;
+  NeighborBucketMask = NB_INITIAL_BUCKETS - 1;
+  NeighborEntries = 0;
+
+  NBUnlockAllStripes(OldIrql);
+
+  if (OldBuckets != NeighborInitialBuckets)
+      ExFreePoolWithTag(OldBuckets, NCE_TABLE_TAG);
+
   TI_DbgPrint(MAX_TRACE, ("Leaving.\n"));
 }
 
@@ -241,18 +482,16 @@ VOID NBDestroyNeighborsForInterface(PIP_INTERFACE Interface)
     PNEIGHBOR_CACHE_ENTRY NCE;
     ULONG i;
 
-    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
-    for (i = 0; i <= NB_HASHMASK; i++)
+    NBLockAllStripes(&OldIrql);
+    for (i = 0; i <= NeighborBucketMask; i++)
     {
-        TcpipAcquireSpinLockAtDpcLevel(&NeighborCache[i].Lock);
-
-        for (PrevNCE = &NeighborCache[i].Cache;
+        for (PrevNCE = &NeighborBuckets[i];
              (NCE = *PrevNCE) != NULL;)
         {
             if (NCE->Interface == Interface)
             {
                 /* Unlink and destroy the NCE */
-                *PrevNCE = NCE->Next;
+                NBUnlinkNeighbor(NCE);
 
                 NBFlushPacketQueue(NCE, NDIS_STATUS_REQUEST_ABORTED);
                 ExFreePoolWithTag(NCE, NCE_TAG);
@@ -264,10 +503,8 @@ VOID NBDestroyNeighborsForInterface(PIP_INTERFACE Interface)
                 PrevNCE = &NCE->Next;
             }
         }
-
-        TcpipReleaseSpinLockFromDpcLevel(&NeighborCache[i].Lock);
     }
-    KeLowerIrql(OldIrql);
+    NBUnlockAllStripes(OldIrql);
 }
 
 PNEIGHBOR_CACHE_ENTRY NBAddNeighbor(
@@ -294,7 +531,9 @@ PNEIGHBOR_CACHE_ENTRY NBAddNeighbor(
  */
 {
   PNEIGHBOR_CACHE_ENTRY NCE;
-  ULONG HashValue;
+  PNEIGHBOR_CACHE_TABLE Stripe;
+  PNEIGHBOR_CACHE_ENTRY *Bucket;
+  ULONG BucketCount;
   KIRQL OldIrql;
 
   TI_DbgPrint
@@ -314,6 +553,7 @@ PNEIGHBOR_CACHE_ENTRY NBAddNeighbor(
 
   NCE->Interface = Interface;
   NCE->Address = *Address;
+  NCE->HashValue = NBHashAddress(Address);
   NCE->LinkAddressLength = LinkAddressLength;
   NCE->LinkAddress = (PVOID)&NCE[1];
   if( LinkAddress )
@@ -322,23 +562,33 @@ PNEIGHBOR_CACHE_ENTRY NBAddNeighbor(
       memset(NCE->LinkAddress, 0xff, LinkAddressLength);
   NCE->State = State;
   NCE->EventTimer = EventTimer;
-  NCE->EventCount = 0;
+  InitializeListHead( &NCE->TimerListEntry );
   InitializeListHead( &NCE->PacketQueue );
 
   TI_DbgPrint(MID_TRACE,("NCE: %x\n", NCE));
 
-  HashValue = *(PULONG)&Address->Address;
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  Stripe = NB_STRIPE(NCE->HashValue);
+
+  TcpipAcquireSpinLock(&Stripe->Lock, &OldIrql);
+
+  Bucket = NB_BUCKET(NCE->HashValue);
+  NCE->Next = *Bucket;
+  *Bucket = NCE;
 
-  TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
+  NCE->EventStart = NeighborTicks;
+  NBScheduleEvent(NCE);
 
-  NCE->Next = NeighborCache[HashValue].Cache;
-  NeighborCache[HashValue].Cache = NCE;
+  Stripe->Statistics.Additions++;
+  BucketCount = NeighborBucketMask + 1;
 
-  TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
+  TcpipReleaseSpinLock(&Stripe->Lock, OldIrql);
+
+  /* Keep the hash chains short */
+  if ((ULONG)InterlockedIncrement(&NeighborEntries) > BucketCount * NB_LOAD_FACTOR &&
+      BucketCount < NB_MAX_BUCKETS)
+  {
+      NBGrowTable(BucketCount * 2);
+  }
 
   return NCE;
 }
@@ -358,60 +608,66 @@ VOID NBUpdateNeighbor(
  */
 {
     KIRQL OldIrql;
-    UINT HashValue;
+    PNEIGHBOR_CACHE_TABLE Stripe;
 
     TI_DbgPrint(DEBUG_NCACHE, ("Called. NCE (0x%X)  LinkAddress (0x%X)  State (0x%X).\n", NCE, LinkAddress, State));
 
-    HashValue  = *(PULONG)(&NCE->Address.Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    Stripe = NB_STRIPE(NCE->HashValue);
 
-    TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
+    TcpipAcquireSpinLock(&Stripe->Lock, &OldIrql);
 
     RtlCopyMemory(NCE->LinkAddress, LinkAddress, NCE->LinkAddressLength);
     NCE->State = State;
-    NCE->EventCount = 0;
+    NCE->EventStart = NeighborTicks;
+    if (!(State & NUD_INCOMPLETE) && NCE->EventTimer)
+        NCE->EventTimer = ARP_COMPLETE_TIMEOUT;
+    NBScheduleEvent(NCE);
 
-    TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
+    TcpipReleaseSpinLock(&Stripe->Lock, OldIrql);
 
     if( !(NCE->State & NUD_INCOMPLETE) )
     {
-        if (NCE->EventTimer) NCE->EventTimer = ARP_COMPLETE_TIMEOUT;
         NBSendPackets( NCE );
     }
 }
 
 VOID
 NBResetNeighborTimeout(PIP_ADDRESS Address)
+/*
+ * FUNCTION: Restarts the timeout of the NCE of an IP address
+ * ARGUMENTS:
+ *   Address = Pointer to IP address
+ * NOTES:
+ *   Called for every received datagram. The NCE stays where it is on
+ *   the timer wheel, NBTimeout reschedules it when its old event is
+ *   due and finds it is not old enough yet
+ */
 {
     KIRQL OldIrql;
-    UINT HashValue;
+    ULONG HashValue;
+    PNEIGHBOR_CACHE_TABLE Stripe;
     PNEIGHBOR_CACHE_ENTRY NCE;
 
     TI_DbgPrint(DEBUG_NCACHE, ("Resetting NCE timout for 0x%s\n", A2S(Address)));
 
-    HashValue  = *(PULONG)(&Address->Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(Address);
+    Stripe = NB_STRIPE(HashValue);
 
-    TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
+    TcpipAcquireSpinLock(&Stripe->Lock, &OldIrql);
 
-    for (NCE = NeighborCache[HashValue].Cache;
+    for (NCE = *NB_BUCKET(HashValue);
          NCE != NULL;
          NCE = NCE->Next)
     {
-         if (AddrIsEqual(Address, &NCE->Address))
+         if (NCE->HashValue == HashValue &&
+             AddrIsEqual(Address, &NCE->Address))
          {
-             NCE->EventCount = 0;
+             NCE->EventStart = NeighborTicks;
              break;
          }
     }
 
-    TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
+    TcpipReleaseSpinLock(&Stripe->Lock, OldIrql);
 }
 
 PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
@@ -430,19 +686,19 @@ PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
  */
 {
   PNEIGHBOR_CACHE_ENTRY NCE;
-  UINT HashValue;
+  PNEIGHBOR_CACHE_TABLE Stripe;
+  ULONG HashValue;
   KIRQL OldIrql;
   PIP_INTERFACE FirstInterface;
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called. Address (0x%X).\n", Address));
 
-  HashValue = *(PULONG)&Address->Address;
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(Address);
+  Stripe = NB_STRIPE(HashValue);
 
-  TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
+  TcpipAcquireSpinLock(&Stripe->Lock, &OldIrql);
+
+  Stripe->Statistics.Lookups++;
 
   /* If there's no adapter specified, we'll look for a match on
    * each one. */
@@ -458,10 +714,11 @@ PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
 
   do
   {
-      NCE = NeighborCache[HashValue].Cache;
+      NCE = *NB_BUCKET(HashValue);
       while (NCE != NULL)
       {
          if (NCE->Interface == Interface &&
+             NCE->HashValue == HashValue &&
              AddrIsEqual(Address, &NCE->Address))
          {
              break;
@@ -479,10 +736,11 @@ PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
   if ((NCE == NULL) && (FirstInterface != NULL))
   {
       /* This time we'll even match loopback NCEs */
-      NCE = NeighborCache[HashValue].Cache;
+      NCE = *NB_BUCKET(HashValue);
       while (NCE != NULL)
       {
-         if (AddrIsEqual(Address, &NCE->Address))
+         if (NCE->HashValue == HashValue &&
+             AddrIsEqual(Address, &NCE->Address))
          {
              break;
          }
@@ -491,7 +749,10 @@ PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
       }
   }
 
-  TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
+  if (NCE != NULL)
+      Stripe->Statistics.Hits++;
+
+  TcpipReleaseSpinLock(&Stripe->Lock, OldIrql);
 
   TI_DbgPrint(MAX_TRACE, ("Leaving.\n"));
 
@@ -554,7 +815,7 @@ BOOLEAN NBQueuePacket(
 {
   KIRQL OldIrql;
   PNEIGHBOR_PACKET Packet;
-  UINT HashValue;
+  PNEIGHBOR_CACHE_TABLE Stripe;
 
   TI_DbgPrint
       (DEBUG_NCACHE,
@@ -566,20 +827,16 @@ BOOLEAN NBQueuePacket(
 
   /* FIXME: Should we limit the number of queued packets? */
 
-  HashValue  = *(PULONG)(&NCE->Address.Address);
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  Stripe = NB_STRIPE(NCE->HashValue);
 
-  TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
+  TcpipAcquireSpinLock(&Stripe->Lock, &OldIrql);
 
   Packet->Complete = PacketComplete;
   Packet->Context = PacketContext;
   Packet->Packet = NdisPacket;
   InsertTailList( &NCE->PacketQueue, &Packet->Next );
 
-  TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
+  TcpipReleaseSpinLock(&Stripe->Lock, OldIrql);
 
   if( !(NCE->State & NUD_INCOMPLETE) )
       NBSendPackets( NCE );
@@ -597,30 +854,25 @@ VOID NBRemoveNeighbor(
  *   The NCE must be in a safe state
  */
 {
-  PNEIGHBOR_CACHE_ENTRY *PrevNCE;
   PNEIGHBOR_CACHE_ENTRY CurNCE;
-  ULONG HashValue;
+  PNEIGHBOR_CACHE_TABLE Stripe;
   KIRQL OldIrql;
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called. NCE (0x%X).\n", NCE));
 
-  HashValue  = *(PULONG)(&NCE->Address.Address);
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  Stripe = NB_STRIPE(NCE->HashValue);
 
-  TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
+  TcpipAcquireSpinLock(&Stripe->Lock, &OldIrql);
 
-  /* Search the list and remove the NCE from the list if found */
-  for (PrevNCE = &NeighborCache[HashValue].Cache;
-    (CurNCE = *PrevNCE) != NULL;
-    PrevNCE = &CurNCE->Next)
+  /* Search the bucket and remove the NCE from the cache if found */
+  for (CurNCE = *NB_BUCKET(NCE->HashValue);
+       CurNCE != NULL;
+       CurNCE = CurNCE->Next)
     {
       if (CurNCE == NCE)
         {
-          /* Found it, now unlink it from the list */
-          *PrevNCE = CurNCE->Next;
+          /* Found it, now unlink it from the cache */
+          NBUnlinkNeighbor(CurNCE);
 
 	  NBFlushPacketQueue( CurNCE, NDIS_STATUS_REQUEST_ABORTED );
           ExFreePoolWithTag(CurNCE, NCE_TAG);
@@ -629,7 +881,7 @@ VOID NBRemoveNeighbor(
         }
     }
 
-  TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
+  TcpipReleaseSpinLock(&Stripe->Lock, OldIrql);
 }
 
 ULONG NBCopyNeighbors
@@ -640,9 +892,9 @@ ULONG NBCopyNeighbors
   KIRQL OldIrql;
   UINT Size = 0, i;
 
-  for (i = 0; i <= NB_HASHMASK; i++) {
-      TcpipAcquireSpinLock(&NeighborCache[i].Lock, &OldIrql);
-      for( CurNCE = NeighborCache[i].Cache;
+  NBLockAllStripes(&OldIrql);
+  for (i = 0; i <= NeighborBucketMask; i++) {
+      for( CurNCE = NeighborBuckets[i];
 	   CurNCE;
 	   CurNCE = CurNCE->Next ) {
 	  if( CurNCE->Interface == Interface &&
@@ -665,8 +917,39 @@ ULONG NBCopyNeighbors
 	      Size++;
 	  }
       }
-      TcpipReleaseSpinLock(&NeighborCache[i].Lock, OldIrql);
   }
+  NBUnlockAllStripes(OldIrql);
 
   return Size;
 }
+
+VOID NBGetStatistics(
+  PNEIGHBOR_CACHE_STATISTICS Statistics)
+/*
+ * FUNCTION: Returns the statistics of the neighbor cache
+ * ARGUMENTS:
+ *   Statistics = Pointer to structure receiving the statistics
+ * NOTES:
+ *   The counters of the stripes are read without their locks, so the
+ *   result is only a snapshot
+ */
+{
+  PNEIGHBOR_CACHE_STATISTICS StripeStatistics;
+  UINT i;
+
+  RtlZeroMemory(Statistics, sizeof(NEIGHBOR_CACHE_STATISTICS));
+
+  for (i = 0; i < NB_LOCK_STRIPES; i++) {
+      StripeStatistics = &NeighborCache[i].Statistics;
+      Statistics->Lookups += StripeStatistics->Lookups;
+      Statistics->Hits += StripeStatistics->Hits;
+      Statistics->Additions += StripeStatistics->Additions;
+      Statistics->Removals += StripeStatistics->Removals;
+      Statistics->Expirations += StripeStatistics->Expirations;
+      Statistics->TimerEvents += StripeStatistics->TimerEvents;
+  }
+
+  Statistics->Entries = NeighborEntries;
+  Statistics->Buckets = NeighborBucketMask + 1;
+  Statistics->Resizes = NeighborResizes;
+}
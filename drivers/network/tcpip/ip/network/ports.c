@@ -24,6 +24,7 @@ NTSTATUS PortsStartup( PPORT_SET PortSet,
 			 PortSet->ProtoBitBuffer,
 			 PortSet->PortsToOversee );
     RtlClearAllBits( &PortSet->ProtoBitmap );
+    PortSet->Seed = KeQueryPerformanceCounter( NULL ).LowPart;
     KeInitializeSpinLock( &PortSet->Lock );
     return STATUS_SUCCESS;
 }
@@ -67,28 +68,34 @@ BOOLEAN AllocatePort( PPORT_SET PortSet, ULONG Port ) {
 }
 
 ULONG AllocateAnyPort( PPORT_SET PortSet ) {
-    ULONG AllocatedPort;
-    KIRQL OldIrql;
-
-    KeAcquireSpinLock( &PortSet->Lock, &OldIrql );
-    AllocatedPort = RtlFindClearBits( &PortSet->ProtoBitmap, 1, 0 );
-    if( AllocatedPort != (ULONG)-1 ) {
-	RtlSetBit( &PortSet->ProtoBitmap, AllocatedPort );
-	AllocatedPort += PortSet->StartingPort;
-	KeReleaseSpinLock( &PortSet->Lock, OldIrql );
-	return htons(AllocatedPort);
-    }
-    KeReleaseSpinLock( &PortSet->Lock, OldIrql );
-
-    return -1;
+    return AllocatePortFromRange( PortSet,
+                                  PortSet->StartingPort,
+                                  PortSet->StartingPort + PortSet->PortsToOversee - 1 );
 }
 
+/*
+ * FUNCTION: Allocates a free port in [Lowest, Highest]
+ * ARGUMENTS:
+ *     PortSet = Port set to allocate from
+ *     Lowest  = First port of the range (host byte order)
+ *     Highest = Last port of the range (host byte order)
+ * RETURNS:
+ *     Port in network byte order, -1 if the range is exhausted
+ * NOTES:
+ *     The search starts at a random port of the range rather than at
+ *     its beginning, so that ephemeral ports are hard to guess and the
+ *     cost does not grow with the number of ports already in use.
+ */
 ULONG AllocatePortFromRange( PPORT_SET PortSet, ULONG Lowest, ULONG Highest ) {
-    ULONG AllocatedPort;
+    ULONG AllocatedPort, Start;
     KIRQL OldIrql;
 
+    /* The bitmap may cover port 0x10000, which is not a port */
+    Highest = min(Highest, 0xFFFF);
+
     if ((Lowest < PortSet->StartingPort) ||
-        (Highest >= PortSet->StartingPort + PortSet->PortsToOversee))
+        (Highest >= PortSet->StartingPort + PortSet->PortsToOversee) ||
+        (Lowest > Highest))
     {
         return -1;
     }
@@ -97,8 +104,21 @@ ULONG AllocatePortFromRange( PPORT_SET PortSet, ULONG Lowest, ULONG Highest ) {
     Highest -= PortSet->StartingPort;
 
     KeAcquireSpinLock( &PortSet->Lock, &OldIrql );
-    AllocatedPort = RtlFindClearBits( &PortSet->ProtoBitmap, 1, Lowest );
-    if( AllocatedPort != (ULONG)-1 && AllocatedPort <= Highest) {
+
+    Start = Lowest + RtlRandomEx( &PortSet->Seed ) % (Highest - Lowest + 1);
+
+    /* RtlFindClearBits wraps around the whole bitmap, so each search
+     * only counts if it stayed inside its part of the range */
+    AllocatedPort = RtlFindClearBits( &PortSet->ProtoBitmap, 1, Start );
+    if( AllocatedPort == (ULONG)-1 ||
+        AllocatedPort < Start || AllocatedPort > Highest ) {
+        AllocatedPort = RtlFindClearBits( &PortSet->ProtoBitmap, 1, Lowest );
+        if( AllocatedPort != (ULONG)-1 &&
+            (AllocatedPort < Lowest || AllocatedPort > Highest) )
+            AllocatedPort = (ULONG)-1;
+    }
+
+    if( AllocatedPort != (ULONG)-1 ) {
 	RtlSetBit( &PortSet->ProtoBitmap, AllocatedPort );
 	AllocatedPort += PortSet->StartingPort;
 	KeReleaseSpinLock( &PortSet->Lock, OldIrql );
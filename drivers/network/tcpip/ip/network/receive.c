@@ -4,8 +4,8 @@
  * FILE:        network/receive.c
  * PURPOSE:     Internet Protocol receive routines
  * PROGRAMMERS: Casper S. Hornstrup (chorns@users.sourceforge.net)
- * NOTES:       The IP datagram reassembly algorithm is taken from
- *              from RFC 815
+ * NOTES:       Fragments are kept sorted by offset and must not overlap,
+ *              a datagram with overlapping fragments is discarded
  * REVISIONS:
  *   CSH 01/08-2000 Created
  */
@@ -13,41 +13,16 @@
 #include "precomp.h"
 
 LIST_ENTRY ReassemblyListHead;
+LIST_ENTRY ReassemblyHashTable[REASSEMBLY_HASH_SIZE];
 KSPIN_LOCK ReassemblyListLock;
 NPAGED_LOOKASIDE_LIST IPDRList;
 NPAGED_LOOKASIDE_LIST IPFragmentList;
-NPAGED_LOOKASIDE_LIST IPHoleList;
 
-PIPDATAGRAM_HOLE CreateHoleDescriptor(
-  ULONG First,
-  ULONG Last)
-/*
- * FUNCTION: Returns a pointer to a IP datagram hole descriptor
- * ARGUMENTS:
- *     First = Offset of first octet of the hole
- *     Last  = Offset of last octet of the hole
- * RETURNS:
- *     Pointer to descriptor, NULL if there was not enough free
- *     resources
- */
-{
-	PIPDATAGRAM_HOLE Hole;
-
-	TI_DbgPrint(DEBUG_IP, ("Called. First (%d)  Last (%d).\n", First, Last));
-
-	Hole = ExAllocateFromNPagedLookasideList(&IPHoleList);
-	if (!Hole) {
-	    TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
-	    return NULL;
-	}
+/* Fragment data held by all datagrams being reassembled, protected by ReassemblyListLock */
+static ULONG ReassemblyMemoryUsed;
 
-	Hole->First = First;
-	Hole->Last  = Last;
-
-	TI_DbgPrint(DEBUG_IP, ("Returning hole descriptor at (0x%X).\n", Hole));
-
-	return Hole;
-}
+#define REASSEMBLY_HASH(SrcAddr, Id, Protocol) \
+  (((SrcAddr) ^ ((SrcAddr) >> 16) ^ (Id) ^ (Protocol)) & (REASSEMBLY_HASH_SIZE - 1))
 
 
 VOID FreeIPDR(
@@ -60,27 +35,10 @@ VOID FreeIPDR(
 {
   PLIST_ENTRY CurrentEntry;
   PLIST_ENTRY NextEntry;
-  PIPDATAGRAM_HOLE CurrentH;
   PIP_FRAGMENT CurrentF;
 
   TI_DbgPrint(DEBUG_IP, ("Freeing IP datagram reassembly descriptor (0x%X).\n", IPDR));
 
-  /* Free all descriptors */
-  CurrentEntry = IPDR->HoleListHead.Flink;
-  while (CurrentEntry != &IPDR->HoleListHead) {
-    NextEntry = CurrentEntry->Flink;
-	  CurrentH = CONTAINING_RECORD(CurrentEntry, IPDATAGRAM_HOLE, ListEntry);
-    /* Unlink it from the list */
-    RemoveEntryList(CurrentEntry);
-
-    TI_DbgPrint(DEBUG_IP, ("Freeing hole descriptor at (0x%X).\n", CurrentH));
-
-    /* And free the hole descriptor */
-    ExFreeToNPagedLookasideList(&IPHoleList, CurrentH);
-
-    CurrentEntry = NextEntry;
-  }
-
   /* Free all fragments */
   CurrentEntry = IPDR->FragmentListHead.Flink;
   while (CurrentEntry != &IPDR->FragmentListHead) {
@@ -123,18 +81,20 @@ VOID FreeIPDR(
 VOID RemoveIPDR(
   PIPDATAGRAM_REASSEMBLY IPDR)
 /*
- * FUNCTION: Removes an IP datagram reassembly structure from the global list
+ * FUNCTION: Removes an IP datagram reassembly structure from the global lists
  * ARGUMENTS:
  *     IPDR = Pointer to IP datagram reassembly structure
+ * NOTES:
+ *     The reassembly lock is held when this routine is called
  */
 {
-  KIRQL OldIrql;
-
   TI_DbgPrint(DEBUG_IP, ("Removing IPDR at (0x%X).\n", IPDR));
 
-  TcpipAcquireSpinLock(&ReassemblyListLock, &OldIrql);
   RemoveEntryList(&IPDR->ListEntry);
-  TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
+  RemoveEntryList(&IPDR->HashEntry);
+
+  ASSERT(ReassemblyMemoryUsed >= IPDR->ReceivedSize);
+  ReassemblyMemoryUsed -= IPDR->ReceivedSize;
 }
 
 
@@ -147,36 +107,32 @@ PIPDATAGRAM_REASSEMBLY GetReassemblyInfo(
  * NOTES:
  *     A datagram is identified by four paramters, which are
  *     Source and destination address, protocol number and
- *     identification number
+ *     identification number. The reassembly lock is held when
+ *     this routine is called
  */
 {
-  KIRQL OldIrql;
-  PLIST_ENTRY CurrentEntry;
+  PLIST_ENTRY CurrentEntry, BucketHead;
   PIPDATAGRAM_REASSEMBLY Current;
   PIPv4_HEADER Header = (PIPv4_HEADER)IPPacket->Header;
 
   TI_DbgPrint(DEBUG_IP, ("Searching for IPDR for IP packet at (0x%X).\n", IPPacket));
 
-  TcpipAcquireSpinLock(&ReassemblyListLock, &OldIrql);
-
   /* FIXME: Assume IPv4 */
 
-  CurrentEntry = ReassemblyListHead.Flink;
-  while (CurrentEntry != &ReassemblyListHead) {
-	  Current = CONTAINING_RECORD(CurrentEntry, IPDATAGRAM_REASSEMBLY, ListEntry);
+  BucketHead = &ReassemblyHashTable[REASSEMBLY_HASH(Header->SrcAddr, Header->Id, Header->Protocol)];
+
+  CurrentEntry = BucketHead->Flink;
+  while (CurrentEntry != BucketHead) {
+    Current = CONTAINING_RECORD(CurrentEntry, IPDATAGRAM_REASSEMBLY, HashEntry);
     if (AddrIsEqual(&IPPacket->SrcAddr, &Current->SrcAddr) &&
       (Header->Id == Current->Id) &&
       (Header->Protocol == Current->Protocol) &&
       (AddrIsEqual(&IPPacket->DstAddr, &Current->DstAddr))) {
-      TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
-
       return Current;
     }
     CurrentEntry = CurrentEntry->Flink;
   }
 
-  TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
-
   return NULL;
 }
 
@@ -191,7 +147,7 @@ ReassembleDatagram(
  *     IPDR = Pointer to IP datagram reassembly structure
  * NOTES:
  *     This routine concatenates fragments into a complete IP datagram.
- *     The lock is held when this routine is called
+ *     The IPDR has been removed from the global lists
  * RETURNS:
  *     Pointer to IP packet, NULL if there was not enough free resources
  * NOTES:
@@ -202,8 +158,6 @@ ReassembleDatagram(
   PIP_FRAGMENT Fragment;
   PCHAR Data;
 
-  PAGED_CODE();
-
   TI_DbgPrint(DEBUG_IP, ("Reassembling datagram from IPDR at (0x%X).\n", IPDR));
   TI_DbgPrint(DEBUG_IP, ("IPDR->HeaderSize = %d\n", IPDR->HeaderSize));
   TI_DbgPrint(DEBUG_IP, ("IPDR->DataSize = %d\n", IPDR->DataSize));
@@ -229,7 +183,8 @@ ReassembleDatagram(
   Data = (PVOID)((ULONG_PTR)IPPacket->Header + IPDR->HeaderSize);
   IPPacket->Data = Data;
 
-  /* Copy data from all fragments into buffer */
+  /* Copy data from all fragments into buffer. This is the only copy
+     of the data, the fragments stay in their NDIS packets until now */
   CurrentEntry = IPDR->FragmentListHead.Flink;
   while (CurrentEntry != &IPDR->FragmentListHead) {
     Fragment = CONTAINING_RECORD(CurrentEntry, IP_FRAGMENT, ListEntry);
@@ -247,24 +202,202 @@ ReassembleDatagram(
 }
 
 
-static inline VOID Cleanup(
-  PKSPIN_LOCK Lock,
-  KIRQL OldIrql,
+static BOOLEAN ReserveReassemblyMemory(
+  PIPDATAGRAM_REASSEMBLY IPDR,
+  UINT Size)
+/*
+ * FUNCTION: Accounts fragment data against the reassembly memory limit
+ * ARGUMENTS:
+ *     IPDR = Datagram the fragment belongs to
+ *     Size = Size of fragment data
+ * RETURNS:
+ *     TRUE if the fragment may be kept
+ * NOTES:
+ *     The oldest datagrams are dropped until there is room. The
+ *     reassembly lock is held when this routine is called
+ */
+{
+  PIPDATAGRAM_REASSEMBLY Oldest;
+
+  while (ReassemblyMemoryUsed + Size > REASSEMBLY_MEMORY_LIMIT) {
+    Oldest = CONTAINING_RECORD(ReassemblyListHead.Flink, IPDATAGRAM_REASSEMBLY, ListEntry);
+
+    /* Never drop the datagram that is being added to */
+    if (Oldest == IPDR)
+      return FALSE;
+
+    TI_DbgPrint(MID_TRACE, ("Reassembly memory exhausted, dropping IPDR at (0x%X).\n", Oldest));
+
+    RemoveIPDR(Oldest);
+    FreeIPDR(Oldest);
+  }
+
+  ReassemblyMemoryUsed += Size;
+  IPDR->ReceivedSize += Size;
+
+  return TRUE;
+}
+
+
+static BOOLEAN FragmentIsConsistent(
+  PIPDATAGRAM_REASSEMBLY IPDR,
+  UINT FragFirst,
+  UINT FragSize,
+  BOOLEAN MoreFragments)
+/*
+ * FUNCTION: Checks a fragment against the datagram received so far
+ * ARGUMENTS:
+ *     IPDR          = Pointer to IP datagram reassembly structure
+ *     FragFirst     = Offset of the fragment data
+ *     FragSize      = Size of the fragment data
+ *     MoreFragments = Whether the fragment is not the last one
+ * RETURNS:
+ *     FALSE if the datagram cannot be reassembled anymore
+ */
+{
+  PIP_FRAGMENT Last;
+
+  if (IPDR->FragmentCount == REASSEMBLY_MAX_FRAGMENTS)
+    return FALSE;
+
+  /* The last fragment fixes the size of the datagram */
+  if (IPDR->DataSize &&
+      (FragFirst + FragSize > IPDR->DataSize ||
+       (!MoreFragments && FragFirst + FragSize != IPDR->DataSize)))
+    return FALSE;
+
+  if (!MoreFragments && !IsListEmpty(&IPDR->FragmentListHead)) {
+    Last = CONTAINING_RECORD(IPDR->FragmentListHead.Blink, IP_FRAGMENT, ListEntry);
+    if (Last->Offset + Last->Size > FragFirst + FragSize)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+static BOOLEAN InsertFragment(
+  PIPDATAGRAM_REASSEMBLY IPDR,
+  PIP_FRAGMENT Fragment,
+  PBOOLEAN Overlap)
+/*
+ * FUNCTION: Inserts a fragment into the sorted fragment list
+ * ARGUMENTS:
+ *     IPDR     = Pointer to IP datagram reassembly structure
+ *     Fragment = Fragment to insert
+ *     Overlap  = Set if the fragment overlaps one already received
+ * RETURNS:
+ *     TRUE if the fragment was inserted, FALSE if it is a duplicate
+ *     or overlaps
+ * NOTES:
+ *     Fragments mostly arrive in order, so the list is searched from
+ *     its end
+ */
+{
+  PLIST_ENTRY CurrentEntry;
+  PIP_FRAGMENT Previous = NULL, Next = NULL;
+
+  *Overlap = FALSE;
+
+  /* Find the last fragment that starts before this one */
+  CurrentEntry = IPDR->FragmentListHead.Blink;
+  while (CurrentEntry != &IPDR->FragmentListHead) {
+    Previous = CONTAINING_RECORD(CurrentEntry, IP_FRAGMENT, ListEntry);
+    if (Previous->Offset <= Fragment->Offset)
+      break;
+
+    Next = Previous;
+    Previous = NULL;
+    CurrentEntry = CurrentEntry->Blink;
+  }
+
+  if (Previous && Previous->Offset + Previous->Size > Fragment->Offset) {
+    /* A duplicate of data we already have is dropped on its own */
+    if (Previous->Offset + Previous->Size < Fragment->Offset + Fragment->Size)
+      *Overlap = TRUE;
+    return FALSE;
+  }
+
+  if (Next && Fragment->Offset + Fragment->Size > Next->Offset) {
+    *Overlap = TRUE;
+    return FALSE;
+  }
+
+  InsertHeadList(CurrentEntry, &Fragment->ListEntry);
+  IPDR->FragmentCount++;
+
+  return TRUE;
+}
+
+
+static VOID DeliverDatagram(
+  PIP_INTERFACE IF,
+  PIP_PACKET IPPacket,
   PIPDATAGRAM_REASSEMBLY IPDR)
 /*
- * FUNCTION: Performs cleaning operations on errors
+ * FUNCTION: Hands a complete datagram to the protocol dispatcher
  * ARGUMENTS:
- *     Lock     = Pointer to spin lock to be released
- *     OldIrql  = Value of IRQL when spin lock was acquired
- *     IPDR     = Pointer to IP datagram reassembly structure to free
- *     Buffer   = Optional pointer to a buffer to free
+ *     IF       = Pointer to IP interface packet was receive on
+ *     IPPacket = Pointer to the IP packet of the last fragment
+ *     IPDR     = Datagram, removed from the global lists. It is freed
  */
 {
-  TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+  IP_PACKET Datagram;
+  BOOLEAN Success;
+
+  TI_DbgPrint(DEBUG_IP, ("Complete datagram received.\n"));
+
+  /* FIXME: Assumes IPv4 */
+  IPInitializePacket(&Datagram, IP_ADDRESS_V4);
+
+  Success = ReassembleDatagram(&Datagram, IPDR);
 
-  TcpipReleaseSpinLock(Lock, OldIrql);
-  RemoveIPDR(IPDR);
   FreeIPDR(IPDR);
+
+  if (!Success)
+    /* Not enough free resources, discard the packet */
+    return;
+
+  /* A datagram that arrived in one piece keeps the checksum result of the adapter */
+  if (IPPacket)
+    Datagram.Flags |= (IPPacket->Flags & IP_PACKET_FLAG_L4_CHECKSUM_OK);
+
+  DISPLAY_IP_PACKET(&Datagram);
+
+  /* Give the packet to the protocol dispatcher */
+  IPDispatchProtocol(IF, &Datagram);
+
+  /* We're done with this datagram */
+  TI_DbgPrint(MAX_TRACE, ("Freeing datagram at (0x%X).\n", Datagram));
+  Datagram.Free(&Datagram);
+}
+
+
+static BOOLEAN SaveHeader(
+  PIPDATAGRAM_REASSEMBLY IPDR,
+  PIP_PACKET IPPacket)
+/*
+ * FUNCTION: Keeps the IP header of the first fragment for the datagram
+ * ARGUMENTS:
+ *     IPDR     = Pointer to IP datagram reassembly structure
+ *     IPPacket = Pointer to IP packet of the first fragment
+ * RETURNS:
+ *     FALSE if there was not enough free resources
+ */
+{
+  IPDR->IPv4Header = ExAllocatePoolWithTag(NonPagedPool,
+                                           IPPacket->HeaderSize,
+                                           PACKET_BUFFER_TAG);
+  if (!IPDR->IPv4Header)
+    return FALSE;
+
+  RtlCopyMemory(IPDR->IPv4Header, IPPacket->Header, IPPacket->HeaderSize);
+  IPDR->HeaderSize = IPPacket->HeaderSize;
+
+  TI_DbgPrint(DEBUG_IP, ("First fragment found. Header buffer is at (0x%X). "
+                         "Header size is (%d).\n", IPDR->IPv4Header, IPPacket->HeaderSize));
+
+  return TRUE;
 }
 
 
@@ -283,202 +416,169 @@ VOID ProcessFragment(
 {
   KIRQL OldIrql;
   PIPDATAGRAM_REASSEMBLY IPDR;
-  PLIST_ENTRY CurrentEntry;
-  PIPDATAGRAM_HOLE Hole, NewHole;
-  USHORT FragFirst;
-  USHORT FragLast;
-  BOOLEAN MoreFragments;
+  UINT FragFirst, FragSize;
+  BOOLEAN MoreFragments, Overlap;
   PIPv4_HEADER IPv4Header;
-  IP_PACKET Datagram;
   PIP_FRAGMENT Fragment;
-  BOOLEAN Success;
+  PLIST_ENTRY BucketHead;
 
   /* FIXME: Assume IPv4 */
 
   IPv4Header = (PIPv4_HEADER)IPPacket->Header;
 
-  /* Check if we already have an reassembly structure for this datagram */
-  IPDR = GetReassemblyInfo(IPPacket);
-  if (IPDR) {
-    TI_DbgPrint(DEBUG_IP, ("Continueing assembly.\n"));
-    /* We have a reassembly structure */
-    TcpipAcquireSpinLock(&IPDR->Lock, &OldIrql);
-
-    /* Reset the timeout since we received a fragment */
-    IPDR->TimeoutCount = 0;
-  } else {
-    TI_DbgPrint(DEBUG_IP, ("Starting new assembly.\n"));
-
-    /* We don't have a reassembly structure, create one */
-    IPDR = ExAllocateFromNPagedLookasideList(&IPDRList);
-    if (!IPDR)
-      /* We don't have the resources to process this packet, discard it */
-      return;
-
-    /* Create a descriptor spanning from zero to infinity.
-       Actually, we use a value slightly greater than the
-       maximum number of octets an IP datagram can contain */
-    Hole = CreateHoleDescriptor(0, 65536);
-    if (!Hole) {
-      /* We don't have the resources to process this packet, discard it */
-      ExFreeToNPagedLookasideList(&IPDRList, IPDR);
-      return;
-    }
-    AddrInitIPv4(&IPDR->SrcAddr, IPv4Header->SrcAddr);
-    AddrInitIPv4(&IPDR->DstAddr, IPv4Header->DstAddr);
-    IPDR->Id         = IPv4Header->Id;
-    IPDR->Protocol   = IPv4Header->Protocol;
-    IPDR->TimeoutCount = 0;
-    InitializeListHead(&IPDR->FragmentListHead);
-    InitializeListHead(&IPDR->HoleListHead);
-    InsertTailList(&IPDR->HoleListHead, &Hole->ListEntry);
-
-    TcpipInitializeSpinLock(&IPDR->Lock);
-
-    TcpipAcquireSpinLock(&IPDR->Lock, &OldIrql);
-
-    /* Update the reassembly list */
-    TcpipInterlockedInsertTailList(
-	&ReassemblyListHead,
-	&IPDR->ListEntry,
-	&ReassemblyListLock);
+  if (IPPacket->TotalSize < IPPacket->HeaderSize) {
+    TI_DbgPrint(MIN_TRACE, ("Datagram received with incorrect total length (%d).\n",
+      IPPacket->TotalSize));
+    return;
   }
 
   FragFirst     = (WN2H(IPv4Header->FlagsFragOfs) & IPv4_FRAGOFS_MASK) << 3;
-  FragLast      = FragFirst + WN2H(IPv4Header->TotalLength);
+  FragSize      = IPPacket->TotalSize - IPPacket->HeaderSize;
   MoreFragments = (WN2H(IPv4Header->FlagsFragOfs) & IPv4_MF_MASK) > 0;
 
-  CurrentEntry = IPDR->HoleListHead.Flink;
-  for (;;) {
-    if (CurrentEntry == &IPDR->HoleListHead)
-        break;
+  /* Only the last fragment may have a size that is not a multiple of 8 */
+  if ((MoreFragments && (FragSize == 0 || (FragSize & 7))) ||
+      (FragFirst + FragSize + IPPacket->HeaderSize > IPv4_MAX_DATAGRAM_SIZE)) {
+    TI_DbgPrint(MIN_TRACE, ("Invalid fragment (%d,%d) discarded.\n", FragFirst, FragSize));
+    return;
+  }
 
-    Hole = CONTAINING_RECORD(CurrentEntry, IPDATAGRAM_HOLE, ListEntry);
+  Fragment = ExAllocateFromNPagedLookasideList(&IPFragmentList);
+  if (!Fragment) {
+    /* We don't have the resources to process this packet, discard it */
+    return;
+  }
 
-    TI_DbgPrint(DEBUG_IP, ("Comparing Fragment (%d,%d) to Hole (%d,%d).\n",
-      FragFirst, FragLast, Hole->First, Hole->Last));
+  TI_DbgPrint(DEBUG_IP, ("Fragment descriptor allocated at (0x%X).\n", Fragment));
 
-    if ((FragFirst > Hole->Last) || (FragLast < Hole->First)) {
-      TI_DbgPrint(MID_TRACE, ("No overlap.\n"));
-      /* The fragment does not overlap with the hole, try next
-         descriptor in the list */
+  Fragment->Size = FragSize;
+  Fragment->Packet = IPPacket->NdisPacket;
+  Fragment->ReturnPacket = IPPacket->ReturnPacket;
+  Fragment->PacketOffset = IPPacket->Position + IPPacket->HeaderSize;
+  Fragment->Offset = FragFirst;
 
-      CurrentEntry = CurrentEntry->Flink;
-      continue;
+  /* A datagram that is not fragmented skips the reassembly lists */
+  if (FragFirst == 0 && !MoreFragments) {
+    IPDR = ExAllocateFromNPagedLookasideList(&IPDRList);
+    if (!IPDR) {
+      ExFreeToNPagedLookasideList(&IPFragmentList, Fragment);
+      return;
     }
 
-    /* The fragment overlap with the hole, unlink the descriptor */
-    RemoveEntryList(CurrentEntry);
-
-    if (FragFirst > Hole->First) {
-      NewHole = CreateHoleDescriptor(Hole->First, FragFirst - 1);
-      if (!NewHole) {
-        /* We don't have the resources to process this packet, discard it */
-        ExFreeToNPagedLookasideList(&IPHoleList, Hole);
-        Cleanup(&IPDR->Lock, OldIrql, IPDR);
-        return;
-      }
-
-      /* Put the new descriptor in the list */
-      InsertTailList(&IPDR->HoleListHead, &NewHole->ListEntry);
-    }
+    RtlZeroMemory(IPDR, sizeof(*IPDR));
+    AddrInitIPv4(&IPDR->SrcAddr, IPv4Header->SrcAddr);
+    AddrInitIPv4(&IPDR->DstAddr, IPv4Header->DstAddr);
+    IPDR->DataSize = FragSize;
+    InitializeListHead(&IPDR->FragmentListHead);
+    InsertTailList(&IPDR->FragmentListHead, &Fragment->ListEntry);
 
-    if ((FragLast < Hole->Last) && MoreFragments) {
-      NewHole = CreateHoleDescriptor(FragLast + 1, Hole->Last);
-      if (!NewHole) {
-        /* We don't have the resources to process this packet, discard it */
-        ExFreeToNPagedLookasideList(&IPHoleList, Hole);
-        Cleanup(&IPDR->Lock, OldIrql, IPDR);
-        return;
-      }
+    /* Disassociate the NDIS packet so it isn't freed upon return from IPReceive() */
+    IPPacket->NdisPacket = NULL;
 
-      /* Put the new hole descriptor in the list */
-      InsertTailList(&IPDR->HoleListHead, &NewHole->ListEntry);
+    if (!SaveHeader(IPDR, IPPacket)) {
+      TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+      FreeIPDR(IPDR);
+      return;
     }
 
-    ExFreeToNPagedLookasideList(&IPHoleList, Hole);
-
-    /* If this is the first fragment, save the IP header */
-    if (FragFirst == 0) {
-        IPDR->IPv4Header = ExAllocatePoolWithTag(NonPagedPool,
-                                                 IPPacket->HeaderSize,
-                                                 PACKET_BUFFER_TAG);
-        if (!IPDR->IPv4Header)
-        {
-            Cleanup(&IPDR->Lock, OldIrql, IPDR);
-            return;
-        }
-
-        RtlCopyMemory(IPDR->IPv4Header, IPPacket->Header, IPPacket->HeaderSize);
-        IPDR->HeaderSize = IPPacket->HeaderSize;
+    DeliverDatagram(IF, IPPacket, IPDR);
+    return;
+  }
 
-        TI_DbgPrint(DEBUG_IP, ("First fragment found. Header buffer is at (0x%X). "
-                               "Header size is (%d).\n", &IPDR->IPv4Header, IPPacket->HeaderSize));
+  TcpipAcquireSpinLock(&ReassemblyListLock, &OldIrql);
 
-    }
+  /* Check if we already have an reassembly structure for this datagram */
+  IPDR = GetReassemblyInfo(IPPacket);
+  if (IPDR) {
+    TI_DbgPrint(DEBUG_IP, ("Continueing assembly.\n"));
 
-    /* Create a buffer, copy the data into it and put it
-       in the fragment list */
+    /* Reset the timeout since we received a fragment */
+    IPDR->Deadline = IpTimerExpirations + MAX_TIMEOUT_COUNT;
+    RemoveEntryList(&IPDR->ListEntry);
+    InsertTailList(&ReassemblyListHead, &IPDR->ListEntry);
+  } else {
+    TI_DbgPrint(DEBUG_IP, ("Starting new assembly.\n"));
 
-    Fragment = ExAllocateFromNPagedLookasideList(&IPFragmentList);
-    if (!Fragment) {
+    /* We don't have a reassembly structure, create one */
+    IPDR = ExAllocateFromNPagedLookasideList(&IPDRList);
+    if (!IPDR) {
       /* We don't have the resources to process this packet, discard it */
-      Cleanup(&IPDR->Lock, OldIrql, IPDR);
+      TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
+      ExFreeToNPagedLookasideList(&IPFragmentList, Fragment);
       return;
     }
 
-    TI_DbgPrint(DEBUG_IP, ("Fragment descriptor allocated at (0x%X).\n", Fragment));
-
-    Fragment->Size = IPPacket->TotalSize - IPPacket->HeaderSize;
-    Fragment->Packet = IPPacket->NdisPacket;
-    Fragment->ReturnPacket = IPPacket->ReturnPacket;
-    Fragment->PacketOffset = IPPacket->Position + IPPacket->HeaderSize;
-    Fragment->Offset = FragFirst;
-
-    /* Disassociate the NDIS packet so it isn't freed upon return from IPReceive() */
-    IPPacket->NdisPacket = NULL;
+    RtlZeroMemory(IPDR, sizeof(*IPDR));
+    AddrInitIPv4(&IPDR->SrcAddr, IPv4Header->SrcAddr);
+    AddrInitIPv4(&IPDR->DstAddr, IPv4Header->DstAddr);
+    IPDR->Id         = IPv4Header->Id;
+    IPDR->Protocol   = IPv4Header->Protocol;
+    IPDR->Deadline   = IpTimerExpirations + MAX_TIMEOUT_COUNT;
+    InitializeListHead(&IPDR->FragmentListHead);
 
-    /* If this is the last fragment, compute and save the datagram data size */
-    if (!MoreFragments)
-      IPDR->DataSize = FragFirst + Fragment->Size;
+    BucketHead = &ReassemblyHashTable[REASSEMBLY_HASH(IPv4Header->SrcAddr,
+                                                      IPv4Header->Id,
+                                                      IPv4Header->Protocol)];
+    InsertTailList(BucketHead, &IPDR->HashEntry);
+    InsertTailList(&ReassemblyListHead, &IPDR->ListEntry);
+  }
 
-    /* Put the fragment in the list */
-    InsertTailList(&IPDR->FragmentListHead, &Fragment->ListEntry);
-    break;
+  if (!FragmentIsConsistent(IPDR, FragFirst, FragSize, MoreFragments)) {
+    TI_DbgPrint(MIN_TRACE, ("Inconsistent fragment (%d,%d), dropping IPDR at (0x%X).\n",
+      FragFirst, FragSize, IPDR));
+    ExFreeToNPagedLookasideList(&IPFragmentList, Fragment);
+    RemoveIPDR(IPDR);
+    TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
+    FreeIPDR(IPDR);
+    return;
   }
 
-  TI_DbgPrint(DEBUG_IP, ("Done searching for hole descriptor.\n"));
+  if (!InsertFragment(IPDR, Fragment, &Overlap)) {
+    ExFreeToNPagedLookasideList(&IPFragmentList, Fragment);
 
-  if (IsListEmpty(&IPDR->HoleListHead)) {
-    /* Hole list is empty which means a complete datagram can be assembled.
-       Assemble the datagram and pass it to an upper layer protocol */
+    if (Overlap) {
+      /* Overlapping fragments are a known way to sneak data past filters */
+      TI_DbgPrint(MIN_TRACE, ("Overlapping fragment (%d,%d), dropping IPDR at (0x%X).\n",
+        FragFirst, FragSize, IPDR));
+      RemoveIPDR(IPDR);
+      TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
+      FreeIPDR(IPDR);
+      return;
+    }
 
-    TI_DbgPrint(DEBUG_IP, ("Complete datagram received.\n"));
+    TI_DbgPrint(MID_TRACE, ("Duplicate fragment (%d,%d) discarded.\n", FragFirst, FragSize));
+    TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
+    return;
+  }
 
+  if (!ReserveReassemblyMemory(IPDR, FragSize) ||
+      (FragFirst == 0 && !SaveHeader(IPDR, IPPacket))) {
+    /* We don't have the resources to process this packet, discard the datagram */
+    TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+    RemoveEntryList(&Fragment->ListEntry);
+    ExFreeToNPagedLookasideList(&IPFragmentList, Fragment);
     RemoveIPDR(IPDR);
-    TcpipReleaseSpinLock(&IPDR->Lock, OldIrql);
-
-    /* FIXME: Assumes IPv4 */
-    IPInitializePacket(&Datagram, IP_ADDRESS_V4);
-
-    Success = ReassembleDatagram(&Datagram, IPDR);
-
+    TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
     FreeIPDR(IPDR);
+    return;
+  }
 
-    if (!Success)
-      /* Not enough free resources, discard the packet */
-      return;
+  /* Disassociate the NDIS packet so it isn't freed upon return from IPReceive() */
+  IPPacket->NdisPacket = NULL;
 
-    DISPLAY_IP_PACKET(&Datagram);
+  /* If this is the last fragment, save the datagram data size */
+  if (!MoreFragments)
+    IPDR->DataSize = FragFirst + FragSize;
 
-    /* Give the packet to the protocol dispatcher */
-    IPDispatchProtocol(IF, &Datagram);
+  if (IPDR->DataSize && IPDR->IPv4Header && IPDR->ReceivedSize == IPDR->DataSize) {
+    /* Every byte is there, which means a complete datagram can be assembled.
+       Assemble the datagram and pass it to an upper layer protocol */
+    RemoveIPDR(IPDR);
+    TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
 
-    /* We're done with this datagram */
-    TI_DbgPrint(MAX_TRACE, ("Freeing datagram at (0x%X).\n", Datagram));
-    Datagram.Free(&Datagram);
+    DeliverDatagram(IF, NULL, IPDR);
   } else
-    TcpipReleaseSpinLock(&IPDR->Lock, OldIrql);
+    TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
 }
 
 
@@ -489,23 +589,18 @@ VOID IPFreeReassemblyList(
  */
 {
   KIRQL OldIrql;
-  PLIST_ENTRY CurrentEntry, NextEntry;
   PIPDATAGRAM_REASSEMBLY Current;
 
   TcpipAcquireSpinLock(&ReassemblyListLock, &OldIrql);
 
-  CurrentEntry = ReassemblyListHead.Flink;
-  while (CurrentEntry != &ReassemblyListHead) {
-    NextEntry = CurrentEntry->Flink;
-    Current = CONTAINING_RECORD(CurrentEntry, IPDATAGRAM_REASSEMBLY, ListEntry);
+  while (!IsListEmpty(&ReassemblyListHead)) {
+    Current = CONTAINING_RECORD(ReassemblyListHead.Flink, IPDATAGRAM_REASSEMBLY, ListEntry);
 
-    /* Unlink it from the list */
-    RemoveEntryList(CurrentEntry);
+    /* Unlink it from the lists */
+    RemoveIPDR(Current);
 
     /* And free the descriptor */
     FreeIPDR(Current);
-
-    CurrentEntry = NextEntry;
   }
 
   TcpipReleaseSpinLock(&ReassemblyListLock, OldIrql);
@@ -518,35 +613,24 @@ VOID IPDatagramReassemblyTimeout(
  * FUNCTION: IP datagram reassembly timeout handler
  * NOTES:
  *     This routine is called by IPTimeout to free any resources used
- *     to hold IP fragments that have taken too long to reassemble
+ *     to hold IP fragments that have taken too long to reassemble.
+ *     The list is kept in the order fragments last arrived, so only
+ *     the expired datagrams at its head are looked at
  */
 {
-    PLIST_ENTRY CurrentEntry, NextEntry;
     PIPDATAGRAM_REASSEMBLY CurrentIPDR;
 
     TcpipAcquireSpinLockAtDpcLevel(&ReassemblyListLock);
 
-    CurrentEntry = ReassemblyListHead.Flink;
-    while (CurrentEntry != &ReassemblyListHead)
+    while (!IsListEmpty(&ReassemblyListHead))
     {
-       NextEntry = CurrentEntry->Flink;
-       CurrentIPDR = CONTAINING_RECORD(CurrentEntry, IPDATAGRAM_REASSEMBLY, ListEntry);
-
-       TcpipAcquireSpinLockAtDpcLevel(&CurrentIPDR->Lock);
-
-       if (++CurrentIPDR->TimeoutCount == MAX_TIMEOUT_COUNT)
-       {
-           TcpipReleaseSpinLockFromDpcLevel(&CurrentIPDR->Lock);
-           RemoveEntryList(CurrentEntry);
-           FreeIPDR(CurrentIPDR);
-       }
-       else
-       {
-           ASSERT(CurrentIPDR->TimeoutCount < MAX_TIMEOUT_COUNT);
-           TcpipReleaseSpinLockFromDpcLevel(&CurrentIPDR->Lock);
-       }
-
-       CurrentEntry = NextEntry;
+       CurrentIPDR = CONTAINING_RECORD(ReassemblyListHead.Flink, IPDATAGRAM_REASSEMBLY, ListEntry);
+
+       if ((LONG)(IpTimerExpirations - CurrentIPDR->Deadline) < 0)
+           break;
+
+       RemoveIPDR(CurrentIPDR);
+       FreeIPDR(CurrentIPDR);
     }
 
     TcpipReleaseSpinLockFromDpcLevel(&ReassemblyListLock);
@@ -611,8 +695,9 @@ VOID IPv4Receive(PIP_INTERFACE IF, PIP_PACKET IPPacket)
         return;
     }
 
-    /* Checksum IPv4 header */
-    if (!IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
+    /* Checksum IPv4 header unless the adapter already did */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_IP_CHECKSUM_OK) &&
+        !IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
         TI_DbgPrint(MIN_TRACE, ("Datagram received with bad checksum. Checksum field (0x%X)\n",
 	      WN2H(((PIPv4_HEADER)IPPacket->Header)->Checksum)));
         /* Discard packet */
@@ -16,6 +16,21 @@
 
 LIST_ENTRY FIBListHead;
 KSPIN_LOCK FIBLock;
+PFIB_NODE FIBRoot;
+ULONG FIBGeneration;
+ROUTE_CACHE_ENTRY RouteCache[ROUTE_CACHE_SIZE];
+
+#define ROUTE_CACHE_HASH(Address) \
+    (((Address) ^ ((Address) >> 8) ^ ((Address) >> 16)) & (ROUTE_CACHE_SIZE - 1))
+
+#define FIB_PREFIX_MASK(Length) \
+    ((Length) ? (0xFFFFFFFF << (32 - (Length))) : 0)
+
+#define FIB_NEXT_BIT(Address, Length) \
+    (((Address) >> (31 - (Length))) & 1)
+
+#define FIB_ROUTER_USABLE(NCE) \
+    (!((NCE)->State & NUD_STALE) && !((NCE)->State & NUD_INCOMPLETE))
 
 void RouterDumpRoutes() {
     PLIST_ENTRY CurrentEntry;
@@ -54,6 +69,226 @@ VOID FreeFIB(
 }
 
 
+VOID FIBInvalidateRouteCache(
+    VOID)
+/*
+ * FUNCTION: Invalidates all the cached routes
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    /* Generation 0 is never valid */
+    if (++FIBGeneration == 0)
+        FIBGeneration = 1;
+}
+
+
+PFIB_NODE FIBCreateNode(
+    ULONG Prefix,
+    UINT Length)
+/*
+ * FUNCTION: Creates a prefix trie node
+ * ARGUMENTS:
+ *     Prefix = Network prefix in host order
+ *     Length = Length of the prefix in bits
+ * RETURNS:
+ *     Pointer to the node, NULL if there were not enough resources
+ */
+{
+    PFIB_NODE Node;
+
+    Node = ExAllocatePoolWithTag(NonPagedPool, sizeof(FIB_NODE), FIB_TAG);
+    if (!Node) {
+        TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+        return NULL;
+    }
+
+    Node->Parent   = NULL;
+    Node->Child[0] = NULL;
+    Node->Child[1] = NULL;
+    Node->Prefix   = Prefix & FIB_PREFIX_MASK(Length);
+    Node->Length   = Length;
+    InitializeListHead(&Node->RouteListHead);
+
+    return Node;
+}
+
+
+PFIB_NODE FIBInsertNode(
+    ULONG Prefix,
+    UINT Length)
+/*
+ * FUNCTION: Finds or creates the prefix trie node of a network
+ * ARGUMENTS:
+ *     Prefix = Network prefix in host order
+ *     Length = Length of the prefix in bits
+ * RETURNS:
+ *     Pointer to the node, NULL if there were not enough resources
+ * NOTES:
+ *     The forward information base lock must be held when called.
+ *     The trie is path compressed, nodes without routes only exist
+ *     where two longer prefixes branch off
+ */
+{
+    PFIB_NODE *Link = &FIBRoot;
+    PFIB_NODE Parent = NULL;
+    PFIB_NODE Node, NewNode, Branch;
+    ULONG Difference;
+    UINT Common;
+
+    Prefix &= FIB_PREFIX_MASK(Length);
+
+    while ((Node = *Link) != NULL) {
+        /* Find how many leading bits of the node's prefix we share */
+        Difference = Prefix ^ Node->Prefix;
+        for (Common = 0;
+             Common < min(Length, Node->Length) && !(Difference & (0x80000000 >> Common));
+             Common++);
+
+        if (Common == Node->Length) {
+            if (Node->Length == Length)
+                return Node;
+
+            /* Go down to the longer prefixes */
+            Parent = Node;
+            Link = &Node->Child[FIB_NEXT_BIT(Prefix, Node->Length)];
+            continue;
+        }
+
+        NewNode = FIBCreateNode(Prefix, Length);
+        if (!NewNode)
+            return NULL;
+
+        if (Common == Length) {
+            /* The new prefix is shorter, it takes the place of the node */
+            NewNode->Parent = Parent;
+            NewNode->Child[FIB_NEXT_BIT(Node->Prefix, Length)] = Node;
+            Node->Parent = NewNode;
+            *Link = NewNode;
+            return NewNode;
+        }
+
+        /* The prefixes diverge, insert a branch node */
+        Branch = FIBCreateNode(Prefix, Common);
+        if (!Branch) {
+            ExFreePoolWithTag(NewNode, FIB_TAG);
+            return NULL;
+        }
+
+        Branch->Parent = Parent;
+        Branch->Child[FIB_NEXT_BIT(Node->Prefix, Common)] = Node;
+        Branch->Child[FIB_NEXT_BIT(Prefix, Common)] = NewNode;
+        Node->Parent = Branch;
+        NewNode->Parent = Branch;
+        *Link = Branch;
+        return NewNode;
+    }
+
+    NewNode = FIBCreateNode(Prefix, Length);
+    if (!NewNode)
+        return NULL;
+
+    NewNode->Parent = Parent;
+    *Link = NewNode;
+    return NewNode;
+}
+
+
+VOID FIBRemoveNode(
+    PFIB_NODE Node)
+/*
+ * FUNCTION: Removes a prefix trie node if it is no longer needed
+ * ARGUMENTS:
+ *     Node = Pointer to the node
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE Parent, Child, *Link;
+
+    while (Node && IsListEmpty(&Node->RouteListHead)) {
+        /* Keep it if two longer prefixes branch off here */
+        if (Node->Child[0] && Node->Child[1])
+            break;
+
+        Parent = Node->Parent;
+        Link = Parent ? &Parent->Child[Parent->Child[1] == Node] : &FIBRoot;
+        Child = Node->Child[0] ? Node->Child[0] : Node->Child[1];
+
+        /* Replace the node with its only child */
+        *Link = Child;
+        if (Child)
+            Child->Parent = Parent;
+
+        ExFreePoolWithTag(Node, FIB_TAG);
+
+        /* The parent lost a child, it may not be needed anymore */
+        if (Child)
+            break;
+
+        Node = Parent;
+    }
+}
+
+
+PNEIGHBOR_CACHE_ENTRY FIBLookup(
+    ULONG Destination,
+    PBOOLEAN Cacheable)
+/*
+ * FUNCTION: Finds the longest prefix route to an IPv4 destination
+ * ARGUMENTS:
+ *     Destination = Destination address in host order
+ *     Cacheable   = Optional, set if the result only changes when the
+ *                   routes change or the router stops being usable
+ * RETURNS:
+ *     Pointer to NCE of the router, NULL if there is no route
+ * NOTES:
+ *     The forward information base lock must be held when called.
+ *     Routers that are stale or incomplete are only used if there
+ *     is no other route
+ */
+{
+    PFIB_NODE Node = FIBRoot;
+    PLIST_ENTRY CurrentEntry;
+    PFIB_ENTRY Current;
+    PNEIGHBOR_CACHE_ENTRY BestNCE = NULL, FallbackNCE = NULL;
+    BOOLEAN FirstUsable = FALSE;
+
+    while (Node && !((Destination ^ Node->Prefix) & FIB_PREFIX_MASK(Node->Length))) {
+        CurrentEntry = Node->RouteListHead.Flink;
+        if (CurrentEntry != &Node->RouteListHead) {
+            Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, NodeListEntry);
+            FallbackNCE = Current->Router;
+
+            /* Any other result would change once the first router becomes usable */
+            FirstUsable = FIB_ROUTER_USABLE(Current->Router);
+        }
+
+        /* The first usable router of the longest prefix wins */
+        while (CurrentEntry != &Node->RouteListHead) {
+            Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, NodeListEntry);
+
+            if (FIB_ROUTER_USABLE(Current->Router)) {
+                BestNCE = Current->Router;
+                break;
+            }
+
+            CurrentEntry = CurrentEntry->Flink;
+        }
+
+        if (Node->Length == 32)
+            break;
+
+        Node = Node->Child[FIB_NEXT_BIT(Destination, Node->Length)];
+    }
+
+    if (Cacheable)
+        *Cacheable = FirstUsable;
+
+    return BestNCE ? BestNCE : FallbackNCE;
+}
+
+
 VOID DestroyFIBE(
     PFIB_ENTRY FIBE)
 /*
@@ -69,6 +304,14 @@ VOID DestroyFIBE(
     /* Unlink the FIB entry from the list */
     RemoveEntryList(&FIBE->ListEntry);
 
+    /* Unlink it from the prefix trie */
+    if (FIBE->Node) {
+        RemoveEntryList(&FIBE->NodeListEntry);
+        FIBRemoveNode(FIBE->Node);
+    }
+
+    FIBInvalidateRouteCache();
+
     /* And free the FIB entry */
     FreeFIB(FIBE);
 }
@@ -206,6 +449,7 @@ PFIB_ENTRY RouterAddRoute(
  *     these references
  */
 {
+    KIRQL OldIrql;
     PFIB_ENTRY FIBE;
 
     TI_DbgPrint(DEBUG_ROUTER, ("Called. NetworkAddress (0x%X)  Netmask (0x%X) "
@@ -228,9 +472,28 @@ PFIB_ENTRY RouterAddRoute(
 		   sizeof(FIBE->Netmask) );
     FIBE->Router         = Router;
     FIBE->Metric         = Metric;
+    FIBE->Node           = NULL;
+
+    TcpipAcquireSpinLock(&FIBLock, &OldIrql);
+
+    /* IPv4 routes are also looked up through the prefix trie */
+    if (NetworkAddress->Type == IP_ADDRESS_V4 && Netmask->Type == IP_ADDRESS_V4) {
+        FIBE->Node = FIBInsertNode(IPv4NToHl(NetworkAddress->Address.IPv4Address),
+                                   AddrCountPrefixBits(Netmask));
+        if (!FIBE->Node) {
+            TcpipReleaseSpinLock(&FIBLock, OldIrql);
+            FreeFIB(FIBE);
+            return NULL;
+        }
+
+        InsertTailList(&FIBE->Node->RouteListHead, &FIBE->NodeListEntry);
+    }
 
     /* Add FIB to the forward information base */
-    TcpipInterlockedInsertTailList(&FIBListHead, &FIBE->ListEntry, &FIBLock);
+    InsertTailList(&FIBListHead, &FIBE->ListEntry);
+    FIBInvalidateRouteCache();
+
+    TcpipReleaseSpinLock(&FIBLock, OldIrql);
 
     return FIBE;
 }
@@ -254,6 +517,9 @@ PNEIGHBOR_CACHE_ENTRY RouterGetRoute(PIP_ADDRESS Destination)
     UCHAR State;
     UINT Length, BestLength = 0, MaskLength;
     PNEIGHBOR_CACHE_ENTRY NCE, BestNCE = NULL;
+    PROUTE_CACHE_ENTRY CacheEntry;
+    ULONG Address;
+    BOOLEAN Cacheable;
 
     TI_DbgPrint(DEBUG_ROUTER, ("Called. Destination (0x%X)\n", Destination));
 
@@ -261,6 +527,38 @@ PNEIGHBOR_CACHE_ENTRY RouterGetRoute(PIP_ADDRESS Destination)
 
     TcpipAcquireSpinLock(&FIBLock, &OldIrql);
 
+    if (Destination->Type == IP_ADDRESS_V4) {
+        Address = IPv4NToHl(Destination->Address.IPv4Address);
+        CacheEntry = &RouteCache[ROUTE_CACHE_HASH(Address)];
+
+        /* Try the route cache first, it is flushed when the routes change.
+           Only routes through the first router of the longest prefix are
+           cached, so the neighbor states need not be watched */
+        if (CacheEntry->Generation == FIBGeneration &&
+            CacheEntry->Destination == Address &&
+            FIB_ROUTER_USABLE(CacheEntry->Router)) {
+            BestNCE = CacheEntry->Router;
+        } else {
+            BestNCE = FIBLookup(Address, &Cacheable);
+
+            if (BestNCE && Cacheable) {
+                CacheEntry->Destination = Address;
+                CacheEntry->Router      = BestNCE;
+                CacheEntry->Generation  = FIBGeneration;
+            }
+        }
+
+        TcpipReleaseSpinLock(&FIBLock, OldIrql);
+
+        if( BestNCE ) {
+            TI_DbgPrint(DEBUG_ROUTER,("Routing to %s\n", A2S(&BestNCE->Address)));
+        } else {
+            TI_DbgPrint(DEBUG_ROUTER,("Packet won't be routed\n"));
+        }
+
+        return BestNCE;
+    }
+
     CurrentEntry = FIBListHead.Flink;
     while (CurrentEntry != &FIBListHead) {
         NextEntry = CurrentEntry->Flink;
@@ -492,6 +790,11 @@ NTSTATUS RouterStartup(
     /* Initialize the Forward Information Base */
     InitializeListHead(&FIBListHead);
     TcpipInitializeSpinLock(&FIBLock);
+    FIBRoot = NULL;
+
+    /* Start with an empty route cache */
+    RtlZeroMemory(RouteCache, sizeof(RouteCache));
+    FIBGeneration = 1;
 
     return STATUS_SUCCESS;
 }
@@ -75,6 +75,7 @@ BOOLEAN PrepareNextFragment(
     PIPv4_HEADER Header;
     BOOLEAN MoreFragments;
     USHORT FragOfs;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
 
     TI_DbgPrint(MAX_TRACE, ("Called. IFC (0x%X)\n", IFC));
 
@@ -83,9 +84,9 @@ BOOLEAN PrepareNextFragment(
         TI_DbgPrint(MAX_TRACE, ("Preparing 1 fragment.\n"));
 
         MaxData  = IFC->PathMTU - IFC->HeaderSize;
-        /* Make fragment a multiplum of 64bit */
-        MaxData -= MaxData % 8;
         if (IFC->BytesLeft > MaxData) {
+            /* Make fragment a multiplum of 64bit */
+            MaxData      -= MaxData % 8;
             DataSize      = MaxData;
             MoreFragments = TRUE;
         } else {
@@ -112,9 +113,12 @@ BOOLEAN PrepareNextFragment(
 
         /* FIXME: Handle options */
 
-        /* Calculate checksum of IP header */
+        /* Calculate checksum of IP header, unless the adapter does */
         Header->Checksum = 0;
-        Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
+        ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket,
+                                                                          TcpIpChecksumPacketInfo));
+        if (!ChecksumInfo.Transmit.NdisPacketIpChecksum)
+            Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
 	TI_DbgPrint(MID_TRACE,("IP Check: %x\n", Header->Checksum));
 
         /* Update pointers */
@@ -196,6 +200,14 @@ NTSTATUS SendFragments(
 
     RtlCopyMemory( IFC->Header, IPPacket->Header, IPPacket->HeaderSize );
 
+    /* Offloads only apply to a datagram that is sent in one piece */
+    if (IFC->BytesLeft <= PathMTU - IFC->HeaderSize) {
+        NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpIpChecksumPacketInfo) =
+            NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket->NdisPacket, TcpIpChecksumPacketInfo);
+        NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpLargeSendPacketInfo) =
+            NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket->NdisPacket, TcpLargeSendPacketInfo);
+    }
+
     while (PrepareNextFragment(IFC))
     {
         NdisStatus = IPSendFragment(IFC->NdisPacket, NCE, IFC);
@@ -238,6 +250,14 @@ NTSTATUS IPSendDatagram(PIP_PACKET IPPacket, PNEIGHBOR_CACHE_ENTRY NCE)
 
     DISPLAY_IP_PACKET(IPPacket);
 
+    /* Datagrams to ourselves skip fragmentation and the neighbor cache */
+    if (NCE->Interface == Loopback)
+        return LoopDeliverDatagram(IPPacket);
+
+    /* The adapter cuts a large send into segments, it is never fragmented */
+    if (NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket->NdisPacket, TcpLargeSendPacketInfo))
+        return SendFragments(IPPacket, NCE, IPPacket->TotalSize);
+
     /* Fetch path MTU now, because it may change */
     TI_DbgPrint(MID_TRACE,("PathMTU: %d\n", NCE->Interface->MTU));
 
@@ -7,6 +7,134 @@
 #include "lwip/api.h"
 #include "lwip/tcpip.h"
 
+/* Largest IPv4 or TCP header in front of the data of a large send */
+#define TCP_MAX_HEADER_SIZE 60
+
+static
+VOID
+TCPFinishChecksum(PIP_PACKET Packet, PIP_INTERFACE Interface, ULONG Mss)
+/*
+ * FUNCTION: Fills in the TCP checksum lwIP left out for the adapter
+ * ARGUMENTS:
+ *     Packet    = Pointer to an IP packet holding a TCP segment
+ *     Interface = Pointer to the interface the packet is sent on
+ *     Mss       = Segment size of a large send, 0 for a plain segment
+ * NOTES:
+ *     An adapter that computes the checksum starts from the pseudo-header
+ *     checksum in the checksum field, without the length for a large send
+ */
+{
+    PIPv4_HEADER Header = Packet->Header;
+    PTCPv4_HEADER TcpHeader;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    ULONG IpHeaderLength, TcpLength, Sum;
+
+    IpHeaderLength = (Header->VerIHL & 0x0F) << 2;
+    TcpHeader = (PTCPv4_HEADER)((PUCHAR)Header + IpHeaderLength);
+    TcpLength = Packet->TotalSize - IpHeaderLength;
+
+    Sum = ChecksumCompute(&Header->SrcAddr, 2 * sizeof(IPv4_RAW_ADDRESS), 0);
+    Sum += WH2N(IPPROTO_TCP);
+
+    if (Interface->OffloadFlags & IP_OFFLOAD_TX_TCP_CHECKSUM)
+    {
+        if (Mss == 0)
+            Sum += WH2N((USHORT)TcpLength);
+        TcpHeader->Checksum = (USHORT)ChecksumFold(Sum);
+
+        ChecksumInfo.Value = 0;
+        ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+        ChecksumInfo.Transmit.NdisPacketTcpChecksum = 1;
+        if (Interface->OffloadFlags & IP_OFFLOAD_TX_IP_CHECKSUM)
+            ChecksumInfo.Transmit.NdisPacketIpChecksum = 1;
+
+        NDIS_PER_PACKET_INFO_FROM_PACKET(Packet->NdisPacket, TcpIpChecksumPacketInfo) =
+            UlongToPtr(ChecksumInfo.Value);
+        /* This is NOT a pointer. MSDN explicitly says so. */
+        NDIS_PER_PACKET_INFO_FROM_PACKET(Packet->NdisPacket, TcpLargeSendPacketInfo) =
+            UlongToPtr(Mss);
+    }
+    else
+    {
+        ASSERT(Mss == 0);
+
+        Sum += WH2N((USHORT)TcpLength);
+        TcpHeader->Checksum = 0;
+        TcpHeader->Checksum = (USHORT)TCPv4Checksum((PUCHAR)TcpHeader, TcpLength, Sum);
+    }
+}
+
+static
+NTSTATUS
+TCPSendSegments(PIP_PACKET Packet, PNEIGHBOR_CACHE_ENTRY NCE, ULONG Mss)
+/*
+ * FUNCTION: Sends a large TCP segment as segments of Mss bytes
+ * ARGUMENTS:
+ *     Packet = Pointer to an IP packet holding the large TCP segment
+ *     NCE    = Pointer to NCE for first hop to destination
+ *     Mss    = Amount of data in each segment
+ * RETURNS:
+ *     Status of operation
+ * NOTES:
+ *     Used when the route leads to an interface that cannot segment
+ *     the packet itself. Packet is freed.
+ */
+{
+    PIPv4_HEADER Header = Packet->Header, SegmentHeader;
+    PTCPv4_HEADER TcpHeader, SegmentTcpHeader;
+    IP_PACKET Segment;
+    NTSTATUS Status = STATUS_SUCCESS;
+    ULONG HeaderLength, DataLength, Offset, Size;
+    USHORT Id;
+
+    TcpHeader = (PTCPv4_HEADER)((PUCHAR)Header + ((Header->VerIHL & 0x0F) << 2));
+    HeaderLength = (ULONG)((PUCHAR)TcpHeader - (PUCHAR)Header) + ((TcpHeader->DataOffset >> 4) << 2);
+    DataLength = Packet->TotalSize - HeaderLength;
+    Id = WN2H(Header->Id);
+
+    for (Offset = 0; Offset < DataLength; Offset += Size)
+    {
+        Size = min(Mss, DataLength - Offset);
+
+        IPInitializePacket(&Segment, IP_ADDRESS_V4);
+
+        Status = AllocatePacketWithBuffer(&Segment.NdisPacket, NULL, HeaderLength + Size);
+        if (Status != NDIS_STATUS_SUCCESS)
+            break;
+
+        GetDataPtr(Segment.NdisPacket, 0, (PCHAR*)&Segment.Header, &Segment.TotalSize);
+        Segment.MappedHeader = TRUE;
+        Segment.HeaderSize = Packet->HeaderSize;
+        Segment.SrcAddr = Packet->SrcAddr;
+        Segment.DstAddr = Packet->DstAddr;
+
+        RtlCopyMemory(Segment.Header, Header, HeaderLength);
+        RtlCopyMemory((PUCHAR)Segment.Header + HeaderLength, (PUCHAR)Header + HeaderLength + Offset, Size);
+
+        SegmentHeader = Segment.Header;
+        SegmentHeader->TotalLength = WH2N((USHORT)(HeaderLength + Size));
+        SegmentHeader->Id = WH2N(Id);
+        Id++;
+
+        SegmentTcpHeader = (PTCPv4_HEADER)((PUCHAR)SegmentHeader + ((PUCHAR)TcpHeader - (PUCHAR)Header));
+        SegmentTcpHeader->SequenceNumber = DH2N(DN2H(TcpHeader->SequenceNumber) + Offset);
+
+        /* PSH and FIN go with the last segment */
+        if (Offset + Size < DataLength)
+            SegmentTcpHeader->Flags &= ~(TCP_PSH | TCP_FIN);
+
+        TCPFinishChecksum(&Segment, NCE->Interface, 0);
+
+        Status = IPSendDatagram(&Segment, NCE);
+        if (!NT_SUCCESS(Status))
+            break;
+    }
+
+    Packet->Free(Packet);
+
+    return Status;
+}
+
 err_t
 TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
 {
@@ -17,6 +145,8 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     PIPv4_HEADER Header;
     ULONG Length;
     ULONG TotalLength;
+    ULONG Mss = netif->lso_mss;
+    PIP_INTERFACE Interface;
 
     /* The caller frees the pbuf struct */
 
@@ -70,6 +200,29 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     Packet.SrcAddr = LocalAddress;
     Packet.DstAddr = RemoteAddress;
 
+    /* lwIP leaves the TCP checksum (and segmentation) to interfaces that offload it,
+     * but the route may lead to another interface */
+    if (Header->Protocol == IPPROTO_TCP && !(netif->chksum_flags & NETIF_CHECKSUM_GEN_TCP))
+    {
+        Interface = NCE->Interface;
+
+        if (Mss != 0 &&
+            (!(Interface->OffloadFlags & IP_OFFLOAD_LARGE_SEND) ||
+             TotalLength > Interface->LargeSendMaxSize ||
+             (TotalLength + Mss - 1) / Mss < Interface->LargeSendMinSegments))
+        {
+            NdisStatus = TCPSendSegments(&Packet, NCE, Mss);
+            if (!NT_SUCCESS(NdisStatus))
+                return ERR_RTE;
+
+            return 0;
+        }
+
+        /* The loopback interface takes the segment as it is */
+        if (!(Interface->OffloadFlags & IP_OFFLOAD_NO_CHECKSUM))
+            TCPFinishChecksum(&Packet, Interface, Mss);
+    }
+
     NdisStatus = IPSendDatagram(&Packet, NCE);
     if (!NT_SUCCESS(NdisStatus))
         return ERR_RTE;
@@ -103,6 +256,16 @@ TCPInterfaceInit(struct netif *netif)
     netif->output = TCPSendDataCallback;
     netif->mtu = IF->MTU;
 
+    /* IPSendDatagram fills in the IP header checksum anyway, the TCP
+     * checksum and segmentation are left to an adapter that offloads them */
+    if (IF->OffloadFlags & IP_OFFLOAD_TX_TCP_CHECKSUM)
+        NETIF_SET_CHECKSUM_CTRL(netif, NETIF_CHECKSUM_ENABLE_ALL & ~(NETIF_CHECKSUM_GEN_IP | NETIF_CHECKSUM_GEN_TCP));
+    else
+        NETIF_SET_CHECKSUM_CTRL(netif, NETIF_CHECKSUM_ENABLE_ALL & ~NETIF_CHECKSUM_GEN_IP);
+
+    if (IF->OffloadFlags & IP_OFFLOAD_LARGE_SEND)
+        netif->lso_max_size = (u16_t)min(IF->LargeSendMaxSize - 2 * TCP_MAX_HEADER_SIZE, 0xFFFF);
+
     netif->name[0] = 'e';
     netif->name[1] = 'n';
 
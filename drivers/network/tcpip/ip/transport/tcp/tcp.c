@@ -202,7 +202,8 @@ VOID TCPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
                            IPPacket->TotalSize,
                            IPPacket->HeaderSize));
 
-    LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize);
+    LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize,
+                      (IPPacket->Flags & IP_PACKET_FLAG_L4_CHECKSUM_OK) != 0);
 }
 
 NTSTATUS TCPStartup(VOID)
@@ -738,6 +739,34 @@ TCPSetNoDelay(
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+TCPSetReceiveWindow(
+    PCONNECTION_ENDPOINT Connection,
+    ULONG Size)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_UNSUCCESSFUL;
+
+    return TCPTranslateError(LibTCPSetReceiveWindow(Connection, Size));
+}
+
+NTSTATUS
+TCPSetSendBuffer(
+    PCONNECTION_ENDPOINT Connection,
+    ULONG Size)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_UNSUCCESSFUL;
+
+    return TCPTranslateError(LibTCPSetSendBuffer(Connection, Size));
+}
+
 NTSTATUS
 TCPGetSocketStatus(
     PCONNECTION_ENDPOINT Connection,
@@ -830,6 +830,50 @@ pbuf_dechain(struct pbuf *p)
   return ((tail_gone > 0) ? NULL : q);
 }
 
+#if LWIP_TCP && TCP_QUEUE_OOSEQ && LWIP_WND_SCALE
+/**
+ * Split a pbuf chain whose total length may exceed 0xFFFF (and so have
+ * overflown tot_len) after the last pbuf that still fits into 64k.
+ *
+ * @param p pbuf chain to split, its tot_len is corrected
+ * @param rest is set to the remainder of the chain or NULL if all of it fits
+ */
+void
+pbuf_split_64k(struct pbuf *p, struct pbuf **rest)
+{
+  *rest = NULL;
+  if ((p != NULL) && (p->next != NULL)) {
+    u16_t tot_len_front = p->len;
+    struct pbuf *i = p;
+    struct pbuf *r = p->next;
+
+    /* continue until the total length (summed up as u16_t) overflows */
+    while ((r != NULL) && ((u16_t)(tot_len_front + r->len) >= tot_len_front)) {
+      tot_len_front += r->len;
+      i = r;
+      r = r->next;
+    }
+    /* i now points to the last pbuf of the first part */
+    i->next = NULL;
+
+    if (r != NULL) {
+      /* update the tot_len fields of the first part (modulo 64k, so this is
+         correct even when they overflowed) */
+      for (i = p; i != NULL; i = i->next) {
+        i->tot_len -= r->tot_len;
+        LWIP_ASSERT("tot_len/len mismatch in last pbuf",
+                    (i->next != NULL) || (i->tot_len == i->len));
+      }
+      if (p->flags & PBUF_FLAG_TCP_FIN) {
+        r->flags |= PBUF_FLAG_TCP_FIN;
+      }
+      /* the reference of the rest is taken over by the caller */
+      *rest = r;
+    }
+  }
+}
+#endif /* LWIP_TCP && TCP_QUEUE_OOSEQ && LWIP_WND_SCALE */
+
 /**
  *
  * Create PBUF_RAM copies of pbufs.
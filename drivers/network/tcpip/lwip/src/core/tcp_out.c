@@ -105,7 +105,7 @@ tcp_output_alloc_header(struct tcp_pcb *pcb, u16_t optlen, u16_t datalen,
     tcphdr->seqno = seqno_be;
     tcphdr->ackno = htonl(pcb->rcv_nxt);
     TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
-    tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+    tcphdr->wnd = htons(TCPWND_MIN16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
     tcphdr->chksum = 0;
     tcphdr->urgp = 0;
 
@@ -395,6 +395,21 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
   }
 #endif /* LWIP_TCP_TIMESTAMPS */
 
+#if LWIP_TCP_LSO
+  /* build segments of several MSS if the netif segments them in hardware,
+     still no bigger than half the maximum window */
+  if ((mss_local == pcb->mss) && (pcb->mss > optlen)) {
+    struct netif *netif = ip_route(&(pcb->remote_ip));
+    if ((netif != NULL) && (netif->lso_max_size != 0)) {
+      u16_t wire_len = pcb->mss - optlen;
+      u32_t lso_len = LWIP_MIN(LWIP_MIN(netif->lso_max_size, TCP_LSO_MAX_SEG), pcb->snd_wnd_max/2);
+      if (lso_len >= 2 * (u32_t)wire_len) {
+        mss_local = (u16_t)(optlen + lso_len - lso_len % wire_len);
+      }
+    }
+  }
+#endif /* LWIP_TCP_LSO */
+
 
   /*
    * TCP segmentation is done in three phases with increasing complexity:
@@ -742,6 +757,17 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
 
   if (flags & TCP_SYN) {
     optflags = TF_SEG_OPTS_MSS;
+#if LWIP_WND_SCALE
+    /* A SYN|ACK may only carry the option if the remote host sent it */
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_WND_SCALE)) {
+      optflags |= TF_SEG_OPTS_WND_SCALE;
+    }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_SACK)) {
+      optflags |= TF_SEG_OPTS_SACK_PERM;
+    }
+#endif /* LWIP_TCP_SACK */
   }
 #if LWIP_TCP_TIMESTAMPS
   if ((pcb->flags & TF_TIMESTAMP)) {
@@ -834,6 +860,48 @@ tcp_build_timestamp_option(struct tcp_pcb *pcb, u32_t *opts)
 }
 #endif
 
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+/* Build the SACK blocks describing the out-of-sequence queue
+ *
+ * Contiguous segments are merged into one block. The blocks are
+ * reported from the lowest sequence number on, since the first hole
+ * is the one the remote host has to fill first.
+ *
+ * @param pcb tcp_pcb
+ * @param blocks array receiving the left and right edge of each block
+ * @param max_blocks maximum number of blocks that fit into the header
+ * @return number of blocks stored
+ */
+static u8_t
+tcp_build_sack_blocks(struct tcp_pcb *pcb, u32_t *blocks, u8_t max_blocks)
+{
+  struct tcp_seg *seg;
+  u32_t left, right, seg_seqno;
+  u8_t count = 0;
+
+  seg = pcb->ooseq;
+  while ((seg != NULL) && (count < max_blocks)) {
+    left = ntohl(seg->tcphdr->seqno);
+    right = left + TCP_TCPLEN(seg);
+    for (seg = seg->next; seg != NULL; seg = seg->next) {
+      seg_seqno = ntohl(seg->tcphdr->seqno);
+      if (TCP_SEQ_GT(seg_seqno, right)) {
+        break;
+      }
+      if (TCP_SEQ_GT(seg_seqno + TCP_TCPLEN(seg), right)) {
+        right = seg_seqno + TCP_TCPLEN(seg);
+      }
+    }
+    if (TCP_SEQ_GT(left, pcb->rcv_nxt)) {
+      blocks[2 * count] = htonl(left);
+      blocks[2 * count + 1] = htonl(right);
+      count++;
+    }
+  }
+  return count;
+}
+#endif /* LWIP_TCP_SACK && TCP_QUEUE_OOSEQ */
+
 /** Send an ACK without data.
  *
  * @param pcb Protocol control block for the TCP connection to send the ACK
@@ -844,12 +912,28 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   struct pbuf *p;
   struct tcp_hdr *tcphdr;
   u8_t optlen = 0;
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+  u32_t sack_blocks[2 * TCP_SACK_MAX_BLOCKS];
+  u8_t num_sacks = 0;
+  u32_t *opts;
+  u8_t i;
+#endif /* LWIP_TCP_SACK && TCP_QUEUE_OOSEQ */
 
 #if LWIP_TCP_TIMESTAMPS
   if (pcb->flags & TF_TIMESTAMP) {
     optlen = LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS);
   }
 #endif
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+  if ((pcb->flags & TF_SACK) && (pcb->ooseq != NULL)) {
+    /* 3 blocks fit next to the timestamp option, 4 without it */
+    num_sacks = tcp_build_sack_blocks(pcb, sack_blocks,
+      (pcb->flags & TF_TIMESTAMP) ? TCP_SACK_MAX_BLOCKS - 1 : TCP_SACK_MAX_BLOCKS);
+    if (num_sacks > 0) {
+      optlen += 4 + 8 * num_sacks;
+    }
+  }
+#endif /* LWIP_TCP_SACK && TCP_QUEUE_OOSEQ */
 
   p = tcp_output_alloc_header(pcb, optlen, 0, htonl(pcb->snd_nxt));
   if (p == NULL) {
@@ -871,9 +955,25 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   }
 #endif
 
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+  if (num_sacks > 0) {
+    opts = (u32_t *)(void *)(tcphdr + 1);
+    if (pcb->flags & TF_TIMESTAMP) {
+      opts += 3;
+    }
+    /* Pad with two NOP options, then the SACK option with its blocks */
+    *opts++ = htonl(0x01010500 | (2 + 8 * num_sacks));
+    for (i = 0; i < 2 * num_sacks; i++) {
+      *opts++ = sack_blocks[i];
+    }
+  }
+#endif /* LWIP_TCP_SACK && TCP_QUEUE_OOSEQ */
+
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
-        IP_PROTO_TCP, p->tot_len);
+  IF__NETIF_CHECKSUM_ENABLED(ip_route(&(pcb->remote_ip)), NETIF_CHECKSUM_GEN_TCP) {
+    tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
+          IP_PROTO_TCP, p->tot_len);
+  }
 #endif
 #if LWIP_NETIF_HWADDRHINT
   ip_output_hinted(p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl, pcb->tos,
@@ -887,6 +987,120 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   return ERR_OK;
 }
 
+#if LWIP_TCP_LSO
+/**
+ * Split the first unsent segment in two. PSH and FIN go with the second part.
+ *
+ * @param pcb the tcp_pcb for which to split the first unsent segment
+ * @param split length of the first part
+ * @return ERR_OK if split, ERR_MEM if out of memory
+ */
+static err_t
+tcp_split_unsent_seg(struct tcp_pcb *pcb, u16_t split)
+{
+  struct tcp_seg *seg = pcb->unsent;
+  struct tcp_seg *seg2;
+  struct pbuf *p;
+  u16_t remainder, offset;
+  u8_t optlen, split_flags, remainder_flags;
+
+  LWIP_ASSERT("tcp_split_unsent_seg: invalid split", seg != NULL && split > 0 && split < seg->len);
+
+  optlen = LWIP_TCP_OPT_LENGTH(seg->flags);
+  remainder = seg->len - split;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, remainder + optlen, PBUF_RAM);
+  if (p == NULL) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_split_unsent_seg: could not allocate pbuf\n"));
+    return ERR_MEM;
+  }
+
+  /* the data starts after all headers and options in the segment pbuf */
+  offset = seg->p->tot_len - seg->len + split;
+  if (pbuf_copy_partial(seg->p, (u8_t *)p->payload + optlen, remainder, offset) != remainder) {
+    pbuf_free(p);
+    return ERR_MEM;
+  }
+
+  split_flags = TCPH_FLAGS(seg->tcphdr);
+  remainder_flags = split_flags & (TCP_PSH | TCP_FIN);
+  split_flags &= ~(TCP_PSH | TCP_FIN);
+
+  seg2 = tcp_create_segment(pcb, p, remainder_flags, ntohl(seg->tcphdr->seqno) + split, seg->flags);
+  if (seg2 == NULL) {
+    return ERR_MEM;
+  }
+
+  pcb->snd_queuelen -= pbuf_clen(seg->p);
+  pbuf_realloc(seg->p, seg->p->tot_len - seg->len + split);
+  seg->len = split;
+  TCPH_FLAGS_SET(seg->tcphdr, split_flags);
+  pcb->snd_queuelen += pbuf_clen(seg->p) + pbuf_clen(seg2->p);
+
+  seg2->next = seg->next;
+  seg->next = seg2;
+#if TCP_OVERSIZE
+  if (seg2->next == NULL) {
+    /* the second part holds exactly its data */
+    pcb->unsent_oversize = 0;
+  }
+#endif /* TCP_OVERSIZE */
+  return ERR_OK;
+}
+
+/**
+ * Make the first unsent segment fit into the send window. A segment built
+ * for large send offload may never fit the window as a whole, e.g. while the
+ * congestion window is small. It is cut at a multiple of the MSS so that the
+ * hardware still sends full sized segments, and to a single MSS when it is
+ * retransmitted. A retransmitted segment may also have been acknowledged in
+ * part, that part is dropped.
+ *
+ * @param pcb the tcp_pcb for which to fit the first unsent segment
+ * @param wnd the usable send window
+ */
+static void
+tcp_fit_unsent_seg(struct tcp_pcb *pcb, u32_t wnd)
+{
+  struct tcp_seg *seg = pcb->unsent;
+  u32_t seqno, space;
+  u16_t wire_len;
+  u8_t optlen;
+
+  if (seg == NULL || seg->len == 0) {
+    return;
+  }
+
+  seqno = ntohl(seg->tcphdr->seqno);
+  if (TCP_SEQ_LT(seqno, pcb->lastack) && TCP_SEQ_LT(pcb->lastack, seqno + seg->len)) {
+    if (tcp_split_unsent_seg(pcb, (u16_t)(pcb->lastack - seqno)) != ERR_OK) {
+      return;
+    }
+    pcb->unsent = seg->next;
+    pcb->snd_queuelen -= pbuf_clen(seg->p);
+    tcp_seg_free(seg);
+    seg = pcb->unsent;
+    seqno = pcb->lastack;
+  }
+
+  optlen = LWIP_TCP_OPT_LENGTH(seg->flags);
+  if (pcb->mss <= optlen) {
+    return;
+  }
+  wire_len = pcb->mss - optlen;
+
+  space = TCP_SEQ_LT(seqno, pcb->lastack + wnd) ? pcb->lastack + wnd - seqno : 0;
+  if (TCP_SEQ_LT(seqno, pcb->snd_nxt)) {
+    space = LWIP_MIN(space, wire_len);
+  }
+  if (seg->len <= space || space < wire_len) {
+    return;
+  }
+
+  tcp_split_unsent_seg(pcb, (u16_t)(space - space % wire_len));
+}
+#endif /* LWIP_TCP_LSO */
+
 /**
  * Find out what we can send and send it
  *
@@ -917,6 +1131,9 @@ tcp_output(struct tcp_pcb *pcb)
 
   wnd = LWIP_MIN(pcb->snd_wnd, pcb->cwnd);
 
+#if LWIP_TCP_LSO
+  tcp_fit_unsent_seg(pcb, wnd);
+#endif /* LWIP_TCP_LSO */
   seg = pcb->unsent;
 
   /* If the TF_ACK_NOW flag is set and no data will be sent (either
@@ -1026,6 +1243,9 @@ tcp_output(struct tcp_pcb *pcb)
     } else {
       tcp_seg_free(seg);
     }
+#if LWIP_TCP_LSO
+    tcp_fit_unsent_seg(pcb, wnd);
+#endif /* LWIP_TCP_LSO */
     seg = pcb->unsent;
   }
 #if TCP_OVERSIZE
@@ -1060,7 +1280,12 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   seg->tcphdr->ackno = htonl(pcb->rcv_nxt);
 
   /* advertise our receive window size in this TCP segment */
-  seg->tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+  if (TCPH_FLAGS(seg->tcphdr) & TCP_SYN) {
+    /* The window field of a SYN segment is never scaled */
+    seg->tcphdr->wnd = htons(TCPWND_MIN16(pcb->rcv_ann_wnd));
+  } else {
+    seg->tcphdr->wnd = htons(TCPWND_MIN16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
+  }
 
   pcb->rcv_ann_right_edge = pcb->rcv_nxt + pcb->rcv_ann_wnd;
 
@@ -1085,6 +1310,20 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     opts += 3;
   }
 #endif
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    /* Pad with a NOP option, then announce our shift count */
+    *opts = htonl(0x01030300 | TCP_RCV_SCALE);
+    opts += 1;
+  }
+#endif
+#if LWIP_TCP_SACK
+  if (seg->flags & TF_SEG_OPTS_SACK_PERM) {
+    /* Pad with two NOP options, then SACK permitted */
+    *opts = PP_HTONL(0x01010402);
+    opts += 1;
+  }
+#endif
 
   /* Set retransmission timer running if it is not currently enabled
      This must be set before checking the route. */
@@ -1092,10 +1331,17 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     pcb->rtime = 0;
   }
 
+#if LWIP_CHECKSUM_CTRL_PER_NETIF || LWIP_TCP_LSO
+  /* The netif decides about checksums and segmentation */
+  netif = ip_route(&(pcb->remote_ip));
+#endif /* LWIP_CHECKSUM_CTRL_PER_NETIF || LWIP_TCP_LSO */
+
   /* If we don't have a local IP address, we get one by
      calling ip_route(). */
   if (ip_addr_isany(&(pcb->local_ip))) {
+#if !LWIP_CHECKSUM_CTRL_PER_NETIF && !LWIP_TCP_LSO
     netif = ip_route(&(pcb->remote_ip));
+#endif /* !LWIP_CHECKSUM_CTRL_PER_NETIF && !LWIP_TCP_LSO */
     if (netif == NULL) {
       return;
     }
@@ -1121,8 +1367,8 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
 
   seg->tcphdr->chksum = 0;
 #if CHECKSUM_GEN_TCP
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP) {
 #if TCP_CHECKSUM_ON_COPY
-  {
     u32_t acc;
 #if TCP_CHECKSUM_ON_COPY_SANITY_CHECK
     u16_t chksum_slow = inet_chksum_pseudo(seg->p, &(pcb->local_ip),
@@ -1153,15 +1399,25 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
       seg->tcphdr->chksum = chksum_slow;
     }
 #endif /* TCP_CHECKSUM_ON_COPY_SANITY_CHECK */
-  }
 #else /* TCP_CHECKSUM_ON_COPY */
-  seg->tcphdr->chksum = inet_chksum_pseudo(seg->p, &(pcb->local_ip),
-         &(pcb->remote_ip),
-         IP_PROTO_TCP, seg->p->tot_len);
+    seg->tcphdr->chksum = inet_chksum_pseudo(seg->p, &(pcb->local_ip),
+           &(pcb->remote_ip),
+           IP_PROTO_TCP, seg->p->tot_len);
 #endif /* TCP_CHECKSUM_ON_COPY */
+  }
 #endif /* CHECKSUM_GEN_TCP */
   TCP_STATS_INC(tcp.xmit);
 
+#if LWIP_TCP_LSO
+  /* Tell the netif where to cut a segment longer than the MSS */
+  if ((netif != NULL) && (netif->lso_max_size != 0)) {
+    u16_t mss = pcb->mss - (TCPH_HDRLEN(seg->tcphdr) * 4 - TCP_HLEN);
+    if (seg->len > mss) {
+      netif->lso_mss = mss;
+    }
+  }
+#endif /* LWIP_TCP_LSO */
+
 #if LWIP_NETIF_HWADDRHINT
   ip_output_hinted(seg->p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl, pcb->tos,
       IP_PROTO_TCP, &(pcb->addr_hint));
@@ -1169,6 +1425,12 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   ip_output(seg->p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl, pcb->tos,
       IP_PROTO_TCP);
 #endif /* LWIP_NETIF_HWADDRHINT*/
+
+#if LWIP_TCP_LSO
+  if (netif != NULL) {
+    netif->lso_mss = 0;
+  }
+#endif /* LWIP_TCP_LSO */
 }
 
 /**
@@ -1212,7 +1474,7 @@ tcp_rst(u32_t seqno, u32_t ackno,
   tcphdr->seqno = htonl(seqno);
   tcphdr->ackno = htonl(ackno);
   TCPH_HDRLEN_FLAGS_SET(tcphdr, TCP_HLEN/4, TCP_RST | TCP_ACK);
-  tcphdr->wnd = PP_HTONS(TCP_WND);
+  tcphdr->wnd = PP_HTONS(((TCP_WND >> TCP_RCV_SCALE) & 0xFFFF));
   tcphdr->chksum = 0;
   tcphdr->urgp = 0;
 
@@ -1244,6 +1506,13 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
     return;
   }
 
+#if LWIP_TCP_SACK
+  /* The remote host may discard SACKed data, so forget about it */
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    seg->flags &= ~(TF_SEG_SACKED | TF_SEG_SACK_REXMIT);
+  }
+#endif /* LWIP_TCP_SACK */
+
   /* Move all unacked segments to the head of the unsent queue */
   for (seg = pcb->unacked; seg->next != NULL; seg = seg->next);
   /* concatenate unsent queue after unacked queue */
@@ -1274,18 +1543,35 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
 void
 tcp_rexmit(struct tcp_pcb *pcb)
 {
-  struct tcp_seg *seg;
-  struct tcp_seg **cur_seg;
-
   if (pcb->unacked == NULL) {
     return;
   }
 
   /* Move the first unacked segment to the unsent queue */
-  /* Keep the unsent queue sorted. */
-  seg = pcb->unacked;
-  pcb->unacked = seg->next;
+  tcp_rexmit_seg(pcb, pcb->unacked);
+}
+
+/**
+ * Requeue an unacked segment for retransmission
+ *
+ * Called by tcp_rexmit() and tcp_rexmit_sack().
+ *
+ * @param pcb the tcp_pcb for which to retransmit the segment
+ * @param seg the segment on the unacked queue to retransmit
+ */
+void
+tcp_rexmit_seg(struct tcp_pcb *pcb, struct tcp_seg *seg)
+{
+  struct tcp_seg **cur_seg;
+
+  /* Remove the segment from the unacked queue */
+  for (cur_seg = &(pcb->unacked); *cur_seg != seg; cur_seg = &((*cur_seg)->next)) {
+    LWIP_ASSERT("tcp_rexmit_seg: segment not on unacked queue", *cur_seg != NULL);
+  }
+  *cur_seg = seg->next;
+  seg->flags |= TF_SEG_SACK_REXMIT;
 
+  /* Keep the unsent queue sorted. */
   cur_seg = &(pcb->unsent);
   while (*cur_seg &&
     TCP_SEQ_LT(ntohl((*cur_seg)->tcphdr->seqno), ntohl(seg->tcphdr->seqno))) {
@@ -1312,6 +1598,39 @@ tcp_rexmit(struct tcp_pcb *pcb)
 }
 
 
+#if LWIP_TCP_SACK
+/**
+ * Retransmit the first hole reported by SACK blocks
+ *
+ * Called by tcp_receive() for each further duplicate ACK during fast
+ * recovery. The first segment that has not been SACKed, has not been
+ * retransmitted in this recovery yet and lies below a SACKed segment is
+ * requeued for retransmission.
+ *
+ * @param pcb the tcp_pcb for which to fill a hole
+ * @return 1 if a segment was requeued, 0 if there is no hole
+ */
+u8_t
+tcp_rexmit_sack(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg, *hole = NULL;
+
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    if (seg->flags & TF_SEG_SACKED) {
+      if (hole != NULL) {
+        LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_rexmit_sack: filling hole at %"U32_F"\n",
+                                   ntohl(hole->tcphdr->seqno)));
+        tcp_rexmit_seg(pcb, hole);
+        return 1;
+      }
+    } else if ((hole == NULL) && !(seg->flags & TF_SEG_SACK_REXMIT)) {
+      hole = seg;
+    }
+  }
+  return 0;
+}
+#endif /* LWIP_TCP_SACK */
+
 /**
  * Handle retransmission after three dupacks received
  *
@@ -1340,7 +1659,7 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
     /* The minimum value for ssthresh should be 2 MSS */
     if (pcb->ssthresh < 2*pcb->mss) {
       LWIP_DEBUGF(TCP_FR_DEBUG,
-                  ("tcp_receive: The minimum value for ssthresh %"U16_F
+                  ("tcp_receive: The minimum value for ssthresh %"TCPWNDSIZE_F
                    " should be min 2 mss %"U16_F"...\n",
                    pcb->ssthresh, 2*pcb->mss));
       pcb->ssthresh = 2*pcb->mss;
@@ -1348,6 +1667,10 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
 
     pcb->cwnd = pcb->ssthresh + 3 * pcb->mss;
     pcb->flags |= TF_INFR;
+#if LWIP_TCP_SACK
+    /* stay in fast recovery until everything sent so far is acknowledged */
+    pcb->recover = pcb->snd_nxt;
+#endif /* LWIP_TCP_SACK */
   }
 }
 
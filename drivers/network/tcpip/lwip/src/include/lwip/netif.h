@@ -94,6 +94,15 @@ extern "C" {
  * Set by the netif driver in its init function. */
 #define NETIF_FLAG_IGMP         0x80U
 
+/** Checksums generated in software for packets sent through the netif
+ * (see NETIF_SET_CHECKSUM_CTRL, needs LWIP_CHECKSUM_CTRL_PER_NETIF) */
+#define NETIF_CHECKSUM_GEN_IP       0x0001
+#define NETIF_CHECKSUM_GEN_UDP      0x0002
+#define NETIF_CHECKSUM_GEN_TCP      0x0004
+#define NETIF_CHECKSUM_GEN_ICMP     0x0008
+#define NETIF_CHECKSUM_ENABLE_ALL   0xFFFF
+#define NETIF_CHECKSUM_DISABLE_ALL  0x0000
+
 /** Function prototype for netif init functions. Set up flags and output/linkoutput
  * callback functions in this function.
  *
@@ -219,6 +228,16 @@ struct netif {
 #if LWIP_NETIF_HWADDRHINT
   u8_t *addr_hint;
 #endif /* LWIP_NETIF_HWADDRHINT */
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+  /** checksums to generate in software (see NETIF_CHECKSUM_GEN_ above) */
+  u16_t chksum_flags;
+#endif /* LWIP_CHECKSUM_CTRL_PER_NETIF */
+#if LWIP_TCP_LSO
+  /** largest TCP payload the hardware segments, 0 if it does not */
+  u16_t lso_max_size;
+  /** MSS to segment the packet being output at, 0 for a plain packet */
+  u16_t lso_mss;
+#endif /* LWIP_TCP_LSO */
 #if ENABLE_LOOPBACK
   /* List of packets to be queued for ourselves. */
   struct pbuf *loop_first;
@@ -229,6 +248,15 @@ struct netif {
 #endif /* ENABLE_LOOPBACK */
 };
 
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+#define NETIF_SET_CHECKSUM_CTRL(netif, chksumflags) (netif)->chksum_flags = (chksumflags)
+#define IF__NETIF_CHECKSUM_ENABLED(netif, chksumflag) \
+  if (((netif) == NULL) || (((netif)->chksum_flags & (chksumflag)) != 0))
+#else /* LWIP_CHECKSUM_CTRL_PER_NETIF */
+#define NETIF_SET_CHECKSUM_CTRL(netif, chksumflags)
+#define IF__NETIF_CHECKSUM_ENABLED(netif, chksumflag)
+#endif /* LWIP_CHECKSUM_CTRL_PER_NETIF */
+
 #if LWIP_SNMP
 #define NETIF_INIT_SNMP(netif, type, speed) \
   /* use "snmp_ifType" enum from snmp.h for "type", snmp_ifType_ethernet_csmacd by example */ \
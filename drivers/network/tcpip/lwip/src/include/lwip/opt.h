@@ -1053,6 +1053,24 @@
 #define TCP_OVERSIZE                    TCP_MSS
 #endif
 
+/**
+ * LWIP_TCP_LSO==1: build TCP segments spanning several MSS for netifs that
+ * segment them in hardware (netif->lso_max_size != 0). tcp_output passes
+ * the MSS to cut them at in netif->lso_mss and splits a segment that does
+ * not fit the send window.
+ */
+#ifndef LWIP_TCP_LSO
+#define LWIP_TCP_LSO                    0
+#endif
+
+/**
+ * TCP_LSO_MAX_SEG: Largest amount of data in one TCP segment built for
+ * large send offload. Must leave room for the headers below 64 KB.
+ */
+#ifndef TCP_LSO_MAX_SEG
+#define TCP_LSO_MAX_SEG                 0xF000
+#endif
+
 /**
  * LWIP_TCP_TIMESTAMPS==1: support the TCP timestamp option.
  */
@@ -1060,12 +1078,34 @@
 #define LWIP_TCP_TIMESTAMPS             0
 #endif
 
+/**
+ * LWIP_WND_SCALE==1: support the TCP window scale option (RFC 1323).
+ * TCP_WND may then exceed 0xffff. TCP_RCV_SCALE is the shift count we
+ * announce to the remote host for our receive window.
+ */
+#ifndef LWIP_WND_SCALE
+#define LWIP_WND_SCALE                  0
+#endif
+#ifndef TCP_RCV_SCALE
+#define TCP_RCV_SCALE                   0
+#endif
+
+/**
+ * LWIP_TCP_SACK==1: support TCP selective acknowledgements (RFC 2018).
+ * We announce SACK blocks for the out-of-sequence queue and use the
+ * blocks sent by the remote host to retransmit holes during fast recovery.
+ * Requires TCP_QUEUE_OOSEQ to send SACK blocks.
+ */
+#ifndef LWIP_TCP_SACK
+#define LWIP_TCP_SACK                   0
+#endif
+
 /**
  * TCP_WND_UPDATE_THRESHOLD: difference in window to trigger an
  * explicit window update
  */
 #ifndef TCP_WND_UPDATE_THRESHOLD
-#define TCP_WND_UPDATE_THRESHOLD   (TCP_WND / 4)
+#define TCP_WND_UPDATE_THRESHOLD   LWIP_MIN((TCP_WND / 4), (TCP_MSS * 4))
 #endif
 
 /**
@@ -1841,6 +1881,16 @@
 #define LWIP_CHECKSUM_ON_COPY           0
 #endif
 
+/**
+ * LWIP_CHECKSUM_CTRL_PER_NETIF==1: Checksum generation can be turned off
+ * per netif (see NETIF_SET_CHECKSUM_CTRL) when the hardware behind it
+ * computes the checksums. Incoming packets are always checked unless the
+ * pbuf carries PBUF_FLAG_IP_CHKSUM_OK / PBUF_FLAG_L4_CHKSUM_OK.
+ */
+#ifndef LWIP_CHECKSUM_CTRL_PER_NETIF
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    0
+#endif
+
 /*
    ---------------------------------------
    ---------- Hook options ---------------
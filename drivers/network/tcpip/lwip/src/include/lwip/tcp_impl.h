@@ -69,6 +69,9 @@ err_t            tcp_send_empty_ack(struct tcp_pcb *pcb);
 void             tcp_rexmit  (struct tcp_pcb *pcb);
 void             tcp_rexmit_rto  (struct tcp_pcb *pcb);
 void             tcp_rexmit_fast (struct tcp_pcb *pcb);
+#if LWIP_TCP_SACK
+u8_t             tcp_rexmit_sack (struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_SACK */
 u32_t            tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb);
 err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 
@@ -292,12 +295,31 @@ struct tcp_seg {
 #define TF_SEG_OPTS_TS          (u8_t)0x02U /* Include timestamp option. */
 #define TF_SEG_DATA_CHECKSUMMED (u8_t)0x04U /* ALL data (not the header) is
                                                checksummed into 'chksum' */
+#define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include window scale option. */
+#define TF_SEG_OPTS_SACK_PERM   (u8_t)0x10U /* Include SACK permitted option. */
+#define TF_SEG_SACKED           (u8_t)0x20U /* Segment was SACKed by the remote host. */
+#define TF_SEG_SACK_REXMIT      (u8_t)0x40U /* Segment was retransmitted to fill a SACK hole. */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
 #define LWIP_TCP_OPT_LENGTH(flags)              \
-  (flags & TF_SEG_OPTS_MSS ? 4  : 0) +          \
-  (flags & TF_SEG_OPTS_TS  ? 12 : 0)
+  (((flags) & TF_SEG_OPTS_MSS       ? 4  : 0) + \
+   ((flags) & TF_SEG_OPTS_TS        ? 12 : 0) + \
+   ((flags) & TF_SEG_OPTS_WND_SCALE ? 4  : 0) + \
+   ((flags) & TF_SEG_OPTS_SACK_PERM ? 4  : 0))
+
+/** Maximum number of SACK blocks we announce in an ACK (RFC 2018 allows 3
+ * when the timestamp option is used, 4 otherwise) */
+#define TCP_SACK_MAX_BLOCKS     4
+
+/** Initial slow start threshold: the largest window the peer can announce,
+ * so that slow start is not cut short on a window scaled connection */
+#if LWIP_WND_SCALE
+#define TCP_INITIAL_SSTHRESH(pcb) (((pcb)->flags & TF_WND_SCALE) ? \
+                                   ((tcpwnd_size_t)0xFFFF << (pcb)->snd_scale) : (pcb)->snd_wnd)
+#else
+#define TCP_INITIAL_SSTHRESH(pcb) ((pcb)->snd_wnd)
+#endif
 
 /** This returns a TCP header option for MSS in an u32_t */
 #define TCP_BUILD_MSS_OPTION(mss) htonl(0x02040000 | ((mss) & 0xFFFF))
@@ -64,9 +64,28 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+/* Scale windows by 2^5 so that the receive window can grow up to 2 MB */
+#define LWIP_WND_SCALE                  1
 
-#define TCP_SND_BUF                     TCP_WND
+#define TCP_RCV_SCALE                   5
+
+#define LWIP_TCP_SACK                   1
+
+/* The glue turns off checksums the adapter computes and builds large
+ * segments for adapters with large send offload */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+
+#define LWIP_TCP_LSO                    1
+
+/* Initial sizes, the glue autotunes them per connection */
+#define TCP_WND                         (128 * 1024)
+
+#define TCP_SND_BUF                     (128 * 1024)
+
+/* Largest send buffer the glue grows a connection to */
+#define TCP_SND_BUF_MAX                 (1024 * 1024)
+
+#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF_MAX) + (TCP_MSS - 1)) / (TCP_MSS))
 
 #define TCP_MAXRTX                      8
 
@@ -1546,6 +1546,15 @@ NTSTATUS DispTdiSetInformationEx(
     Request.RequestNotifyObject = NULL;
     Request.RequestContext      = NULL;
 
+    /* Connection options sent to a connection object apply to that connection */
+    if ((ULONG_PTR)IrpSp->FileObject->FsContext2 == TDI_CONNECTION_FILE &&
+        Info->ID.toi_class == INFO_CLASS_PROTOCOL &&
+        Info->ID.toi_type == INFO_TYPE_CONNECTION)
+    {
+        return SetConnectionInfo(&Info->ID, Request.Handle.ConnectionContext,
+                                 &Info->Buffer, Info->BufferSize);
+    }
+
     Status = InfoTdiSetInformationEx(&Request, &Info->ID,
             &Info->Buffer, Info->BufferSize);
 
@@ -21,6 +21,9 @@
 LIST_ENTRY AddressFileListHead;
 KSPIN_LOCK AddressFileListLock;
 
+/* Datagram address files by protocol and port, also protected by AddressFileListLock */
+LIST_ENTRY AddressFileHashTable[ADDRESS_FILE_HASH_SIZE];
+
 /* List of all connection endpoint file objects managed by this driver */
 LIST_ENTRY ConnectionEndpointListHead;
 KSPIN_LOCK ConnectionEndpointListLock;
@@ -34,6 +37,9 @@ KSPIN_LOCK ConnectionEndpointListLock;
  *     SearchContext = Pointer to search context
  * RETURNS:
  *     Pointer to address file, NULL if none was found
+ * NOTES:
+ *     Only the hash bucket of the port and protocol is searched, TCP
+ *     address files are not hashed and are never found here
  */
 PADDRESS_FILE AddrSearchFirst(
     PIP_ADDRESS Address,
@@ -46,13 +52,14 @@ PADDRESS_FILE AddrSearchFirst(
     SearchContext->Address  = Address;
     SearchContext->Port     = Port;
     SearchContext->Protocol = Protocol;
+    SearchContext->Head     = &AddressFileHashTable[ADDRESS_FILE_HASH(Port, Protocol)];
 
     TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
 
-    SearchContext->Next = AddressFileListHead.Flink;
+    SearchContext->Next = SearchContext->Head->Flink;
 
-    if (!IsListEmpty(&AddressFileListHead))
-        ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, ListEntry));
+    if (!IsListEmpty(SearchContext->Head))
+        ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, HashEntry));
 
     TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
 
@@ -113,6 +120,7 @@ LogActiveObjects(VOID)
     KIRQL OldIrql;
     PADDRESS_FILE AddrFile;
     PCONNECTION_ENDPOINT Conn;
+    NEIGHBOR_CACHE_STATISTICS NCStats;
 
     DbgPrint("----------- TCP/IP Active Object Dump -------------\n");
 
@@ -183,6 +191,13 @@ LogActiveObjects(VOID)
 
     TcpipReleaseSpinLock(&ConnectionEndpointListLock, OldIrql);
 
+    NBGetStatistics(&NCStats);
+    DbgPrint("Neighbor cache: %u entries in %u buckets (%u resizes)\n",
+             NCStats.Entries, NCStats.Buckets, NCStats.Resizes);
+    DbgPrint("\tLookups: %u | Hits: %u | Added: %u | Removed: %u | Expired: %u | Timer events: %u\n",
+             NCStats.Lookups, NCStats.Hits, NCStats.Additions, NCStats.Removals,
+             NCStats.Expirations, NCStats.TimerEvents);
+
     DbgPrint("---------------------------------------------------\n");
 #endif
 }
@@ -240,19 +255,19 @@ PADDRESS_FILE AddrSearchNext(
 
     TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
 
-    if (SearchContext->Next == &AddressFileListHead)
+    if (SearchContext->Next == SearchContext->Head)
     {
         TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
         return NULL;
     }
 
     /* Save this pointer so we can dereference it later */
-    StartingAddrFile = CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, ListEntry);
+    StartingAddrFile = CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, HashEntry);
 
     CurrentEntry = SearchContext->Next;
 
-    while (CurrentEntry != &AddressFileListHead) {
-        Current = CONTAINING_RECORD(CurrentEntry, ADDRESS_FILE, ListEntry);
+    while (CurrentEntry != SearchContext->Head) {
+        Current = CONTAINING_RECORD(CurrentEntry, ADDRESS_FILE, HashEntry);
 
         IPAddress = &Current->Address;
 
@@ -279,10 +294,10 @@ PADDRESS_FILE AddrSearchNext(
     {
         SearchContext->Next = CurrentEntry->Flink;
 
-        if (SearchContext->Next != &AddressFileListHead)
+        if (SearchContext->Next != SearchContext->Head)
         {
             /* Reference the next address file to prevent the link from disappearing behind our back */
-            ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, ListEntry));
+            ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, HashEntry));
         }
 
         /* Reference the returned address file before dereferencing the starting
@@ -321,6 +336,7 @@ VOID AddrFileFree(
   /* Remove address file from the global list */
   TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
   RemoveEntryList(&AddrFile->ListEntry);
+  RemoveEntryList(&AddrFile->HashEntry);
   TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
 
   /* FIXME: Kill TCP connections on this address file object */
@@ -405,6 +421,7 @@ NTSTATUS FileOpenAddress(
 {
   PADDRESS_FILE AddrFile;
   UINT AllocatedPort;
+  KIRQL OldIrql;
 
   TI_DbgPrint(MID_TRACE, ("Called (Proto %d).\n", Protocol));
 
@@ -569,11 +586,16 @@ NTSTATUS FileOpenAddress(
   /* Return address file object */
   Request->Handle.AddressHandle = AddrFile;
 
-  /* Add address file to global list */
-  ExInterlockedInsertTailList(
-    &AddressFileListHead,
-    &AddrFile->ListEntry,
-    &AddressFileListLock);
+  /* Add address file to global list. TCP address files may get their port
+   * later and are demultiplexed by lwIP, so only datagram ones are hashed */
+  TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
+  InsertTailList(&AddressFileListHead, &AddrFile->ListEntry);
+  if (Protocol == IPPROTO_TCP)
+    InitializeListHead(&AddrFile->HashEntry);
+  else
+    InsertTailList(&AddressFileHashTable[ADDRESS_FILE_HASH(AddrFile->Port, Protocol)],
+                   &AddrFile->HashEntry);
+  TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
 
   TI_DbgPrint(MAX_TRACE, ("Leaving.\n"));
 
@@ -212,6 +212,29 @@ InfoTdiQueryGetATInfo(
     return Status;
 }
 
+TDI_STATUS
+InfoTdiQueryGetMemoryStats(
+    PNDIS_BUFFER Buffer,
+    PUINT BufferSize)
+/*
+ * FUNCTION: Returns the allocation counters of the lwIP memory caches
+ * ARGUMENTS:
+ *   Buffer     = Pointer to buffer to receive the statistics
+ *   BufferSize = Pointer to buffer with size of Buffer. On return
+ *                this is filled with number of bytes returned
+ * RETURNS:
+ *   Status of operation
+ */
+{
+    LWIP_MEMORY_STATS Stats;
+
+    TI_DbgPrint(DEBUG_INFO, ("Called.\n"));
+
+    LibIPQueryMemoryStatistics(&Stats);
+
+    return InfoCopyOut((PCHAR)&Stats, sizeof(Stats), Buffer, BufferSize);
+}
+
 TDI_STATUS InfoTdiQueryInformationEx(
   PTDI_REQUEST Request,
   TDIObjectID *ID,
@@ -362,6 +385,13 @@ TDI_STATUS InfoTdiQueryInformationEx(
                  else
                      return TDI_INVALID_PARAMETER;
 
+              case TCP_MEMORY_STATS_ID:
+                 if (ID->toi_type != INFO_TYPE_PROVIDER ||
+                     ID->toi_entity.tei_entity != CO_TL_ENTITY)
+                     return TDI_INVALID_PARAMETER;
+
+                 return InfoTdiQueryGetMemoryStats(Buffer, BufferSize);
+
 #if 0
               case IP_INTFC_INFO_ID:
                  if (ID->toi_type != INFO_TYPE_PROVIDER)
@@ -0,0 +1,288 @@
+/*
+ * PROJECT:     ReactOS NDIS statistics utility
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Prints the packet statistics NDIS keeps for each adapter
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIN32_NO_STATUS
+#include <windef.h>
+#include <winbase.h>
+#include <devioctl.h>
+#include <ntddndis.h>
+#include <iphlpapi.h>
+#define NTOS_MODE_USER
+#include <ndk/iofuncs.h>
+#include <ndk/obfuncs.h>
+#include <ndk/rtlfuncs.h>
+
+#include <ndisstat.h>
+
+#define MAX_ADAPTERS    16
+
+typedef struct _ADAPTER
+{
+    CHAR Name[MAX_ADAPTER_NAME_LENGTH + 4];
+    CHAR Description[MAX_ADAPTER_DESCRIPTION_LENGTH + 4];
+    HANDLE Handle;
+    PNDIS_PACKET_STATISTICS Current;
+    PNDIS_PACKET_STATISTICS Previous;
+    ULONG Size;
+} ADAPTER, *PADAPTER;
+
+static const ULONG LatencyLimits[NDIS_SEND_LATENCY_BUCKETS - 1] = NDIS_SEND_LATENCY_LIMITS;
+
+static ADAPTER Adapters[MAX_ADAPTERS];
+static ULONG AdapterCount;
+
+static
+HANDLE
+OpenAdapter(
+    _In_ PCSTR Name)
+{
+    CHAR DeviceName[MAX_PATH];
+    ANSI_STRING AnsiName;
+    UNICODE_STRING UnicodeName;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    HANDLE Handle;
+    NTSTATUS Status;
+
+    /* Adapters have no DOS name, so go through the native API */
+    _snprintf(DeviceName, sizeof(DeviceName), "\\Device\\%s", Name);
+    DeviceName[sizeof(DeviceName) - 1] = ANSI_NULL;
+
+    RtlInitAnsiString(&AnsiName, DeviceName);
+    Status = RtlAnsiStringToUnicodeString(&UnicodeName, &AnsiName, TRUE);
+    if (!NT_SUCCESS(Status))
+        return NULL;
+
+    InitializeObjectAttributes(&ObjectAttributes, &UnicodeName, OBJ_CASE_INSENSITIVE, NULL, NULL);
+
+    Status = NtCreateFile(&Handle,
+                          GENERIC_READ | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          0,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          FILE_OPEN,
+                          FILE_SYNCHRONOUS_IO_NONALERT,
+                          NULL,
+                          0);
+
+    RtlFreeUnicodeString(&UnicodeName);
+
+    return NT_SUCCESS(Status) ? Handle : NULL;
+}
+
+static
+BOOL
+QueryStatistics(
+    _Inout_ PADAPTER Adapter)
+{
+    ULONG Oid = OID_REACTOS_PACKET_STATISTICS;
+    DWORD BytesReturned;
+
+    return DeviceIoControl(Adapter->Handle,
+                           IOCTL_NDIS_QUERY_GLOBAL_STATS,
+                           &Oid,
+                           sizeof(Oid),
+                           Adapter->Current,
+                           Adapter->Size,
+                           &BytesReturned,
+                           NULL);
+}
+
+static
+BOOL
+FindAdapters(VOID)
+{
+    PIP_ADAPTER_INFO AdapterInfo, Info;
+    ULONG Length = 0;
+    PADAPTER Adapter;
+
+    if (GetAdaptersInfo(NULL, &Length) != ERROR_BUFFER_OVERFLOW)
+        return FALSE;
+
+    AdapterInfo = HeapAlloc(GetProcessHeap(), 0, Length);
+    if (!AdapterInfo)
+        return FALSE;
+
+    if (GetAdaptersInfo(AdapterInfo, &Length) != NO_ERROR)
+    {
+        HeapFree(GetProcessHeap(), 0, AdapterInfo);
+        return FALSE;
+    }
+
+    for (Info = AdapterInfo; Info && AdapterCount < MAX_ADAPTERS; Info = Info->Next)
+    {
+        Adapter = &Adapters[AdapterCount];
+
+        Adapter->Handle = OpenAdapter(Info->AdapterName);
+        if (!Adapter->Handle)
+            continue;
+
+        strcpy(Adapter->Name, Info->AdapterName);
+        strcpy(Adapter->Description, Info->Description);
+
+        /* Sized for the number of processors the first query reports */
+        Adapter->Size = sizeof(NDIS_PACKET_STATISTICS);
+        Adapter->Current = HeapAlloc(GetProcessHeap(), 0, Adapter->Size);
+        if (!Adapter->Current || !QueryStatistics(Adapter))
+        {
+            printf("%s: no packet statistics (error %lu)\n", Info->Description, GetLastError());
+            CloseHandle(Adapter->Handle);
+            continue;
+        }
+
+        Adapter->Size = FIELD_OFFSET(NDIS_PACKET_STATISTICS,
+                                     Processor[Adapter->Current->NumberOfProcessors]);
+        HeapFree(GetProcessHeap(), 0, Adapter->Current);
+        Adapter->Current = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Adapter->Size);
+        Adapter->Previous = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Adapter->Size);
+        if (!Adapter->Current || !Adapter->Previous || !QueryStatistics(Adapter))
+        {
+            CloseHandle(Adapter->Handle);
+            continue;
+        }
+
+        AdapterCount++;
+    }
+
+    HeapFree(GetProcessHeap(), 0, AdapterInfo);
+
+    return AdapterCount != 0;
+}
+
+static
+VOID
+PrintCounters(
+    _In_ PCSTR Label,
+    _In_ PNDIS_PACKET_COUNTERS Current,
+    _In_ PNDIS_PACKET_COUNTERS Previous,
+    _In_ ULONG Seconds)
+{
+    printf("  %-6s tx %8I64u pkt/s %10I64u B/s  rx %8I64u pkt/s %10I64u B/s  int %7I64u/s  dpc %7I64u/s  err %I64u  sg %I64u\n",
+           Label,
+           (Current->SendPackets - Previous->SendPackets) / Seconds,
+           (Current->SendBytes - Previous->SendBytes) / Seconds,
+           (Current->ReceivePackets - Previous->ReceivePackets) / Seconds,
+           (Current->ReceiveBytes - Previous->ReceiveBytes) / Seconds,
+           (Current->Interrupts - Previous->Interrupts) / Seconds,
+           (Current->Dpcs - Previous->Dpcs) / Seconds,
+           Current->SendErrors - Previous->SendErrors,
+           Current->ScatterGatherFailures - Previous->ScatterGatherFailures);
+}
+
+static
+VOID
+PrintAdapter(
+    _In_ PADAPTER Adapter,
+    _In_ BOOL PerProcessor,
+    _In_ ULONG Seconds)
+{
+    PNDIS_PACKET_STATISTICS Current = Adapter->Current;
+    PNDIS_PACKET_STATISTICS Previous = Adapter->Previous;
+    CHAR Label[16];
+    ULONG i;
+
+    printf("%s %s\n", Adapter->Description, Adapter->Name);
+
+    PrintCounters("total", &Current->Total, &Previous->Total, Seconds);
+
+    if (PerProcessor)
+    {
+        for (i = 0; i < Current->NumberOfProcessors; i++)
+        {
+            _snprintf(Label, sizeof(Label), "cpu%lu", i);
+            Label[sizeof(Label) - 1] = ANSI_NULL;
+            PrintCounters(Label, &Current->Processor[i], &Previous->Processor[i], Seconds);
+        }
+    }
+
+    printf("  queue %lu (max %lu), %I64u sends in flight\n",
+           Current->QueueDepth,
+           Current->MaximumQueueDepth,
+           Current->Total.SendPackets - Current->Total.SendCompletions);
+
+    printf("  send latency:");
+    for (i = 0; i < NDIS_SEND_LATENCY_BUCKETS; i++)
+    {
+        if (i < NDIS_SEND_LATENCY_BUCKETS - 1)
+            printf(" <%luus %I64u", LatencyLimits[i],
+                   Current->Total.SendLatency[i] - Previous->Total.SendLatency[i]);
+        else
+            printf(" more %I64u",
+                   Current->Total.SendLatency[i] - Previous->Total.SendLatency[i]);
+    }
+    printf("\n\n");
+}
+
+static
+VOID
+Usage(VOID)
+{
+    printf("Prints the packet statistics NDIS keeps for each adapter\n\n"
+           "NDISSTAT [-p] [interval]\n\n"
+           "  -p        Show each processor separately\n"
+           "  interval  Seconds between updates, 1 by default\n");
+}
+
+int main(int argc, char **argv)
+{
+    PNDIS_PACKET_STATISTICS Swap;
+    BOOL PerProcessor = FALSE;
+    ULONG Seconds = 1;
+    ULONG i;
+    int Arg;
+
+    for (Arg = 1; Arg < argc; Arg++)
+    {
+        if (!_stricmp(argv[Arg], "-p") || !_stricmp(argv[Arg], "/p"))
+        {
+            PerProcessor = TRUE;
+        }
+        else if (atoi(argv[Arg]) > 0)
+        {
+            Seconds = atoi(argv[Arg]);
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (!FindAdapters())
+    {
+        printf("No adapter reports packet statistics\n");
+        return 1;
+    }
+
+    /* Every line shows the rates over the last interval, until Ctrl+C */
+    for (;;)
+    {
+        Sleep(Seconds * 1000);
+
+        for (i = 0; i < AdapterCount; i++)
+        {
+            Swap = Adapters[i].Previous;
+            Adapters[i].Previous = Adapters[i].Current;
+            Adapters[i].Current = Swap;
+
+            if (!QueryStatistics(&Adapters[i]))
+            {
+                printf("%s: query failed (error %lu)\n", Adapters[i].Description, GetLastError());
+                continue;
+            }
+
+            PrintAdapter(&Adapters[i], PerProcessor, Seconds);
+        }
+    }
+
+    return 0;
+}
@@ -443,6 +443,53 @@ AfdSetInformation(
     return Status;
 }
 
+NTSTATUS
+AfdPollRegister(
+    _In_ HANDLE SocketHandle,
+    _In_ ULONG Events,
+    _In_ ULONG Flags,
+    _In_opt_ PVOID Context)
+{
+    NTSTATUS Status;
+    IO_STATUS_BLOCK IoStatus;
+    AFD_POLL_REGISTER_INFO RegisterInfo;
+    HANDLE Event;
+
+    Status = NtCreateEvent(&Event,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           NotificationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        return Status;
+    }
+
+    RegisterInfo.Events = Events;
+    RegisterInfo.Flags = Flags;
+    RegisterInfo.Context = Context;
+
+    Status = NtDeviceIoControlFile(SocketHandle,
+                                   Event,
+                                   NULL,
+                                   NULL,
+                                   &IoStatus,
+                                   IOCTL_AFD_POLL_REGISTER,
+                                   &RegisterInfo,
+                                   sizeof(RegisterInfo),
+                                   NULL,
+                                   0);
+    if (Status == STATUS_PENDING)
+    {
+        NtWaitForSingleObject(Event, FALSE, NULL);
+        Status = IoStatus.Status;
+    }
+
+    NtClose(Event);
+
+    return Status;
+}
+
 NTSTATUS
 AfdGetInformation(
     _In_ HANDLE SocketHandle,
@@ -49,6 +49,13 @@ AfdSetInformation(
     _In_opt_ PULONG Ulong,
     _In_opt_ PLARGE_INTEGER LargeInteger);
 
+NTSTATUS
+AfdPollRegister(
+    _In_ HANDLE SocketHandle,
+    _In_ ULONG Events,
+    _In_ ULONG Flags,
+    _In_opt_ PVOID Context);
+
 NTSTATUS
 AfdGetInformation(
     _In_ HANDLE SocketHandle,
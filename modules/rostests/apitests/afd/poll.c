@@ -0,0 +1,239 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Test for IOCTL_AFD_POLL_REGISTER
+ */
+
+#include "precomp.h"
+
+#define IDLE_SOCKETS    10000
+#define ACTIVE_SOCKETS  100
+#define ROUNDS          100
+
+static
+SOCKET
+CreateBoundSocket(
+    _Out_ struct sockaddr_in *Address)
+{
+    SOCKET Socket;
+    int AddressLength = sizeof(*Address);
+
+    Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (Socket == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    memset(Address, 0, sizeof(*Address));
+    Address->sin_family = AF_INET;
+    Address->sin_addr.s_addr = inet_addr("127.0.0.1");
+    Address->sin_port = htons(0);
+
+    if (bind(Socket, (struct sockaddr *)Address, sizeof(*Address)) == SOCKET_ERROR ||
+        getsockname(Socket, (struct sockaddr *)Address, &AddressLength) == SOCKET_ERROR)
+    {
+        closesocket(Socket);
+        return INVALID_SOCKET;
+    }
+
+    return Socket;
+}
+
+static
+void
+TestRegister(void)
+{
+    NTSTATUS Status;
+    SOCKET Receiver, Sender;
+    struct sockaddr_in ReceiverAddress, SenderAddress;
+    HANDLE Port;
+    DWORD Events;
+    ULONG_PTR Key;
+    LPOVERLAPPED Context;
+    CHAR Buffer[16] = "ping";
+    BOOL Ret;
+
+    Receiver = CreateBoundSocket(&ReceiverAddress);
+    ok(Receiver != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    Sender = CreateBoundSocket(&SenderAddress);
+    ok(Sender != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    if (Receiver == INVALID_SOCKET || Sender == INVALID_SOCKET)
+    {
+        skip("No sockets\n");
+        return;
+    }
+
+    /* Without a completion port there is nowhere to report to */
+    Status = AfdPollRegister((HANDLE)Receiver, AFD_EVENT_RECEIVE, 0, (PVOID)0x1234);
+    ok(Status == STATUS_INVALID_PARAMETER, "AfdPollRegister returned %lx\n", Status);
+
+    Port = CreateIoCompletionPort((HANDLE)Receiver, NULL, 0x55, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+
+    Status = AfdPollRegister((HANDLE)Receiver, AFD_EVENT_RECEIVE, 0x80, (PVOID)0x1234);
+    ok(Status == STATUS_INVALID_PARAMETER, "AfdPollRegister returned %lx\n", Status);
+
+    Status = AfdPollRegister((HANDLE)Receiver, AFD_EVENT_RECEIVE, 0, (PVOID)0x1234);
+    ok(Status == STATUS_SUCCESS, "AfdPollRegister returned %lx\n", Status);
+
+    /* Nothing to report yet */
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 0);
+    ok(Ret == FALSE && Context == NULL, "Unexpected completion %lx\n", Events);
+
+    sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ReceiverAddress, sizeof(ReceiverAddress));
+
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 1000);
+    ok(Ret == TRUE, "GetQueuedCompletionStatus failed with %lu\n", GetLastError());
+    ok(Events == AFD_EVENT_RECEIVE, "Events = %lx\n", Events);
+    ok(Key == 0x55, "Key = %Ix\n", Key);
+    ok(Context == (LPOVERLAPPED)0x1234, "Context = %p\n", Context);
+
+    /* Level-triggered registrations report once until re-armed */
+    sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ReceiverAddress, sizeof(ReceiverAddress));
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 200);
+    ok(Ret == FALSE && Context == NULL, "Unexpected completion %lx\n", Events);
+
+    /* Re-arming reports the data that is still there */
+    Status = AfdPollRegister((HANDLE)Receiver, AFD_EVENT_RECEIVE, 0, (PVOID)0x1234);
+    ok(Status == STATUS_SUCCESS, "AfdPollRegister returned %lx\n", Status);
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 0);
+    ok(Ret == TRUE && Events == AFD_EVENT_RECEIVE, "Ret = %d, Events = %lx\n", Ret, Events);
+
+    recv(Receiver, Buffer, sizeof(Buffer), 0);
+    recv(Receiver, Buffer, sizeof(Buffer), 0);
+
+    /* Edge-triggered registrations report when the socket becomes readable */
+    Status = AfdPollRegister((HANDLE)Receiver, AFD_EVENT_RECEIVE, AFD_POLL_EDGE_TRIGGERED, (PVOID)0x5678);
+    ok(Status == STATUS_SUCCESS, "AfdPollRegister returned %lx\n", Status);
+    sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ReceiverAddress, sizeof(ReceiverAddress));
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 1000);
+    ok(Ret == TRUE && Context == (LPOVERLAPPED)0x5678, "Ret = %d, Context = %p\n", Ret, Context);
+    ok(Events == AFD_EVENT_RECEIVE, "Events = %lx\n", Events);
+
+    /* But not again while the earlier data is still unread */
+    sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ReceiverAddress, sizeof(ReceiverAddress));
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 200);
+    ok(Ret == FALSE && Context == NULL, "Unexpected completion %lx\n", Events);
+
+    /* Once everything was read, new data is reported again */
+    recv(Receiver, Buffer, sizeof(Buffer), 0);
+    recv(Receiver, Buffer, sizeof(Buffer), 0);
+    sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ReceiverAddress, sizeof(ReceiverAddress));
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 1000);
+    ok(Ret == TRUE && Context == (LPOVERLAPPED)0x5678, "Ret = %d, Context = %p\n", Ret, Context);
+    ok(Events == AFD_EVENT_RECEIVE, "Events = %lx\n", Events);
+    recv(Receiver, Buffer, sizeof(Buffer), 0);
+
+    /* Unregistered sockets stay quiet */
+    Status = AfdPollRegister((HANDLE)Receiver, 0, 0, NULL);
+    ok(Status == STATUS_SUCCESS, "AfdPollRegister returned %lx\n", Status);
+    sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ReceiverAddress, sizeof(ReceiverAddress));
+    Ret = GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 200);
+    ok(Ret == FALSE && Context == NULL, "Unexpected completion %lx\n", Events);
+
+    closesocket(Sender);
+    closesocket(Receiver);
+    CloseHandle(Port);
+}
+
+static
+void
+TestManySockets(void)
+{
+    SOCKET *Idle, Active[ACTIVE_SOCKETS], Sender;
+    struct sockaddr_in ActiveAddress[ACTIVE_SOCKETS], Address;
+    HANDLE Port;
+    DWORD Events;
+    ULONG_PTR Key;
+    LPOVERLAPPED Context;
+    CHAR Buffer[16] = "ping";
+    ULONG IdleCount, Received, i, Round;
+    LARGE_INTEGER Frequency, Start, End;
+    NTSTATUS Status;
+
+    Idle = HeapAlloc(GetProcessHeap(), 0, IDLE_SOCKETS * sizeof(*Idle));
+    if (!Idle)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+
+    /* Idle sockets are registered but never become ready */
+    for (IdleCount = 0; IdleCount < IDLE_SOCKETS; IdleCount++)
+    {
+        Idle[IdleCount] = CreateBoundSocket(&Address);
+        if (Idle[IdleCount] == INVALID_SOCKET)
+            break;
+
+        CreateIoCompletionPort((HANDLE)Idle[IdleCount], Port, IdleCount, 0);
+        AfdPollRegister((HANDLE)Idle[IdleCount], AFD_EVENT_RECEIVE, 0, &Idle[IdleCount]);
+    }
+    trace("Registered %lu idle sockets\n", IdleCount);
+
+    for (i = 0; i < ACTIVE_SOCKETS; i++)
+    {
+        Active[i] = CreateBoundSocket(&ActiveAddress[i]);
+        ok(Active[i] != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+        CreateIoCompletionPort((HANDLE)Active[i], Port, IDLE_SOCKETS + i, 0);
+        Status = AfdPollRegister((HANDLE)Active[i], AFD_EVENT_RECEIVE, 0, &Active[i]);
+        ok(Status == STATUS_SUCCESS, "AfdPollRegister returned %lx\n", Status);
+    }
+
+    Sender = CreateBoundSocket(&Address);
+    ok(Sender != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    Received = 0;
+    for (Round = 0; Round < ROUNDS; Round++)
+    {
+        for (i = 0; i < ACTIVE_SOCKETS; i++)
+        {
+            sendto(Sender, Buffer, 4, 0, (struct sockaddr *)&ActiveAddress[i], sizeof(ActiveAddress[i]));
+        }
+
+        for (i = 0; i < ACTIVE_SOCKETS; i++)
+        {
+            if (!GetQueuedCompletionStatus(Port, &Events, &Key, &Context, 1000))
+                break;
+
+            ok(Key >= IDLE_SOCKETS, "Idle socket %Iu reported %lx\n", Key, Events);
+            if (Key < IDLE_SOCKETS)
+                continue;
+
+            /* Consume the datagram and wait for the next one */
+            recv(Active[Key - IDLE_SOCKETS], Buffer, sizeof(Buffer), 0);
+            AfdPollRegister((HANDLE)Active[Key - IDLE_SOCKETS], AFD_EVENT_RECEIVE, 0, Context);
+            Received++;
+        }
+    }
+
+    QueryPerformanceCounter(&End);
+
+    ok(Received == ROUNDS * ACTIVE_SOCKETS, "Received %lu events\n", Received);
+    trace("%lu events with %lu idle sockets in %I64u us\n",
+          Received, IdleCount,
+          (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart);
+
+    closesocket(Sender);
+    for (i = 0; i < ACTIVE_SOCKETS; i++)
+        closesocket(Active[i]);
+    for (i = 0; i < IdleCount; i++)
+        closesocket(Idle[i]);
+    CloseHandle(Port);
+    HeapFree(GetProcessHeap(), 0, Idle);
+}
+
+START_TEST(poll)
+{
+    WSADATA WsaData;
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+
+    TestRegister();
+    TestManySockets();
+
+    WSACleanup();
+}
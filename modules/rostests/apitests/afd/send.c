@@ -88,8 +88,142 @@ TestSendTo(void)
     NtClose(SocketHandle);
 }
 
+#define ZERO_COPY_CALL_SIZE     (256 * 1024)
+#define ZERO_COPY_SMALL_BUFFERS 64
+
+static
+DWORD
+WINAPI
+DrainThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET Socket = (SOCKET)Parameter;
+    CHAR Buffer[16 * 1024];
+
+    while (recv(Socket, Buffer, sizeof(Buffer), 0) > 0)
+        ;
+
+    return 0;
+}
+
+/* Returns how many sends on the socket AFD handed to the transport without
+ * copying them, or -1 if AFD doesn't count them */
+static
+LONG
+ZeroCopySends(
+    _In_ SOCKET Socket)
+{
+    NTSTATUS Status;
+    ULONG Count;
+
+    Status = AfdGetInformation((HANDLE)Socket, AFD_INFO_ZERO_COPY_SENDS, NULL, &Count, NULL);
+    return NT_SUCCESS(Status) ? (LONG)Count : -1;
+}
+
+static
+void
+TestZeroCopySend(void)
+{
+    SOCKET Listener, Client = INVALID_SOCKET, Server = INVALID_SOCKET;
+    struct sockaddr_in addr;
+    int addrLength = sizeof(addr);
+    HANDLE Thread = NULL;
+    PCHAR Buffer;
+    WSABUF WsaBufs[ZERO_COPY_SMALL_BUFFERS];
+    DWORD Sent, i;
+    LONG Before, After;
+    int ret;
+
+    Buffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, ZERO_COPY_CALL_SIZE);
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Listener != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (Buffer && Listener != INVALID_SOCKET &&
+        bind(Listener, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+        getsockname(Listener, (struct sockaddr *)&addr, &addrLength) == 0 &&
+        listen(Listener, 1) == 0)
+    {
+        Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (Client != INVALID_SOCKET &&
+            connect(Client, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            Server = accept(Listener, NULL, NULL);
+        }
+    }
+    if (Server == INVALID_SOCKET)
+    {
+        skip("No connection\n");
+        goto Cleanup;
+    }
+
+    Before = ZeroCopySends(Client);
+    if (Before < 0)
+    {
+        skip("AFD doesn't count zero-copy sends\n");
+        goto Cleanup;
+    }
+    ok(Before == 0, "%ld zero-copy sends on a new socket\n", Before);
+
+    Thread = CreateThread(NULL, 0, DrainThread, (PVOID)Server, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        goto Cleanup;
+
+    /* A small send is copied into AFD's send window */
+    ret = send(Client, Buffer, 1024, 0);
+    ok(ret == 1024, "send returned %d, error %d\n", ret, WSAGetLastError());
+    After = ZeroCopySends(Client);
+    ok(After == Before, "Small send went zero-copy (%ld -> %ld)\n", Before, After);
+
+    /* So are large sends made of small buffers */
+    for (i = 0; i < ZERO_COPY_SMALL_BUFFERS; i++)
+    {
+        WsaBufs[i].buf = Buffer + i * (ZERO_COPY_CALL_SIZE / ZERO_COPY_SMALL_BUFFERS);
+        WsaBufs[i].len = ZERO_COPY_CALL_SIZE / ZERO_COPY_SMALL_BUFFERS;
+    }
+    Before = After;
+    ret = WSASend(Client, WsaBufs, ZERO_COPY_SMALL_BUFFERS, &Sent, 0, NULL, NULL);
+    ok(ret == 0, "WSASend failed with %d\n", WSAGetLastError());
+    After = ZeroCopySends(Client);
+    ok(After == Before, "Send of small buffers went zero-copy (%ld -> %ld)\n", Before, After);
+
+    /* A large buffer is handed to the transport straight from here, once
+     * everything queued ahead of it is gone. Give the copied sends a moment
+     * to drain so it doesn't have to fall back */
+    Sleep(500);
+    WsaBufs[0].buf = Buffer;
+    WsaBufs[0].len = ZERO_COPY_CALL_SIZE;
+    Before = After;
+    ret = WSASend(Client, WsaBufs, 1, &Sent, 0, NULL, NULL);
+    ok(ret == 0, "WSASend failed with %d\n", WSAGetLastError());
+    ok(Sent == ZERO_COPY_CALL_SIZE, "Sent %lu bytes\n", Sent);
+    After = ZeroCopySends(Client);
+    ok(After == Before + 1, "Large send didn't go zero-copy (%ld -> %ld)\n", Before, After);
+
+    shutdown(Client, SD_SEND);
+    WaitForSingleObject(Thread, INFINITE);
+
+Cleanup:
+    if (Thread)
+        CloseHandle(Thread);
+    if (Buffer)
+        HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(Server);
+    closesocket(Client);
+    closesocket(Listener);
+}
+
 START_TEST(send)
 {
+    WSADATA WsaData;
+
     TestSend();
     TestSendTo();
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+    TestZeroCopySend();
+    WSACleanup();
 }
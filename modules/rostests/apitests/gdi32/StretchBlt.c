@@ -850,6 +850,120 @@ static void test_StretchBlt_TopDownOptions(BOOL SrcTopDown, BOOL DstTopDown)
     DeleteDC(hdcScreen);
 }
 
+static HBITMAP create_dib32(HDC hdc, int width, int height, UINT32 **bits)
+{
+    BITMAPINFO bi;
+
+    memset(&bi, 0, sizeof(bi));
+    bi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bi.bmiHeader.biWidth = width;
+    bi.bmiHeader.biHeight = -height;
+    bi.bmiHeader.biPlanes = 1;
+    bi.bmiHeader.biBitCount = 32;
+    bi.bmiHeader.biCompression = BI_RGB;
+
+    return CreateDIBSection(hdc, &bi, DIB_RGB_COLORS, (void **)bits, NULL, 0);
+}
+
+static void test_StretchBlt_Halftone(void)
+{
+    HDC hdcScreen, hdcDst, hdcSrc;
+    HBITMAP bmpDst, bmpSrc, oldDst, oldSrc;
+    UINT32 *dstBits, *srcBits;
+    DWORD start, halftone, coloroncolor;
+    int x, y, i, blue, previous, monotonic;
+
+    hdcScreen = CreateCompatibleDC(0);
+    hdcDst = CreateCompatibleDC(hdcScreen);
+    hdcSrc = CreateCompatibleDC(hdcScreen);
+
+    bmpDst = create_dib32(hdcScreen, 256, 256, &dstBits);
+    bmpSrc = create_dib32(hdcScreen, 512, 512, &srcBits);
+    ok(bmpDst != NULL && bmpSrc != NULL, "CreateDIBSection failed\n");
+    if (!bmpDst || !bmpSrc)
+        goto cleanup;
+
+    oldDst = SelectObject(hdcDst, bmpDst);
+    oldSrc = SelectObject(hdcSrc, bmpSrc);
+
+    ok(SetStretchBltMode(hdcDst, HALFTONE) != 0, "SetStretchBltMode failed\n");
+    SetBrushOrgEx(hdcDst, 0, 0, NULL);
+
+    /* Halving a one pixel checkerboard averages it to gray */
+    for (y = 0; y < 512; y++)
+        for (x = 0; x < 512; x++)
+            srcBits[y * 512 + x] = ((x ^ y) & 1) ? 0xFFFFFF : 0x000000;
+
+    StretchBlt(hdcDst, 0, 0, 256, 256, hdcSrc, 0, 0, 512, 512, SRCCOPY);
+    for (i = 0; i < 256 * 256; i++)
+    {
+        blue = dstBits[i] & 0xFF;
+        if (blue < 0x60 || blue > 0xA0)
+            break;
+    }
+    ok(i == 256 * 256, "Pixel %d is 0x%08x, expected gray\n", i, i < 256 * 256 ? dstBits[i] : 0);
+
+    /* A flat color stays the same whatever the scale */
+    for (i = 0; i < 512 * 512; i++)
+        srcBits[i] = 0x00336699;
+
+    StretchBlt(hdcDst, 0, 0, 256, 256, hdcSrc, 0, 0, 300, 500, SRCCOPY);
+    StretchBlt(hdcDst, 0, 0, 256, 100, hdcSrc, 0, 0, 7, 3, SRCCOPY);
+    for (i = 0; i < 256 * 256; i++)
+    {
+        if (abs((int)(dstBits[i] & 0xFF) - 0x99) > 1 ||
+            abs((int)((dstBits[i] >> 8) & 0xFF) - 0x66) > 1 ||
+            abs((int)((dstBits[i] >> 16) & 0xFF) - 0x33) > 1)
+        {
+            break;
+        }
+    }
+    ok(i == 256 * 256, "Pixel %d is 0x%08x, expected 0x00336699\n", i, i < 256 * 256 ? dstBits[i] : 0);
+
+    /* Growing a gradient keeps it smooth and in order */
+    for (x = 0; x < 16; x++)
+        srcBits[x] = x * 17;
+
+    StretchBlt(hdcDst, 0, 0, 256, 1, hdcSrc, 0, 0, 16, 1, SRCCOPY);
+    previous = 0;
+    monotonic = TRUE;
+    for (x = 0; x < 256; x++)
+    {
+        blue = dstBits[x] & 0xFF;
+        if (blue < previous)
+            monotonic = FALSE;
+        previous = blue;
+    }
+    ok(monotonic, "Stretched gradient is not monotonic\n");
+    ok((dstBits[0] & 0xFF) <= 0x08, "First pixel is 0x%08x\n", dstBits[0]);
+    ok((dstBits[255] & 0xFF) >= 0xF7, "Last pixel is 0x%08x\n", dstBits[255]);
+
+    /* Throughput, for comparison with the nearest neighbour stretch */
+    start = GetTickCount();
+    for (i = 0; i < 20; i++)
+        StretchBlt(hdcDst, 0, 0, 256, 256, hdcSrc, 0, 0, 500, 400, SRCCOPY);
+    halftone = GetTickCount() - start;
+
+    SetStretchBltMode(hdcDst, COLORONCOLOR);
+    start = GetTickCount();
+    for (i = 0; i < 20; i++)
+        StretchBlt(hdcDst, 0, 0, 256, 256, hdcSrc, 0, 0, 500, 400, SRCCOPY);
+    coloroncolor = GetTickCount() - start;
+
+    trace("20 stretches of 500x400 to 256x256: HALFTONE %lu ms, COLORONCOLOR %lu ms\n",
+          halftone, coloroncolor);
+
+    SelectObject(hdcSrc, oldSrc);
+    SelectObject(hdcDst, oldDst);
+
+cleanup:
+    if (bmpSrc) DeleteObject(bmpSrc);
+    if (bmpDst) DeleteObject(bmpDst);
+    DeleteDC(hdcSrc);
+    DeleteDC(hdcDst);
+    DeleteDC(hdcScreen);
+}
+
 START_TEST(StretchBlt)
 {
     trace("\n\n## Start of generalized StretchBlt tests.\n\n");
@@ -866,4 +980,7 @@ START_TEST(StretchBlt)
 
     trace("\n\n## Start of source bottom-up and destination bottom-up tests.\n\n");
     test_StretchBlt_TopDownOptions(FALSE, FALSE);
+
+    trace("\n\n## Start of HALFTONE tests.\n\n");
+    test_StretchBlt_Halftone();
 }
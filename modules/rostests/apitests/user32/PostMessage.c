@@ -0,0 +1,200 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Order and throughput of filtered posted message retrieval
+ */
+
+#include "precomp.h"
+
+#define STRESS_THREADS  2
+#define STRESS_MESSAGES 2000
+
+typedef struct _STRESS_CONTEXT
+{
+    HWND hWndStatus;
+    HWND hWndNoise;
+    LPARAM Id;
+} STRESS_CONTEXT, *PSTRESS_CONTEXT;
+
+static HWND CreateTestWindow(void)
+{
+    return CreateWindowExW(0, L"PostTest", NULL, 0,  10, 10, 20, 20,  NULL, NULL, 0, NULL);
+}
+
+static void Test_FilteredOrder(void)
+{
+    HWND hWnd1, hWnd2;
+    MSG msg;
+
+    hWnd1 = CreateTestWindow();
+    ok(hWnd1 != NULL, "CreateWindow failed\n");
+    hWnd2 = CreateTestWindow();
+    ok(hWnd2 != NULL, "CreateWindow failed\n");
+
+    /* Spread over several windows and message ranges */
+    ok(PostMessageW(hWnd1, WM_APP, 1, 0), "PostMessage failed\n");
+    ok(PostMessageW(hWnd2, WM_USER, 2, 0), "PostMessage failed\n");
+    ok(PostThreadMessageW(GetCurrentThreadId(), WM_APP, 3, 0), "PostThreadMessage failed\n");
+    ok(PostMessageW(hWnd1, WM_TIMER, 4, 0), "PostMessage failed\n");
+    ok(PostMessageW(hWnd1, WM_NULL, 5, 0), "PostMessage failed\n");
+    ok(PostMessageW(hWnd2, WM_APP, 6, 0), "PostMessage failed\n");
+    ok(PostMessageW(hWnd1, WM_USER, 7, 0), "PostMessage failed\n");
+
+    /* One window, any message: posting order across the ranges */
+    ok(PeekMessageW(&msg, hWnd1, 0, 0, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 1, "wParam = %Iu\n", msg.wParam);
+    ok(PeekMessageW(&msg, hWnd1, 0, 0, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 4, "wParam = %Iu\n", msg.wParam);
+
+    /* Any window, one range: posting order across the windows */
+    ok(PeekMessageW(&msg, NULL, WM_USER, WM_APP, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 2, "wParam = %Iu\n", msg.wParam);
+    ok(PeekMessageW(&msg, NULL, WM_USER, WM_APP, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 3 && msg.hwnd == NULL, "wParam = %Iu, hwnd = %p\n", msg.wParam, msg.hwnd);
+
+    /* A range that spans a single message */
+    ok(PeekMessageW(&msg, NULL, WM_USER, WM_USER, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 7, "wParam = %Iu\n", msg.wParam);
+    ok(!PeekMessageW(&msg, hWnd1, WM_USER, WM_USER, PM_NOREMOVE), "PeekMessage succeeded\n");
+
+    /* Thread messages only */
+    ok(!PeekMessageW(&msg, (HWND)-1, 0, 0, PM_NOREMOVE), "PeekMessage succeeded\n");
+
+    /* What is left, in order */
+    ok(PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 5, "wParam = %Iu\n", msg.wParam);
+    ok(PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE), "PeekMessage failed\n");
+    ok(msg.wParam == 6, "wParam = %Iu\n", msg.wParam);
+    ok(!PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE), "PeekMessage succeeded\n");
+
+    DestroyWindow(hWnd1);
+    DestroyWindow(hWnd2);
+}
+
+static void Test_DestroyWindow(void)
+{
+    HWND hWnd1, hWnd2;
+    MSG msg;
+    UINT i, Count;
+
+    hWnd1 = CreateTestWindow();
+    ok(hWnd1 != NULL, "CreateWindow failed\n");
+    hWnd2 = CreateTestWindow();
+    ok(hWnd2 != NULL, "CreateWindow failed\n");
+
+    for (i = 0; i < STRESS_MESSAGES; i++)
+    {
+        PostMessageW(hWnd1, WM_APP, i, 0);
+        PostMessageW(hWnd2, WM_APP, i, 0);
+    }
+
+    /* The dead window's messages go away, the other window keeps its own */
+    DestroyWindow(hWnd1);
+
+    for (Count = 0; PeekMessageW(&msg, NULL, WM_APP, WM_APP, PM_REMOVE); Count++)
+    {
+        if (msg.hwnd != hWnd2 || msg.wParam != Count)
+            break;
+    }
+    ok(Count == STRESS_MESSAGES, "Got %u messages\n", Count);
+
+    DestroyWindow(hWnd2);
+}
+
+static DWORD WINAPI StressThread(PVOID Param)
+{
+    PSTRESS_CONTEXT Context = Param;
+    UINT i;
+
+    for (i = 0; i < STRESS_MESSAGES; i++)
+    {
+        if (!PostMessageW(Context->hWndNoise, WM_APP + 2, i, Context->Id) ||
+            !PostMessageW(Context->hWndStatus, WM_APP + 1, i, Context->Id))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void Test_Throughput(void)
+{
+    STRESS_CONTEXT Context[STRESS_THREADS];
+    HANDLE hThreads[STRESS_THREADS];
+    WPARAM Next[STRESS_THREADS] = { 0 };
+    HWND hWndStatus, hWndNoise;
+    DWORD ExitCode, Start, Elapsed;
+    UINT i, Count, Bad;
+    MSG msg;
+
+    hWndStatus = CreateTestWindow();
+    ok(hWndStatus != NULL, "CreateWindow failed\n");
+    hWndNoise = CreateTestWindow();
+    ok(hWndNoise != NULL, "CreateWindow failed\n");
+
+    /* Workers fill the queue with status updates buried in noise */
+    for (i = 0; i < STRESS_THREADS; i++)
+    {
+        Context[i].hWndStatus = hWndStatus;
+        Context[i].hWndNoise = hWndNoise;
+        Context[i].Id = i;
+        hThreads[i] = CreateThread(NULL, 0, StressThread, &Context[i], 0, NULL);
+        ok(hThreads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    WaitForMultipleObjects(STRESS_THREADS, hThreads, TRUE, INFINITE);
+    for (i = 0; i < STRESS_THREADS; i++)
+    {
+        ok(GetExitCodeThread(hThreads[i], &ExitCode) && ExitCode == 0, "Thread %u failed to post\n", i);
+        CloseHandle(hThreads[i]);
+    }
+
+    /* Pick the status updates out one by one */
+    Start = GetTickCount();
+    Count = Bad = 0;
+    while (PeekMessageW(&msg, hWndStatus, WM_APP + 1, WM_APP + 1, PM_REMOVE))
+    {
+        if (msg.lParam >= STRESS_THREADS || msg.wParam != Next[msg.lParam]++)
+            Bad++;
+        Count++;
+    }
+    Elapsed = GetTickCount() - Start;
+
+    ok(Count == STRESS_THREADS * STRESS_MESSAGES, "Got %u status messages\n", Count);
+    ok(Bad == 0, "%u status messages out of order\n", Bad);
+    trace("%u filtered PeekMessage calls over a queue of %u messages took %lu ms\n",
+          Count, 2 * Count, Elapsed);
+
+    /* The noise is still there, in order */
+    Start = GetTickCount();
+    Count = 0;
+    while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))
+    {
+        ok(msg.hwnd == hWndNoise && msg.message == WM_APP + 2,
+           "Unexpected message %u for %p\n", msg.message, msg.hwnd);
+        Count++;
+    }
+    Elapsed = GetTickCount() - Start;
+
+    ok(Count == STRESS_THREADS * STRESS_MESSAGES, "Got %u noise messages\n", Count);
+    trace("%u unfiltered PeekMessage calls took %lu ms\n", Count, Elapsed);
+
+    DestroyWindow(hWndStatus);
+    DestroyWindow(hWndNoise);
+}
+
+START_TEST(PostMessage)
+{
+    WNDCLASSW wc = { 0 };
+
+    wc.lpfnWndProc = DefWindowProcW;
+    wc.lpszClassName = L"PostTest";
+    ok(RegisterClassW(&wc) != 0, "RegisterClass failed\n");
+
+    Test_FilteredOrder();
+    Test_DestroyWindow();
+    Test_Throughput();
+
+    UnregisterClassW(L"PostTest", NULL);
+}
@@ -57,6 +57,94 @@ EnumFuncEx(
     return TRUE;
 }
 
+#define MANY_PROPS 100
+
+typedef struct _ENUM_CONTEXT
+{
+    UINT Count;
+    ATOM Atoms[MANY_PROPS];
+} ENUM_CONTEXT, *PENUM_CONTEXT;
+
+static
+BOOL
+CALLBACK
+EnumFuncRecord(
+    _In_ HWND hWnd,
+    _In_ PWSTR lpszString,
+    _In_ HANDLE hData,
+    _In_ ULONG_PTR dwData)
+{
+    PENUM_CONTEXT Context = (PENUM_CONTEXT)dwData;
+
+    ok(!HIWORD(lpszString), "Unexpected EnumFuncRecord call: %p, '%ls', %p\n", hWnd, lpszString, hData);
+    ok(hData == (HANDLE)lpszString, "Prop 0x%04x = %p\n", (USHORT)(ULONG_PTR)lpszString, hData);
+    if (Context->Count < MANY_PROPS)
+        Context->Atoms[Context->Count] = (ATOM)(ULONG_PTR)lpszString;
+    Context->Count++;
+    return TRUE;
+}
+
+/* Enough properties to use the hashed lookup in win32k */
+static
+VOID
+TestManyProps(VOID)
+{
+    static ENUM_CONTEXT Context1, Context2;
+    HWND hWnd;
+    UINT i;
+    HANDLE Prop;
+    LRESULT Result;
+
+    hWnd = CreateWindowExW(0, L"PropTest", NULL, 0,  10, 10, 20, 20,  NULL, NULL, 0, NULL);
+    ok(hWnd != NULL, "CreateWindow failed\n");
+
+    for (i = 1; i <= MANY_PROPS; i++)
+    {
+        Result = SetPropW(hWnd, (PCWSTR)MAKEINTATOM(i), (HANDLE)(ULONG_PTR)i);
+        ok(Result == TRUE, "SetProp(0x%04x) returned %Iu\n", i, Result);
+    }
+    for (i = 1; i <= MANY_PROPS; i++)
+    {
+        Prop = GetPropW(hWnd, (PCWSTR)MAKEINTATOM(i));
+        ok(Prop == (HANDLE)(ULONG_PTR)i, "Prop 0x%04x = %p\n", i, Prop);
+    }
+    Prop = GetPropW(hWnd, (PCWSTR)MAKEINTATOM(MANY_PROPS + 1));
+    ok(Prop == NULL, "Prop 0x%04x = %p\n", MANY_PROPS + 1, Prop);
+
+    /* Punch holes in the probe runs */
+    for (i = 1; i <= MANY_PROPS; i += 2)
+    {
+        Prop = RemovePropW(hWnd, (PCWSTR)MAKEINTATOM(i));
+        ok(Prop == (HANDLE)(ULONG_PTR)i, "RemoveProp(0x%04x) returned %p\n", i, Prop);
+    }
+    for (i = 1; i <= MANY_PROPS; i++)
+    {
+        Prop = GetPropW(hWnd, (PCWSTR)MAKEINTATOM(i));
+        ok(Prop == ((i & 1) ? NULL : (HANDLE)(ULONG_PTR)i), "Prop 0x%04x = %p\n", i, Prop);
+    }
+
+    /* Enumeration sees every property once, in the same order each time */
+    EnumPropsExW(hWnd, EnumFuncRecord, (LPARAM)&Context1);
+    EnumPropsExW(hWnd, EnumFuncRecord, (LPARAM)&Context2);
+    ok(Context1.Count == MANY_PROPS / 2, "Enumerated %u props\n", Context1.Count);
+    ok(Context2.Count == Context1.Count, "Enumerated %u props, then %u\n", Context1.Count, Context2.Count);
+    ok(Context1.Count <= MANY_PROPS &&
+       !memcmp(Context1.Atoms, Context2.Atoms, Context1.Count * sizeof(ATOM)),
+       "Enumeration order changed\n");
+
+    for (i = 2; i <= MANY_PROPS; i += 2)
+    {
+        Prop = RemovePropW(hWnd, (PCWSTR)MAKEINTATOM(i));
+        ok(Prop == (HANDLE)(ULONG_PTR)i, "RemoveProp(0x%04x) returned %p\n", i, Prop);
+    }
+    Result = SetPropW(hWnd, (PCWSTR)MAKEINTATOM(1), (HANDLE)(ULONG_PTR)1);
+    ok(Result == TRUE, "SetProp returned %Iu\n", Result);
+    Prop = GetPropW(hWnd, (PCWSTR)MAKEINTATOM(1));
+    ok(Prop == (HANDLE)(ULONG_PTR)1, "Prop 0x0001 = %p\n", Prop);
+
+    DestroyWindow(hWnd);
+}
+
 START_TEST(SetProp)
 {
     HWND hWnd;
@@ -170,6 +258,8 @@ START_TEST(SetProp)
 
     DestroyWindow(hWnd);
 
+    TestManyProps();
+
     while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
         DispatchMessageA(&msg);
  }
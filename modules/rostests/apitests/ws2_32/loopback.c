@@ -0,0 +1,271 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Latency and throughput of 127.0.0.1 traffic
+ */
+
+#include "ws2_32.h"
+
+#define ROUND_TRIPS     1000
+#define TRANSFER_SIZE   (64 * 1024 * 1024)
+#define CHUNK_SIZE      (64 * 1024)
+
+static
+ULONGLONG
+ElapsedMicroseconds(
+    _In_ PLARGE_INTEGER Start)
+{
+    LARGE_INTEGER Frequency, End;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+
+    return (End.QuadPart - Start->QuadPart) * 1000000 / Frequency.QuadPart;
+}
+
+static
+SOCKET
+CreateBoundSocket(
+    _In_ int Type,
+    _Out_ struct sockaddr_in *Address)
+{
+    SOCKET Socket;
+    int AddressLength = sizeof(*Address);
+
+    Socket = socket(AF_INET, Type, 0);
+    if (Socket == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    memset(Address, 0, sizeof(*Address));
+    Address->sin_family = AF_INET;
+    Address->sin_addr.s_addr = inet_addr("127.0.0.1");
+    Address->sin_port = htons(0);
+
+    if (bind(Socket, (struct sockaddr *)Address, sizeof(*Address)) == SOCKET_ERROR ||
+        getsockname(Socket, (struct sockaddr *)Address, &AddressLength) == SOCKET_ERROR)
+    {
+        closesocket(Socket);
+        return INVALID_SOCKET;
+    }
+
+    return Socket;
+}
+
+static
+void
+TestUdpLatency(void)
+{
+    SOCKET Client, Server;
+    struct sockaddr_in ClientAddress, ServerAddress;
+    CHAR Buffer[64];
+    LARGE_INTEGER Start;
+    ULONGLONG Elapsed;
+    ULONG i;
+    int Result;
+
+    Client = CreateBoundSocket(SOCK_DGRAM, &ClientAddress);
+    ok(Client != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    Server = CreateBoundSocket(SOCK_DGRAM, &ServerAddress);
+    ok(Server != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    if (Client == INVALID_SOCKET || Server == INVALID_SOCKET)
+    {
+        skip("No sockets\n");
+        return;
+    }
+
+    memset(Buffer, 0x55, sizeof(Buffer));
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < ROUND_TRIPS; i++)
+    {
+        Result = sendto(Client, Buffer, sizeof(Buffer), 0, (struct sockaddr *)&ServerAddress, sizeof(ServerAddress));
+        if (Result != sizeof(Buffer))
+            break;
+        Result = recv(Server, Buffer, sizeof(Buffer), 0);
+        if (Result != sizeof(Buffer))
+            break;
+        Result = sendto(Server, Buffer, sizeof(Buffer), 0, (struct sockaddr *)&ClientAddress, sizeof(ClientAddress));
+        if (Result != sizeof(Buffer))
+            break;
+        Result = recv(Client, Buffer, sizeof(Buffer), 0);
+        if (Result != sizeof(Buffer))
+            break;
+    }
+
+    Elapsed = ElapsedMicroseconds(&Start);
+
+    ok(i == ROUND_TRIPS, "Round trip %lu failed with %d, error %d\n", i, Result, WSAGetLastError());
+    ok(Buffer[0] == 0x55 && Buffer[sizeof(Buffer) - 1] == 0x55, "Data corrupted\n");
+    trace("UDP: %lu round trips in %I64u us, %I64u us each\n",
+          i, Elapsed, i ? Elapsed / i : 0);
+
+    closesocket(Client);
+    closesocket(Server);
+}
+
+static
+void
+TestUdpLargeDatagram(void)
+{
+    SOCKET Client, Server;
+    struct sockaddr_in ClientAddress, ServerAddress;
+    PUCHAR SendBuffer, ReceiveBuffer;
+    int Size = 30000, Result, i;
+
+    SendBuffer = HeapAlloc(GetProcessHeap(), 0, Size);
+    ReceiveBuffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Size);
+    if (!SendBuffer || !ReceiveBuffer)
+    {
+        skip("Out of memory\n");
+        goto Cleanup;
+    }
+
+    for (i = 0; i < Size; i++)
+        SendBuffer[i] = (UCHAR)i;
+
+    Client = CreateBoundSocket(SOCK_DGRAM, &ClientAddress);
+    ok(Client != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    Server = CreateBoundSocket(SOCK_DGRAM, &ServerAddress);
+    ok(Server != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    if (Client == INVALID_SOCKET || Server == INVALID_SOCKET)
+    {
+        skip("No sockets\n");
+        goto Cleanup;
+    }
+
+    /* Larger than the MTU of the loopback interface */
+    Result = sendto(Client, (PCHAR)SendBuffer, Size, 0, (struct sockaddr *)&ServerAddress, sizeof(ServerAddress));
+    ok(Result == Size, "sendto returned %d, error %d\n", Result, WSAGetLastError());
+    Result = recv(Server, (PCHAR)ReceiveBuffer, Size, 0);
+    ok(Result == Size, "recv returned %d, error %d\n", Result, WSAGetLastError());
+    ok(!memcmp(SendBuffer, ReceiveBuffer, Size), "Data corrupted\n");
+
+    closesocket(Client);
+    closesocket(Server);
+
+Cleanup:
+    if (SendBuffer)
+        HeapFree(GetProcessHeap(), 0, SendBuffer);
+    if (ReceiveBuffer)
+        HeapFree(GetProcessHeap(), 0, ReceiveBuffer);
+}
+
+static
+DWORD
+WINAPI
+TcpSendThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET Socket = (SOCKET)Parameter;
+    PCHAR Buffer;
+    ULONG Sent = 0;
+    int Result;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+        return 0;
+
+    memset(Buffer, 0xAA, CHUNK_SIZE);
+
+    while (Sent < TRANSFER_SIZE)
+    {
+        Result = send(Socket, Buffer, CHUNK_SIZE, 0);
+        if (Result <= 0)
+            break;
+        Sent += Result;
+    }
+
+    shutdown(Socket, SD_SEND);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+
+    return Sent;
+}
+
+static
+void
+TestTcpThroughput(void)
+{
+    SOCKET Listener, Client, Server;
+    struct sockaddr_in Address;
+    HANDLE Thread;
+    PUCHAR Buffer;
+    LARGE_INTEGER Start;
+    ULONGLONG Elapsed;
+    ULONG Received = 0;
+    DWORD Sent = 0;
+    BOOLEAN Corrupted = FALSE;
+    int Result, i;
+
+    Listener = CreateBoundSocket(SOCK_STREAM, &Address);
+    ok(Listener != INVALID_SOCKET, "CreateBoundSocket failed with %d\n", WSAGetLastError());
+    if (Listener == INVALID_SOCKET)
+    {
+        skip("No socket\n");
+        return;
+    }
+
+    Result = listen(Listener, 1);
+    ok(Result == 0, "listen failed with %d\n", WSAGetLastError());
+
+    Client = socket(AF_INET, SOCK_STREAM, 0);
+    ok(Client != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    Result = connect(Client, (struct sockaddr *)&Address, sizeof(Address));
+    ok(Result == 0, "connect failed with %d\n", WSAGetLastError());
+    Server = accept(Listener, NULL, NULL);
+    ok(Server != INVALID_SOCKET, "accept failed with %d\n", WSAGetLastError());
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (Result != 0 || Server == INVALID_SOCKET || !Buffer)
+    {
+        skip("No connection\n");
+        goto Cleanup;
+    }
+
+    QueryPerformanceCounter(&Start);
+
+    Thread = CreateThread(NULL, 0, TcpSendThread, (PVOID)Client, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        goto Cleanup;
+
+    while ((Result = recv(Server, (PCHAR)Buffer, CHUNK_SIZE, 0)) > 0)
+    {
+        for (i = 0; i < Result; i++)
+            Corrupted |= (Buffer[i] != 0xAA);
+        Received += Result;
+    }
+
+    Elapsed = ElapsedMicroseconds(&Start);
+
+    WaitForSingleObject(Thread, INFINITE);
+    GetExitCodeThread(Thread, &Sent);
+    CloseHandle(Thread);
+
+    ok(Result == 0, "recv failed with %d\n", WSAGetLastError());
+    ok(Sent == TRANSFER_SIZE, "Sent %lu bytes\n", Sent);
+    ok(Received == Sent, "Received %lu of %lu bytes\n", Received, Sent);
+    ok(!Corrupted, "Data corrupted\n");
+    trace("TCP: %lu bytes in %I64u us, %I64u KB/s\n",
+          Received, Elapsed, Elapsed ? (ULONGLONG)Received * 1000000 / 1024 / Elapsed : 0);
+
+Cleanup:
+    if (Buffer)
+        HeapFree(GetProcessHeap(), 0, Buffer);
+    if (Server != INVALID_SOCKET)
+        closesocket(Server);
+    closesocket(Client);
+    closesocket(Listener);
+}
+
+START_TEST(loopback)
+{
+    WSADATA WsaData;
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+
+    TestUdpLatency();
+    TestUdpLargeDatagram();
+    TestTcpThroughput();
+
+    WSACleanup();
+}
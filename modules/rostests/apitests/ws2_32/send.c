@@ -167,6 +167,227 @@ test_sendto(void)
     FreeReadOnly(buffer);
 }
 
+#define LARGE_SEND_SIZE     (16 * 1024 * 1024)
+#define CPU_TRANSFER_SIZE   (256 * 1024 * 1024)
+#define CPU_CALL_SIZE       (256 * 1024)
+#define CPU_SMALL_BUFFERS   64
+
+static
+BOOL
+CreateConnectedPair(
+    _Out_ SOCKET *Client,
+    _Out_ SOCKET *Server)
+{
+    SOCKET Listener;
+    struct sockaddr_in addr;
+    int addrLength = sizeof(addr);
+
+    *Client = *Server = INVALID_SOCKET;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Listener == INVALID_SOCKET)
+        return FALSE;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(Listener, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+        getsockname(Listener, (struct sockaddr *)&addr, &addrLength) == 0 &&
+        listen(Listener, 1) == 0)
+    {
+        *Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (*Client != INVALID_SOCKET &&
+            connect(*Client, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            *Server = accept(Listener, NULL, NULL);
+        }
+    }
+
+    closesocket(Listener);
+
+    if (*Server == INVALID_SOCKET)
+    {
+        if (*Client != INVALID_SOCKET)
+            closesocket(*Client);
+        *Client = INVALID_SOCKET;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Large blocking sends go to the transport straight from the caller's pages.
+ * Cancel one while the transport waits for window space and make sure the
+ * pages stay valid until the transport lets go of them */
+static
+VOID
+test_send_cancel(void)
+{
+    SOCKET Client, Server;
+    PUCHAR Buffer, Received;
+    SIZE_T Size = 0;
+    WSABUF WsaBuf;
+    WSAOVERLAPPED Overlapped = { 0 };
+    DWORD Sent = 0, Flags = 0, Total, i;
+    BOOLEAN Corrupted = FALSE;
+    NTSTATUS Status;
+    int ret;
+
+    if (!CreateConnectedPair(&Client, &Server))
+    {
+        skip("No connection\n");
+        return;
+    }
+
+    Buffer = VirtualAlloc(NULL, LARGE_SEND_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    Received = HeapAlloc(GetProcessHeap(), 0, 64 * 1024);
+    Overlapped.hEvent = WSACreateEvent();
+    if (!Buffer || !Received || !Overlapped.hEvent)
+    {
+        skip("No memory\n");
+        goto Cleanup;
+    }
+
+    for (i = 0; i < LARGE_SEND_SIZE; i++)
+        Buffer[i] = (UCHAR)(i % 251);
+
+    /* Nobody reads on the other side, so the send has to wait */
+    WsaBuf.buf = (PCHAR)Buffer;
+    WsaBuf.len = LARGE_SEND_SIZE;
+    ret = WSASend(Client, &WsaBuf, 1, NULL, 0, &Overlapped, NULL);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == WSA_IO_PENDING,
+       "WSASend returned %d, error %d\n", ret, WSAGetLastError());
+
+    Sleep(500);
+    ok(CancelIo((HANDLE)Client), "CancelIo failed with %lu\n", GetLastError());
+    WSAGetOverlappedResult(Client, &Overlapped, &Sent, TRUE, &Flags);
+    ok(Sent < LARGE_SEND_SIZE, "Sent %lu bytes\n", Sent);
+
+    /* Anything the transport still read from here would fault */
+    Status = NtFreeVirtualMemory(NtCurrentProcess(), (PVOID *)&Buffer, &Size, MEM_RELEASE);
+    ok(Status == STATUS_SUCCESS, "Status = %lx\n", Status);
+    Buffer = NULL;
+
+    /* What the transport took is in the stream, followed by later sends */
+    ret = send(Client, "end", 4, 0);
+    ok(ret == 4, "send returned %d, error %d\n", ret, WSAGetLastError());
+    shutdown(Client, SD_SEND);
+
+    Total = 0;
+    while ((ret = recv(Server, (PCHAR)Received, 64 * 1024, 0)) > 0)
+    {
+        for (i = 0; i < (DWORD)ret; i++, Total++)
+        {
+            if (Total < Sent)
+                Corrupted |= (Received[i] != (UCHAR)(Total % 251));
+            else if (Total - Sent < 4)
+                Corrupted |= (Received[i] != (UCHAR)"end"[Total - Sent]);
+        }
+    }
+    ok(ret == 0, "recv failed with %d\n", WSAGetLastError());
+    ok(Total == Sent + 4, "Received %lu bytes, sent %lu + 4\n", Total, Sent);
+    ok(!Corrupted, "Data corrupted\n");
+
+Cleanup:
+    if (Overlapped.hEvent)
+        WSACloseEvent(Overlapped.hEvent);
+    if (Received)
+        HeapFree(GetProcessHeap(), 0, Received);
+    if (Buffer)
+        VirtualFree(Buffer, 0, MEM_RELEASE);
+    closesocket(Server);
+    closesocket(Client);
+}
+
+static
+DWORD
+WINAPI
+DrainThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET Socket = (SOCKET)Parameter;
+    CHAR Buffer[64 * 1024];
+
+    while (recv(Socket, Buffer, sizeof(Buffer), 0) > 0)
+        ;
+
+    return 0;
+}
+
+static
+ULONGLONG
+ThreadCpuTime(void)
+{
+    FILETIME Creation, Exit, Kernel, User;
+
+    GetThreadTimes(GetCurrentThread(), &Creation, &Exit, &Kernel, &User);
+    return ((ULARGE_INTEGER *)&Kernel)->QuadPart + ((ULARGE_INTEGER *)&User)->QuadPart;
+}
+
+/* CPU time the sending thread needs per GB, with the same bytes per call in
+ * one large buffer (zero-copy) or in small buffers (copied through AFD's
+ * send window, like every send before zero-copy) */
+static
+VOID
+test_send_cpu(
+    _In_ DWORD BufferCount)
+{
+    SOCKET Client, Server;
+    HANDLE Thread;
+    PCHAR Buffer;
+    WSABUF WsaBufs[CPU_SMALL_BUFFERS];
+    DWORD Sent, Total, i;
+    ULONGLONG Start, Cpu;
+    int ret = 0;
+
+    if (!CreateConnectedPair(&Client, &Server))
+    {
+        skip("No connection\n");
+        return;
+    }
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CPU_CALL_SIZE);
+    Thread = CreateThread(NULL, 0, DrainThread, (PVOID)Server, 0, NULL);
+    if (!Buffer || !Thread)
+    {
+        skip("No resources\n");
+        goto Cleanup;
+    }
+
+    memset(Buffer, 0x5A, CPU_CALL_SIZE);
+    for (i = 0; i < BufferCount; i++)
+    {
+        WsaBufs[i].buf = Buffer + i * (CPU_CALL_SIZE / BufferCount);
+        WsaBufs[i].len = CPU_CALL_SIZE / BufferCount;
+    }
+
+    Start = ThreadCpuTime();
+    for (Total = 0; Total < CPU_TRANSFER_SIZE; Total += Sent)
+    {
+        ret = WSASend(Client, WsaBufs, BufferCount, &Sent, 0, NULL, NULL);
+        if (ret != 0 || Sent == 0)
+            break;
+    }
+    Cpu = ThreadCpuTime() - Start;
+
+    ok(ret == 0, "WSASend failed with %d\n", WSAGetLastError());
+    ok(Total >= CPU_TRANSFER_SIZE, "Sent %lu bytes\n", Total);
+    trace("%lu x %lu byte buffers per call: %I64u ms of sender CPU per GB\n",
+          BufferCount, CPU_CALL_SIZE / BufferCount,
+          Total ? Cpu / 10000 * 1024 * 1024 * 1024 / Total : 0);
+
+    shutdown(Client, SD_SEND);
+    WaitForSingleObject(Thread, INFINITE);
+
+Cleanup:
+    if (Thread)
+        CloseHandle(Thread);
+    if (Buffer)
+        HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(Server);
+    closesocket(Client);
+}
+
 START_TEST(send)
 {
     int ret;
@@ -176,5 +397,8 @@ START_TEST(send)
     ok(ret == 0, "WSAStartup failed with %d\n", ret);
     test_send();
     test_sendto();
+    test_send_cancel();
+    test_send_cpu(1);
+    test_send_cpu(CPU_SMALL_BUFFERS);
     WSACleanup();
 }
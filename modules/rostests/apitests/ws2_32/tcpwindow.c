@@ -0,0 +1,288 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     TCP window scaling and bulk throughput with large socket buffers
+ *
+ * Without window scaling a receiver cannot offer more than 64 KB of window,
+ * so a peer that stops reading lets the sender queue only that much plus
+ * what the buffers on both ends hold. With a 1 MB SO_RCVBUF far more than
+ * that must be in flight. Then a bulk transfer over loopback is timed with
+ * large and with small socket buffers.
+ */
+
+#include "ws2_32.h"
+
+#define LARGE_BUFFER        (1024 * 1024)
+#define SMALL_BUFFER        (8 * 1024)
+#define CHUNK_SIZE          (64 * 1024)
+#define TRANSFER_SIZE       (64 * 1024 * 1024)
+#define MAX_QUEUED          (4 * 1024 * 1024)
+
+/*
+ * 64 KB of unscaled window, at most 128 KB in the send buffer of the
+ * transport, and the AFD buffers of both sockets, with room to spare
+ */
+#define MAX_UNSCALED_QUEUED (512 * 1024)
+
+typedef struct _TRANSFER_CONTEXT
+{
+    SOCKET Socket;
+    ULONG Sent;
+    int Error;
+} TRANSFER_CONTEXT, *PTRANSFER_CONTEXT;
+
+static
+UCHAR
+Pattern(
+    _In_ ULONG Offset)
+{
+    return (UCHAR)(Offset % 251);
+}
+
+static
+BOOLEAN
+SetBuffers(
+    _In_ SOCKET Socket,
+    _In_ int BufferSize)
+{
+    return setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (PCHAR)&BufferSize, sizeof(BufferSize)) == 0 &&
+           setsockopt(Socket, SOL_SOCKET, SO_SNDBUF, (PCHAR)&BufferSize, sizeof(BufferSize)) == 0;
+}
+
+static
+BOOLEAN
+CreateConnection(
+    _In_ int BufferSize,
+    _Out_ SOCKET *Client,
+    _Out_ SOCKET *Server)
+{
+    struct sockaddr_in Address;
+    int AddressLength = sizeof(Address);
+    SOCKET Listener;
+
+    *Client = *Server = INVALID_SOCKET;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Listener != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Listener == INVALID_SOCKET)
+        return FALSE;
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    /* The buffers are set before listen() and connect(), so the window scale is announced in the SYNs */
+    ok(SetBuffers(Listener, BufferSize), "Setting the listener buffers failed with %d\n", WSAGetLastError());
+    if (bind(Listener, (struct sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR ||
+        getsockname(Listener, (struct sockaddr *)&Address, &AddressLength) == SOCKET_ERROR ||
+        listen(Listener, 1) == SOCKET_ERROR)
+    {
+        ok(0, "Listening failed with %d\n", WSAGetLastError());
+        goto Cleanup;
+    }
+
+    *Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(*Client != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (*Client == INVALID_SOCKET)
+        goto Cleanup;
+
+    ok(SetBuffers(*Client, BufferSize), "Setting the client buffers failed with %d\n", WSAGetLastError());
+    if (connect(*Client, (struct sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR)
+    {
+        ok(0, "connect failed with %d\n", WSAGetLastError());
+        goto Cleanup;
+    }
+
+    *Server = accept(Listener, NULL, NULL);
+    ok(*Server != INVALID_SOCKET, "accept failed with %d\n", WSAGetLastError());
+
+Cleanup:
+    closesocket(Listener);
+
+    if (*Server == INVALID_SOCKET && *Client != INVALID_SOCKET)
+    {
+        closesocket(*Client);
+        *Client = INVALID_SOCKET;
+    }
+
+    return *Server != INVALID_SOCKET;
+}
+
+static
+void
+TestWindowScale(void)
+{
+    SOCKET Client, Server;
+    CHAR Buffer[CHUNK_SIZE];
+    ULONG Queued = 0, Idle = 0;
+    ULONG NonBlocking = 1;
+    int Result, Error;
+
+    if (!CreateConnection(LARGE_BUFFER, &Client, &Server))
+    {
+        skip("No connection\n");
+        return;
+    }
+
+    /* Fill everything between the sender and the receiver, which doesn't read */
+    memset(Buffer, 0x55, sizeof(Buffer));
+    ioctlsocket(Client, FIONBIO, &NonBlocking);
+    while (Queued < MAX_QUEUED && Idle < 5)
+    {
+        Result = send(Client, Buffer, sizeof(Buffer), 0);
+        if (Result > 0)
+        {
+            Queued += Result;
+            Idle = 0;
+        }
+        else
+        {
+            Error = WSAGetLastError();
+            ok(Error == WSAEWOULDBLOCK, "send failed with %d\n", Error);
+            if (Error != WSAEWOULDBLOCK)
+                break;
+
+            /* Let the data drain into the receive window */
+            Sleep(100);
+            Idle++;
+        }
+    }
+
+    ok(Queued > MAX_UNSCALED_QUEUED, "Only %lu bytes were queued, the window is not scaled\n", Queued);
+    trace("%lu bytes queued to a peer with a %u byte receive buffer\n", Queued, LARGE_BUFFER);
+
+    closesocket(Client);
+    closesocket(Server);
+}
+
+static
+DWORD
+WINAPI
+SendThread(
+    _In_ PVOID Parameter)
+{
+    PTRANSFER_CONTEXT Context = Parameter;
+    PUCHAR Buffer;
+    ULONG Length, i;
+    int Result;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+    {
+        Context->Error = ERROR_NOT_ENOUGH_MEMORY;
+        return 0;
+    }
+
+    while (Context->Sent < TRANSFER_SIZE)
+    {
+        Length = min(CHUNK_SIZE, TRANSFER_SIZE - Context->Sent);
+        for (i = 0; i < Length; i++)
+            Buffer[i] = Pattern(Context->Sent + i);
+
+        Result = send(Context->Socket, (PCHAR)Buffer, Length, 0);
+        if (Result <= 0)
+        {
+            Context->Error = WSAGetLastError();
+            break;
+        }
+
+        /* A partial send goes on with the pattern where it stopped */
+        Context->Sent += Result;
+    }
+
+    shutdown(Context->Socket, SD_SEND);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+
+    return 0;
+}
+
+static
+double
+TimeTransfer(
+    _In_ int BufferSize)
+{
+    TRANSFER_CONTEXT Context = { INVALID_SOCKET };
+    LARGE_INTEGER Frequency, Start, End;
+    SOCKET Server;
+    HANDLE Thread;
+    PUCHAR Buffer;
+    ULONG Received = 0, Errors = 0, i;
+    double Rate = 0;
+    int Result;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        return 0;
+    }
+
+    if (!CreateConnection(BufferSize, &Context.Socket, &Server))
+    {
+        skip("No connection\n");
+        HeapFree(GetProcessHeap(), 0, Buffer);
+        return 0;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    Thread = CreateThread(NULL, 0, SendThread, &Context, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        goto Cleanup;
+
+    for (;;)
+    {
+        Result = recv(Server, (PCHAR)Buffer, CHUNK_SIZE, 0);
+        if (Result <= 0)
+        {
+            ok(Result == 0, "recv failed with %d\n", WSAGetLastError());
+            break;
+        }
+
+        for (i = 0; i < (ULONG)Result; i++)
+        {
+            if (Buffer[i] != Pattern(Received + i))
+                Errors++;
+        }
+        Received += Result;
+    }
+
+    QueryPerformanceCounter(&End);
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+
+    ok(Context.Error == 0, "send failed with %d\n", Context.Error);
+    ok(Received == TRANSFER_SIZE, "Received %lu of %u bytes\n", Received, TRANSFER_SIZE);
+    ok(Errors == 0, "%lu bytes were received wrong\n", Errors);
+
+    /* Megabits per second */
+    Rate = (double)Received * 8 * Frequency.QuadPart / (End.QuadPart - Start.QuadPart) / 1e6;
+    trace("%u MB with %d byte socket buffers: %.1f Mbit/s\n", TRANSFER_SIZE >> 20, BufferSize, Rate);
+
+Cleanup:
+    closesocket(Context.Socket);
+    closesocket(Server);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+
+    return Rate;
+}
+
+START_TEST(tcpwindow)
+{
+    WSADATA WsaData;
+    double LargeRate, SmallRate;
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+
+    TestWindowScale();
+
+    /* A window of a few segments takes a round trip through the stack for each of them */
+    LargeRate = TimeTransfer(LARGE_BUFFER);
+    SmallRate = TimeTransfer(SMALL_BUFFER);
+    ok(LargeRate > SmallRate, "%.1f Mbit/s with large buffers, %.1f Mbit/s with small ones\n",
+       LargeRate, SmallRate);
+
+    WSACleanup();
+}
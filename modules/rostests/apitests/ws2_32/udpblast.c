@@ -0,0 +1,296 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Packets per second of small UDP datagrams
+ *
+ * By default the datagrams go to 127.0.0.1, which only measures the stack.
+ * To measure a network card, run the test on both ends of the link:
+ *   set UDPBLAST_LISTEN=9000           on the receiving machine
+ *   set UDPBLAST_TARGET=10.0.2.15:9000 on the sending machine
+ * Any other UDP sender or receiver works for the other end as well.
+ */
+
+#include "ws2_32.h"
+
+#define DATAGRAM_SIZE   64
+#define DURATION        3000    /* Milliseconds */
+#define LISTEN_TIMEOUT  60000   /* Milliseconds to wait for the first datagram */
+#define SETTING_LENGTH  64
+
+typedef struct _BLAST_CONTEXT
+{
+    SOCKET Socket;
+    struct sockaddr_in Target;
+    volatile LONG Stop;
+    ULONG Sent;
+    ULONG Failed;
+    ULONGLONG Elapsed;
+} BLAST_CONTEXT, *PBLAST_CONTEXT;
+
+static
+ULONGLONG
+ElapsedMicroseconds(
+    _In_ PLARGE_INTEGER Start)
+{
+    LARGE_INTEGER Frequency, End;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+
+    return (End.QuadPart - Start->QuadPart) * 1000000 / Frequency.QuadPart;
+}
+
+static
+ULONGLONG
+PacketsPerSecond(
+    _In_ ULONG Packets,
+    _In_ ULONGLONG Elapsed)
+{
+    return Elapsed ? (ULONGLONG)Packets * 1000000 / Elapsed : 0;
+}
+
+static
+SOCKET
+CreateReceiveSocket(
+    _In_ ULONG Address,
+    _In_ USHORT Port,
+    _Out_ struct sockaddr_in *BoundAddress)
+{
+    SOCKET Socket;
+    int AddressLength = sizeof(*BoundAddress);
+    int BufferSize = 1024 * 1024;
+
+    Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (Socket == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    memset(BoundAddress, 0, sizeof(*BoundAddress));
+    BoundAddress->sin_family = AF_INET;
+    BoundAddress->sin_addr.s_addr = Address;
+    BoundAddress->sin_port = htons(Port);
+
+    /* Give bursts some room, the result only counts what gets through */
+    setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (PCHAR)&BufferSize, sizeof(BufferSize));
+
+    if (bind(Socket, (struct sockaddr *)BoundAddress, sizeof(*BoundAddress)) == SOCKET_ERROR ||
+        getsockname(Socket, (struct sockaddr *)BoundAddress, &AddressLength) == SOCKET_ERROR)
+    {
+        closesocket(Socket);
+        return INVALID_SOCKET;
+    }
+
+    return Socket;
+}
+
+static
+DWORD
+WINAPI
+BlastThread(
+    _In_ PVOID Parameter)
+{
+    PBLAST_CONTEXT Context = Parameter;
+    CHAR Buffer[DATAGRAM_SIZE];
+    LARGE_INTEGER Start;
+    int Result;
+
+    memset(Buffer, 0x55, sizeof(Buffer));
+    QueryPerformanceCounter(&Start);
+
+    while (!Context->Stop)
+    {
+        Result = sendto(Context->Socket, Buffer, sizeof(Buffer), 0,
+                        (struct sockaddr *)&Context->Target, sizeof(Context->Target));
+        if (Result == sizeof(Buffer))
+            Context->Sent++;
+        else
+            Context->Failed++;
+    }
+
+    Context->Elapsed = ElapsedMicroseconds(&Start);
+
+    return 0;
+}
+
+static
+ULONG
+ReceiveDatagrams(
+    _In_ SOCKET Socket,
+    _In_ DWORD Timeout,
+    _Out_ PULONGLONG Elapsed)
+{
+    CHAR Buffer[DATAGRAM_SIZE * 2];
+    LARGE_INTEGER Start;
+    ULONG Received = 0;
+    DWORD ReceiveTimeout;
+
+    /* Wait for the first datagram, then count for the test duration */
+    ReceiveTimeout = Timeout;
+    setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO, (PCHAR)&ReceiveTimeout, sizeof(ReceiveTimeout));
+    if (recv(Socket, Buffer, sizeof(Buffer), 0) <= 0)
+    {
+        *Elapsed = 0;
+        return 0;
+    }
+
+    ReceiveTimeout = 500;
+    setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO, (PCHAR)&ReceiveTimeout, sizeof(ReceiveTimeout));
+    QueryPerformanceCounter(&Start);
+
+    do
+    {
+        if (recv(Socket, Buffer, sizeof(Buffer), 0) <= 0)
+            break;
+        Received++;
+    } while (ElapsedMicroseconds(&Start) < DURATION * 1000);
+
+    *Elapsed = ElapsedMicroseconds(&Start);
+
+    return Received;
+}
+
+static
+BOOLEAN
+GetSetting(
+    _In_ PCSTR Name,
+    _Out_writes_(SETTING_LENGTH) PSTR Value)
+{
+    DWORD Length;
+
+    Length = GetEnvironmentVariableA(Name, Value, SETTING_LENGTH);
+    return Length != 0 && Length < SETTING_LENGTH;
+}
+
+static
+void
+TestLoopbackRate(void)
+{
+    BLAST_CONTEXT Context = { INVALID_SOCKET };
+    struct sockaddr_in Address;
+    SOCKET Server;
+    HANDLE Thread;
+    ULONGLONG Elapsed;
+    ULONG Received;
+
+    Server = CreateReceiveSocket(inet_addr("127.0.0.1"), 0, &Address);
+    ok(Server != INVALID_SOCKET, "CreateReceiveSocket failed with %d\n", WSAGetLastError());
+    Context.Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ok(Context.Socket != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Server == INVALID_SOCKET || Context.Socket == INVALID_SOCKET)
+    {
+        skip("No sockets\n");
+        goto Cleanup;
+    }
+
+    Context.Target = Address;
+
+    Thread = CreateThread(NULL, 0, BlastThread, &Context, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        goto Cleanup;
+
+    Received = ReceiveDatagrams(Server, 5000, &Elapsed);
+
+    InterlockedExchange(&Context.Stop, TRUE);
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+
+    ok(Context.Sent != 0, "Nothing was sent, %lu sends failed\n", Context.Failed);
+    ok(Received != 0, "Nothing was received\n");
+    ok(Received <= Context.Sent, "Received %lu of %lu datagrams\n", Received, Context.Sent);
+    trace("Loopback: sent %lu datagrams (%lu failed), %I64u per second; received %lu, %I64u per second\n",
+          Context.Sent, Context.Failed, PacketsPerSecond(Context.Sent, Context.Elapsed),
+          Received, PacketsPerSecond(Received, Elapsed));
+
+Cleanup:
+    if (Context.Socket != INVALID_SOCKET)
+        closesocket(Context.Socket);
+    if (Server != INVALID_SOCKET)
+        closesocket(Server);
+}
+
+static
+void
+TestSendRate(
+    _In_ PCSTR Target)
+{
+    BLAST_CONTEXT Context = { INVALID_SOCKET };
+    CHAR Address[SETTING_LENGTH];
+    PCHAR Port;
+    HANDLE Thread;
+
+    /* address:port */
+    strcpy(Address, Target);
+    Port = strchr(Address, ':');
+    if (!Port)
+    {
+        skip("UDPBLAST_TARGET must be address:port\n");
+        return;
+    }
+    *Port++ = ANSI_NULL;
+
+    Context.Target.sin_family = AF_INET;
+    Context.Target.sin_addr.s_addr = inet_addr(Address);
+    Context.Target.sin_port = htons((USHORT)atoi(Port));
+
+    Context.Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ok(Context.Socket != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Context.Socket == INVALID_SOCKET)
+        return;
+
+    Thread = CreateThread(NULL, 0, BlastThread, &Context, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (Thread)
+    {
+        Sleep(DURATION);
+        InterlockedExchange(&Context.Stop, TRUE);
+        WaitForSingleObject(Thread, INFINITE);
+        CloseHandle(Thread);
+
+        ok(Context.Sent != 0, "Nothing was sent, %lu sends failed\n", Context.Failed);
+        trace("Sent %lu datagrams to %s (%lu failed), %I64u per second\n",
+              Context.Sent, Target, Context.Failed, PacketsPerSecond(Context.Sent, Context.Elapsed));
+    }
+
+    closesocket(Context.Socket);
+}
+
+static
+void
+TestReceiveRate(
+    _In_ PCSTR Port)
+{
+    struct sockaddr_in Address;
+    SOCKET Server;
+    ULONGLONG Elapsed;
+    ULONG Received;
+
+    Server = CreateReceiveSocket(INADDR_ANY, (USHORT)atoi(Port), &Address);
+    ok(Server != INVALID_SOCKET, "CreateReceiveSocket failed with %d\n", WSAGetLastError());
+    if (Server == INVALID_SOCKET)
+        return;
+
+    trace("Waiting for datagrams on port %u\n", ntohs(Address.sin_port));
+    Received = ReceiveDatagrams(Server, LISTEN_TIMEOUT, &Elapsed);
+
+    ok(Received != 0, "Nothing was received\n");
+    trace("Received %lu datagrams, %I64u per second\n", Received, PacketsPerSecond(Received, Elapsed));
+
+    closesocket(Server);
+}
+
+START_TEST(udpblast)
+{
+    WSADATA WsaData;
+    CHAR Setting[SETTING_LENGTH];
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+
+    if (GetSetting("UDPBLAST_LISTEN", Setting))
+        TestReceiveRate(Setting);
+    else if (GetSetting("UDPBLAST_TARGET", Setting))
+        TestSendRate(Setting);
+    else
+        TestLoopbackRate();
+
+    WSACleanup();
+}
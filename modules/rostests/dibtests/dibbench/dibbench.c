@@ -0,0 +1,320 @@
+/*
+ * PROJECT:     ReactOS DIB tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Checks and times the win32k DIB row kernels on synthetic surfaces
+ *
+ * The kernels are compiled straight into this program, so it runs on any
+ * x86 or x64 Windows, or on ReactOS itself. It is built with the rostests,
+ * or outside of the tree with:
+ *   cl /O2 dibbench.c
+ *   gcc -O2 -o dibbench.exe dibbench.c
+ */
+
+#include <windows.h>
+#include <winddi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIBROW_STANDALONE
+#include "../../../../win32ss/gdi/dib/dibrow.c"
+#ifdef DIB_ROW_SSE2
+#include "../../../../win32ss/gdi/dib/dibrow_sse2.c"
+#endif
+
+#define SURFACE_WIDTH   1021    /* Odd on purpose, the kernels must handle the row tails */
+#define SURFACE_HEIGHT  768
+#define ITERATIONS      50
+#define MAX_TAPS        8
+
+typedef enum _KERNEL
+{
+    Blend32,
+    Blend16,
+    Transparent32,
+    Transparent16,
+    Fill32,
+    Fill16,
+    SwapRedBlue32,
+    Pack32to16,
+    FilterX,
+    FilterY
+} KERNEL;
+
+typedef struct _TEST
+{
+    PCSTR Name;
+    KERNEL Kernel;
+    ULONG DstFormat;
+    UCHAR ConstAlpha;
+    BOOLEAN SrcAlpha;   /* Or SrcRgb for Pack32to16 */
+    BOOLEAN Is555;
+    ULONG Taps;
+} TEST;
+
+static const TEST Tests[] =
+{
+    { "blend32 constant alpha",  Blend32,       BMF_32BPP, 128, FALSE, FALSE },
+    { "blend32 pixel alpha",     Blend32,       BMF_32BPP, 255, TRUE,  FALSE },
+    { "blend32 both alphas",     Blend32,       BMF_32BPP, 200, TRUE,  FALSE },
+    { "blend565 constant alpha", Blend16,       BMF_16BPP, 128, FALSE, FALSE },
+    { "blend565 pixel alpha",    Blend16,       BMF_16BPP, 255, TRUE,  FALSE },
+    { "blend555 both alphas",    Blend16,       BMF_16BPP, 200, TRUE,  TRUE  },
+    { "transparent32",           Transparent32, BMF_32BPP, 0,   FALSE, FALSE },
+    { "transparent16",           Transparent16, BMF_16BPP, 0,   FALSE, FALSE },
+    { "fill32",                  Fill32,        BMF_32BPP, 0,   FALSE, FALSE },
+    { "fill16",                  Fill16,        BMF_16BPP, 0,   FALSE, FALSE },
+    { "swap red and blue",       SwapRedBlue32, BMF_32BPP, 0,   FALSE, FALSE },
+    { "pack BGR to 565",         Pack32to16,    BMF_16BPP, 0,   FALSE, FALSE },
+    { "pack RGB to 555",         Pack32to16,    BMF_16BPP, 0,   TRUE,  TRUE  },
+    { "filter x bilinear",       FilterX,       BMF_32BPP, 0,   FALSE, FALSE, 2 },
+    { "filter x box 5 taps",     FilterX,       BMF_32BPP, 0,   FALSE, FALSE, 5 },
+    { "filter y bilinear",       FilterY,       BMF_32BPP, 0,   FALSE, FALSE, 2 },
+    { "filter y box 5 taps",     FilterY,       BMF_32BPP, 0,   FALSE, FALSE, 5 },
+};
+
+/* Filter taps for the stretch kernels, each pixel or row gets its own weights */
+static ULONG FilterFirst[SURFACE_WIDTH];
+static SHORT FilterWeights[SURFACE_WIDTH * MAX_TAPS];
+
+static ULONG Seed = 0x12345678;
+
+static
+ULONG
+Random(VOID)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 16) | (Seed << 16);
+}
+
+static
+VOID
+CreateSurface(
+    _Out_ SURFOBJ *Surface,
+    _In_ ULONG Format)
+{
+    ULONG Bpp = (Format == BMF_32BPP) ? 4 : 2;
+
+    ZeroMemory(Surface, sizeof(*Surface));
+    Surface->iBitmapFormat = Format;
+    Surface->sizlBitmap.cx = SURFACE_WIDTH;
+    Surface->sizlBitmap.cy = SURFACE_HEIGHT;
+    /* Rows start 4 bytes past a 16 byte boundary to exercise unaligned access */
+    Surface->lDelta = ((SURFACE_WIDTH * Bpp + 15) & ~15) + 4;
+    Surface->cjBits = Surface->lDelta * SURFACE_HEIGHT;
+    Surface->pvBits = malloc(Surface->cjBits + 16);
+    Surface->pvScan0 = (PBYTE)Surface->pvBits + 4;
+}
+
+static
+VOID
+RandomizeSurface(
+    _Inout_ SURFOBJ *Surface,
+    _In_ ULONG TransColor)
+{
+    PBYTE Bits = Surface->pvBits;
+    ULONG i;
+
+    for (i = 0; i < Surface->cjBits + 16; i++)
+        Bits[i] = (UCHAR)Random();
+
+    /* Make sure the color key shows up often, in runs and alone */
+    for (i = 0; i + 4 <= Surface->cjBits; i += 4)
+    {
+        if ((Random() & 3) == 0)
+        {
+            if (Surface->iBitmapFormat == BMF_32BPP)
+                *(PULONG)((PBYTE)Surface->pvScan0 + i) = TransColor | (Random() & 0xFF000000);
+            else
+                *(PUSHORT)((PBYTE)Surface->pvScan0 + i) = (USHORT)TransColor;
+        }
+    }
+}
+
+static
+VOID
+InitFilter(
+    _In_ ULONG Taps)
+{
+    ULONG i, k, Left;
+
+    for (i = 0; i < SURFACE_WIDTH; i++)
+    {
+        /* Half as many outputs as inputs, like a downscale */
+        FilterFirst[i] = min(i * 2, SURFACE_WIDTH - Taps);
+
+        Left = 1 << DIB_FILTER_WEIGHT_BITS;
+        for (k = 0; k < Taps - 1; k++)
+        {
+            FilterWeights[i * Taps + k] = (SHORT)(Random() % (Left + 1));
+            Left -= FilterWeights[i * Taps + k];
+        }
+        FilterWeights[i * Taps + k] = (SHORT)Left;
+    }
+}
+
+static
+VOID
+RunTest(
+    _In_ const TEST *Test,
+    _In_ const DIB_ROW_FUNCTIONS *Functions,
+    _Inout_ SURFOBJ *Dst,
+    _In_ SURFOBJ *Src,
+    _In_ ULONG TransColor)
+{
+    PBYTE DstRow = Dst->pvScan0;
+    PBYTE SrcRow = Src->pvScan0;
+    const SHORT *Rows[MAX_TAPS];
+    ULONG k;
+    LONG y;
+
+    for (y = 0; y < Dst->sizlBitmap.cy; y++)
+    {
+        switch (Test->Kernel)
+        {
+            case Blend32:
+                Functions->Blend32((PULONG)DstRow, (PULONG)SrcRow, Dst->sizlBitmap.cx,
+                                   Test->ConstAlpha, Test->SrcAlpha);
+                break;
+            case Blend16:
+                Functions->Blend16((PUSHORT)DstRow, (PULONG)SrcRow, Dst->sizlBitmap.cx,
+                                   Test->ConstAlpha, Test->SrcAlpha, Test->Is555);
+                break;
+            case Transparent32:
+                Functions->Transparent32((PULONG)DstRow, (PULONG)SrcRow, Dst->sizlBitmap.cx,
+                                         TransColor);
+                break;
+            case Transparent16:
+                Functions->Transparent16((PUSHORT)DstRow, (PUSHORT)SrcRow, Dst->sizlBitmap.cx,
+                                         TransColor);
+                break;
+            case Fill32:
+                Functions->Fill32((PULONG)DstRow, Dst->sizlBitmap.cx, TransColor);
+                break;
+            case Fill16:
+                Functions->Fill16((PUSHORT)DstRow, Dst->sizlBitmap.cx, (USHORT)TransColor);
+                break;
+            case SwapRedBlue32:
+                Functions->SwapRedBlue32((PULONG)DstRow, (PULONG)SrcRow, Dst->sizlBitmap.cx);
+                break;
+            case Pack32to16:
+                Functions->Pack32to16((PUSHORT)DstRow, (PULONG)SrcRow, Dst->sizlBitmap.cx,
+                                      Test->SrcAlpha, Test->Is555);
+                break;
+            case FilterX:
+                /* Four channels of 16 bits fill a row with half as many pixels */
+                Functions->FilterX((PSHORT)DstRow, (PULONG)SrcRow, FilterFirst, FilterWeights,
+                                   Test->Taps, Dst->sizlBitmap.cx / 2);
+                break;
+            case FilterY:
+                for (k = 0; k < Test->Taps; k++)
+                {
+                    Rows[k] = (const SHORT *)((PBYTE)Src->pvScan0 +
+                                              ((y + k) % Src->sizlBitmap.cy) * Src->lDelta);
+                }
+                Functions->FilterY((PULONG)DstRow, Rows, FilterWeights + y * Test->Taps,
+                                   Test->Taps, Dst->sizlBitmap.cx / 2);
+                break;
+        }
+
+        DstRow += Dst->lDelta;
+        SrcRow += Src->lDelta;
+    }
+}
+
+static
+double
+TimeTest(
+    _In_ const TEST *Test,
+    _In_ const DIB_ROW_FUNCTIONS *Functions,
+    _Inout_ SURFOBJ *Dst,
+    _In_ SURFOBJ *Src,
+    _In_ ULONG TransColor)
+{
+    LARGE_INTEGER Start, End, Frequency;
+    ULONG i;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < ITERATIONS; i++)
+        RunTest(Test, Functions, Dst, Src, TransColor);
+
+    QueryPerformanceCounter(&End);
+
+    /* Megapixels per second */
+    return (double)SURFACE_WIDTH * SURFACE_HEIGHT * ITERATIONS * Frequency.QuadPart /
+           ((double)(End.QuadPart - Start.QuadPart) * 1000000.0);
+}
+
+int main(int argc, char **argv)
+{
+    const DIB_ROW_FUNCTIONS *Fast;
+    SURFOBJ Src32, Src16, Reference, Result;
+    ULONG i, TransColor, Failures = 0;
+    const TEST *Test;
+    SURFOBJ *Src;
+
+    Fast = DIB_SelectRowFunctions(IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE));
+    if (Fast == &DibRowFunctionsPortable)
+        printf("SSE2 is not available, timing the portable kernels only\n");
+
+    CreateSurface(&Src32, BMF_32BPP);
+    CreateSurface(&Src16, BMF_16BPP);
+
+    for (i = 0; i < sizeof(Tests) / sizeof(Tests[0]); i++)
+    {
+        Test = &Tests[i];
+        Src = (Test->DstFormat == BMF_32BPP || Test->Kernel == Blend16 ||
+               Test->Kernel == Pack32to16) ? &Src32 : &Src16;
+        TransColor = (Test->DstFormat == BMF_32BPP) ? 0x00FF00FF : 0xF81F;
+
+        RandomizeSurface(Src, TransColor);
+
+        if (Test->Kernel == FilterX || Test->Kernel == FilterY)
+        {
+            InitFilter(Test->Taps);
+
+            /* The vertical pass takes channels of the horizontal one, at most 255 << 7 */
+            if (Test->Kernel == FilterY)
+            {
+                PUSHORT Channel = Src->pvBits;
+                ULONG j;
+
+                for (j = 0; j < Src->cjBits / sizeof(USHORT); j++)
+                    Channel[j] %= (255 << DIB_FILTER_CHANNEL_BITS) + 1;
+            }
+        }
+        CreateSurface(&Reference, Test->DstFormat);
+        CreateSurface(&Result, Test->DstFormat);
+        RandomizeSurface(&Reference, TransColor);
+        memcpy(Result.pvBits, Reference.pvBits, Reference.cjBits + 16);
+
+        /* Both kernels must leave exactly the same bits, padding included */
+        RunTest(Test, &DibRowFunctionsPortable, &Reference, Src, TransColor);
+        RunTest(Test, Fast, &Result, Src, TransColor);
+
+        if (memcmp(Reference.pvBits, Result.pvBits, Reference.cjBits + 16))
+        {
+            printf("%-24s MISMATCH\n", Test->Name);
+            Failures++;
+        }
+        else
+        {
+            printf("%-24s portable %8.1f Mpix/s, selected %8.1f Mpix/s\n",
+                   Test->Name,
+                   TimeTest(Test, &DibRowFunctionsPortable, &Reference, Src, TransColor),
+                   TimeTest(Test, Fast, &Result, Src, TransColor));
+        }
+
+        free(Reference.pvBits);
+        free(Result.pvBits);
+    }
+
+    free(Src32.pvBits);
+    free(Src16.pvBits);
+
+    printf("%lu of %lu kernels mismatched\n", Failures, (ULONG)(sizeof(Tests) / sizeof(Tests[0])));
+
+    return Failures ? 1 : 0;
+}
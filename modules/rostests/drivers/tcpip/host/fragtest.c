@@ -0,0 +1,450 @@
+/*
+ * PROJECT:     ReactOS TCP/IP driver tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Checks the IPv4 fragment reassembly of the driver
+ *
+ * The receive path of the driver is compiled straight into this program,
+ * with the host headers, so it runs on any host:
+ *   gcc -O2 -I. -I../../../../../sdk/include/host -I../../../../../drivers/network/tcpip/include
+ *       -o fragtest fragtest.c ../../../../../drivers/network/tcpip/ip/network/receive.c
+ *       ../../../../../drivers/network/tcpip/ip/network/checksum.c
+ *
+ * Fragments with valid headers are fed to IPReceive the way the link layer
+ * does. Every byte of a datagram depends on its offset, so a datagram that
+ * is handed to the protocols must be exactly the one that was sent. After
+ * each test no NDIS packet may be left behind.
+ */
+
+#include "precomp.h"
+
+#define SOURCE_ADDRESS      0x0A000001
+#define DESTINATION_ADDRESS 0x0A000002
+#define FRAGMENT_SIZE       1480
+#define LARGE_DATAGRAM_SIZE 60000
+
+#define PIECES(DatagramSize) (((DatagramSize) + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE)
+
+typedef struct _TEST_PACKET
+{
+    NDIS_PACKET Packet;
+    UINT Size;
+    UCHAR Data[1];
+} TEST_PACKET, *PTEST_PACKET;
+
+static IP_INTERFACE Interface;
+static ULONG PacketsAllocated;
+static ULONG PacketsFreed;
+static ULONG Delivered;
+static USHORT DeliveredId;
+static UINT DeliveredSize;
+static ULONG DataErrors;
+static ULONG Failures;
+
+ULONG IpTimerExpirations;
+
+BOOLEAN AddrIsEqual(PIP_ADDRESS Address1, PIP_ADDRESS Address2)
+{
+    return Address1->Type == Address2->Type &&
+           Address1->Address.IPv4Address == Address2->Address.IPv4Address;
+}
+
+UINT CopyPacketToBuffer(PCHAR DstData, PNDIS_PACKET SrcPacket, UINT SrcOffset, UINT Length)
+{
+    PTEST_PACKET Packet = CONTAINING_RECORD(SrcPacket, TEST_PACKET, Packet);
+
+    if (SrcOffset >= Packet->Size)
+        return 0;
+
+    Length = min(Length, Packet->Size - SrcOffset);
+    RtlCopyMemory(DstData, &Packet->Data[SrcOffset], Length);
+
+    return Length;
+}
+
+VOID FreeNdisPacket(PNDIS_PACKET Packet)
+{
+    PacketsFreed++;
+    free(CONTAINING_RECORD(Packet, TEST_PACKET, Packet));
+}
+
+VOID NdisReturnPackets(PNDIS_PACKET *PacketsToReturn, UINT NumberOfPackets)
+{
+    UINT i;
+
+    for (i = 0; i < NumberOfPackets; i++)
+        FreeNdisPacket(PacketsToReturn[i]);
+}
+
+static VOID FreePacket(PVOID Object)
+{
+    PIP_PACKET IPPacket = Object;
+
+    /* What DeinitializePacket does */
+    if (IPPacket->NdisPacket)
+        FreeNdisPacket(IPPacket->NdisPacket);
+
+    if (!IPPacket->MappedHeader && IPPacket->Header)
+        ExFreePoolWithTag(IPPacket->Header, PACKET_BUFFER_TAG);
+}
+
+PIP_PACKET IPInitializePacket(PIP_PACKET IPPacket, ULONG Type)
+{
+    RtlZeroMemory(IPPacket, sizeof(IP_PACKET));
+
+    IPPacket->Free = FreePacket;
+    IPPacket->Type = Type;
+
+    return IPPacket;
+}
+
+static UCHAR
+Pattern(USHORT Id, UINT Offset)
+{
+    return (UCHAR)(Id * 31 + Offset + (Offset >> 8));
+}
+
+VOID IPDispatchProtocol(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
+{
+    PIPv4_HEADER Header = IPPacket->Header;
+    PUCHAR Data = IPPacket->Data;
+    UINT i;
+
+    Delivered++;
+    DeliveredId = WN2H(Header->Id);
+    DeliveredSize = IPPacket->TotalSize - IPPacket->HeaderSize;
+
+    for (i = 0; i < DeliveredSize; i++)
+    {
+        if (Data[i] != Pattern(DeliveredId, i))
+        {
+            DataErrors++;
+            break;
+        }
+    }
+}
+
+static VOID
+ReceiveFragment(USHORT Id, UINT Offset, UINT Size, BOOLEAN MoreFragments)
+{
+    PTEST_PACKET Packet;
+    PIPv4_HEADER Header;
+    IP_PACKET IPPacket;
+    UINT i;
+
+    Packet = malloc(sizeof(TEST_PACKET) + sizeof(IPv4_HEADER) + Size);
+    if (!Packet)
+        exit(2);
+    PacketsAllocated++;
+
+    Packet->Size = sizeof(IPv4_HEADER) + Size;
+    Header = (PIPv4_HEADER)Packet->Data;
+    RtlZeroMemory(Header, sizeof(IPv4_HEADER));
+    Header->VerIHL = 0x45;
+    Header->TotalLength = WH2N(sizeof(IPv4_HEADER) + Size);
+    Header->Id = WH2N(Id);
+    Header->FlagsFragOfs = WH2N((Offset >> 3) | (MoreFragments ? IPv4_MF_MASK : 0));
+    Header->Ttl = 64;
+    Header->Protocol = IPPROTO_UDP;
+    Header->SrcAddr = DH2N(SOURCE_ADDRESS);
+    Header->DstAddr = DH2N(DESTINATION_ADDRESS);
+    Header->Checksum = (USHORT)IPv4Checksum(Header, sizeof(IPv4_HEADER), 0);
+
+    for (i = 0; i < Size; i++)
+        Packet->Data[sizeof(IPv4_HEADER) + i] = Pattern(Id, Offset + i);
+
+    /* What the link layer does, IPReceive takes care of the NDIS packet */
+    IPInitializePacket(&IPPacket, 0);
+    IPPacket.NdisPacket = &Packet->Packet;
+    IPReceive(&Interface, &IPPacket);
+}
+
+static VOID
+ReceivePiece(USHORT Id, UINT DatagramSize, UINT Index)
+{
+    UINT Offset = Index * FRAGMENT_SIZE;
+
+    ReceiveFragment(Id, Offset, min(FRAGMENT_SIZE, DatagramSize - Offset),
+                    Offset + FRAGMENT_SIZE < DatagramSize);
+}
+
+static VOID
+Check(BOOLEAN Condition, PCSTR Test, PCSTR What)
+{
+    if (!Condition)
+    {
+        printf("%s: %s\n", Test, What);
+        Failures++;
+    }
+}
+
+static VOID
+StartTest(VOID)
+{
+    Delivered = 0;
+    DeliveredId = 0;
+    DeliveredSize = 0;
+    DataErrors = 0;
+}
+
+static VOID
+EndTest(PCSTR Test, ULONG ExpectedDelivered, USHORT ExpectedId, UINT ExpectedSize)
+{
+    Check(Delivered == ExpectedDelivered, Test, "wrong number of datagrams delivered");
+    if (ExpectedDelivered && Delivered)
+    {
+        Check(DeliveredId == ExpectedId, Test, "wrong datagram delivered");
+        Check(DeliveredSize == ExpectedSize, Test, "wrong datagram size");
+    }
+    Check(DataErrors == 0, Test, "wrong datagram data");
+    Check(IsListEmpty(&ReassemblyListHead), Test, "datagrams left being reassembled");
+
+    IPFreeReassemblyList();
+    Check(PacketsAllocated == PacketsFreed, Test, "NDIS packets leaked");
+}
+
+static VOID
+TestOrders(VOID)
+{
+    UINT i;
+
+    StartTest();
+    ReceiveFragment(1, 0, 1000, FALSE);
+    EndTest("Unfragmented", 1, 1, 1000);
+
+    StartTest();
+    for (i = 0; i < 3; i++)
+        ReceivePiece(2, 4000, i);
+    EndTest("In order", 1, 2, 4000);
+
+    StartTest();
+    ReceivePiece(3, 4000, 2);
+    ReceivePiece(3, 4000, 0);
+    ReceivePiece(3, 4000, 1);
+    EndTest("Out of order", 1, 3, 4000);
+
+    StartTest();
+    for (i = PIECES(65000); i > 0; i--)
+        ReceivePiece(4, 65000, i - 1);
+    EndTest("Reverse order", 1, 4, 65000);
+
+    /* Two datagrams at once */
+    StartTest();
+    ReceivePiece(5, 4000, 0);
+    ReceivePiece(6, 3000, 1);
+    ReceivePiece(5, 4000, 2);
+    ReceivePiece(6, 3000, 0);
+    ReceivePiece(5, 4000, 1);
+    Check(Delivered == 1 && DeliveredId == 5, "Interleaved", "first datagram not delivered");
+    ReceivePiece(6, 3000, 2);
+    EndTest("Interleaved", 2, 6, 3000);
+}
+
+static VOID
+TestDuplicates(VOID)
+{
+    /* Duplicates are dropped on their own, the datagram still completes */
+    StartTest();
+    ReceivePiece(10, 4000, 0);
+    ReceivePiece(10, 4000, 0);
+    ReceivePiece(10, 4000, 2);
+    ReceivePiece(10, 4000, 2);
+    ReceivePiece(10, 4000, 1);
+    EndTest("Duplicate", 1, 10, 4000);
+
+    /* Data within a fragment that is already there */
+    StartTest();
+    ReceivePiece(11, 4000, 1);
+    ReceiveFragment(11, FRAGMENT_SIZE + 8, 16, TRUE);
+    ReceiveFragment(11, FRAGMENT_SIZE, 8, TRUE);
+    ReceivePiece(11, 4000, 0);
+    ReceivePiece(11, 4000, 2);
+    EndTest("Contained duplicate", 1, 11, 4000);
+}
+
+static VOID
+TestOverlaps(VOID)
+{
+    /* Overlapping the end of the fragment before it */
+    StartTest();
+    ReceivePiece(20, 4000, 0);
+    ReceiveFragment(20, FRAGMENT_SIZE - 8, FRAGMENT_SIZE, TRUE);
+    Check(IsListEmpty(&ReassemblyListHead), "Overlap with previous", "datagram not dropped");
+    ReceivePiece(20, 4000, 1);
+    ReceivePiece(20, 4000, 2);
+    IPFreeReassemblyList();
+    EndTest("Overlap with previous", 0, 0, 0);
+
+    /* Overlapping the start of the fragment after it */
+    StartTest();
+    ReceivePiece(21, 4000, 1);
+    ReceiveFragment(21, 0, FRAGMENT_SIZE + 8, TRUE);
+    Check(IsListEmpty(&ReassemblyListHead), "Overlap with next", "datagram not dropped");
+    ReceivePiece(21, 4000, 0);
+    ReceivePiece(21, 4000, 2);
+    IPFreeReassemblyList();
+    EndTest("Overlap with next", 0, 0, 0);
+
+    /* Covering a fragment and more */
+    StartTest();
+    ReceiveFragment(22, 8, 8, TRUE);
+    ReceiveFragment(22, 0, 24, TRUE);
+    Check(IsListEmpty(&ReassemblyListHead), "Covering overlap", "datagram not dropped");
+    EndTest("Covering overlap", 0, 0, 0);
+
+    /* Two last fragments that end in different places */
+    StartTest();
+    ReceivePiece(23, 4000, 2);
+    ReceiveFragment(23, 2 * FRAGMENT_SIZE, 8, FALSE);
+    Check(IsListEmpty(&ReassemblyListHead), "Second end", "datagram not dropped");
+    EndTest("Second end", 0, 0, 0);
+
+    /* Data beyond the last fragment */
+    StartTest();
+    ReceivePiece(24, 4000, 2);
+    ReceiveFragment(24, 4000, 8, TRUE);
+    Check(IsListEmpty(&ReassemblyListHead), "Beyond the end", "datagram not dropped");
+    EndTest("Beyond the end", 0, 0, 0);
+
+    /* A last fragment that ends before data already received */
+    StartTest();
+    ReceivePiece(25, 4000, 1);
+    ReceiveFragment(25, 8, 8, FALSE);
+    Check(IsListEmpty(&ReassemblyListHead), "End before data", "datagram not dropped");
+    EndTest("End before data", 0, 0, 0);
+}
+
+static VOID
+TestFragmentCount(VOID)
+{
+    UINT i;
+
+    StartTest();
+    for (i = 0; i < REASSEMBLY_MAX_FRAGMENTS; i++)
+        ReceiveFragment(30, i * 8, 8, i + 1 < REASSEMBLY_MAX_FRAGMENTS);
+    EndTest("Most fragments", 1, 30, REASSEMBLY_MAX_FRAGMENTS * 8);
+
+    /* One fragment more drops the datagram, in any order */
+    StartTest();
+    for (i = 0; i <= REASSEMBLY_MAX_FRAGMENTS; i++)
+        ReceiveFragment(31, i * 8, 8, i < REASSEMBLY_MAX_FRAGMENTS);
+    EndTest("Too many fragments", 0, 0, 0);
+
+    StartTest();
+    for (i = 0; i <= REASSEMBLY_MAX_FRAGMENTS; i++)
+        ReceiveFragment(32, (REASSEMBLY_MAX_FRAGMENTS - i) * 8, 8, i != 0);
+    EndTest("Too many fragments, reverse order", 0, 0, 0);
+}
+
+static VOID
+ReceiveAllButLast(USHORT Id)
+{
+    UINT i;
+
+    for (i = 0; i + 1 < PIECES(LARGE_DATAGRAM_SIZE); i++)
+        ReceivePiece(Id, LARGE_DATAGRAM_SIZE, i);
+}
+
+static VOID
+ReceiveLast(USHORT Id)
+{
+    ReceivePiece(Id, LARGE_DATAGRAM_SIZE, PIECES(LARGE_DATAGRAM_SIZE) - 1);
+}
+
+static VOID
+TestMemoryLimit(VOID)
+{
+    USHORT Id;
+
+    /* Four incomplete datagrams fit in the 256 KB, the fifth makes room by dropping the oldest */
+    StartTest();
+    for (Id = 40; Id < 45; Id++)
+        ReceiveAllButLast(Id);
+    for (Id = 41; Id < 45; Id++)
+    {
+        ReceiveLast(Id);
+        Check(Delivered == Id - 40u && DeliveredId == Id, "Memory limit", "datagram not delivered");
+    }
+    ReceiveLast(40);
+    Check(Delivered == 4, "Memory limit", "dropped datagram delivered");
+    IPFreeReassemblyList();
+    EndTest("Memory limit", 4, 44, LARGE_DATAGRAM_SIZE);
+
+    /* The datagram that got a fragment last is kept, not the one that got one first */
+    StartTest();
+    for (Id = 50; Id < 54; Id++)
+        ReceivePiece(Id, LARGE_DATAGRAM_SIZE, 0);
+    for (Id = 51; Id < 54; Id++)
+        ReceiveAllButLast(Id);
+    ReceiveAllButLast(50);
+    ReceiveAllButLast(54);
+    ReceiveLast(50);
+    Check(Delivered == 1 && DeliveredId == 50, "Least recently used", "newest datagram dropped");
+    ReceiveLast(51);
+    Check(Delivered == 1, "Least recently used", "oldest datagram not dropped");
+    IPFreeReassemblyList();
+    EndTest("Least recently used", 1, 50, LARGE_DATAGRAM_SIZE);
+
+    /* Dropped datagrams give their memory back */
+    StartTest();
+    for (Id = 60; Id < 80; Id++)
+    {
+        ReceiveAllButLast(Id);
+        IPFreeReassemblyList();
+    }
+    for (Id = 80; Id < 84; Id++)
+        ReceiveAllButLast(Id);
+    for (Id = 80; Id < 84; Id++)
+        ReceiveLast(Id);
+    EndTest("Memory returned", 4, 83, LARGE_DATAGRAM_SIZE);
+}
+
+static VOID
+TestTimeout(VOID)
+{
+    StartTest();
+    ReceivePiece(90, 4000, 0);
+    ReceivePiece(91, 4000, 0);
+
+    IpTimerExpirations += MAX_TIMEOUT_COUNT - 1;
+    IPDatagramReassemblyTimeout();
+    Check(!IsListEmpty(&ReassemblyListHead), "Timeout", "datagram dropped too early");
+
+    /* A fragment restarts the timeout */
+    ReceivePiece(91, 4000, 1);
+    IpTimerExpirations++;
+    IPDatagramReassemblyTimeout();
+    ReceivePiece(90, 4000, 1);
+    ReceivePiece(90, 4000, 2);
+    Check(Delivered == 0, "Timeout", "expired datagram delivered");
+
+    ReceivePiece(91, 4000, 2);
+    Check(Delivered == 1, "Timeout", "datagram dropped too early");
+
+    IpTimerExpirations += MAX_TIMEOUT_COUNT;
+    IPDatagramReassemblyTimeout();
+    EndTest("Timeout", 1, 91, 4000);
+}
+
+int main(int argc, char *argv[])
+{
+    ULONG i;
+
+    /* What IPStartup does */
+    IPDRList.Size = sizeof(IPDATAGRAM_REASSEMBLY);
+    IPFragmentList.Size = sizeof(IP_FRAGMENT);
+    InitializeListHead(&ReassemblyListHead);
+    for (i = 0; i < REASSEMBLY_HASH_SIZE; i++)
+        InitializeListHead(&ReassemblyHashTable[i]);
+    TcpipInitializeSpinLock(&ReassemblyListLock);
+
+    TestOrders();
+    TestDuplicates();
+    TestOverlaps();
+    TestFragmentCount();
+    TestMemoryLimit();
+    TestTimeout();
+
+    printf("%lu failures, %lu packets received\n", (unsigned long)Failures, (unsigned long)PacketsAllocated);
+
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * PROJECT:     ReactOS TCP/IP driver tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Checks and times the neighbor cache of the driver
+ *
+ * The neighbor cache of the driver is compiled straight into this program,
+ * with the host headers, so it runs on any host:
+ *   gcc -O2 -I. -I../../../../../sdk/include/host -I../../../../../drivers/network/tcpip/include
+ *       -o neighborbench neighborbench.c ../../../../../drivers/network/tcpip/ip/network/neighbor.c
+ *
+ * A random sequence of additions, updates, timeout resets and removals is
+ * run against the cache and against a model that ages every entry on every
+ * tick, the way the cache did before it had a timer wheel. After each tick
+ * the entries, their states and the solicitations sent must be the same.
+ * Then the lookups and the ticks are timed with many resolved neighbors.
+ */
+
+#include "precomp.h"
+
+#include <time.h>
+
+#define ADDRESS_BASE        0x0A000000
+#define ADDRESS_STEP        7
+#define CHECKED_NEIGHBORS   1000
+#define CHECKED_TICKS       3000
+#define OPERATIONS_PER_TICK 20
+#define TIMED_NEIGHBORS     30000
+#define TIMED_LOOKUPS       1000000
+#define TIMED_TICKS         800     /* Less than ARP_RATE, nothing goes stale */
+
+typedef struct _MODEL_ENTRY
+{
+    BOOLEAN Present;
+    UCHAR State;
+    UINT EventTimer;
+    ULONG EventCount;   /* Ticks since the last event */
+    ULONG Solicits;     /* Solicitations due in the current tick */
+} MODEL_ENTRY, *PMODEL_ENTRY;
+
+static IP_INTERFACE Interface;
+static UCHAR LinkAddress[6] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 };
+static MODEL_ENTRY Model[CHECKED_NEIGHBORS];
+static ULONG Solicits[CHECKED_NEIGHBORS];
+static ULONG RandomState = 1;
+static PNEIGHBOR_CACHE_ENTRY volatile LookupResult;
+
+BOOLEAN AddrIsEqual(PIP_ADDRESS Address1, PIP_ADDRESS Address2)
+{
+    return Address1->Type == Address2->Type &&
+           Address1->Address.IPv4Address == Address2->Address.IPv4Address;
+}
+
+BOOLEAN AddrIsUnspecified(PIP_ADDRESS Address)
+{
+    return Address->Address.IPv4Address == 0;
+}
+
+PIP_INTERFACE GetDefaultInterface(VOID)
+{
+    return &Interface;
+}
+
+BOOLEAN ARPTransmit(PIP_ADDRESS Address, PVOID LinkAddress, PIP_INTERFACE Interface)
+{
+    ULONG Index = (Address->Address.IPv4Address - ADDRESS_BASE) / ADDRESS_STEP;
+
+    if (Index < CHECKED_NEIGHBORS)
+        Solicits[Index]++;
+
+    return TRUE;
+}
+
+static ULONG
+Random(VOID)
+{
+    RandomState = RandomState * 1103515245 + 12345;
+    return RandomState >> 8;
+}
+
+static PIP_ADDRESS
+NeighborAddress(ULONG Index)
+{
+    static IP_ADDRESS Address;
+
+    Address.Type = IP_ADDRESS_V4;
+    Address.Address.IPv4Address = ADDRESS_BASE + Index * ADDRESS_STEP;
+
+    return &Address;
+}
+
+static VOID
+AddNeighbor(ULONG Index, PVOID LinkAddress, UCHAR State, UINT EventTimer)
+{
+    PMODEL_ENTRY Entry = &Model[Index];
+
+    NBAddNeighbor(&Interface, NeighborAddress(Index), LinkAddress, Interface.AddressLength, State, EventTimer);
+
+    Entry->Present = TRUE;
+    Entry->State = State;
+    Entry->EventTimer = EventTimer;
+    Entry->EventCount = 0;
+}
+
+static VOID
+ModelTimeout(VOID)
+{
+    PMODEL_ENTRY Entry;
+    ULONG i;
+
+    for (i = 0; i < CHECKED_NEIGHBORS; i++)
+    {
+        Entry = &Model[i];
+        Entry->Solicits = 0;
+
+        if (!Entry->Present)
+            continue;
+
+        if (Entry->State & NUD_INCOMPLETE)
+        {
+            Entry->Solicits++;
+            if (Entry->EventTimer == 0 && ++Entry->EventCount == ARP_INCOMPLETE_TIMEOUT)
+                Entry->EventCount = 0;
+        }
+
+        if (Entry->EventTimer > 0)
+        {
+            Entry->EventCount++;
+
+            if ((Entry->EventCount > ARP_RATE && Entry->EventCount % ARP_TIMEOUT_RETRANSMISSION == 0) ||
+                Entry->EventCount == ARP_RATE)
+            {
+                Entry->State |= NUD_STALE;
+                Entry->Solicits++;
+            }
+
+            if (Entry->EventCount == Entry->EventTimer)
+                Entry->Present = FALSE;
+        }
+    }
+}
+
+static ULONG
+CheckNeighbors(ULONG Tick)
+{
+    PNEIGHBOR_CACHE_ENTRY NCE;
+    PMODEL_ENTRY Entry;
+    ULONG i, Errors = 0;
+
+    for (i = 0; i < CHECKED_NEIGHBORS; i++)
+    {
+        Entry = &Model[i];
+        NCE = NBLocateNeighbor(NeighborAddress(i), &Interface);
+
+        if (!NCE != !Entry->Present ||
+            (NCE && NCE->State != Entry->State) ||
+            Solicits[i] != Entry->Solicits)
+        {
+            if (Errors++ < 10)
+            {
+                printf("Tick %lu, neighbor %lu: present %d/%d, state %x/%x, solicits %lu/%lu\n",
+                       (unsigned long)Tick, (unsigned long)i, NCE != NULL, Entry->Present,
+                       NCE ? NCE->State : 0, Entry->State,
+                       (unsigned long)Solicits[i], (unsigned long)Entry->Solicits);
+            }
+        }
+
+        Solicits[i] = 0;
+    }
+
+    return Errors;
+}
+
+static ULONG
+CheckTimeouts(VOID)
+{
+    PNEIGHBOR_CACHE_ENTRY NCE;
+    ULONG i, Tick, Operation, Errors = 0;
+
+    NBStartup();
+
+    /* Every kind of entry the driver creates */
+    for (i = 0; i < CHECKED_NEIGHBORS; i++)
+    {
+        switch (i % 4)
+        {
+            case 0: AddNeighbor(i, NULL, NUD_INCOMPLETE, ARP_INCOMPLETE_TIMEOUT); break;
+            case 1: AddNeighbor(i, LinkAddress, 0, ARP_COMPLETE_TIMEOUT); break;
+            case 2: AddNeighbor(i, NULL, NUD_PERMANENT, 0); break;
+            case 3: AddNeighbor(i, NULL, NUD_INCOMPLETE, 0); break;
+        }
+    }
+
+    for (Tick = 1; Tick <= CHECKED_TICKS; Tick++)
+    {
+        for (Operation = 0; Operation < OPERATIONS_PER_TICK; Operation++)
+        {
+            i = Random() % CHECKED_NEIGHBORS;
+            NCE = NBLocateNeighbor(NeighborAddress(i), &Interface);
+
+            switch (Random() % 4)
+            {
+                case 0:
+                    /* A datagram was received */
+                    NBResetNeighborTimeout(NeighborAddress(i));
+                    if (Model[i].Present)
+                        Model[i].EventCount = 0;
+                    break;
+
+                case 1:
+                    /* An ARP reply was received */
+                    if (NCE && (NCE->State & NUD_INCOMPLETE))
+                    {
+                        NBUpdateNeighbor(NCE, LinkAddress, 0);
+                        Model[i].State = 0;
+                        Model[i].EventCount = 0;
+                        if (Model[i].EventTimer)
+                            Model[i].EventTimer = ARP_COMPLETE_TIMEOUT;
+                    }
+                    break;
+
+                case 2:
+                    if (!NCE)
+                        AddNeighbor(i, LinkAddress, 0, ARP_COMPLETE_TIMEOUT);
+                    break;
+
+                case 3:
+                    if (NCE && Random() % 8 == 0)
+                    {
+                        NBRemoveNeighbor(NCE);
+                        Model[i].Present = FALSE;
+                    }
+                    break;
+            }
+        }
+
+        NBTimeout();
+        ModelTimeout();
+        Errors += CheckNeighbors(Tick);
+    }
+
+    NBShutdown();
+
+    return Errors;
+}
+
+static VOID
+TimeNeighbors(ULONG Count)
+{
+    NEIGHBOR_CACHE_STATISTICS Statistics;
+    clock_t Start;
+    double LookupTime, TickTime;
+    ULONG i;
+
+    NBStartup();
+
+    for (i = 0; i < Count; i++)
+        NBAddNeighbor(&Interface, NeighborAddress(i), LinkAddress, Interface.AddressLength, 0, ARP_COMPLETE_TIMEOUT);
+
+    Start = clock();
+    for (i = 0; i < TIMED_LOOKUPS; i++)
+        LookupResult = NBLocateNeighbor(NeighborAddress(i % Count), &Interface);
+    LookupTime = (double)(clock() - Start) * 1e9 / CLOCKS_PER_SEC / TIMED_LOOKUPS;
+
+    Start = clock();
+    for (i = 0; i < TIMED_TICKS; i++)
+        NBTimeout();
+    TickTime = (double)(clock() - Start) * 1e9 / CLOCKS_PER_SEC / TIMED_TICKS;
+
+    NBGetStatistics(&Statistics);
+    printf("%lu neighbors in %lu buckets: %.1f ns per lookup, %.0f ns per tick\n",
+           (unsigned long)Statistics.Entries, (unsigned long)Statistics.Buckets, LookupTime, TickTime);
+
+    NBShutdown();
+}
+
+int main(int argc, char *argv[])
+{
+    ULONG Errors;
+
+    Interface.AddressLength = sizeof(LinkAddress);
+
+    Errors = CheckTimeouts();
+    printf("%lu differences from the model in %u ticks\n", (unsigned long)Errors, CHECKED_TICKS);
+
+    TimeNeighbors(CHECKED_NEIGHBORS);
+    TimeNeighbors((argc > 1) ? strtoul(argv[1], NULL, 0) : TIMED_NEIGHBORS);
+
+    return Errors ? 1 : 0;
+}
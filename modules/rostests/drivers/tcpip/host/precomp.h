@@ -0,0 +1,139 @@
+/*
+ * PROJECT:     ReactOS TCP/IP driver tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Stand-in for the precompiled header of the driver in host builds
+ *
+ * The driver headers that only need basic types are used as they are, and
+ * only what the driver files built into the host programs use is defined.
+ * Spin locks and IRQLs do nothing, the pool and the lookaside lists are the
+ * C heap, and the rest of the driver is left to the programs.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <typedefs.h>
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define STATUS_SUCCESS      ((NTSTATUS)0x00000000)
+#define STATUS_UNSUCCESSFUL ((NTSTATUS)0xC0000001)
+
+#define RtlCopyMemory(Destination, Source, Length) memcpy(Destination, Source, Length)
+#define RtlZeroMemory(Destination, Length) memset(Destination, 0, Length)
+
+/* Kernel */
+typedef UCHAR KIRQL, *PKIRQL;
+typedef ULONG_PTR KSPIN_LOCK, *PKSPIN_LOCK;
+typedef struct _KDPC *PKDPC;
+
+#define DISPATCH_LEVEL 2
+
+#define KeRaiseIrql(NewIrql, OldIrql) (*(OldIrql) = (NewIrql))
+#define KeLowerIrql(NewIrql) ((void)(NewIrql))
+
+#define NonPagedPool 0
+#define ExAllocatePoolWithTag(PoolType, Size, Tag) malloc(Size)
+#define ExFreePoolWithTag(P, Tag) free(P)
+
+typedef struct _NPAGED_LOOKASIDE_LIST {
+    SIZE_T Size;
+} NPAGED_LOOKASIDE_LIST, *PNPAGED_LOOKASIDE_LIST;
+
+#define ExAllocateFromNPagedLookasideList(Lookaside) malloc((Lookaside)->Size)
+#define ExFreeToNPagedLookasideList(Lookaside, Entry) free(Entry)
+
+#define InterlockedIncrement(Addend) (++*(Addend))
+#define InterlockedDecrement(Addend) (--*(Addend))
+
+static __inline
+PLIST_ENTRY
+ExInterlockedRemoveHeadList(
+    PLIST_ENTRY ListHead,
+    PKSPIN_LOCK Lock)
+{
+    return IsListEmpty(ListHead) ? NULL : RemoveHeadList(ListHead);
+}
+
+#define TcpipInitializeSpinLock(SpinLock) ((void)(SpinLock))
+#define TcpipAcquireSpinLock(SpinLock, Irql) ((void)(SpinLock), (void)(Irql))
+#define TcpipReleaseSpinLock(SpinLock, Irql) ((void)(SpinLock), (void)(Irql))
+#define TcpipAcquireSpinLockAtDpcLevel(SpinLock) ((void)(SpinLock))
+#define TcpipReleaseSpinLockFromDpcLevel(SpinLock) ((void)(SpinLock))
+
+/* NDIS */
+typedef INT NDIS_STATUS;
+
+#define NDIS_STATUS_NOT_ACCEPTED        ((NDIS_STATUS)0x00010003L)
+#define NDIS_STATUS_REQUEST_ABORTED     ((NDIS_STATUS)0xC001000CL)
+#define NDIS_STATUS_NETWORK_UNREACHABLE ((NDIS_STATUS)0xC000023CL)
+#define NDIS_STATUS_HOST_UNREACHABLE    ((NDIS_STATUS)0xC000023DL)
+
+typedef struct _NDIS_PACKET {
+    UCHAR ProtocolReserved[4 * sizeof(PVOID)];
+} NDIS_PACKET, *PNDIS_PACKET;
+
+/* The driver */
+#define TI_DbgPrint(_t_, _x_)
+#define A2S(Address) ""
+#define DISPLAY_IP_PACKET(IPPacket)
+
+#define ASSERT_KM_POINTER(Pointer)
+
+/* Byte order conversions of tcpip.h, for little endian hosts */
+#define DN2H(dw) \
+    ((((dw) & 0xFF000000L) >> 24) | \
+     (((dw) & 0x00FF0000L) >> 8) | \
+     (((dw) & 0x0000FF00L) << 8) | \
+     (((dw) & 0x000000FFL) << 24))
+#define DH2N(dw) DN2H(dw)
+#define WN2H(w) \
+    ((((w) & 0xFF00) >> 8) | \
+     (((w) & 0x00FF) << 8))
+#define WH2N(w) WN2H(w)
+
+#define LAN_PROTO_IPv4 0x0000
+
+#include <tags.h>
+#include <ip.h>
+#include <checksum.h>
+
+/* From address.h */
+#define AddrInitIPv4(IPAddress, RawAddress)           \
+{                                                     \
+    (IPAddress)->Type                = IP_ADDRESS_V4; \
+    (IPAddress)->Address.IPv4Address = (RawAddress);  \
+}
+
+/* From info.h */
+#define ARP_ENTRY_STATIC 4
+#define ARP_ENTRY_DYNAMIC 3
+#define ARP_ENTRY_INVALID 2
+
+typedef struct IPARP_ENTRY {
+    ULONG Index;
+    ULONG AddrSize;
+    UCHAR PhysAddr[8];
+    ULONG LogAddr;
+    ULONG Type;
+} IPARP_ENTRY, *PIPARP_ENTRY;
+
+/* Provided by the programs */
+ULONG IPv4NToHl(ULONG Address);
+UINT AddrCountPrefixBits(PIP_ADDRESS Netmask);
+BOOLEAN AddrIsEqual(PIP_ADDRESS Address1, PIP_ADDRESS Address2);
+BOOLEAN AddrIsUnspecified(PIP_ADDRESS Address);
+PIP_INTERFACE FindOnLinkInterface(PIP_ADDRESS Address);
+PIP_INTERFACE GetDefaultInterface(VOID);
+BOOLEAN ARPTransmit(PIP_ADDRESS Address, PVOID LinkAddress, PIP_INTERFACE Interface);
+UINT CopyPacketToBuffer(PCHAR DstData, PNDIS_PACKET SrcPacket, UINT SrcOffset, UINT Length);
+VOID FreeNdisPacket(PNDIS_PACKET Packet);
+VOID NdisReturnPackets(PNDIS_PACKET *PacketsToReturn, UINT NumberOfPackets);
+
+#include <neighbor.h>
+#include <router.h>
+#include <receive.h>
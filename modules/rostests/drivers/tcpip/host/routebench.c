@@ -0,0 +1,241 @@
+/*
+ * PROJECT:     ReactOS TCP/IP driver tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Checks and times the IPv4 route lookups of the driver
+ *
+ * The router of the driver is compiled straight into this program, with the
+ * host headers, so it runs on any host:
+ *   gcc -O2 -I. -I../../../../../sdk/include/host -I../../../../../drivers/network/tcpip/include
+ *       -o routebench routebench.c ../../../../../drivers/network/tcpip/ip/network/router.c
+ *
+ * A table of random routes is built, a fifth of them is removed again, and
+ * every lookup is compared with a linear longest prefix match over the whole
+ * table. The comparison is repeated after routers became stale or usable,
+ * with the route cache still filled. Then the lookups are timed with and
+ * without the route cache.
+ */
+
+#include "precomp.h"
+
+#include <time.h>
+
+#define ROUTERS         64
+#define DESTINATIONS    65536   /* Many more than the route cache holds */
+#define HOT_DESTINATIONS 64     /* Few enough to stay in the route cache */
+#define TIMED_LOOKUPS   2000000
+#define STATE_CHANGES   64
+
+/* Not in the headers */
+extern LIST_ENTRY FIBListHead;
+PNEIGHBOR_CACHE_ENTRY FIBLookup(ULONG Destination, PBOOLEAN Cacheable);
+VOID DestroyFIBE(PFIB_ENTRY FIBE);
+
+static NEIGHBOR_CACHE_ENTRY Routers[ROUTERS];
+static ULONG Destinations[DESTINATIONS];
+static ULONGLONG RandomState = 0x9E3779B97F4A7C15ULL;
+static PNEIGHBOR_CACHE_ENTRY volatile LookupResult;
+
+ULONG IPv4NToHl(ULONG Address)
+{
+    return ((Address & 0xFF) << 24) | ((Address & 0xFF00) << 8) |
+           ((Address >> 8) & 0xFF00) | ((Address >> 24) & 0xFF);
+}
+
+UINT AddrCountPrefixBits(PIP_ADDRESS Netmask)
+{
+    ULONG Mask = IPv4NToHl(Netmask->Address.IPv4Address);
+    UINT Length = 0;
+
+    while (Length < 32 && (Mask & (0x80000000 >> Length)))
+        Length++;
+
+    return Length;
+}
+
+BOOLEAN AddrIsEqual(PIP_ADDRESS Address1, PIP_ADDRESS Address2)
+{
+    return Address1->Type == Address2->Type &&
+           Address1->Address.IPv4Address == Address2->Address.IPv4Address;
+}
+
+PIP_INTERFACE FindOnLinkInterface(PIP_ADDRESS Address)
+{
+    return NULL;
+}
+
+PNEIGHBOR_CACHE_ENTRY NBFindOrCreateNeighbor(PIP_INTERFACE Interface, PIP_ADDRESS Address, BOOLEAN NoTimeout)
+{
+    return NULL;
+}
+
+static ULONG
+Random(VOID)
+{
+    /* xorshift64, so that every host gets the same table */
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return (ULONG)RandomState;
+}
+
+static PNEIGHBOR_CACHE_ENTRY
+LinearLookup(ULONG Destination)
+{
+    PLIST_ENTRY CurrentEntry;
+    PFIB_ENTRY Current;
+    PNEIGHBOR_CACHE_ENTRY BestNCE = NULL, FallbackNCE = NULL;
+    INT BestLength = -1, FallbackLength = -1, Length;
+    ULONG Mask;
+
+    /* The longest prefix with a usable router, else the longest prefix */
+    for (CurrentEntry = FIBListHead.Flink; CurrentEntry != &FIBListHead; CurrentEntry = CurrentEntry->Flink)
+    {
+        Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, ListEntry);
+        Length = AddrCountPrefixBits(&Current->Netmask);
+        Mask = Length ? 0xFFFFFFFF << (32 - Length) : 0;
+
+        if ((Destination ^ IPv4NToHl(Current->NetworkAddress.Address.IPv4Address)) & Mask)
+            continue;
+
+        if (Length > FallbackLength)
+        {
+            FallbackLength = Length;
+            FallbackNCE = Current->Router;
+        }
+
+        if (!(Current->Router->State & (NUD_STALE | NUD_INCOMPLETE)) && Length > BestLength)
+        {
+            BestLength = Length;
+            BestNCE = Current->Router;
+        }
+    }
+
+    return BestNCE ? BestNCE : FallbackNCE;
+}
+
+static PNEIGHBOR_CACHE_ENTRY
+GetRoute(ULONG Destination)
+{
+    IP_ADDRESS Address;
+
+    Address.Type = IP_ADDRESS_V4;
+    Address.Address.IPv4Address = IPv4NToHl(Destination);
+
+    return RouterGetRoute(&Address);
+}
+
+static PNEIGHBOR_CACHE_ENTRY
+TrieLookup(ULONG Destination)
+{
+    return FIBLookup(Destination, NULL);
+}
+
+static ULONG
+CompareLookups(ULONG Count)
+{
+    ULONG i, Mismatches = 0;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (GetRoute(Destinations[i]) != LinearLookup(Destinations[i]))
+            Mismatches++;
+    }
+
+    return Mismatches;
+}
+
+static double
+TimeLookups(PNEIGHBOR_CACHE_ENTRY (*Lookup)(ULONG), ULONG Count, ULONG DestinationMask)
+{
+    clock_t Start;
+    ULONG i;
+
+    Start = clock();
+    for (i = 0; i < Count; i++)
+        LookupResult = Lookup(Destinations[i & DestinationMask]);
+
+    /* Return the nanoseconds per lookup */
+    return (double)(clock() - Start) * 1e9 / CLOCKS_PER_SEC / Count;
+}
+
+int main(int argc, char *argv[])
+{
+    ULONG RouteCount = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000;
+    PFIB_ENTRY *Routes;
+    IP_ADDRESS Network, Netmask;
+    ULONG i, j, Length, Mask, Mismatches;
+
+    Routes = calloc(RouteCount, sizeof(*Routes));
+    if (!RouteCount || !Routes)
+        return 1;
+
+    RouterStartup();
+
+    /* One router in seven is stale, its routes are only used as a last resort */
+    for (i = 0; i < ROUTERS; i++)
+        Routers[i].State = (i % 7) ? 0 : NUD_STALE;
+
+    /* A default route, then prefixes from /8 to /32 */
+    for (i = 0; i < RouteCount; i++)
+    {
+        Length = i ? 8 + Random() % 25 : 0;
+        Mask = Length ? 0xFFFFFFFF << (32 - Length) : 0;
+
+        Network.Type = Netmask.Type = IP_ADDRESS_V4;
+        Network.Address.IPv4Address = IPv4NToHl(Random() & Mask);
+        Netmask.Address.IPv4Address = IPv4NToHl(Mask);
+
+        Routes[i] = RouterAddRoute(&Network, &Netmask, &Routers[Random() % ROUTERS], 1);
+        if (!Routes[i])
+            return 1;
+    }
+
+    /* Leave nodes without routes behind */
+    for (i = 1; i < RouteCount; i += 5)
+    {
+        DestroyFIBE(Routes[i]);
+        Routes[i] = NULL;
+    }
+
+    /* Half of the destinations are in the remaining networks, half anywhere */
+    for (i = 0; i < DESTINATIONS; i++)
+    {
+        j = Random() % RouteCount;
+        if (!Routes[j])
+            j--;
+
+        if (i & 1)
+            Destinations[i] = Random();
+        else
+            Destinations[i] = IPv4NToHl(Routes[j]->NetworkAddress.Address.IPv4Address) | (Random() & 0xFF);
+    }
+
+    Mismatches = CompareLookups(DESTINATIONS);
+
+    /* The neighbor cache changes the router states behind the back of the route cache */
+    for (j = 0; j < STATE_CHANGES; j++)
+    {
+        for (i = 0; i < ROUTERS; i++)
+            Routers[i].State = (Random() % 3) ? 0 : ((Random() & 1) ? NUD_STALE : NUD_INCOMPLETE);
+
+        Mismatches += CompareLookups(HOT_DESTINATIONS);
+    }
+
+    printf("%lu routes, %lu mismatches in %u lookups\n",
+           (unsigned long)(RouteCount - (RouteCount + 3) / 5), (unsigned long)Mismatches,
+           DESTINATIONS + STATE_CHANGES * HOT_DESTINATIONS);
+
+    printf("Linear scan (reference):     %9.1f ns\n",
+           TimeLookups(LinearLookup, TIMED_LOOKUPS / 1000, DESTINATIONS - 1));
+    printf("Prefix trie:                 %9.1f ns\n",
+           TimeLookups(TrieLookup, TIMED_LOOKUPS, DESTINATIONS - 1));
+    printf("RouterGetRoute, %5u dests:  %9.1f ns\n", DESTINATIONS,
+           TimeLookups(GetRoute, TIMED_LOOKUPS, DESTINATIONS - 1));
+    printf("RouterGetRoute, %5u dests:  %9.1f ns\n", HOT_DESTINATIONS,
+           TimeLookups(GetRoute, TIMED_LOOKUPS, HOT_DESTINATIONS - 1));
+
+    RouterShutdown();
+    free(Routes);
+
+    return Mismatches ? 1 : 0;
+}
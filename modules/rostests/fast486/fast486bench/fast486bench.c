@@ -0,0 +1,367 @@
+/*
+ * PROJECT:     ReactOS Fast486 tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Times Fast486 on small guest programs, with and without the decode cache
+ *
+ * The emulator is linked straight into this program, so it runs on any
+ * x86 or x64 Windows, or on ReactOS itself. It is built with the rostests,
+ * or outside of the tree with:
+ *   gcc -O2 -I../../../../sdk/include/reactos -I../../../../sdk/include/reactos/libs/fast486
+ *       -o fast486bench.exe fast486bench.c ../../../../sdk/lib/fast486/*.c -lntdll
+ *
+ * Each program runs alternately with the cache disabled and enabled, the
+ * best time of each is kept. Both runs must leave the same memory and
+ * registers behind, so this also checks the cache against the plain fetch.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fast486.h>
+
+#define MEMORY_SIZE     (1024 * 1024)
+#define STACK_OFFSET    0x7C00
+#define DEFAULT_ROUNDS  5
+
+typedef struct _PROGRAM
+{
+    PCSTR Name;
+    const UCHAR *Code;
+    ULONG Size;
+} PROGRAM;
+
+typedef struct _RESULT
+{
+    ULONGLONG Instructions;
+    ULONGLONG Ticks;
+    ULONG Checksum;
+} RESULT;
+
+static UCHAR Memory[MEMORY_SIZE];
+static FAST486_STATE State;
+static FAST486_DECODE_CACHE DecodeCache;
+
+/*
+ * The programs start at 0000:0000 in real mode with SS:SP = 0000:7C00,
+ * and stop at HLT. Build a new one with:
+ *   as --32 -o prog.o prog.S && ld -m elf_i386 -Ttext=0 --oformat=binary -o prog.bin prog.o
+ */
+
+/*
+ * Prefix-free, branchy 16-bit code: sieve of 8191, recursive fib(14),
+ * and a loop patching the immediate of an instruction it then runs.
+ *
+ *       .code16
+ *   start:
+ *       xorw %ax, %ax
+ *       movw %ax, %ds
+ *       movw %ax, %es
+ *       movw $0x5000, %bp
+ *       movw $40, %cx
+ *   outer:
+ *       pushw %cx
+ *       movw $0x8000, %di
+ *       movw $8191, %cx
+ *       movb $1, %al
+ *       cld
+ *       rep stosb
+ *       xorw %dx, %dx
+ *       movw $2, %si
+ *   sieve:
+ *       cmpb $0, 0x8000(%si)
+ *       je next
+ *       incw %dx
+ *       movw %si, %bx
+ *       addw %si, %bx
+ *   mark:
+ *       cmpw $8191, %bx
+ *       jae next
+ *       movb $0, 0x8000(%bx)
+ *       addw %si, %bx
+ *       jmp mark
+ *   next:
+ *       incw %si
+ *       cmpw $8191, %si
+ *       jb sieve
+ *       addw %dx, (%bp)
+ *       movw $14, %ax
+ *       call fib
+ *       addw %ax, 2(%bp)
+ *       movw $7, %cx
+ *   smc:
+ *       movb %cl, imm+1
+ *       jmp imm
+ *   imm:
+ *       movb $0, %al
+ *       addb %al, 4(%bp)
+ *       loop smc
+ *       popw %cx
+ *       loop outer
+ *       hlt
+ *   fib:
+ *       cmpw $2, %ax
+ *       jb done
+ *       pushw %ax
+ *       decw %ax
+ *       call fib
+ *       movw %ax, %bx
+ *       popw %ax
+ *       pushw %bx
+ *       subw $2, %ax
+ *       call fib
+ *       popw %bx
+ *       addw %bx, %ax
+ *   done:
+ *       ret
+ */
+static const UCHAR Sieve16Code[] =
+{
+    0x31, 0xC0, 0x8E, 0xD8, 0x8E, 0xC0, 0xBD, 0x00, 0x50, 0xB9, 0x28, 0x00,
+    0x51, 0xBF, 0x00, 0x80, 0xB9, 0xFF, 0x1F, 0xB0, 0x01, 0xFC, 0xF3, 0xAA,
+    0x31, 0xD2, 0xBE, 0x02, 0x00, 0x80, 0xBC, 0x00, 0x80, 0x00, 0x74, 0x14,
+    0x42, 0x89, 0xF3, 0x01, 0xF3, 0x81, 0xFB, 0xFF, 0x1F, 0x73, 0x09, 0xC6,
+    0x87, 0x00, 0x80, 0x00, 0x01, 0xF3, 0xEB, 0xF1, 0x46, 0x81, 0xFE, 0xFF,
+    0x1F, 0x72, 0xDE, 0x01, 0x56, 0x00, 0xB8, 0x0E, 0x00, 0xE8, 0x17, 0x00,
+    0x01, 0x46, 0x02, 0xB9, 0x07, 0x00, 0x88, 0x0E, 0x55, 0x00, 0xEB, 0x00,
+    0xB0, 0x00, 0x00, 0x46, 0x04, 0xE2, 0xF3, 0x59, 0xE2, 0xAE, 0xF4, 0x83,
+    0xF8, 0x02, 0x72, 0x12, 0x50, 0x48, 0xE8, 0xF6, 0xFF, 0x89, 0xC3, 0x58,
+    0x53, 0x83, 0xE8, 0x02, 0xE8, 0xEC, 0xFF, 0x5B, 0x01, 0xD8, 0xC3
+};
+
+/*
+ * 16-bit code using 32-bit operands and addressing: operand and
+ * address size prefixes, segment overrides, SIB bytes.
+ *
+ *       .code16
+ *   start:
+ *       xorw %ax, %ax
+ *       movw %ax, %ds
+ *       movw $0x1000, %ax
+ *       movw %ax, %es
+ *       movw $20000, %cx
+ *   outer:
+ *       xorl %esi, %esi
+ *       movl $0x12345678, %eax
+ *       xorl %edx, %edx
+ *       movw $0x100, %bx
+ *   inner:
+ *       addl %es:0x10(%bx,%si), %eax
+ *       movl %eax, %es:0x400(%bx,%si)
+ *       xorl %es:0x800(%bx), %edx
+ *       leal 3(%eax,%edx,2), %edi
+ *       addr32 movl (%esi), %ebp
+ *       addl %edi, %ebp
+ *       movl %ebp, %es:0xC00(%si)
+ *       addw $4, %si
+ *       cmpw $0x100, %si
+ *       jb inner
+ *       loop outer
+ *       movl %eax, 0x5000
+ *       movl %edx, 0x5004
+ *       hlt
+ */
+static const UCHAR Address32Code[] =
+{
+    0x31, 0xC0, 0x8E, 0xD8, 0xB8, 0x00, 0x10, 0x8E, 0xC0, 0xB9, 0x20, 0x4E,
+    0x66, 0x31, 0xF6, 0x66, 0xB8, 0x78, 0x56, 0x34, 0x12, 0x66, 0x31, 0xD2,
+    0xBB, 0x00, 0x01, 0x26, 0x66, 0x03, 0x40, 0x10, 0x26, 0x66, 0x89, 0x80,
+    0x00, 0x04, 0x26, 0x66, 0x33, 0x97, 0x00, 0x08, 0x67, 0x66, 0x8D, 0x7C,
+    0x50, 0x03, 0x67, 0x66, 0x8B, 0x2E, 0x66, 0x01, 0xFD, 0x26, 0x66, 0x89,
+    0xAC, 0x00, 0x0C, 0x83, 0xC6, 0x04, 0x81, 0xFE, 0x00, 0x01, 0x72, 0xD3,
+    0xE2, 0xC2, 0x66, 0xA3, 0x00, 0x50, 0x66, 0x89, 0x16, 0x04, 0x50, 0xF4
+};
+
+/*
+ * Switches to flat 32-bit protected mode, then fills, sums and
+ * copies a 4 KB array.
+ *
+ *       .code16
+ *   start:
+ *       xorw %ax, %ax
+ *       movw %ax, %ds
+ *       lgdt gdtdesc
+ *       movl %cr0, %eax
+ *       orb $1, %al
+ *       movl %eax, %cr0
+ *       ljmp $0x08, $pm32
+ *       .p2align 3
+ *   gdt:
+ *       .quad 0
+ *       .quad 0x00CF9A000000FFFF
+ *       .quad 0x00CF92000000FFFF
+ *   gdtdesc:
+ *       .word 23
+ *       .long gdt
+ *       .code32
+ *   pm32:
+ *       movw $0x10, %ax
+ *       movw %ax, %ds
+ *       movw %ax, %es
+ *       movw %ax, %ss
+ *       movl $0x7000, %esp
+ *       movl $300, %ecx
+ *       xorl %ebx, %ebx
+ *   outer:
+ *       movl $0x20000, %edi
+ *       movl $1024, %edx
+ *   fill:
+ *       movl %edx, (%edi,%edx,4)
+ *       decl %edx
+ *       jnz fill
+ *       movl $1023, %edx
+ *       xorl %eax, %eax
+ *   sum:
+ *       addl (%edi,%edx,4), %eax
+ *       imull $3, %eax, %eax
+ *       decl %edx
+ *       jns sum
+ *       addl %eax, %ebx
+ *       pushl %ecx
+ *       movl $0x20000, %esi
+ *       movl $0x30000, %edi
+ *       movl $1024, %ecx
+ *       rep movsl
+ *       popl %ecx
+ *       loop outer
+ *       movl %ebx, 0x5000
+ *       hlt
+ */
+static const UCHAR Protected32Code[] =
+{
+    0x31, 0xC0, 0x8E, 0xD8, 0x0F, 0x01, 0x16, 0x30, 0x00, 0x0F, 0x20, 0xC0,
+    0x0C, 0x01, 0x0F, 0x22, 0xC0, 0xEA, 0x36, 0x00, 0x08, 0x00, 0x66, 0x90,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00,
+    0x00, 0x9A, 0xCF, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x92, 0xCF, 0x00,
+    0x17, 0x00, 0x18, 0x00, 0x00, 0x00, 0x66, 0xB8, 0x10, 0x00, 0x8E, 0xD8,
+    0x8E, 0xC0, 0x8E, 0xD0, 0xBC, 0x00, 0x70, 0x00, 0x00, 0xB9, 0x2C, 0x01,
+    0x00, 0x00, 0x31, 0xDB, 0xBF, 0x00, 0x00, 0x02, 0x00, 0xBA, 0x00, 0x04,
+    0x00, 0x00, 0x89, 0x14, 0x97, 0x4A, 0x75, 0xFA, 0xBA, 0xFF, 0x03, 0x00,
+    0x00, 0x31, 0xC0, 0x03, 0x04, 0x97, 0x6B, 0xC0, 0x03, 0x4A, 0x79, 0xF7,
+    0x01, 0xC3, 0x51, 0xBE, 0x00, 0x00, 0x02, 0x00, 0xBF, 0x00, 0x00, 0x03,
+    0x00, 0xB9, 0x00, 0x04, 0x00, 0x00, 0xF3, 0xA5, 0x59, 0xE2, 0xC9, 0x89,
+    0x1D, 0x00, 0x50, 0x00, 0x00, 0xF4
+};
+
+static const PROGRAM Programs[] =
+{
+    { "Sieve16",     Sieve16Code,     sizeof(Sieve16Code)     },
+    { "Address32",   Address32Code,   sizeof(Address32Code)   },
+    { "Protected32", Protected32Code, sizeof(Protected32Code) },
+};
+
+static VOID FASTCALL
+MemRead(PFAST486_STATE Cpu, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        memcpy(Buffer, &Memory[Address], Size);
+    else
+        memset(Buffer, 0xFF, Size);
+}
+
+static VOID FASTCALL
+MemWrite(PFAST486_STATE Cpu, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        memcpy(&Memory[Address], Buffer, Size);
+}
+
+static ULONG
+Checksum(VOID)
+{
+    ULONG Hash = 2166136261u;
+    ULONG i;
+
+    /* FNV-1a over the memory and the general registers */
+    for (i = 0; i < MEMORY_SIZE; i++)
+        Hash = (Hash ^ Memory[i]) * 16777619u;
+    for (i = 0; i < FAST486_NUM_GEN_REGS; i++)
+        Hash = (Hash ^ State.GeneralRegs[i].Long) * 16777619u;
+
+    return Hash;
+}
+
+static VOID
+RunProgram(const PROGRAM *Program, BOOLEAN UseCache, RESULT *Result)
+{
+    LARGE_INTEGER Start, End;
+    ULONGLONG Instructions = 0;
+
+    memset(Memory, 0, sizeof(Memory));
+    memcpy(Memory, Program->Code, Program->Size);
+
+    Fast486Initialize(&State, MemRead, MemWrite, NULL, NULL, NULL, NULL, NULL, NULL);
+    Fast486SetDecodeCache(&State, UseCache ? &DecodeCache : NULL);
+    Fast486ExecuteAt(&State, 0, 0);
+    Fast486SetStack(&State, 0, STACK_OFFSET);
+
+    /* Step like NTVDM does */
+    QueryPerformanceCounter(&Start);
+    while (!State.Halted)
+    {
+        Fast486StepInto(&State);
+        Instructions++;
+    }
+    QueryPerformanceCounter(&End);
+
+    Result->Instructions = Instructions;
+    Result->Ticks = End.QuadPart - Start.QuadPart;
+    Result->Checksum = Checksum();
+}
+
+static double
+Mips(const RESULT *Result, LARGE_INTEGER Frequency)
+{
+    return (double)Result->Instructions * Frequency.QuadPart / Result->Ticks / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    LARGE_INTEGER Frequency;
+    RESULT Result, Best[2];
+    ULONG Rounds = DEFAULT_ROUNDS;
+    ULONG i, Round, Mode;
+    int Failures = 0;
+
+    if (argc > 1)
+        Rounds = max(strtoul(argv[1], NULL, 0), 1);
+
+    QueryPerformanceFrequency(&Frequency);
+
+    printf("%-12s %12s %10s %10s %8s\n", "Program", "Instructions", "MIPS off", "MIPS on", "Gain");
+
+    for (i = 0; i < _countof(Programs); i++)
+    {
+        for (Round = 0; Round < Rounds; Round++)
+        {
+            for (Mode = 0; Mode < 2; Mode++)
+            {
+                RunProgram(&Programs[i], (BOOLEAN)Mode, &Result);
+
+                if (Round == 0 || Result.Ticks < Best[Mode].Ticks)
+                    Best[Mode] = Result;
+            }
+        }
+
+        if (Best[0].Checksum != Best[1].Checksum || Best[0].Instructions != Best[1].Instructions)
+        {
+            printf("%-12s MISMATCH: %" PRIu64 " instructions, checksum %08lX without the cache, "
+                   "%" PRIu64 " instructions, checksum %08lX with it\n",
+                   Programs[i].Name, Best[0].Instructions, Best[0].Checksum,
+                   Best[1].Instructions, Best[1].Checksum);
+            Failures++;
+            continue;
+        }
+
+        printf("%-12s %12" PRIu64 " %10.2f %10.2f %+7.1f%%\n",
+               Programs[i].Name,
+               Best[0].Instructions,
+               Mips(&Best[0], Frequency),
+               Mips(&Best[1], Frequency),
+               (Mips(&Best[1], Frequency) / Mips(&Best[0], Frequency) - 1) * 100);
+    }
+
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * PROJECT:     ReactOS Fast486 tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Compares the host floating point mode of the Fast486 FPU with the exact emulation
+ *
+ * The emulator is linked straight into this program, so it runs on any
+ * x86 or x64 Windows, or on ReactOS itself. It is built with the rostests,
+ * or outside of the tree with:
+ *   gcc -O2 -I../../../../sdk/include/reactos -I../../../../sdk/include/reactos/libs/fast486
+ *       -o fpubench.exe fpubench.c ../../../../sdk/lib/fast486/*.c -lntdll
+ *
+ * Each instruction runs on the same pseudo-random operands in both modes.
+ * The results are stored as doubles and compared in units in the last
+ * place, along with the exception flags. Then both modes are timed.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <fast486.h>
+
+#define MEMORY_SIZE     (1024 * 1024)
+#define STACK_OFFSET    0x7C00
+#define OPERAND_BASE    0x10000
+#define RESULT_BASE     0x20000
+#define OPERAND_COUNT   4095
+#define TIMED_REPEATS   10
+#define SW_FLAGS        0x041F  /* C2 and the exception flags but PE, see below */
+
+/*
+ * Runs one FPU instruction on each operand pair of the table at 1000:0010
+ * and stores the result and the status word at 2000:xxx0. The number of
+ * passes is at 1000:0000 and the number of operand pairs at 1000:0002.
+ * The instruction replaces the two FNOPs.
+ *
+ *   start:
+ *       movw $0x1000, %ax
+ *       movw %ax, %ds
+ *       movw $0x2000, %ax
+ *       movw %ax, %es
+ *       movw (0), %dx
+ *   again:
+ *       movw $16, %si
+ *       xorw %di, %di
+ *       movw (2), %cx
+ *   next:
+ *       fninit
+ *       fldl 8(%si)             # Second operand, ST(1)
+ *       fldl (%si)              # First operand, ST(0)
+ *   op:
+ *       fnop
+ *       fnop
+ *       fnstsw %es:8(%di)
+ *       fstpl %es:(%di)
+ *       addw $16, %si
+ *       addw $16, %di
+ *       loop next
+ *       decw %dx
+ *       jnz again
+ *       hlt
+ */
+static const UCHAR LoopCode[] =
+{
+    0xB8, 0x00, 0x10, 0x8E, 0xD8, 0xB8, 0x00, 0x20, 0x8E, 0xC0, 0x8B, 0x16,
+    0x00, 0x00, 0xBE, 0x10, 0x00, 0x31, 0xFF, 0x8B, 0x0E, 0x02, 0x00, 0xDB,
+    0xE3, 0xDD, 0x44, 0x08, 0xDD, 0x04, 0xD9, 0xD0, 0xD9, 0xD0, 0x26, 0xDD,
+    0x7D, 0x08, 0x26, 0xDD, 0x1D, 0x83, 0xC6, 0x10, 0x83, 0xC7, 0x10, 0xE2,
+    0xE6, 0x4A, 0x75, 0xDA, 0xF4
+};
+
+#define OPERATION_OFFSET        0x1E
+#define INSTRUCTIONS_PER_PAIR   9
+
+typedef enum _OPERANDS
+{
+    AnyOperands,        /* Random signs, moderate exponents */
+    PositiveFirst,      /* ST(0) > 0 */
+    Angle               /* ST(0) within a few turns */
+} OPERANDS;
+
+typedef struct _OPERATION
+{
+    PCSTR Name;
+    UCHAR Code[4];
+    OPERANDS Operands;
+    ULONG MaxUlps;
+} OPERATION;
+
+/*
+ * The basic operations may only differ by the double rounding of the
+ * extended precision result. The exact emulation computes the others
+ * with series, a few dozen ulps off, which still catches wrong signs.
+ */
+static const OPERATION Operations[] =
+{
+    { "FADD",    { 0xD8, 0xC1, 0xD9, 0xD0 }, AnyOperands,   1 },
+    { "FSUB",    { 0xD8, 0xE1, 0xD9, 0xD0 }, AnyOperands,   1 },
+    { "FMUL",    { 0xD8, 0xC9, 0xD9, 0xD0 }, AnyOperands,   1 },
+    { "FDIV",    { 0xD8, 0xF1, 0xD9, 0xD0 }, AnyOperands,   1 },
+    { "FSQRT",   { 0xD9, 0xFA, 0xD9, 0xD0 }, PositiveFirst, 1 },
+    { "FSIN",    { 0xD9, 0xFE, 0xD9, 0xD0 }, Angle,         64 },
+    { "FCOS",    { 0xD9, 0xFF, 0xD9, 0xD0 }, Angle,         64 },
+    { "FPTAN",   { 0xD9, 0xF2, 0xDD, 0xD8 }, Angle,         64 }, /* FSTP ST(0) drops the 1.0 */
+    { "FSINCOS", { 0xD9, 0xFB, 0xD9, 0xD0 }, Angle,         64 }, /* The cosine is stored */
+    { "FPATAN",  { 0xD9, 0xF3, 0xD9, 0xD0 }, AnyOperands,   64 },
+    { "FYL2X",   { 0xD9, 0xF1, 0xD9, 0xD0 }, PositiveFirst, 64 },
+};
+
+static UCHAR Memory[MEMORY_SIZE];
+static FAST486_STATE State;
+static ULONGLONG RandomState = 0x9E3779B97F4A7C15ULL;
+
+static VOID FASTCALL
+MemRead(PFAST486_STATE Cpu, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        memcpy(Buffer, &Memory[Address], Size);
+    else
+        memset(Buffer, 0xFF, Size);
+}
+
+static VOID FASTCALL
+MemWrite(PFAST486_STATE Cpu, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        memcpy(&Memory[Address], Buffer, Size);
+}
+
+static ULONGLONG
+Random(VOID)
+{
+    /* xorshift64, so that every host gets the same operands */
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return RandomState;
+}
+
+static double
+RandomNumber(int MinExponent, int MaxExponent, BOOLEAN Signed)
+{
+    ULONGLONG Bits = Random();
+    double Value;
+
+    /* One number in eight is a small integer, so that some results are exact */
+    if ((Bits & 7) == 0)
+    {
+        Value = (double)((Bits >> 3) % 64 + 1);
+    }
+    else
+    {
+        Value = ldexp(1.0 + (double)(Bits >> 11) / 9007199254740992.0,
+                      MinExponent + (int)((Bits >> 3) % (MaxExponent - MinExponent + 1)));
+    }
+
+    if (Signed && (Random() & 1))
+        Value = -Value;
+
+    return Value;
+}
+
+static VOID
+MakeOperands(OPERANDS Operands)
+{
+    double Pair[2];
+    ULONG i;
+
+    for (i = 0; i < OPERAND_COUNT; i++)
+    {
+        switch (Operands)
+        {
+            case AnyOperands:
+                Pair[0] = RandomNumber(-40, 40, TRUE);
+                break;
+
+            case PositiveFirst:
+                Pair[0] = RandomNumber(-100, 100, FALSE);
+                break;
+
+            case Angle:
+                Pair[0] = RandomNumber(-10, 4, TRUE);
+                break;
+        }
+
+        Pair[1] = RandomNumber(-40, 40, TRUE);
+        memcpy(&Memory[OPERAND_BASE + 16 * (i + 1)], Pair, sizeof(Pair));
+    }
+}
+
+static double
+RunOperation(const OPERATION *Operation, BOOLEAN HostFloat, USHORT Passes)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    USHORT Count = OPERAND_COUNT;
+
+    /* The operands are left alone */
+    memset(Memory, 0, OPERAND_BASE);
+    memset(&Memory[RESULT_BASE], 0, MEMORY_SIZE - RESULT_BASE);
+    memcpy(Memory, LoopCode, sizeof(LoopCode));
+    memcpy(&Memory[OPERATION_OFFSET], Operation->Code, sizeof(Operation->Code));
+    memcpy(&Memory[OPERAND_BASE], &Passes, sizeof(Passes));
+    memcpy(&Memory[OPERAND_BASE + 2], &Count, sizeof(Count));
+
+    Fast486Initialize(&State, MemRead, MemWrite, NULL, NULL, NULL, NULL, NULL, NULL);
+    Fast486SetFpuHostFloat(&State, HostFloat);
+    Fast486ExecuteAt(&State, 0, 0);
+    Fast486SetStack(&State, 0, STACK_OFFSET);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    while (!State.Halted) Fast486StepInto(&State);
+    QueryPerformanceCounter(&End);
+
+    /* Return the MIPS */
+    return (double)Passes * Count * INSTRUCTIONS_PER_PAIR * Frequency.QuadPart
+           / (End.QuadPart - Start.QuadPart) / 1e6;
+}
+
+static LONGLONG
+OrderedBits(double Value)
+{
+    LONGLONG Bits;
+
+    /* Adjacent doubles get adjacent integers, and -0.0 the same as +0.0 */
+    memcpy(&Bits, &Value, sizeof(Bits));
+    return (Bits < 0) ? (LONGLONG)(0x8000000000000000ULL - (ULONGLONG)Bits) : Bits;
+}
+
+int main(int argc, char *argv[])
+{
+    static UCHAR ExactResults[OPERAND_COUNT * 16];
+    double ExactMips, HostMips;
+    ULONG i, j;
+    int Failures = 0;
+
+    printf("%-8s %9s %9s %9s %11s %11s %8s\n",
+           "Insn", "Max ulps", "Mean ulps", "Flag diff", "Exact MIPS", "Host MIPS", "Speedup");
+
+    for (i = 0; i < _countof(Operations); i++)
+    {
+        const OPERATION *Operation = &Operations[i];
+        ULONGLONG MaxUlps = 0, TotalUlps = 0;
+        ULONG FlagDiffs = 0;
+
+        /* Run both modes on the same operands */
+        MakeOperands(Operation->Operands);
+        RunOperation(Operation, FALSE, 1);
+        memcpy(ExactResults, &Memory[RESULT_BASE], sizeof(ExactResults));
+        RunOperation(Operation, TRUE, 1);
+
+        for (j = 0; j < OPERAND_COUNT; j++)
+        {
+            double ExactValue, HostValue;
+            USHORT ExactStatus, HostStatus;
+            LONGLONG Ulps;
+
+            memcpy(&ExactValue, &ExactResults[j * 16], sizeof(ExactValue));
+            memcpy(&ExactStatus, &ExactResults[j * 16 + 8], sizeof(ExactStatus));
+            memcpy(&HostValue, &Memory[RESULT_BASE + j * 16], sizeof(HostValue));
+            memcpy(&HostStatus, &Memory[RESULT_BASE + j * 16 + 8], sizeof(HostStatus));
+
+            Ulps = OrderedBits(ExactValue) - OrderedBits(HostValue);
+            if (Ulps < 0) Ulps = -Ulps;
+
+            MaxUlps = max(MaxUlps, (ULONGLONG)Ulps);
+            TotalUlps += Ulps;
+
+            /*
+             * The exact emulation doesn't raise the precision exception for
+             * arithmetic, while the host mode does, so it isn't compared.
+             */
+            if ((ExactStatus ^ HostStatus) & SW_FLAGS)
+                FlagDiffs++;
+        }
+
+        ExactMips = RunOperation(Operation, FALSE, TIMED_REPEATS);
+        HostMips = RunOperation(Operation, TRUE, TIMED_REPEATS);
+
+        printf("%-8s %9" PRIu64 " %9.3f %9lu %11.2f %11.2f %7.1fx",
+               Operation->Name, MaxUlps, (double)TotalUlps / OPERAND_COUNT, FlagDiffs,
+               ExactMips, HostMips, HostMips / ExactMips);
+
+        if (MaxUlps > Operation->MaxUlps || FlagDiffs)
+        {
+            printf("  FAILED");
+            Failures++;
+        }
+
+        printf("\n");
+    }
+
+    return Failures ? 1 : 0;
+}
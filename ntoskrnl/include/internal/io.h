@@ -1305,17 +1305,6 @@ IopDeleteIoCompletion(
     PVOID ObjectBody
 );
 
-NTSTATUS
-NTAPI
-IoSetIoCompletion(
-    IN PVOID IoCompletion,
-    IN PVOID KeyContext,
-    IN PVOID ApcContext,
-    IN NTSTATUS IoStatus,
-    IN ULONG_PTR IoStatusInformation,
-    IN BOOLEAN Quota
-);
-
 //
 // Ramdisk Routines
 //
@@ -70,6 +70,17 @@ IoReportHalResourceUsage(
     _In_ PCM_RESOURCE_LIST TranslatedResourceList,
     _In_ ULONG ResourceListSize
 );
+
+NTSTATUS
+NTAPI
+IoSetIoCompletion(
+    _In_ PVOID IoCompletion,
+    _In_ PVOID KeyContext,
+    _In_ PVOID ApcContext,
+    _In_ NTSTATUS IoStatus,
+    _In_ ULONG_PTR IoStatusInformation,
+    _In_ BOOLEAN Quota
+);
 #endif
 
 //
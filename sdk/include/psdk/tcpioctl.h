@@ -101,7 +101,12 @@
 #define AO_OPTION_PROTECT           38
 
 /* TCP connection options */
-#define TCP_SOCKET_NODELAY 1
+#define TCP_SOCKET_NODELAY    1
+#define TCP_SOCKET_KEEPALIVE  2
+#define TCP_SOCKET_OOBINLINE  3
+#define TCP_SOCKET_BSDURGENT  4
+#define TCP_SOCKET_ATMARK     5
+#define TCP_SOCKET_WINDOW     6
 
 typedef struct IFEntry
 {
@@ -132,6 +132,22 @@ typedef struct _AFD_ENUM_NETWORK_EVENTS_INFO {
     NTSTATUS EventStatus[AFD_MAX_EVENTS];
 } AFD_ENUM_NETWORK_EVENTS_INFO, *PAFD_ENUM_NETWORK_EVENTS_INFO;
 
+/* Readiness of a socket registered with IOCTL_AFD_POLL_REGISTER is posted
+ * to the completion port the socket handle is associated with. The packet
+ * carries the port key, Context as the overlapped pointer and the ready
+ * AFD_EVENT_* flags as the transfer count. Without AFD_POLL_EDGE_TRIGGERED
+ * a registration reports once and is re-armed by registering again, which
+ * reports right away if the socket is still ready. With it, each event is
+ * reported once when it becomes ready, and again only after it was consumed
+ * (e.g. all data read) and became ready anew. Events == 0 unregisters. */
+#define AFD_POLL_EDGE_TRIGGERED         0x1
+
+typedef struct _AFD_POLL_REGISTER_INFO {
+    ULONG Events;
+    ULONG Flags;
+    PVOID Context;
+} AFD_POLL_REGISTER_INFO, *PAFD_POLL_REGISTER_INFO;
+
 typedef struct _AFD_DISCONNECT_INFO {
     ULONG				DisconnectType;
     LARGE_INTEGER			Timeout;
@@ -186,6 +202,7 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_INFO_SEND_WINDOW_SIZE	0x07L
 #define AFD_INFO_GROUP_ID_TYPE	        0x10L
 #define AFD_INFO_RECEIVE_CONTENT_SIZE   0x11L
+#define AFD_INFO_ZERO_COPY_SENDS        0x80L /* ReactOS only */
 
 /* AFD Share Flags */
 #define AFD_SHARE_UNIQUE		0x0L
@@ -259,6 +276,7 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_EVENT_SELECT		33
 #define AFD_ENUM_NETWORK_EVENTS         34
 #define AFD_DEFER_ACCEPT		35
+#define AFD_POLL_REGISTER		36
 #define AFD_GET_PENDING_CONNECT_DATA	41
 #define AFD_VALIDATE_GROUP		42
 
@@ -330,6 +348,8 @@ typedef struct _AFD_TDI_HANDLE_DATA
   _AFD_CONTROL_CODE(AFD_EVENT_SELECT, METHOD_NEITHER)
 #define IOCTL_AFD_DEFER_ACCEPT \
   _AFD_CONTROL_CODE(AFD_DEFER_ACCEPT, METHOD_NEITHER)
+#define IOCTL_AFD_POLL_REGISTER \
+  _AFD_CONTROL_CODE(AFD_POLL_REGISTER, METHOD_NEITHER)
 #define IOCTL_AFD_GET_PENDING_CONNECT_DATA \
   _AFD_CONTROL_CODE(AFD_GET_PENDING_CONNECT_DATA, METHOD_NEITHER)
 #define IOCTL_AFD_ENUM_NETWORK_EVENTS \
@@ -0,0 +1,42 @@
+#ifndef __NDISSTAT_H
+#define __NDISSTAT_H
+
+/* Queried with IOCTL_NDIS_QUERY_GLOBAL_STATS on the adapter device
+ * (\Device\{GUID}). NDIS answers it itself, the miniport never sees it */
+#define OID_REACTOS_PACKET_STATISTICS   0xFF010101
+
+#define NDIS_PACKET_STATISTICS_VERSION  1
+
+/* Send completion latency buckets. Each bucket but the last holds the
+ * completions faster than its limit, in microseconds */
+#define NDIS_SEND_LATENCY_BUCKETS       8
+#define NDIS_SEND_LATENCY_LIMITS        { 10, 50, 100, 500, 1000, 5000, 10000 }
+
+/* Counters kept by NDIS for one processor */
+typedef struct _NDIS_PACKET_COUNTERS
+{
+    ULONG64     SendPackets;            /* Packets handed to the miniport */
+    ULONG64     SendBytes;
+    ULONG64     SendCompletions;        /* Sends completed, successfully or not */
+    ULONG64     SendErrors;             /* Sends completed with an error */
+    ULONG64     ScatterGatherFailures;  /* Sends that could not be mapped for DMA */
+    ULONG64     ReceivePackets;         /* Packets indicated by the miniport */
+    ULONG64     ReceiveBytes;
+    ULONG64     Interrupts;             /* Interrupts recognized by the miniport */
+    ULONG64     Dpcs;                   /* Deferred interrupt processing runs */
+    ULONG64     SendLatency[NDIS_SEND_LATENCY_BUCKETS];
+} NDIS_PACKET_COUNTERS, *PNDIS_PACKET_COUNTERS;
+
+/* Returned for OID_REACTOS_PACKET_STATISTICS. Processor holds as many
+ * entries as the buffer has room for, up to NumberOfProcessors */
+typedef struct _NDIS_PACKET_STATISTICS
+{
+    ULONG                   Version;
+    ULONG                   NumberOfProcessors;
+    ULONG                   QueueDepth;         /* Work items waiting for the miniport */
+    ULONG                   MaximumQueueDepth;
+    NDIS_PACKET_COUNTERS    Total;
+    NDIS_PACKET_COUNTERS    Processor[ANYSIZE_ARRAY];
+} NDIS_PACKET_STATISTICS, *PNDIS_PACKET_STATISTICS;
+
+#endif
@@ -116,6 +116,22 @@
 C_ASSERT((FAST486_CACHE_SIZE >= sizeof(ULONG))
          && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE));
 
+/*
+ * Decode cache geometry. Blocks never cross a page boundary and the
+ * number of blocks must be a power of two.
+ */
+#define FAST486_DECODE_CACHE_BLOCKS 512
+#define FAST486_DECODE_CACHE_PAGES  1024
+#define FAST486_DECODE_BLOCK_SIZE   64
+#define FAST486_DECODE_BLOCK_INSTS  24
+#define FAST486_DECODE_LINE_SIZE    (FAST486_PAGE_SIZE / 64)
+#define FAST486_DECODE_FILTER_BITS  1024
+
+C_ASSERT((FAST486_DECODE_CACHE_BLOCKS & (FAST486_DECODE_CACHE_BLOCKS - 1)) == 0);
+C_ASSERT((FAST486_DECODE_CACHE_PAGES & (FAST486_DECODE_CACHE_PAGES - 1)) == 0);
+C_ASSERT((FAST486_DECODE_FILTER_BITS & (FAST486_DECODE_FILTER_BITS - 1)) == 0);
+C_ASSERT(FAST486_DECODE_BLOCK_SIZE <= 2 * FAST486_DECODE_LINE_SIZE);
+
 struct _FAST486_STATE;
 typedef struct _FAST486_STATE FAST486_STATE, *PFAST486_STATE;
 
@@ -511,6 +527,75 @@ typedef union _FAST486_FPU_CONTROL_REG
     };
 } FAST486_FPU_CONTROL_REG, *PFAST486_FPU_CONTROL_REG;
 
+#ifndef FAST486_NO_DECODE_CACHE
+
+#define FAST486_DECODED_MODRM_MEMORY    (1 << 0)
+#define FAST486_DECODED_MODRM_ADSIZE    (1 << 1)
+#define FAST486_DECODED_MODRM_SS        (1 << 2)
+
+typedef struct _FAST486_DECODED_MODRM
+{
+    UCHAR Length;           // Size of the MOD REG R/M byte, SIB byte and displacement
+    UCHAR Flags;
+    UCHAR Register;
+    UCHAR SecondRegister;   // Register operand or base register
+    UCHAR IndexRegister;
+    UCHAR Scale;
+    LONG Displacement;
+} FAST486_DECODED_MODRM, *PFAST486_DECODED_MODRM;
+
+typedef struct _FAST486_DECODED_INST
+{
+    UCHAR Offset;           // Offset of the first prefix within the block
+    UCHAR OpcodeOffset;     // Offset of the opcode within the block
+    UCHAR ModRegRmOffset;   // Offset of the MOD REG R/M byte within the block
+    UCHAR Length;
+    UCHAR Opcode;
+    UCHAR SegmentOverride;
+    USHORT PrefixFlags;
+    FAST486_DECODED_MODRM ModRegRm;
+} FAST486_DECODED_INST, *PFAST486_DECODED_INST;
+
+typedef struct _FAST486_DECODED_BLOCK
+{
+    ULONG Address;          // Linear address of the first instruction
+    ULONG PhysicalAddress;
+    ULONG Generation;       // Matches the cache generation while the block is valid
+    UCHAR Mode;             // Code segment size and CPL the block was decoded for
+    UCHAR Count;            // Number of decoded instructions
+    UCHAR Size;             // Number of code bytes
+    UCHAR Reserved;
+    USHORT Page;            // Code page the block belongs to
+    USHORT NextBlock;       // Next and previous block of the same code page
+    USHORT PrevBlock;
+    UCHAR Code[FAST486_DECODE_BLOCK_SIZE];
+    FAST486_DECODED_INST Instructions[FAST486_DECODE_BLOCK_INSTS];
+} FAST486_DECODED_BLOCK, *PFAST486_DECODED_BLOCK;
+
+typedef struct _FAST486_CODE_PAGE
+{
+    ULONG Page;             // Physical page number
+    ULONG Generation;
+    ULONGLONG Lines;        // Lines of the page covered by decoded blocks
+    USHORT FirstBlock;
+} FAST486_CODE_PAGE, *PFAST486_CODE_PAGE;
+
+/*
+ * Cache of pre-decoded instructions, keyed by linear address and
+ * invalidated on writes to the physical pages holding them.
+ * It is allocated by the host, like the TLB.
+ */
+typedef struct _FAST486_DECODE_CACHE
+{
+    ULONG Generation;
+    ULONG PageCount;
+    ULONG PageFilter[FAST486_DECODE_FILTER_BITS / 32];  // Pages that may hold blocks
+    FAST486_CODE_PAGE Pages[FAST486_DECODE_CACHE_PAGES];
+    FAST486_DECODED_BLOCK Blocks[FAST486_DECODE_CACHE_BLOCKS];
+} FAST486_DECODE_CACHE, *PFAST486_DECODE_CACHE;
+
+#endif
+
 struct _FAST486_STATE
 {
     FAST486_MEM_READ_PROC MemReadCallback;
@@ -544,6 +629,13 @@ struct _FAST486_STATE
     ULONG PrefetchAddress;
     UCHAR PrefetchCache[FAST486_CACHE_SIZE];
 #endif
+#ifndef FAST486_NO_DECODE_CACHE
+    PFAST486_DECODE_CACHE DecodeCache;
+    PFAST486_DECODED_BLOCK DecodeBlock;
+    PFAST486_DECODED_INST DecodeInst;
+    ULONG DecodeIndex;
+    ULONG DecodeCount;
+#endif
 #ifndef FAST486_NO_FPU
     FAST486_FPU_DATA_REG FpuRegisters[FAST486_NUM_FPU_REGS];
     FAST486_FPU_STATUS_REG FpuStatus;
@@ -553,6 +645,7 @@ struct _FAST486_STATE
     USHORT FpuLastCodeSel;
     FAST486_REG FpuLastOpPtr;
     USHORT FpuLastDataSel;
+    BOOLEAN FpuHostFloat;
 #endif
 };
 
@@ -619,6 +712,30 @@ VOID
 NTAPI
 Fast486Rewind(PFAST486_STATE State);
 
+#ifndef FAST486_NO_FPU
+
+VOID
+NTAPI
+Fast486SetFpuHostFloat(PFAST486_STATE State, BOOLEAN Enable);
+
+#endif
+
+#ifndef FAST486_NO_DECODE_CACHE
+
+VOID
+NTAPI
+Fast486SetDecodeCache(PFAST486_STATE State, PFAST486_DECODE_CACHE DecodeCache);
+
+VOID
+NTAPI
+Fast486FlushDecodeCache(PFAST486_STATE State);
+
+VOID
+NTAPI
+Fast486InvalidateDecodeCache(PFAST486_STATE State, ULONG PhysicalAddress, ULONG Size);
+
+#endif
+
 #endif // _FAST486_H_
 
 /* EOF */
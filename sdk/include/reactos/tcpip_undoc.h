@@ -3,3 +3,6 @@
 
 /* Ioctl called by GetInterfaceInfo. Returns IP_INTERFACE_INFO structure. */
 #define IOCTL_IP_INTERFACE_INFO _TCP_CTL_CODE(0x10, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* Private TCP connection option used by AFD for SO_SNDBUF. Takes a ULONG. */
+#define TCP_SOCKET_SNDBUF 0x100
@@ -194,6 +194,34 @@ Fast486CallGate
     BOOLEAN Call
 );
 
+#ifndef FAST486_NO_DECODE_CACHE
+
+BOOLEAN
+FASTCALL
+Fast486LookupDecodedInst
+(
+    PFAST486_STATE State,
+    PFAST486_DECODED_INST *DecodedInst
+);
+
+VOID
+FASTCALL
+Fast486DecodeCacheFlush
+(
+    PFAST486_STATE State
+);
+
+VOID
+FASTCALL
+Fast486DecodeCacheInvalidate
+(
+    PFAST486_STATE State,
+    ULONG PhysicalAddress,
+    ULONG Size
+);
+
+#endif
+
 /* INLINED FUNCTIONS **********************************************************/
 
 #include "common.inl"
@@ -150,11 +150,42 @@ VOID
 FASTCALL
 Fast486FlushTlb(PFAST486_STATE State)
 {
+#ifndef FAST486_NO_DECODE_CACHE
+    /* Decoded blocks are looked up by linear address */
+    Fast486DecodeCacheFlush(State);
+#endif
+
     if (!State->Tlb || State->TlbEmpty) return;
     RtlFillMemory(State->Tlb, NUM_TLB_ENTRIES * sizeof(ULONG), 0xFF);
     State->TlbEmpty = TRUE;
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486InvalidateCode(PFAST486_STATE State,
+                      ULONG PhysicalAddress,
+                      ULONG Size)
+{
+#ifndef FAST486_NO_DECODE_CACHE
+    PFAST486_DECODE_CACHE Cache = State->DecodeCache;
+    ULONG Page = PhysicalAddress >> 12;
+
+    if (Cache == NULL) return;
+
+    /* Check if the write may have modified decoded instructions */
+    if ((Page != ((PhysicalAddress + Size - 1) >> 12))
+        || (Cache->PageFilter[(Page % FAST486_DECODE_FILTER_BITS) / 32] & (1 << (Page % 32))))
+    {
+        Fast486DecodeCacheInvalidate(State, PhysicalAddress, Size);
+    }
+#else
+    UNREFERENCED_PARAMETER(State);
+    UNREFERENCED_PARAMETER(PhysicalAddress);
+    UNREFERENCED_PARAMETER(Size);
+#endif
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -285,6 +316,7 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                                     (TableEntry.Address << 12) | PageOffset,
                                     (PVOID)((ULONG_PTR)Buffer + BufferOffset),
                                     PageLength);
+            Fast486InvalidateCode(State, (TableEntry.Address << 12) | PageOffset, PageLength);
 
             BufferOffset += PageLength;
         }
@@ -293,6 +325,7 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
     {
         /* Write the memory */
         State->MemWriteCallback(State, LinearAddress, Buffer, Size);
+        Fast486InvalidateCode(State, LinearAddress, Size);
     }
 
     return TRUE;
@@ -569,6 +602,11 @@ Fast486LoadSegmentInternal(PFAST486_STATE State,
     /* Get the cached descriptor */
     CachedDescriptor = &State->SegmentRegs[Segment];
 
+#ifndef FAST486_NO_DECODE_CACHE
+    /* The next instruction can no longer be taken from the current block */
+    if (Segment == FAST486_REG_CS) State->DecodeCount = 0;
+#endif
+
     /* Check for protected mode */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PE)
     {
@@ -853,6 +891,109 @@ Fast486ProcessGate(PFAST486_STATE State, USHORT Selector, ULONG Offset, BOOLEAN
     }
 }
 
+#ifndef FAST486_NO_DECODE_CACHE
+
+FORCEINLINE
+PVOID
+FASTCALL
+Fast486GetDecodedCode(PFAST486_STATE State,
+                      ULONG Offset,
+                      ULONG Size)
+{
+    PFAST486_DECODED_INST Inst = State->DecodeInst;
+    ULONG Position;
+
+    if (Inst == NULL) return NULL;
+
+    Position = State->SegmentRegs[FAST486_REG_CS].Base + Offset - State->DecodeBlock->Address;
+
+    /* The bytes must belong to the instruction being executed */
+    if ((Position < Inst->Offset) || ((Position + Size) > (ULONG)(Inst->Offset + Inst->Length)))
+    {
+        return NULL;
+    }
+
+    return &State->DecodeBlock->Code[Position];
+}
+
+FORCEINLINE
+ULONG
+Fast486DecodeHash(ULONG Value)
+{
+    return (Value * 0x9E3779B1) >> 16;
+}
+
+FORCEINLINE
+BOOLEAN
+FASTCALL
+Fast486GetDecodedInst(PFAST486_STATE State,
+                      PFAST486_DECODED_INST *DecodedInst)
+{
+    PFAST486_SEG_REG CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_DECODE_CACHE Cache = State->DecodeCache;
+    PFAST486_DECODED_BLOCK Block = State->DecodeBlock;
+    PFAST486_DECODED_INST Inst;
+    ULONG Offset, LinearAddress, Last;
+
+    Offset = (CachedDescriptor->Size) ? State->InstPtr.Long
+                                      : State->InstPtr.LowWord;
+    LinearAddress = CachedDescriptor->Base + Offset;
+
+    if (State->DecodeCount != 0)
+    {
+        /* Most of the time, this is the next instruction of the current block */
+        if (State->DecodeIndex < State->DecodeCount)
+        {
+            Inst = &Block->Instructions[State->DecodeIndex];
+
+            if (LinearAddress == (Block->Address + Inst->Offset))
+            {
+                State->DecodeIndex++;
+                *DecodedInst = Inst;
+                return TRUE;
+            }
+        }
+
+        /* Or the same one, when a string instruction is repeated */
+        Inst = &Block->Instructions[State->DecodeIndex - 1];
+
+        if (LinearAddress == (Block->Address + Inst->Offset))
+        {
+            *DecodedInst = Inst;
+            return TRUE;
+        }
+    }
+
+    /*
+     * Otherwise, a jump was taken. Enter the block starting at the target
+     * right away if it is valid and entirely within the code segment, which
+     * is the case of almost all jumps. Blocks are short in branchy code, so
+     * this must not cost more than fetching the instructions would.
+     */
+    Block = &Cache->Blocks[Fast486DecodeHash(LinearAddress) & (FAST486_DECODE_CACHE_BLOCKS - 1)];
+    Last = CachedDescriptor->Size ? CachedDescriptor->Limit
+                                  : min(CachedDescriptor->Limit, 0xFFFF);
+
+    if ((Block->Address == LinearAddress)
+        && (Block->Generation == Cache->Generation)
+        && (Block->Mode == (UCHAR)(CachedDescriptor->Size
+                                   | (Fast486GetCurrentPrivLevel(State) << 1)))
+        && (Offset <= Last)
+        && ((ULONG)(Block->Size - 1) <= (Last - Offset)))
+    {
+        State->DecodeBlock = Block;
+        State->DecodeIndex = 1;
+        State->DecodeCount = Block->Count;
+        *DecodedInst = &Block->Instructions[0];
+        return TRUE;
+    }
+
+    /* Call the internal function */
+    return Fast486LookupDecodedInst(State, DecodedInst);
+}
+
+#endif
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -864,6 +1005,9 @@ Fast486FetchByte(PFAST486_STATE State,
 #ifndef FAST486_NO_PREFETCH
     ULONG LinearAddress;
 #endif
+#ifndef FAST486_NO_DECODE_CACHE
+    PVOID Code;
+#endif
 
     /* Get the cached descriptor of CS */
     CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
@@ -872,7 +1016,16 @@ Fast486FetchByte(PFAST486_STATE State,
                                       : State->InstPtr.LowWord;
 #ifndef FAST486_NO_PREFETCH
     LinearAddress = CachedDescriptor->Base + Offset;
+#endif
 
+#ifndef FAST486_NO_DECODE_CACHE
+    if ((Code = Fast486GetDecodedCode(State, Offset, sizeof(UCHAR))) != NULL)
+    {
+        *Data = *(PUCHAR)Code;
+    }
+    else
+#endif
+#ifndef FAST486_NO_PREFETCH
     if (State->PrefetchValid
         && (LinearAddress >= State->PrefetchAddress)
         && ((LinearAddress + sizeof(UCHAR)) <= (State->PrefetchAddress + FAST486_CACHE_SIZE)))
@@ -913,6 +1066,9 @@ Fast486FetchWord(PFAST486_STATE State,
 #ifndef FAST486_NO_PREFETCH
     ULONG LinearAddress;
 #endif
+#ifndef FAST486_NO_DECODE_CACHE
+    PVOID Code;
+#endif
 
     /* Get the cached descriptor of CS */
     CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
@@ -922,7 +1078,16 @@ Fast486FetchWord(PFAST486_STATE State,
 
 #ifndef FAST486_NO_PREFETCH
     LinearAddress = CachedDescriptor->Base + Offset;
+#endif
 
+#ifndef FAST486_NO_DECODE_CACHE
+    if ((Code = Fast486GetDecodedCode(State, Offset, sizeof(USHORT))) != NULL)
+    {
+        *Data = *(PUSHORT)Code;
+    }
+    else
+#endif
+#ifndef FAST486_NO_PREFETCH
     if (State->PrefetchValid
         && (LinearAddress >= State->PrefetchAddress)
         && ((LinearAddress + sizeof(USHORT)) <= (State->PrefetchAddress + FAST486_CACHE_SIZE)))
@@ -964,6 +1129,9 @@ Fast486FetchDword(PFAST486_STATE State,
 #ifndef FAST486_NO_PREFETCH
     ULONG LinearAddress;
 #endif
+#ifndef FAST486_NO_DECODE_CACHE
+    PVOID Code;
+#endif
 
     /* Get the cached descriptor of CS */
     CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
@@ -973,7 +1141,16 @@ Fast486FetchDword(PFAST486_STATE State,
 
 #ifndef FAST486_NO_PREFETCH
     LinearAddress = CachedDescriptor->Base + Offset;
+#endif
 
+#ifndef FAST486_NO_DECODE_CACHE
+    if ((Code = Fast486GetDecodedCode(State, Offset, sizeof(ULONG))) != NULL)
+    {
+        *Data = *(PULONG)Code;
+    }
+    else
+#endif
+#ifndef FAST486_NO_PREFETCH
     if (State->PrefetchValid
         && (LinearAddress >= State->PrefetchAddress)
         && ((LinearAddress + sizeof(ULONG)) <= (State->PrefetchAddress + FAST486_CACHE_SIZE)))
@@ -1013,6 +1190,70 @@ Fast486CalculateParity(UCHAR Number)
     return (0x9669 >> ((Number & 0x0F) ^ (Number >> 4))) & 1;
 }
 
+#ifndef FAST486_NO_DECODE_CACHE
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486UseDecodedModRegRm(PFAST486_STATE State,
+                          PFAST486_DECODED_MODRM Decoded,
+                          PFAST486_MOD_REG_RM ModRegRm)
+{
+    ULONG Address = Decoded->Displacement;
+
+    ModRegRm->Register = Decoded->Register;
+    ModRegRm->Memory = (Decoded->Flags & FAST486_DECODED_MODRM_MEMORY) ? TRUE : FALSE;
+
+    if (!ModRegRm->Memory)
+    {
+        /* The second operand is also a register */
+        ModRegRm->SecondRegister = Decoded->SecondRegister;
+    }
+    else if (Decoded->Flags & FAST486_DECODED_MODRM_ADSIZE)
+    {
+        if (Decoded->SecondRegister < FAST486_NUM_GEN_REGS)
+        {
+            Address += State->GeneralRegs[Decoded->SecondRegister].Long;
+        }
+
+        if (Decoded->IndexRegister < FAST486_NUM_GEN_REGS)
+        {
+            Address += State->GeneralRegs[Decoded->IndexRegister].Long << Decoded->Scale;
+        }
+
+        ModRegRm->MemoryAddress = Address;
+    }
+    else
+    {
+        if (Decoded->SecondRegister < FAST486_NUM_GEN_REGS)
+        {
+            Address += State->GeneralRegs[Decoded->SecondRegister].LowWord;
+        }
+
+        if (Decoded->IndexRegister < FAST486_NUM_GEN_REGS)
+        {
+            Address += State->GeneralRegs[Decoded->IndexRegister].LowWord;
+        }
+
+        ModRegRm->MemoryAddress = Address & 0x0000FFFF;
+    }
+
+    /* Check if the default segment should be SS */
+    if ((Decoded->Flags & FAST486_DECODED_MODRM_SS)
+        && !(State->PrefixFlags & FAST486_PREFIX_SEG))
+    {
+        /* Add a SS: prefix */
+        State->PrefixFlags |= FAST486_PREFIX_SEG;
+        State->SegmentOverride = FAST486_REG_SS;
+    }
+
+    /* Skip the MOD REG R/M byte, the SIB byte and the displacement */
+    if (State->SegmentRegs[FAST486_REG_CS].Size) State->InstPtr.Long += Decoded->Length;
+    else State->InstPtr.LowWord += Decoded->Length;
+}
+
+#endif
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -1022,6 +1263,26 @@ Fast486ParseModRegRm(PFAST486_STATE State,
 {
     UCHAR ModRmByte, Mode, RegMem;
 
+#ifndef FAST486_NO_DECODE_CACHE
+    if (State->DecodeInst != NULL)
+    {
+        PFAST486_DECODED_MODRM Decoded = &State->DecodeInst->ModRegRm;
+
+        /* Use the pre-decoded operands if they are at the current position */
+        if ((Decoded->Length != 0)
+            && (!(Decoded->Flags & FAST486_DECODED_MODRM_ADSIZE) == !AddressSize)
+            && (Fast486GetDecodedCode(State,
+                                      State->SegmentRegs[FAST486_REG_CS].Size
+                                      ? State->InstPtr.Long : State->InstPtr.LowWord,
+                                      Decoded->Length)
+                == &State->DecodeBlock->Code[State->DecodeInst->ModRegRmOffset]))
+        {
+            Fast486UseDecodedModRegRm(State, Decoded, ModRegRm);
+            return TRUE;
+        }
+    }
+#endif
+
     /* Fetch the MOD REG R/M byte */
     if (!Fast486FetchByte(State, &ModRmByte))
     {
@@ -50,6 +50,9 @@ Fast486ExecutionControl(PFAST486_STATE State, FAST486_EXEC_CMD Command)
 {
     UCHAR Opcode;
     FAST486_OPCODE_HANDLER_PROC CurrentHandler;
+#ifndef FAST486_NO_DECODE_CACHE
+    PFAST486_DECODED_INST DecodedInst;
+#endif
     INT ProcedureCallCount = 0;
     BOOLEAN Trap;
 
@@ -68,22 +71,61 @@ NextInst:
                 State->SavedStackPtr = State->GeneralRegs[FAST486_REG_ESP];
             }
 
-            /* Perform an instruction fetch */
-            if (!Fast486FetchByte(State, &Opcode))
+#ifndef FAST486_NO_DECODE_CACHE
+            DecodedInst = NULL;
+
+            /* Look for the instruction in the decode cache */
+            if ((State->PrefixFlags == 0) && (State->DecodeCache != NULL))
             {
-                /* Exception occurred */
-                State->PrefixFlags = 0;
-                continue;
+                if (!Fast486GetDecodedInst(State, &DecodedInst))
+                {
+                    /* Exception occurred */
+                    continue;
+                }
             }
 
-            // TODO: Check for CALL/RET to update ProcedureCallCount.
+            if (DecodedInst != NULL)
+            {
+                /* Apply the prefixes and skip to the operands */
+                State->PrefixFlags = DecodedInst->PrefixFlags;
+                State->SegmentOverride = DecodedInst->SegmentOverride;
+                State->DecodeInst = DecodedInst;
+
+                if (State->SegmentRegs[FAST486_REG_CS].Size)
+                {
+                    State->InstPtr.Long += DecodedInst->OpcodeOffset - DecodedInst->Offset + 1;
+                }
+                else
+                {
+                    State->InstPtr.LowWord += DecodedInst->OpcodeOffset - DecodedInst->Offset + 1;
+                }
 
-            /* Call the opcode handler */
-            CurrentHandler = Fast486OpcodeHandlers[Opcode];
-            CurrentHandler(State, Opcode);
+                // TODO: Check for CALL/RET to update ProcedureCallCount.
 
-            /* If this is a prefix, go to the next instruction immediately */
-            if (CurrentHandler == Fast486OpcodePrefix) goto NextInst;
+                /* Call the opcode handler */
+                Fast486OpcodeHandlers[DecodedInst->Opcode](State, DecodedInst->Opcode);
+                State->DecodeInst = NULL;
+            }
+            else
+#endif
+            {
+                /* Perform an instruction fetch */
+                if (!Fast486FetchByte(State, &Opcode))
+                {
+                    /* Exception occurred */
+                    State->PrefixFlags = 0;
+                    continue;
+                }
+
+                // TODO: Check for CALL/RET to update ProcedureCallCount.
+
+                /* Call the opcode handler */
+                CurrentHandler = Fast486OpcodeHandlers[Opcode];
+                CurrentHandler(State, Opcode);
+
+                /* If this is a prefix, go to the next instruction immediately */
+                if (CurrentHandler == Fast486OpcodePrefix) goto NextInst;
+            }
 
             /* A non-prefix opcode has been executed, reset the prefix flags */
             State->PrefixFlags = 0;
@@ -0,0 +1,749 @@
+/*
+ * Fast486 386/486 CPU Emulation Library
+ * decode.c
+ *
+ * Copyright (C) 2015 Aleksandar Andrejevic <theflash AT sdf DOT lonestar DOT org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include <windef.h>
+
+// #define NDEBUG
+#include <debug.h>
+
+#include <fast486.h>
+#include "common.h"
+
+#ifndef FAST486_NO_DECODE_CACHE
+
+/* DEFINES ********************************************************************/
+
+#define DECODE_MODRM    (1 << 0)
+#define DECODE_IMM8     (1 << 1)
+#define DECODE_IMM16    (1 << 2)
+#define DECODE_IMMZ     (1 << 3)    /* 16 or 32 bits, depending on the operand size */
+#define DECODE_MOFFS    (1 << 4)    /* 16 or 32 bits, depending on the address size */
+#define DECODE_FARPTR   (1 << 5)    /* Offset followed by a selector */
+#define DECODE_PREFIX   (1 << 6)
+#define DECODE_LAST     (1 << 7)    /* Transfers control, ends the block */
+#define DECODE_STOP     (1 << 8)    /* Never cached, ends the block before it */
+#define DECODE_GROUP    (1 << 9)    /* Operands depend on the REG field */
+#define DECODE_EXT      (1 << 10)   /* Two-byte opcode */
+
+#define DECODE_MAX_INST_LENGTH  15
+#define DECODE_NO_REGISTER      0xFF
+#define DECODE_NO_BLOCK         0xFFFF
+
+#define M   DECODE_MODRM
+#define B   DECODE_IMM8
+#define W   DECODE_IMM16
+#define Z   DECODE_IMMZ
+#define O   DECODE_MOFFS
+#define F   DECODE_FARPTR
+#define P   DECODE_PREFIX
+#define L   DECODE_LAST
+#define S   DECODE_STOP
+#define G   DECODE_GROUP
+#define X   DECODE_EXT
+
+static const USHORT
+Fast486DecodeTable[FAST486_NUM_OPCODE_HANDLERS] =
+{
+    M,   M,   M,   M,   B,   Z,   0,   0,   M,   M,   M,   M,   B,   Z,   0,   X,   /* 0x00 */
+    M,   M,   M,   M,   B,   Z,   0,   0,   M,   M,   M,   M,   B,   Z,   0,   0,   /* 0x10 */
+    M,   M,   M,   M,   B,   Z,   P,   0,   M,   M,   M,   M,   B,   Z,   P,   0,   /* 0x20 */
+    M,   M,   M,   M,   B,   Z,   P,   0,   M,   M,   M,   M,   B,   Z,   P,   0,   /* 0x30 */
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   /* 0x40 */
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   /* 0x50 */
+    0,   0,   M,   M,   P,   P,   P,   P,   Z,   M|Z, B,   M|B, 0,   0,   0,   0,   /* 0x60 */
+    B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   B,   /* 0x70 */
+    M|B, M|Z, M|B, M|B, M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   /* 0x80 */
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   F|L, 0,   0,   0,   0,   0,   /* 0x90 */
+    O,   O,   O,   O,   0,   0,   0,   0,   B,   Z,   0,   0,   0,   0,   0,   0,   /* 0xA0 */
+    B,   B,   B,   B,   B,   B,   B,   B,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   /* 0xB0 */
+    M|B, M|B, W|L, L,   M|G, M,   M|B, M|Z, W|B, 0,   W|L, L,   L,   B|L, L,   L,   /* 0xC0 */
+    M,   M,   M,   M,   B,   B,   0,   0,   M,   M,   M,   M,   M,   M,   M,   M,   /* 0xD0 */
+    B,   B,   B,   B,   B,   B,   B,   B,   Z|L, Z|L, F|L, B|L, 0,   0,   0,   0,   /* 0xE0 */
+    P,   S,   P,   P,   L,   0,   M|G, M|G, 0,   0,   0,   0,   0,   0,   M,   M|G, /* 0xF0 */
+};
+
+static const USHORT
+Fast486DecodeExtTable[FAST486_NUM_OPCODE_HANDLERS] =
+{
+    M|L, M|L, M,   M,   S,   S,   L,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x00 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x10 */
+    M,   M,   M|L, M|L, S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x20 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x30 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x40 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x50 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x60 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0x70 */
+    Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   Z,   /* 0x80 */
+    M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   M,   /* 0x90 */
+    0,   0,   S,   M,   M|B, M,   S,   S,   0,   0,   S,   M,   M|B, M,   S,   M,   /* 0xA0 */
+    M,   M,   M,   M,   M,   M,   M,   M,   S,   S,   M|B, M,   M,   M,   M,   M,   /* 0xB0 */
+    M,   M,   S,   S,   S,   S,   S,   S,   0,   0,   0,   0,   0,   0,   0,   0,   /* 0xC0 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0xD0 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0xE0 */
+    S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   S,   /* 0xF0 */
+};
+
+#undef M
+#undef B
+#undef W
+#undef Z
+#undef O
+#undef F
+#undef P
+#undef L
+#undef S
+#undef G
+#undef X
+
+/* PRIVATE FUNCTIONS **********************************************************/
+
+FORCEINLINE
+ULONGLONG
+Fast486DecodeLines(ULONG Start, ULONG End)
+{
+    ULONG First = PAGE_OFFSET(Start) / FAST486_DECODE_LINE_SIZE;
+    ULONG Last = PAGE_OFFSET(End) / FAST486_DECODE_LINE_SIZE;
+
+    /* Set the bits of all lines from the first to the last one */
+    return ((~0ULL) >> (63 - Last)) & ((~0ULL) << First);
+}
+
+static PFAST486_CODE_PAGE
+FASTCALL
+Fast486FindCodePage(PFAST486_DECODE_CACHE Cache, ULONG Page, BOOLEAN Create)
+{
+    ULONG Index = Fast486DecodeHash(Page) & (FAST486_DECODE_CACHE_PAGES - 1);
+
+    while (TRUE)
+    {
+        PFAST486_CODE_PAGE Entry = &Cache->Pages[Index];
+
+        if (Entry->Generation != Cache->Generation)
+        {
+            /* This is a free entry, the page isn't in the cache */
+            if (!Create) return NULL;
+
+            Entry->Page = Page;
+            Entry->Generation = Cache->Generation;
+            Entry->Lines = 0;
+            Entry->FirstBlock = DECODE_NO_BLOCK;
+            Cache->PageCount++;
+            return Entry;
+        }
+
+        if (Entry->Page == Page) return Entry;
+
+        /* Linear probing */
+        Index = (Index + 1) & (FAST486_DECODE_CACHE_PAGES - 1);
+    }
+}
+
+static VOID
+FASTCALL
+Fast486UnlinkBlock(PFAST486_DECODE_CACHE Cache, PFAST486_DECODED_BLOCK Block)
+{
+    if (Block->PrevBlock != DECODE_NO_BLOCK)
+    {
+        Cache->Blocks[Block->PrevBlock].NextBlock = Block->NextBlock;
+    }
+    else
+    {
+        Cache->Pages[Block->Page].FirstBlock = Block->NextBlock;
+    }
+
+    if (Block->NextBlock != DECODE_NO_BLOCK)
+    {
+        Cache->Blocks[Block->NextBlock].PrevBlock = Block->PrevBlock;
+    }
+
+    /* The block is no longer valid */
+    Block->Generation = 0;
+}
+
+static UCHAR
+FASTCALL
+Fast486DecodeModRegRm(PUCHAR Code,
+                      ULONG Available,
+                      BOOLEAN AddressSize,
+                      PFAST486_DECODED_MODRM ModRegRm)
+{
+    UCHAR ModRmByte, Mode, RegMem;
+    UCHAR Length = 1;
+
+    if (Available < 1) return 0;
+
+    ModRmByte = Code[0];
+    Mode = ModRmByte >> 6;
+    RegMem = ModRmByte & 0x07;
+
+    ModRegRm->Register = (ModRmByte >> 3) & 0x07;
+    ModRegRm->SecondRegister = RegMem;
+    ModRegRm->IndexRegister = DECODE_NO_REGISTER;
+    ModRegRm->Scale = 0;
+    ModRegRm->Displacement = 0;
+    ModRegRm->Flags = AddressSize ? FAST486_DECODED_MODRM_ADSIZE : 0;
+
+    if (Mode == 3)
+    {
+        /* The second operand is also a register */
+        ModRegRm->Length = Length;
+        return Length;
+    }
+
+    /* The second operand is memory */
+    ModRegRm->Flags |= FAST486_DECODED_MODRM_MEMORY;
+
+    if (AddressSize)
+    {
+        if (RegMem == FAST486_REG_ESP)
+        {
+            UCHAR SibByte;
+
+            if (Available < 2) return 0;
+            SibByte = Code[Length++];
+
+            ModRegRm->Scale = SibByte >> 6;
+            if (((SibByte >> 3) & 0x07) != FAST486_REG_ESP)
+            {
+                ModRegRm->IndexRegister = (SibByte >> 3) & 0x07;
+            }
+
+            if (((SibByte & 0x07) != FAST486_REG_EBP) || (Mode != 0))
+            {
+                /* Use the register a base */
+                ModRegRm->SecondRegister = SibByte & 0x07;
+            }
+            else
+            {
+                /* The base is a 32-bit displacement */
+                ModRegRm->SecondRegister = DECODE_NO_REGISTER;
+
+                if (Available < (ULONG)Length + sizeof(LONG)) return 0;
+                ModRegRm->Displacement = *(PLONG)&Code[Length];
+                Length += sizeof(LONG);
+            }
+
+            if (((SibByte & 0x07) == FAST486_REG_ESP)
+                || (((SibByte & 0x07) == FAST486_REG_EBP) && (Mode != 0)))
+            {
+                ModRegRm->Flags |= FAST486_DECODED_MODRM_SS;
+            }
+        }
+        else if ((RegMem == FAST486_REG_EBP) && (Mode == 0))
+        {
+            /* The address is only a displacement */
+            ModRegRm->SecondRegister = DECODE_NO_REGISTER;
+        }
+        else if ((RegMem == FAST486_REG_EBP) && Mode)
+        {
+            ModRegRm->Flags |= FAST486_DECODED_MODRM_SS;
+        }
+
+        if (Mode == 1)
+        {
+            if (Available < (ULONG)Length + sizeof(CHAR)) return 0;
+            ModRegRm->Displacement += (LONG)(CHAR)Code[Length];
+            Length += sizeof(CHAR);
+        }
+        else if ((Mode == 2) || ((Mode == 0) && (RegMem == FAST486_REG_EBP)))
+        {
+            if (Available < (ULONG)Length + sizeof(LONG)) return 0;
+            ModRegRm->Displacement += *(PLONG)&Code[Length];
+            Length += sizeof(LONG);
+        }
+    }
+    else
+    {
+        static const UCHAR BaseRegisters[8] =
+        {
+            FAST486_REG_EBX, FAST486_REG_EBX, FAST486_REG_EBP, FAST486_REG_EBP,
+            FAST486_REG_ESI, FAST486_REG_EDI, FAST486_REG_EBP, FAST486_REG_EBX
+        };
+        static const UCHAR IndexRegisters[8] =
+        {
+            FAST486_REG_ESI, FAST486_REG_EDI, FAST486_REG_ESI, FAST486_REG_EDI,
+            DECODE_NO_REGISTER, DECODE_NO_REGISTER, DECODE_NO_REGISTER, DECODE_NO_REGISTER
+        };
+
+        ModRegRm->SecondRegister = BaseRegisters[RegMem];
+        ModRegRm->IndexRegister = IndexRegisters[RegMem];
+
+        if ((RegMem == 6) && (Mode == 0))
+        {
+            /* [constant] */
+            ModRegRm->SecondRegister = DECODE_NO_REGISTER;
+        }
+
+        if ((RegMem == 2) || (RegMem == 3) || ((RegMem == 6) && Mode))
+        {
+            ModRegRm->Flags |= FAST486_DECODED_MODRM_SS;
+        }
+
+        if (Mode == 1)
+        {
+            if (Available < (ULONG)Length + sizeof(CHAR)) return 0;
+            ModRegRm->Displacement = (LONG)(CHAR)Code[Length];
+            Length += sizeof(CHAR);
+        }
+        else if ((Mode == 2) || ((Mode == 0) && (RegMem == 6)))
+        {
+            if (Available < (ULONG)Length + sizeof(SHORT)) return 0;
+            ModRegRm->Displacement = (LONG)*(PSHORT)&Code[Length];
+            Length += sizeof(SHORT);
+        }
+    }
+
+    ModRegRm->Length = Length;
+    return Length;
+}
+
+static UCHAR
+FASTCALL
+Fast486DecodeInstruction(PFAST486_STATE State,
+                         PUCHAR Code,
+                         ULONG Available,
+                         PFAST486_DECODED_INST Inst,
+                         PBOOLEAN LastInst)
+{
+    BOOLEAN OperandSize, AddressSize;
+    USHORT Flags;
+    ULONG Length = 0;
+    ULONG Immediate = 0;
+
+    OperandSize = AddressSize = State->SegmentRegs[FAST486_REG_CS].Size;
+    Inst->PrefixFlags = 0;
+    Inst->SegmentOverride = FAST486_REG_DS;
+
+    if (Available > DECODE_MAX_INST_LENGTH) Available = DECODE_MAX_INST_LENGTH;
+
+    /* Process the prefixes the same way as Fast486OpcodePrefix */
+    while (TRUE)
+    {
+        if (Length >= Available) return 0;
+
+        Inst->Opcode = Code[Length];
+        Flags = Fast486DecodeTable[Inst->Opcode];
+        if (!(Flags & DECODE_PREFIX)) break;
+
+        switch (Inst->Opcode)
+        {
+            /* Segment overrides */
+            case 0x26:
+            case 0x2E:
+            case 0x36:
+            case 0x3E:
+            case 0x64:
+            case 0x65:
+            {
+                static const UCHAR Segments[] =
+                {
+                    FAST486_REG_ES, FAST486_REG_CS, FAST486_REG_SS, FAST486_REG_DS
+                };
+
+                Inst->PrefixFlags |= FAST486_PREFIX_SEG;
+                Inst->SegmentOverride = (Inst->Opcode < 0x64)
+                                        ? Segments[(Inst->Opcode >> 3) & 0x03]
+                                        : FAST486_REG_FS + (Inst->Opcode & 1);
+                break;
+            }
+
+            /* OPSIZE */
+            case 0x66:
+            {
+                Inst->PrefixFlags |= FAST486_PREFIX_OPSIZE;
+                break;
+            }
+
+            /* ADSIZE */
+            case 0x67:
+            {
+                Inst->PrefixFlags |= FAST486_PREFIX_ADSIZE;
+                break;
+            }
+
+            /* LOCK */
+            case 0xF0:
+            {
+                Inst->PrefixFlags |= FAST486_PREFIX_LOCK;
+                break;
+            }
+
+            /* REPNZ */
+            case 0xF2:
+            {
+                Inst->PrefixFlags |= FAST486_PREFIX_REPNZ;
+                Inst->PrefixFlags &= ~FAST486_PREFIX_REP;
+                break;
+            }
+
+            /* REP / REPZ */
+            case 0xF3:
+            {
+                Inst->PrefixFlags |= FAST486_PREFIX_REP;
+                Inst->PrefixFlags &= ~FAST486_PREFIX_REPNZ;
+                break;
+            }
+        }
+
+        Length++;
+    }
+
+    Inst->OpcodeOffset = Length++;
+    if (Inst->PrefixFlags & FAST486_PREFIX_OPSIZE) OperandSize = !OperandSize;
+    if (Inst->PrefixFlags & FAST486_PREFIX_ADSIZE) AddressSize = !AddressSize;
+
+    if (Flags & DECODE_EXT)
+    {
+        /* Two-byte opcode */
+        if (Length >= Available) return 0;
+        Flags = Fast486DecodeExtTable[Code[Length++]];
+    }
+
+    if (Flags & DECODE_STOP) return 0;
+
+    Inst->ModRegRmOffset = Length;
+    Inst->ModRegRm.Length = 0;
+
+    if (Flags & DECODE_MODRM)
+    {
+        UCHAR Reg;
+
+        if (!Fast486DecodeModRegRm(&Code[Length],
+                                   Available - Length,
+                                   AddressSize,
+                                   &Inst->ModRegRm))
+        {
+            return 0;
+        }
+
+        Length += Inst->ModRegRm.Length;
+        Reg = Inst->ModRegRm.Register;
+
+        if (Flags & DECODE_GROUP)
+        {
+            switch (Inst->Opcode)
+            {
+                case 0xC4:
+                {
+                    /* LES with a register operand is a BOP, never cache it */
+                    if (!(Inst->ModRegRm.Flags & FAST486_DECODED_MODRM_MEMORY)) return 0;
+                    break;
+                }
+
+                case 0xF6:
+                {
+                    /* TEST has an immediate operand */
+                    if (Reg < 2) Flags |= DECODE_IMM8;
+                    break;
+                }
+
+                case 0xF7:
+                {
+                    /* TEST has an immediate operand */
+                    if (Reg < 2) Flags |= DECODE_IMMZ;
+                    break;
+                }
+
+                case 0xFF:
+                {
+                    /* CALL and JMP end the block */
+                    if ((Reg >= 2) && (Reg <= 5)) Flags |= DECODE_LAST;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Add the size of the immediate operands */
+    if (Flags & DECODE_IMM8) Immediate += sizeof(UCHAR);
+    if (Flags & DECODE_IMM16) Immediate += sizeof(USHORT);
+    if (Flags & DECODE_IMMZ) Immediate += OperandSize ? sizeof(ULONG) : sizeof(USHORT);
+    if (Flags & DECODE_MOFFS) Immediate += AddressSize ? sizeof(ULONG) : sizeof(USHORT);
+    if (Flags & DECODE_FARPTR) Immediate += (OperandSize ? sizeof(ULONG) : sizeof(USHORT)) + sizeof(USHORT);
+
+    Length += Immediate;
+    if (Length > Available) return 0;
+
+    *LastInst = ((Flags & DECODE_LAST) != 0);
+    Inst->Length = (UCHAR)Length;
+    return (UCHAR)Length;
+}
+
+static BOOLEAN
+FASTCALL
+Fast486DecodeBlock(PFAST486_STATE State,
+                   ULONG Offset,
+                   UCHAR Mode,
+                   PFAST486_DECODED_BLOCK Block)
+{
+    PFAST486_DECODE_CACHE Cache = State->DecodeCache;
+    PFAST486_SEG_REG CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_CODE_PAGE Page;
+    ULONG LinearAddress = CachedDescriptor->Base + Offset;
+    ULONG PhysicalAddress = LinearAddress;
+    ULONG Size = FAST486_DECODE_BLOCK_SIZE;
+    ULONG Position = 0;
+    BOOLEAN LastInst = FALSE;
+    UCHAR Count = 0;
+
+    /* Evict the previous block */
+    if (Block->Generation == Cache->Generation) Fast486UnlinkBlock(Cache, Block);
+
+    /* Leave the cases that would fault to the normal instruction fetch */
+    if (Offset > CachedDescriptor->Limit) return TRUE;
+
+    /* Blocks never cross a page boundary nor the segment limit */
+    Size = min(Size, FAST486_PAGE_SIZE - PAGE_OFFSET(LinearAddress));
+    Size = min(Size, CachedDescriptor->Limit - Offset + 1);
+    if (!CachedDescriptor->Size) Size = min(Size, 0x10000 - Offset);
+
+    /* Read the first byte with all checks of an instruction fetch */
+    if (!Fast486ReadMemory(State, FAST486_REG_CS, Offset, TRUE, Block->Code, sizeof(UCHAR)))
+    {
+        /* Exception occurred */
+        return FALSE;
+    }
+
+    /* The rest is in the same page, so it can't fault */
+    if ((Size > 1) && !Fast486ReadLinearMemory(State,
+                                               LinearAddress + 1,
+                                               &Block->Code[1],
+                                               Size - 1,
+                                               FALSE))
+    {
+        return FALSE;
+    }
+
+    if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
+    {
+        FAST486_PAGE_TABLE TableEntry;
+
+        /* Writes are tracked by physical address */
+        TableEntry.Value = Fast486GetPageTableEntry(State, LinearAddress, FALSE);
+        PhysicalAddress = (TableEntry.Address << 12) | PAGE_OFFSET(LinearAddress);
+    }
+
+    while (!LastInst && (Count < FAST486_DECODE_BLOCK_INSTS))
+    {
+        PFAST486_DECODED_INST Inst = &Block->Instructions[Count];
+        UCHAR Length;
+
+        Length = Fast486DecodeInstruction(State,
+                                          &Block->Code[Position],
+                                          Size - Position,
+                                          Inst,
+                                          &LastInst);
+        if (Length == 0) break;
+
+        Inst->Offset = (UCHAR)Position;
+        Inst->OpcodeOffset += (UCHAR)Position;
+        Inst->ModRegRmOffset += (UCHAR)Position;
+
+        Position += Length;
+        Count++;
+    }
+
+    /* Nothing to cache */
+    if (Count == 0) return TRUE;
+
+    /* Make room for the page if needed */
+    if (Cache->PageCount >= (FAST486_DECODE_CACHE_PAGES * 3) / 4)
+    {
+        Fast486DecodeCacheFlush(State);
+    }
+
+    Page = Fast486FindCodePage(Cache, PhysicalAddress >> 12, TRUE);
+    Cache->PageFilter[((PhysicalAddress >> 12) % FAST486_DECODE_FILTER_BITS) / 32]
+        |= 1 << ((PhysicalAddress >> 12) % 32);
+    Page->Lines |= Fast486DecodeLines(PhysicalAddress, PhysicalAddress + Position - 1);
+
+    /* Link the block to its page */
+    Block->Page = (USHORT)(Page - Cache->Pages);
+    Block->PrevBlock = DECODE_NO_BLOCK;
+    Block->NextBlock = Page->FirstBlock;
+    if (Page->FirstBlock != DECODE_NO_BLOCK)
+    {
+        Cache->Blocks[Page->FirstBlock].PrevBlock = (USHORT)(Block - Cache->Blocks);
+    }
+    Page->FirstBlock = (USHORT)(Block - Cache->Blocks);
+
+    Block->Address = LinearAddress;
+    Block->PhysicalAddress = PhysicalAddress;
+    Block->Mode = Mode;
+    Block->Count = Count;
+    Block->Size = (UCHAR)Position;
+    Block->Generation = Cache->Generation;
+    return TRUE;
+}
+
+/* PUBLIC FUNCTIONS ***********************************************************/
+
+BOOLEAN
+FASTCALL
+Fast486LookupDecodedInst(PFAST486_STATE State, PFAST486_DECODED_INST *DecodedInst)
+{
+    PFAST486_DECODE_CACHE Cache = State->DecodeCache;
+    PFAST486_SEG_REG CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_DECODED_BLOCK Block = State->DecodeBlock;
+    PFAST486_DECODED_INST Inst;
+    ULONG Offset, LinearAddress, Index, Count, Last;
+    UCHAR Mode;
+
+    Offset = (CachedDescriptor->Size) ? State->InstPtr.Long
+                                      : State->InstPtr.LowWord;
+    LinearAddress = CachedDescriptor->Base + Offset;
+    Mode = (UCHAR)(CachedDescriptor->Size | (Fast486GetCurrentPrivLevel(State) << 1));
+
+    *DecodedInst = NULL;
+    State->DecodeCount = 0;
+
+    if ((Block != NULL)
+        && (Block->Generation == Cache->Generation)
+        && (Block->Mode == Mode)
+        && (State->DecodeIndex > 0)
+        && (LinearAddress == Block->Address
+                             + Block->Instructions[State->DecodeIndex - 1].Offset))
+    {
+        /* A string instruction is being restarted */
+        Index = State->DecodeIndex - 1;
+    }
+    else
+    {
+        /* Look for a block starting here */
+        Block = &Cache->Blocks[Fast486DecodeHash(LinearAddress) & (FAST486_DECODE_CACHE_BLOCKS - 1)];
+        State->DecodeBlock = NULL;
+
+        if ((Block->Generation != Cache->Generation)
+            || (Block->Address != LinearAddress)
+            || (Block->Mode != Mode))
+        {
+            /* Decode a new block */
+            if (!Fast486DecodeBlock(State, Offset, Mode, Block)) return FALSE;
+            if (Block->Generation != Cache->Generation) return TRUE;
+        }
+
+        Index = 0;
+    }
+
+    /*
+     * Count the instructions that can be executed in sequence from here,
+     * each of them must be entirely within the code segment.
+     */
+    Inst = &Block->Instructions[Index];
+    Last = CachedDescriptor->Size ? CachedDescriptor->Limit
+                                  : min(CachedDescriptor->Limit, 0xFFFF);
+    if (Offset > Last) return TRUE;
+
+    if ((ULONG)(Block->Size - Inst->Offset - 1) <= (Last - Offset))
+    {
+        /* The rest of the block is within the segment */
+        Count = Block->Count;
+    }
+    else for (Count = Index; Count < Block->Count; Count++)
+    {
+        ULONG End = Block->Instructions[Count].Offset
+                    + Block->Instructions[Count].Length
+                    - Inst->Offset - 1;
+
+        if (End > Last - Offset) break;
+    }
+
+    if (Count == Index) return TRUE;
+
+    State->DecodeBlock = Block;
+    State->DecodeIndex = Index + 1;
+    State->DecodeCount = Count;
+    *DecodedInst = Inst;
+    return TRUE;
+}
+
+VOID
+FASTCALL
+Fast486DecodeCacheFlush(PFAST486_STATE State)
+{
+    PFAST486_DECODE_CACHE Cache = State->DecodeCache;
+
+    if (Cache == NULL) return;
+
+    /* Changing the generation invalidates all blocks and pages at once */
+    if (++Cache->Generation == 0)
+    {
+        RtlZeroMemory(Cache, sizeof(*Cache));
+        Cache->Generation = 1;
+    }
+
+    Cache->PageCount = 0;
+    RtlZeroMemory(Cache->PageFilter, sizeof(Cache->PageFilter));
+    State->DecodeCount = 0;
+}
+
+VOID
+FASTCALL
+Fast486DecodeCacheInvalidate(PFAST486_STATE State, ULONG PhysicalAddress, ULONG Size)
+{
+    PFAST486_DECODE_CACHE Cache = State->DecodeCache;
+    ULONG Start = PhysicalAddress;
+    ULONG End = PhysicalAddress + Size - 1;
+    ULONG Page;
+
+    for (Page = Start >> 12; Page <= (End >> 12); Page++)
+    {
+        PFAST486_CODE_PAGE Entry = Fast486FindCodePage(Cache, Page, FALSE);
+        ULONGLONG Lines = 0;
+        USHORT Index;
+
+        if (Entry == NULL) continue;
+
+        /* Check the lines first, most writes don't touch any code */
+        if (!(Entry->Lines & Fast486DecodeLines(max(Start, Page << 12),
+                                                min(End, (Page << 12) | 0xFFF))))
+        {
+            continue;
+        }
+
+        for (Index = Entry->FirstBlock; Index != DECODE_NO_BLOCK;)
+        {
+            PFAST486_DECODED_BLOCK Block = &Cache->Blocks[Index];
+            Index = Block->NextBlock;
+
+            if ((Block->PhysicalAddress <= End)
+                && (Start < Block->PhysicalAddress + Block->Size))
+            {
+                /* The code was overwritten */
+                Fast486UnlinkBlock(Cache, Block);
+                if (Block == State->DecodeBlock) State->DecodeCount = 0;
+            }
+            else
+            {
+                Lines |= Fast486DecodeLines(Block->PhysicalAddress,
+                                            Block->PhysicalAddress + Block->Size - 1);
+            }
+        }
+
+        Entry->Lines = Lines;
+    }
+}
+
+#endif
+
+/* EOF */
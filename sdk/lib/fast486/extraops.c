@@ -640,6 +640,11 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeLoadControlReg)
     State->PrefetchValid = FALSE;
 #endif
 
+#ifndef FAST486_NO_DECODE_CACHE
+    /* The same goes for the decode cache */
+    Fast486DecodeCacheFlush(State);
+#endif
+
     if (ModRegRm.Register == (INT)FAST486_REG_CR3)
     {
         /* Flush the TLB */
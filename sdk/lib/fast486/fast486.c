@@ -132,7 +132,7 @@ Fast486Reset(PFAST486_STATE State)
 {
     FAST486_SEG_REGS i;
 
-    /* Save the callbacks and TLB */
+    /* Save the callbacks, TLB, decode cache and FPU mode */
     FAST486_MEM_READ_PROC  MemReadCallback  = State->MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback = State->MemWriteCallback;
     FAST486_IO_READ_PROC   IoReadCallback   = State->IoReadCallback;
@@ -141,6 +141,12 @@ Fast486Reset(PFAST486_STATE State)
     FAST486_INT_ACK_PROC   IntAckCallback   = State->IntAckCallback;
     FAST486_FPU_PROC       FpuCallback      = State->FpuCallback;
     PULONG                 Tlb              = State->Tlb;
+#ifndef FAST486_NO_DECODE_CACHE
+    PFAST486_DECODE_CACHE  DecodeCache      = State->DecodeCache;
+#endif
+#ifndef FAST486_NO_FPU
+    BOOLEAN                FpuHostFloat     = State->FpuHostFloat;
+#endif
 
     /* Clear the entire structure */
     RtlZeroMemory(State, sizeof(*State));
@@ -186,7 +192,7 @@ Fast486Reset(PFAST486_STATE State)
     State->FpuTag = 0xFFFF;
 #endif
 
-    /* Restore the callbacks and TLB */
+    /* Restore the callbacks, TLB, decode cache and FPU mode */
     State->MemReadCallback  = MemReadCallback;
     State->MemWriteCallback = MemWriteCallback;
     State->IoReadCallback   = IoReadCallback;
@@ -195,6 +201,12 @@ Fast486Reset(PFAST486_STATE State)
     State->IntAckCallback   = IntAckCallback;
     State->FpuCallback      = FpuCallback;
     State->Tlb              = Tlb;
+#ifndef FAST486_NO_DECODE_CACHE
+    State->DecodeCache      = DecodeCache;
+#endif
+#ifndef FAST486_NO_FPU
+    State->FpuHostFloat     = FpuHostFloat;
+#endif
 
     /* Flush the TLB */
     Fast486FlushTlb(State);
@@ -258,6 +270,65 @@ Fast486Rewind(PFAST486_STATE State)
 #ifndef FAST486_NO_PREFETCH
     State->PrefetchValid = FALSE;
 #endif
+#ifndef FAST486_NO_DECODE_CACHE
+    State->DecodeInst = NULL;
+#endif
+}
+
+#ifndef FAST486_NO_FPU
+
+VOID
+NTAPI
+Fast486SetFpuHostFloat(PFAST486_STATE State, BOOLEAN Enable)
+{
+    /*
+     * Use the host floating point for the arithmetic and transcendental
+     * instructions, with double instead of extended precision.
+     */
+    State->FpuHostFloat = Enable;
+}
+
+#endif
+
+#ifndef FAST486_NO_DECODE_CACHE
+
+VOID
+NTAPI
+Fast486SetDecodeCache(PFAST486_STATE State, PFAST486_DECODE_CACHE DecodeCache)
+{
+    /* Set the decode cache (NULL disables it) */
+    State->DecodeCache = DecodeCache;
+    State->DecodeBlock = NULL;
+    State->DecodeInst = NULL;
+    State->DecodeCount = 0;
+
+    if (DecodeCache != NULL)
+    {
+        /* Start with an empty cache */
+        RtlZeroMemory(DecodeCache, sizeof(*DecodeCache));
+        DecodeCache->Generation = 1;
+    }
+}
+
+VOID
+NTAPI
+Fast486FlushDecodeCache(PFAST486_STATE State)
+{
+    /* Call the internal function */
+    Fast486DecodeCacheFlush(State);
+}
+
+VOID
+NTAPI
+Fast486InvalidateDecodeCache(PFAST486_STATE State, ULONG PhysicalAddress, ULONG Size)
+{
+    /* This must be called when the host modifies the guest memory directly */
+    if ((State->DecodeCache != NULL) && (Size != 0))
+    {
+        Fast486DecodeCacheInvalidate(State, PhysicalAddress, Size);
+    }
 }
 
+#endif
+
 /* EOF */
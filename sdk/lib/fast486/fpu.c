@@ -22,6 +22,8 @@
 /* INCLUDES *******************************************************************/
 
 #include <windef.h>
+#include <float.h>
+#include <math.h>
 
 // #define NDEBUG
 #include <debug.h>
@@ -1480,6 +1482,333 @@ Fast486FpuCalculateCosine(PFAST486_STATE State,
     return Fast486FpuCalculateSine(State, &Value, Result);
 }
 
+/*
+ * Host floating point support, used when FpuHostFloat is set.
+ *
+ * The operands are rounded to double precision and the operation is done
+ * by the host. Only normal operands and results are handled this way,
+ * everything else (NaNs, infinities, denormals, zero divides, overflows and
+ * underflows) goes through the emulation above, which raises the exceptions.
+ */
+
+typedef union _FPU_HOST_REAL
+{
+    double Value;
+    ULONGLONG Bits;
+} FPU_HOST_REAL;
+
+static inline BOOLEAN FASTCALL
+Fast486FpuToHostReal(PCFAST486_FPU_DATA_REG Value,
+                     double *Result,
+                     PBOOLEAN Inexact)
+{
+    FPU_HOST_REAL Host;
+    LONG Exponent;
+    ULONGLONG Mantissa;
+
+    if (FPU_IS_ZERO(Value))
+    {
+        Host.Bits = (ULONGLONG)Value->Sign << 63;
+        *Result = Host.Value;
+        return TRUE;
+    }
+
+    /* Leave the special values to the emulation */
+    if (FPU_IS_NAN(Value) || !FPU_IS_NORMALIZED(Value)) return FALSE;
+
+    Exponent = (LONG)Value->Exponent - FPU_REAL10_BIAS + FPU_REAL8_BIAS;
+    if ((Exponent <= 0) || (Exponent >= 0x7FF)) return FALSE;
+
+    /* Round the mantissa to 53 bits, to the nearest even number */
+    Mantissa = Value->Mantissa >> 11;
+    if (Value->Mantissa & 0x7FFULL)
+    {
+        *Inexact = TRUE;
+
+        if ((Value->Mantissa & 0x400ULL)
+            && ((Value->Mantissa & 0x3FFULL) || (Mantissa & 1ULL)))
+        {
+            Mantissa++;
+        }
+    }
+
+    /* The explicit high bit of the mantissa is added to the exponent */
+    Host.Bits = ((ULONGLONG)(Exponent - 1) << 52) + Mantissa;
+    if ((Host.Bits >> 52) >= 0x7FF) return FALSE;
+
+    Host.Bits |= (ULONGLONG)Value->Sign << 63;
+    *Result = Host.Value;
+    return TRUE;
+}
+
+static inline VOID FASTCALL
+Fast486FpuFromHostReal(double Value,
+                       PFAST486_FPU_DATA_REG Result)
+{
+    FPU_HOST_REAL Host;
+
+    Host.Value = Value;
+    Result->Sign = (UCHAR)(Host.Bits >> 63);
+
+    if (!(Host.Bits & ~(1ULL << 63)))
+    {
+        Result->Exponent = 0;
+        Result->Mantissa = 0ULL;
+        return;
+    }
+
+    /* This is never called for denormals */
+    Result->Exponent = (USHORT)(((Host.Bits >> 52) & 0x7FF) - FPU_REAL8_BIAS + FPU_REAL10_BIAS);
+    Result->Mantissa = FPU_MANTISSA_HIGH_BIT | ((Host.Bits & ((1ULL << 52) - 1ULL)) << 11);
+}
+
+static inline BOOLEAN FASTCALL
+Fast486FpuIsHostResult(double Value, BOOLEAN ZeroAllowed)
+{
+    double Magnitude = fabs(Value);
+
+    /* Overflows and underflows are left to the emulation */
+    if (Magnitude == 0.0) return ZeroAllowed;
+    return (Magnitude >= DBL_MIN) && (Magnitude <= DBL_MAX);
+}
+
+/*
+ * Checks if the product of two numbers is exactly equal to a third one,
+ * using Dekker's algorithm to get the rounding error of the product.
+ * Large and small numbers are assumed to be inexact.
+ */
+static inline BOOLEAN FASTCALL
+Fast486FpuIsHostProductExact(double First, double Second, double Product)
+{
+    double Result = First * Second;
+    double Temp, FirstHigh, FirstLow, SecondHigh, SecondLow, Error;
+
+    if (Result != Product) return FALSE;
+    if (Product == 0.0) return TRUE;
+
+    if ((fabs(First) > FPU_HOST_EXACT_MAX) || (fabs(Second) > FPU_HOST_EXACT_MAX)
+        || (fabs(Product) > FPU_HOST_EXACT_MAX) || (fabs(Product) < FPU_HOST_EXACT_MIN))
+    {
+        return FALSE;
+    }
+
+    Temp = FPU_HOST_SPLIT_FACTOR * First;
+    FirstHigh = Temp - (Temp - First);
+    FirstLow = First - FirstHigh;
+
+    Temp = FPU_HOST_SPLIT_FACTOR * Second;
+    SecondHigh = Temp - (Temp - Second);
+    SecondLow = Second - SecondHigh;
+
+    Error = (((FirstHigh * SecondHigh - Result) + FirstHigh * SecondLow)
+            + FirstLow * SecondHigh) + FirstLow * SecondLow;
+
+    return (Error == 0.0);
+}
+
+static inline BOOLEAN FASTCALL
+Fast486FpuHostArithmetic(PFAST486_STATE State,
+                         INT Operation,
+                         PCFAST486_FPU_DATA_REG FirstOperand,
+                         PCFAST486_FPU_DATA_REG SecondOperand,
+                         PFAST486_FPU_DATA_REG Result)
+{
+    double First, Second, Value, Temp;
+    BOOLEAN Inexact = FALSE;
+    BOOLEAN ZeroAllowed;
+
+    if (!Fast486FpuToHostReal(FirstOperand, &First, &Inexact)) return FALSE;
+    if (!Fast486FpuToHostReal(SecondOperand, &Second, &Inexact)) return FALSE;
+
+    switch (Operation)
+    {
+        /* FADD */
+        case 0:
+        /* FSUB */
+        case 4:
+        {
+            if (Operation == 4) Second = -Second;
+            Value = First + Second;
+
+            /* Sums can cancel out */
+            ZeroAllowed = TRUE;
+            if (!Fast486FpuIsHostResult(Value, ZeroAllowed)) return FALSE;
+
+            /* Calculate the rounding error (Knuth's two-sum) */
+            Temp = Value - First;
+            if (((First - (Value - Temp)) + (Second - Temp)) != 0.0) Inexact = TRUE;
+
+            break;
+        }
+
+        /* FMUL */
+        case 1:
+        {
+            Value = First * Second;
+
+            ZeroAllowed = (First == 0.0) || (Second == 0.0);
+            if (!Fast486FpuIsHostResult(Value, ZeroAllowed)) return FALSE;
+
+            if (!Fast486FpuIsHostProductExact(First, Second, Value)) Inexact = TRUE;
+            break;
+        }
+
+        /* FDIV */
+        case 6:
+        {
+            /* Let the emulation raise the zero divide exception */
+            if (Second == 0.0) return FALSE;
+
+            Value = First / Second;
+
+            ZeroAllowed = (First == 0.0);
+            if (!Fast486FpuIsHostResult(Value, ZeroAllowed)) return FALSE;
+
+            if (!ZeroAllowed && !Fast486FpuIsHostProductExact(Value, Second, First)) Inexact = TRUE;
+            break;
+        }
+
+        default:
+        {
+            return FALSE;
+        }
+    }
+
+    if (Inexact) State->FpuStatus.Pe = TRUE;
+    Fast486FpuFromHostReal(Value, Result);
+    return TRUE;
+}
+
+static inline BOOLEAN FASTCALL
+Fast486FpuHostSquareRoot(PFAST486_STATE State,
+                         PCFAST486_FPU_DATA_REG Operand,
+                         PFAST486_FPU_DATA_REG Result)
+{
+    double Value;
+    BOOLEAN Inexact = FALSE;
+
+    if (!Fast486FpuToHostReal(Operand, &Value, &Inexact)) return FALSE;
+
+    /* Let the emulation raise the invalid operation exception */
+    if (Value < 0.0) return FALSE;
+
+    if (Value != 0.0)
+    {
+        double Root = sqrt(Value);
+
+        if (!Fast486FpuIsHostProductExact(Root, Root, Value)) Inexact = TRUE;
+        Value = Root;
+    }
+
+    if (Inexact) State->FpuStatus.Pe = TRUE;
+    Fast486FpuFromHostReal(Value, Result);
+    return TRUE;
+}
+
+static inline BOOLEAN FASTCALL
+Fast486FpuHostTrigonometric(PFAST486_STATE State,
+                            PCFAST486_FPU_DATA_REG Operand,
+                            PFAST486_FPU_DATA_REG Sine,
+                            PFAST486_FPU_DATA_REG Cosine,
+                            PFAST486_FPU_DATA_REG Tangent)
+{
+    double Angle, SineValue = 0.0, CosineValue = 0.0, TangentValue = 0.0;
+    BOOLEAN Inexact = FALSE;
+
+    if (!Fast486FpuToHostReal(Operand, &Angle, &Inexact)) return FALSE;
+
+    /* Out of range operands are left to the emulation */
+    if (fabs(Angle) >= FPU_HOST_MAX_ANGLE) return FALSE;
+
+    if (Sine)
+    {
+        SineValue = sin(Angle);
+        if (!Fast486FpuIsHostResult(SineValue, Angle == 0.0)) return FALSE;
+    }
+
+    if (Cosine)
+    {
+        CosineValue = cos(Angle);
+        if (!Fast486FpuIsHostResult(CosineValue, FALSE)) return FALSE;
+    }
+
+    if (Tangent)
+    {
+        TangentValue = tan(Angle);
+        if (!Fast486FpuIsHostResult(TangentValue, Angle == 0.0)) return FALSE;
+    }
+
+    /* The operand is within range */
+    State->FpuStatus.Code2 = FALSE;
+
+    /* The results are only exact for zero */
+    if (Inexact || (Angle != 0.0)) State->FpuStatus.Pe = TRUE;
+
+    if (Sine) Fast486FpuFromHostReal(SineValue, Sine);
+    if (Cosine) Fast486FpuFromHostReal(CosineValue, Cosine);
+    if (Tangent) Fast486FpuFromHostReal(TangentValue, Tangent);
+    return TRUE;
+}
+
+static inline BOOLEAN FASTCALL
+Fast486FpuHostArcTangent(PFAST486_STATE State,
+                         PCFAST486_FPU_DATA_REG Numerator,
+                         PCFAST486_FPU_DATA_REG Denominator,
+                         PFAST486_FPU_DATA_REG Result)
+{
+    double First, Second, Value;
+    BOOLEAN Inexact = FALSE;
+
+    if (!Fast486FpuToHostReal(Numerator, &First, &Inexact)) return FALSE;
+    if (!Fast486FpuToHostReal(Denominator, &Second, &Inexact)) return FALSE;
+
+    /* Leave the signed zero cases to the emulation */
+    if (First == 0.0 || Second == 0.0) return FALSE;
+
+    Value = atan2(First, Second);
+    if (!Fast486FpuIsHostResult(Value, FALSE)) return FALSE;
+
+    State->FpuStatus.Pe = TRUE;
+    Fast486FpuFromHostReal(Value, Result);
+    return TRUE;
+}
+
+static inline BOOLEAN FASTCALL
+Fast486FpuHostLogBase2(PFAST486_STATE State,
+                       PCFAST486_FPU_DATA_REG Operand,
+                       PCFAST486_FPU_DATA_REG Multiplier,
+                       PFAST486_FPU_DATA_REG Result)
+{
+    double Value, Factor, Logarithm;
+    BOOLEAN Inexact = FALSE;
+    int Exponent;
+
+    if (!Fast486FpuToHostReal(Operand, &Value, &Inexact)) return FALSE;
+    if (!Fast486FpuToHostReal(Multiplier, &Factor, &Inexact)) return FALSE;
+
+    /* Let the emulation handle the invalid operands and zero divides */
+    if (Value <= 0.0) return FALSE;
+
+    /* The logarithm of a power of two is exact */
+    if (frexp(Value, &Exponent) == 0.5)
+    {
+        Logarithm = (double)(Exponent - 1);
+    }
+    else
+    {
+        Logarithm = log(Value) / FPU_HOST_LN2;
+        Inexact = TRUE;
+    }
+
+    Value = Logarithm * Factor;
+    if (!Fast486FpuIsHostResult(Value, (Logarithm == 0.0) || (Factor == 0.0))) return FALSE;
+    if (!Fast486FpuIsHostProductExact(Logarithm, Factor, Value)) Inexact = TRUE;
+
+    if (Inexact) State->FpuStatus.Pe = TRUE;
+    Fast486FpuFromHostReal(Value, Result);
+    return TRUE;
+}
+
 static inline VOID FASTCALL
 Fast486FpuArithmeticOperation(PFAST486_STATE State,
                               INT Operation,
@@ -1490,6 +1819,21 @@ Fast486FpuArithmeticOperation(PFAST486_STATE State,
 
     ASSERT(!(Operation & ~7));
 
+    if (FPU_USE_HOST() && (Operation != 2) && (Operation != 3))
+    {
+        BOOLEAN Reverse = (Operation == 5) || (Operation == 7);
+
+        /* Try to let the host do the operation */
+        if (Fast486FpuHostArithmetic(State,
+                                     Reverse ? (Operation - 1) : Operation,
+                                     Reverse ? Operand : &FPU_ST(0),
+                                     Reverse ? &FPU_ST(0) : Operand,
+                                     DestOperand))
+        {
+            return;
+        }
+    }
+
     /* Check the operation */
     switch (Operation)
     {
@@ -2289,6 +2633,15 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                     break;
                 }
 
+                if (FPU_USE_HOST()
+                    && Fast486FpuHostLogBase2(State, &FPU_ST(0), &FPU_ST(1), &FPU_ST(1)))
+                {
+                    /* Pop the stack so that the result ends up in ST0 */
+                    Fast486FpuPop(State);
+                    FPU_UPDATE_TAG(0);
+                    break;
+                }
+
                 if (!Fast486FpuCalculateLogBase2(State, &FPU_ST(0), &Logarithm))
                 {
                     /* Exception occurred */
@@ -2318,6 +2671,16 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                 Fast486FpuExceptionCheck(State);
                 FPU_SAVE_LAST_INST();
 
+                if (FPU_USE_HOST()
+                    && Fast486FpuHostTrigonometric(State, &FPU_ST(0), NULL, NULL, &FPU_ST(0)))
+                {
+                    FPU_UPDATE_TAG(0);
+
+                    /* Push 1.00 */
+                    Fast486FpuPush(State, &FpuOne);
+                    break;
+                }
+
                 /* Compute the sine */
                 if (!Fast486FpuCalculateSine(State, &FPU_ST(0), &Sine)) break;
 
@@ -2332,6 +2695,12 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                     break;
                 }
 
+                /*
+                 * The quotient is truncated, so the remainder of a negative
+                 * angle is negative too and lies in the previous quadrant.
+                 */
+                if (FPU_ST(0).Sign) Quadrant--;
+
                 /* Normalize the quadrant number */
                 Quadrant &= 3;
 
@@ -2358,6 +2727,15 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                 Fast486FpuExceptionCheck(State);
                 FPU_SAVE_LAST_INST();
 
+                if (FPU_USE_HOST()
+                    && Fast486FpuHostArcTangent(State, &FPU_ST(1), &FPU_ST(0), &FPU_ST(1)))
+                {
+                    FPU_UPDATE_TAG(1);
+
+                    Fast486FpuPop(State);
+                    break;
+                }
+
                 if (!Fast486FpuCalculateArcTangent(State,
                                                    &FPU_ST(1),
                                                    &FPU_ST(0),
@@ -2509,7 +2887,12 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                 Fast486FpuExceptionCheck(State);
                 FPU_SAVE_LAST_INST();
 
-                Fast486FpuCalculateSquareRoot(State, &FPU_ST(0), &FPU_ST(0));
+                if (!FPU_USE_HOST()
+                    || !Fast486FpuHostSquareRoot(State, &FPU_ST(0), &FPU_ST(0)))
+                {
+                    Fast486FpuCalculateSquareRoot(State, &FPU_ST(0), &FPU_ST(0));
+                }
+
                 FPU_UPDATE_TAG(0);
 
                 break;
@@ -2539,6 +2922,14 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                     }
                 }
 
+                if (FPU_USE_HOST()
+                    && Fast486FpuHostTrigonometric(State, &Number, &FPU_ST(0), &Number, NULL))
+                {
+                    FPU_UPDATE_TAG(0);
+                    Fast486FpuPush(State, &Number);
+                    break;
+                }
+
                 /* Replace FP0 with the sine */
                 if (!Fast486FpuCalculateSine(State, &Number, &FPU_ST(0))) break;
                 FPU_UPDATE_TAG(0);
@@ -2686,7 +3077,12 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                     }
                 }
 
-                Fast486FpuCalculateSine(State, &FPU_ST(0), &FPU_ST(0));
+                if (!FPU_USE_HOST()
+                    || !Fast486FpuHostTrigonometric(State, &FPU_ST(0), &FPU_ST(0), NULL, NULL))
+                {
+                    Fast486FpuCalculateSine(State, &FPU_ST(0), &FPU_ST(0));
+                }
+
                 FPU_UPDATE_TAG(0);
 
                 break;
@@ -2714,7 +3110,12 @@ FAST486_OPCODE_HANDLER(Fast486FpuOpcodeD9)
                     }
                 }
 
-                Fast486FpuCalculateCosine(State, &FPU_ST(0), &FPU_ST(0));
+                if (!FPU_USE_HOST()
+                    || !Fast486FpuHostTrigonometric(State, &FPU_ST(0), NULL, &FPU_ST(0), NULL))
+                {
+                    Fast486FpuCalculateCosine(State, &FPU_ST(0), &FPU_ST(0));
+                }
+
                 FPU_UPDATE_TAG(0);
 
                 break;
@@ -71,6 +71,15 @@
 #define FPU_IS_NEG_INF(x)       (FPU_IS_INFINITY(x) && (x)->Sign)
 #define FPU_IS_INDEFINITE(x)    (FPU_IS_NAN(x) && !FPU_IS_INFINITY(x))
 
+#define FPU_USE_HOST()          (State->FpuHostFloat \
+                                 && (State->FpuControl.Rc == FPU_ROUND_NEAREST) \
+                                 && (State->FpuControl.Pc != FPU_SINGLE_PRECISION))
+#define FPU_HOST_SPLIT_FACTOR   134217729.0     // 2^27 + 1
+#define FPU_HOST_EXACT_MIN      1e-270          // Smallest result checked for exactness
+#define FPU_HOST_EXACT_MAX      1e270           // Largest result checked for exactness
+#define FPU_HOST_MAX_ANGLE      9223372036854775808.0   // 2^63
+#define FPU_HOST_LN2            0.69314718055994530942
+
 #define INVERSE_NUMBERS_COUNT   50
 
 enum
@@ -4148,6 +4148,11 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeLdsLes)
             /* Call the BOP handler */
             State->BopCallback(State, BopCode);
 
+#ifndef FAST486_NO_DECODE_CACHE
+            /* The BOP handler may have changed the code as well */
+            Fast486DecodeCacheFlush(State);
+#endif
+
             /*
              * If an interrupt should occur at this time, delay it.
              * We must do this because if an interrupt begins and the BOP callback
@@ -2284,6 +2284,11 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeGroup0F01)
                 State->Tlb[ModRegRm.MemoryAddress >> 12] = INVALID_TLB_FIELD;
             }
 
+#ifndef FAST486_NO_DECODE_CACHE
+            /* Decoded blocks of the page may now refer to other code */
+            Fast486DecodeCacheFlush(State);
+#endif
+
             break;
         }
 
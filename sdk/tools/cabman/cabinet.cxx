@@ -18,6 +18,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #if !defined(_WIN32)
 # include <dirent.h>
 # include <sys/stat.h>
@@ -27,6 +30,7 @@
 #include "CCFDATAStorage.h"
 #include "raw.h"
 #include "mszip.h"
+#include "lzx.h"
 
 #ifndef CAB_READ_ONLY
 
@@ -66,6 +70,77 @@ void DumpBuffer(void* Buffer, ULONG Size)
 #endif /* CAB_READ_ONLY */
 
 
+/* CCABCodec */
+
+ULONG CCABCodec::CompressBlocks(PCAB_CODEC_BLOCK Blocks,
+                                ULONG Count,
+                                ULONG ThreadCount)
+/*
+ * FUNCTION: Compresses consecutive data blocks of the current folder
+ * ARGUMENTS:
+ *     Blocks      = Pointer to array of blocks to compress
+ *     Count       = Number of blocks in the array
+ *     ThreadCount = Maximum number of threads to use
+ * RETURNS:
+ *     Status of the first block that failed, CS_SUCCESS otherwise
+ * NOTES:
+ *     The default implementation compresses the blocks one by one,
+ *     codecs without state shared between blocks may override it
+ */
+{
+    ULONG i;
+
+    for (i = 0; i < Count; i++)
+    {
+        Blocks[i].Status = Compress(Blocks[i].OutputBuffer,
+                                    Blocks[i].InputBuffer,
+                                    Blocks[i].InputLength,
+                                    &Blocks[i].OutputLength);
+        if (Blocks[i].Status != CS_SUCCESS)
+            return Blocks[i].Status;
+    }
+
+    return CS_SUCCESS;
+}
+
+
+void CabRunParallel(ULONG Count,
+                    ULONG ThreadCount,
+                    const std::function<void(ULONG)>& Worker)
+/*
+ * FUNCTION: Runs a work item for each index on a pool of threads
+ * ARGUMENTS:
+ *     Count       = Number of work items
+ *     ThreadCount = Maximum number of threads to use
+ *     Worker      = Function called with the index of each work item
+ */
+{
+    std::atomic<ULONG> NextIndex(0);
+    std::vector<std::thread> Threads;
+    ULONG i;
+
+    auto Run = [&]()
+    {
+        ULONG Index;
+
+        while ((Index = NextIndex++) < Count)
+            Worker(Index);
+    };
+
+    if (ThreadCount > Count)
+        ThreadCount = Count;
+
+    /* The calling thread is one of the workers */
+    for (i = 1; i < ThreadCount; i++)
+        Threads.emplace_back(Run);
+
+    Run();
+
+    for (std::thread& Thread : Threads)
+        Thread.join();
+}
+
+
 /* CCabinet */
 
 CCabinet::CCabinet()
@@ -92,6 +167,8 @@ CCabinet::CCabinet()
     MaxDiskSize  = 0;
     BlockIsSplit = false;
     ScratchFile  = NULL;
+    ThreadCount  = 0;
+    PipelineBuffer = NULL;
 
     FolderUncompSize = 0;
     BytesLeftInBlock = 0;
@@ -296,6 +373,8 @@ bool CCabinet::SetCompressionCodec(const char* CodecName)
         SelectCodec(CAB_CODEC_RAW);
     else if( !strcasecmp(CodecName, "mszip") )
         SelectCodec(CAB_CODEC_MSZIP);
+    else if( !strcasecmp(CodecName, "lzx") )
+        SelectCodec(CAB_CODEC_LZX);
     else
     {
         printf("ERROR: Invalid codec specified!\n");
@@ -1041,6 +1120,10 @@ void CCabinet::SelectCodec(LONG Id)
             Codec = new CMSZipCodec();
             break;
 
+        case CAB_CODEC_LZX:
+            Codec = new CLZXCodec();
+            break;
+
         default:
             return;
     }
@@ -1065,13 +1148,24 @@ ULONG CCabinet::NewCabinet()
 
     CurrentDiskNumber = 0;
 
-    OutputBuffer = malloc(CAB_BLOCKSIZE + 12); // This should be enough
-    InputBuffer  = malloc(CAB_BLOCKSIZE + 12); // This should be enough
+    OutputBuffer = malloc(CAB_MAX_COMPSIZE);
+    InputBuffer  = malloc(CAB_MAX_COMPSIZE);
     if ((!OutputBuffer) || (!InputBuffer))
     {
         DPRINT(MIN_TRACE, ("Insufficient memory.\n"));
         return CAB_STATUS_NOMEMORY;
     }
+
+    if (ThreadCount == 0)
+        ThreadCount = std::max(std::thread::hardware_concurrency(), 1U);
+
+    PipelineBuffer = malloc(CAB_PIPELINE_BLOCKS * (CAB_BLOCKSIZE + CAB_MAX_COMPSIZE));
+    if (!PipelineBuffer)
+    {
+        DPRINT(MIN_TRACE, ("Insufficient memory.\n"));
+        return CAB_STATUS_NOMEMORY;
+    }
+    PendingBlocks.clear();
     CurrentIBuffer     = InputBuffer;
     CurrentIBufferSize = 0;
 
@@ -1156,8 +1250,15 @@ ULONG CCabinet::NewFolder()
  *     Status of operation
  */
 {
+    ULONG Status;
+
     DPRINT(MAX_TRACE, ("Creating new folder.\n"));
 
+    /* Queued data blocks belong to the previous folder */
+    Status = FlushDataBlocks();
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     CurrentFolderNode = NewFolderNode();
     if (!CurrentFolderNode)
     {
@@ -1174,10 +1275,16 @@ ULONG CCabinet::NewFolder()
             CurrentFolderNode->Folder.CompressionType = CAB_COMP_MSZIP;
             break;
 
+        case CAB_CODEC_LZX:
+            CurrentFolderNode->Folder.CompressionType = CAB_COMP_LZX | (LZX_WINDOW_BITS << 8);
+            break;
+
         default:
             return CAB_STATUS_UNSUPPCOMP;
     }
 
+    Codec->Reset();
+
     /* FIXME: This won't work if no files are added to the new folder */
 
     DiskSize += sizeof(CFFOLDER);
@@ -1384,6 +1491,11 @@ ULONG CCabinet::WriteDisk(ULONG MoreDisks)
             }
         } while (CreateNewDisk);
     }
+
+    Status = FlushDataBlocks();
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     CommitDisk(MoreDisks);
 
     return CAB_STATUS_SUCCESS;
@@ -1499,6 +1611,12 @@ ULONG CCabinet::CloseCabinet()
         OutputBuffer = NULL;
     }
 
+    if (PipelineBuffer)
+    {
+        free(PipelineBuffer);
+        PipelineBuffer = NULL;
+    }
+
     Close();
 
     if (ScratchFile)
@@ -1727,6 +1845,16 @@ void CCabinet::SetMaxDiskSize(ULONG Size)
     MaxDiskSize = Size;
 }
 
+void CCabinet::SetThreadCount(ULONG Count)
+/*
+ * FUNCTION: Sets the number of threads used for compression
+ * ARGUMENTS:
+ *     Count = Number of threads (0 means one per processor)
+ */
+{
+    ThreadCount = Count;
+}
+
 #endif /* CAB_READ_ONLY */
 
 
@@ -2756,15 +2884,23 @@ ULONG CCabinet::WriteDataBlock()
  */
 {
     ULONG Status;
-    ULONG BytesWritten;
-    PCFDATA_NODE DataNode;
 
     if (!BlockIsSplit)
     {
+        /* Blocks are only split when the disk size is limited, otherwise
+           they can be compressed in parallel before being stored */
+        if (MaxDiskSize == 0)
+            return QueueDataBlock();
+
         Status = Codec->Compress(OutputBuffer,
             InputBuffer,
             CurrentIBufferSize,
             &TotalCompSize);
+        if (Status != CS_SUCCESS)
+        {
+            DPRINT(MIN_TRACE, ("Cannot compress block (%u).\n", (UINT)Status));
+            return (Status == CS_NOMEMORY) ? CAB_STATUS_NOMEMORY : CAB_STATUS_FAILURE;
+        }
 
         DPRINT(MAX_TRACE, ("Block compressed. CurrentIBufferSize (%u)  TotalCompSize(%u).\n",
             (UINT)CurrentIBufferSize, (UINT)TotalCompSize));
@@ -2773,6 +2909,100 @@ ULONG CCabinet::WriteDataBlock()
         CurrentOBufferSize = TotalCompSize;
     }
 
+    return StoreDataBlock();
+}
+
+
+ULONG CCabinet::QueueDataBlock()
+/*
+ * FUNCTION: Queues the current data block for compression
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    CAB_CODEC_BLOCK Block;
+    PUCHAR Buffer;
+
+    Buffer = (PUCHAR)PipelineBuffer + PendingBlocks.size() * (CAB_BLOCKSIZE + CAB_MAX_COMPSIZE);
+
+    Block.InputBuffer  = Buffer;
+    Block.InputLength  = CurrentIBufferSize;
+    Block.OutputBuffer = Buffer + CAB_BLOCKSIZE;
+    Block.OutputLength = 0;
+    Block.Status       = CS_SUCCESS;
+
+    memcpy(Block.InputBuffer, InputBuffer, CurrentIBufferSize);
+    PendingBlocks.push_back(Block);
+
+    CurrentIBufferSize = 0;
+    CurrentIBuffer     = InputBuffer;
+
+    if (PendingBlocks.size() == CAB_PIPELINE_BLOCKS)
+        return FlushDataBlocks();
+
+    return CAB_STATUS_SUCCESS;
+}
+
+
+ULONG CCabinet::FlushDataBlocks()
+/*
+ * FUNCTION: Compresses the queued data blocks and writes them to the scratch file
+ * RETURNS:
+ *     Status of operation
+ * NOTES:
+ *     The blocks are written in the order they were queued, so the
+ *     output does not depend on the number of threads
+ */
+{
+    ULONG Status;
+
+    if (PendingBlocks.empty())
+        return CAB_STATUS_SUCCESS;
+
+    Status = Codec->CompressBlocks(PendingBlocks.data(),
+                                   (ULONG)PendingBlocks.size(),
+                                   ThreadCount);
+    if (Status != CS_SUCCESS)
+    {
+        DPRINT(MIN_TRACE, ("Cannot compress blocks (%u).\n", (UINT)Status));
+        PendingBlocks.clear();
+        return (Status == CS_NOMEMORY) ? CAB_STATUS_NOMEMORY : CAB_STATUS_FAILURE;
+    }
+
+    for (CAB_CODEC_BLOCK& Block : PendingBlocks)
+    {
+        DPRINT(MAX_TRACE, ("Block compressed. InputLength (%u)  OutputLength(%u).\n",
+            (UINT)Block.InputLength, (UINT)Block.OutputLength));
+
+        CurrentIBufferSize = Block.InputLength;
+        CurrentOBuffer     = Block.OutputBuffer;
+        CurrentOBufferSize = Block.OutputLength;
+
+        Status = StoreDataBlock();
+        if (Status != CAB_STATUS_SUCCESS)
+        {
+            PendingBlocks.clear();
+            return Status;
+        }
+    }
+
+    PendingBlocks.clear();
+
+    return CAB_STATUS_SUCCESS;
+}
+
+
+ULONG CCabinet::StoreDataBlock()
+/*
+ * FUNCTION: Writes the current compressed data block to the scratch file
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    ULONG Status;
+    ULONG BytesWritten;
+    PCFDATA_NODE DataNode;
+
     DataNode = NewDataNode(CurrentFolderNode);
     if (!DataNode)
     {
@@ -27,6 +27,8 @@
 #include <limits.h>
 #include <string>
 #include <list>
+#include <vector>
+#include <functional>
 
 #ifndef PATH_MAX
 #define PATH_MAX MAX_PATH
@@ -108,6 +110,7 @@ extern ULONG DebugTraceLevel;
 #define CAB_SIGNATURE        0x4643534D // "MSCF"
 #define CAB_VERSION          0x0103
 #define CAB_BLOCKSIZE        32768
+#define CAB_MAX_COMPSIZE     (CAB_BLOCKSIZE + 6144) // LZX may grow a block by up to 6144 bytes
 
 #define CAB_COMP_MASK        0x00FF
 #define CAB_COMP_NONE        0x0000
@@ -267,6 +270,15 @@ typedef struct _CAB_SEARCH
 
 /* Codecs */
 
+typedef struct _CAB_CODEC_BLOCK
+{
+    void*   InputBuffer;        // Uncompressed data of the block
+    ULONG   InputLength;        // Number of uncompressed bytes
+    void*   OutputBuffer;       // Receives compressed data (CAB_MAX_COMPSIZE bytes)
+    ULONG   OutputLength;       // Number of compressed bytes
+    ULONG   Status;             // Codec status code for this block
+} CAB_CODEC_BLOCK, *PCAB_CODEC_BLOCK;
+
 class CCABCodec
 {
 public:
@@ -284,8 +296,19 @@ public:
                              void* InputBuffer,
                              ULONG InputLength,
                              PULONG OutputLength) = 0;
+    /* Prepares the codec for the first data block of a new folder */
+    virtual void Reset() {};
+    /* Compresses consecutive data blocks of the current folder */
+    virtual ULONG CompressBlocks(PCAB_CODEC_BLOCK Blocks,
+                                 ULONG Count,
+                                 ULONG ThreadCount);
 };
 
+/* Runs Worker(0) ... Worker(Count - 1) on up to ThreadCount threads */
+void CabRunParallel(ULONG Count,
+                    ULONG ThreadCount,
+                    const std::function<void(ULONG)>& Worker);
+
 
 /* Codec status codes */
 #define CS_SUCCESS      0x0000  /* All data consumed */
@@ -293,6 +316,10 @@ public:
 #define CS_BADSTREAM    0x0002  /* Bad data stream */
 
 
+/* Number of data blocks that are compressed together before being written */
+#define CAB_PIPELINE_BLOCKS 256
+
+
 /* Codec indentifiers */
 #define CAB_CODEC_RAW   0x00
 #define CAB_CODEC_LZX   0x01
@@ -377,6 +404,8 @@ public:
     ULONG AddFile(const std::string& FileName, const std::string& TargetFolder);
     /* Sets the maximum size of the current disk */
     void SetMaxDiskSize(ULONG Size);
+    /* Sets the number of threads used for compression (0 = all processors) */
+    void SetThreadCount(ULONG Count);
 #endif /* CAB_READ_ONLY */
 
     /* Default event handlers */
@@ -422,6 +451,9 @@ private:
     ULONG WriteFileEntries();
     ULONG CommitDataBlocks(PCFFOLDER_NODE FolderNode);
     ULONG WriteDataBlock();
+    ULONG StoreDataBlock();
+    ULONG QueueDataBlock();
+    ULONG FlushDataBlocks();
     ULONG GetAttributesOnFile(PCFFILE_NODE File);
     ULONG SetAttributesOnFile(char* FileName, USHORT FileAttributes);
     ULONG GetFileTimes(FILE* FileHandle, PCFFILE_NODE File);
@@ -484,6 +516,9 @@ private:
     ULONG TotalBytesLeft;
     bool BlockIsSplit;                  // true if current data block is split
     ULONG NextFolderNumber;     // Zero based folder number
+    ULONG ThreadCount;          // Number of compression threads
+    void* PipelineBuffer;               // Buffers of the queued data blocks
+    std::vector<CAB_CODEC_BLOCK> PendingBlocks; // Data blocks waiting to be compressed
 #endif /* CAB_READ_ONLY */
 };
 
@@ -0,0 +1,843 @@
+/*
+ * COPYRIGHT:   See COPYING in the top level directory
+ * PROJECT:     ReactOS cabinet manager
+ * FILE:        tools/cabman/lzx.cxx
+ * PURPOSE:     CAB codec for LZX compressed data
+ * NOTES:       Only compression is implemented. Every CFDATA block is
+ *              encoded as a single verbatim (or uncompressed) LZX block,
+ *              so the bitstream is realigned at each 32K frame boundary
+ *              as required by the decoders. Match finding for groups of
+ *              blocks runs in parallel; Huffman coding is sequential since
+ *              code lengths are delta coded against the previous block.
+ */
+#include <algorithm>
+#include <queue>
+#include "lzx.h"
+
+#define LZX_HASH_BITS       16
+#define LZX_MAX_CHAIN       128     /* Hash chain entries to examine */
+#define LZX_NICE_MATCH      128     /* Stop searching once a match is this long */
+
+/* Rough costs in bits used to choose between literals and matches */
+#define LZX_LITERAL_COST    6
+#define LZX_MATCH_COST      8
+#define LZX_REPEAT_COST     6
+
+static const ULONG LZXPositionBase[LZX_NUM_POSITION_SLOTS + 1] =
+{
+          0,       1,       2,       3,       4,       6,       8,      12,
+         16,      24,      32,      48,      64,      96,     128,     192,
+        256,     384,     512,     768,    1024,    1536,    2048,    3072,
+       4096,    6144,    8192,   12288,   16384,   24576,   32768,   49152,
+      65536,   98304,  131072,  196608,  262144,  393216,  524288,  655360,
+     786432,  917504, 1048576, 1179648, 1310720, 1441792, 1572864, 1703936,
+    1835008, 1966080, 2097152
+};
+
+static const UCHAR LZXExtraBits[LZX_NUM_POSITION_SLOTS] =
+{
+     0,  0,  0,  0,  1,  1,  2,  2,  3,  3,  4,  4,  5,  5,  6,  6,
+     7,  7,  8,  8,  9,  9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14,
+    15, 15, 16, 16, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+    17, 17
+};
+
+
+static ULONG LZXGetPositionSlot(ULONG FormattedOffset)
+{
+    return (ULONG)(std::upper_bound(LZXPositionBase,
+                                    LZXPositionBase + LZX_NUM_POSITION_SLOTS + 1,
+                                    FormattedOffset) - LZXPositionBase) - 1;
+}
+
+
+/* Match finder */
+
+typedef struct _LZX_PARSER
+{
+    const UCHAR*        Data;           // Folder history and current blocks
+    ULONG               DataEnd;        // Number of valid bytes in Data
+    ULONG               LookStart;      // First position indexed by the hash chains
+    ULONG               Repeat[LZX_NUM_REPEATED_OFFSETS]; // Repeated offsets, 0 if not known
+    std::vector<LONG>   Head;           // Most recent position for each hash value
+    std::vector<LONG>   Prev;           // Previous position with the same hash value
+} LZX_PARSER, *PLZX_PARSER;
+
+static ULONG LZXHash(const UCHAR* Data)
+{
+    return ((Data[0] | (Data[1] << 8) | (Data[2] << 16)) * 2654435761U) >> (32 - LZX_HASH_BITS);
+}
+
+static void LZXInsertPosition(PLZX_PARSER Parser, ULONG Position)
+{
+    ULONG Hash;
+
+    if (Position + 3 > Parser->DataEnd)
+        return;
+
+    Hash = LZXHash(Parser->Data + Position);
+    Parser->Prev[Position - Parser->LookStart] = Parser->Head[Hash];
+    Parser->Head[Hash] = (LONG)Position;
+}
+
+static ULONG LZXMatchLength(const UCHAR* Source, const UCHAR* Current, ULONG MaxLength)
+{
+    ULONG Length = 0;
+
+    while ((Length < MaxLength) && (Source[Length] == Current[Length]))
+        Length++;
+
+    return Length;
+}
+
+static LONG LZXMatchScore(ULONG Length, ULONG Offset, ULONG Repeat)
+/*
+ * FUNCTION: Estimates the bits saved by a match compared to literals
+ */
+{
+    if (Repeat < LZX_NUM_REPEATED_OFFSETS)
+        return (LONG)(Length * LZX_LITERAL_COST) - LZX_REPEAT_COST;
+
+    return (LONG)(Length * LZX_LITERAL_COST) - LZX_MATCH_COST -
+           LZXExtraBits[LZXGetPositionSlot(Offset + 2)];
+}
+
+static LONG LZXFindMatch(PLZX_PARSER Parser, ULONG Position, ULONG End, PLZX_ITEM Match)
+/*
+ * FUNCTION: Finds the most profitable match at a position
+ * ARGUMENTS:
+ *     Parser   = Pointer to match finder state
+ *     Position = Position to find a match for
+ *     End      = End of the current block (matches must not cross it)
+ *     Match    = Address of buffer to place the match (Length is 0 if none)
+ * RETURNS:
+ *     Estimated bits saved by the match
+ */
+{
+    const UCHAR* Current = Parser->Data + Position;
+    ULONG MaxLength = std::min((ULONG)LZX_MAX_MATCH, End - Position);
+    ULONG Length, Offset, Chain, i;
+    LONG BestScore = 0, Score;
+    LONG Candidate;
+
+    Match->Length = 0;
+
+    if (MaxLength < LZX_MIN_MATCH)
+        return 0;
+
+    /* Repeated offsets need no position footer, so try them first */
+    for (i = 0; i < LZX_NUM_REPEATED_OFFSETS; i++)
+    {
+        Offset = Parser->Repeat[i];
+        if ((Offset == 0) || (Offset > Position - Parser->LookStart))
+            continue;
+
+        Length = LZXMatchLength(Current - Offset, Current, MaxLength);
+        Score = LZXMatchScore(Length, Offset, i);
+        if ((Length >= LZX_MIN_MATCH) && (Score > BestScore))
+        {
+            BestScore     = Score;
+            Match->Length = (USHORT)Length;
+            Match->Offset = Offset;
+            Match->Repeat = (USHORT)i;
+        }
+    }
+
+    if ((MaxLength < 3) || (Match->Length >= MaxLength))
+        return BestScore;
+
+    Candidate = Parser->Head[LZXHash(Current)];
+    for (Chain = 0; (Candidate >= 0) && (Chain < LZX_MAX_CHAIN); Chain++)
+    {
+        Offset = Position - (ULONG)Candidate;
+        if (Offset > LZX_WINDOW_SIZE - 3)
+            break;
+
+        /* Only a longer match can beat the best one, closer candidates come first */
+        if (Parser->Data[Candidate + Match->Length] == Current[Match->Length])
+        {
+            Length = LZXMatchLength(Parser->Data + Candidate, Current, MaxLength);
+            Score = LZXMatchScore(Length, Offset, LZX_NUM_REPEATED_OFFSETS);
+            if ((Length >= 3) && (Score > BestScore))
+            {
+                BestScore     = Score;
+                Match->Length = (USHORT)Length;
+                Match->Offset = Offset;
+                Match->Repeat = LZX_NUM_REPEATED_OFFSETS;
+                if ((Length >= MaxLength) || (Length >= LZX_NICE_MATCH))
+                    break;
+            }
+        }
+
+        Candidate = Parser->Prev[Candidate - Parser->LookStart];
+    }
+
+    return BestScore;
+}
+
+static void LZXUpdateRepeats(PULONG Repeat, const LZX_ITEM* Match)
+/*
+ * FUNCTION: Updates the repeated offsets the way the decoder does
+ * ARGUMENTS:
+ *     Repeat = Pointer to the three repeated offsets
+ *     Match  = Pointer to the match being emitted
+ */
+{
+    ULONG Offset;
+
+    switch (Match->Repeat)
+    {
+        case 0:
+            break;
+
+        case 1:
+        case 2:
+            Offset = Repeat[Match->Repeat];
+            Repeat[Match->Repeat] = Repeat[0];
+            Repeat[0] = Offset;
+            break;
+
+        default:
+            Repeat[2] = Repeat[1];
+            Repeat[1] = Repeat[0];
+            Repeat[0] = Match->Offset;
+            break;
+    }
+}
+
+static void LZXParseSegment(const UCHAR* Data,
+                            ULONG DataEnd,
+                            ULONG Start,
+                            const ULONG* BlockEnds,
+                            ULONG BlockCount,
+                            std::vector<LZX_ITEM>* Items)
+/*
+ * FUNCTION: Splits a group of consecutive blocks into literals and matches
+ * ARGUMENTS:
+ *     Data       = Pointer to folder history followed by the blocks
+ *     DataEnd    = Number of valid bytes in Data
+ *     Start      = Position of the first block
+ *     BlockEnds  = Pointer to array with the end position of each block
+ *     BlockCount = Number of blocks in the group
+ *     Items      = Pointer to array receiving the items of each block
+ * NOTES:
+ *     Each group only indexes a fixed amount of history and only uses repeated
+ *     offsets it has set itself, so the result does not depend on the other
+ *     groups and the output stays the same with any number of threads
+ */
+{
+    LZX_PARSER Parser;
+    LZX_ITEM Current, Next;
+    ULONG Position, End, Block, i;
+    LONG Score, NextScore;
+
+    Parser.Data      = Data;
+    Parser.DataEnd   = DataEnd;
+    Parser.LookStart = (Start > LZX_SEGMENT_LOOKBACK) ? Start - LZX_SEGMENT_LOOKBACK : 0;
+    Parser.Head.assign(1 << LZX_HASH_BITS, -1);
+    Parser.Prev.resize(BlockEnds[BlockCount - 1] - Parser.LookStart);
+
+    /* The decoder starts each folder with all repeated offsets set to 1 */
+    for (i = 0; i < LZX_NUM_REPEATED_OFFSETS; i++)
+        Parser.Repeat[i] = (Start == 0) ? 1 : 0;
+
+    for (Position = Parser.LookStart; Position < Start; Position++)
+        LZXInsertPosition(&Parser, Position);
+
+    for (Block = 0; Block < BlockCount; Block++)
+    {
+        std::vector<LZX_ITEM>& Output = Items[Block];
+
+        End = BlockEnds[Block];
+        Output.clear();
+        Output.reserve(End - Position);
+
+        while (Position < End)
+        {
+            Score = LZXFindMatch(&Parser, Position, End, &Current);
+            LZXInsertPosition(&Parser, Position);
+
+            if (Current.Length == 0)
+            {
+                Output.push_back({ Data[Position], 0, LZX_NUM_REPEATED_OFFSETS });
+                Position++;
+                continue;
+            }
+
+            /* Lazy evaluation: prefer a literal if the next position has a better match */
+            while ((Current.Length < LZX_NICE_MATCH) && (Position + 1 < End))
+            {
+                NextScore = LZXFindMatch(&Parser, Position + 1, End, &Next);
+                if (NextScore <= Score + LZX_LITERAL_COST)
+                    break;
+
+                Output.push_back({ Data[Position], 0, LZX_NUM_REPEATED_OFFSETS });
+                Position++;
+                LZXInsertPosition(&Parser, Position);
+                Current = Next;
+                Score = NextScore;
+            }
+
+            Output.push_back(Current);
+            LZXUpdateRepeats(Parser.Repeat, &Current);
+
+            for (i = 1; i < Current.Length; i++)
+                LZXInsertPosition(&Parser, Position + i);
+            Position += Current.Length;
+        }
+    }
+}
+
+
+/* Huffman coding */
+
+typedef struct _LZX_BITWRITER
+{
+    PUCHAR  Buffer;         // Output buffer
+    ULONG   Size;           // Size of output buffer
+    ULONG   Position;       // Bytes written (may exceed Size on overflow)
+    ULONG   BitBuffer;      // Bits not yet written
+    ULONG   BitCount;       // Number of bits in BitBuffer
+} LZX_BITWRITER, *PLZX_BITWRITER;
+
+static void LZXPutByte(PLZX_BITWRITER Writer, UCHAR Value)
+{
+    if (Writer->Position < Writer->Size)
+        Writer->Buffer[Writer->Position] = Value;
+    Writer->Position++;
+}
+
+static void LZXPutBits(PLZX_BITWRITER Writer, ULONG Value, ULONG Count)
+/*
+ * FUNCTION: Writes bits to the output, most significant bit first
+ * NOTES:
+ *     LZX stores the bitstream as little-endian 16-bit words
+ */
+{
+    ULONG Word;
+
+    if (Count > 16)
+    {
+        LZXPutBits(Writer, Value >> 16, Count - 16);
+        Value &= 0xFFFF;
+        Count = 16;
+    }
+
+    Writer->BitBuffer = (Writer->BitBuffer << Count) | (Value & ((1 << Count) - 1));
+    Writer->BitCount += Count;
+
+    if (Writer->BitCount >= 16)
+    {
+        Writer->BitCount -= 16;
+        Word = Writer->BitBuffer >> Writer->BitCount;
+        LZXPutByte(Writer, (UCHAR)Word);
+        LZXPutByte(Writer, (UCHAR)(Word >> 8));
+    }
+}
+
+static void LZXBuildLengths(const ULONG* Frequencies, ULONG Count, ULONG MaxLength, PUCHAR Lengths)
+/*
+ * FUNCTION: Computes Huffman code lengths limited to MaxLength bits
+ * ARGUMENTS:
+ *     Frequencies = Pointer to array with the frequency of each symbol
+ *     Count       = Number of symbols
+ *     MaxLength   = Maximum code length
+ *     Lengths     = Pointer to array receiving the code lengths
+ * NOTES:
+ *     The decoders reject incomplete codes, so a tree with a single used
+ *     symbol gets an unused second symbol
+ */
+{
+    typedef std::pair<ULONG, ULONG> NODE; /* Weight, index */
+    std::vector<ULONG> Weights, Symbols;
+    ULONG i, Depth, MaxDepth;
+
+    memset(Lengths, 0, Count);
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Frequencies[i] != 0)
+        {
+            Symbols.push_back(i);
+            Weights.push_back(Frequencies[i]);
+        }
+    }
+
+    if (Symbols.empty())
+        return;
+
+    if (Symbols.size() == 1)
+    {
+        Lengths[Symbols[0]] = 1;
+        Lengths[(Symbols[0] == 0) ? 1 : 0] = 1;
+        return;
+    }
+
+    for (;;)
+    {
+        std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE>> Queue;
+        std::vector<ULONG> Parent(2 * Symbols.size() - 1);
+        std::vector<ULONG> Depths(Parent.size());
+        ULONG NextNode = (ULONG)Symbols.size();
+
+        for (i = 0; i < Symbols.size(); i++)
+            Queue.push(NODE(Weights[i], i));
+
+        while (Queue.size() > 1)
+        {
+            NODE Left = Queue.top();
+            Queue.pop();
+            NODE Right = Queue.top();
+            Queue.pop();
+
+            Parent[Left.second] = NextNode;
+            Parent[Right.second] = NextNode;
+            Queue.push(NODE(Left.first + Right.first, NextNode++));
+        }
+
+        /* Parents are always created after their children */
+        MaxDepth = 0;
+        Depths[NextNode - 1] = 0;
+        for (i = NextNode - 1; i-- > 0;)
+        {
+            Depth = Depths[Parent[i]] + 1;
+            Depths[i] = Depth;
+            if ((i < Symbols.size()) && (Depth > MaxDepth))
+                MaxDepth = Depth;
+        }
+
+        if (MaxDepth <= MaxLength)
+        {
+            for (i = 0; i < Symbols.size(); i++)
+                Lengths[Symbols[i]] = (UCHAR)Depths[i];
+            return;
+        }
+
+        /* Flatten the distribution until the tree is shallow enough */
+        for (i = 0; i < Weights.size(); i++)
+            Weights[i] = (Weights[i] >> 1) | 1;
+    }
+}
+
+static void LZXBuildCodes(const UCHAR* Lengths, ULONG Count, PUSHORT Codes)
+/*
+ * FUNCTION: Assigns canonical Huffman codes from code lengths
+ */
+{
+    ULONG LengthCount[LZX_MAX_CODE_LENGTH + 1] = { 0 };
+    ULONG NextCode[LZX_MAX_CODE_LENGTH + 1];
+    ULONG Code = 0, Bits, i;
+
+    for (i = 0; i < Count; i++)
+        LengthCount[Lengths[i]]++;
+    LengthCount[0] = 0;
+
+    for (Bits = 1; Bits <= LZX_MAX_CODE_LENGTH; Bits++)
+    {
+        Code = (Code + LengthCount[Bits - 1]) << 1;
+        NextCode[Bits] = Code;
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Lengths[i] != 0)
+            Codes[i] = (USHORT)NextCode[Lengths[i]]++;
+    }
+}
+
+static void LZXWriteLengths(PLZX_BITWRITER Writer,
+                            const UCHAR* Previous,
+                            const UCHAR* Lengths,
+                            ULONG Count)
+/*
+ * FUNCTION: Writes code lengths through a pretree, as deltas to the previous lengths
+ * ARGUMENTS:
+ *     Writer   = Pointer to bit writer
+ *     Previous = Pointer to code lengths of the previous block
+ *     Lengths  = Pointer to code lengths of this block
+ *     Count    = Number of code lengths
+ */
+{
+    struct { UCHAR Symbol, Extra, Delta; } Tokens[LZX_MAINTREE_ELEMENTS];
+    ULONG Frequencies[LZX_PRETREE_ELEMENTS] = { 0 };
+    UCHAR PreLengths[LZX_PRETREE_ELEMENTS];
+    USHORT PreCodes[LZX_PRETREE_ELEMENTS];
+    ULONG TokenCount = 0, Run, i;
+    UCHAR Delta;
+
+    for (i = 0; i < Count; i += Run)
+    {
+        Delta = (UCHAR)((Previous[i] + 17 - Lengths[i]) % 17);
+
+        for (Run = 1; (i + Run < Count) && (Lengths[i + Run] == Lengths[i]); Run++);
+
+        if ((Lengths[i] == 0) && (Run >= 20))
+        {
+            Run = std::min(Run, (ULONG)51);
+            Tokens[TokenCount++] = { 18, (UCHAR)(Run - 20), 0 };
+        }
+        else if ((Lengths[i] == 0) && (Run >= 4))
+        {
+            Tokens[TokenCount++] = { 17, (UCHAR)(Run - 4), 0 };
+        }
+        else if (Run >= 4)
+        {
+            Run = std::min(Run, (ULONG)5);
+            Tokens[TokenCount++] = { 19, (UCHAR)(Run - 4), Delta };
+            Frequencies[Delta]++;
+        }
+        else
+        {
+            Run = 1;
+            Tokens[TokenCount++] = { Delta, 0, 0 };
+        }
+
+        Frequencies[Tokens[TokenCount - 1].Symbol]++;
+    }
+
+    LZXBuildLengths(Frequencies, LZX_PRETREE_ELEMENTS, LZX_PRETREE_MAX_CODE_LENGTH, PreLengths);
+    LZXBuildCodes(PreLengths, LZX_PRETREE_ELEMENTS, PreCodes);
+
+    for (i = 0; i < LZX_PRETREE_ELEMENTS; i++)
+        LZXPutBits(Writer, PreLengths[i], 4);
+
+    for (i = 0; i < TokenCount; i++)
+    {
+        LZXPutBits(Writer, PreCodes[Tokens[i].Symbol], PreLengths[Tokens[i].Symbol]);
+        switch (Tokens[i].Symbol)
+        {
+            case 17:
+                LZXPutBits(Writer, Tokens[i].Extra, 4);
+                break;
+
+            case 18:
+                LZXPutBits(Writer, Tokens[i].Extra, 5);
+                break;
+
+            case 19:
+                LZXPutBits(Writer, Tokens[i].Extra, 1);
+                LZXPutBits(Writer, PreCodes[Tokens[i].Delta], PreLengths[Tokens[i].Delta]);
+                break;
+        }
+    }
+}
+
+static void LZXGetMatchSymbols(const LZX_ITEM* Match,
+                               PULONG MainSymbol,
+                               PULONG LengthSymbol,
+                               PULONG Footer,
+                               PULONG FooterBits)
+/*
+ * FUNCTION: Splits a match into its main tree symbol, length tree symbol
+ *           (LZX_LENGTH_ELEMENTS if none) and position footer
+ */
+{
+    ULONG LengthHeader = Match->Length - LZX_MIN_MATCH;
+    ULONG Slot, FormattedOffset;
+
+    *LengthSymbol = LZX_LENGTH_ELEMENTS;
+    if (LengthHeader >= LZX_NUM_PRIMARY_LENGTHS)
+    {
+        *LengthSymbol = LengthHeader - LZX_NUM_PRIMARY_LENGTHS;
+        LengthHeader = LZX_NUM_PRIMARY_LENGTHS;
+    }
+
+    if (Match->Repeat < LZX_NUM_REPEATED_OFFSETS)
+    {
+        Slot = Match->Repeat;
+        *Footer = 0;
+        *FooterBits = 0;
+    }
+    else
+    {
+        FormattedOffset = Match->Offset + 2;
+        Slot = LZXGetPositionSlot(FormattedOffset);
+        *Footer = FormattedOffset - LZXPositionBase[Slot];
+        *FooterBits = LZXExtraBits[Slot];
+    }
+
+    *MainSymbol = LZX_NUM_CHARS + ((Slot << 3) | LengthHeader);
+}
+
+
+/* CLZXCodec */
+
+CLZXCodec::CLZXCodec()
+/*
+ * FUNCTION: Default constructor
+ */
+{
+    Reset();
+}
+
+
+CLZXCodec::~CLZXCodec()
+/*
+ * FUNCTION: Default destructor
+ */
+{
+}
+
+
+void CLZXCodec::Reset()
+/*
+ * FUNCTION: Prepares the codec for the first data block of a new folder
+ */
+{
+    ULONG i;
+
+    Window.clear();
+    HeaderWritten = false;
+    for (i = 0; i < LZX_NUM_REPEATED_OFFSETS; i++)
+        RepeatedOffsets[i] = 1;
+    memset(MainLengths, 0, sizeof(MainLengths));
+    memset(LengthLengths, 0, sizeof(LengthLengths));
+}
+
+
+ULONG CLZXCodec::EncodeBlock(PCAB_CODEC_BLOCK Block,
+                             const std::vector<LZX_ITEM>& Items)
+/*
+ * FUNCTION: Encodes the items of a data block as one LZX block
+ * ARGUMENTS:
+ *     Block = Pointer to the data block
+ *     Items = Literals and matches of the block
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    ULONG MainFrequencies[LZX_MAINTREE_ELEMENTS] = { 0 };
+    ULONG LengthFrequencies[LZX_LENGTH_ELEMENTS + 1] = { 0 };
+    UCHAR NewMainLengths[LZX_MAINTREE_ELEMENTS];
+    UCHAR NewLengthLengths[LZX_LENGTH_ELEMENTS];
+    USHORT MainCodes[LZX_MAINTREE_ELEMENTS];
+    USHORT LengthCodes[LZX_LENGTH_ELEMENTS];
+    ULONG MainSymbol, LengthSymbol, Footer, FooterBits;
+    ULONG Repeat[LZX_NUM_REPEATED_OFFSETS];
+    LZX_BITWRITER Writer;
+    PUCHAR Input = (PUCHAR)Block->InputBuffer;
+    ULONG i, j;
+
+    memcpy(Repeat, RepeatedOffsets, sizeof(Repeat));
+
+    for (const LZX_ITEM& Item : Items)
+    {
+        if (Item.Length == 0)
+        {
+            MainFrequencies[Item.Offset]++;
+            continue;
+        }
+
+        LZXGetMatchSymbols(&Item, &MainSymbol, &LengthSymbol, &Footer, &FooterBits);
+        MainFrequencies[MainSymbol]++;
+        LengthFrequencies[LengthSymbol]++;
+        LZXUpdateRepeats(Repeat, &Item);
+    }
+
+    LZXBuildLengths(MainFrequencies, LZX_MAINTREE_ELEMENTS, LZX_MAX_CODE_LENGTH, NewMainLengths);
+    LZXBuildLengths(LengthFrequencies, LZX_LENGTH_ELEMENTS, LZX_MAX_CODE_LENGTH, NewLengthLengths);
+    LZXBuildCodes(NewMainLengths, LZX_MAINTREE_ELEMENTS, MainCodes);
+    LZXBuildCodes(NewLengthLengths, LZX_LENGTH_ELEMENTS, LengthCodes);
+
+    Writer.Buffer    = (PUCHAR)Block->OutputBuffer;
+    Writer.Size      = CAB_MAX_COMPSIZE;
+    Writer.Position  = 0;
+    Writer.BitBuffer = 0;
+    Writer.BitCount  = 0;
+
+    /* No E8 call translation */
+    if (!HeaderWritten)
+        LZXPutBits(&Writer, 0, 1);
+
+    LZXPutBits(&Writer, LZX_BLOCKTYPE_VERBATIM, 3);
+    LZXPutBits(&Writer, Block->InputLength >> 8, 16);
+    LZXPutBits(&Writer, Block->InputLength & 0xFF, 8);
+
+    LZXWriteLengths(&Writer, MainLengths, NewMainLengths, LZX_NUM_CHARS);
+    LZXWriteLengths(&Writer, MainLengths + LZX_NUM_CHARS, NewMainLengths + LZX_NUM_CHARS,
+                    LZX_MAINTREE_ELEMENTS - LZX_NUM_CHARS);
+    LZXWriteLengths(&Writer, LengthLengths, NewLengthLengths, LZX_LENGTH_ELEMENTS);
+
+    for (const LZX_ITEM& Item : Items)
+    {
+        if (Writer.Position > Block->InputLength)
+            break;
+
+        if (Item.Length == 0)
+        {
+            LZXPutBits(&Writer, MainCodes[Item.Offset], NewMainLengths[Item.Offset]);
+            continue;
+        }
+
+        LZXGetMatchSymbols(&Item, &MainSymbol, &LengthSymbol, &Footer, &FooterBits);
+        LZXPutBits(&Writer, MainCodes[MainSymbol], NewMainLengths[MainSymbol]);
+        if (LengthSymbol < LZX_LENGTH_ELEMENTS)
+            LZXPutBits(&Writer, LengthCodes[LengthSymbol], NewLengthLengths[LengthSymbol]);
+        LZXPutBits(&Writer, Footer, FooterBits);
+    }
+
+    /* Each frame ends on a 16-bit boundary */
+    if (Writer.BitCount > 0)
+        LZXPutBits(&Writer, 0, 16 - Writer.BitCount);
+
+    if (Writer.Position <= Block->InputLength)
+    {
+        memcpy(MainLengths, NewMainLengths, sizeof(MainLengths));
+        memcpy(LengthLengths, NewLengthLengths, sizeof(LengthLengths));
+    }
+    else
+    {
+        /* Incompressible data, store it. The decoder keeps its code lengths
+           and takes the repeated offsets from the block header */
+        Writer.Position  = 0;
+        Writer.BitBuffer = 0;
+        Writer.BitCount  = 0;
+
+        if (!HeaderWritten)
+            LZXPutBits(&Writer, 0, 1);
+
+        LZXPutBits(&Writer, LZX_BLOCKTYPE_UNCOMPRESSED, 3);
+        LZXPutBits(&Writer, Block->InputLength >> 8, 16);
+        LZXPutBits(&Writer, Block->InputLength & 0xFF, 8);
+
+        /* Padding up to the next 16-bit boundary, at least 1 bit */
+        LZXPutBits(&Writer, 0, 16 - Writer.BitCount);
+
+        for (i = 0; i < LZX_NUM_REPEATED_OFFSETS; i++)
+        {
+            for (j = 0; j < 4; j++)
+                LZXPutByte(&Writer, (UCHAR)(Repeat[i] >> (j * 8)));
+        }
+
+        for (i = 0; i < Block->InputLength; i++)
+            LZXPutByte(&Writer, Input[i]);
+
+        if (Block->InputLength & 1)
+            LZXPutByte(&Writer, 0);
+    }
+
+    if (Writer.Position > CAB_MAX_COMPSIZE)
+    {
+        DPRINT(MIN_TRACE, ("Compressed block too large (%u).\n", (UINT)Writer.Position));
+        return CS_BADSTREAM;
+    }
+
+    memcpy(RepeatedOffsets, Repeat, sizeof(RepeatedOffsets));
+    HeaderWritten = true;
+    Block->OutputLength = Writer.Position;
+
+    return CS_SUCCESS;
+}
+
+
+ULONG CLZXCodec::CompressBlocks(PCAB_CODEC_BLOCK Blocks,
+                                ULONG Count,
+                                ULONG ThreadCount)
+/*
+ * FUNCTION: Compresses consecutive data blocks of the current folder
+ * ARGUMENTS:
+ *     Blocks      = Pointer to array of blocks to compress
+ *     Count       = Number of blocks in the array
+ *     ThreadCount = Maximum number of threads to use
+ * RETURNS:
+ *     Status of the first block that failed, CS_SUCCESS otherwise
+ */
+{
+    std::vector<std::vector<LZX_ITEM>> Items(Count);
+    std::vector<ULONG> BlockEnds(Count);
+    ULONG HistorySize, SegmentCount, Status, i;
+
+    DPRINT(MAX_TRACE, ("Count (%u).\n", (UINT)Count));
+
+    if (Count == 0)
+        return CS_SUCCESS;
+
+    HistorySize = (ULONG)Window.size();
+    for (i = 0; i < Count; i++)
+    {
+        Window.insert(Window.end(),
+                      (PUCHAR)Blocks[i].InputBuffer,
+                      (PUCHAR)Blocks[i].InputBuffer + Blocks[i].InputLength);
+        BlockEnds[i] = (ULONG)Window.size();
+    }
+
+    SegmentCount = (Count + LZX_SEGMENT_BLOCKS - 1) / LZX_SEGMENT_BLOCKS;
+    CabRunParallel(SegmentCount, ThreadCount, [&](ULONG Segment)
+    {
+        ULONG First = Segment * LZX_SEGMENT_BLOCKS;
+        ULONG Last  = std::min(First + LZX_SEGMENT_BLOCKS, Count);
+
+        LZXParseSegment(Window.data(),
+                        (ULONG)Window.size(),
+                        (First == 0) ? HistorySize : BlockEnds[First - 1],
+                        &BlockEnds[First],
+                        Last - First,
+                        &Items[First]);
+    });
+
+    for (i = 0; i < Count; i++)
+    {
+        Status = EncodeBlock(&Blocks[i], Items[i]);
+        Blocks[i].Status = Status;
+        if (Status != CS_SUCCESS)
+            return Status;
+    }
+
+    /* Only keep what the next blocks can reference */
+    if (Window.size() > LZX_WINDOW_SIZE)
+        Window.erase(Window.begin(), Window.end() - LZX_WINDOW_SIZE);
+
+    return CS_SUCCESS;
+}
+
+
+ULONG CLZXCodec::Compress(void* OutputBuffer,
+                          void* InputBuffer,
+                          ULONG InputLength,
+                          PULONG OutputLength)
+/*
+ * FUNCTION: Compresses data in a buffer
+ * ARGUMENTS:
+ *     OutputBuffer   = Pointer to buffer to place compressed data
+ *     InputBuffer    = Pointer to buffer with data to be compressed
+ *     InputLength    = Length of input buffer
+ *     OutputLength   = Address of buffer to place size of compressed data
+ */
+{
+    CAB_CODEC_BLOCK Block;
+    ULONG Status;
+
+    Block.InputBuffer  = InputBuffer;
+    Block.InputLength  = InputLength;
+    Block.OutputBuffer = OutputBuffer;
+    Block.OutputLength = 0;
+    Block.Status       = CS_SUCCESS;
+
+    Status = CompressBlocks(&Block, 1, 1);
+    *OutputLength = Block.OutputLength;
+
+    return Status;
+}
+
+
+ULONG CLZXCodec::Uncompress(void* OutputBuffer,
+                            void* InputBuffer,
+                            ULONG InputLength,
+                            PULONG OutputLength)
+/*
+ * FUNCTION: Uncompresses data in a buffer
+ * ARGUMENTS:
+ *     OutputBuffer = Pointer to buffer to place uncompressed data
+ *     InputBuffer  = Pointer to buffer with data to be uncompressed
+ *     InputLength  = Length of input buffer
+ *     OutputLength = Address of buffer to place size of uncompressed data
+ * NOTES:
+ *     LZX blocks depend on all previous blocks of the folder, which does
+ *     not fit the block by block extraction of CCabinet
+ */
+{
+    DPRINT(MIN_TRACE, ("LZX decompression is not supported.\n"));
+    return CS_BADSTREAM;
+}
+
+/* EOF */
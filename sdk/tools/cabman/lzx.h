@@ -0,0 +1,79 @@
+/*
+ * COPYRIGHT:   See COPYING in the top level directory
+ * PROJECT:     ReactOS cabinet manager
+ * FILE:        tools/cabman/lzx.h
+ * PURPOSE:     CAB codec for LZX compressed data
+ */
+
+#pragma once
+
+#include "cabinet.h"
+
+/* LZX constants */
+#define LZX_WINDOW_BITS             21
+#define LZX_WINDOW_SIZE             (1 << LZX_WINDOW_BITS)
+#define LZX_MIN_MATCH               2
+#define LZX_MAX_MATCH               257
+#define LZX_NUM_CHARS               256
+#define LZX_NUM_POSITION_SLOTS      50  /* For a window of 2^21 bytes */
+#define LZX_NUM_PRIMARY_LENGTHS     7
+#define LZX_NUM_REPEATED_OFFSETS    3
+#define LZX_MAINTREE_ELEMENTS       (LZX_NUM_CHARS + (LZX_NUM_POSITION_SLOTS << 3))
+#define LZX_LENGTH_ELEMENTS         249
+#define LZX_PRETREE_ELEMENTS        20
+#define LZX_MAX_CODE_LENGTH         16
+#define LZX_PRETREE_MAX_CODE_LENGTH 15
+
+#define LZX_BLOCKTYPE_VERBATIM      1
+#define LZX_BLOCKTYPE_UNCOMPRESSED  3
+
+/* Data blocks whose matches are searched by the same worker thread */
+#define LZX_SEGMENT_BLOCKS          16
+/* Bytes of history a worker indexes before the start of its segment */
+#define LZX_SEGMENT_LOOKBACK        (LZX_WINDOW_SIZE / 2)
+
+/* Literal or match found by the match finder */
+typedef struct _LZX_ITEM
+{
+    ULONG   Offset;     // Match offset, or literal byte if Length is 0
+    USHORT  Length;     // Match length, 0 for literals
+    USHORT  Repeat;     // Repeated offset used by the match, or LZX_NUM_REPEATED_OFFSETS
+} LZX_ITEM, *PLZX_ITEM;
+
+
+/* Classes */
+
+class CLZXCodec : public CCABCodec
+{
+public:
+    /* Default constructor */
+    CLZXCodec();
+    /* Default destructor */
+    virtual ~CLZXCodec();
+    /* Compresses a data block */
+    virtual ULONG Compress(void* OutputBuffer,
+                           void* InputBuffer,
+                           ULONG InputLength,
+                           PULONG OutputLength) override;
+    /* Uncompresses a data block */
+    virtual ULONG Uncompress(void* OutputBuffer,
+                             void* InputBuffer,
+                             ULONG InputLength,
+                             PULONG OutputLength) override;
+    /* Prepares the codec for the first data block of a new folder */
+    virtual void Reset() override;
+    /* Compresses consecutive data blocks of the current folder */
+    virtual ULONG CompressBlocks(PCAB_CODEC_BLOCK Blocks,
+                                 ULONG Count,
+                                 ULONG ThreadCount) override;
+private:
+    ULONG EncodeBlock(PCAB_CODEC_BLOCK Block,
+                      const std::vector<LZX_ITEM>& Items);
+    std::vector<UCHAR> Window;              // Folder history followed by the current blocks
+    bool HeaderWritten;                     // true once the folder header has been written
+    ULONG RepeatedOffsets[LZX_NUM_REPEATED_OFFSETS];
+    UCHAR MainLengths[LZX_MAINTREE_ELEMENTS];   // Code lengths of the last verbatim block
+    UCHAR LengthLengths[LZX_LENGTH_ELEMENTS];
+};
+
+/* EOF */
@@ -63,22 +63,29 @@ ULONG CMSZipCodec::Compress(void* OutputBuffer,
  *     InputBuffer    = Pointer to buffer with data to be compressed
  *     InputLength    = Length of input buffer
  *     OutputLength   = Address of buffer to place size of compressed data
+ * NOTES:
+ *     Uses its own zlib stream, so blocks may be compressed concurrently
  */
 {
     PUSHORT Magic;
+    z_stream Stream;
+    int Status;
 
     DPRINT(MAX_TRACE, ("InputLength (%u).\n", (UINT)InputLength));
 
     Magic  = (PUSHORT)OutputBuffer;
     *Magic = MSZIP_MAGIC;
 
-    ZStream.next_in   = (unsigned char*)InputBuffer;
-    ZStream.avail_in  = InputLength;
-    ZStream.next_out  = ((unsigned char *)OutputBuffer + 2);
-    ZStream.avail_out = CAB_BLOCKSIZE + 12;
+    Stream.zalloc    = MSZipAlloc;
+    Stream.zfree     = MSZipFree;
+    Stream.opaque    = (voidpf)0;
+    Stream.next_in   = (unsigned char*)InputBuffer;
+    Stream.avail_in  = InputLength;
+    Stream.next_out  = ((unsigned char *)OutputBuffer + 2);
+    Stream.avail_out = CAB_BLOCKSIZE + 12;
 
     /* WindowBits is passed < 0 to tell that there is no zlib header */
-    Status = deflateInit2(&ZStream,
+    Status = deflateInit2(&Stream,
                           Z_DEFAULT_COMPRESSION,
                           Z_DEFLATED,
                           -MAX_WBITS,
@@ -90,18 +97,19 @@ ULONG CMSZipCodec::Compress(void* OutputBuffer,
         return CS_NOMEMORY;
     }
 
-    Status = deflate(&ZStream, Z_FINISH);
+    Status = deflate(&Stream, Z_FINISH);
     if ((Status != Z_OK) && (Status != Z_STREAM_END))
     {
-        DPRINT(MIN_TRACE, ("deflate() returned (%d) (%s).\n", Status, ZStream.msg));
+        DPRINT(MIN_TRACE, ("deflate() returned (%d) (%s).\n", Status, Stream.msg));
+        deflateEnd(&Stream);
         if (Status == Z_MEM_ERROR)
             return CS_NOMEMORY;
         return CS_BADSTREAM;
     }
 
-    *OutputLength = ZStream.total_out + 2;
+    *OutputLength = Stream.total_out + 2;
 
-    Status = deflateEnd(&ZStream);
+    Status = deflateEnd(&Stream);
     if (Status != Z_OK)
     {
         DPRINT(MIN_TRACE, ("deflateEnd() returned (%d).\n", Status));
@@ -112,6 +120,42 @@ ULONG CMSZipCodec::Compress(void* OutputBuffer,
 }
 
 
+ULONG CMSZipCodec::CompressBlocks(PCAB_CODEC_BLOCK Blocks,
+                                  ULONG Count,
+                                  ULONG ThreadCount)
+/*
+ * FUNCTION: Compresses consecutive data blocks of the current folder
+ * ARGUMENTS:
+ *     Blocks      = Pointer to array of blocks to compress
+ *     Count       = Number of blocks in the array
+ *     ThreadCount = Maximum number of threads to use
+ * RETURNS:
+ *     Status of the first block that failed, CS_SUCCESS otherwise
+ * NOTES:
+ *     MSZIP blocks do not depend on each other, so they are all
+ *     compressed in parallel
+ */
+{
+    ULONG i;
+
+    CabRunParallel(Count, ThreadCount, [this, Blocks](ULONG Index)
+    {
+        Blocks[Index].Status = Compress(Blocks[Index].OutputBuffer,
+                                        Blocks[Index].InputBuffer,
+                                        Blocks[Index].InputLength,
+                                        &Blocks[Index].OutputLength);
+    });
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Blocks[i].Status != CS_SUCCESS)
+            return Blocks[i].Status;
+    }
+
+    return CS_SUCCESS;
+}
+
+
 ULONG CMSZipCodec::Uncompress(void* OutputBuffer,
                               void* InputBuffer,
                               ULONG InputLength,
@@ -32,6 +32,10 @@ public:
                              void* InputBuffer,
                              ULONG InputLength,
                              PULONG OutputLength) override;
+    /* Compresses consecutive data blocks of the current folder */
+    virtual ULONG CompressBlocks(PCAB_CODEC_BLOCK Blocks,
+                                 ULONG Count,
+                                 ULONG ThreadCount) override;
 private:
     int Status;
     z_stream ZStream; /* Zlib stream */
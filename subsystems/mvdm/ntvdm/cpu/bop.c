@@ -48,6 +48,11 @@ VOID FASTCALL EmulatorBiosOperation(PFAST486_STATE State, UCHAR BopCode)
         BopProc[BopCode](Stack);
     else
         DPRINT1("Invalid BOP code: 0x%02X\n", BopCode);
+
+#ifndef FAST486_NO_DECODE_CACHE
+    /* The handler may have written code to the VDM memory directly (e.g. loaded a program) */
+    Fast486FlushDecodeCache(State);
+#endif
 }
 
 /* EOF */
@@ -39,6 +39,10 @@
 FAST486_STATE EmulatorContext;
 BOOLEAN CpuRunning = FALSE;
 
+#ifndef FAST486_NO_DECODE_CACHE
+static PFAST486_DECODE_CACHE DecodeCache = NULL;
+#endif
+
 /* No more than 'MaxCpuCallLevel' recursive CPU calls are allowed */
 static const INT MaxCpuCallLevel = 32;
 static INT CpuCallLevel = 0; // == 0: CPU stopped; >= 1: CPU running or halted
@@ -233,6 +237,28 @@ BOOLEAN CpuInitialize(VOID)
                       EmulatorFpu,
                       NULL /* TODO: Use a TLB */);
 
+#ifndef FAST486_NO_FPU
+    /* Use the host floating point if the exact FPU emulation isn't needed */
+    Fast486SetFpuHostFloat(&EmulatorContext, GlobalSettings.FpuHostFloat);
+#endif
+
+#ifndef FAST486_NO_DECODE_CACHE
+    /*
+     * The decode cache is invalidated by the writes of the VDM code only.
+     * The 32-bit BIOS and DOS write the VDM memory directly, so the cache
+     * is flushed after each BOP, which makes it a loss for programs that
+     * call them all the time. Therefore it is only used when asked for.
+     */
+    if (GlobalSettings.DecodeCache)
+    {
+        DecodeCache = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*DecodeCache));
+        if (DecodeCache != NULL)
+            Fast486SetDecodeCache(&EmulatorContext, DecodeCache);
+        else
+            DPRINT1("Failed to allocate the decode cache\n");
+    }
+#endif
+
     /* Initialize the software callback system and register the emulator BOPs */
     // RegisterBop(BOP_DEBUGGER  , EmulatorDebugBreakBop);
     RegisterBop(BOP_UNSIMULATE, CpuUnsimulateBop);
@@ -243,6 +269,15 @@ BOOLEAN CpuInitialize(VOID)
 VOID CpuCleanup(VOID)
 {
     // Fast486Cleanup();
+
+#ifndef FAST486_NO_DECODE_CACHE
+    if (DecodeCache != NULL)
+    {
+        Fast486SetDecodeCache(&EmulatorContext, NULL);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, DecodeCache);
+        DecodeCache = NULL;
+    }
+#endif
 }
 
 /* EOF */
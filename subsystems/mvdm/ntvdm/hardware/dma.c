@@ -480,6 +480,9 @@ DWORD DmaRequest(IN WORD      iChannel,
             if (Increment)
             {
                 EmulatorWriteMemory(&EmulatorContext, CurrAddress, dmabuf, length);
+#ifndef FAST486_NO_DECODE_CACHE
+                Fast486InvalidateDecodeCache(&EmulatorContext, CurrAddress, length);
+#endif
             }
             else
             {
@@ -487,6 +490,9 @@ DWORD DmaRequest(IN WORD      iChannel,
                 {
                     EmulatorWriteMemory(&EmulatorContext, CurrAddress - i, dmabuf + i, sizeof(BYTE));
                 }
+#ifndef FAST486_NO_DECODE_CACHE
+                Fast486InvalidateDecodeCache(&EmulatorContext, CurrAddress - length + 1, length);
+#endif
             }
 
             break;
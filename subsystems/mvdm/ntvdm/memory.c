@@ -442,8 +442,19 @@ VdmFlushCache(IN USHORT   Segment,
               IN ULONG    Size,
               IN VDM_MODE Mode)
 {
-    // FIXME
-    UNIMPLEMENTED;
+    if (Size == 0) return TRUE;
+
+    /* Discard the instructions decoded from this range */
+    if (Mode == VDM_V86)
+    {
+        Fast486InvalidateDecodeCache(&EmulatorContext, TO_LINEAR(Segment, Offset), Size);
+    }
+    else
+    {
+        // FIXME: Resolve the selector instead of flushing everything
+        Fast486FlushDecodeCache(&EmulatorContext);
+    }
+
     return TRUE;
 }
 
@@ -163,6 +163,54 @@ NtVdmConfigureHDD(IN PWSTR ValueName,
     return STATUS_SUCCESS;
 }
 
+static NTSTATUS
+NTAPI
+NtVdmConfigureFpu(IN PWSTR ValueName,
+                  IN ULONG ValueType,
+                  IN PVOID ValueData,
+                  IN ULONG ValueLength,
+                  IN PVOID Context,
+                  IN PVOID EntryContext)
+{
+    PNTVDM_SETTINGS Settings = (PNTVDM_SETTINGS)Context;
+
+    /* Check for the type of the value */
+    if (ValueType != REG_DWORD || ValueLength < sizeof(ULONG))
+    {
+        Settings->FpuHostFloat = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    /* Use the host floating point instead of the exact FPU emulation */
+    Settings->FpuHostFloat = (*(PULONG)ValueData != 0);
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+NTAPI
+NtVdmConfigureDecodeCache(IN PWSTR ValueName,
+                          IN ULONG ValueType,
+                          IN PVOID ValueData,
+                          IN ULONG ValueLength,
+                          IN PVOID Context,
+                          IN PVOID EntryContext)
+{
+    PNTVDM_SETTINGS Settings = (PNTVDM_SETTINGS)Context;
+
+    /* Check for the type of the value */
+    if (ValueType != REG_DWORD || ValueLength < sizeof(ULONG))
+    {
+        Settings->DecodeCache = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    /* Keep the decoded instructions of the VDM code between executions */
+    Settings->DecodeCache = (*(PULONG)ValueData != 0);
+
+    return STATUS_SUCCESS;
+}
+
 static RTL_QUERY_REGISTRY_TABLE
 NtVdmConfigurationTable[] =
 {
@@ -246,6 +294,26 @@ NtVdmConfigurationTable[] =
         0
     },
 
+    {
+        NtVdmConfigureFpu,
+        0,
+        L"FpuHostFloat",
+        NULL,
+        REG_NONE,
+        NULL,
+        0
+    },
+
+    {
+        NtVdmConfigureDecodeCache,
+        0,
+        L"DecodeCache",
+        NULL,
+        REG_NONE,
+        NULL,
+        0
+    },
+
     /* End of table */
     {0}
 };
@@ -87,6 +87,8 @@ typedef struct _NTVDM_SETTINGS
     ANSI_STRING RomFiles;
     UNICODE_STRING FloppyDisks[2];
     UNICODE_STRING HardDisks[4];
+    BOOLEAN FpuHostFloat;
+    BOOLEAN DecodeCache;
 } NTVDM_SETTINGS, *PNTVDM_SETTINGS;
 
 extern NTVDM_SETTINGS GlobalSettings;
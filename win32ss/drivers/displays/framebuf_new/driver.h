@@ -50,6 +50,11 @@ typedef struct  _PDEV
 // eVb: 3.1 [DDK Change] - Support new VGA Miniport behavior w.r.t updated framebuffer remapping
     LONG flHooks;
 // eVb: 3.1 [END]
+    HSURF   hsurfShadow;                // Engine's handle to the shadow bitmap
+    SURFOBJ *psoShadow;                 // System memory copy of the screen,
+                                        // NULL when drawing to the frame buffer
+    RECTL   rclDirty;                   // Shadow area not yet copied to the
+                                        // frame buffer
 } PDEV, *PPDEV;
 
 DWORD NTAPI getAvailableModes(HANDLE, PVIDEO_MODE_INFORMATION *, DWORD *);
@@ -60,6 +65,19 @@ BOOL NTAPI bInitPointer(PPDEV, DEVINFO *);
 BOOL NTAPI bInit256ColorPalette(PPDEV);
 VOID NTAPI vDisablePalette(PPDEV);
 VOID NTAPI vDisableSURF(PPDEV);
+BOOL NTAPI bEnableShadow(PPDEV, SIZEL, ULONG);
+VOID NTAPI vDisableShadow(PPDEV);
+VOID NTAPI vFlushShadow(PPDEV);
+VOID NTAPI vRepaintShadow(PPDEV);
+
+//
+// Draw into a system memory shadow of the screen and copy the changed area
+// to the frame buffer after each drawing call.  Reading back uncached video
+// memory is very slow on most adapters, which makes the engine's
+// read-modify-write operations (blending, ROPs, XOR cursors) crawl.
+//
+
+#define ENABLE_SHADOW_SURFACE 1
 
 #define MAX_CLUT_SIZE (sizeof(VIDEO_CLUT) + (sizeof(ULONG) * 256))
 
@@ -22,7 +22,17 @@ static DRVFN gadrvfn[] =
     {   INDEX_DrvSetPalette,            (PFN) DrvSetPalette         },
     {   INDEX_DrvMovePointer,           (PFN) DrvMovePointer        },
     {   INDEX_DrvSetPointerShape,       (PFN) DrvSetPointerShape    },
-    {   INDEX_DrvGetModes,              (PFN) DrvGetModes           }
+    {   INDEX_DrvGetModes,              (PFN) DrvGetModes           },
+#if ENABLE_SHADOW_SURFACE
+    {   INDEX_DrvBitBlt,                (PFN) DrvBitBlt             },
+    {   INDEX_DrvCopyBits,              (PFN) DrvCopyBits           },
+    {   INDEX_DrvAlphaBlend,            (PFN) DrvAlphaBlend         },
+    {   INDEX_DrvTransparentBlt,        (PFN) DrvTransparentBlt     },
+    {   INDEX_DrvGradientFill,          (PFN) DrvGradientFill       },
+    {   INDEX_DrvLineTo,                (PFN) DrvLineTo             },
+    {   INDEX_DrvStrokePath,            (PFN) DrvStrokePath         },
+    {   INDEX_DrvTextOut,               (PFN) DrvTextOut            },
+#endif
 };
 
 // Define the functions you want to hook for 8/16/24/32 pel formats
@@ -35,6 +45,12 @@ static DRVFN gadrvfn[] =
 
 #define HOOKS_BMF32BPP 0
 
+// Everything that draws has to be hooked when drawing into the shadow
+
+#define HOOKS_SHADOW (HOOK_BITBLT | HOOK_COPYBITS | HOOK_ALPHABLEND |       \
+                      HOOK_TRANSPARENTBLT | HOOK_GRADIENTFILL | HOOK_LINETO | \
+                      HOOK_STROKEPATH | HOOK_TEXTOUT)
+
 /******************************Public*Routine******************************\
 * DrvEnableDriver
 *
@@ -243,6 +259,13 @@ DHPDEV dhpdev)
         ulBitmapType = BMF_32BPP;
         flHooks = HOOKS_BMF32BPP;
     }
+
+#if ENABLE_SHADOW_SURFACE
+    if (bEnableShadow(ppdev, sizl, ulBitmapType))
+    {
+        flHooks |= HOOKS_SHADOW;
+    }
+#endif
 // eVb: 1.3 [DDK Change] - Support new VGA Miniport behavior w.r.t updated framebuffer remapping
     ppdev->flHooks = flHooks;
 // eVb: 1.3 [END]
@@ -254,10 +277,35 @@ DHPDEV dhpdev)
     if (hsurf == NULL)
     {
         RIP("DISP DrvEnableSurface failed EngCreateDeviceSurface\n");
+        vDisableShadow(ppdev);
         return NULL;
     }
 // eVb: 1.4 [END]
 
+    if (ppdev->psoShadow)
+    {
+        // The engine never sees the frame buffer, all drawing goes through
+        // the hooks into the shadow.
+
+        if (!EngAssociateSurface(hsurf,
+                                 ppdev->hdevEng,
+                                 ppdev->flHooks | HOOK_SYNCHRONIZE))
+        {
+            RIP("DISP DrvEnableSurface failed EngAssociateSurface\n");
+            EngDeleteSurface(hsurf);
+            vDisableShadow(ppdev);
+            return NULL;
+        }
+
+        ppdev->hsurfEng = hsurf;
+
+        // The shadow starts out zeroed, make the screen match it.
+
+        vRepaintShadow(ppdev);
+
+        return hsurf;
+    }
+
 // eVb: 1.5 [DDK Change] - Use EngModifySurface instead of EngAssociateSurface
     if ( !EngModifySurface(hsurf,
                            ppdev->hdevEng,
@@ -288,6 +336,7 @@ VOID NTAPI DrvDisableSurface(
 DHPDEV dhpdev)
 {
     EngDeleteSurface(((PPDEV) dhpdev)->hsurfEng);
+    vDisableShadow((PPDEV) dhpdev);
     vDisableSURF((PPDEV) dhpdev);
     ((PPDEV) dhpdev)->hsurfEng = NULL;
 }
@@ -321,7 +370,14 @@ BOOL bEnable)
             return FALSE;
         }
 
-        if (pjScreen != ppdev->pjScreen) {
+        if (ppdev->psoShadow)
+        {
+            // The mode set cleared the frame buffer, the shadow still
+            // holds the screen contents.
+
+            vRepaintShadow(ppdev);
+        }
+        else if (pjScreen != ppdev->pjScreen) {
 
             if ( !EngModifySurface(ppdev->hsurfEng,
                                    ppdev->hdevEng,
@@ -0,0 +1,471 @@
+/*
+ * PROJECT:         ReactOS Framebuffer Display Driver
+ * LICENSE:         Microsoft NT4 DDK Sample Code License
+ * FILE:            win32ss/drivers/displays/framebuf_new/shadow.c
+ * PURPOSE:         System memory shadow of the frame buffer
+ * PROGRAMMERS:     ReactOS Portable Systems Group
+ */
+
+#include "driver.h"
+
+/*
+ * When the shadow is enabled the primary surface is a device surface
+ * without bits.  Every drawing call is hooked, punted to the engine on the
+ * system memory shadow bitmap and the touched area is then copied to the
+ * frame buffer.  Reads (alpha blending, XOR cursors, ROPs using the
+ * destination) never touch video memory, and the frame buffer only sees
+ * sequential row writes.
+ */
+
+/******************************Private*Routine*****************************\
+* vShadowDirty
+*
+* Adds the part of prcl inside the clip bounds to the dirty rectangle.
+* A NULL prcl stands for the whole clip area.
+*
+\**************************************************************************/
+
+static VOID vShadowDirty(PPDEV ppdev, CLIPOBJ *pco, RECTL *prcl)
+{
+    RECTL rcl;
+
+    if (prcl)
+    {
+        rcl.left   = min(prcl->left, prcl->right);
+        rcl.right  = max(prcl->left, prcl->right);
+        rcl.top    = min(prcl->top, prcl->bottom);
+        rcl.bottom = max(prcl->top, prcl->bottom);
+    }
+    else
+    {
+        rcl.left   = 0;
+        rcl.top    = 0;
+        rcl.right  = ppdev->cxScreen;
+        rcl.bottom = ppdev->cyScreen;
+    }
+
+    if (pco && pco->iDComplexity != DC_TRIVIAL)
+    {
+        rcl.left   = max(rcl.left, pco->rclBounds.left);
+        rcl.top    = max(rcl.top, pco->rclBounds.top);
+        rcl.right  = min(rcl.right, pco->rclBounds.right);
+        rcl.bottom = min(rcl.bottom, pco->rclBounds.bottom);
+    }
+
+    rcl.left   = max(rcl.left, 0);
+    rcl.top    = max(rcl.top, 0);
+    rcl.right  = min(rcl.right, (LONG)ppdev->cxScreen);
+    rcl.bottom = min(rcl.bottom, (LONG)ppdev->cyScreen);
+
+    if (rcl.left >= rcl.right || rcl.top >= rcl.bottom)
+        return;
+
+    if (ppdev->rclDirty.left >= ppdev->rclDirty.right)
+    {
+        ppdev->rclDirty = rcl;
+    }
+    else
+    {
+        ppdev->rclDirty.left   = min(ppdev->rclDirty.left, rcl.left);
+        ppdev->rclDirty.top    = min(ppdev->rclDirty.top, rcl.top);
+        ppdev->rclDirty.right  = max(ppdev->rclDirty.right, rcl.right);
+        ppdev->rclDirty.bottom = max(ppdev->rclDirty.bottom, rcl.bottom);
+    }
+}
+
+/******************************Public*Routine******************************\
+* vFlushShadow
+*
+* Copies the dirty rectangle of the shadow to the frame buffer.
+*
+\**************************************************************************/
+
+VOID NTAPI vFlushShadow(PPDEV ppdev)
+{
+    SURFOBJ *psoShadow = ppdev->psoShadow;
+    ULONG cjPixel = ppdev->ulBitCount / 8;
+    ULONG cjRow;
+    LONG  cy;
+    PBYTE pjSrc;
+    PBYTE pjDst;
+
+    if (ppdev->rclDirty.left >= ppdev->rclDirty.right)
+        return;
+
+    cjRow = (ppdev->rclDirty.right - ppdev->rclDirty.left) * cjPixel;
+    cy = ppdev->rclDirty.bottom - ppdev->rclDirty.top;
+
+    pjSrc = (PBYTE)psoShadow->pvScan0 + ppdev->rclDirty.top * psoShadow->lDelta +
+            ppdev->rclDirty.left * cjPixel;
+    pjDst = ppdev->pjScreen + ppdev->rclDirty.top * ppdev->lDeltaScreen +
+            ppdev->rclDirty.left * cjPixel;
+
+    if (psoShadow->lDelta == ppdev->lDeltaScreen &&
+        cjRow == ppdev->cxScreen * cjPixel)
+    {
+        // Full scanlines with the same stride are one contiguous block.
+
+        memcpy(pjDst, pjSrc, (cy - 1) * ppdev->lDeltaScreen + cjRow);
+    }
+    else
+    {
+        while (cy--)
+        {
+            memcpy(pjDst, pjSrc, cjRow);
+            pjSrc += psoShadow->lDelta;
+            pjDst += ppdev->lDeltaScreen;
+        }
+    }
+
+    ppdev->rclDirty.left = ppdev->rclDirty.right = 0;
+}
+
+/******************************Public*Routine******************************\
+* bEnableShadow
+*
+* Allocates the shadow bitmap.  On failure the driver keeps drawing
+* straight into the frame buffer.
+*
+\**************************************************************************/
+
+BOOL NTAPI bEnableShadow(PPDEV ppdev, SIZEL sizl, ULONG ulBitmapType)
+{
+    ppdev->hsurfShadow = (HSURF)EngCreateBitmap(sizl, 0, ulBitmapType, BMF_TOPDOWN, NULL);
+
+    if (ppdev->hsurfShadow == NULL)
+    {
+        DISPDBG((0, "bEnableShadow failed EngCreateBitmap\n"));
+        return FALSE;
+    }
+
+    ppdev->psoShadow = EngLockSurface(ppdev->hsurfShadow);
+
+    if (ppdev->psoShadow == NULL)
+    {
+        DISPDBG((0, "bEnableShadow failed EngLockSurface\n"));
+        EngDeleteSurface(ppdev->hsurfShadow);
+        ppdev->hsurfShadow = NULL;
+        return FALSE;
+    }
+
+    ppdev->rclDirty.left = ppdev->rclDirty.right = 0;
+
+    return TRUE;
+}
+
+/******************************Public*Routine******************************\
+* vDisableShadow
+*
+* Frees the shadow bitmap.
+*
+\**************************************************************************/
+
+VOID NTAPI vDisableShadow(PPDEV ppdev)
+{
+    if (ppdev->psoShadow)
+    {
+        EngUnlockSurface(ppdev->psoShadow);
+        ppdev->psoShadow = NULL;
+    }
+
+    if (ppdev->hsurfShadow)
+    {
+        EngDeleteSurface(ppdev->hsurfShadow);
+        ppdev->hsurfShadow = NULL;
+    }
+}
+
+/******************************Public*Routine******************************\
+* vRepaintShadow
+*
+* Copies the whole shadow to the frame buffer, used once the mode has been
+* set again.
+*
+\**************************************************************************/
+
+VOID NTAPI vRepaintShadow(PPDEV ppdev)
+{
+    vShadowDirty(ppdev, NULL, NULL);
+    vFlushShadow(ppdev);
+}
+
+/******************************Public*Routine******************************\
+* DrvBitBlt
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvBitBlt(
+SURFOBJ  *psoTrg,
+SURFOBJ  *psoSrc,
+SURFOBJ  *psoMask,
+CLIPOBJ  *pco,
+XLATEOBJ *pxlo,
+RECTL    *prclTrg,
+POINTL   *pptlSrc,
+POINTL   *pptlMask,
+BRUSHOBJ *pbo,
+POINTL   *pptlBrush,
+ROP4      rop4)
+{
+    PPDEV ppdev = NULL;
+    BOOL  bRet;
+
+    if (psoTrg->iType == STYPE_DEVICE)
+    {
+        ppdev = (PPDEV)psoTrg->dhpdev;
+        psoTrg = ppdev->psoShadow;
+    }
+
+    if (psoSrc && psoSrc->iType == STYPE_DEVICE)
+        psoSrc = ((PPDEV)psoSrc->dhpdev)->psoShadow;
+
+    bRet = EngBitBlt(psoTrg, psoSrc, psoMask, pco, pxlo, prclTrg, pptlSrc,
+                     pptlMask, pbo, pptlBrush, rop4);
+
+    if (ppdev)
+    {
+        vShadowDirty(ppdev, pco, prclTrg);
+        vFlushShadow(ppdev);
+    }
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvCopyBits
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvCopyBits(
+SURFOBJ  *psoDest,
+SURFOBJ  *psoSrc,
+CLIPOBJ  *pco,
+XLATEOBJ *pxlo,
+RECTL    *prclDest,
+POINTL   *pptlSrc)
+{
+    PPDEV ppdev = NULL;
+    BOOL  bRet;
+
+    if (psoDest->iType == STYPE_DEVICE)
+    {
+        ppdev = (PPDEV)psoDest->dhpdev;
+        psoDest = ppdev->psoShadow;
+    }
+
+    if (psoSrc->iType == STYPE_DEVICE)
+        psoSrc = ((PPDEV)psoSrc->dhpdev)->psoShadow;
+
+    bRet = EngCopyBits(psoDest, psoSrc, pco, pxlo, prclDest, pptlSrc);
+
+    if (ppdev)
+    {
+        vShadowDirty(ppdev, pco, prclDest);
+        vFlushShadow(ppdev);
+    }
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvAlphaBlend
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvAlphaBlend(
+SURFOBJ  *psoDest,
+SURFOBJ  *psoSrc,
+CLIPOBJ  *pco,
+XLATEOBJ *pxlo,
+RECTL    *prclDest,
+RECTL    *prclSrc,
+BLENDOBJ *pBlendObj)
+{
+    PPDEV ppdev = NULL;
+    BOOL  bRet;
+
+    if (psoDest->iType == STYPE_DEVICE)
+    {
+        ppdev = (PPDEV)psoDest->dhpdev;
+        psoDest = ppdev->psoShadow;
+    }
+
+    if (psoSrc->iType == STYPE_DEVICE)
+        psoSrc = ((PPDEV)psoSrc->dhpdev)->psoShadow;
+
+    bRet = EngAlphaBlend(psoDest, psoSrc, pco, pxlo, prclDest, prclSrc, pBlendObj);
+
+    if (ppdev)
+    {
+        vShadowDirty(ppdev, pco, prclDest);
+        vFlushShadow(ppdev);
+    }
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvTransparentBlt
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvTransparentBlt(
+SURFOBJ  *psoDst,
+SURFOBJ  *psoSrc,
+CLIPOBJ  *pco,
+XLATEOBJ *pxlo,
+RECTL    *prclDst,
+RECTL    *prclSrc,
+ULONG     iTransColor,
+ULONG     ulReserved)
+{
+    PPDEV ppdev = NULL;
+    BOOL  bRet;
+
+    if (psoDst->iType == STYPE_DEVICE)
+    {
+        ppdev = (PPDEV)psoDst->dhpdev;
+        psoDst = ppdev->psoShadow;
+    }
+
+    if (psoSrc->iType == STYPE_DEVICE)
+        psoSrc = ((PPDEV)psoSrc->dhpdev)->psoShadow;
+
+    bRet = EngTransparentBlt(psoDst, psoSrc, pco, pxlo, prclDst, prclSrc,
+                             iTransColor, ulReserved);
+
+    if (ppdev)
+    {
+        vShadowDirty(ppdev, pco, prclDst);
+        vFlushShadow(ppdev);
+    }
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvGradientFill
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvGradientFill(
+SURFOBJ   *pso,
+CLIPOBJ   *pco,
+XLATEOBJ  *pxlo,
+TRIVERTEX *pVertex,
+ULONG      nVertex,
+PVOID      pMesh,
+ULONG      nMesh,
+RECTL     *prclExtents,
+POINTL    *pptlDitherOrg,
+ULONG      ulMode)
+{
+    PPDEV ppdev = (PPDEV)pso->dhpdev;
+    BOOL  bRet;
+
+    bRet = EngGradientFill(ppdev->psoShadow, pco, pxlo, pVertex, nVertex,
+                           pMesh, nMesh, prclExtents, pptlDitherOrg, ulMode);
+
+    vShadowDirty(ppdev, pco, prclExtents);
+    vFlushShadow(ppdev);
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvLineTo
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvLineTo(
+SURFOBJ  *pso,
+CLIPOBJ  *pco,
+BRUSHOBJ *pbo,
+LONG      x1,
+LONG      y1,
+LONG      x2,
+LONG      y2,
+RECTL    *prclBounds,
+MIX       mix)
+{
+    PPDEV ppdev = (PPDEV)pso->dhpdev;
+    BOOL  bRet;
+
+    bRet = EngLineTo(ppdev->psoShadow, pco, pbo, x1, y1, x2, y2, prclBounds, mix);
+
+    vShadowDirty(ppdev, pco, prclBounds);
+    vFlushShadow(ppdev);
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvStrokePath
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvStrokePath(
+SURFOBJ   *pso,
+PATHOBJ   *ppo,
+CLIPOBJ   *pco,
+XFORMOBJ  *pxo,
+BRUSHOBJ  *pbo,
+POINTL    *pptlBrushOrg,
+LINEATTRS *plineattrs,
+MIX        mix)
+{
+    PPDEV ppdev = (PPDEV)pso->dhpdev;
+    BOOL  bRet;
+
+    bRet = EngStrokePath(ppdev->psoShadow, ppo, pco, pxo, pbo, pptlBrushOrg,
+                         plineattrs, mix);
+
+    // Wide lines may reach past the path bounds, use the clip bounds.
+
+    vShadowDirty(ppdev, pco, NULL);
+    vFlushShadow(ppdev);
+
+    return bRet;
+}
+
+/******************************Public*Routine******************************\
+* DrvTextOut
+*
+\**************************************************************************/
+
+BOOL NTAPI DrvTextOut(
+SURFOBJ  *pso,
+STROBJ   *pstro,
+FONTOBJ  *pfo,
+CLIPOBJ  *pco,
+RECTL    *prclExtra,
+RECTL    *prclOpaque,
+BRUSHOBJ *pboFore,
+BRUSHOBJ *pboOpaque,
+POINTL   *pptlOrg,
+MIX       mix)
+{
+    PPDEV ppdev = (PPDEV)pso->dhpdev;
+    BOOL  bRet;
+
+    bRet = EngTextOut(ppdev->psoShadow, pstro, pfo, pco, prclExtra, prclOpaque,
+                      pboFore, pboOpaque, pptlOrg, mix);
+
+    // Underlines and strikeouts may lie outside the background rectangle.
+
+    if (prclExtra)
+    {
+        vShadowDirty(ppdev, pco, NULL);
+    }
+    else
+    {
+        vShadowDirty(ppdev, pco, &pstro->rclBkGround);
+
+        if (prclOpaque)
+            vShadowDirty(ppdev, pco, prclOpaque);
+    }
+
+    vFlushShadow(ppdev);
+
+    return bRet;
+}
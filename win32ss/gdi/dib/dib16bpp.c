@@ -140,6 +140,39 @@ DIB_16BPP_VLine(SURFOBJ *SurfObj, LONG x, LONG y1, LONG y2, ULONG c)
 #endif
 }
 
+/* Copies that are not mirrored left to right translate a whole row per call.
+ * SourceLine is the first source row to copy, the rest follow it downwards
+ * or upwards for bTopToBottom */
+static BOOLEAN
+DIB_16BPP_BitBltSrcCopyRows(PBLTINFO BltInfo, PBYTE SourceLine, PBYTE DestLine,
+                            BOOLEAN bTopToBottom)
+{
+  LONG DestWidth = BltInfo->DestRect.right - BltInfo->DestRect.left;
+  LONG DestHeight = BltInfo->DestRect.bottom - BltInfo->DestRect.top;
+  DIB_ROW_CONTEXT RowContext;
+  XLATEROW XlateRow;
+  LONG j;
+
+  if (!EXLATEOBJ_bInitXlateRow(&XlateRow, BltInfo->XlateSourceToDest,
+                               BltInfo->SourceSurface->iBitmapFormat, BMF_16BPP,
+                               DIB_BeginRowOperation(&RowContext, DestWidth * DestHeight)))
+  {
+    DIB_EndRowOperation(&RowContext);
+    return FALSE;
+  }
+
+  for (j = 0; j < DestHeight; j++)
+  {
+    XLATEROW_vXlate(&XlateRow, DestLine, SourceLine, DestWidth);
+    DEC_OR_INC(SourceLine, bTopToBottom, BltInfo->SourceSurface->lDelta);
+    DestLine += BltInfo->DestSurface->lDelta;
+  }
+
+  DIB_EndRowOperation(&RowContext);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 {
@@ -287,6 +320,12 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         * (BltInfo->DestRect.bottom - BltInfo->DestRect.top - 1);
     }
 
+    if (!bLeftToRight &&
+        DIB_16BPP_BitBltSrcCopyRows(BltInfo, SourceLine, DestLine, bTopToBottom))
+    {
+      break;
+    }
+
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
@@ -593,6 +632,12 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
     }
     DestLine = DestBits;
 
+    if (!bLeftToRight &&
+        DIB_16BPP_BitBltSrcCopyRows(BltInfo, SourceLine, DestLine, bTopToBottom))
+    {
+      break;
+    }
+
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
@@ -634,6 +679,12 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
     }
     DestLine = DestBits;
 
+    if (!bLeftToRight && !bTopToBottom &&
+        DIB_16BPP_BitBltSrcCopyRows(BltInfo, SourceLine, DestLine, FALSE))
+    {
+      break;
+    }
+
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
@@ -710,15 +761,70 @@ DIB_16BPP_ColorFill(SURFOBJ* DestSurface, RECTL* DestRect, ULONG color)
     pos =(PULONG)((ULONG_PTR)pos + delta);
   }
 #else /* _M_IX86 */
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  LONG Width = DestRect->right - DestRect->left;
+  PBYTE DestRow;
 
-  for (DestY = DestRect->top; DestY< DestRect->bottom; DestY++)
+  if (Width <= 0 || DestRect->bottom <= DestRect->top)
+    return TRUE;
+
+  DestRow = (PBYTE)DestSurface->pvScan0 + DestRect->top * DestSurface->lDelta + (DestRect->left << 1);
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * (DestRect->bottom - DestRect->top));
+  for (DestY = DestRect->top; DestY < DestRect->bottom; DestY++)
   {
-    DIB_16BPP_HLine (DestSurface, DestRect->left, DestRect->right, DestY, color);
+    RowFunctions->Fill16((PUSHORT)DestRow, Width, (USHORT)color);
+    DestRow += DestSurface->lDelta;
   }
+  DIB_EndRowOperation(&RowContext);
 #endif
   return TRUE;
 }
 
+/* Unstretched copies from another 16bpp surface without color translation
+ * and entirely inside the source are done a row at a time */
+static BOOLEAN
+DIB_16BPP_TransparentBltRows(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                             RECTL *DestRect, RECTL *SourceRect,
+                             XLATEOBJ *ColorTranslation, ULONG iTransColor)
+{
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  PBYTE DestRow, SourceRow;
+  LONG Width, Height;
+
+  Width = DestRect->right - DestRect->left;
+  Height = DestRect->bottom - DestRect->top;
+
+  if (SourceSurf == DestSurf ||
+      SourceSurf->iBitmapFormat != BMF_16BPP ||
+      (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL)) ||
+      Width <= 0 || Height <= 0 ||
+      SourceRect->right - SourceRect->left != Width ||
+      SourceRect->bottom - SourceRect->top != Height ||
+      SourceRect->left < 0 || SourceRect->top < 0 ||
+      SourceRect->right > SourceSurf->sizlBitmap.cx ||
+      SourceRect->bottom > SourceSurf->sizlBitmap.cy)
+  {
+    return FALSE;
+  }
+
+  DestRow = (PBYTE)DestSurf->pvScan0 + DestRect->top * DestSurf->lDelta + (DestRect->left << 1);
+  SourceRow = (PBYTE)SourceSurf->pvScan0 + SourceRect->top * SourceSurf->lDelta + (SourceRect->left << 1);
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * Height);
+  while (Height--)
+  {
+    RowFunctions->Transparent16((PUSHORT)DestRow, (PUSHORT)SourceRow, Width, iTransColor);
+    DestRow += DestSurf->lDelta;
+    SourceRow += SourceSurf->lDelta;
+  }
+  DIB_EndRowOperation(&RowContext);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_16BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
                          RECTL*  DestRect,  RECTL *SourceRect,
@@ -732,6 +838,12 @@ DIB_16BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
   LONG SrcHeight;
   LONG SrcWidth;
 
+  if (DIB_16BPP_TransparentBltRows(DestSurf, SourceSurf, DestRect, SourceRect,
+                                   ColorTranslation, iTransColor))
+  {
+    return TRUE;
+  }
+
   DstHeight = DestRect->bottom - DestRect->top;
   DstWidth = DestRect->right - DestRect->left;
   SrcHeight = SourceRect->bottom - SourceRect->top;
@@ -847,6 +959,47 @@ Clamp5(ULONG val)
    return (val > 31) ? 31 : (UCHAR)val;
 }
 
+/* Unstretched blends from a 32bpp BGR surface are done a row at a time */
+static BOOLEAN
+DIB_16BPP_AlphaBlendRows(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
+                         RECTL* SourceRect, EXLATEOBJ* pexlo,
+                         BLENDFUNCTION BlendFunc)
+{
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  PBYTE DstRow, SrcRow;
+  LONG Width, Height;
+
+  Width = DestRect->right - DestRect->left;
+  Height = DestRect->bottom - DestRect->top;
+
+  if (BitsPerFormat(Source->iBitmapFormat) != 32 ||
+      !(pexlo->ppalSrc->flFlags & PAL_BGR) ||
+      Width <= 0 || Height <= 0 ||
+      SourceRect->right - SourceRect->left != Width ||
+      SourceRect->bottom - SourceRect->top != Height)
+  {
+    return FALSE;
+  }
+
+  DstRow = (PBYTE)Dest->pvScan0 + DestRect->top * Dest->lDelta + (DestRect->left << 1);
+  SrcRow = (PBYTE)Source->pvScan0 + SourceRect->top * Source->lDelta + (SourceRect->left << 2);
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * Height);
+  while (Height--)
+  {
+    RowFunctions->Blend16((PUSHORT)DstRow, (PULONG)SrcRow, Width,
+                          BlendFunc.SourceConstantAlpha,
+                          (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0,
+                          (pexlo->ppalDst->flFlags & PAL_RGB16_555) != 0);
+    DstRow += Dest->lDelta;
+    SrcRow += Source->lDelta;
+  }
+  DIB_EndRowOperation(&RowContext);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
@@ -893,6 +1046,10 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
   }
 
   pexlo = CONTAINING_RECORD(ColorTranslation, EXLATEOBJ, xlo);
+
+  if (DIB_16BPP_AlphaBlendRows(Dest, Source, DestRect, SourceRect, pexlo, BlendFunc))
+    return TRUE;
+
   EXLATEOBJ_vInitialize(&exloSrcRGB, pexlo->ppalSrc, &gpalRGB, 0, 0, 0);
 
   if (pexlo->ppalDst->flFlags & PAL_RGB16_555)
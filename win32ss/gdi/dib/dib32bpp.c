@@ -50,6 +50,37 @@ DIB_32BPP_VLine(SURFOBJ *SurfObj, LONG x, LONG y1, LONG y2, ULONG c)
   }
 }
 
+/* Copies that are not mirrored left to right translate a whole row per call.
+ * SourceLine is the first source row to copy, the rest follow it downwards
+ * or upwards for bTopToBottom */
+static BOOLEAN
+DIB_32BPP_BitBltSrcCopyRows(PBLTINFO BltInfo, PBYTE SourceLine, PBYTE DestLine,
+                            LONG DestWidth, LONG DestHeight, BOOLEAN bTopToBottom)
+{
+  DIB_ROW_CONTEXT RowContext;
+  XLATEROW XlateRow;
+  LONG j;
+
+  if (!EXLATEOBJ_bInitXlateRow(&XlateRow, BltInfo->XlateSourceToDest,
+                               BltInfo->SourceSurface->iBitmapFormat, BMF_32BPP,
+                               DIB_BeginRowOperation(&RowContext, DestWidth * DestHeight)))
+  {
+    DIB_EndRowOperation(&RowContext);
+    return FALSE;
+  }
+
+  for (j = 0; j < DestHeight; j++)
+  {
+    XLATEROW_vXlate(&XlateRow, DestLine, SourceLine, DestWidth);
+    DEC_OR_INC(SourceLine, bTopToBottom, BltInfo->SourceSurface->lDelta);
+    DestLine += BltInfo->DestSurface->lDelta;
+  }
+
+  DIB_EndRowOperation(&RowContext);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 {
@@ -225,6 +256,12 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceLine += BltInfo->SourceSurface->lDelta * (DestHeight - 1);
     }
 
+    if (!bLeftToRight &&
+        DIB_32BPP_BitBltSrcCopyRows(BltInfo, SourceLine, DestLine, DestWidth, DestHeight, bTopToBottom))
+    {
+      break;
+    }
+
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
@@ -267,6 +304,12 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceLine += BltInfo->SourceSurface->lDelta * (DestHeight - 1);
     }
 
+    if (!bLeftToRight &&
+        DIB_32BPP_BitBltSrcCopyRows(BltInfo, SourceLine, DestLine, DestWidth, DestHeight, bTopToBottom))
+    {
+      break;
+    }
+
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
@@ -311,6 +354,12 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     DestLine = DestBits;
 
+    if (!bLeftToRight &&
+        DIB_32BPP_BitBltSrcCopyRows(BltInfo, SourceLine, DestLine, DestWidth, DestHeight, bTopToBottom))
+    {
+      break;
+    }
+
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
@@ -429,7 +478,15 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
       if (!bTopToBottom && !bLeftToRight)
       {
-        if (BltInfo->DestRect.top < BltInfo->SourcePoint.y)
+        /* Different surfaces cannot overlap, so the order does not matter */
+        if (BltInfo->SourceSurface->pvScan0 != BltInfo->DestSurface->pvScan0)
+        {
+          SourceBits = (PBYTE)BltInfo->SourceSurface->pvScan0
+            + (BltInfo->SourcePoint.y * BltInfo->SourceSurface->lDelta)
+            + 4 * BltInfo->SourcePoint.x;
+          DIB_32BPP_BitBltSrcCopyRows(BltInfo, SourceBits, DestBits, DestWidth, DestHeight, FALSE);
+        }
+        else if (BltInfo->DestRect.top < BltInfo->SourcePoint.y)
         {
           SourceBits = ((PBYTE)BltInfo->SourceSurface->pvScan0
             + (BltInfo->SourcePoint.y * BltInfo->SourceSurface->lDelta)
@@ -697,6 +754,49 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
   return TRUE;
 }
 
+/* Unstretched copies from another 32bpp surface without color translation
+ * and entirely inside the source are done a row at a time */
+static BOOLEAN
+DIB_32BPP_TransparentBltRows(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                             RECTL *DestRect, RECTL *SourceRect,
+                             XLATEOBJ *ColorTranslation, ULONG iTransColor)
+{
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  PBYTE DestRow, SourceRow;
+  LONG Width, Height;
+
+  Width = DestRect->right - DestRect->left;
+  Height = DestRect->bottom - DestRect->top;
+
+  if (SourceSurf == DestSurf ||
+      SourceSurf->iBitmapFormat != BMF_32BPP ||
+      (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL)) ||
+      Width <= 0 || Height <= 0 ||
+      SourceRect->right - SourceRect->left != Width ||
+      SourceRect->bottom - SourceRect->top != Height ||
+      SourceRect->left < 0 || SourceRect->top < 0 ||
+      SourceRect->right > SourceSurf->sizlBitmap.cx ||
+      SourceRect->bottom > SourceSurf->sizlBitmap.cy)
+  {
+    return FALSE;
+  }
+
+  DestRow = (PBYTE)DestSurf->pvScan0 + DestRect->top * DestSurf->lDelta + (DestRect->left << 2);
+  SourceRow = (PBYTE)SourceSurf->pvScan0 + SourceRect->top * SourceSurf->lDelta + (SourceRect->left << 2);
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * Height);
+  while (Height--)
+  {
+    RowFunctions->Transparent32((PULONG)DestRow, (PULONG)SourceRow, Width, iTransColor);
+    DestRow += DestSurf->lDelta;
+    SourceRow += SourceSurf->lDelta;
+  }
+  DIB_EndRowOperation(&RowContext);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_32BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
                          RECTL*  DestRect,  RECTL *SourceRect,
@@ -710,6 +810,12 @@ DIB_32BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
   LONG SrcHeight;
   LONG SrcWidth;
 
+  if (DIB_32BPP_TransparentBltRows(DestSurf, SourceSurf, DestRect, SourceRect,
+                                   ColorTranslation, iTransColor))
+  {
+    return TRUE;
+  }
+
   DstHeight = DestRect->bottom - DestRect->top;
   DstWidth = DestRect->right - DestRect->left;
   SrcHeight = SourceRect->bottom - SourceRect->top;
@@ -759,6 +865,48 @@ Clamp8(ULONG val)
   return (val > 255) ? 255 : (UCHAR)val;
 }
 
+/* Unstretched blends from another 32bpp surface without color translation
+ * are done a row at a time */
+static BOOLEAN
+DIB_32BPP_AlphaBlendRows(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
+                         RECTL* SourceRect, XLATEOBJ* ColorTranslation,
+                         BLENDFUNCTION BlendFunc)
+{
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  PBYTE DstRow, SrcRow;
+  LONG Width, Height;
+
+  Width = DestRect->right - DestRect->left;
+  Height = DestRect->bottom - DestRect->top;
+
+  if (Source == Dest ||
+      BitsPerFormat(Source->iBitmapFormat) != 32 ||
+      (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL)) ||
+      Width <= 0 || Height <= 0 ||
+      SourceRect->right - SourceRect->left != Width ||
+      SourceRect->bottom - SourceRect->top != Height)
+  {
+    return FALSE;
+  }
+
+  DstRow = (PBYTE)Dest->pvScan0 + DestRect->top * Dest->lDelta + (DestRect->left << 2);
+  SrcRow = (PBYTE)Source->pvScan0 + SourceRect->top * Source->lDelta + (SourceRect->left << 2);
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * Height);
+  while (Height--)
+  {
+    RowFunctions->Blend32((PULONG)DstRow, (PULONG)SrcRow, Width,
+                          BlendFunc.SourceConstantAlpha,
+                          (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0);
+    DstRow += Dest->lDelta;
+    SrcRow += Source->lDelta;
+  }
+  DIB_EndRowOperation(&RowContext);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
@@ -797,6 +945,12 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     return FALSE;
   }
 
+  if (DIB_32BPP_AlphaBlendRows(Dest, Source, DestRect, SourceRect,
+                               ColorTranslation, BlendFunc))
+  {
+    return TRUE;
+  }
+
   Dst = (PULONG)((ULONG_PTR)Dest->pvScan0 + (DestRect->top * Dest->lDelta) +
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
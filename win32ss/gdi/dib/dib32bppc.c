@@ -30,15 +30,28 @@ DIB_32BPP_HLine(SURFOBJ *SurfObj, LONG x1, LONG x2, LONG y, ULONG c)
 BOOLEAN
 DIB_32BPP_ColorFill(SURFOBJ* DestSurface, RECTL* DestRect, ULONG color)
 {
-  ULONG DestY;
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  LONG Width, Height;
+  PBYTE DestRow;
 
   /* Make WellOrdered by making top < bottom and left < right */
   RECTL_vMakeWellOrdered(DestRect);
 
-  for (DestY = DestRect->top; DestY< DestRect->bottom; DestY++)
+  Width = DestRect->right - DestRect->left;
+  Height = DestRect->bottom - DestRect->top;
+  if (Width <= 0 || Height <= 0)
+    return TRUE;
+
+  DestRow = (PBYTE)DestSurface->pvScan0 + DestRect->top * DestSurface->lDelta + (DestRect->left << 2);
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * Height);
+  while (Height--)
   {
-    DIB_32BPP_HLine (DestSurface, DestRect->left, DestRect->right, DestY, color);
+    RowFunctions->Fill32((PULONG)DestRow, Width, color);
+    DestRow += DestSurface->lDelta;
   }
+  DIB_EndRowOperation(&RowContext);
 
   return TRUE;
 }
@@ -0,0 +1,305 @@
+/*
+ * PROJECT:         Win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            win32ss/gdi/dib/dibrow.c
+ * PURPOSE:         Row kernels for the 16bpp and 32bpp blit fast paths
+ */
+
+#ifdef DIBROW_STANDALONE
+#include "dibrow.h"
+#else
+#include <win32k.h>
+
+#define NDEBUG
+#include <debug.h>
+#endif
+
+/*
+ * The portable kernels follow DIB_32BPP_AlphaBlend, DIB_16BPP_AlphaBlend
+ * and the TransparentBlt loops exactly, the SSE2 ones are checked against
+ * them by modules/rostests/dibtests/dibbench.
+ */
+
+static VOID
+DIB_RowBlend32(PULONG Dst, const ULONG *Src, ULONG Count,
+               UCHAR ConstAlpha, BOOLEAN SrcAlpha)
+{
+  ULONG i, Shift, SrcPixel, DstPixel, Result, Alpha, SrcChannel, DstChannel;
+
+  for (i = 0; i < Count; i++)
+  {
+    SrcPixel = Src[i];
+    DstPixel = Dst[i];
+
+    Alpha = SrcAlpha ? ((SrcPixel >> 24) * ConstAlpha) / 255 : ConstAlpha;
+
+    Result = 0;
+    for (Shift = 0; Shift < 32; Shift += 8)
+    {
+      SrcChannel = (((SrcPixel >> Shift) & 0xFF) * ConstAlpha) / 255;
+      DstChannel = (((DstPixel >> Shift) & 0xFF) * (255 - Alpha)) / 255 + SrcChannel;
+      Result |= min(DstChannel, 255) << Shift;
+    }
+
+    Dst[i] = Result;
+  }
+}
+
+static VOID
+DIB_RowBlend16(PUSHORT Dst, const ULONG *Src, ULONG Count,
+               UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN Is555)
+{
+  ULONG i, SrcPixel, DstPixel, Alpha, Alpha5, Alpha6;
+  ULONG SrcRed, SrcGreen, SrcBlue, Red, Green, Blue;
+
+  for (i = 0; i < Count; i++)
+  {
+    SrcPixel = Src[i];
+    DstPixel = Dst[i];
+
+    SrcRed = (((SrcPixel >> 16) & 0xFF) * ConstAlpha) / 255;
+    SrcGreen = (((SrcPixel >> 8) & 0xFF) * ConstAlpha) / 255;
+    SrcBlue = ((SrcPixel & 0xFF) * ConstAlpha) / 255;
+
+    Alpha = SrcAlpha ? ((SrcPixel >> 24) * ConstAlpha) / 255 : ConstAlpha;
+    Alpha5 = Alpha >> 3;
+
+    if (Is555)
+    {
+      Red = (((DstPixel >> 10) & 0x1F) * (31 - Alpha5)) / 31 + (SrcRed >> 3);
+      Green = (((DstPixel >> 5) & 0x1F) * (31 - Alpha5)) / 31 + (SrcGreen >> 3);
+      Blue = ((DstPixel & 0x1F) * (31 - Alpha5)) / 31 + (SrcBlue >> 3);
+
+      Dst[i] = (USHORT)((DstPixel & 0x8000) | (min(Red, 31) << 10) |
+                        (min(Green, 31) << 5) | min(Blue, 31));
+    }
+    else
+    {
+      Alpha6 = Alpha >> 2;
+
+      Red = ((DstPixel >> 11) * (31 - Alpha5)) / 31 + (SrcRed >> 3);
+      Green = (((DstPixel >> 5) & 0x3F) * (63 - Alpha6)) / 63 + (SrcGreen >> 2);
+      Blue = ((DstPixel & 0x1F) * (31 - Alpha5)) / 31 + (SrcBlue >> 3);
+
+      Dst[i] = (USHORT)((min(Red, 31) << 11) | (min(Green, 63) << 5) | min(Blue, 31));
+    }
+  }
+}
+
+static VOID
+DIB_RowTransparent32(PULONG Dst, const ULONG *Src, ULONG Count, ULONG TransColor)
+{
+  ULONG i;
+
+  for (i = 0; i < Count; i++)
+  {
+    if ((Src[i] ^ TransColor) & 0x00FFFFFF)
+      Dst[i] = Src[i];
+  }
+}
+
+static VOID
+DIB_RowTransparent16(PUSHORT Dst, const USHORT *Src, ULONG Count, ULONG TransColor)
+{
+  ULONG i;
+
+  for (i = 0; i < Count; i++)
+  {
+    if (Src[i] != TransColor)
+      Dst[i] = Src[i];
+  }
+}
+
+static VOID
+DIB_RowFill32(PULONG Dst, ULONG Count, ULONG Color)
+{
+  while (Count--)
+    *Dst++ = Color;
+}
+
+static VOID
+DIB_RowFill16(PUSHORT Dst, ULONG Count, USHORT Color)
+{
+  ULONG Pair = Color | ((ULONG)Color << 16);
+  PULONG DstPair;
+
+  /* Two pixels per store once the destination is ULONG aligned */
+  if (Count && ((ULONG_PTR)Dst & 2))
+  {
+    *Dst++ = Color;
+    Count--;
+  }
+
+  for (DstPair = (PULONG)Dst; Count >= 2; Count -= 2)
+    *DstPair++ = Pair;
+
+  if (Count)
+    *(PUSHORT)DstPair = Color;
+}
+
+/* Same as EXLATEOBJ_iXlateRGBtoBGR */
+static VOID
+DIB_RowSwapRedBlue32(PULONG Dst, const ULONG *Src, ULONG Count)
+{
+  ULONG i, Color;
+
+  for (i = 0; i < Count; i++)
+  {
+    Color = Src[i];
+    Dst[i] = (Color & 0xFF00FF00) | ((Color >> 16) & 0xFF) | ((Color & 0xFF) << 16);
+  }
+}
+
+/* Same as EXLATEOBJ_iXlateBGRto565 and its RGB and 555 variants */
+static VOID
+DIB_RowPack32to16(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                  BOOLEAN SrcRgb, BOOLEAN Is555)
+{
+  ULONG i, Color;
+
+  for (i = 0; i < Count; i++)
+  {
+    Color = Src[i];
+    if (SrcRgb)
+      Color = ((Color >> 16) & 0xFF) | (Color & 0xFF00) | ((Color & 0xFF) << 16);
+
+    if (Is555)
+      Dst[i] = (USHORT)(((Color >> 9) & 0x7C00) | ((Color >> 6) & 0x3E0) | ((Color >> 3) & 0x1F));
+    else
+      Dst[i] = (USHORT)(((Color >> 8) & 0xF800) | ((Color >> 5) & 0x7E0) | ((Color >> 3) & 0x1F));
+  }
+}
+
+static VOID
+DIB_RowFilterX(PSHORT Dst, const ULONG *Src, const ULONG *First,
+               const SHORT *Weights, ULONG Taps, ULONG Count)
+{
+  ULONG i, k, Shift, Pixel;
+  LONG Sum[4];
+  const ULONG *Pixels;
+
+  for (i = 0; i < Count; i++, Dst += 4, Weights += Taps)
+  {
+    Pixels = Src + First[i];
+    Sum[0] = Sum[1] = Sum[2] = Sum[3] = 0;
+
+    for (k = 0; k < Taps; k++)
+    {
+      Pixel = Pixels[k];
+      for (Shift = 0; Shift < 4; Shift++)
+        Sum[Shift] += (LONG)((Pixel >> (Shift * 8)) & 0xFF) * Weights[k];
+    }
+
+    for (Shift = 0; Shift < 4; Shift++)
+    {
+      Dst[Shift] = (SHORT)((Sum[Shift] + (1 << (DIB_FILTER_WEIGHT_BITS - DIB_FILTER_CHANNEL_BITS - 1)))
+                           >> (DIB_FILTER_WEIGHT_BITS - DIB_FILTER_CHANNEL_BITS));
+    }
+  }
+}
+
+static VOID
+DIB_RowFilterY(PULONG Dst, const SHORT * const *Rows,
+               const SHORT *Weights, ULONG Taps, ULONG Count)
+{
+  ULONG i, k, Channel, Result;
+  LONG Sum;
+
+  for (i = 0; i < Count; i++)
+  {
+    Result = 0;
+    for (Channel = 0; Channel < 4; Channel++)
+    {
+      Sum = 1 << (DIB_FILTER_WEIGHT_BITS + DIB_FILTER_CHANNEL_BITS - 1);
+      for (k = 0; k < Taps; k++)
+        Sum += Rows[k][i * 4 + Channel] * Weights[k];
+
+      Sum >>= DIB_FILTER_WEIGHT_BITS + DIB_FILTER_CHANNEL_BITS;
+      Result |= (ULONG)min(Sum, 255) << (Channel * 8);
+    }
+    Dst[i] = Result;
+  }
+}
+
+const DIB_ROW_FUNCTIONS DibRowFunctionsPortable =
+{
+  DIB_RowBlend32,
+  DIB_RowBlend16,
+  DIB_RowTransparent32,
+  DIB_RowTransparent16,
+  DIB_RowFill32,
+  DIB_RowFill16,
+  DIB_RowSwapRedBlue32,
+  DIB_RowPack32to16,
+  DIB_RowFilterX,
+  DIB_RowFilterY
+};
+
+const DIB_ROW_FUNCTIONS *
+DIB_SelectRowFunctions(BOOLEAN Sse2Present)
+{
+#ifdef DIB_ROW_SSE2
+  if (Sse2Present)
+    return &DibRowFunctionsSse2;
+#endif
+
+  return &DibRowFunctionsPortable;
+}
+
+#ifndef DIBROW_STANDALONE
+
+static const DIB_ROW_FUNCTIONS *gpDibRowFunctions = &DibRowFunctionsPortable;
+
+VOID
+DIB_InitRowFunctions(VOID)
+{
+  gpDibRowFunctions = DIB_SelectRowFunctions(
+      ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE));
+}
+
+/* Picks the kernels for a blit of Pixels pixels. Every call must be
+ * paired with DIB_EndRowOperation once the kernels are done */
+const DIB_ROW_FUNCTIONS *
+DIB_BeginRowOperation(PDIB_ROW_CONTEXT Context, ULONG Pixels)
+{
+  Context->Functions = gpDibRowFunctions;
+
+#ifdef _M_IX86
+  Context->FloatSaved = FALSE;
+
+  if (Context->Functions != &DibRowFunctionsPortable)
+  {
+    if (Pixels >= DIB_ROW_SSE2_MIN_PIXELS &&
+        NT_SUCCESS(KeSaveFloatingPointState(&Context->FloatSave)))
+    {
+      Context->FloatSaved = TRUE;
+    }
+    else
+    {
+      Context->Functions = &DibRowFunctionsPortable;
+    }
+  }
+#else
+  UNREFERENCED_PARAMETER(Pixels);
+#endif
+
+  return Context->Functions;
+}
+
+VOID
+DIB_EndRowOperation(PDIB_ROW_CONTEXT Context)
+{
+#ifdef _M_IX86
+  if (Context->FloatSaved)
+  {
+    KeRestoreFloatingPointState(&Context->FloatSave);
+    Context->FloatSaved = FALSE;
+  }
+#else
+  UNREFERENCED_PARAMETER(Context);
+#endif
+}
+
+#endif /* DIBROW_STANDALONE */
+
+/* EOF */
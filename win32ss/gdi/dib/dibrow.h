@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * Row kernels used by the 16bpp and 32bpp AlphaBlend, TransparentBlt and
+ * ColorFill fast paths. Each kernel handles one unstretched row without
+ * color translation; the callers take care of clipping, stretching and
+ * translated surfaces and fall back to the per-pixel loops for them.
+ *
+ * Every table produces bit-identical results, so the one in use only
+ * changes the speed.
+ */
+
+/* Blends Count 32bpp BGRA pixels over a 32bpp destination */
+typedef VOID (*PFN_DIB_ROW_BLEND32)(PULONG Dst, const ULONG *Src, ULONG Count,
+                                    UCHAR ConstAlpha, BOOLEAN SrcAlpha);
+/* Blends Count 32bpp BGRA pixels over a 565 or 555 destination */
+typedef VOID (*PFN_DIB_ROW_BLEND16)(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                                    UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN Is555);
+/* Copies the pixels that do not match the transparent color */
+typedef VOID (*PFN_DIB_ROW_TRANSPARENT32)(PULONG Dst, const ULONG *Src, ULONG Count,
+                                          ULONG TransColor);
+typedef VOID (*PFN_DIB_ROW_TRANSPARENT16)(PUSHORT Dst, const USHORT *Src, ULONG Count,
+                                          ULONG TransColor);
+typedef VOID (*PFN_DIB_ROW_FILL32)(PULONG Dst, ULONG Count, ULONG Color);
+typedef VOID (*PFN_DIB_ROW_FILL16)(PUSHORT Dst, ULONG Count, USHORT Color);
+/* Color conversions of the xlate objects, see EXLATEOBJ_bInitXlateRow */
+typedef VOID (*PFN_DIB_ROW_SWAP32)(PULONG Dst, const ULONG *Src, ULONG Count);
+typedef VOID (*PFN_DIB_ROW_PACK16)(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                                   BOOLEAN SrcRgb, BOOLEAN Is555);
+/*
+ * The two passes of the HALFTONE stretch, see DIB_XXBPP_StretchBltHalftone.
+ * Weights are 2.14 fixed point and add up to 1 for each output pixel. The
+ * horizontal pass leaves 4 channels per pixel in 8.7 fixed point, the
+ * vertical pass combines Taps of those rows back into 32bpp pixels.
+ */
+#define DIB_FILTER_WEIGHT_BITS  14
+#define DIB_FILTER_CHANNEL_BITS 7
+
+typedef VOID (*PFN_DIB_ROW_FILTERX)(PSHORT Dst, const ULONG *Src, const ULONG *First,
+                                    const SHORT *Weights, ULONG Taps, ULONG Count);
+typedef VOID (*PFN_DIB_ROW_FILTERY)(PULONG Dst, const SHORT * const *Rows,
+                                    const SHORT *Weights, ULONG Taps, ULONG Count);
+
+typedef struct _DIB_ROW_FUNCTIONS
+{
+    PFN_DIB_ROW_BLEND32       Blend32;
+    PFN_DIB_ROW_BLEND16       Blend16;
+    PFN_DIB_ROW_TRANSPARENT32 Transparent32;
+    PFN_DIB_ROW_TRANSPARENT16 Transparent16;
+    PFN_DIB_ROW_FILL32        Fill32;
+    PFN_DIB_ROW_FILL16        Fill16;
+    PFN_DIB_ROW_SWAP32        SwapRedBlue32;
+    PFN_DIB_ROW_PACK16        Pack32to16;
+    PFN_DIB_ROW_FILTERX       FilterX;
+    PFN_DIB_ROW_FILTERY       FilterY;
+} DIB_ROW_FUNCTIONS, *PDIB_ROW_FUNCTIONS;
+
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(__i386__) || defined(__x86_64__)
+#define DIB_ROW_SSE2
+extern const DIB_ROW_FUNCTIONS DibRowFunctionsSse2;
+#endif
+
+extern const DIB_ROW_FUNCTIONS DibRowFunctionsPortable;
+
+const DIB_ROW_FUNCTIONS *DIB_SelectRowFunctions(BOOLEAN Sse2Present);
+
+#ifndef DIBROW_STANDALONE
+
+/*
+ * On x86 the SSE registers belong to the user mode thread, so the kernels
+ * are only worth their state save for blits of at least this many pixels.
+ */
+#define DIB_ROW_SSE2_MIN_PIXELS 4096
+
+typedef struct _DIB_ROW_CONTEXT
+{
+    const DIB_ROW_FUNCTIONS *Functions;
+#ifdef _M_IX86
+    BOOLEAN FloatSaved;
+    KFLOATING_SAVE FloatSave;
+#endif
+} DIB_ROW_CONTEXT, *PDIB_ROW_CONTEXT;
+
+VOID DIB_InitRowFunctions(VOID);
+const DIB_ROW_FUNCTIONS *DIB_BeginRowOperation(PDIB_ROW_CONTEXT Context, ULONG Pixels);
+VOID DIB_EndRowOperation(PDIB_ROW_CONTEXT Context);
+
+#endif /* DIBROW_STANDALONE */
@@ -0,0 +1,461 @@
+/*
+ * PROJECT:         Win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            win32ss/gdi/dib/dibrow_sse2.c
+ * PURPOSE:         SSE2 row kernels for the 16bpp and 32bpp blit fast paths
+ */
+
+#ifdef DIBROW_STANDALONE
+#include "dibrow.h"
+#else
+#include <win32k.h>
+#endif
+
+#include <emmintrin.h>
+
+/* Only reached once SSE2 is known to be present, the rest of win32k
+ * must not be compiled for it */
+#if defined(__GNUC__) || defined(__clang__)
+#define DIB_SSE2 __attribute__((__target__("sse2")))
+#else
+#define DIB_SSE2
+#endif
+
+/* x / 255 rounded down, exact for x <= 255 * 255 */
+#define DIV255(x) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), One), _mm_srli_epi16((x), 8)), 8)
+/* x / 31 and x / 63 rounded down, exact for x <= 31 * 31 and x <= 63 * 63 */
+#define DIV31(x)  _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), One), _mm_srli_epi16((x), 5)), 5)
+#define DIV63(x)  _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), One), _mm_srli_epi16((x), 6)), 6)
+
+DIB_SSE2
+static VOID
+DIB_RowBlend32Sse2(PULONG Dst, const ULONG *Src, ULONG Count,
+                   UCHAR ConstAlpha, BOOLEAN SrcAlpha)
+{
+  const __m128i Zero = _mm_setzero_si128();
+  const __m128i One = _mm_set1_epi16(1);
+  const __m128i Max = _mm_set1_epi16(255);
+  const __m128i Const = _mm_set1_epi16(ConstAlpha);
+  __m128i SrcPixels, DstPixels, SrcLow, SrcHigh, DstLow, DstHigh, AlphaLow, AlphaHigh;
+  ULONG i;
+
+  /* Four pixels at a time, two per register once widened to 16 bits */
+  for (i = 0; i + 4 <= Count; i += 4)
+  {
+    SrcPixels = _mm_loadu_si128((const __m128i *)(Src + i));
+    DstPixels = _mm_loadu_si128((const __m128i *)(Dst + i));
+
+    SrcLow = _mm_unpacklo_epi8(SrcPixels, Zero);
+    SrcHigh = _mm_unpackhi_epi8(SrcPixels, Zero);
+    if (ConstAlpha != 255)
+    {
+      SrcLow = _mm_mullo_epi16(SrcLow, Const);
+      SrcLow = DIV255(SrcLow);
+      SrcHigh = _mm_mullo_epi16(SrcHigh, Const);
+      SrcHigh = DIV255(SrcHigh);
+    }
+
+    if (SrcAlpha)
+    {
+      /* Spread each pixel's alpha over its four channels */
+      AlphaLow = _mm_shufflehi_epi16(_mm_shufflelo_epi16(SrcLow, 0xFF), 0xFF);
+      AlphaHigh = _mm_shufflehi_epi16(_mm_shufflelo_epi16(SrcHigh, 0xFF), 0xFF);
+    }
+    else
+    {
+      AlphaLow = AlphaHigh = Const;
+    }
+
+    DstLow = _mm_mullo_epi16(_mm_unpacklo_epi8(DstPixels, Zero), _mm_sub_epi16(Max, AlphaLow));
+    DstLow = _mm_add_epi16(DIV255(DstLow), SrcLow);
+    DstHigh = _mm_mullo_epi16(_mm_unpackhi_epi8(DstPixels, Zero), _mm_sub_epi16(Max, AlphaHigh));
+    DstHigh = _mm_add_epi16(DIV255(DstHigh), SrcHigh);
+
+    /* The unsigned saturation clamps each channel to 255 */
+    _mm_storeu_si128((__m128i *)(Dst + i), _mm_packus_epi16(DstLow, DstHigh));
+  }
+
+  DibRowFunctionsPortable.Blend32(Dst + i, Src + i, Count - i, ConstAlpha, SrcAlpha);
+}
+
+DIB_SSE2
+static VOID
+DIB_RowBlend16Sse2(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                   UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN Is555)
+{
+  const __m128i One = _mm_set1_epi16(1);
+  const __m128i Const = _mm_set1_epi16(ConstAlpha);
+  const __m128i Byte = _mm_set1_epi32(0xFF);
+  const __m128i Mask5 = _mm_set1_epi16(0x1F);
+  const __m128i Mask6 = _mm_set1_epi16(0x3F);
+  const __m128i Max5 = _mm_set1_epi16(31);
+  const __m128i Max6 = _mm_set1_epi16(63);
+  __m128i Src0, Src1, DstPixels, Red, Green, Blue, Alpha, Alpha5, Alpha6;
+  __m128i DstRed, DstGreen, DstBlue;
+  ULONG i;
+
+  /* Eight pixels at a time, one channel per register */
+  for (i = 0; i + 8 <= Count; i += 8)
+  {
+    Src0 = _mm_loadu_si128((const __m128i *)(Src + i));
+    Src1 = _mm_loadu_si128((const __m128i *)(Src + i + 4));
+    DstPixels = _mm_loadu_si128((const __m128i *)(Dst + i));
+
+    Red = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(Src0, 16), Byte),
+                          _mm_and_si128(_mm_srli_epi32(Src1, 16), Byte));
+    Green = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(Src0, 8), Byte),
+                            _mm_and_si128(_mm_srli_epi32(Src1, 8), Byte));
+    Blue = _mm_packs_epi32(_mm_and_si128(Src0, Byte), _mm_and_si128(Src1, Byte));
+
+    Red = _mm_mullo_epi16(Red, Const);
+    Red = DIV255(Red);
+    Green = _mm_mullo_epi16(Green, Const);
+    Green = DIV255(Green);
+    Blue = _mm_mullo_epi16(Blue, Const);
+    Blue = DIV255(Blue);
+
+    if (SrcAlpha)
+    {
+      Alpha = _mm_packs_epi32(_mm_srli_epi32(Src0, 24), _mm_srli_epi32(Src1, 24));
+      Alpha = _mm_mullo_epi16(Alpha, Const);
+      Alpha = DIV255(Alpha);
+    }
+    else
+    {
+      Alpha = Const;
+    }
+
+    Alpha5 = _mm_sub_epi16(Max5, _mm_srli_epi16(Alpha, 3));
+    Blue = _mm_srli_epi16(Blue, 3);
+    Red = _mm_srli_epi16(Red, 3);
+
+    DstBlue = _mm_mullo_epi16(_mm_and_si128(DstPixels, Mask5), Alpha5);
+    DstBlue = _mm_min_epi16(_mm_add_epi16(DIV31(DstBlue), Blue), Max5);
+
+    if (Is555)
+    {
+      Green = _mm_srli_epi16(Green, 3);
+
+      DstRed = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(DstPixels, 10), Mask5), Alpha5);
+      DstRed = _mm_min_epi16(_mm_add_epi16(DIV31(DstRed), Red), Max5);
+      DstGreen = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(DstPixels, 5), Mask5), Alpha5);
+      DstGreen = _mm_min_epi16(_mm_add_epi16(DIV31(DstGreen), Green), Max5);
+
+      DstPixels = _mm_or_si128(_mm_and_si128(DstPixels, _mm_set1_epi16((SHORT)0x8000)),
+                               _mm_or_si128(_mm_slli_epi16(DstRed, 10),
+                                            _mm_or_si128(_mm_slli_epi16(DstGreen, 5), DstBlue)));
+    }
+    else
+    {
+      Alpha6 = _mm_sub_epi16(Max6, _mm_srli_epi16(Alpha, 2));
+      Green = _mm_srli_epi16(Green, 2);
+
+      DstRed = _mm_mullo_epi16(_mm_srli_epi16(DstPixels, 11), Alpha5);
+      DstRed = _mm_min_epi16(_mm_add_epi16(DIV31(DstRed), Red), Max5);
+      DstGreen = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(DstPixels, 5), Mask6), Alpha6);
+      DstGreen = _mm_min_epi16(_mm_add_epi16(DIV63(DstGreen), Green), Max6);
+
+      DstPixels = _mm_or_si128(_mm_slli_epi16(DstRed, 11),
+                               _mm_or_si128(_mm_slli_epi16(DstGreen, 5), DstBlue));
+    }
+
+    _mm_storeu_si128((__m128i *)(Dst + i), DstPixels);
+  }
+
+  DibRowFunctionsPortable.Blend16(Dst + i, Src + i, Count - i, ConstAlpha, SrcAlpha, Is555);
+}
+
+DIB_SSE2
+static VOID
+DIB_RowTransparent32Sse2(PULONG Dst, const ULONG *Src, ULONG Count, ULONG TransColor)
+{
+  const __m128i ColorMask = _mm_set1_epi32(0x00FFFFFF);
+  const __m128i Key = _mm_set1_epi32(TransColor & 0x00FFFFFF);
+  __m128i SrcPixels, Transparent;
+  int Mask;
+  ULONG i;
+
+  for (i = 0; i + 4 <= Count; i += 4)
+  {
+    SrcPixels = _mm_loadu_si128((const __m128i *)(Src + i));
+    Transparent = _mm_cmpeq_epi32(_mm_and_si128(SrcPixels, ColorMask), Key);
+
+    /* Sprites are mostly all opaque or all transparent runs */
+    Mask = _mm_movemask_epi8(Transparent);
+    if (Mask == 0xFFFF)
+      continue;
+
+    if (Mask != 0)
+    {
+      SrcPixels = _mm_or_si128(_mm_and_si128(Transparent, _mm_loadu_si128((const __m128i *)(Dst + i))),
+                               _mm_andnot_si128(Transparent, SrcPixels));
+    }
+
+    _mm_storeu_si128((__m128i *)(Dst + i), SrcPixels);
+  }
+
+  DibRowFunctionsPortable.Transparent32(Dst + i, Src + i, Count - i, TransColor);
+}
+
+DIB_SSE2
+static VOID
+DIB_RowTransparent16Sse2(PUSHORT Dst, const USHORT *Src, ULONG Count, ULONG TransColor)
+{
+  const __m128i Key = _mm_set1_epi16((SHORT)TransColor);
+  __m128i SrcPixels, Transparent;
+  int Mask;
+  ULONG i = 0;
+
+  /* A key wider than a pixel matches nothing, the plain loop copies all */
+  if (TransColor <= 0xFFFF)
+  {
+    for (; i + 8 <= Count; i += 8)
+    {
+      SrcPixels = _mm_loadu_si128((const __m128i *)(Src + i));
+      Transparent = _mm_cmpeq_epi16(SrcPixels, Key);
+
+      Mask = _mm_movemask_epi8(Transparent);
+      if (Mask == 0xFFFF)
+        continue;
+
+      if (Mask != 0)
+      {
+        SrcPixels = _mm_or_si128(_mm_and_si128(Transparent, _mm_loadu_si128((const __m128i *)(Dst + i))),
+                                 _mm_andnot_si128(Transparent, SrcPixels));
+      }
+
+      _mm_storeu_si128((__m128i *)(Dst + i), SrcPixels);
+    }
+  }
+
+  DibRowFunctionsPortable.Transparent16(Dst + i, Src + i, Count - i, TransColor);
+}
+
+DIB_SSE2
+static VOID
+DIB_RowFill32Sse2(PULONG Dst, ULONG Count, ULONG Color)
+{
+  const __m128i Pixels = _mm_set1_epi32(Color);
+
+  while (Count && ((ULONG_PTR)Dst & 15))
+  {
+    *Dst++ = Color;
+    Count--;
+  }
+
+  for (; Count >= 4; Count -= 4, Dst += 4)
+    _mm_store_si128((__m128i *)Dst, Pixels);
+
+  while (Count--)
+    *Dst++ = Color;
+}
+
+DIB_SSE2
+static VOID
+DIB_RowFill16Sse2(PUSHORT Dst, ULONG Count, USHORT Color)
+{
+  const __m128i Pixels = _mm_set1_epi16((SHORT)Color);
+
+  while (Count && ((ULONG_PTR)Dst & 15))
+  {
+    *Dst++ = Color;
+    Count--;
+  }
+
+  for (; Count >= 8; Count -= 8, Dst += 8)
+    _mm_store_si128((__m128i *)Dst, Pixels);
+
+  while (Count--)
+    *Dst++ = Color;
+}
+
+DIB_SSE2
+static VOID
+DIB_RowSwapRedBlue32Sse2(PULONG Dst, const ULONG *Src, ULONG Count)
+{
+  const __m128i Keep = _mm_set1_epi32(0xFF00FF00);
+  const __m128i Byte = _mm_set1_epi32(0xFF);
+  __m128i Pixels;
+  ULONG i;
+
+  for (i = 0; i + 4 <= Count; i += 4)
+  {
+    Pixels = _mm_loadu_si128((const __m128i *)(Src + i));
+    Pixels = _mm_or_si128(_mm_and_si128(Pixels, Keep),
+                          _mm_or_si128(_mm_and_si128(_mm_srli_epi32(Pixels, 16), Byte),
+                                       _mm_slli_epi32(_mm_and_si128(Pixels, Byte), 16)));
+    _mm_storeu_si128((__m128i *)(Dst + i), Pixels);
+  }
+
+  DibRowFunctionsPortable.SwapRedBlue32(Dst + i, Src + i, Count - i);
+}
+
+DIB_SSE2
+static __m128i
+DIB_Pack32to16Sse2(__m128i Pixels, BOOLEAN SrcRgb, BOOLEAN Is555)
+{
+  const __m128i Byte = _mm_set1_epi32(0xFF);
+
+  if (SrcRgb)
+  {
+    Pixels = _mm_or_si128(_mm_and_si128(Pixels, _mm_set1_epi32(0xFF00)),
+                          _mm_or_si128(_mm_and_si128(_mm_srli_epi32(Pixels, 16), Byte),
+                                       _mm_slli_epi32(_mm_and_si128(Pixels, Byte), 16)));
+  }
+
+  if (Is555)
+  {
+    Pixels = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(Pixels, 9), _mm_set1_epi32(0x7C00)),
+                          _mm_or_si128(_mm_and_si128(_mm_srli_epi32(Pixels, 6), _mm_set1_epi32(0x3E0)),
+                                       _mm_and_si128(_mm_srli_epi32(Pixels, 3), _mm_set1_epi32(0x1F))));
+  }
+  else
+  {
+    Pixels = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(Pixels, 8), _mm_set1_epi32(0xF800)),
+                          _mm_or_si128(_mm_and_si128(_mm_srli_epi32(Pixels, 5), _mm_set1_epi32(0x7E0)),
+                                       _mm_and_si128(_mm_srli_epi32(Pixels, 3), _mm_set1_epi32(0x1F))));
+  }
+
+  /* Sign extend, so that the signed saturation of the pack keeps all 16 bits */
+  return _mm_srai_epi32(_mm_slli_epi32(Pixels, 16), 16);
+}
+
+DIB_SSE2
+static VOID
+DIB_RowPack32to16Sse2(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                      BOOLEAN SrcRgb, BOOLEAN Is555)
+{
+  __m128i Low, High;
+  ULONG i;
+
+  for (i = 0; i + 8 <= Count; i += 8)
+  {
+    Low = DIB_Pack32to16Sse2(_mm_loadu_si128((const __m128i *)(Src + i)), SrcRgb, Is555);
+    High = DIB_Pack32to16Sse2(_mm_loadu_si128((const __m128i *)(Src + i + 4)), SrcRgb, Is555);
+    _mm_storeu_si128((__m128i *)(Dst + i), _mm_packs_epi32(Low, High));
+  }
+
+  DibRowFunctionsPortable.Pack32to16(Dst + i, Src + i, Count - i, SrcRgb, Is555);
+}
+
+/* Two weights for _mm_madd_epi16, the second may be zero */
+#define WEIGHT_PAIR(w0, w1) _mm_set1_epi32((USHORT)(w0) | ((ULONG)(USHORT)(w1) << 16))
+
+DIB_SSE2
+static VOID
+DIB_RowFilterXSse2(PSHORT Dst, const ULONG *Src, const ULONG *First,
+                   const SHORT *Weights, ULONG Taps, ULONG Count)
+{
+  const __m128i Zero = _mm_setzero_si128();
+  const __m128i Round = _mm_set1_epi32(1 << (DIB_FILTER_WEIGHT_BITS - DIB_FILTER_CHANNEL_BITS - 1));
+  __m128i Sum, Pixels;
+  const ULONG *Source;
+  ULONG i, k;
+
+  for (i = 0; i < Count; i++, Dst += 4, Weights += Taps)
+  {
+    Source = Src + First[i];
+    Sum = Round;
+
+    /* Two source pixels per step, their channels interleaved for the madd */
+    for (k = 0; k + 2 <= Taps; k += 2)
+    {
+      Pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(Source + k)), Zero);
+      Pixels = _mm_unpacklo_epi16(Pixels, _mm_srli_si128(Pixels, 8));
+      Sum = _mm_add_epi32(Sum, _mm_madd_epi16(Pixels, WEIGHT_PAIR(Weights[k], Weights[k + 1])));
+    }
+
+    if (k < Taps)
+    {
+      Pixels = _mm_unpacklo_epi8(_mm_cvtsi32_si128(Source[k]), Zero);
+      Pixels = _mm_unpacklo_epi16(Pixels, Zero);
+      Sum = _mm_add_epi32(Sum, _mm_madd_epi16(Pixels, WEIGHT_PAIR(Weights[k], 0)));
+    }
+
+    Sum = _mm_srai_epi32(Sum, DIB_FILTER_WEIGHT_BITS - DIB_FILTER_CHANNEL_BITS);
+    _mm_storel_epi64((__m128i *)Dst, _mm_packs_epi32(Sum, Sum));
+  }
+}
+
+DIB_SSE2
+static VOID
+DIB_RowFilterYSse2(PULONG Dst, const SHORT * const *Rows,
+                   const SHORT *Weights, ULONG Taps, ULONG Count)
+{
+  const __m128i Zero = _mm_setzero_si128();
+  const __m128i Round = _mm_set1_epi32(1 << (DIB_FILTER_WEIGHT_BITS + DIB_FILTER_CHANNEL_BITS - 1));
+  __m128i Low, High, Row0, Row1, Pair;
+  ULONG i, k;
+
+  /* Two pixels, 8 channels, per step */
+  for (i = 0; i + 2 <= Count; i += 2)
+  {
+    Low = High = Round;
+
+    for (k = 0; k < Taps; k += 2)
+    {
+      Row0 = _mm_loadu_si128((const __m128i *)(Rows[k] + i * 4));
+      if (k + 1 < Taps)
+      {
+        Row1 = _mm_loadu_si128((const __m128i *)(Rows[k + 1] + i * 4));
+        Pair = WEIGHT_PAIR(Weights[k], Weights[k + 1]);
+      }
+      else
+      {
+        Row1 = Zero;
+        Pair = WEIGHT_PAIR(Weights[k], 0);
+      }
+
+      Low = _mm_add_epi32(Low, _mm_madd_epi16(_mm_unpacklo_epi16(Row0, Row1), Pair));
+      High = _mm_add_epi32(High, _mm_madd_epi16(_mm_unpackhi_epi16(Row0, Row1), Pair));
+    }
+
+    Low = _mm_srai_epi32(Low, DIB_FILTER_WEIGHT_BITS + DIB_FILTER_CHANNEL_BITS);
+    High = _mm_srai_epi32(High, DIB_FILTER_WEIGHT_BITS + DIB_FILTER_CHANNEL_BITS);
+    Low = _mm_packs_epi32(Low, High);
+    _mm_storel_epi64((__m128i *)(Dst + i), _mm_packus_epi16(Low, Low));
+  }
+
+  /* The last pixel of an odd row */
+  if (i < Count)
+  {
+    Low = Round;
+
+    for (k = 0; k < Taps; k += 2)
+    {
+      Row0 = _mm_loadl_epi64((const __m128i *)(Rows[k] + i * 4));
+      if (k + 1 < Taps)
+      {
+        Row1 = _mm_loadl_epi64((const __m128i *)(Rows[k + 1] + i * 4));
+        Pair = WEIGHT_PAIR(Weights[k], Weights[k + 1]);
+      }
+      else
+      {
+        Row1 = Zero;
+        Pair = WEIGHT_PAIR(Weights[k], 0);
+      }
+
+      Low = _mm_add_epi32(Low, _mm_madd_epi16(_mm_unpacklo_epi16(Row0, Row1), Pair));
+    }
+
+    Low = _mm_srai_epi32(Low, DIB_FILTER_WEIGHT_BITS + DIB_FILTER_CHANNEL_BITS);
+    Low = _mm_packs_epi32(Low, Low);
+    Dst[i] = (ULONG)_mm_cvtsi128_si32(_mm_packus_epi16(Low, Low));
+  }
+}
+
+const DIB_ROW_FUNCTIONS DibRowFunctionsSse2 =
+{
+  DIB_RowBlend32Sse2,
+  DIB_RowBlend16Sse2,
+  DIB_RowTransparent32Sse2,
+  DIB_RowTransparent16Sse2,
+  DIB_RowFill32Sse2,
+  DIB_RowFill16Sse2,
+  DIB_RowSwapRedBlue32Sse2,
+  DIB_RowPack32to16Sse2,
+  DIB_RowFilterXSse2,
+  DIB_RowFilterYSse2
+};
+
+/* EOF */
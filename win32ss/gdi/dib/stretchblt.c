@@ -229,4 +229,250 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *Ma
   return TRUE;
 }
 
+/*
+ * HALFTONE stretching of 24bpp and 32bpp sources with 8 bits per channel.
+ *
+ * Each axis is resampled separately in fixed point: a box filter that
+ * averages all covered source pixels when shrinking, bilinear when
+ * growing. The horizontal pass runs once per source row into a ring of
+ * DIB_FILTER_CHANNEL_BITS precision rows, the vertical pass combines those
+ * into the output row, which is then translated to the destination format.
+ */
+
+/* More taps than this means shrinking over 60 times, use nearest neighbour */
+#define STRETCH_MAX_TAPS 64
+
+static ULONG
+DIB_StretchTaps(LONG SrcSize, LONG DstSize)
+{
+  if (SrcSize == DstSize || SrcSize == 1)
+    return 1;
+
+  if (SrcSize < DstSize)
+    return 2;
+
+  /* A destination pixel covers up to this many source pixels */
+  return min((ULONG)((SrcSize + DstSize - 1) / DstSize + 1), (ULONG)SrcSize);
+}
+
+/* Computes the first source pixel and the weights of destination pixels
+ * First to First + Count - 1, out of DstSize pixels mapped onto SrcSize */
+static VOID
+DIB_StretchWeights(LONG SrcSize, LONG DstSize, LONG First, LONG Count,
+                   ULONG Taps, PULONG SrcFirst, PSHORT Weights)
+{
+  const LONG One = 1 << DIB_FILTER_WEIGHT_BITS;
+  LONGLONG Position, Start, End;
+  LONG i, k, x, Source, Fraction, Sum, Largest;
+  SHORT Weight;
+
+  for (i = 0; i < Count; i++, Weights += Taps)
+  {
+    x = First + i;
+    RtlZeroMemory(Weights, Taps * sizeof(SHORT));
+
+    if (Taps == 1)
+    {
+      /* Same size, or a single source pixel */
+      SrcFirst[i] = (SrcSize == 1) ? 0 : x;
+      Weights[0] = (SHORT)One;
+    }
+    else if (SrcSize < DstSize)
+    {
+      /* Bilinear between the two source pixels around the center of x */
+      Position = ((LONGLONG)(2 * x + 1) * SrcSize - DstSize) * One / (2 * DstSize);
+      if (Position < 0)
+        Position = 0;
+
+      Source = (LONG)(Position >> DIB_FILTER_WEIGHT_BITS);
+      Fraction = (LONG)(Position & (One - 1));
+
+      if (Source >= SrcSize - 1)
+      {
+        Source = SrcSize - 2;
+        Fraction = One;
+      }
+
+      SrcFirst[i] = Source;
+      Weights[0] = (SHORT)(One - Fraction);
+      Weights[1] = (SHORT)Fraction;
+    }
+    else
+    {
+      /* Box filter, x covers [x * SrcSize, (x + 1) * SrcSize) in units of
+       * 1 / DstSize of a source pixel */
+      Start = (LONGLONG)x * SrcSize;
+      End = Start + SrcSize;
+      Source = (LONG)(Start / DstSize);
+
+      /* Stay inside the source, the weights move with the first pixel */
+      SrcFirst[i] = min(Source, SrcSize - (LONG)Taps);
+      k = Source - (LONG)SrcFirst[i];
+
+      Sum = 0;
+      Largest = k;
+      for (; Source < SrcSize && (LONGLONG)Source * DstSize < End; Source++, k++)
+      {
+        Position = min((LONGLONG)(Source + 1) * DstSize, End) -
+                   max((LONGLONG)Source * DstSize, Start);
+        Weight = (SHORT)(Position * One / SrcSize);
+        Weights[k] = Weight;
+        Sum += Weight;
+        if (Weight > Weights[Largest])
+          Largest = k;
+      }
+
+      /* Make the weights add up to exactly one, so flat areas stay flat */
+      Weights[Largest] += (SHORT)(One - Sum);
+    }
+  }
+}
+
+BOOLEAN
+DIB_XXBPP_StretchBltHalftone(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                             RECTL *DestRect, RECTL *SourceRect, RECTL *ClipRect,
+                             XLATEOBJ *ColorTranslation)
+{
+  LONG SrcWidth, SrcHeight, DstWidth, DstHeight, Width, Height;
+  LONG x, y, Row, SpanFirst, SpanWidth, SourceBpp, DestBpp;
+  ULONG TapsX, TapsY, k, Slot;
+  SIZE_T Size;
+  PBYTE Buffer, SourceLine, DestLine;
+  PULONG FirstX, FirstY, Span, Output;
+  PSHORT WeightsX, WeightsY, Ring;
+  PLONG RingRow;
+  const SHORT *Rows[STRETCH_MAX_TAPS];
+  const DIB_ROW_FUNCTIONS *RowFunctions;
+  DIB_ROW_CONTEXT RowContext;
+  XLATEROW ExpandRow, OutputRow;
+  BOOLEAN DirectOutput;
+
+  SrcWidth = SourceRect->right - SourceRect->left;
+  SrcHeight = SourceRect->bottom - SourceRect->top;
+  DstWidth = DestRect->right - DestRect->left;
+  DstHeight = DestRect->bottom - DestRect->top;
+  Width = ClipRect->right - ClipRect->left;
+  Height = ClipRect->bottom - ClipRect->top;
+
+  /* Only 8 bits per channel can be filtered, the rest is done by StretchBlt */
+  if ((SourceSurf->iBitmapFormat != BMF_24BPP && SourceSurf->iBitmapFormat != BMF_32BPP) ||
+      DestSurf->iBitmapFormat < BMF_8BPP || DestSurf->iBitmapFormat > BMF_32BPP ||
+      (!ColorTranslation && DestSurf->iBitmapFormat < BMF_24BPP) ||
+      (ColorTranslation &&
+       !(((PEXLATEOBJ)ColorTranslation)->ppalSrc->flFlags & (PAL_RGB | PAL_BGR))))
+  {
+    return FALSE;
+  }
+
+  if (SrcWidth <= 0 || SrcHeight <= 0 || DstWidth <= 0 || DstHeight <= 0 ||
+      Width <= 0 || Height <= 0 ||
+      SourceRect->left < 0 || SourceRect->top < 0 ||
+      SourceRect->right > SourceSurf->sizlBitmap.cx ||
+      SourceRect->bottom > SourceSurf->sizlBitmap.cy ||
+      ClipRect->left < DestRect->left || ClipRect->top < DestRect->top ||
+      ClipRect->right > DestRect->right || ClipRect->bottom > DestRect->bottom)
+  {
+    return FALSE;
+  }
+
+  TapsX = DIB_StretchTaps(SrcWidth, DstWidth);
+  TapsY = DIB_StretchTaps(SrcHeight, DstHeight);
+  if (TapsX > STRETCH_MAX_TAPS || TapsY > STRETCH_MAX_TAPS)
+    return FALSE;
+
+  /* One allocation for the taps, the ring of filtered rows, a source span
+   * for 24bpp sources and an output row */
+  Size = Width * (sizeof(ULONG) + TapsX * sizeof(SHORT)) +
+         Height * (sizeof(ULONG) + TapsY * sizeof(SHORT)) +
+         TapsY * (sizeof(LONG) + Width * 4 * sizeof(SHORT)) +
+         (SrcWidth + Width) * sizeof(ULONG) + 4 * sizeof(ULONG);
+  Buffer = ExAllocatePoolWithTag(PagedPool, Size, TAG_DIB);
+  if (!Buffer)
+  {
+    DPRINT1("Could not allocate %Iu bytes for the stretch.\n", Size);
+    return FALSE;
+  }
+
+  FirstX = (PULONG)Buffer;
+  FirstY = FirstX + Width;
+  RingRow = (PLONG)(FirstY + Height);
+  Span = (PULONG)(RingRow + TapsY);
+  Output = Span + SrcWidth;
+  Ring = (PSHORT)(Output + Width);
+  WeightsX = Ring + TapsY * Width * 4;
+  WeightsY = WeightsX + Width * TapsX;
+
+  DIB_StretchWeights(SrcWidth, DstWidth, ClipRect->left - DestRect->left, Width,
+                     TapsX, FirstX, WeightsX);
+  DIB_StretchWeights(SrcHeight, DstHeight, ClipRect->top - DestRect->top, Height,
+                     TapsY, FirstY, WeightsY);
+
+  /* Only the source columns the clip rect needs are filtered */
+  SpanFirst = FirstX[0];
+  SpanWidth = FirstX[Width - 1] + TapsX - SpanFirst;
+  for (x = 0; x < Width; x++)
+    FirstX[x] -= SpanFirst;
+
+  for (k = 0; k < TapsY; k++)
+    RingRow[k] = -1;
+
+  SourceBpp = BitsPerFormat(SourceSurf->iBitmapFormat) >> 3;
+  DestBpp = BitsPerFormat(DestSurf->iBitmapFormat) >> 3;
+  DirectOutput = DestSurf->iBitmapFormat == BMF_32BPP &&
+                 (!ColorTranslation || (ColorTranslation->flXlate & XO_TRIVIAL));
+
+  RowFunctions = DIB_BeginRowOperation(&RowContext, Width * Height * (TapsX + TapsY));
+  EXLATEOBJ_bInitXlateRow(&ExpandRow, NULL, BMF_24BPP, BMF_32BPP, RowFunctions);
+  EXLATEOBJ_bInitXlateRow(&OutputRow, ColorTranslation, BMF_32BPP,
+                          DestSurf->iBitmapFormat, RowFunctions);
+
+  DestLine = (PBYTE)DestSurf->pvScan0 + ClipRect->top * DestSurf->lDelta +
+             ClipRect->left * DestBpp;
+
+  for (y = 0; y < Height; y++)
+  {
+    /* Filter the source rows this row needs that are not in the ring yet.
+     * FirstY never goes back, so the ring never drops a row still needed */
+    for (k = 0; k < TapsY; k++)
+    {
+      Row = FirstY[y] + k;
+      Slot = Row % TapsY;
+      Rows[k] = Ring + Slot * Width * 4;
+
+      if (RingRow[Slot] == Row)
+        continue;
+
+      SourceLine = (PBYTE)SourceSurf->pvScan0 +
+                   (SourceRect->top + Row) * SourceSurf->lDelta +
+                   (SourceRect->left + SpanFirst) * SourceBpp;
+
+      if (SourceSurf->iBitmapFormat == BMF_24BPP)
+      {
+        XLATEROW_vXlate(&ExpandRow, Span, SourceLine, SpanWidth);
+        SourceLine = (PBYTE)Span;
+      }
+
+      RowFunctions->FilterX((PSHORT)Rows[k], (PULONG)SourceLine, FirstX, WeightsX, TapsX, Width);
+      RingRow[Slot] = Row;
+    }
+
+    if (DirectOutput)
+    {
+      RowFunctions->FilterY((PULONG)DestLine, Rows, WeightsY + y * TapsY, TapsY, Width);
+    }
+    else
+    {
+      RowFunctions->FilterY(Output, Rows, WeightsY + y * TapsY, TapsY, Width);
+      XLATEROW_vXlate(&OutputRow, DestLine, Output, Width);
+    }
+
+    DestLine += DestSurf->lDelta;
+  }
+
+  DIB_EndRowOperation(&RowContext);
+  ExFreePoolWithTag(Buffer, TAG_DIB);
+
+  return TRUE;
+}
+
 /* EOF */
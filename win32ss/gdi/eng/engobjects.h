@@ -129,11 +129,13 @@ typedef struct _SHARED_FACE_CACHE {
 } SHARED_FACE_CACHE, *PSHARED_FACE_CACHE;
 
 typedef struct _SHARED_FACE {
-  FT_Face       Face;
+  FT_Face       Face;           /* NULL until first use for fonts listed from the metadata cache */
   LONG          RefCount;
   PSHARED_MEM   Memory;
   SHARED_FACE_CACHE EnglishUS;
   SHARED_FACE_CACHE UserLanguage;
+  LONG          FaceIndex;
+  BOOL          LoadFailed;
 } SHARED_FACE, *PSHARED_FACE;
 
 typedef struct _FONTGDI {
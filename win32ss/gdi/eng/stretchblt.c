@@ -465,6 +465,79 @@ EngStretchBlt(
         ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY));
 }
 
+/*
+ * Filters a HALFTONE stretch of a bitmap in the DIB code, see
+ * DIB_XXBPP_StretchBltHalftone. Only plain unflipped source copies between
+ * two bitmaps the driver does not stretch itself qualify; everything else,
+ * or a failure part way, is left to the nearest neighbour stretch.
+ */
+static BOOL
+IntEngStretchBltHalftone(SURFOBJ *psoDest,
+                         SURFOBJ *psoSource,
+                         CLIPOBJ *ClipRegion,
+                         XLATEOBJ *ColorTranslation,
+                         RECTL *DestRect,
+                         RECTL *SourceRect)
+{
+    SURFACE *psurfDest = CONTAINING_RECORD(psoDest, SURFACE, SurfObj);
+    RECTL SurfaceRect, BoundsRect, ClipRect, CombinedRect;
+    RECT_ENUM RectEnum;
+    BOOL EnumMore;
+    ULONG i;
+
+    if (psoSource == NULL ||
+        psoDest->iType != STYPE_BITMAP ||
+        psoSource->iType != STYPE_BITMAP ||
+        psoDest->pvScan0 == psoSource->pvScan0 ||
+        (psurfDest->flags & HOOK_STRETCHBLTROP))
+    {
+        return FALSE;
+    }
+
+    SurfaceRect.left = 0;
+    SurfaceRect.top = 0;
+    SurfaceRect.right = psoDest->sizlBitmap.cx;
+    SurfaceRect.bottom = psoDest->sizlBitmap.cy;
+    if (!RECTL_bIntersectRect(&BoundsRect, DestRect, &SurfaceRect))
+        return TRUE;
+
+    switch (ClipRegion->iDComplexity)
+    {
+        case DC_TRIVIAL:
+            return DIB_XXBPP_StretchBltHalftone(psoDest, psoSource, DestRect, SourceRect,
+                                                &BoundsRect, ColorTranslation);
+
+        case DC_RECT:
+            if (!RECTL_bIntersectRect(&CombinedRect, &BoundsRect, &ClipRegion->rclBounds))
+                return TRUE;
+
+            return DIB_XXBPP_StretchBltHalftone(psoDest, psoSource, DestRect, SourceRect,
+                                                &CombinedRect, ColorTranslation);
+
+        case DC_COMPLEX:
+            CLIPOBJ_cEnumStart(ClipRegion, FALSE, CT_RECTANGLES, CD_ANY, 0);
+            do
+            {
+                EnumMore = CLIPOBJ_bEnum(ClipRegion, (ULONG)sizeof(RectEnum), (PVOID)&RectEnum);
+
+                for (i = 0; i < RectEnum.c; i++)
+                {
+                    ClipRect = RectEnum.arcl[i];
+                    if (RECTL_bIntersectRect(&CombinedRect, &BoundsRect, &ClipRect) &&
+                        !DIB_XXBPP_StretchBltHalftone(psoDest, psoSource, DestRect, SourceRect,
+                                                      &CombinedRect, ColorTranslation))
+                    {
+                        return FALSE;
+                    }
+                }
+            }
+            while (EnumMore);
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 BOOL APIENTRY
 IntEngStretchBlt(SURFOBJ *psoDest,
                  SURFOBJ *psoSource,
@@ -477,7 +550,8 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                  POINTL *pMaskOrigin,
                  BRUSHOBJ *pbo,
                  POINTL *BrushOrigin,
-                 DWORD Rop4)
+                 DWORD Rop4,
+                 ULONG iMode)
 {
     BOOLEAN ret;
     POINTL MaskOrigin = {0, 0};
@@ -631,6 +705,15 @@ IntEngStretchBlt(SURFOBJ *psoDest,
 
     DPRINT("source and dest size are NOT equal.\n");
 
+    if (iMode == HALFTONE && MaskSurf == NULL &&
+        Rop4 == ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY) &&
+        cxSrc > 0 && cySrc > 0 && cxDest > 0 && cyDest > 0 &&
+        IntEngStretchBltHalftone(psoDest, psoSource, ClipRegion, ColorTranslation,
+                                 DestRect, SourceRect))
+    {
+        return TRUE;
+    }
+
     DPRINT("SourceRect: (%d,%d)-(%d,%d) and DestRect: (%d,%d)-(%d,%d)\n",
            SourceRect->left, SourceRect->top, SourceRect->right, SourceRect->bottom,
            DestRect->left, DestRect->top, DestRect->right, DestRect->bottom);
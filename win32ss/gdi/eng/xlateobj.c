@@ -35,6 +35,62 @@ static const BYTE gajXlate6to8[64] =
 130,134,138,142,146,150,154,158,162,166,170,174,178,182,186,190,
 194,198,202,207,210,215,219,223,227,231,235,239,243,247,251,255};
 
+/* Lookups an xlate object does before it sets up a nearest index cache */
+#define XLATE_CACHE_MIN_LOOKUPS 32
+
+/* Pixels the generic row routine translates per pass */
+#define XLATE_ROW_CHUNK 64
+
+
+/** Nearest index cache *******************************************************/
+
+/*
+ * The RGB to palette translations search the whole destination palette for
+ * every pixel. Blits of real images repeat colors a lot, so remember the
+ * last index found per hash slot. The cache lives in the xlate object,
+ * which only exists for one call, so changes to the palette never make it
+ * stale.
+ */
+static
+ULONG
+EXLATEOBJ_iNearestIndex(
+    _Inout_ PEXLATEOBJ pexlo,
+    _In_ ULONG iColor)
+{
+    PXLATECACHE pCache = pexlo->pCache;
+    ULONG iSlot, iIndex;
+
+    /* Only the color counts, the high byte is ignored by the search */
+    iColor &= 0xFFFFFF;
+
+    if (!pCache)
+    {
+        /* Small blits are not worth the allocation */
+        if (++pexlo->cCacheLookups != XLATE_CACHE_MIN_LOOKUPS)
+            return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+
+        /* On failure the counter has passed the limit, so don't retry */
+        pCache = EngAllocMem(0, sizeof(XLATECACHE), GDITAG_PXLATE);
+        if (!pCache)
+            return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+
+        /* No color has the high byte set, so all slots start empty */
+        RtlFillMemory(pCache->aulColor, sizeof(pCache->aulColor), 0xFF);
+        pexlo->pCache = pCache;
+    }
+
+    iSlot = (iColor * 0x9E3779B1) >> 24;
+
+    if (pCache->aulColor[iSlot] == iColor)
+        return pCache->aulIndex[iSlot];
+
+    iIndex = PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    pCache->aulColor[iSlot] = iColor;
+    pCache->aulIndex[iSlot] = iIndex;
+
+    return iIndex;
+}
+
 
 /** iXlate functions **********************************************************/
 
@@ -179,7 +235,7 @@ ULONG
 FASTCALL
 EXLATEOBJ_iXlateRGBtoPal(PEXLATEOBJ pexlo, ULONG iColor)
 {
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 _Function_class_(FN_XLATE)
@@ -252,7 +308,7 @@ EXLATEOBJ_iXlate555toPal(PEXLATEOBJ pexlo, ULONG iColor)
 {
     iColor = EXLATEOBJ_iXlate555toRGB(pexlo, iColor);
 
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 _Function_class_(FN_XLATE)
@@ -321,7 +377,7 @@ EXLATEOBJ_iXlate565toPal(EXLATEOBJ *pexlo, ULONG iColor)
 {
     iColor = EXLATEOBJ_iXlate565toRGB(pexlo, iColor);
 
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 _Function_class_(FN_XLATE)
@@ -347,7 +403,283 @@ EXLATEOBJ_iXlateBitfieldsToPal(PEXLATEOBJ pexlo, ULONG iColor)
     iColor = EXLATEOBJ_iXlateShiftAndMask(pexlo, iColor);
 
     /* Return nearest index */
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
+}
+
+
+/** Row functions *************************************************************/
+
+/*
+ * These convert a whole row per call. The common format pairs call the
+ * iXlate functions above directly, so the compiler can inline them, or use
+ * the SIMD row kernels of the DIB code. Everything else goes through
+ * XLATEROW_vGeneric, which still saves the per pixel format handling of the
+ * blit loops.
+ */
+
+static
+VOID
+FASTCALL
+XLATEROW_vCopy(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    RtlMoveMemory(pvDst, pvSrc, cPixels * (BitsPerFormat(pxr->iDstFormat) >> 3));
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_vSwapRedBlue32(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    pxr->pRowFunctions->SwapRedBlue32(pvDst, pvSrc, cPixels);
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_vPack32to16(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    PFN_XLATE pfnXlate = pxr->pexlo->pfnXlate;
+
+    pxr->pRowFunctions->Pack32to16(pvDst,
+                                   pvSrc,
+                                   cPixels,
+                                   pfnXlate == EXLATEOBJ_iXlateRGBto555 ||
+                                   pfnXlate == EXLATEOBJ_iXlateRGBto565,
+                                   pfnXlate == EXLATEOBJ_iXlateRGBto555 ||
+                                   pfnXlate == EXLATEOBJ_iXlateBGRto555);
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_v555to32(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    const USHORT *pusSrc = pvSrc;
+    PULONG pulDst = pvDst;
+    ULONG i;
+
+    /* The 5 to 8 bit table is not a plain formula, so this stays scalar */
+    if (pxr->pexlo->pfnXlate == EXLATEOBJ_iXlate555toRGB)
+    {
+        for (i = 0; i < cPixels; i++)
+            pulDst[i] = EXLATEOBJ_iXlate555toRGB(pxr->pexlo, pusSrc[i]);
+    }
+    else
+    {
+        for (i = 0; i < cPixels; i++)
+            pulDst[i] = EXLATEOBJ_iXlate555toBGR(pxr->pexlo, pusSrc[i]);
+    }
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_v565to32(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    const USHORT *pusSrc = pvSrc;
+    PULONG pulDst = pvDst;
+    ULONG i;
+
+    if (pxr->pexlo->pfnXlate == EXLATEOBJ_iXlate565toRGB)
+    {
+        for (i = 0; i < cPixels; i++)
+            pulDst[i] = EXLATEOBJ_iXlate565toRGB(pxr->pexlo, pusSrc[i]);
+    }
+    else
+    {
+        for (i = 0; i < cPixels; i++)
+            pulDst[i] = EXLATEOBJ_iXlate565toBGR(pxr->pexlo, pusSrc[i]);
+    }
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_v16to16(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    const USHORT *pusSrc = pvSrc;
+    PUSHORT pusDst = pvDst;
+    ULONG i;
+
+    if (pxr->pexlo->pfnXlate == EXLATEOBJ_iXlate555to565)
+    {
+        for (i = 0; i < cPixels; i++)
+            pusDst[i] = (USHORT)EXLATEOBJ_iXlate555to565(pxr->pexlo, pusSrc[i]);
+    }
+    else
+    {
+        for (i = 0; i < cPixels; i++)
+            pusDst[i] = (USHORT)EXLATEOBJ_iXlate565to555(pxr->pexlo, pusSrc[i]);
+    }
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_vTable8(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    const BYTE *pjSrc = pvSrc;
+    PBYTE pjDst = pvDst;
+    ULONG i, iColor;
+
+    switch (pxr->iDstFormat)
+    {
+        case BMF_16BPP:
+            for (i = 0; i < cPixels; i++)
+                ((PUSHORT)pjDst)[i] = (USHORT)EXLATEOBJ_iXlateTable(pxr->pexlo, pjSrc[i]);
+            break;
+
+        case BMF_24BPP:
+            for (i = 0; i < cPixels; i++, pjDst += 3)
+            {
+                iColor = EXLATEOBJ_iXlateTable(pxr->pexlo, pjSrc[i]);
+                pjDst[0] = (BYTE)iColor;
+                pjDst[1] = (BYTE)(iColor >> 8);
+                pjDst[2] = (BYTE)(iColor >> 16);
+            }
+            break;
+
+        default:
+            for (i = 0; i < cPixels; i++)
+                ((PULONG)pjDst)[i] = EXLATEOBJ_iXlateTable(pxr->pexlo, pjSrc[i]);
+            break;
+    }
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_v24to32(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    const BYTE *pjSrc = pvSrc;
+    PULONG pulDst = pvDst;
+    ULONG i;
+
+    if (pxr->pexlo->pfnXlate == EXLATEOBJ_iXlateRGBtoBGR)
+    {
+        for (i = 0; i < cPixels; i++, pjSrc += 3)
+            pulDst[i] = (pjSrc[0] << 16) | (pjSrc[1] << 8) | pjSrc[2];
+    }
+    else
+    {
+        for (i = 0; i < cPixels; i++, pjSrc += 3)
+            pulDst[i] = (pjSrc[2] << 16) | (pjSrc[1] << 8) | pjSrc[0];
+    }
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_v32to24(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    const ULONG *pulSrc = pvSrc;
+    PBYTE pjDst = pvDst;
+    ULONG i, iColor;
+
+    if (pxr->pexlo->pfnXlate == EXLATEOBJ_iXlateRGBtoBGR)
+    {
+        for (i = 0; i < cPixels; i++, pjDst += 3)
+        {
+            iColor = pulSrc[i];
+            pjDst[0] = (BYTE)(iColor >> 16);
+            pjDst[1] = (BYTE)(iColor >> 8);
+            pjDst[2] = (BYTE)iColor;
+        }
+    }
+    else
+    {
+        for (i = 0; i < cPixels; i++, pjDst += 3)
+        {
+            iColor = pulSrc[i];
+            pjDst[0] = (BYTE)iColor;
+            pjDst[1] = (BYTE)(iColor >> 8);
+            pjDst[2] = (BYTE)(iColor >> 16);
+        }
+    }
+}
+
+static
+VOID
+FASTCALL
+XLATEROW_vGeneric(PXLATEROW pxr, PVOID pvDst, const VOID *pvSrc, ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = pxr->pexlo;
+    ULONG aulColor[XLATE_ROW_CHUNK];
+    const BYTE *pjSrc = pvSrc;
+    PBYTE pjDst = pvDst;
+    ULONG i, cChunk;
+
+    while (cPixels)
+    {
+        cChunk = min(cPixels, XLATE_ROW_CHUNK);
+
+        /* Read a chunk of source pixels */
+        switch (pxr->iSrcFormat)
+        {
+            case BMF_8BPP:
+                for (i = 0; i < cChunk; i++)
+                    aulColor[i] = pjSrc[i];
+                break;
+
+            case BMF_16BPP:
+                for (i = 0; i < cChunk; i++)
+                    aulColor[i] = ((const USHORT *)pjSrc)[i];
+                break;
+
+            case BMF_24BPP:
+                for (i = 0; i < cChunk; i++)
+                {
+                    aulColor[i] = (pjSrc[3 * i + 2] << 16) |
+                                  (pjSrc[3 * i + 1] << 8) |
+                                  pjSrc[3 * i];
+                }
+                break;
+
+            default:
+                for (i = 0; i < cChunk; i++)
+                    aulColor[i] = ((const ULONG *)pjSrc)[i];
+                break;
+        }
+
+        /* Translate it */
+        if (pexlo->pfnXlate != EXLATEOBJ_iXlateTrivial)
+        {
+            for (i = 0; i < cChunk; i++)
+                aulColor[i] = pexlo->pfnXlate(pexlo, aulColor[i]);
+        }
+
+        /* And write it out */
+        switch (pxr->iDstFormat)
+        {
+            case BMF_8BPP:
+                for (i = 0; i < cChunk; i++)
+                    pjDst[i] = (BYTE)aulColor[i];
+                break;
+
+            case BMF_16BPP:
+                for (i = 0; i < cChunk; i++)
+                    ((PUSHORT)pjDst)[i] = (USHORT)aulColor[i];
+                break;
+
+            case BMF_24BPP:
+                for (i = 0; i < cChunk; i++)
+                {
+                    pjDst[3 * i] = (BYTE)aulColor[i];
+                    pjDst[3 * i + 1] = (BYTE)(aulColor[i] >> 8);
+                    pjDst[3 * i + 2] = (BYTE)(aulColor[i] >> 16);
+                }
+                break;
+
+            default:
+                for (i = 0; i < cChunk; i++)
+                    ((PULONG)pjDst)[i] = aulColor[i];
+                break;
+        }
+
+        pjSrc += cChunk * (BitsPerFormat(pxr->iSrcFormat) >> 3);
+        pjDst += cChunk * (BitsPerFormat(pxr->iDstFormat) >> 3);
+        cPixels -= cChunk;
+    }
 }
 
 
@@ -375,6 +707,8 @@ EXLATEOBJ_vInitialize(
     pexlo->xlo.pulXlate = pexlo->aulXlate;
     pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
     pexlo->hColorTransform = NULL;
+    pexlo->pCache = NULL;
+    pexlo->cCacheLookups = 0;
     pexlo->ppalSrc = ppalSrc;
     pexlo->ppalDst = ppalDst;
     pexlo->xlo.iSrcType = (USHORT)ppalSrc->flFlags;
@@ -654,6 +988,95 @@ EXLATEOBJ_vCleanup(
         EngFreeMem(pexlo->xlo.pulXlate);
     }
     pexlo->xlo.pulXlate = pexlo->aulXlate;
+
+    if (pexlo->pCache)
+    {
+        EngFreeMem(pexlo->pCache);
+        pexlo->pCache = NULL;
+    }
+}
+/*
+ * Sets up pxr to translate rows of iSrcFormat pixels to iDstFormat with
+ * pxlo, which may be NULL for no translation. The SIMD conversions use
+ * pRowFunctions, so on x86 the caller must keep the DIB_ROW_CONTEXT it got
+ * them from open while it translates. Fails for formats of less than 8 bits
+ * per pixel, the caller must translate those itself.
+ */
+BOOL
+NTAPI
+EXLATEOBJ_bInitXlateRow(
+    _Out_ PXLATEROW pxr,
+    _In_opt_ XLATEOBJ *pxlo,
+    _In_ ULONG iSrcFormat,
+    _In_ ULONG iDstFormat,
+    _In_ const DIB_ROW_FUNCTIONS *pRowFunctions)
+{
+    PEXLATEOBJ pexlo = pxlo ? (PEXLATEOBJ)pxlo : &gexloTrivial;
+    PFN_XLATE pfnXlate = pexlo->pfnXlate;
+
+    if (iSrcFormat < BMF_8BPP || iSrcFormat > BMF_32BPP ||
+        iDstFormat < BMF_8BPP || iDstFormat > BMF_32BPP)
+    {
+        return FALSE;
+    }
+
+    pxr->pexlo = pexlo;
+    pxr->pRowFunctions = pRowFunctions;
+    pxr->iSrcFormat = iSrcFormat;
+    pxr->iDstFormat = iDstFormat;
+    pxr->pfnXlateRow = XLATEROW_vGeneric;
+
+    if (pfnXlate == EXLATEOBJ_iXlateTrivial)
+    {
+        if (iSrcFormat == iDstFormat)
+            pxr->pfnXlateRow = XLATEROW_vCopy;
+        else if (iSrcFormat == BMF_24BPP && iDstFormat == BMF_32BPP)
+            pxr->pfnXlateRow = XLATEROW_v24to32;
+        else if (iSrcFormat == BMF_32BPP && iDstFormat == BMF_24BPP)
+            pxr->pfnXlateRow = XLATEROW_v32to24;
+    }
+    else if (pfnXlate == EXLATEOBJ_iXlateTable)
+    {
+        if (iSrcFormat == BMF_8BPP && iDstFormat != BMF_8BPP)
+            pxr->pfnXlateRow = XLATEROW_vTable8;
+    }
+    else if (pfnXlate == EXLATEOBJ_iXlateRGBtoBGR)
+    {
+        if (iSrcFormat == BMF_32BPP && iDstFormat == BMF_32BPP)
+            pxr->pfnXlateRow = XLATEROW_vSwapRedBlue32;
+        else if (iSrcFormat == BMF_24BPP && iDstFormat == BMF_32BPP)
+            pxr->pfnXlateRow = XLATEROW_v24to32;
+        else if (iSrcFormat == BMF_32BPP && iDstFormat == BMF_24BPP)
+            pxr->pfnXlateRow = XLATEROW_v32to24;
+    }
+    else if (pfnXlate == EXLATEOBJ_iXlateRGBto555 ||
+             pfnXlate == EXLATEOBJ_iXlateRGBto565 ||
+             pfnXlate == EXLATEOBJ_iXlateBGRto555 ||
+             pfnXlate == EXLATEOBJ_iXlateBGRto565)
+    {
+        if (iSrcFormat == BMF_32BPP && iDstFormat == BMF_16BPP)
+            pxr->pfnXlateRow = XLATEROW_vPack32to16;
+    }
+    else if (pfnXlate == EXLATEOBJ_iXlate555toRGB ||
+             pfnXlate == EXLATEOBJ_iXlate555toBGR)
+    {
+        if (iSrcFormat == BMF_16BPP && iDstFormat == BMF_32BPP)
+            pxr->pfnXlateRow = XLATEROW_v555to32;
+    }
+    else if (pfnXlate == EXLATEOBJ_iXlate565toRGB ||
+             pfnXlate == EXLATEOBJ_iXlate565toBGR)
+    {
+        if (iSrcFormat == BMF_16BPP && iDstFormat == BMF_32BPP)
+            pxr->pfnXlateRow = XLATEROW_v565to32;
+    }
+    else if (pfnXlate == EXLATEOBJ_iXlate555to565 ||
+             pfnXlate == EXLATEOBJ_iXlate565to555)
+    {
+        if (iSrcFormat == BMF_16BPP && iDstFormat == BMF_16BPP)
+            pxr->pfnXlateRow = XLATEROW_v16to16;
+    }
+
+    return TRUE;
 }
 
 /** Public DDI Functions ******************************************************/
@@ -8,6 +8,8 @@
  */
 
 struct _EXLATEOBJ;
+struct _XLATEROW;
+struct _DIB_ROW_FUNCTIONS;
 
 _Function_class_(FN_XLATE)
 typedef
@@ -16,6 +18,23 @@ ULONG
     _In_ struct _EXLATEOBJ *pexlo,
     _In_ ULONG iColor);
 
+typedef
+VOID
+(FASTCALL *PFN_XLATE_ROW)(
+    _In_ struct _XLATEROW *pxr,
+    _Out_ PVOID pvDst,
+    _In_ const VOID *pvSrc,
+    _In_ ULONG cPixels);
+
+/* Direct mapped cache of nearest palette indexes, see EXLATEOBJ_iNearestIndex */
+#define XLATE_CACHE_SIZE 256
+
+typedef struct _XLATECACHE
+{
+    ULONG aulColor[XLATE_CACHE_SIZE];
+    ULONG aulIndex[XLATE_CACHE_SIZE];
+} XLATECACHE, *PXLATECACHE;
+
 typedef struct _EXLATEOBJ
 {
     XLATEOBJ xlo;
@@ -28,6 +47,9 @@ typedef struct _EXLATEOBJ
 
     HANDLE hColorTransform;
 
+    PXLATECACHE pCache;
+    ULONG cCacheLookups;
+
     union
     {
         ULONG aulXlate[6];
@@ -43,6 +65,16 @@ typedef struct _EXLATEOBJ
     };
 } EXLATEOBJ, *PEXLATEOBJ;
 
+/* Converts whole rows between two bitmap formats, see EXLATEOBJ_bInitXlateRow */
+typedef struct _XLATEROW
+{
+    PFN_XLATE_ROW pfnXlateRow;
+    PEXLATEOBJ pexlo;
+    const struct _DIB_ROW_FUNCTIONS *pRowFunctions;
+    ULONG iSrcFormat;
+    ULONG iDstFormat;
+} XLATEROW, *PXLATEROW;
+
 extern EXLATEOBJ gexloTrivial;
 
 _Notnull_
@@ -84,3 +116,22 @@ NTAPI
 EXLATEOBJ_vCleanup(
     _Inout_ PEXLATEOBJ pexlo);
 
+BOOL
+NTAPI
+EXLATEOBJ_bInitXlateRow(
+    _Out_ PXLATEROW pxr,
+    _In_opt_ XLATEOBJ *pxlo,
+    _In_ ULONG iSrcFormat,
+    _In_ ULONG iDstFormat,
+    _In_ const struct _DIB_ROW_FUNCTIONS *pRowFunctions);
+
+FORCEINLINE
+VOID
+XLATEROW_vXlate(
+    _In_ PXLATEROW pxr,
+    _Out_ PVOID pvDst,
+    _In_ const VOID *pvSrc,
+    _In_ ULONG cPixels)
+{
+    pxr->pfnXlateRow(pxr, pvDst, pvSrc, cPixels);
+}
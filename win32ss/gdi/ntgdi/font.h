@@ -50,6 +50,22 @@ typedef struct _FONT_CACHE_HASHED
     FT_Matrix matTransform;
 } FONT_CACHE_HASHED, *PFONT_CACHE_HASHED;
 
+/* The LOGFONTW fields GetFontPenalty looks at, normalized the way it compares them */
+typedef struct _FONT_MATCH_HASHED
+{
+    LONG lfHeight;
+    LONG lfWidth;
+    LONG lfWeight;          /* FW_DONTCARE is FW_NORMAL */
+    BYTE lfItalic;          /* 0 or 1, as are lfUnderline and lfStrikeOut */
+    BYTE lfUnderline;
+    BYTE lfStrikeOut;
+    BYTE lfCharSet;
+    BYTE lfOutPrecision;
+    BYTE lfPitchAndFamily;
+    WCHAR lfFaceName[LF_FACESIZE];  /* lower case, zero padded */
+    WORD Reserved;
+} FONT_MATCH_HASHED, *PFONT_MATCH_HASHED;
+
 #include <poppack.h>
 
 typedef struct _FONT_CACHE_ENTRY
@@ -63,6 +79,23 @@ typedef struct _FONT_CACHE_ENTRY
 C_ASSERT(FIELD_OFFSET(FONT_CACHE_ENTRY, Hashed) % sizeof(DWORD) == 0); /* for hashing */
 C_ASSERT(sizeof(FONT_CACHE_HASHED) % sizeof(DWORD) == 0); /* for hashing */
 
+/*
+ * FONT_MATCH_ENTRY --- the global font FindBestFontFromList chose for a
+ * substituted LOGFONTW, see IntFindBestGlobalFont
+ */
+typedef struct _FONT_MATCH_ENTRY
+{
+    LIST_ENTRY HashEntry;
+    LIST_ENTRY LruEntry;
+    FONTOBJ *FontObj;
+    ULONG Penalty;
+    DWORD dwHash;
+    FONT_MATCH_HASHED Hashed;
+} FONT_MATCH_ENTRY, *PFONT_MATCH_ENTRY;
+
+C_ASSERT(FIELD_OFFSET(FONT_MATCH_ENTRY, Hashed) % sizeof(DWORD) == 0); /* for hashing */
+C_ASSERT(sizeof(FONT_MATCH_HASHED) % sizeof(DWORD) == 0); /* for hashing */
+
 /*
  * FONTSUBST_... --- constants for font substitutes
  */
@@ -81,6 +114,42 @@ typedef struct FONTSUBST_ENTRY
 } FONTSUBST_ENTRY, *PFONTSUBST_ENTRY;
 
 
+/*
+ * FONT_METADATA --- what the font metadata cache remembers of a font file,
+ * stored as a binary registry value named after the file. The registry value
+ * name and then one FONT_METADATA_FACE per font entry follow the header,
+ * each ULONG aligned.
+ */
+#define FONT_METADATA_VERSION   1
+
+typedef struct _FONT_METADATA
+{
+    ULONG           Version;
+    USHORT          LanguageID;         /* of the localized names */
+    BOOLEAN         IsTrueType;
+    BYTE            Reserved;
+    LARGE_INTEGER   LastWriteTime;
+    LARGE_INTEGER   FileSize;
+    ULONG           FaceCount;          /* as counted by IntGdiLoadFontsFromMemory */
+    ULONG           EntryCount;
+    USHORT          RegValueNameLength;
+    USHORT          Reserved2;
+} FONT_METADATA, *PFONT_METADATA;
+
+typedef struct _FONT_METADATA_FACE
+{
+    USHORT          Size;               /* including the names and the padding */
+    BYTE            CharSet;
+    BYTE            OriginalItalic;
+    LONG            FaceIndex;
+    LONG            OriginalWeight;
+    USHORT          FaceNameLength;     /* names of the FONT_ENTRY */
+    USHORT          StyleNameLength;
+    USHORT          FamilyNameLength;   /* localized names of the SHARED_FACE */
+    USHORT          FullNameLength;
+    /* The four names follow in this order, not terminated */
+} FONT_METADATA_FACE, *PFONT_METADATA_FACE;
+
 typedef struct GDI_LOAD_FONT
 {
     PUNICODE_STRING     pFileName;
@@ -59,6 +59,10 @@ FT_Library  g_FreeTypeLibrary;
 static UNICODE_STRING g_FontRegPath =
     RTL_CONSTANT_STRING(L"\\REGISTRY\\Machine\\Software\\Microsoft\\Windows NT\\CurrentVersion\\Fonts");
 
+/* font metadata cache, see IntGdiLoadFontsFromMetadata */
+static UNICODE_STRING g_FontMetadataRegPath =
+    RTL_CONSTANT_STRING(L"\\REGISTRY\\Machine\\Software\\Microsoft\\Windows NT\\CurrentVersion\\FontMetadata");
+
 
 /* The FreeType library is not thread safe, so we have
    to serialize access to it */
@@ -94,6 +98,16 @@ static BOOL             g_RenderingEnabled = TRUE;
 static LIST_ENTRY g_FontCacheListHead;
 static UINT g_FontCacheNumEntries;
 
+/* Font realizations, protected by the global font list lock */
+#define MAX_FONT_MATCH_CACHE    128
+#define FONT_MATCH_BUCKETS      32
+
+static LIST_ENTRY g_FontMatchBuckets[FONT_MATCH_BUCKETS];
+static LIST_ENTRY g_FontMatchLruHead;
+static UINT g_FontMatchNumEntries;
+static ULONG g_FontMatchHits;
+static ULONG g_FontMatchMisses;
+
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
     L"Western", /* 00 */
@@ -211,6 +225,16 @@ SharedFaceCache_Init(PSHARED_FACE_CACHE Cache)
     RtlInitUnicodeString(&Cache->FullName, NULL);
 }
 
+/* The name cache IntGetFontLocalizedName uses for the user language */
+static PSHARED_FACE_CACHE
+SharedFace_GetUserCache(PSHARED_FACE SharedFace)
+{
+    if (PRIMARYLANGID(gusLanguageID) == LANG_ENGLISH)
+        return &SharedFace->EnglishUS;
+    else
+        return &SharedFace->UserLanguage;
+}
+
 static PSHARED_FACE
 SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
 {
@@ -223,6 +247,8 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Memory = Memory;
         SharedFaceCache_Init(&Ptr->EnglishUS);
         SharedFaceCache_Init(&Ptr->UserLanguage);
+        Ptr->FaceIndex = Face->face_index;
+        Ptr->LoadFailed = FALSE;
 
         SharedMem_AddRef(Memory);
         DPRINT("Creating SharedFace for %s\n", Face->family_name ? Face->family_name : "<NULL>");
@@ -230,6 +256,25 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
     return Ptr;
 }
 
+/* A face listed from the metadata cache, opened by SharedFace_Load */
+static PSHARED_FACE
+SharedFace_CreateDeferred(LONG FaceIndex)
+{
+    PSHARED_FACE Ptr;
+    Ptr = ExAllocatePoolWithTag(PagedPool, sizeof(SHARED_FACE), TAG_FONT);
+    if (Ptr)
+    {
+        Ptr->Face = NULL;
+        Ptr->RefCount = 1;
+        Ptr->Memory = NULL;
+        SharedFaceCache_Init(&Ptr->EnglishUS);
+        SharedFaceCache_Init(&Ptr->UserLanguage);
+        Ptr->FaceIndex = FaceIndex;
+        Ptr->LoadFailed = FALSE;
+    }
+    return Ptr;
+}
+
 static PSHARED_MEM
 SharedMem_Create(PBYTE Buffer, ULONG BufferSize, BOOL IsMapping)
 {
@@ -288,6 +333,25 @@ RemoveCacheEntries(FT_Face Face)
     }
 }
 
+/* Forgets every realization, the font lists have changed */
+static void
+IntFlushFontMatchCache(VOID)
+{
+    PLIST_ENTRY CurrentEntry;
+    PFONT_MATCH_ENTRY MatchEntry;
+
+    ASSERT_GLOBALFONTS_LOCK_HELD();
+
+    while (!IsListEmpty(&g_FontMatchLruHead))
+    {
+        CurrentEntry = RemoveHeadList(&g_FontMatchLruHead);
+        MatchEntry = CONTAINING_RECORD(CurrentEntry, FONT_MATCH_ENTRY, LruEntry);
+        RemoveEntryList(&MatchEntry->HashEntry);
+        ExFreePoolWithTag(MatchEntry, TAG_FONT);
+    }
+    g_FontMatchNumEntries = 0;
+}
+
 static void SharedMem_Release(PSHARED_MEM Ptr)
 {
     ASSERT_FREETYPE_LOCK_HELD();
@@ -327,10 +391,13 @@ SharedFace_Release(PSHARED_FACE Ptr)
     --Ptr->RefCount;
     if (Ptr->RefCount == 0)
     {
-        DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name ? Ptr->Face->family_name : "<NULL>");
-        RemoveCacheEntries(Ptr->Face);
-        FT_Done_Face(Ptr->Face);
-        SharedMem_Release(Ptr->Memory);
+        if (Ptr->Face)
+        {
+            DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name ? Ptr->Face->family_name : "<NULL>");
+            RemoveCacheEntries(Ptr->Face);
+            FT_Done_Face(Ptr->Face);
+            SharedMem_Release(Ptr->Memory);
+        }
         SharedFaceCache_Release(&Ptr->EnglishUS);
         SharedFaceCache_Release(&Ptr->UserLanguage);
         ExFreePoolWithTag(Ptr, TAG_FONT);
@@ -338,6 +405,125 @@ SharedFace_Release(PSHARED_FACE Ptr)
     IntUnLockFreeType();
 }
 
+/* Maps a font file into system space for FreeType */
+static PSHARED_MEM
+IntMapFontFile(PUNICODE_STRING PathName)
+{
+    NTSTATUS Status;
+    HANDLE FileHandle;
+    PVOID Buffer = NULL;
+    IO_STATUS_BLOCK Iosb;
+    PVOID SectionObject;
+    SIZE_T ViewSize = 0;
+    LARGE_INTEGER SectionSize;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    PFILE_OBJECT FileObject;
+    PSHARED_MEM Memory;
+
+    /* Open the font file */
+    InitializeObjectAttributes(&ObjectAttributes, PathName,
+                               OBJ_KERNEL_HANDLE | OBJ_CASE_INSENSITIVE, NULL, NULL);
+    Status = ZwOpenFile(
+                 &FileHandle,
+                 FILE_GENERIC_READ | SYNCHRONIZE,
+                 &ObjectAttributes,
+                 &Iosb,
+                 FILE_SHARE_READ,
+                 FILE_SYNCHRONOUS_IO_NONALERT);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Could not load font file: %wZ\n", PathName);
+        return NULL;
+    }
+
+    Status = ObReferenceObjectByHandle(FileHandle, FILE_READ_DATA, NULL,
+                                       KernelMode, (PVOID*)&FileObject, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("ObReferenceObjectByHandle failed.\n");
+        ZwClose(FileHandle);
+        return NULL;
+    }
+
+    SectionSize.QuadPart = 0LL;
+    Status = MmCreateSection(&SectionObject,
+                             STANDARD_RIGHTS_REQUIRED | SECTION_QUERY | SECTION_MAP_READ,
+                             NULL, &SectionSize, PAGE_READONLY,
+                             SEC_COMMIT, FileHandle, FileObject);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Could not map file: %wZ\n", PathName);
+        ZwClose(FileHandle);
+        ObDereferenceObject(FileObject);
+        return NULL;
+    }
+    ZwClose(FileHandle);
+
+    /* The view keeps the section and the file alive */
+    Status = MmMapViewInSystemSpace(SectionObject, &Buffer, &ViewSize);
+    ObDereferenceObject(SectionObject);
+    ObDereferenceObject(FileObject);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Could not map file: %wZ\n", PathName);
+        return NULL;
+    }
+
+    Memory = SharedMem_Create(Buffer, ViewSize, TRUE);
+    if (!Memory)
+        MmUnmapViewInSystemSpace(Buffer);
+
+    return Memory;
+}
+
+/* Opens the face of a font listed from the metadata cache */
+static BOOL
+SharedFace_Load(PSHARED_FACE Ptr, LPCWSTR FileName)
+{
+    UNICODE_STRING PathName;
+    PSHARED_MEM Memory;
+    FT_Face Face;
+    FT_Error Error;
+
+    ASSERT_FREETYPE_LOCK_NOT_HELD();
+
+    if (Ptr->Face)
+        return TRUE;
+
+    if (Ptr->LoadFailed || !FileName)
+        return FALSE;
+
+    RtlInitUnicodeString(&PathName, FileName);
+    Memory = IntMapFontFile(&PathName);
+
+    IntLockFreeType();
+    if (!Ptr->Face && Memory)
+    {
+        Error = FT_New_Memory_Face(g_FreeTypeLibrary, Memory->Buffer, Memory->BufferSize,
+                                   Ptr->FaceIndex, &Face);
+        if (!Error)
+        {
+            Ptr->Face = Face;
+            Ptr->Memory = Memory;
+            SharedMem_AddRef(Memory);
+        }
+        else
+        {
+            DPRINT1("Error reading font %wZ (error code: %d)\n", &PathName, Error);
+        }
+    }
+
+    /* Do not try again on every realization if the file went away */
+    if (!Ptr->Face)
+        Ptr->LoadFailed = TRUE;
+
+    if (Memory)
+        SharedMem_Release(Memory);
+    IntUnLockFreeType();
+
+    return !Ptr->LoadFailed;
+}
+
 
 static VOID FASTCALL
 CleanupFontEntryEx(PFONT_ENTRY FontEntry, PFONTGDI FontGDI)
@@ -496,11 +682,21 @@ VOID DumpGlobalFontList(BOOL bDoLock)
         IntUnLockGlobalFonts();
 }
 
+VOID DumpFontMatchCache(VOID)
+{
+    ULONG Lookups = g_FontMatchHits + g_FontMatchMisses;
+
+    DPRINT("## DumpFontMatchCache: %u entries, %lu hits, %lu misses (%lu%%)\n",
+           g_FontMatchNumEntries, g_FontMatchHits, g_FontMatchMisses,
+           Lookups ? (g_FontMatchHits * 100) / Lookups : 0);
+}
+
 VOID DumpFontInfo(BOOL bDoLock)
 {
     DumpGlobalFontList(bDoLock);
     DumpPrivateFontList(bDoLock);
     DumpFontSubstList();
+    DumpFontMatchCache();
 }
 #endif
 
@@ -660,11 +856,15 @@ IntLoadFontSubstList(PLIST_ENTRY pHead)
 BOOL FASTCALL
 InitFontSupport(VOID)
 {
-    ULONG ulError;
+    ULONG ulError, i;
 
     InitializeListHead(&g_FontListHead);
     InitializeListHead(&g_FontCacheListHead);
     g_FontCacheNumEntries = 0;
+    for (i = 0; i < FONT_MATCH_BUCKETS; ++i)
+        InitializeListHead(&g_FontMatchBuckets[i]);
+    InitializeListHead(&g_FontMatchLruHead);
+    g_FontMatchNumEntries = 0;
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -1316,6 +1516,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
         /* global font */
         IntLockGlobalFonts();
         InsertTailList(&g_FontListHead, &Entry->ListEntry);
+        IntFlushFontMatchCache();
         IntUnLockGlobalFonts();
     }
 
@@ -1416,6 +1617,359 @@ NameFromCharSet(BYTE CharSet)
     }
 }
 
+static NTSTATUS
+IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
+                        FT_UShort NameID, FT_UShort LangID);
+
+/*
+ * IntGdiLoadFontsFromMetadata
+ *
+ * Adds the fonts of a file as the metadata cache remembers them, without
+ * opening the file. The faces are opened by SharedFace_Load once a font is
+ * realized or enumerated. Returns 0 if the file has to be loaded instead.
+ */
+static INT FASTCALL
+IntGdiLoadFontsFromMetadata(PGDI_LOAD_FONT pLoadFont,
+                            PFILE_NETWORK_OPEN_INFORMATION FileInfo)
+{
+    NTSTATUS Status;
+    HANDLE KeyHandle;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    PKEY_VALUE_PARTIAL_INFORMATION pInfo = NULL;
+    ULONG Length, Offset, i;
+    FONT_METADATA Header;
+    FONT_METADATA_FACE Record;
+    UNICODE_STRING Names[4];
+    LIST_ENTRY LocalList;
+    PLIST_ENTRY ListEntry;
+    PFONT_ENTRY Entry;
+    PFONTGDI FontGDI;
+    PSHARED_FACE SharedFace;
+    PSHARED_FACE_CACHE Cache;
+    PUNICODE_STRING pFileName = pLoadFont->pFileName;
+    PBYTE pData;
+    INT FaceCount = 0;
+
+    InitializeObjectAttributes(&ObjectAttributes, &g_FontMetadataRegPath,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL, NULL);
+    Status = ZwOpenKey(&KeyHandle, KEY_QUERY_VALUE, &ObjectAttributes);
+    if (!NT_SUCCESS(Status))
+        return 0;
+
+    Status = ZwQueryValueKey(KeyHandle, pFileName, KeyValuePartialInformation,
+                             NULL, 0, &Length);
+    if (Status == STATUS_BUFFER_OVERFLOW || Status == STATUS_BUFFER_TOO_SMALL)
+    {
+        pInfo = ExAllocatePoolWithTag(PagedPool, Length, TAG_FONT);
+        if (pInfo)
+        {
+            Status = ZwQueryValueKey(KeyHandle, pFileName, KeyValuePartialInformation,
+                                     pInfo, Length, &Length);
+        }
+    }
+    ZwClose(KeyHandle);
+
+    if (!pInfo)
+        return 0;
+
+    if (!NT_SUCCESS(Status) || pInfo->Type != REG_BINARY ||
+        pInfo->DataLength < sizeof(Header))
+    {
+        ExFreePoolWithTag(pInfo, TAG_FONT);
+        return 0;
+    }
+
+    /* The cache is only valid for the same file and the same user language */
+    pData = pInfo->Data;
+    RtlCopyMemory(&Header, pData, sizeof(Header));
+    Offset = sizeof(Header) + ALIGN_UP_BY(Header.RegValueNameLength, sizeof(ULONG));
+    if (Header.Version != FONT_METADATA_VERSION ||
+        Header.LanguageID != gusLanguageID ||
+        Header.LastWriteTime.QuadPart != FileInfo->LastWriteTime.QuadPart ||
+        Header.FileSize.QuadPart != FileInfo->EndOfFile.QuadPart ||
+        Header.FaceCount == 0 || Header.EntryCount == 0 ||
+        (Header.RegValueNameLength & 1) || Offset > pInfo->DataLength)
+    {
+        DPRINT("Font metadata of %wZ is out of date\n", pFileName);
+        ExFreePoolWithTag(pInfo, TAG_FONT);
+        return 0;
+    }
+
+    InitializeListHead(&LocalList);
+    for (i = 0; i < Header.EntryCount; ++i)
+    {
+        if (pInfo->DataLength - Offset < sizeof(Record))
+            break;
+
+        RtlCopyMemory(&Record, pData + Offset, sizeof(Record));
+        Length = (ULONG)Record.FaceNameLength + Record.StyleNameLength +
+                 Record.FamilyNameLength + Record.FullNameLength;
+        if (Record.Size < sizeof(Record) + Length || (Record.Size & (sizeof(ULONG) - 1)) ||
+            Record.Size > pInfo->DataLength - Offset ||
+            ((Record.FaceNameLength | Record.StyleNameLength |
+              Record.FamilyNameLength | Record.FullNameLength) & 1))
+        {
+            break;
+        }
+
+        Names[0].Buffer = (PWCH)(pData + Offset + sizeof(Record));
+        Names[0].Length = Record.FaceNameLength;
+        Names[1].Buffer = Names[0].Buffer + Names[0].Length / sizeof(WCHAR);
+        Names[1].Length = Record.StyleNameLength;
+        Names[2].Buffer = Names[1].Buffer + Names[1].Length / sizeof(WCHAR);
+        Names[2].Length = Record.FamilyNameLength;
+        Names[3].Buffer = Names[2].Buffer + Names[2].Length / sizeof(WCHAR);
+        Names[3].Length = Record.FullNameLength;
+        Names[0].MaximumLength = Names[0].Length + sizeof(UNICODE_NULL);
+        Names[1].MaximumLength = Names[1].Length + sizeof(UNICODE_NULL);
+        Names[2].MaximumLength = Names[2].Length + sizeof(UNICODE_NULL);
+        Names[3].MaximumLength = Names[3].Length + sizeof(UNICODE_NULL);
+        Offset += Record.Size;
+
+        /* The charset variants of a face share it, as they do when loaded */
+        SharedFace = NULL;
+        for (ListEntry = LocalList.Flink; ListEntry != &LocalList; ListEntry = ListEntry->Flink)
+        {
+            Entry = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+            if (Entry->Font->SharedFace->FaceIndex == Record.FaceIndex)
+            {
+                SharedFace = Entry->Font->SharedFace;
+                IntLockFreeType();
+                SharedFace_AddRef(SharedFace);
+                IntUnLockFreeType();
+                break;
+            }
+        }
+
+        if (!SharedFace)
+        {
+            SharedFace = SharedFace_CreateDeferred(Record.FaceIndex);
+            if (!SharedFace)
+                break;
+
+            Cache = SharedFace_GetUserCache(SharedFace);
+            if (!NT_SUCCESS(DuplicateUnicodeString(&Names[2], &Cache->FontFamily)) ||
+                !NT_SUCCESS(DuplicateUnicodeString(&Names[3], &Cache->FullName)))
+            {
+                SharedFace_Release(SharedFace);
+                break;
+            }
+        }
+
+        Entry = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_ENTRY), TAG_FONT);
+        if (!Entry)
+        {
+            SharedFace_Release(SharedFace);
+            break;
+        }
+
+        FontGDI = EngAllocMem(FL_ZERO_MEMORY, sizeof(FONTGDI), GDITAG_RFONT);
+        if (!FontGDI)
+        {
+            SharedFace_Release(SharedFace);
+            ExFreePoolWithTag(Entry, TAG_FONT);
+            break;
+        }
+
+        RtlInitUnicodeString(&Entry->FaceName, NULL);
+        RtlInitUnicodeString(&Entry->StyleName, NULL);
+        Entry->Font = FontGDI;
+        Entry->NotEnum = (pLoadFont->Characteristics & FR_NOT_ENUM);
+        FontGDI->SharedFace = SharedFace;
+        FontGDI->CharSet = Record.CharSet;
+        FontGDI->OriginalItalic = Record.OriginalItalic;
+        FontGDI->RequestItalic = FALSE;
+        FontGDI->OriginalWeight = Record.OriginalWeight;
+        FontGDI->RequestWeight = FW_NORMAL;
+        InsertTailList(&LocalList, &Entry->ListEntry);
+
+        FontGDI->Filename = ExAllocatePoolWithTag(PagedPool,
+                                                  pFileName->Length + sizeof(UNICODE_NULL),
+                                                  GDITAG_PFF);
+        if (FontGDI->Filename == NULL)
+            break;
+
+        RtlCopyMemory(FontGDI->Filename, pFileName->Buffer, pFileName->Length);
+        FontGDI->Filename[pFileName->Length / sizeof(WCHAR)] = UNICODE_NULL;
+
+        if (!NT_SUCCESS(DuplicateUnicodeString(&Names[0], &Entry->FaceName)))
+            break;
+        if (Names[1].Length && !NT_SUCCESS(DuplicateUnicodeString(&Names[1], &Entry->StyleName)))
+            break;
+    }
+
+    /* All or nothing, so that a bad record falls back to loading the file */
+    if (i == Header.EntryCount)
+    {
+        Names[0].Buffer = (PWCH)(pData + sizeof(Header));
+        Names[0].Length = Header.RegValueNameLength;
+        Names[0].MaximumLength = Names[0].Length + sizeof(UNICODE_NULL);
+        if (NT_SUCCESS(DuplicateUnicodeString(&Names[0], &pLoadFont->RegValueName)))
+        {
+            pLoadFont->IsTrueType = Header.IsTrueType;
+            FaceCount = Header.FaceCount;
+
+            IntLockGlobalFonts();
+            while (!IsListEmpty(&LocalList))
+            {
+                ListEntry = RemoveHeadList(&LocalList);
+                InsertTailList(&g_FontListHead, ListEntry);
+            }
+            IntFlushFontMatchCache();
+            IntUnLockGlobalFonts();
+        }
+    }
+
+    while (!IsListEmpty(&LocalList))
+    {
+        ListEntry = RemoveHeadList(&LocalList);
+        Entry = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+        CleanupFontEntry(Entry);
+    }
+
+    ExFreePoolWithTag(pInfo, TAG_FONT);
+    return FaceCount;
+}
+
+/*
+ * IntStoreFontMetadata
+ *
+ * Remembers the fonts just loaded from a file in the metadata cache, so that
+ * the next boot can list them with IntGdiLoadFontsFromMetadata.
+ */
+static VOID FASTCALL
+IntStoreFontMetadata(PGDI_LOAD_FONT pLoadFont, INT FaceCount,
+                     PFILE_NETWORK_OPEN_INFORMATION FileInfo)
+{
+    NTSTATUS Status;
+    HANDLE KeyHandle;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    PLIST_ENTRY ListEntry;
+    PFONT_ENTRY Entry;
+    PSHARED_FACE_CACHE Cache;
+    UNICODE_STRING Name;
+    PFONT_METADATA pHeader;
+    PFONT_METADATA_FACE pRecord;
+    ULONG DataSize, EntryCount, RecordSize;
+    PBYTE pData, pName;
+
+    IntLockGlobalFonts();
+
+    /* Fill the name caches and size the value */
+    DataSize = sizeof(FONT_METADATA) + ALIGN_UP_BY(pLoadFont->RegValueName.Length, sizeof(ULONG));
+    EntryCount = 0;
+    for (ListEntry = g_FontListHead.Flink; ListEntry != &g_FontListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Entry = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+        if (Entry->Font->SharedFace->Memory != pLoadFont->Memory)
+            continue;
+
+        RtlInitUnicodeString(&Name, NULL);
+        IntGetFontLocalizedName(&Name, Entry->Font->SharedFace, TT_NAME_ID_FONT_FAMILY, gusLanguageID);
+        RtlFreeUnicodeString(&Name);
+        IntGetFontLocalizedName(&Name, Entry->Font->SharedFace, TT_NAME_ID_FULL_NAME, gusLanguageID);
+        RtlFreeUnicodeString(&Name);
+
+        Cache = SharedFace_GetUserCache(Entry->Font->SharedFace);
+        if (!Cache->FontFamily.Buffer || !Cache->FullName.Buffer)
+        {
+            IntUnLockGlobalFonts();
+            return;
+        }
+
+        RecordSize = sizeof(FONT_METADATA_FACE) + Entry->FaceName.Length +
+                     Entry->StyleName.Length + Cache->FontFamily.Length +
+                     Cache->FullName.Length;
+        RecordSize = ALIGN_UP_BY(RecordSize, sizeof(ULONG));
+        if (RecordSize > MAXUSHORT)
+        {
+            IntUnLockGlobalFonts();
+            return;
+        }
+
+        DataSize += RecordSize;
+        ++EntryCount;
+    }
+
+    if (EntryCount == 0)
+    {
+        IntUnLockGlobalFonts();
+        return;
+    }
+
+    pData = ExAllocatePoolWithTag(PagedPool, DataSize, TAG_FONT);
+    if (!pData)
+    {
+        IntUnLockGlobalFonts();
+        return;
+    }
+    RtlZeroMemory(pData, DataSize);
+
+    pHeader = (PFONT_METADATA)pData;
+    pHeader->Version = FONT_METADATA_VERSION;
+    pHeader->LanguageID = gusLanguageID;
+    pHeader->IsTrueType = !!pLoadFont->IsTrueType;
+    pHeader->LastWriteTime = FileInfo->LastWriteTime;
+    pHeader->FileSize = FileInfo->EndOfFile;
+    pHeader->FaceCount = FaceCount;
+    pHeader->EntryCount = EntryCount;
+    pHeader->RegValueNameLength = pLoadFont->RegValueName.Length;
+    RtlCopyMemory(pHeader + 1, pLoadFont->RegValueName.Buffer, pLoadFont->RegValueName.Length);
+
+    pRecord = (PFONT_METADATA_FACE)(pData + sizeof(FONT_METADATA) +
+                                    ALIGN_UP_BY(pLoadFont->RegValueName.Length, sizeof(ULONG)));
+    for (ListEntry = g_FontListHead.Flink; ListEntry != &g_FontListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Entry = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+        if (Entry->Font->SharedFace->Memory != pLoadFont->Memory)
+            continue;
+
+        Cache = SharedFace_GetUserCache(Entry->Font->SharedFace);
+        pRecord->CharSet = Entry->Font->CharSet;
+        pRecord->OriginalItalic = (BYTE)Entry->Font->OriginalItalic;
+        pRecord->FaceIndex = Entry->Font->SharedFace->FaceIndex;
+        pRecord->OriginalWeight = Entry->Font->OriginalWeight;
+        pRecord->FaceNameLength = Entry->FaceName.Length;
+        pRecord->StyleNameLength = Entry->StyleName.Length;
+        pRecord->FamilyNameLength = Cache->FontFamily.Length;
+        pRecord->FullNameLength = Cache->FullName.Length;
+
+        pName = (PBYTE)(pRecord + 1);
+        RtlCopyMemory(pName, Entry->FaceName.Buffer, Entry->FaceName.Length);
+        pName += Entry->FaceName.Length;
+        RtlCopyMemory(pName, Entry->StyleName.Buffer, Entry->StyleName.Length);
+        pName += Entry->StyleName.Length;
+        RtlCopyMemory(pName, Cache->FontFamily.Buffer, Cache->FontFamily.Length);
+        pName += Cache->FontFamily.Length;
+        RtlCopyMemory(pName, Cache->FullName.Buffer, Cache->FullName.Length);
+        pName += Cache->FullName.Length;
+
+        pRecord->Size = (USHORT)ALIGN_UP_BY(pName - (PBYTE)pRecord, sizeof(ULONG));
+        pRecord = (PFONT_METADATA_FACE)((PBYTE)pRecord + pRecord->Size);
+    }
+
+    IntUnLockGlobalFonts();
+
+    InitializeObjectAttributes(&ObjectAttributes, &g_FontMetadataRegPath,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL, NULL);
+    Status = ZwCreateKey(&KeyHandle, KEY_SET_VALUE, &ObjectAttributes, 0, NULL,
+                         REG_OPTION_NON_VOLATILE, NULL);
+    if (NT_SUCCESS(Status))
+    {
+        Status = ZwSetValueKey(KeyHandle, pLoadFont->pFileName, 0, REG_BINARY,
+                               pData, DataSize);
+        ZwClose(KeyHandle);
+    }
+    if (!NT_SUCCESS(Status))
+        DPRINT1("Could not store the font metadata of %wZ: 0x%08X\n", pLoadFont->pFileName, Status);
+
+    ExFreePoolWithTag(pData, TAG_FONT);
+}
+
 /*
  * IntGdiAddFontResource
  *
@@ -1427,19 +1981,15 @@ IntGdiAddFontResourceEx(PUNICODE_STRING FileName, DWORD Characteristics,
                         DWORD dwFlags)
 {
     NTSTATUS Status;
-    HANDLE FileHandle;
-    PVOID Buffer = NULL;
-    IO_STATUS_BLOCK Iosb;
-    PVOID SectionObject;
-    SIZE_T ViewSize = 0, Length;
-    LARGE_INTEGER SectionSize;
+    SIZE_T Length;
     OBJECT_ATTRIBUTES ObjectAttributes;
+    FILE_NETWORK_OPEN_INFORMATION FileInfo;
     GDI_LOAD_FONT LoadFont;
     INT FontCount;
     HANDLE KeyHandle;
     UNICODE_STRING PathName;
     LPWSTR pszBuffer;
-    PFILE_OBJECT FileObject;
+    BOOL bCacheable;
     static const UNICODE_STRING TrueTypePostfix = RTL_CONSTANT_STRING(L" (TrueType)");
     static const UNICODE_STRING DosPathPrefix = RTL_CONSTANT_STRING(L"\\??\\");
 
@@ -1462,75 +2012,41 @@ IntGdiAddFontResourceEx(PUNICODE_STRING FileName, DWORD Characteristics,
             return 0;   /* failure */
     }
 
-    /* Open the font file */
-    InitializeObjectAttributes(&ObjectAttributes, &PathName,
-                               OBJ_KERNEL_HANDLE | OBJ_CASE_INSENSITIVE, NULL, NULL);
-    Status = ZwOpenFile(
-                 &FileHandle,
-                 FILE_GENERIC_READ | SYNCHRONIZE,
-                 &ObjectAttributes,
-                 &Iosb,
-                 FILE_SHARE_READ,
-                 FILE_SYNCHRONOUS_IO_NONALERT);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT1("Could not load font file: %wZ\n", &PathName);
-        RtlFreeUnicodeString(&PathName);
-        return 0;
-    }
-
-    Status = ObReferenceObjectByHandle(FileHandle, FILE_READ_DATA, NULL,
-                                       KernelMode, (PVOID*)&FileObject, NULL);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT1("ObReferenceObjectByHandle failed.\n");
-        ZwClose(FileHandle);
-        RtlFreeUnicodeString(&PathName);
-        return 0;
-    }
-
-    SectionSize.QuadPart = 0LL;
-    Status = MmCreateSection(&SectionObject,
-                             STANDARD_RIGHTS_REQUIRED | SECTION_QUERY | SECTION_MAP_READ,
-                             NULL, &SectionSize, PAGE_READONLY,
-                             SEC_COMMIT, FileHandle, FileObject);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT1("Could not map file: %wZ\n", &PathName);
-        ZwClose(FileHandle);
-        ObDereferenceObject(FileObject);
-        RtlFreeUnicodeString(&PathName);
-        return 0;
-    }
-    ZwClose(FileHandle);
-
-    Status = MmMapViewInSystemSpace(SectionObject, &Buffer, &ViewSize);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT1("Could not map file: %wZ\n", &PathName);
-        ObDereferenceObject(SectionObject);
-        ObDereferenceObject(FileObject);
-        RtlFreeUnicodeString(&PathName);
-        return 0;
-    }
-
     LoadFont.pFileName          = &PathName;
-    LoadFont.Memory             = SharedMem_Create(Buffer, ViewSize, TRUE);
+    LoadFont.Memory             = NULL;
     LoadFont.Characteristics    = Characteristics;
     RtlInitUnicodeString(&LoadFont.RegValueName, NULL);
     LoadFont.IsTrueType         = FALSE;
     LoadFont.CharSet            = DEFAULT_CHARSET;
     LoadFont.PrivateEntry       = NULL;
-    FontCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1);
 
-    /* Release our copy */
-    IntLockFreeType();
-    SharedMem_Release(LoadFont.Memory);
-    IntUnLockFreeType();
+    /* Shared fonts seen before are listed from the metadata cache */
+    FontCount = 0;
+    InitializeObjectAttributes(&ObjectAttributes, &PathName,
+                               OBJ_KERNEL_HANDLE | OBJ_CASE_INSENSITIVE, NULL, NULL);
+    bCacheable = !(Characteristics & FR_PRIVATE) &&
+                 NT_SUCCESS(ZwQueryFullAttributesFile(&ObjectAttributes, &FileInfo));
+    if (bCacheable)
+        FontCount = IntGdiLoadFontsFromMetadata(&LoadFont, &FileInfo);
 
-    ObDereferenceObject(SectionObject);
+    if (FontCount == 0)
+    {
+        LoadFont.Memory = IntMapFontFile(&PathName);
+        if (!LoadFont.Memory)
+        {
+            RtlFreeUnicodeString(&PathName);
+            return 0;
+        }
 
-    ObDereferenceObject(FileObject);
+        FontCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1);
+        if (FontCount > 0 && bCacheable)
+            IntStoreFontMetadata(&LoadFont, FontCount, &FileInfo);
+
+        /* Release our copy */
+        IntLockFreeType();
+        SharedMem_Release(LoadFont.Memory);
+        IntUnLockFreeType();
+    }
 
     /* Save the loaded font name into the registry */
     if (FontCount > 0 && (dwFlags & AFRX_WRITE_REGISTRY))
@@ -2314,10 +2830,6 @@ FillTM(TEXTMETRICW *TM, PFONTGDI FontGDI,
     TM->tmCharSet = FontGDI->CharSet;
 }
 
-static NTSTATUS
-IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
-                        FT_UShort NameID, FT_UShort LangID);
-
 typedef struct FONT_NAMES
 {
     UNICODE_STRING FamilyNameW;     /* family name (TT_NAME_ID_FONT_FAMILY) */
@@ -2639,6 +3151,10 @@ IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
         return DuplicateUnicodeString(&Cache->FullName, pNameW);
     }
 
+    /* only the cached names of a face that is not open yet are known */
+    if (!Face)
+        return STATUS_NOT_FOUND;
+
     BestIndex = -1;
     BestScore = 0;
 
@@ -2782,11 +3298,17 @@ FontFamilyFillInfo(PFONTFAMILYINFO Info, LPCWSTR FaceName,
     DWORD fs0;
     NTSTATUS status;
     PSHARED_FACE SharedFace = FontGDI->SharedFace;
-    FT_Face Face = SharedFace->Face;
+    FT_Face Face;
     UNICODE_STRING NameW;
 
     RtlInitUnicodeString(&NameW, NULL);
     RtlZeroMemory(Info, sizeof(FONTFAMILYINFO));
+    if (!SharedFace_Load(SharedFace, FontGDI->Filename))
+    {
+        return;
+    }
+    Face = SharedFace->Face;
+
     Size = IntGetOutlineTextMetrics(FontGDI, 0, NULL);
     Otm = ExAllocatePoolWithTag(PagedPool, Size, GDITAG_TEXT);
     if (!Otm)
@@ -5040,72 +5562,310 @@ GetFontPenalty(const LOGFONTW *               LogFont,
     return Penalty;     /* success */
 }
 
+/* Compares a face name the way GetFontPenalty does with the names in the OTM */
+static BOOL
+IntMatchCachedFaceName(const LOGFONTW *LogFont, PUNICODE_STRING Name)
+{
+    SIZE_T Length;
+
+    /* not known yet, so it may still match */
+    if (!Name->Buffer)
+        return TRUE;
+
+    for (Length = 0; Length < Name->Length / sizeof(WCHAR); ++Length)
+    {
+        if (Name->Buffer[Length] == UNICODE_NULL)
+            break;
+    }
+
+    return wcslen(LogFont->lfFaceName) == Length &&
+           _wcsnicmp(LogFont->lfFaceName, Name->Buffer, Length) == 0;
+}
+
+/*
+ * The part of GetFontPenalty that is known without opening the face. The
+ * real penalty is never lower, so the fonts whose bound is above the best
+ * penalty found so far need not be scored.
+ */
+static UINT
+GetFontPenaltyBound(const LOGFONTW *LogFont, PFONTGDI FontGDI)
+{
+    ULONG   Penalty = 0;
+    BYTE    Byte;
+    const BYTE UserCharSet = CharSetFromLangID(gusLanguageID);
+    PSHARED_FACE_CACHE Cache = SharedFace_GetUserCache(FontGDI->SharedFace);
+
+    /* The same as GetFontPenalty, tmCharSet is FontGDI->CharSet */
+    Byte = LogFont->lfCharSet;
+
+    if (Byte != FontGDI->CharSet)
+    {
+        if (Byte != DEFAULT_CHARSET && Byte != ANSI_CHARSET)
+        {
+            GOT_PENALTY("CharSet", 65000);
+        }
+        else
+        {
+            if (UserCharSet != FontGDI->CharSet)
+            {
+                GOT_PENALTY("UNDOCUMENTED:NotUserLanguage", 100);
+
+                if (ANSI_CHARSET != FontGDI->CharSet)
+                {
+                    GOT_PENALTY("UNDOCUMENTED:NotAnsiCharSet", 100);
+                }
+            }
+        }
+    }
+
+    /* The OTM family and face names are the cached localized names */
+    if (LogFont->lfFaceName[0] != UNICODE_NULL &&
+        !IntMatchCachedFaceName(LogFont, &Cache->FontFamily) &&
+        !IntMatchCachedFaceName(LogFont, &Cache->FullName))
+    {
+        GOT_PENALTY("FaceName", 10000);
+    }
+
+    return Penalty;
+}
+
 #undef GOT_PENALTY
 
+typedef struct _FONT_CANDIDATE
+{
+    ULONG       Bound;
+    ULONG       Index;      /* in the font list */
+    PFONTGDI    FontGDI;
+} FONT_CANDIDATE, *PFONT_CANDIDATE;
+
+static int __cdecl
+CompareFontCandidates(const void *pv1, const void *pv2)
+{
+    const FONT_CANDIDATE *Candidate1 = pv1, *Candidate2 = pv2;
+
+    if (Candidate1->Bound != Candidate2->Bound)
+        return (Candidate1->Bound < Candidate2->Bound) ? -1 : 1;
+    if (Candidate1->Index != Candidate2->Index)
+        return (Candidate1->Index < Candidate2->Index) ? -1 : 1;
+    return 0;
+}
+
+static BOOL
+IntGetFontMatchPenalty(PFONTGDI FontGDI, const LOGFONTW *LogFont,
+                       OUTLINETEXTMETRICW **pOtm, UINT *pOtmCapacity,
+                       ULONG *pPenalty)
+{
+    UINT OtmSize;
+
+    /* get text metrics */
+    OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL);
+    if (OtmSize > *pOtmCapacity || !*pOtm)
+    {
+        if (*pOtm)
+            ExFreePoolWithTag(*pOtm, GDITAG_TEXT);
+        *pOtm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+        *pOtmCapacity = (*pOtm ? OtmSize : 0);
+        if (!*pOtm)
+            return FALSE;
+    }
+
+    IntLockFreeType();
+    IntRequestFontSize(NULL, FontGDI, LogFont->lfWidth, LogFont->lfHeight);
+    IntUnLockFreeType();
+
+    OtmSize = IntGetOutlineTextMetrics(FontGDI, *pOtmCapacity, *pOtm);
+    if (!OtmSize)
+        return FALSE;
+
+    *pPenalty = GetFontPenalty(LogFont, *pOtm, FontGDI->SharedFace->Face->style_name);
+    return TRUE;
+}
+
+/*
+ * Finds the font of lowest penalty, the first one in the list on ties. The
+ * fonts are scored in the order of their penalty bound, so the faces that
+ * cannot win are neither opened nor measured.
+ */
 static __inline VOID
 FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
                      const LOGFONTW *LogFont,
                      const PLIST_ENTRY Head)
 {
-    ULONG Penalty;
+    ULONG Penalty, Count, i;
+    LONG BestIndex = -1;
     PLIST_ENTRY Entry;
     PFONT_ENTRY CurrentEntry;
-    FONTGDI *FontGDI;
+    PFONT_CANDIDATE Candidates, Candidate;
     OUTLINETEXTMETRICW *Otm = NULL;
-    UINT OtmSize, OldOtmSize = 0;
-    FT_Face Face;
+    UINT OtmCapacity;
 
     ASSERT(FontObj);
     ASSERT(MatchPenalty);
     ASSERT(LogFont);
     ASSERT(Head);
 
-    /* Start with a pretty big buffer */
-    OldOtmSize = 0x200;
-    Otm = ExAllocatePoolWithTag(PagedPool, OldOtmSize, GDITAG_TEXT);
+    Count = 0;
+    for (Entry = Head->Flink; Entry != Head; Entry = Entry->Flink)
+        ++Count;
 
-    /* get the FontObj of lowest penalty */
+    if (Count == 0)
+        return;
+
+    Candidates = ExAllocatePoolWithTag(PagedPool, Count * sizeof(FONT_CANDIDATE), GDITAG_TEXT);
+    if (!Candidates)
+        return;
+
+    i = 0;
     for (Entry = Head->Flink; Entry != Head; Entry = Entry->Flink)
     {
         CurrentEntry = CONTAINING_RECORD(Entry, FONT_ENTRY, ListEntry);
+        ASSERT(CurrentEntry->Font);
 
-        FontGDI = CurrentEntry->Font;
-        ASSERT(FontGDI);
-        Face = FontGDI->SharedFace->Face;
+        Candidates[i].FontGDI = CurrentEntry->Font;
+        Candidates[i].Index = i;
+        Candidates[i].Bound = GetFontPenaltyBound(LogFont, CurrentEntry->Font);
+        ++i;
+    }
+    qsort(Candidates, Count, sizeof(FONT_CANDIDATE), CompareFontCandidates);
 
-        /* get text metrics */
-        OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL);
-        if (OtmSize > OldOtmSize)
+    /* Start with a pretty big buffer */
+    OtmCapacity = 0x200;
+    Otm = ExAllocatePoolWithTag(PagedPool, OtmCapacity, GDITAG_TEXT);
+
+    /* get the FontObj of lowest penalty */
+    for (i = 0; i < Count; ++i)
+    {
+        Candidate = &Candidates[i];
+
+        /* An earlier font with the same penalty still wins a tie */
+        if (*MatchPenalty != 0xFFFFFFFF &&
+            !(Candidate->Bound < *MatchPenalty ||
+              (Candidate->Bound == *MatchPenalty && (LONG)Candidate->Index < BestIndex)))
         {
-            if (Otm)
-                ExFreePoolWithTag(Otm, GDITAG_TEXT);
-            Otm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+            break;
         }
 
+        if (!SharedFace_Load(Candidate->FontGDI->SharedFace, Candidate->FontGDI->Filename))
+            continue;
+
+        if (!IntGetFontMatchPenalty(Candidate->FontGDI, LogFont, &Otm, &OtmCapacity, &Penalty))
+            continue;
+
         /* update FontObj if lowest penalty */
-        if (Otm)
+        if (*MatchPenalty == 0xFFFFFFFF || Penalty < *MatchPenalty ||
+            (Penalty == *MatchPenalty && (LONG)Candidate->Index < BestIndex))
         {
-            IntLockFreeType();
-            IntRequestFontSize(NULL, FontGDI, LogFont->lfWidth, LogFont->lfHeight);
-            IntUnLockFreeType();
+            *FontObj = GDIToObj(Candidate->FontGDI, FONT);
+            *MatchPenalty = Penalty;
+            BestIndex = Candidate->Index;
+        }
+    }
 
-            OtmSize = IntGetOutlineTextMetrics(FontGDI, OtmSize, Otm);
-            if (!OtmSize)
-                continue;
+    if (Otm)
+        ExFreePoolWithTag(Otm, GDITAG_TEXT);
+    ExFreePoolWithTag(Candidates, GDITAG_TEXT);
+}
+
+static VOID
+IntGetFontMatchKey(PFONT_MATCH_HASHED Hashed, const LOGFONTW *LogFont)
+{
+    UINT i;
 
-            OldOtmSize = OtmSize;
+    RtlZeroMemory(Hashed, sizeof(*Hashed));
+    Hashed->lfHeight = LogFont->lfHeight;
+    Hashed->lfWidth = LogFont->lfWidth;
+    Hashed->lfWeight = (LogFont->lfWeight == FW_DONTCARE) ? FW_NORMAL : LogFont->lfWeight;
+    Hashed->lfItalic = !!LogFont->lfItalic;
+    Hashed->lfUnderline = !!LogFont->lfUnderline;
+    Hashed->lfStrikeOut = !!LogFont->lfStrikeOut;
+    Hashed->lfCharSet = LogFont->lfCharSet;
+    Hashed->lfOutPrecision = LogFont->lfOutPrecision;
+    Hashed->lfPitchAndFamily = LogFont->lfPitchAndFamily;
+
+    /* The face names are compared with _wcsicmp */
+    for (i = 0; i < LF_FACESIZE && LogFont->lfFaceName[i]; ++i)
+        Hashed->lfFaceName[i] = towlower(LogFont->lfFaceName[i]);
+}
+
+/*
+ * Same as FindBestFontFromList on the global font list, remembering the
+ * result. The global font of lowest penalty wins over the font found so
+ * far exactly when FindBestFontFromList would pick it, so one answer per
+ * LOGFONTW serves every process. The cache is flushed when fonts are added.
+ */
+static VOID
+IntFindBestGlobalFont(FONTOBJ **FontObj, ULONG *MatchPenalty,
+                      const LOGFONTW *LogFont)
+{
+    FONT_MATCH_HASHED Hashed;
+    DWORD dwHash;
+    PLIST_ENTRY Bucket, CurrentEntry;
+    PFONT_MATCH_ENTRY MatchEntry = NULL;
+    FONTOBJ *BestFontObj = NULL;
+    ULONG BestPenalty = 0xFFFFFFFF;
+
+    ASSERT_GLOBALFONTS_LOCK_HELD();
+
+    IntGetFontMatchKey(&Hashed, LogFont);
+    dwHash = IntGetHash(&Hashed, sizeof(Hashed) / sizeof(DWORD));
+    Bucket = &g_FontMatchBuckets[dwHash % FONT_MATCH_BUCKETS];
+
+    for (CurrentEntry = Bucket->Flink; CurrentEntry != Bucket;
+         CurrentEntry = CurrentEntry->Flink)
+    {
+        MatchEntry = CONTAINING_RECORD(CurrentEntry, FONT_MATCH_ENTRY, HashEntry);
+        if (MatchEntry->dwHash == dwHash &&
+            RtlEqualMemory(&MatchEntry->Hashed, &Hashed, sizeof(Hashed)))
+        {
+            break;
+        }
+    }
 
-            Penalty = GetFontPenalty(LogFont, Otm, Face->style_name);
-            if (*MatchPenalty == 0xFFFFFFFF || Penalty < *MatchPenalty)
+    if (CurrentEntry != Bucket)
+    {
+        ++g_FontMatchHits;
+        RemoveEntryList(&MatchEntry->LruEntry);
+        InsertHeadList(&g_FontMatchLruHead, &MatchEntry->LruEntry);
+        BestFontObj = MatchEntry->FontObj;
+        BestPenalty = MatchEntry->Penalty;
+    }
+    else
+    {
+        ++g_FontMatchMisses;
+        FindBestFontFromList(&BestFontObj, &BestPenalty, LogFont, &g_FontListHead);
+
+        MatchEntry = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_MATCH_ENTRY), TAG_FONT);
+        if (MatchEntry)
+        {
+            MatchEntry->FontObj = BestFontObj;
+            MatchEntry->Penalty = BestPenalty;
+            MatchEntry->dwHash = dwHash;
+            MatchEntry->Hashed = Hashed;
+            InsertHeadList(Bucket, &MatchEntry->HashEntry);
+            InsertHeadList(&g_FontMatchLruHead, &MatchEntry->LruEntry);
+
+            if (++g_FontMatchNumEntries > MAX_FONT_MATCH_CACHE)
             {
-                *FontObj = GDIToObj(FontGDI, FONT);
-                *MatchPenalty = Penalty;
+                MatchEntry = CONTAINING_RECORD(g_FontMatchLruHead.Blink, FONT_MATCH_ENTRY, LruEntry);
+                RemoveEntryList(&MatchEntry->LruEntry);
+                RemoveEntryList(&MatchEntry->HashEntry);
+                ExFreePoolWithTag(MatchEntry, TAG_FONT);
+                --g_FontMatchNumEntries;
             }
         }
+
+        if (((g_FontMatchHits + g_FontMatchMisses) & 0xFFF) == 0)
+        {
+            DPRINT("Font match cache: %lu hits, %lu misses\n",
+                   g_FontMatchHits, g_FontMatchMisses);
+        }
     }
 
-    if (Otm)
-        ExFreePoolWithTag(Otm, GDITAG_TEXT);
+    if (BestFontObj && (*MatchPenalty == 0xFFFFFFFF || BestPenalty < *MatchPenalty))
+    {
+        *FontObj = BestFontObj;
+        *MatchPenalty = BestPenalty;
+    }
 }
 
 static
@@ -5245,8 +6005,7 @@ TextIntRealizeFont(HFONT FontHandle, PTEXTOBJ pTextObj)
 
     /* Search system fonts */
     IntLockGlobalFonts();
-    FindBestFontFromList(&TextObj->Font, &MatchPenalty, &SubstitutedLogFont,
-                         &g_FontListHead);
+    IntFindBestGlobalFont(&TextObj->Font, &MatchPenalty, &SubstitutedLogFont);
     IntUnLockGlobalFonts();
 
     if (NULL == TextObj->Font)
@@ -717,6 +717,9 @@ typedef struct _WND
     /* Property list head.*/
     LIST_ENTRY PropListHead;
     ULONG PropListItems;
+    /* Property lookup table, once the list grows long. */
+    struct _PROPERTY **PropHashTable;
+    ULONG PropHashSize;
     /* Scrollbar info */
     PSBINFO pSBInfo;
     /* system menu handle. */
@@ -759,6 +762,11 @@ typedef struct _WND
     LIST_ENTRY ThreadListEntry;
 
     PVOID DialogPointer;
+
+    /* Visible region of the last GetDC, see VIS_GetCachedVisibleRegion */
+    struct _REGION *VisRgnCache;
+    ULONG VisRgnCacheGeneration;
+    UINT VisRgnCacheFlags;
 } WND, *PWND;
 
 #define PWND_BOTTOM ((PWND)1)
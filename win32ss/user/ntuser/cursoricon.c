@@ -1929,6 +1929,8 @@ UserDrawIconEx(
         ERR("NtGdiAlphaBlend failed!\n");
     }
 NoAlpha:
+    /* The mask and image passes must cover the same pixels, so always
+     * stretch them with COLORONCOLOR, whatever the DC stretch mode is */
     if (diFlags & DI_MASK)
     {
         DWORD rop4 = (diFlags & DI_IMAGE) ? ROP4_SRCAND : ROP4_SRCCOPY;
@@ -1946,7 +1948,8 @@ NoAlpha:
                                NULL,
                                NULL,
                                NULL,
-                               rop4);
+                               rop4,
+                               COLORONCOLOR);
 
         EXLATEOBJ_vCleanup(&exlo);
 
@@ -1976,7 +1979,8 @@ NoAlpha:
                                    NULL,
                                    NULL,
                                    NULL,
-                                   rop4);
+                                   rop4,
+                                   COLORONCOLOR);
 
             EXLATEOBJ_vCleanup(&exlo);
 
@@ -2005,7 +2009,8 @@ NoAlpha:
                                    NULL,
                                    NULL,
                                    NULL,
-                                   rop4);
+                                   rop4,
+                                   COLORONCOLOR);
 
             EXLATEOBJ_vCleanup(&exlo);
 
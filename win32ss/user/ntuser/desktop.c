@@ -1642,6 +1642,7 @@ IntHideDesktop(PDESKTOP Desktop)
         return ERROR_INVALID_WINDOW_HANDLE;
     }
     DesktopWnd->style &= ~WS_VISIBLE;
+    VIS_InvalidateVisibleRegions(DesktopWnd);
 
     return STATUS_SUCCESS;
 }
@@ -41,6 +41,9 @@ typedef struct _DESKTOP
     /* Thread blocking input */
     PVOID BlockInputThread;
     LIST_ENTRY ShellHookWindows;
+    /* Bumped whenever a window of the desktop moves, changes z-order,
+       visibility or shape, see VIS_InvalidateVisibleRegions */
+    ULONG VisRgnGeneration;
 } DESKTOP, *PDESKTOP;
 
 // Desktop flags
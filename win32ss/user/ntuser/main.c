@@ -501,6 +501,10 @@ InitThreadCallback(PETHREAD Thread)
     {
         InitializeListHead(&ptiCurrent->aphkStart[i]);
     }
+    for (i = 0; i < POSTED_MSG_SLOTS * POSTED_MSG_CLASSES; i++)
+    {
+        InitializeListHead(&ptiCurrent->PostedMessagesIndex[i]);
+    }
     ptiCurrent->ptiSibling = ptiCurrent->ppi->ptiList;
     ptiCurrent->ppi->ptiList = ptiCurrent;
     ptiCurrent->ppi->cThreads++;
@@ -1032,6 +1036,8 @@ DriverEntry(
     NT_ROF(InitGdiHandleTable());
     NT_ROF(InitPaletteImpl());
 
+    DIB_InitRowFunctions();
+
     /* Create stock objects, ie. precreated objects commonly
        used by win32 applications */
     CreateStockObjects();
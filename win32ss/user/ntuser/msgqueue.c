@@ -727,6 +727,50 @@ co_MsqInsertMouseMessage(MSG* Msg, DWORD flags, ULONG_PTR dwExtraInfo, BOOL Hook
    }
 }
 
+/*
+ * Besides pti->PostedMessagesListHead, which keeps every posted message in
+ * posting order, each posted message sits in one bucket of
+ * pti->PostedMessagesIndex picked from its window handle and the range its
+ * message number falls in. Filtered peeks and window teardown only walk the
+ * buckets that can hold a match; the sequence number restores the posting
+ * order between buckets.
+ */
+static const UINT PostedMessageClassFirst[POSTED_MSG_CLASSES] =
+{
+   0,             /* WM_NULL .. WM_KEYFIRST - 1 */
+   WM_KEYFIRST,   /* keyboard, commands, timers, menus and scrolling */
+   WM_MOUSEFIRST, /* mouse and the rest of the system range */
+   WM_USER        /* WM_USER, WM_APP and registered messages */
+};
+
+static inline ULONG
+MsqPostedMessageClass(UINT Message)
+{
+   ULONG Class = POSTED_MSG_CLASSES - 1;
+
+   while (Message < PostedMessageClassFirst[Class])
+      Class--;
+
+   return Class;
+}
+
+static inline ULONG
+MsqPostedMessageSlot(HWND hWnd)
+{
+   /* Thread messages get a slot of their own */
+   if (!hWnd)
+      return POSTED_MSG_WND_SLOTS;
+
+   /* Handles are even, spread windows by their handle table index */
+   return ((ULONG)(LOWORD(hWnd) - FIRST_USER_HANDLE) >> 1) % POSTED_MSG_WND_SLOTS;
+}
+
+static inline PLIST_ENTRY
+MsqPostedMessageBucket(PTHREADINFO pti, ULONG Slot, ULONG Class)
+{
+   return &pti->PostedMessagesIndex[Slot * POSTED_MSG_CLASSES + Class];
+}
+
 PUSER_MESSAGE FASTCALL
 MsqCreateMessage(LPMSG Msg)
 {
@@ -754,6 +798,10 @@ MsqDestroyMessage(PUSER_MESSAGE Message)
       return;
    }
    RemoveEntryList(&Message->ListEntry);
+   if (Message->IndexEntry.Flink)
+   {
+      RemoveEntryList(&Message->IndexEntry);
+   }
    Message->pti = NULL;
    ExFreeToPagedLookasideList(pgMessageLookasideList, Message);
    PostMsgCount--;
@@ -801,32 +849,33 @@ MsqRemoveWindowMessagesFromQueue(PWND Window)
    PUSER_SENT_MESSAGE SentMessage;
    PUSER_MESSAGE PostedMessage;
    PLIST_ENTRY CurrentEntry, ListHead;
+   ULONG Slot, Class;
 
    ASSERT(Window);
 
    pti = Window->head.pti;
 
-   /* remove the posted messages for this window */
-   CurrentEntry = pti->PostedMessagesListHead.Flink;
-   ListHead = &pti->PostedMessagesListHead;
-   while (CurrentEntry != ListHead)
+   /* remove the posted messages for this window, they all sit in its slot */
+   Slot = MsqPostedMessageSlot(Window->head.h);
+   for (Class = 0; Class < POSTED_MSG_CLASSES; Class++)
    {
-      PostedMessage = CONTAINING_RECORD(CurrentEntry, USER_MESSAGE, ListEntry);
-
-      if (PostedMessage->Msg.hwnd == Window->head.h)
+      ListHead = MsqPostedMessageBucket(pti, Slot, Class);
+      CurrentEntry = ListHead->Flink;
+      while (CurrentEntry != ListHead)
       {
-         if (PostedMessage->Msg.message == WM_QUIT && pti->QuitPosted == 0)
+         PostedMessage = CONTAINING_RECORD(CurrentEntry, USER_MESSAGE, IndexEntry);
+         CurrentEntry = CurrentEntry->Flink;
+
+         if (PostedMessage->Msg.hwnd == Window->head.h)
          {
-            pti->QuitPosted = 1;
-            pti->exitCode = PostedMessage->Msg.wParam;
+            if (PostedMessage->Msg.message == WM_QUIT && pti->QuitPosted == 0)
+            {
+               pti->QuitPosted = 1;
+               pti->exitCode = PostedMessage->Msg.wParam;
+            }
+            ClearMsgBitsMask(pti, PostedMessage->QS_Flags);
+            MsqDestroyMessage(PostedMessage);
          }
-         ClearMsgBitsMask(pti, PostedMessage->QS_Flags);
-         MsqDestroyMessage(PostedMessage);
-         CurrentEntry = pti->PostedMessagesListHead.Flink;
-      }
-      else
-      {
-         CurrentEntry = CurrentEntry->Flink;
       }
    }
 
@@ -1366,7 +1415,12 @@ MsqPostMessage(PTHREADINFO pti,
 
    if (!HardwareMessage)
    {
+       Message->Sequence = pti->PostedMessagesSequence++;
        InsertTailList(&pti->PostedMessagesListHead, &Message->ListEntry);
+       InsertTailList(MsqPostedMessageBucket(pti,
+                                             MsqPostedMessageSlot(Msg->hwnd),
+                                             MsqPostedMessageClass(Msg->message)),
+                      &Message->IndexEntry);
    }
    else
    {
@@ -2104,6 +2158,26 @@ co_MsqPeekHardwareMessage(IN PTHREADINFO pti,
    return Ret;
 }
 
+static inline BOOL
+MsqPostedMessageMatches(PUSER_MESSAGE CurrentMessage,
+                        PWND Window,
+                        UINT MsgFilterLow,
+                        UINT MsgFilterHigh,
+                        UINT QSflags)
+{
+/*
+ MSDN:
+ 1: any window that belongs to the current thread, and any messages on the current thread's message queue whose hwnd value is NULL.
+ 2: retrieves only messages on the current thread's message queue whose hwnd value is NULL.
+ 3: handle to the window whose messages are to be retrieved.
+ */
+   return ( ( !Window || // 1
+             ( Window == PWND_BOTTOM && CurrentMessage->Msg.hwnd == NULL ) || // 2
+             ( Window != PWND_BOTTOM && Window->head.h == CurrentMessage->Msg.hwnd ) ) && // 3
+             ( ( ( MsgFilterLow == 0 && MsgFilterHigh == 0 ) && CurrentMessage->QS_Flags & QSflags ) ||
+               ( MsgFilterLow <= CurrentMessage->Msg.message && MsgFilterHigh >= CurrentMessage->Msg.message ) ) );
+}
+
 BOOLEAN APIENTRY
 MsqPeekMessage(IN PTHREADINFO pti,
                   IN BOOLEAN Remove,
@@ -2115,50 +2189,95 @@ MsqPeekMessage(IN PTHREADINFO pti,
                   OUT DWORD *dwQEvent,
                   OUT PMSG Message)
 {
-   PUSER_MESSAGE CurrentMessage;
-   PLIST_ENTRY ListHead;
+   PUSER_MESSAGE CurrentMessage, FoundMessage = NULL;
+   PLIST_ENTRY ListHead, Entry;
+   ULONG Slot, FirstSlot, LastSlot, Class, FirstClass, LastClass;
    DWORD QS_Flags;
-   BOOL Ret = FALSE;
-
-   ListHead = pti->PostedMessagesListHead.Flink;
 
-   if (IsListEmpty(ListHead)) return FALSE;
+   if (IsListEmpty(&pti->PostedMessagesListHead)) return FALSE;
 
-   while(ListHead != &pti->PostedMessagesListHead)
+   if (!Window && MsgFilterLow == 0 && MsgFilterHigh == 0)
    {
-      CurrentMessage = CONTAINING_RECORD(ListHead, USER_MESSAGE, ListEntry);
-      ListHead = ListHead->Flink;
-/*
- MSDN:
- 1: any window that belongs to the current thread, and any messages on the current thread's message queue whose hwnd value is NULL.
- 2: retrieves only messages on the current thread's message queue whose hwnd value is NULL.
- 3: handle to the window whose messages are to be retrieved.
- */
-      if ( ( !Window || // 1
-            ( Window == PWND_BOTTOM && CurrentMessage->Msg.hwnd == NULL ) || // 2
-            ( Window != PWND_BOTTOM && Window->head.h == CurrentMessage->Msg.hwnd ) ) && // 3
-            ( ( ( MsgFilterLow == 0 && MsgFilterHigh == 0 ) && CurrentMessage->QS_Flags & QSflags ) ||
-              ( MsgFilterLow <= CurrentMessage->Msg.message && MsgFilterHigh >= CurrentMessage->Msg.message ) ) )
+      /* No filter, the oldest message usually matches */
+      ListHead = &pti->PostedMessagesListHead;
+      for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+      {
+         CurrentMessage = CONTAINING_RECORD(Entry, USER_MESSAGE, ListEntry);
+         if (MsqPostedMessageMatches(CurrentMessage, Window, MsgFilterLow, MsgFilterHigh, QSflags))
+         {
+            FoundMessage = CurrentMessage;
+            break;
+         }
+      }
+   }
+   else
+   {
+      if (MsgFilterLow == 0 && MsgFilterHigh == 0)
       {
-         *Message   = CurrentMessage->Msg;
-         *ExtraInfo = CurrentMessage->ExtraInfo;
-         QS_Flags   = CurrentMessage->QS_Flags;
-         if (dwQEvent) *dwQEvent = CurrentMessage->dwQEvent;
+         FirstClass = 0;
+         LastClass = POSTED_MSG_CLASSES - 1;
+      }
+      else if (MsgFilterLow <= MsgFilterHigh)
+      {
+         FirstClass = MsqPostedMessageClass(MsgFilterLow);
+         LastClass = MsqPostedMessageClass(MsgFilterHigh);
+      }
+      else
+      {
+         return FALSE;
+      }
 
-         if (Remove)
+      if (!Window)
+      {
+         FirstSlot = 0;
+         LastSlot = POSTED_MSG_SLOTS - 1;
+      }
+      else
+      {
+         FirstSlot = LastSlot = MsqPostedMessageSlot(Window == PWND_BOTTOM ? NULL : Window->head.h);
+      }
+
+      /* Take the oldest of the first match of each bucket */
+      for (Slot = FirstSlot; Slot <= LastSlot; Slot++)
+      {
+         for (Class = FirstClass; Class <= LastClass; Class++)
          {
-             if (CurrentMessage->pti != NULL)
-             {
-                MsqDestroyMessage(CurrentMessage);
-             }
-             ClearMsgBitsMask(pti, QS_Flags);
+            ListHead = MsqPostedMessageBucket(pti, Slot, Class);
+            for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+            {
+               CurrentMessage = CONTAINING_RECORD(Entry, USER_MESSAGE, IndexEntry);
+
+               /* The rest of this bucket was posted later than what we have */
+               if (FoundMessage && (LONG)(CurrentMessage->Sequence - FoundMessage->Sequence) > 0)
+                  break;
+
+               if (MsqPostedMessageMatches(CurrentMessage, Window, MsgFilterLow, MsgFilterHigh, QSflags))
+               {
+                  FoundMessage = CurrentMessage;
+                  break;
+               }
+            }
          }
-         Ret = TRUE;
-         break;
       }
    }
 
-   return Ret;
+   if (!FoundMessage) return FALSE;
+
+   *Message   = FoundMessage->Msg;
+   *ExtraInfo = FoundMessage->ExtraInfo;
+   QS_Flags   = FoundMessage->QS_Flags;
+   if (dwQEvent) *dwQEvent = FoundMessage->dwQEvent;
+
+   if (Remove)
+   {
+       if (FoundMessage->pti != NULL)
+       {
+          MsqDestroyMessage(FoundMessage);
+       }
+       ClearMsgBitsMask(pti, QS_Flags);
+   }
+
+   return TRUE;
 }
 
 NTSTATUS FASTCALL
@@ -13,6 +13,8 @@ typedef struct _USER_MESSAGE
   LONG_PTR ExtraInfo;
   DWORD dwQEvent;
   PTHREADINFO pti;
+  LIST_ENTRY IndexEntry; /* Posted messages only, see MsqPeekMessage */
+  ULONG Sequence;
 } USER_MESSAGE, *PUSER_MESSAGE;
 
 struct _USER_MESSAGE_QUEUE;
@@ -9,8 +9,139 @@
 #include <win32k.h>
 DBG_DEFAULT_CHANNEL(UserProp);
 
+/*
+ * Windows with more than PROP_HASH_THRESHOLD properties also index them in
+ * an open addressed table with linear probing, kept at most half full.
+ * The list still owns the properties and gives the enumeration order.
+ */
+#define PROP_HASH_THRESHOLD 8
+#define PROP_HASH_MIN_SIZE  16
+
 /* STATIC FUNCTIONS **********************************************************/
 
+static inline
+ULONG
+IntPropHashIndex(
+    _In_ PWND Window,
+    _In_ ATOM Atom,
+    _In_ WORD SystemFlag)
+{
+    ULONG Key = ((ULONG)Atom << 1) | SystemFlag;
+
+    return ((Key * 0x9E3779B1) >> 16) & (Window->PropHashSize - 1);
+}
+
+static
+VOID
+IntPropHashInsert(
+    _In_ PWND Window,
+    _In_ PPROPERTY Property)
+{
+    ULONG Mask = Window->PropHashSize - 1;
+    ULONG i;
+
+    i = IntPropHashIndex(Window, Property->Atom, Property->fs & PROPERTY_FLAG_SYSTEM);
+    while (Window->PropHashTable[i] != NULL)
+    {
+        i = (i + 1) & Mask;
+    }
+    Window->PropHashTable[i] = Property;
+}
+
+static
+VOID
+IntPropHashRemove(
+    _In_ PWND Window,
+    _In_ PPROPERTY Property)
+{
+    PPROPERTY *Table = Window->PropHashTable;
+    ULONG Mask = Window->PropHashSize - 1;
+    ULONG i, j, Home;
+
+    i = IntPropHashIndex(Window, Property->Atom, Property->fs & PROPERTY_FLAG_SYSTEM);
+    while (Table[i] != Property)
+    {
+        NT_ASSERT(Table[i] != NULL);
+        i = (i + 1) & Mask;
+    }
+
+    /* No tombstones, move the rest of the probe run back over the hole */
+    for (j = (i + 1) & Mask; Table[j] != NULL; j = (j + 1) & Mask)
+    {
+        Home = IntPropHashIndex(Window, Table[j]->Atom, Table[j]->fs & PROPERTY_FLAG_SYSTEM);
+        if (((j - Home) & Mask) >= ((j - i) & Mask))
+        {
+            Table[i] = Table[j];
+            i = j;
+        }
+    }
+    Table[i] = NULL;
+}
+
+static
+VOID
+IntPropHashFree(
+    _In_ PWND Window)
+{
+    if (Window->PropHashTable != NULL)
+    {
+        UserHeapFree(Window->PropHashTable);
+        Window->PropHashTable = NULL;
+        Window->PropHashSize = 0;
+    }
+}
+
+/* Called once Property is on the list and counted */
+static
+VOID
+IntPropHashAdd(
+    _In_ PWND Window,
+    _In_ PPROPERTY Property)
+{
+    PLIST_ENTRY ListEntry;
+    PPROPERTY *Table;
+    ULONG Size;
+
+    if (Window->PropHashTable == NULL)
+    {
+        if (Window->PropListItems <= PROP_HASH_THRESHOLD)
+        {
+            return;
+        }
+    }
+    else if (Window->PropListItems * 2 <= Window->PropHashSize)
+    {
+        IntPropHashInsert(Window, Property);
+        return;
+    }
+
+    /* (Re)build the table from the list */
+    Size = PROP_HASH_MIN_SIZE;
+    while (Size < Window->PropListItems * 2)
+    {
+        Size *= 2;
+    }
+
+    Table = UserHeapAlloc(Size * sizeof(PPROPERTY));
+    IntPropHashFree(Window);
+    if (Table == NULL)
+    {
+        /* Lookups fall back to the list, try again on the next insertion */
+        WARN("Failed to allocate the property table of window %p\n", Window);
+        return;
+    }
+    RtlZeroMemory(Table, Size * sizeof(PPROPERTY));
+    Window->PropHashTable = Table;
+    Window->PropHashSize = Size;
+
+    for (ListEntry = Window->PropListHead.Flink;
+         ListEntry != &Window->PropListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        IntPropHashInsert(Window, CONTAINING_RECORD(ListEntry, PROPERTY, PropListEntry));
+    }
+}
+
 PPROPERTY
 FASTCALL
 IntGetProp(
@@ -24,6 +155,22 @@ IntGetProp(
     WORD SystemFlag = SystemProp ? PROPERTY_FLAG_SYSTEM : 0;
 
     NT_ASSERT(UserIsEntered());
+
+    if (Window->PropHashTable != NULL)
+    {
+        for (i = IntPropHashIndex(Window, Atom, SystemFlag);
+             (Property = Window->PropHashTable[i]) != NULL;
+             i = (i + 1) & (Window->PropHashSize - 1))
+        {
+            if (Property->Atom == Atom &&
+                (Property->fs & PROPERTY_FLAG_SYSTEM) == SystemFlag)
+            {
+                return Property;
+            }
+        }
+        return NULL;
+    }
+
     ListEntry = Window->PropListHead.Flink;
 
     for (i = 0; i < Window->PropListItems; i++)
@@ -74,9 +221,17 @@ UserRemoveProp(
     }
 
     Data = Prop->Data;
+    if (Window->PropHashTable != NULL)
+    {
+        IntPropHashRemove(Window, Prop);
+    }
     RemoveEntryList(&Prop->PropListEntry);
     UserHeapFree(Prop);
     Window->PropListItems--;
+    if (Window->PropListItems == 0)
+    {
+        IntPropHashFree(Window);
+    }
     return Data;
 }
 
@@ -104,6 +259,7 @@ UserSetProp(
         Prop->fs = SystemProp ? PROPERTY_FLAG_SYSTEM : 0;
         InsertTailList(&Window->PropListHead, &Prop->PropListEntry);
         Window->PropListItems++;
+        IntPropHashAdd(Window, Prop);
     }
 
     Prop->Data = Data;
@@ -119,6 +275,7 @@ UserRemoveWindowProps(
     PPROPERTY Property;
 
     NT_ASSERT(UserIsEnteredExclusive());
+    IntPropHashFree(Window);
     while (!IsListEmpty(&Window->PropListHead))
     {
         ListEntry = Window->PropListHead.Flink;
@@ -14,7 +14,18 @@ DBG_DEFAULT_CHANNEL(UserTimer);
 /* GLOBALS *******************************************************************/
 
 static LIST_ENTRY TimersListHead;
-static LONG TimeLast = 0;
+
+/* Timers hashed by window and id, see FindTimer */
+#define TIMER_HASH_SIZE 64
+static LIST_ENTRY TimersHashTable[TIMER_HASH_SIZE];
+
+/* Timers waiting for their thread to pick them up, see PostTimerMessages */
+static LIST_ENTRY TimersReadyListHead;
+
+/* Binary min-heap of the running timers by due time, see ProcessTimers */
+static PTIMER *TimerHeap;
+static ULONG TimerHeapCount;
+static ULONG TimerHeapSize;
 
 /* Windows 2000 has room for 32768 window-less timers */
 #define NUM_WINDOW_LESS_TIMERS   32768
@@ -46,6 +57,154 @@ ERESOURCE TimerLock;
 
 
 /* FUNCTIONS *****************************************************************/
+
+/* Tick counts wrap, compare them by difference */
+#define TIMER_DUE_BEFORE(a, b) ((LONG)((a)->DueTime - (b)->DueTime) < 0)
+
+static inline
+PLIST_ENTRY
+TimerHashBucket(PWND Window, UINT_PTR nID)
+{
+  return &TimersHashTable[(((ULONG_PTR)Window >> 4) ^ nID) % TIMER_HASH_SIZE];
+}
+
+static
+VOID
+FASTCALL
+TimerHeapSiftUp(ULONG Index)
+{
+  PTIMER pTmr = TimerHeap[Index];
+  ULONG Parent;
+
+  while (Index > 0)
+  {
+     Parent = (Index - 1) / 2;
+     if (!TIMER_DUE_BEFORE(pTmr, TimerHeap[Parent]))
+        break;
+
+     TimerHeap[Index] = TimerHeap[Parent];
+     TimerHeap[Index]->iHeap = Index;
+     Index = Parent;
+  }
+
+  TimerHeap[Index] = pTmr;
+  pTmr->iHeap = Index;
+}
+
+static
+VOID
+FASTCALL
+TimerHeapSiftDown(ULONG Index)
+{
+  PTIMER pTmr = TimerHeap[Index];
+  ULONG Child;
+
+  while ((Child = 2 * Index + 1) < TimerHeapCount)
+  {
+     if (Child + 1 < TimerHeapCount && TIMER_DUE_BEFORE(TimerHeap[Child + 1], TimerHeap[Child]))
+        Child++;
+
+     if (!TIMER_DUE_BEFORE(TimerHeap[Child], pTmr))
+        break;
+
+     TimerHeap[Index] = TimerHeap[Child];
+     TimerHeap[Index]->iHeap = Index;
+     Index = Child;
+  }
+
+  TimerHeap[Index] = pTmr;
+  pTmr->iHeap = Index;
+}
+
+/* Makes room for one more timer in the heap */
+static
+BOOL
+FASTCALL
+TimerHeapReserve(VOID)
+{
+  PTIMER *NewHeap;
+  ULONG NewSize;
+
+  if (TimerHeapCount < TimerHeapSize)
+     return TRUE;
+
+  NewSize = TimerHeapSize ? TimerHeapSize * 2 : 64;
+  NewHeap = ExAllocatePoolWithTag(PagedPool, NewSize * sizeof(PTIMER), USERTAG_TIMER);
+  if (!NewHeap)
+     return FALSE;
+
+  if (TimerHeap)
+  {
+     RtlCopyMemory(NewHeap, TimerHeap, TimerHeapCount * sizeof(PTIMER));
+     ExFreePoolWithTag(TimerHeap, USERTAG_TIMER);
+  }
+
+  TimerHeap = NewHeap;
+  TimerHeapSize = NewSize;
+  return TRUE;
+}
+
+static
+VOID
+FASTCALL
+TimerHeapInsert(PTIMER pTmr)
+{
+  ASSERT(TimerHeapCount < TimerHeapSize);
+
+  TimerHeap[TimerHeapCount] = pTmr;
+  TimerHeapSiftUp(TimerHeapCount++);
+}
+
+/* Moves the timer to its place after its due time changed */
+static
+VOID
+FASTCALL
+TimerHeapUpdate(PTIMER pTmr)
+{
+  TimerHeapSiftUp(pTmr->iHeap);
+  TimerHeapSiftDown(pTmr->iHeap);
+}
+
+static
+VOID
+FASTCALL
+TimerHeapRemove(PTIMER pTmr)
+{
+  ULONG Index = pTmr->iHeap;
+  PTIMER pLast;
+
+  if (Index == TIMER_NOT_QUEUED)
+     return;
+
+  pTmr->iHeap = TIMER_NOT_QUEUED;
+  pLast = TimerHeap[--TimerHeapCount];
+  if (pLast == pTmr)
+     return;
+
+  TimerHeap[Index] = pLast;
+  pLast->iHeap = Index;
+  TimerHeapUpdate(pLast);
+}
+
+/* Wakes the raw input thread when the first timer is due */
+static
+VOID
+FASTCALL
+TimerSetMasterTimer(LONG Time)
+{
+  LARGE_INTEGER DueTime;
+  LONG Delay;
+
+  if (!TimerHeapCount)
+     return;
+
+  Delay = max(TimerHeap[0]->DueTime - Time, 1);
+  DueTime.QuadPart = (LONGLONG)Delay * -10000;
+
+  ASSERT(MasterTimer != NULL);
+  KeSetTimer(MasterTimer, DueTime, NULL);
+}
+
 static
 PTIMER
 FASTCALL
@@ -58,6 +217,7 @@ CreateTimer(VOID)
   if (Ret)
   {
      Ret->head.h = Handle;
+     Ret->iHeap = TIMER_NOT_QUEUED;
      InsertTailList(&TimersListHead, &Ret->ptmrList);
   }
 
@@ -74,6 +234,10 @@ RemoveTimer(PTIMER pTmr)
   {
      /* Set the flag, it will be removed when ready */
      RemoveEntryList(&pTmr->ptmrList);
+     RemoveEntryList(&pTmr->HashLink);
+     if (pTmr->flags & TMRF_READY)
+        RemoveEntryList(&pTmr->ReadyLink);
+     TimerHeapRemove(pTmr);
      if ((pTmr->pWnd == NULL) && (!(pTmr->flags & TMRF_SYSTEM))) // System timers are reusable.
      {
         UINT_PTR IDEvent;
@@ -97,14 +261,15 @@ FindTimer(PWND Window,
           UINT_PTR nID,
           UINT flags)
 {
-  PLIST_ENTRY pLE;
+  PLIST_ENTRY pLE, pBucket;
   PTIMER pTmr, RetTmr = NULL;
 
   TimerEnterExclusive();
-  pLE = TimersListHead.Flink;
-  while (pLE != &TimersListHead)
+  pBucket = TimerHashBucket(Window, nID);
+  pLE = pBucket->Flink;
+  while (pLE != pBucket)
   {
-    pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
+    pTmr = CONTAINING_RECORD(pLE, TIMER, HashLink);
 
     if ( pTmr->nID == nID &&
          pTmr->pWnd == Window &&
@@ -182,8 +347,7 @@ IntSetTimer( PWND Window,
 {
   PTIMER pTmr;
   UINT Ret = IDEvent;
-  LARGE_INTEGER DueTime;
-  DueTime.QuadPart = (LONGLONG)(-97656); // 1024hz .9765625 ms set to 10.0 ms
+  LONG Time;
 
 #if 0
   /* Windows NT/2k/XP behaviour */
@@ -213,8 +377,17 @@ IntSetTimer( PWND Window,
   if ((Window) && (IDEvent == 0))
      Ret = 1;
 
+  TimerEnterExclusive();
   pTmr = FindTimer(Window, IDEvent, Type);
 
+  if ((!pTmr) && (!TimerHeapReserve()))
+  {
+     TimerLeave();
+     ERR("Unable to grow the timer heap\n");
+     EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
+     return 0;
+  }
+
   if ((!pTmr) && (Window == NULL) && (!(Type & TMRF_SYSTEM)))
   {
       IntLockWindowlessTimerBitmap();
@@ -224,6 +397,7 @@ IntSetTimer( PWND Window,
       if (IDEvent == (UINT_PTR) -1)
       {
          IntUnlockWindowlessTimerBitmap();
+         TimerLeave();
          ERR("Unable to find a free window-less timer id\n");
          EngSetLastError(ERROR_NO_SYSTEM_RESOURCES);
          ASSERT(FALSE);
@@ -239,7 +413,11 @@ IntSetTimer( PWND Window,
   if (!pTmr)
   {
      pTmr = CreateTimer();
-     if (!pTmr) return 0;
+     if (!pTmr)
+     {
+        TimerLeave();
+        return 0;
+     }
 
      if (Window && (Type & TMRF_TIFROMWND))
         pTmr->pti = Window->head.pti->pEThread->Tcb.Win32Thread;
@@ -252,22 +430,26 @@ IntSetTimer( PWND Window,
      }
 
      pTmr->pWnd    = Window;
-     pTmr->cmsCountdown = Elapse;
-     pTmr->cmsRate = Elapse;
      pTmr->pfn     = TimerFunc;
      pTmr->nID     = IDEvent;
-     pTmr->flags   = Type|TMRF_INIT;
-  }
-  else
-  {
-     pTmr->cmsCountdown = Elapse;
-     pTmr->cmsRate = Elapse;
+     pTmr->flags   = Type;
+     InsertTailList(TimerHashBucket(Window, IDEvent), &pTmr->HashLink);
   }
 
-  ASSERT(MasterTimer != NULL);
-  // Start the timer thread!
-  if (TimersListHead.Flink == TimersListHead.Blink) // There is only one timer
-     KeSetTimer(MasterTimer, DueTime, NULL);
+  Time = EngGetTickCount32();
+  pTmr->cmsRate = Elapse;
+  pTmr->DueTime = Time + Elapse;
+
+  if (pTmr->iHeap != TIMER_NOT_QUEUED)
+     TimerHeapUpdate(pTmr);
+  else if (!(pTmr->flags & TMRF_WAITING))
+     TimerHeapInsert(pTmr);
+
+  // Start the timer thread if this timer is the next one due!
+  if (pTmr->iHeap == 0)
+     TimerSetMasterTimer(Time);
+
+  TimerLeave();
 
   return Ret;
 }
@@ -403,12 +585,11 @@ PostTimerMessages(PWND Window)
   pti = PsGetCurrentThreadWin32Thread();
 
   TimerEnterExclusive();
-  pLE = TimersListHead.Flink;
-  while(pLE != &TimersListHead)
+  pLE = TimersReadyListHead.Flink;
+  while(pLE != &TimersReadyListHead)
   {
-     pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
-     if ( (pTmr->flags & TMRF_READY) &&
-          (pTmr->pti == pti) &&
+     pTmr = CONTAINING_RECORD(pLE, TIMER, ReadyLink);
+     if ( (pTmr->pti == pti) &&
           ((pTmr->pWnd == Window) || (Window == NULL)) )
         {
            Msg.hwnd    = (pTmr->pWnd) ? pTmr->pWnd->head.h : 0;
@@ -421,15 +602,11 @@ PostTimerMessages(PWND Window)
 
            MsqPostMessage(pti, &Msg, FALSE, (QS_POSTMESSAGE|QS_ALLPOSTMESSAGE), 0, 0);
            pTmr->flags &= ~TMRF_READY;
+           // Off the ready list, the other ready timers of this thread go
+           // first in the next msg loop.
+           RemoveEntryList(&pTmr->ReadyLink);
            ClearMsgBitsMask(pti, QS_TIMER);
            Hit = TRUE;
-           // Now move this entry to the end of the list so it will not be
-           // called again in the next msg loop.
-           if (pLE != &TimersListHead)
-           {
-              RemoveEntryList(&pTmr->ptmrList);
-              InsertTailList(&TimersListHead, &pTmr->ptmrList);
-           }
            break;
         }
 
@@ -445,74 +622,60 @@ VOID
 FASTCALL
 ProcessTimers(VOID)
 {
-  LARGE_INTEGER DueTime;
   LONG Time;
-  PLIST_ENTRY pLE;
   PTIMER pTmr;
+  BOOL Fire;
   LONG TimerCount = 0;
 
   TimerEnterExclusive();
-  pLE = TimersListHead.Flink;
   Time = EngGetTickCount32();
 
-  DueTime.QuadPart = (LONGLONG)(-97656); // 1024hz .9765625 ms set to 10.0 ms
-
-  while(pLE != &TimersListHead)
+  // Only the timers that are due, earliest first.
+  while (TimerHeapCount && (LONG)(Time - TimerHeap[0]->DueTime) >= 0)
   {
-    pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
+    pTmr = TimerHeap[0];
     TimerCount++;
-    if (pTmr->flags & TMRF_WAITING)
+
+    ASSERT(pTmr->pti);
+    Fire = (!(pTmr->flags & TMRF_READY)) && (!(pTmr->pti->TIF_flags & TIF_INCLEANUP));
+
+    // Reschedule before the raw input thread callbacks, they may set or
+    // kill timers.
+    if (Fire && (pTmr->flags & TMRF_ONESHOT))
     {
-       pLE = pTmr->ptmrList.Flink;
-       pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
-       continue;
+       pTmr->flags |= TMRF_WAITING;
+       TimerHeapRemove(pTmr);
+    }
+    else
+    {
+       pTmr->DueTime = Time + pTmr->cmsRate;
+       TimerHeapUpdate(pTmr);
     }
 
-    if (pTmr->flags & TMRF_INIT)
+    if (!Fire)
+       continue;
+
+    if (pTmr->flags & TMRF_RIT)
     {
-       pTmr->flags &= ~TMRF_INIT; // Skip this run.
+       // Hard coded call here, inside raw input thread.
+       pTmr->pfn(NULL, WM_SYSTIMER, pTmr->nID, (LPARAM)pTmr);
     }
     else
     {
-       if (pTmr->cmsCountdown < 0)
-       {
-          ASSERT(pTmr->pti);
-          if ((!(pTmr->flags & TMRF_READY)) && (!(pTmr->pti->TIF_flags & TIF_INCLEANUP)))
-          {
-             if (pTmr->flags & TMRF_ONESHOT)
-                pTmr->flags |= TMRF_WAITING;
-
-             if (pTmr->flags & TMRF_RIT)
-             {
-                // Hard coded call here, inside raw input thread.
-                pTmr->pfn(NULL, WM_SYSTIMER, pTmr->nID, (LPARAM)pTmr);
-             }
-             else
-             {
-                pTmr->flags |= TMRF_READY; // Set timer ready to be ran.
-                // Set thread message queue for this timer.
-                if (pTmr->pti)
-                {  // Wakeup thread
-                   pTmr->pti->cTimersReady++;
-                   ASSERT(pTmr->pti->pEventQueueServer != NULL);
-                   MsqWakeQueue(pTmr->pti, QS_TIMER, TRUE);
-                }
-             }
-          }
-          pTmr->cmsCountdown = pTmr->cmsRate;
+       pTmr->flags |= TMRF_READY; // Set timer ready to be ran.
+       InsertTailList(&TimersReadyListHead, &pTmr->ReadyLink);
+       // Set thread message queue for this timer.
+       if (pTmr->pti)
+       {  // Wakeup thread
+          pTmr->pti->cTimersReady++;
+          ASSERT(pTmr->pti->pEventQueueServer != NULL);
+          MsqWakeQueue(pTmr->pti, QS_TIMER, TRUE);
        }
-       else
-          pTmr->cmsCountdown -= Time - TimeLast;
     }
-
-    pLE = pLE->Flink;
   }
 
   // Restart the timer thread!
-  ASSERT(MasterTimer != NULL);
-  KeSetTimer(MasterTimer, DueTime, NULL);
-
-  TimeLast = Time;
+  TimerSetMasterTimer(Time);
 
   TimerLeave();
   TRACE("TimerCount = %d\n", TimerCount);
@@ -593,7 +756,7 @@ NTSTATUS
 NTAPI
 InitTimerImpl(VOID)
 {
-   ULONG BitmapBytes;
+   ULONG BitmapBytes, i;
 
    /* Allocate FAST_MUTEX from non paged pool */
    Mutex = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
@@ -620,6 +783,11 @@ InitTimerImpl(VOID)
 
    ExInitializeResourceLite(&TimerLock);
    InitializeListHead(&TimersListHead);
+   InitializeListHead(&TimersReadyListHead);
+   for (i = 0; i < TIMER_HASH_SIZE; i++)
+   {
+      InitializeListHead(&TimersHashTable[i]);
+   }
 
    return STATUS_SUCCESS;
 }
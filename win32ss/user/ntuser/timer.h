@@ -4,10 +4,13 @@ typedef struct _TIMER
 {
   HEAD           head;
   LIST_ENTRY     ptmrList;
+  LIST_ENTRY     HashLink;     // Bucket of (pWnd, nID), see FindTimer
+  LIST_ENTRY     ReadyLink;    // Ready timers while TMRF_READY is set
   PTHREADINFO    pti;
   PWND           pWnd;         // hWnd
   UINT_PTR       nID;          // Specifies a nonzero timer identifier.
-  INT            cmsCountdown; // uElapse
+  LONG           DueTime;      // Tick count of the next expiry
+  ULONG          iHeap;        // Slot in the due time heap or TIMER_NOT_QUEUED
   INT            cmsRate;      // uElapse
   FLONG          flags;
   TIMERPROC      pfn;          // lpTimerFunc
@@ -24,6 +27,8 @@ typedef struct _TIMER
 #define TMRF_WAITING 0x0020
 #define TMRF_TIFROMWND 0x0040
 
+#define TIMER_NOT_QUEUED ((ULONG)-1)
+
 #define ID_EVENT_SYSTIMER_MOUSEHOVER     ID_TME_TIMER
 #define ID_EVENT_SYSTIMER_FLASHWIN       (0xFFF8)
 #define ID_EVENT_SYSTIMER_TRACKWIN       (0xFFF7)
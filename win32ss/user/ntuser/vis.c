@@ -141,6 +141,74 @@ VIS_ComputeVisibleRegion(
    return VisRgn;
 }
 
+/*
+ * The visible region only depends on the position, z-order, visibility and
+ * shape of the windows of the desktop, so a window keeps the last one it
+ * computed until any of these change on its desktop.
+ */
+PREGION FASTCALL
+VIS_GetCachedVisibleRegion(
+   PWND Wnd,
+   BOOLEAN ClientArea,
+   BOOLEAN ClipChildren,
+   BOOLEAN ClipSiblings)
+{
+   PDESKTOP Desktop;
+   PREGION VisRgn;
+   UINT Flags;
+
+   Desktop = Wnd ? Wnd->head.rpdesk : NULL;
+   if (!Desktop)
+   {
+      return VIS_ComputeVisibleRegion(Wnd, ClientArea, ClipChildren, ClipSiblings);
+   }
+
+   Flags = (ClientArea ? 1 : 0) | (ClipChildren ? 2 : 0) | (ClipSiblings ? 4 : 0);
+   if (!Wnd->VisRgnCache ||
+       Wnd->VisRgnCacheGeneration != Desktop->VisRgnGeneration ||
+       Wnd->VisRgnCacheFlags != Flags)
+   {
+      VIS_FreeVisRgnCache(Wnd);
+
+      VisRgn = VIS_ComputeVisibleRegion(Wnd, ClientArea, ClipChildren, ClipSiblings);
+      if (!VisRgn)
+      {
+         return NULL;
+      }
+
+      Wnd->VisRgnCache = VisRgn;
+      Wnd->VisRgnCacheGeneration = Desktop->VisRgnGeneration;
+      Wnd->VisRgnCacheFlags = Flags;
+   }
+
+   /* The callers combine and delete what they get */
+   VisRgn = IntSysCreateRectpRgn(0, 0, 0, 0);
+   if (VisRgn)
+   {
+      IntGdiCombineRgn(VisRgn, Wnd->VisRgnCache, NULL, RGN_COPY);
+   }
+   return VisRgn;
+}
+
+VOID FASTCALL
+VIS_InvalidateVisibleRegions(PWND Wnd)
+{
+   if (Wnd && Wnd->head.rpdesk)
+   {
+      Wnd->head.rpdesk->VisRgnGeneration++;
+   }
+}
+
+VOID FASTCALL
+VIS_FreeVisRgnCache(PWND Wnd)
+{
+   if (Wnd->VisRgnCache)
+   {
+      REGION_Delete(Wnd->VisRgnCache);
+      Wnd->VisRgnCache = NULL;
+   }
+}
+
 VOID FASTCALL
 co_VIS_WindowLayoutChanged(
    PWND Wnd,
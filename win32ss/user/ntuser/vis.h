@@ -10,6 +10,9 @@
 #pragma once
 
 PREGION FASTCALL VIS_ComputeVisibleRegion(PWND Window, BOOLEAN ClientArea, BOOLEAN ClipChildren, BOOLEAN ClipSiblings);
+PREGION FASTCALL VIS_GetCachedVisibleRegion(PWND Window, BOOLEAN ClientArea, BOOLEAN ClipChildren, BOOLEAN ClipSiblings);
+VOID FASTCALL VIS_InvalidateVisibleRegions(PWND Window);
+VOID FASTCALL VIS_FreeVisRgnCache(PWND Window);
 VOID FASTCALL co_VIS_WindowLayoutChanged(PWND Window, PREGION UncoveredRgn);
 
 /* EOF */
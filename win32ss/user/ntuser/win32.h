@@ -72,6 +72,11 @@ typedef struct _W32THREAD
 
 struct tagIMC;
 
+/* Buckets of the posted message index, see MsqPeekMessage */
+#define POSTED_MSG_WND_SLOTS 8                          /* Shared by windows */
+#define POSTED_MSG_SLOTS     (POSTED_MSG_WND_SLOTS + 1) /* And one for thread messages */
+#define POSTED_MSG_CLASSES   4
+
 /*
  * THREADINFO structure.
  * See also: https://reactos.org/wiki/Techwiki:Win32k/THREADINFO
@@ -154,6 +159,9 @@ typedef struct _THREADINFO
 
     LIST_ENTRY WindowListHead;
     LIST_ENTRY W32CallbackListHead;
+    /* Posted messages again, by window handle slot and message range */
+    LIST_ENTRY PostedMessagesIndex[POSTED_MSG_SLOTS * POSTED_MSG_CLASSES];
+    ULONG PostedMessagesSequence;
     SINGLE_LIST_ENTRY  ReferencesList;
     ULONG cExclusiveLocks;
 #if DBG
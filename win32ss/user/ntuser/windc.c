@@ -72,10 +72,10 @@ PREGION FASTCALL
 DceGetVisRgn(PWND Window, ULONG Flags, HWND hWndChild, ULONG CFlags)
 {
     PREGION Rgn;
-    Rgn = VIS_ComputeVisibleRegion( Window,
-                                    0 == (Flags & DCX_WINDOW),
-                                    0 != (Flags & DCX_CLIPCHILDREN),
-                                    0 != (Flags & DCX_CLIPSIBLINGS));
+    Rgn = VIS_GetCachedVisibleRegion( Window,
+                                      0 == (Flags & DCX_WINDOW),
+                                      0 != (Flags & DCX_CLIPCHILDREN),
+                                      0 != (Flags & DCX_CLIPSIBLINGS));
     /* Caller expects a non-null region */
     if (!Rgn)
         Rgn = IntSysCreateRectpRgn(0, 0, 0, 0);
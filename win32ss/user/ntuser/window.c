@@ -147,6 +147,7 @@ IntSetStyle( PWND pwnd, ULONG set_bits, ULONG clear_bits )
     styleNew = (pwnd->style | set_bits) & ~clear_bits;
     if (styleNew == styleOld) return styleNew;
     pwnd->style = styleNew;
+    VIS_InvalidateVisibleRegions(pwnd);
     if ((styleOld ^ styleNew) & WS_VISIBLE) // State Change.
     {
        if (styleOld & WS_VISIBLE) pwnd->head.pti->cVisWindows--;
@@ -592,6 +593,7 @@ LRESULT co_UserFreeWindow(PWND Window,
    Window->state2 |= WNDS2_INDESTROY;
    Window->style &= ~WS_VISIBLE;
    Window->head.pti->cVisWindows--;
+   VIS_InvalidateVisibleRegions(Window);
 
    WndSetOwner(Window, NULL);
 
@@ -757,6 +759,7 @@ LRESULT co_UserFreeWindow(PWND Window,
       GreDeleteObject(Window->hrgnClip);
       Window->hrgnClip = NULL;
    }
+   VIS_FreeVisRgnCache(Window);
    Window->head.pti->cWindows--;
 
 //   ASSERT(Window != NULL);
@@ -969,6 +972,8 @@ IntLinkWindow(
 
         Wnd->spwndParent->spwndChild = Wnd;
     }
+
+    VIS_InvalidateVisibleRegions(Wnd);
 }
 
 /*
@@ -1232,6 +1237,7 @@ co_IntSetParent(PWND Wnd, PWND WndNewParent)
        !(Wnd->style & WS_CLIPSIBLINGS) )
    {
       Wnd->style |= WS_CLIPSIBLINGS;
+      VIS_InvalidateVisibleRegions(Wnd);
       DceResetActiveDCEs(Wnd);
    }
 
@@ -1353,6 +1359,7 @@ IntUnlinkWindow(PWND Wnd)
         Wnd->spwndParent->spwndChild = Wnd->spwndNext;
 
     Wnd->spwndPrev = Wnd->spwndNext = NULL;
+    VIS_InvalidateVisibleRegions(Wnd);
 }
 
 // Win: ExpandWindowList
@@ -2031,6 +2038,8 @@ PWND FASTCALL IntCreateWindow(CREATESTRUCTW* Cs,
 
    InitializeListHead(&pWnd->PropListHead);
    pWnd->PropListItems = 0;
+   pWnd->PropHashTable = NULL;
+   pWnd->PropHashSize = 0;
 
    if ( WindowName->Buffer != NULL && WindowName->Length > 0 )
    {
@@ -2460,6 +2469,7 @@ co_UserCreateWindowEx(CREATESTRUCTW* Cs,
 
    RECTL_vOffsetRect(&Window->rcWindow, MaxPos.x - Window->rcWindow.left,
                                      MaxPos.y - Window->rcWindow.top);
+   VIS_InvalidateVisibleRegions(Window);
    }
 
    /* Send the WM_CREATE message. */
@@ -3907,6 +3917,7 @@ co_IntSetWindowLongPtr(HWND hWnd, DWORD Index, LONG_PTR NewValue, BOOL Ansi, ULO
             }
 
             Window->ExStyle = (DWORD)Style.styleNew;
+            VIS_InvalidateVisibleRegions(Window);
 
             co_IntSendMessage(hWnd, WM_STYLECHANGED, GWL_EXSTYLE, (LPARAM) &Style);
             break;
@@ -3960,6 +3971,7 @@ co_IntSetWindowLongPtr(HWND hWnd, DWORD Index, LONG_PTR NewValue, BOOL Ansi, ULO
                DceResetActiveDCEs( Window );
             }
             Window->style = (DWORD)Style.styleNew;
+            VIS_InvalidateVisibleRegions(Window);
 
             if (!bAlter)
                 co_IntSendMessage(hWnd, WM_STYLECHANGED, GWL_STYLE, (LPARAM) &Style);
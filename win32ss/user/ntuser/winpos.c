@@ -278,6 +278,8 @@ SelectWindowRgn(PWND Window, HRGN hRgnClip)
 
         Window->hrgnClip = hRgnClip;
     }
+
+    VIS_InvalidateVisibleRegions(Window);
 }
 
 //
@@ -1535,6 +1537,7 @@ WinPosInternalMoveWindow(PWND Window, INT MoveX, INT MoveY)
    Window->rcClient.right += MoveX;
    Window->rcClient.top += MoveY;
    Window->rcClient.bottom += MoveY;
+   VIS_InvalidateVisibleRegions(Window);
 
    for(Child = Window->spwndChild; Child; Child = Child->spwndNext)
    {
@@ -1952,6 +1955,7 @@ co_WinPosSetWindowPos(
 
    Window->rcWindow = NewWindowRect;
    Window->rcClient = NewClientRect;
+   VIS_InvalidateVisibleRegions(Window);
 
    /* erase parent when hiding or resizing child */
    if (WinPos.flags & SWP_HIDEWINDOW)
@@ -1967,6 +1971,7 @@ co_WinPosSetWindowPos(
 
       Window->style &= ~WS_VISIBLE; //IntSetStyle( Window, 0, WS_VISIBLE );
       Window->head.pti->cVisWindows--;
+      VIS_InvalidateVisibleRegions(Window);
       IntNotifyWinEvent(EVENT_OBJECT_HIDE, Window, OBJID_WINDOW, CHILDID_SELF, WEF_SETBYWNDPTI);
    }
    else if (WinPos.flags & SWP_SHOWWINDOW)
@@ -1994,6 +1999,7 @@ co_WinPosSetWindowPos(
 
       Window->style |= WS_VISIBLE; //IntSetStyle( Window, WS_VISIBLE, 0 );
       Window->head.pti->cVisWindows++;
+      VIS_InvalidateVisibleRegions(Window);
       IntNotifyWinEvent(EVENT_OBJECT_SHOW, Window, OBJID_WINDOW, CHILDID_SELF, WEF_SETBYWNDPTI);
    }
    else
@@ -52,6 +52,7 @@ typedef struct _DC *PDC;
 #include "gdi/ntgdi/coord.h"
 #include "gdi/ntgdi/path.h"
 #include "gdi/dib/dib.h"
+#include "gdi/dib/dibrow.h"
 #include "reactx/ntddraw/intddraw.h"
 
 /* Internal NtUser Headers */